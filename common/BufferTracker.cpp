@@ -18,50 +18,97 @@
 
 #include <android-base/macros.h>
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <set>
 #include <stack>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "CpuExecutor.h"
 #include "LegacyUtils.h"
+#include "SizeClassPool.h"
 #include "nnapi/TypeUtils.h"
 #include "nnapi/Validation.h"
 
 namespace android::nn {
 
+namespace {
+
+// The most allocations and memory that the pool of ManagedBuffer allocations keeps for reuse.
+constexpr size_t kMaxPooledBuffers = 1024;
+constexpr size_t kMaxPooledBufferBytes = 16 * 1024 * 1024;
+
+using BufferPool = SizeClassPool<std::unique_ptr<uint8_t[]>>;
+
+BufferPool& getBufferPool() {
+    // Never destroyed, as ManagedBuffers may outlive the static objects.
+    static BufferPool* const pool = new BufferPool(kMaxPooledBuffers, kMaxPooledBufferBytes);
+    return *pool;
+}
+
+std::unique_ptr<uint8_t[]> allocateBuffer(size_t capacity) {
+    if (auto buffer = getBufferPool().acquire(capacity)) {
+        return std::move(*buffer);
+    }
+    std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[capacity]);
+    if (buffer == nullptr) {
+        // Free the cached buffers and try again.
+        getBufferPool().trim();
+        buffer.reset(new (std::nothrow) uint8_t[capacity]);
+    }
+    return buffer;
+}
+
+}  // namespace
+
 std::shared_ptr<ManagedBuffer> ManagedBuffer::create(uint32_t size,
                                                      std::set<PreparedModelRole> roles,
                                                      const Operand& operand) {
-    std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[size]);
-    if (buffer == nullptr) {
-        return nullptr;
-    }
     if (isExtension(operand.type)) {
         LOG(ERROR) << "ManagedBuffer cannot handle extension operands.";
         return nullptr;
     }
-    return std::make_shared<ManagedBuffer>(std::move(buffer), size, std::move(roles), operand);
+    const size_t capacity = getSizeClass(size);
+    std::unique_ptr<uint8_t[]> buffer = allocateBuffer(capacity);
+    if (buffer == nullptr) {
+        return nullptr;
+    }
+    return std::make_shared<ManagedBuffer>(std::move(buffer), size, capacity, std::move(roles),
+                                           operand);
 }
 
-ManagedBuffer::ManagedBuffer(std::unique_ptr<uint8_t[]> buffer, uint32_t size,
+ManagedBuffer::ManagedBuffer(std::unique_ptr<uint8_t[]> buffer, uint32_t size, size_t capacity,
                              std::set<PreparedModelRole> roles, const Operand& operand)
-    : kBuffer(std::move(buffer)),
+    : kBuffer(buffer.release(), BufferDeleter{.capacity = capacity}),
       kSize(size),
       kRoles(std::move(roles)),
       kOperandType(operand.type),
       kInitialDimensions(operand.dimensions),
+      kHasFixedDimensions(!tensorHasUnspecifiedDimensions(operand.type, operand.dimensions)),
       mUpdatedDimensions(operand.dimensions) {
     CHECK(!isExtension(kOperandType));
+    CHECK_LE(kSize, capacity);
+}
+
+PoolStatistics ManagedBuffer::getPoolStatistics() {
+    return getBufferPool().getStatistics();
+}
+
+void ManagedBuffer::trimPool() {
+    getBufferPool().trim();
+}
+
+void ManagedBuffer::BufferDeleter::operator()(uint8_t* buffer) const {
+    getBufferPool().release(capacity, std::unique_ptr<uint8_t[]>(buffer));
 }
 
 ErrorStatus ManagedBuffer::validateRequest(uint32_t poolIndex, const Request& request,
                                            const IPreparedModel* preparedModel) const {
     CHECK_LT(poolIndex, request.pools.size());
     CHECK(std::holds_alternative<Request::MemoryDomainToken>(request.pools[poolIndex]));
-    std::lock_guard<std::mutex> guard(mMutex);
 
     bool usedAsInput = false, usedAsOutput = false;
     for (uint32_t i = 0; i < request.inputs.size(); i++) {
@@ -72,17 +119,14 @@ ErrorStatus ManagedBuffer::validateRequest(uint32_t poolIndex, const Request& re
             LOG(ERROR) << "ManagedBuffer::validateRequest -- invalid buffer role.";
             return ErrorStatus::INVALID_ARGUMENT;
         }
-        if (!mInitialized) {
+        if (!mInitialized.load(std::memory_order_acquire)) {
             LOG(ERROR) << "ManagedBuffer::validateRequest -- using uninitialized buffer as input "
                           "request.";
             return ErrorStatus::GENERAL_FAILURE;
         }
-        auto combined = combineDimensions(mUpdatedDimensions, request.inputs[i].dimensions);
-        if (!combined.has_value()) {
-            LOG(ERROR) << "ManagedBuffer::validateRequest -- incompatible dimensions ("
-                       << toString(mUpdatedDimensions) << " vs "
-                       << toString(request.inputs[i].dimensions) << ")";
-            return ErrorStatus::INVALID_ARGUMENT;
+        if (const auto status = validateInputDimensions(request.inputs[i].dimensions);
+            status != ErrorStatus::NONE) {
+            return status;
         }
         usedAsInput = true;
     }
@@ -111,6 +155,24 @@ ErrorStatus ManagedBuffer::validateRequest(uint32_t poolIndex, const Request& re
     return ErrorStatus::NONE;
 }
 
+ErrorStatus ManagedBuffer::validateInputDimensions(const Dimensions& dimensions) const {
+    if (kHasFixedDimensions) {
+        if (!combineDimensions(kInitialDimensions, dimensions).has_value()) {
+            LOG(ERROR) << "ManagedBuffer::validateRequest -- incompatible dimensions ("
+                       << toString(kInitialDimensions) << " vs " << toString(dimensions) << ")";
+            return ErrorStatus::INVALID_ARGUMENT;
+        }
+        return ErrorStatus::NONE;
+    }
+    std::lock_guard<std::mutex> guard(mMutex);
+    if (!combineDimensions(mUpdatedDimensions, dimensions).has_value()) {
+        LOG(ERROR) << "ManagedBuffer::validateRequest -- incompatible dimensions ("
+                   << toString(mUpdatedDimensions) << " vs " << toString(dimensions) << ")";
+        return ErrorStatus::INVALID_ARGUMENT;
+    }
+    return ErrorStatus::NONE;
+}
+
 ErrorStatus ManagedBuffer::validateCopyFrom(const std::vector<uint32_t>& dimensions,
                                             uint32_t size) const {
     if (size != kSize) {
@@ -160,8 +222,7 @@ ErrorStatus ManagedBuffer::validateCopyTo(uint32_t size) const {
                    << size;
         return ErrorStatus::INVALID_ARGUMENT;
     }
-    std::lock_guard<std::mutex> guard(mMutex);
-    if (!mInitialized) {
+    if (!mInitialized.load(std::memory_order_acquire)) {
         LOG(ERROR) << "ManagedBuffer::validateCopyTo -- using uninitialized buffer as source.";
         return ErrorStatus::GENERAL_FAILURE;
     }
@@ -175,25 +236,41 @@ bool ManagedBuffer::updateDimensions(const std::vector<uint32_t>& dimensions) {
                    << toString(kInitialDimensions) << " vs " << toString(dimensions) << ")";
         return false;
     }
+    if (kHasFixedDimensions) {
+        return true;
+    }
     std::lock_guard<std::mutex> guard(mMutex);
     mUpdatedDimensions = std::move(combined.value());
     return true;
 }
 
 void ManagedBuffer::setInitialized(bool initialized) {
-    std::lock_guard<std::mutex> guard(mMutex);
-    mInitialized = initialized;
+    // Release the contents written to the buffer before it is marked as initialized.
+    mInitialized.store(initialized, std::memory_order_release);
 }
 
 BufferTracker::BufferTracker() {
-    constexpr size_t kPreallocatedElements = 1024;
     using StackSpace = std::vector<Request::MemoryDomainToken>;
     using Stack = std::stack<Request::MemoryDomainToken, StackSpace>;
     StackSpace stackSpace;
-    stackSpace.reserve(kPreallocatedElements);
+    stackSpace.reserve(kSegmentSize);
     mFreeTokens = Stack(std::move(stackSpace));
-    mTokenToBuffers.reserve(kPreallocatedElements);
-    mTokenToBuffers.emplace_back();
+    mSegments[0].store(new Slot[kSegmentSize], std::memory_order_release);
+}
+
+BufferTracker::~BufferTracker() {
+    for (auto& segment : mSegments) {
+        delete[] segment.load(std::memory_order_relaxed);
+    }
+}
+
+BufferTracker::Slot* BufferTracker::getSlot(uint32_t index) const {
+    const uint32_t segmentIndex = index / kSegmentSize;
+    if (segmentIndex >= kMaxSegments) {
+        return nullptr;
+    }
+    Slot* segment = mSegments[segmentIndex].load(std::memory_order_acquire);
+    return segment == nullptr ? nullptr : &segment[index % kSegmentSize];
 }
 
 std::unique_ptr<BufferTracker::Token> BufferTracker::add(std::shared_ptr<ManagedBuffer> buffer) {
@@ -203,36 +280,60 @@ std::unique_ptr<BufferTracker::Token> BufferTracker::add(std::shared_ptr<Managed
     std::lock_guard<std::mutex> guard(mMutex);
     auto token = Request::MemoryDomainToken{0};
     if (mFreeTokens.empty()) {
-        token = static_cast<Request::MemoryDomainToken>(mTokenToBuffers.size());
-        mTokenToBuffers.push_back(std::move(buffer));
+        if (mNumTokens == kSegmentSize * kMaxSegments) {
+            LOG(ERROR) << "BufferTracker::add -- too many tokens";
+            return nullptr;
+        }
+        token = static_cast<Request::MemoryDomainToken>(mNumTokens++);
+        auto& segment = mSegments[static_cast<uint32_t>(token) / kSegmentSize];
+        if (segment.load(std::memory_order_relaxed) == nullptr) {
+            segment.store(new Slot[kSegmentSize], std::memory_order_release);
+        }
     } else {
         token = mFreeTokens.top();
         mFreeTokens.pop();
-        const auto index = static_cast<uint32_t>(token);
-        mTokenToBuffers[index] = std::move(buffer);
     }
+    Slot* slot = getSlot(static_cast<uint32_t>(token));
+    ManagedBuffer* pointer = buffer.get();
+    slot->owner = std::move(buffer);
+    slot->buffer.store(pointer, std::memory_order_seq_cst);
     VLOG(MEMORY) << "BufferTracker::add -- new token = " << token;
     return std::make_unique<Token>(token, shared_from_this());
 }
 
 std::shared_ptr<ManagedBuffer> BufferTracker::get(Request::MemoryDomainToken token) const {
-    std::lock_guard<std::mutex> guard(mMutex);
-    const auto index = static_cast<uint32_t>(token);
-    if (mTokenToBuffers.size() <= index || mTokenToBuffers[index] == nullptr) {
+    Slot* slot = getSlot(static_cast<uint32_t>(token));
+    std::shared_ptr<ManagedBuffer> buffer;
+    if (slot != nullptr) {
+        slot->numReaders.fetch_add(1, std::memory_order_seq_cst);
+        if (slot->buffer.load(std::memory_order_seq_cst) != nullptr) {
+            buffer = slot->owner;
+        }
+        slot->numReaders.fetch_sub(1, std::memory_order_release);
+    }
+    if (buffer == nullptr) {
         LOG(ERROR) << "BufferTracker::get -- unknown token " << token;
-        return nullptr;
     }
-    return mTokenToBuffers[index];
+    return buffer;
 }
 
 void BufferTracker::free(Request::MemoryDomainToken token) {
-    std::lock_guard<std::mutex> guard(mMutex);
-    const auto index = static_cast<uint32_t>(token);
-    CHECK_LT(index, mTokenToBuffers.size());
-    CHECK(mTokenToBuffers[index] != nullptr);
-    VLOG(MEMORY) << "BufferTracker::free -- release token = " << token;
-    mTokenToBuffers[index] = nullptr;
-    mFreeTokens.push(token);
+    // The buffer is released after the lock, as it may be the last reference.
+    std::shared_ptr<ManagedBuffer> buffer;
+    {
+        std::lock_guard<std::mutex> guard(mMutex);
+        Slot* slot = getSlot(static_cast<uint32_t>(token));
+        CHECK(slot != nullptr);
+        CHECK(slot->buffer.load(std::memory_order_relaxed) != nullptr);
+        VLOG(MEMORY) << "BufferTracker::free -- release token = " << token;
+        slot->buffer.store(nullptr, std::memory_order_seq_cst);
+        // Wait for the readers that may have seen the buffer before it was cleared.
+        while (slot->numReaders.load(std::memory_order_seq_cst) != 0) {
+            std::this_thread::yield();
+        }
+        buffer = std::move(slot->owner);
+        mFreeTokens.push(token);
+    }
 }
 
 }  // namespace android::nn
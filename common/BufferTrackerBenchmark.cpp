@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+#include "BufferTracker.h"
+#include "nnapi/Types.h"
+#include "nnapi/Validation.h"
+
+namespace android::nn {
+namespace {
+
+const Operand kOperand = {.type = OperandType::TENSOR_FLOAT32, .dimensions = {1, 224, 224, 3}};
+constexpr uint32_t kSize = 1 * 224 * 224 * 3 * sizeof(float);
+
+// A driver-managed buffer that is used as the input of every execution, as a sample driver with
+// many concurrent executions of the same prepared model sees it.
+struct SharedBuffer {
+    SharedBuffer()
+        : tracker(BufferTracker::create()),
+          buffer(ManagedBuffer::create(kSize, {{nullptr, IOType::INPUT, 0}}, kOperand)),
+          token(tracker->add(buffer)) {
+        buffer->setInitialized(true);
+        request.inputs = {{.lifetime = Request::Argument::LifeTime::POOL,
+                           .location = {.poolIndex = 0, .length = kSize}}};
+        request.pools = {token->get()};
+    }
+
+    const std::shared_ptr<BufferTracker> tracker;
+    const std::shared_ptr<ManagedBuffer> buffer;
+    const std::unique_ptr<BufferTracker::Token> token;
+    Request request;
+};
+
+const SharedBuffer& getSharedBuffer() {
+    static const SharedBuffer sharedBuffer;
+    return sharedBuffer;
+}
+
+// Each iteration looks up the shared buffer and validates the request against it, as the sample
+// driver does before every execution.
+// Arguments: whether every iteration also allocates and frees a token of its own, as executions
+// allocating their own device memories do.
+void BM_GetAndValidateRequest(benchmark::State& state) {
+    const SharedBuffer& shared = getSharedBuffer();
+    const bool churn = state.range(0) != 0;
+    const Operand smallOperand = {.type = OperandType::TENSOR_FLOAT32, .dimensions = {4}};
+    const auto token = std::get<Request::MemoryDomainToken>(shared.request.pools[0]);
+    for (auto _ : state) {
+        if (churn) {
+            const auto ownToken = shared.tracker->add(ManagedBuffer::create(16, {}, smallOperand));
+            benchmark::DoNotOptimize(ownToken);
+        }
+        const auto buffer = shared.tracker->get(token);
+        if (buffer == nullptr ||
+            buffer->validateRequest(0, shared.request, nullptr) != ErrorStatus::NONE) {
+            state.SkipWithError("Validation failed");
+            break;
+        }
+    }
+}
+
+BENCHMARK(BM_GetAndValidateRequest)
+        ->ArgName("churn")
+        ->Arg(0)
+        ->Arg(1)
+        ->ThreadRange(1, 8)
+        ->UseRealTime();
+
+// Each iteration creates a device memory and frees it, as a client allocating its memories per
+// frame does.
+// Arguments: the size of the memory in bytes, and whether the pool of freed buffers is trimmed
+// after every iteration, which measures the allocation without the pool.
+void BM_CreateAndFreeManagedBuffer(benchmark::State& state) {
+    const auto size = static_cast<uint32_t>(state.range(0));
+    const bool trim = state.range(1) != 0;
+    const Operand operand = {.type = OperandType::TENSOR_QUANT8_ASYMM, .dimensions = {size}};
+    ManagedBuffer::trimPool();
+    const PoolStatistics before = ManagedBuffer::getPoolStatistics();
+    for (auto _ : state) {
+        auto buffer = ManagedBuffer::create(size, {}, operand);
+        if (buffer == nullptr) {
+            state.SkipWithError("Allocation failed");
+            break;
+        }
+        // Touch the memory, as a client copying its contents in would.
+        benchmark::DoNotOptimize(buffer->createRunTimePoolInfo().getBuffer()[size - 1] = 1);
+        buffer.reset();
+        if (trim) {
+            ManagedBuffer::trimPool();
+        }
+    }
+    const PoolStatistics after = ManagedBuffer::getPoolStatistics();
+    const uint64_t numAcquires = after.numAcquires - before.numAcquires;
+    const uint64_t numReuses = after.numReuses - before.numReuses;
+    state.counters["reuse_ratio"] =
+            numAcquires == 0 ? 0.0 : static_cast<double>(numReuses) / numAcquires;
+}
+
+BENCHMARK(BM_CreateAndFreeManagedBuffer)
+        ->ArgNames({"bytes", "trim"})
+        ->ArgsProduct({{4 * 1024, 1024 * 1024, 8 * 1024 * 1024}, {0, 1}})
+        ->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+}  // namespace android::nn
+
+BENCHMARK_MAIN();
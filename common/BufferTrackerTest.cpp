@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "BufferTracker.h"
+#include "nnapi/Types.h"
+
+namespace android::nn {
+namespace {
+
+TEST(BufferTrackerTest, ConcurrentAddFreeAndGet) {
+    const auto tracker = BufferTracker::create();
+    const Operand operand = {.type = OperandType::TENSOR_FLOAT32, .dimensions = {4}};
+    const auto sharedBuffer = ManagedBuffer::create(16, {}, operand);
+    ASSERT_NE(sharedBuffer, nullptr);
+    const auto sharedToken = tracker->add(sharedBuffer);
+    ASSERT_NE(sharedToken, nullptr);
+
+    constexpr uint32_t kNumThreads = 4;
+    constexpr uint32_t kNumIterations = 1000;
+    std::atomic<uint32_t> maxToken = 0;
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < kNumThreads; ++i) {
+        threads.emplace_back([&] {
+            for (uint32_t j = 0; j < kNumIterations; ++j) {
+                const auto buffer = ManagedBuffer::create(16, {}, operand);
+                auto token = tracker->add(buffer);
+                ASSERT_NE(token, nullptr);
+                EXPECT_EQ(tracker->get(token->get()), buffer);
+                EXPECT_EQ(tracker->get(sharedToken->get()), sharedBuffer);
+                const auto index = static_cast<uint32_t>(token->get());
+                for (uint32_t max = maxToken; index > max;) {
+                    maxToken.compare_exchange_weak(max, index);
+                }
+                token.reset();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Every token but the shared one was freed, and they were reused.
+    EXPECT_LE(maxToken, kNumThreads + 1);
+    for (uint32_t token = 0; token <= maxToken; ++token) {
+        if (token == static_cast<uint32_t>(sharedToken->get())) continue;
+        EXPECT_EQ(tracker->get(static_cast<Request::MemoryDomainToken>(token)), nullptr);
+    }
+    EXPECT_EQ(tracker->get(sharedToken->get()), sharedBuffer);
+}
+
+TEST(ManagedBufferTest, InitializedStateAndFixedDimensions) {
+    const Operand operand = {.type = OperandType::TENSOR_FLOAT32, .dimensions = {4}};
+    const auto buffer = ManagedBuffer::create(16, {}, operand);
+    ASSERT_NE(buffer, nullptr);
+    EXPECT_EQ(buffer->validateCopyTo(16), ErrorStatus::GENERAL_FAILURE);
+    buffer->setInitialized(true);
+    EXPECT_EQ(buffer->validateCopyTo(16), ErrorStatus::NONE);
+    EXPECT_TRUE(buffer->updateDimensions({4}));
+    EXPECT_TRUE(buffer->updateDimensions({}));
+    EXPECT_FALSE(buffer->updateDimensions({2}));
+}
+
+TEST(ManagedBufferTest, BuffersAreReusedFromPool) {
+    ManagedBuffer::trimPool();
+    const Operand operand = {.type = OperandType::TENSOR_FLOAT32, .dimensions = {100}};
+    const uint64_t numReuses = ManagedBuffer::getPoolStatistics().numReuses;
+    ManagedBuffer::create(400, {}, operand).reset();
+    // 390 bytes are in the same size class as 400 bytes.
+    const auto buffer = ManagedBuffer::create(390, {}, operand);
+    ASSERT_NE(buffer, nullptr);
+    EXPECT_EQ(ManagedBuffer::getPoolStatistics().numReuses, numReuses + 1);
+    EXPECT_EQ(buffer->validateCopyTo(390), ErrorStatus::GENERAL_FAILURE);
+    EXPECT_EQ(buffer->validateCopyFrom({}, 390), ErrorStatus::NONE);
+}
+
+}  // namespace
+}  // namespace android::nn
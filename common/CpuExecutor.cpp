@@ -22,12 +22,18 @@
 #include <nnapi/SharedMemory.h>
 #include <nnapi/TypeUtils.h>
 
+#include <array>
+#include <iomanip>
 #include <limits>
 #include <memory>
+#include <sstream>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "ControlFlow.h"
+#include "CpuInternalOperations.h"
+#include "CpuParallelFor.h"
 #include "NeuralNetworks.h"
 #include "OperationResolver.h"
 #include "Operations.h"
@@ -66,18 +72,21 @@ class OperationExecutionContext : public IOperationExecutionContext {
     DISALLOW_IMPLICIT_CONSTRUCTORS(OperationExecutionContext);
 
    public:
-    OperationExecutionContext(const Operation* operation, RunTimeOperandInfo* operands)
-        : operation(operation), operands(operands) {}
+    OperationExecutionContext(const Operation* operation, RunTimeOperandInfo* operands,
+                              ScratchWorkspace* scratchWorkspace)
+        : operation(operation), operands(operands), scratchWorkspace(scratchWorkspace) {}
 
     uint32_t getNumInputs() const override;
     OperandType getInputType(uint32_t index) const override;
     Shape getInputShape(uint32_t index) const override;
+    ShapeView getInputShapeView(uint32_t index) const override;
     const void* getInputBuffer(uint32_t index) const override;
     const Operand::ExtraParams& getInputExtraParams(uint32_t index) const override;
 
     uint32_t getNumOutputs() const override;
     OperandType getOutputType(uint32_t index) const override;
     Shape getOutputShape(uint32_t index) const override;
+    ShapeView getOutputShapeView(uint32_t index) const override;
     void* getOutputBuffer(uint32_t index) override;
 
     // Return false on failure and store the result code.
@@ -88,6 +97,8 @@ class OperationExecutionContext : public IOperationExecutionContext {
     bool isOmittedInput(uint32_t index) const override;
     bool isOmittedOutput(uint32_t index) const override;
 
+    ScratchWorkspace* getScratchWorkspace() override;
+
     // Return false if any of inputs or outputs is omitted, i.e. has lifetime of NO_VALUE.
     bool checkNoOmittedOperand() const;
     // Return false if any of inputs has dimension 0.
@@ -100,6 +111,7 @@ class OperationExecutionContext : public IOperationExecutionContext {
 
     const Operation* operation;
     RunTimeOperandInfo* operands;
+    ScratchWorkspace* scratchWorkspace;
 
     int result = ANEURALNETWORKS_NO_ERROR;
 };
@@ -127,6 +139,10 @@ Shape OperationExecutionContext::getInputShape(uint32_t index) const {
     return getInputInfo(index)->shape();
 }
 
+ShapeView OperationExecutionContext::getInputShapeView(uint32_t index) const {
+    return getInputInfo(index)->shapeView();
+}
+
 const void* OperationExecutionContext::getInputBuffer(uint32_t index) const {
     return getInputInfo(index)->buffer;
 }
@@ -143,6 +159,10 @@ Shape OperationExecutionContext::getOutputShape(uint32_t index) const {
     return getOutputInfo(index)->shape();
 }
 
+ShapeView OperationExecutionContext::getOutputShapeView(uint32_t index) const {
+    return getOutputInfo(index)->shapeView();
+}
+
 void* OperationExecutionContext::getOutputBuffer(uint32_t index) {
     return getOutputInfo(index)->buffer;
 }
@@ -212,7 +232,8 @@ bool setInfoAndAllocateIfNeeded(RunTimeOperandInfo* info, const Shape& shape, in
         return false;
     }
 
-    // Allocate the buffer only if the combined dimension is fully specified
+    // Allocate the buffer only if the combined dimension is fully specified, reusing the spare
+    // buffer if it is large enough.
     if (info->buffer == nullptr && (info->lifetime == Operand::LifeTime::TEMPORARY_VARIABLE ||
                                     info->lifetime == Operand::LifeTime::SUBGRAPH_OUTPUT)) {
         if (isExtension(info->type)) {
@@ -221,7 +242,12 @@ bool setInfoAndAllocateIfNeeded(RunTimeOperandInfo* info, const Shape& shape, in
             return false;
         }
         uint32_t length = nonExtensionOperandSizeOfData(info->type, info->dimensions);
-        if (length > 0) {
+        if (length > 0 && info->spareBuffer != nullptr && info->spareLength >= length) {
+            info->buffer = std::exchange(info->spareBuffer, nullptr);
+            info->length = std::exchange(info->spareLength, 0);
+        } else if (length > 0) {
+            delete[] std::exchange(info->spareBuffer, nullptr);
+            info->spareLength = 0;
             info->buffer = new uint8_t[length];
             if (info->buffer == nullptr) {
                 *result = ANEURALNETWORKS_OUT_OF_MEMORY;
@@ -253,6 +279,10 @@ bool OperationExecutionContext::isOmittedOutput(uint32_t index) const {
     return getOutputInfo(index)->lifetime == Operand::LifeTime::NO_VALUE;
 }
 
+ScratchWorkspace* OperationExecutionContext::getScratchWorkspace() {
+    return scratchWorkspace;
+}
+
 bool OperationExecutionContext::checkNoOmittedOperand() const {
     for (uint32_t i = 0; i < operation->inputs.size(); i++) {
         NN_RET_CHECK(!isOmittedInput(i))
@@ -279,6 +309,19 @@ bool OperationExecutionContext::checkNoZeroSizedInput() const {
 
 }  // namespace
 
+const OperationRegistration* findCpuInternalOperation([[maybe_unused]] OperationType type) {
+#ifdef NN_INCLUDE_CPU_IMPLEMENTATION
+    static const OperationRegistration kFullyConnectedSparse(
+            kOperationFullyConnectedSparse, fully_connected_sparse::kOperationName,
+            /*validate=*/nullptr, fully_connected_sparse::prepare, fully_connected_sparse::execute,
+            {});
+    if (type == kOperationFullyConnectedSparse) {
+        return &kFullyConnectedSparse;
+    }
+#endif  // NN_INCLUDE_CPU_IMPLEMENTATION
+    return nullptr;
+}
+
 // Used to keep a pointer to a memory pool.
 //
 // In the case of an "mmap_fd" pool, owns the mmap region
@@ -553,8 +596,67 @@ static void freeUnusedSubgraphOperands(std::vector<RunTimeOperandInfo>* operands
     }
 }
 
+// Keeps the buffers of the TEMPORARY_VARIABLE operands of a subgraph that a WHILE loop executes
+// repeatedly from one iteration to the next, instead of freeing them after their last use in
+// each iteration. freeUnusedSubgraphOperands frees them after the loop. Returns the indexes of
+// the temporaries whose size is only known at execution time, which resetLoopOperands prepares
+// for each iteration.
+static std::vector<uint32_t> retainLoopTemporaries(const Model::Subgraph& subgraph,
+                                                   RunTimeOperandInfo* operands) {
+    std::vector<uint32_t> dynamicTemporaries;
+    for (uint32_t i = 0, n = subgraph.operands.size(); i < n; ++i) {
+        const Operand& operand = subgraph.operands[i];
+        if (operand.lifetime != Operand::LifeTime::TEMPORARY_VARIABLE) {
+            continue;
+        }
+        operands[i].numberOfUsesLeft = 0;
+        if (!isExtension(operand.type) && nonExtensionOperandSizeOfData(operand) == 0) {
+            dynamicTemporaries.push_back(i);
+        }
+    }
+    return dynamicTemporaries;
+}
+
+// Resets the dimensions of operands whose size may change between iterations of a WHILE loop to
+// those of the model, and turns their buffers into spare buffers, so that the next iteration
+// reuses them if they are large enough.
+static void resetLoopOperands(const Model::Subgraph& subgraph, const std::vector<uint32_t>& indexes,
+                              RunTimeOperandInfo* operands) {
+    for (uint32_t i : indexes) {
+        RunTimeOperandInfo& info = operands[i];
+        info.dimensions = subgraph.operands[i].dimensions;
+        info.spareBuffer = std::exchange(info.buffer, nullptr);
+        info.spareLength = std::exchange(info.length, 0);
+    }
+}
+
+// Frees the spare buffers of the operands listed that were not reused.
+static void freeSpareBuffers(const std::vector<uint32_t>& indexes, RunTimeOperandInfo* operands) {
+    for (uint32_t i : indexes) {
+        RunTimeOperandInfo& info = operands[i];
+        delete[] std::exchange(info.spareBuffer, nullptr);
+        info.spareLength = 0;
+    }
+}
+
 // Ignore the .pools entry in model and request.  This will have been taken care of
 // by the caller.
+std::unique_ptr<ScratchWorkspace> ScratchWorkspacePool::acquire() {
+    std::lock_guard<std::mutex> guard(mMutex);
+    if (mWorkspaces.empty()) {
+        return std::make_unique<ScratchWorkspace>();
+    }
+    std::unique_ptr<ScratchWorkspace> workspace = std::move(mWorkspaces.back());
+    mWorkspaces.pop_back();
+    return workspace;
+}
+
+void ScratchWorkspacePool::release(std::unique_ptr<ScratchWorkspace> workspace) {
+    CHECK(workspace != nullptr);
+    std::lock_guard<std::mutex> guard(mMutex);
+    mWorkspaces.push_back(std::move(workspace));
+}
+
 int CpuExecutor::run(const Model& model, const Request& request,
                      const std::vector<RunTimePoolInfo>& modelPoolInfos,
                      const std::vector<RunTimePoolInfo>& requestPoolInfos) {
@@ -563,12 +665,28 @@ int CpuExecutor::run(const Model& model, const Request& request,
     mModelOperandValues = model.operandValues.data();
     mModelPoolInfos = &modelPoolInfos;
     mReferencedSubgraphs = &model.referenced;
+    mOperationProfiles.clear();
+    mNumUnprofiledOperations = 0;
+    if (mProfiling) {
+        mOperationProfiles.reserve(std::min(model.main.operations.size(), mMaxOperationProfiles));
+        mProfilingStart = Clock::now();
+        mProfilingDepth = 0;
+    }
 
     // b/109953668, disable OpenMP
 #ifdef NNAPI_OPENMP
     ScopedOpenmpSettings openMpSettings;
 #endif  // NNAPI_OPENMP
 
+    // Operations split across threads stop scheduling work once the deadline has passed.
+    ScopedCpuDeadline cpuDeadline(mDeadline);
+
+    if (mScratchWorkspacePool != nullptr) {
+        mScratchWorkspace = mScratchWorkspacePool->acquire();
+    } else if (mScratchWorkspace == nullptr) {
+        mScratchWorkspace = std::make_unique<ScratchWorkspace>();
+    }
+
     std::vector<RunTimeOperandInfo> operands = initializeRunTimeInfo(model.main);
     updateForArguments(model.main.inputIndexes, request.inputs, requestPoolInfos, operands.data());
     updateForArguments(model.main.outputIndexes, request.outputs, requestPoolInfos,
@@ -590,10 +708,15 @@ int CpuExecutor::run(const Model& model, const Request& request,
         mOutputShapes.clear();
     }
 
+    if (mScratchWorkspacePool != nullptr) {
+        mScratchWorkspacePool->release(std::move(mScratchWorkspace));
+    }
+
     mFinished = true;
     mModelOperandValues = nullptr;
     mModelPoolInfos = nullptr;
     mReferencedSubgraphs = nullptr;
+    mLoopSubgraphInfos.clear();
     return result;
 }
 
@@ -601,11 +724,115 @@ int CpuExecutor::executeSubgraph(const Model::Subgraph& subgraph, RunTimeOperand
     VLOG(CPUEXE) << "CpuExecutor::executeSubgraph " << subgraph;
     // The graph has serialized the operation in execution order.
     for (const auto& operation : subgraph.operations) {
-        NN_RETURN_IF_ERROR(executeOperation(operation, operands));
+        NN_RETURN_IF_ERROR(mProfiling ? executeOperationWithProfiling(operation, operands)
+                                      : executeOperation(operation, operands));
     }
     return ANEURALNETWORKS_NO_ERROR;
 }
 
+static OperationProfile::Operand makeOperandProfile(const RunTimeOperandInfo& info) {
+    return {.type = info.type, .dimensions = info.dimensions, .isOmitted = IsNullInput(&info)};
+}
+
+static uint64_t getProfiledSize(const RunTimeOperandInfo& info) {
+    if (IsNullInput(&info)) {
+        return 0;
+    }
+    // The sizes of extension types are unknown, so the length of the buffer is used instead.
+    if (isExtension(info.type)) {
+        return info.length;
+    }
+    return nonExtensionOperandSizeOfData(info.type, info.dimensions);
+}
+
+int CpuExecutor::executeOperationWithProfiling(const Operation& operation,
+                                               RunTimeOperandInfo* operands) {
+    if (mOperationProfiles.size() >= mMaxOperationProfiles) {
+        ++mNumUnprofiledOperations;
+        return executeOperation(operation, operands);
+    }
+
+    // The profile is referred to by index, as the operations of control flow subgraphs add theirs
+    // while this one is executed.
+    const size_t index = mOperationProfiles.size();
+    mOperationProfiles.push_back({.type = operation.type, .depth = mProfilingDepth});
+
+    // An output buffer that is set by the operation and is not the spare buffer of the output was
+    // allocated for it.
+    std::vector<std::pair<const uint8_t*, const uint8_t*>> outputBuffers;
+    outputBuffers.reserve(operation.outputs.size());
+    for (uint32_t i : operation.outputs) {
+        outputBuffers.emplace_back(operands[i].buffer, operands[i].spareBuffer);
+    }
+    const size_t numScratchAllocations = mScratchWorkspace->getNumAllocations();
+
+    const TimePoint start = Clock::now();
+    ++mProfilingDepth;
+    const int result = executeOperation(operation, operands);
+    --mProfilingDepth;
+    const TimePoint end = Clock::now();
+
+    OperationProfile& profile = mOperationProfiles[index];
+    profile.startTime = start - mProfilingStart;
+    profile.duration = end - start;
+    profile.numAllocations =
+            static_cast<uint32_t>(mScratchWorkspace->getNumAllocations() - numScratchAllocations);
+    profile.inputs.reserve(operation.inputs.size());
+    for (uint32_t i : operation.inputs) {
+        profile.inputs.push_back(makeOperandProfile(operands[i]));
+        profile.bytesRead += getProfiledSize(operands[i]);
+    }
+    profile.outputs.reserve(operation.outputs.size());
+    for (size_t i = 0; i < operation.outputs.size(); ++i) {
+        const RunTimeOperandInfo& info = operands[operation.outputs[i]];
+        profile.outputs.push_back(makeOperandProfile(info));
+        profile.bytesWritten += getProfiledSize(info);
+        const auto [previousBuffer, previousSpareBuffer] = outputBuffers[i];
+        if (previousBuffer == nullptr && info.buffer != nullptr &&
+            info.buffer != previousSpareBuffer) {
+            ++profile.numAllocations;
+        }
+    }
+    return result;
+}
+
+static void printProfiledOperands(std::ostream& os,
+                                  const std::vector<OperationProfile::Operand>& operands) {
+    for (size_t i = 0; i < operands.size(); ++i) {
+        os << (i > 0 ? ", " : "");
+        if (operands[i].isOmitted) {
+            os << "omitted";
+            continue;
+        }
+        os << operands[i].type << "[";
+        for (size_t j = 0; j < operands[i].dimensions.size(); ++j) {
+            os << (j > 0 ? "," : "") << operands[i].dimensions[j];
+        }
+        os << "]";
+    }
+}
+
+std::string toChromeTrace(const std::vector<OperationProfile>& profiles) {
+    using Microseconds = std::chrono::duration<double, std::micro>;
+    std::ostringstream os;
+    os << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        const OperationProfile& profile = profiles[i];
+        os << (i > 0 ? ",\n" : "\n") << "{\"name\":\"" << profile.type
+           << "\",\"cat\":\"operation\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":"
+           << Microseconds(profile.startTime).count()
+           << ",\"dur\":" << Microseconds(profile.duration).count() << ",\"args\":{\"inputs\":\"";
+        printProfiledOperands(os, profile.inputs);
+        os << "\",\"outputs\":\"";
+        printProfiledOperands(os, profile.outputs);
+        os << "\",\"bytes_read\":" << profile.bytesRead
+           << ",\"bytes_written\":" << profile.bytesWritten
+           << ",\"allocations\":" << profile.numAllocations << "}}";
+    }
+    os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    return os.str();
+}
+
 std::vector<RunTimeOperandInfo> CpuExecutor::initializeRunTimeInfo(
         const Model::Subgraph& subgraph) {
     VLOG(CPUEXE) << "CpuExecutor::initializeRunTimeInfo";
@@ -804,7 +1031,7 @@ int CpuExecutor::executeOperation([[maybe_unused]] const Operation& operation,
 
             success = reshapePrepare(input.shape(),
                                      reinterpret_cast<const int32_t*>(targetShape.buffer),
-                                     getNumberOfElements(targetShape.shape()), &outShape) &&
+                                     getNumberOfElements(targetShape.shapeView()), &outShape) &&
                       setInfoAndAllocateIfNeeded(&output, outShape, &result) &&
                       copyData(input.buffer, input.shape(), output.buffer, outShape);
         } break;
@@ -1647,14 +1874,17 @@ int CpuExecutor::executeOperation([[maybe_unused]] const Operation& operation,
         } break;
         default: {
             const OperationRegistration* operationRegistration =
-                    mOperationResolver->findOperation(operation.type);
+                    findCpuInternalOperation(operation.type);
+            if (operationRegistration == nullptr) {
+                operationRegistration = mOperationResolver->findOperation(operation.type);
+            }
             if (operationRegistration == nullptr) {
                 LOG(ERROR) << operation.type << " not registered";
             } else if (operationRegistration->prepare == nullptr ||
                        operationRegistration->execute == nullptr) {
                 LOG(ERROR) << "Incomplete operation registration: " << operation.type;
             } else {
-                OperationExecutionContext context(&operation, operands);
+                OperationExecutionContext context(&operation, operands, mScratchWorkspace.get());
                 success = operationRegistration->flags.allowOmittedOperand ||
                           context.checkNoOmittedOperand();
                 success = success && (operationRegistration->flags.allowZeroSizedInput ||
@@ -1666,13 +1896,16 @@ int CpuExecutor::executeOperation([[maybe_unused]] const Operation& operation,
         }
     }
     if (!success && result == ANEURALNETWORKS_NO_ERROR) {
-        result = ANEURALNETWORKS_OP_FAILED;
+        // The operation may have been cut short by parallelFor.
+        result = hasDeadlinePassed(mDeadline) ? ANEURALNETWORKS_MISSED_DEADLINE_TRANSIENT
+                                              : ANEURALNETWORKS_OP_FAILED;
     }
     if (result != ANEURALNETWORKS_NO_ERROR) {
         LOG(ERROR) << operation.type << " failed.";
     }
 
     consumeOperationInputs(ins, operands);
+    mScratchWorkspace->reset();
     return result;
 #else
     LOG(ERROR) << "Built without CPU execution support";
@@ -1681,13 +1914,18 @@ int CpuExecutor::executeOperation([[maybe_unused]] const Operation& operation,
 }
 
 // Copies RunTimeOperandInfo, preserving the original lifetime and numberOfUsesLeft
-// to prevent deallocation of subgraph inputs and outputs.
+// to prevent deallocation of subgraph inputs and outputs. The spare buffer is also
+// preserved, as it belongs to the operand it was set on.
 static void setInfoExceptLifetime(RunTimeOperandInfo* to, const RunTimeOperandInfo& from) {
     auto originalLifetime = to->lifetime;
     auto originalNumberOfUsesLeft = to->numberOfUsesLeft;
+    auto originalSpareBuffer = to->spareBuffer;
+    auto originalSpareLength = to->spareLength;
     *to = from;
     to->lifetime = originalLifetime;
     to->numberOfUsesLeft = originalNumberOfUsesLeft;
+    to->spareBuffer = originalSpareBuffer;
+    to->spareLength = originalSpareLength;
 }
 
 int CpuExecutor::executeIfOperation(const Operation& operation, RunTimeOperandInfo* operands) {
@@ -1737,45 +1975,81 @@ int CpuExecutor::executeWhileOperation(const Operation& operation, RunTimeOperan
             *reinterpret_cast<const Model::Subgraph*>(condModelOperand.buffer);
     const Model::Subgraph& bodySubgraph =
             *reinterpret_cast<const Model::Subgraph*>(bodyModelOperand.buffer);
-    std::vector<RunTimeOperandInfo> condOperands = initializeRunTimeInfo(condSubgraph);
-    std::vector<RunTimeOperandInfo> bodyOperands = initializeRunTimeInfo(bodySubgraph);
+    // The runtime info of the subgraphs is prepared once per run(), so that loops nested in other
+    // loops do not prepare it again on every iteration of the outer loop.
+    std::unique_ptr<LoopSubgraphInfo> condInfo = acquireLoopSubgraphInfo(condSubgraph);
+    std::unique_ptr<LoopSubgraphInfo> bodyInfo = acquireLoopSubgraphInfo(bodySubgraph);
+    std::vector<RunTimeOperandInfo>& condOperands = condInfo->operands;
+    std::vector<RunTimeOperandInfo>& bodyOperands = bodyInfo->operands;
+
+    // Temporaries are allocated by the first iteration and reused by the following ones. Those of
+    // unknown size are reset before each iteration, and only reallocated when they grow.
+    const std::vector<uint32_t>& condDynamicTemporaries = condInfo->dynamicTemporaries;
+    const std::vector<uint32_t>& bodyDynamicTemporaries = bodyInfo->dynamicTemporaries;
 
     // The code below implements the following sequence of subgraph input and output buffer
     // assignments:
-    // iteration = 0   cond inputs = body inputs = outer inputs   body outputs = tmp1
-    // iteration = 1   cond inputs = body inputs = tmp1           body outputs = tmp2
-    // iteration = 2   cond inputs = body inputs = tmp2           body outputs = tmp1
+    // iteration = 0   cond inputs = body inputs = outer inputs   body outputs = buffers[0]
+    // iteration = 1   cond inputs = body inputs = buffers[0]     body outputs = buffers[1]
+    // iteration = 2   cond inputs = body inputs = buffers[1]     body outputs = buffers[0]
     // iteration = 3   cond inputs = body inputs = ...            body outputs = ...
-
-    // For body output double buffering.
-    std::vector<uint8_t*> tmp1(bodySubgraph.outputIndexes.size());
-    std::vector<uint8_t*> tmp2(bodySubgraph.outputIndexes.size());
+    //
+    // For body outputs of known shape, buffers[0] is the outer output, so that no copy is needed
+    // when the loop ends after an odd number of iterations. Body outputs of unknown shape can
+    // change size between iterations, so each iteration offers the buffer of the iteration before
+    // the previous one as a spare buffer, which is only reallocated if the output has grown.
+    struct LoopOutputBuffer {
+        uint8_t* buffer = nullptr;
+        uint32_t length = 0;
+        bool isOwned = true;
+    };
+    const uint32_t numOutputs = bodySubgraph.outputIndexes.size();
+    std::vector<std::array<LoopOutputBuffer, 2>> outputBuffers(numOutputs);
+    // Outer outputs allocated for the loop, which are freed again if it fails.
+    std::vector<uint32_t> allocatedOuterOutputs;
 
     // Ensure objects are freed
-    auto cleanupGuard = base::make_scope_guard(
-            [&tmp1, &tmp2, &condOperands, &bodyOperands, &operation, &operands] {
-                auto freeLoopOutputs = [](const std::vector<uint8_t*>& tmp) {
-                    for (auto buffer : tmp) {
-                        if (buffer != nullptr) {
-                            delete[] buffer;
-                        }
-                    }
-                };
+    auto cleanupGuard = base::make_scope_guard([&] {
+        for (const auto& buffers : outputBuffers) {
+            for (const LoopOutputBuffer& output : buffers) {
+                if (output.isOwned) {
+                    delete[] output.buffer;
+                }
+            }
+        }
+        freeSpareBuffers(condDynamicTemporaries, condOperands.data());
+        freeSpareBuffers(bodyDynamicTemporaries, bodyOperands.data());
+        freeSpareBuffers(bodySubgraph.outputIndexes, bodyOperands.data());
+        freeUnusedSubgraphOperands(&condOperands);
+        freeUnusedSubgraphOperands(&bodyOperands);
+        releaseLoopSubgraphInfo(condSubgraph, std::move(condInfo));
+        releaseLoopSubgraphInfo(bodySubgraph, std::move(bodyInfo));
+        for (uint32_t index : allocatedOuterOutputs) {
+            delete[] std::exchange(operands[index].buffer, nullptr);
+            operands[index].length = 0;
+        }
+        consumeOperationInputs(operation.inputs, operands);
+    });
 
-                freeLoopOutputs(tmp1);
-                freeLoopOutputs(tmp2);
-                freeUnusedSubgraphOperands(&condOperands);
-                freeUnusedSubgraphOperands(&bodyOperands);
-                consumeOperationInputs(operation.inputs, operands);
-            });
-
-    // For body outputs with unknown shape, we skip double buffering and
-    // allocate on each iteration instead. This allows growing output tensors
-    // inside a WHILE loop.
-    std::vector<bool> bodyOutputHasUnknownShape(bodySubgraph.outputIndexes.size());
-    for (uint32_t i = 0, n = bodySubgraph.outputIndexes.size(); i < n; ++i) {
+    std::vector<bool> bodyOutputHasUnknownShape(numOutputs);
+    for (uint32_t i = 0; i < numOutputs; ++i) {
         const Operand& operand = bodySubgraph.operands[bodySubgraph.outputIndexes[i]];
         bodyOutputHasUnknownShape[i] = nonExtensionOperandSizeOfData(operand) == 0;
+        // Body outputs past the outer outputs only carry state between iterations.
+        if (bodyOutputHasUnknownShape[i] || i >= operation.outputs.size()) {
+            continue;
+        }
+        RunTimeOperandInfo& outerOperand = operands[operation.outputs[i]];
+        const Shape shape = bodyOperands[bodySubgraph.outputIndexes[i]].shape();
+        const bool hadBuffer = outerOperand.buffer != nullptr;
+        if (int error; !setInfoAndAllocateIfNeeded(&outerOperand, shape, &error)) {
+            return error;
+        }
+        if (!hadBuffer) {
+            allocatedOuterOutputs.push_back(operation.outputs[i]);
+        }
+        outputBuffers[i][0] = {
+                .buffer = outerOperand.buffer, .length = outerOperand.length, .isOwned = false};
     }
 
     // Initialize condition inputs from outer operands.
@@ -1796,12 +2070,14 @@ int CpuExecutor::executeWhileOperation(const Operation& operation, RunTimeOperan
         VLOG(CPUEXE) << "CpuExecutor::executeWhileOperation: iteration " << iteration;
         if (iteration != 0) {
             // Set condition inputs from previous iteration outputs.
-            for (uint32_t i = 0, n = bodySubgraph.outputIndexes.size(); i < n; ++i) {
+            for (uint32_t i = 0; i < numOutputs; ++i) {
                 setInfoExceptLifetime(&condOperands[condSubgraph.inputIndexes[i]],
                                       bodyOperands[bodySubgraph.outputIndexes[i]]);
             }
         }
+        resetLoopOperands(condSubgraph, condDynamicTemporaries, condOperands.data());
         NN_RETURN_IF_ERROR(executeSubgraph(condSubgraph, condOperands.data()));
+        freeSpareBuffers(condDynamicTemporaries, condOperands.data());
         VLOG(CPUEXE) << "CpuExecutor::executeWhileOperation: condition value: "
                      << static_cast<int>(condValue);
         if (!condValue) {
@@ -1821,43 +2097,79 @@ int CpuExecutor::executeWhileOperation(const Operation& operation, RunTimeOperan
             bodyOperands[bodySubgraph.inputIndexes[i]] = condOperands[condSubgraph.inputIndexes[i]];
         }
         // Set body outputs.
-        auto& outputBuffer = iteration % 2 == 0 ? tmp1 : tmp2;
-        for (uint32_t i = 0, n = bodySubgraph.outputIndexes.size(); i < n; ++i) {
+        const uint32_t parity = iteration % 2;
+        for (uint32_t i = 0; i < numOutputs; ++i) {
             RunTimeOperandInfo& info = bodyOperands[bodySubgraph.outputIndexes[i]];
+            LoopOutputBuffer& output = outputBuffers[i][parity];
             if (bodyOutputHasUnknownShape[i]) {
-                // Reset dimensions and buffer.
                 info.dimensions = bodySubgraph.operands[bodySubgraph.outputIndexes[i]].dimensions;
-                if (outputBuffer[i] != nullptr) {
-                    delete[] outputBuffer[i];
-                    outputBuffer[i] = nullptr;
-                }
+                info.buffer = nullptr;
+                info.length = 0;
+                info.spareBuffer = std::exchange(output.buffer, nullptr);
+                info.spareLength = std::exchange(output.length, 0);
+            } else {
+                info.buffer = output.buffer;
+                info.length = output.length;
             }
-            info.buffer = outputBuffer[i];
         }
+        resetLoopOperands(bodySubgraph, bodyDynamicTemporaries, bodyOperands.data());
 
-        NN_RETURN_IF_ERROR(executeSubgraph(bodySubgraph, bodyOperands.data()));
+        const int result = executeSubgraph(bodySubgraph, bodyOperands.data());
 
-        // Update output buffer information in case we have allocated new buffers.
-        for (uint32_t i = 0, n = bodySubgraph.outputIndexes.size(); i < n; ++i) {
-            outputBuffer[i] = bodyOperands[bodySubgraph.outputIndexes[i]].buffer;
+        // Update output buffer information in case we have allocated new buffers, even if the
+        // iteration failed, so that they are freed.
+        for (uint32_t i = 0; i < numOutputs; ++i) {
+            const RunTimeOperandInfo& info = bodyOperands[bodySubgraph.outputIndexes[i]];
+            LoopOutputBuffer& output = outputBuffers[i][parity];
+            output.buffer = info.buffer;
+            output.length = info.length;
         }
+        freeSpareBuffers(bodySubgraph.outputIndexes, bodyOperands.data());
+        freeSpareBuffers(bodyDynamicTemporaries, bodyOperands.data());
+        NN_RETURN_IF_ERROR(result);
     }
 
-    // Copy body outputs to outer outputs.
+    // Copy body outputs to outer outputs, unless the last iteration wrote them there already.
     for (uint32_t i = 0, n = operation.outputs.size(); i < n; ++i) {
         RunTimeOperandInfo& outerOperand = operands[operation.outputs[i]];
         RunTimeOperandInfo& innerOperand = condOperands[condSubgraph.inputIndexes[i]];
         if (int error; !setInfoAndAllocateIfNeeded(&outerOperand, innerOperand.shape(), &error)) {
             return error;
         }
-        CHECK_EQ(outerOperand.length, innerOperand.length);
-        // TODO: Use the outer buffer as tmp1 to avoid copies.
-        std::memcpy(outerOperand.buffer, innerOperand.buffer, innerOperand.length);
+        if (outerOperand.buffer != innerOperand.buffer) {
+            std::memcpy(outerOperand.buffer, innerOperand.buffer,
+                        nonExtensionOperandSizeOfData(innerOperand.type, innerOperand.dimensions));
+        }
     }
 
+    allocatedOuterOutputs.clear();
     return ANEURALNETWORKS_NO_ERROR;
 }
 
+std::unique_ptr<CpuExecutor::LoopSubgraphInfo> CpuExecutor::acquireLoopSubgraphInfo(
+        const Model::Subgraph& subgraph) {
+    std::unique_ptr<LoopSubgraphInfo>& prepared = mLoopSubgraphInfos[&subgraph];
+    if (prepared != nullptr) {
+        return std::move(prepared);
+    }
+    auto info = std::make_unique<LoopSubgraphInfo>();
+    info->operands = initializeRunTimeInfo(subgraph);
+    info->dynamicTemporaries = retainLoopTemporaries(subgraph, info->operands.data());
+    return info;
+}
+
+void CpuExecutor::releaseLoopSubgraphInfo(const Model::Subgraph& subgraph,
+                                          std::unique_ptr<LoopSubgraphInfo> info) {
+    // The inputs and outputs refer to buffers of the loop that has ended.
+    for (const auto* indexes : {&subgraph.inputIndexes, &subgraph.outputIndexes}) {
+        for (uint32_t i : *indexes) {
+            info->operands[i].buffer = nullptr;
+            info->operands[i].length = 0;
+        }
+    }
+    mLoopSubgraphInfos[&subgraph] = std::move(info);
+}
+
 void CpuExecutor::setOutputShapes(const std::vector<uint32_t>& outputIndexes,
                                   const std::vector<RunTimeOperandInfo>& operands) {
     mOutputShapes.resize(outputIndexes.size());
@@ -0,0 +1,1081 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "CpuOperationFusion"
+
+#include "CpuOperationFusion.h"
+
+#include <android-base/logging.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "CpuExecutor.h"
+#include "CpuInternalOperations.h"
+#include "FullyConnected.h"
+#include "LegacyUtils.h"
+#include "ModelUtils.h"
+#include "NeuralNetworks.h"
+#include "OperationsExecutionUtils.h"
+#include "nnapi/SharedMemory.h"
+#include "nnapi/TypeUtils.h"
+#include "nnapi/Types.h"
+
+namespace android::nn {
+namespace {
+
+constexpr uint32_t kNoProducer = std::numeric_limits<uint32_t>::max();
+
+// Returns the value of a scalar or small tensor operand whose value is stored in the model.
+template <typename T>
+std::optional<std::vector<T>> getConstantValues(const Model& model, uint32_t operandIndex) {
+    const Operand& op = model.main.operands[operandIndex];
+    if (op.lifetime != Operand::LifeTime::CONSTANT_COPY) {
+        return std::nullopt;
+    }
+    const uint32_t length = op.location.length;
+    if (length % sizeof(T) != 0 || op.location.offset + length > model.operandValues.size()) {
+        return std::nullopt;
+    }
+    std::vector<T> values(length / sizeof(T));
+    std::memcpy(values.data(), model.operandValues.data() + op.location.offset, length);
+    return values;
+}
+
+// Appends a new CONSTANT_COPY operand to the main subgraph and returns its index.
+uint32_t addConstantOperand(Model* model, OperandType type, std::vector<uint32_t> dimensions,
+                            const void* data, size_t length) {
+    Operand op = {
+            .type = type,
+            .dimensions = std::move(dimensions),
+            .lifetime = Operand::LifeTime::CONSTANT_COPY,
+            .location = model->operandValues.append(static_cast<const uint8_t*>(data), length),
+    };
+    model->main.operands.push_back(std::move(op));
+    return model->main.operands.size() - 1;
+}
+
+// Tracks the producer and the number of consumers of each operand of the main subgraph while
+// operations are being rewritten.
+class FusionState {
+   public:
+    explicit FusionState(Model* model) : mModel(model) {
+        const Model::Subgraph& main = model->main;
+        mProducers.resize(main.operands.size(), kNoProducer);
+        mNumberOfConsumers = countNumberOfConsumers(main.operands.size(), main.operations).value();
+        mRemoved.resize(main.operations.size(), false);
+        for (uint32_t i = 0; i < main.operations.size(); ++i) {
+            for (uint32_t output : main.operations[i].outputs) {
+                mProducers[output] = i;
+            }
+        }
+    }
+
+    const Operand& operand(uint32_t index) const { return mModel->main.operands[index]; }
+    Operation& operation(uint32_t index) { return mModel->main.operations[index]; }
+    uint32_t producer(uint32_t operandIndex) const { return mProducers[operandIndex]; }
+    bool isRemoved(uint32_t operationIndex) const { return mRemoved[operationIndex]; }
+
+    // Returns true if the operand is a temporary that is only read by a single operation, and thus
+    // can be elided when its producer and consumer are fused.
+    bool isSingleUseTemporary(uint32_t operandIndex) const {
+        return operand(operandIndex).lifetime == Operand::LifeTime::TEMPORARY_VARIABLE &&
+               mNumberOfConsumers[operandIndex] == 1 && mProducers[operandIndex] != kNoProducer;
+    }
+
+    // Returns the value of a scalar or small tensor operand whose value is known at this point.
+    template <typename T>
+    std::optional<std::vector<T>> getConstantValues(uint32_t operandIndex) const {
+        return nn::getConstantValues<T>(*mModel, operandIndex);
+    }
+
+    std::optional<int32_t> getScalarInt32(uint32_t operandIndex) const {
+        if (operand(operandIndex).type != OperandType::INT32) {
+            return std::nullopt;
+        }
+        const auto values = getConstantValues<int32_t>(operandIndex);
+        if (!values.has_value() || values->size() != 1) {
+            return std::nullopt;
+        }
+        return values->front();
+    }
+
+    // Appends a new CONSTANT_COPY INT32 scalar operand and returns its index.
+    uint32_t addScalarInt32(int32_t value) {
+        const uint32_t index =
+                addConstantOperand(mModel, OperandType::INT32, {}, &value, sizeof(value));
+        mProducers.push_back(kNoProducer);
+        mNumberOfConsumers.push_back(0);
+        return index;
+    }
+
+    // Replaces operation.inputs[inputIndex], keeping the consumer counts up to date.
+    void replaceInput(uint32_t operationIndex, uint32_t inputIndex, uint32_t operandIndex) {
+        uint32_t& input = operation(operationIndex).inputs[inputIndex];
+        mNumberOfConsumers[input]--;
+        mNumberOfConsumers[operandIndex]++;
+        input = operandIndex;
+    }
+
+    // Replaces all inputs of the operation, keeping the consumer counts up to date.
+    void setInputs(uint32_t operationIndex, std::vector<uint32_t> inputs) {
+        std::vector<uint32_t>& current = operation(operationIndex).inputs;
+        for (uint32_t input : current) {
+            mNumberOfConsumers[input]--;
+        }
+        for (uint32_t input : inputs) {
+            mNumberOfConsumers[input]++;
+        }
+        current = std::move(inputs);
+    }
+
+    // Marks the operation as removed. Its outputs are left without a producer, so the caller must
+    // make another operation write them or make sure they are no longer read.
+    void removeOperation(uint32_t operationIndex) {
+        Operation& removed = operation(operationIndex);
+        for (uint32_t input : removed.inputs) {
+            mNumberOfConsumers[input]--;
+        }
+        for (uint32_t output : removed.outputs) {
+            mProducers[output] = kNoProducer;
+        }
+        mRemoved[operationIndex] = true;
+    }
+
+    void setOutput(uint32_t operationIndex, uint32_t operandIndex) {
+        Operation& op = operation(operationIndex);
+        CHECK_EQ(op.outputs.size(), 1u);
+        mProducers[op.outputs[0]] = kNoProducer;
+        op.outputs[0] = operandIndex;
+        mProducers[operandIndex] = operationIndex;
+    }
+
+    // Drops the removed operations from the main subgraph.
+    uint32_t eraseRemovedOperations() {
+        std::vector<Operation>& operations = mModel->main.operations;
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < operations.size(); ++i) {
+            if (!mRemoved[i]) {
+                if (kept != i) {
+                    operations[kept] = std::move(operations[i]);
+                }
+                kept++;
+            }
+        }
+        const uint32_t removed = operations.size() - kept;
+        operations.resize(kept);
+        return removed;
+    }
+
+   private:
+    Model* mModel;
+    std::vector<uint32_t> mProducers;
+    std::vector<uint32_t> mNumberOfConsumers;
+    std::vector<bool> mRemoved;
+};
+
+bool isFusableTensorType(OperandType type) {
+    switch (type) {
+        case OperandType::TENSOR_FLOAT16:
+        case OperandType::TENSOR_FLOAT32:
+        case OperandType::TENSOR_QUANT8_ASYMM:
+        case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Returns the index of the fused activation input of the operation, or std::nullopt if the
+// operation does not have one.
+std::optional<uint32_t> getFusedActivationInputIndex(const FusionState& state,
+                                                     const Operation& operation) {
+    const uint32_t inputCount = operation.inputs.size();
+    auto inputType = [&state, &operation](uint32_t i) {
+        return state.operand(operation.inputs[i]).type;
+    };
+    switch (operation.type) {
+        case OperationType::ADD:
+        case OperationType::SUB:
+        case OperationType::MUL:
+        case OperationType::DIV:
+            return inputCount == 3 ? std::optional<uint32_t>(2) : std::nullopt;
+        case OperationType::FULLY_CONNECTED:
+            return inputCount == 4 ? std::optional<uint32_t>(3) : std::nullopt;
+        case OperationType::CONV_2D:
+            // Implicit padding has 7, 8 or 10 inputs with input 7 being the layout.
+            if (inputCount == 7 || (inputCount >= 8 && inputType(7) == OperandType::BOOL)) {
+                return 6;
+            }
+            return inputCount >= 10 ? std::optional<uint32_t>(9) : std::nullopt;
+        case OperationType::DEPTHWISE_CONV_2D:
+            // Implicit padding has 8, 9 or 11 inputs with input 8 being the layout.
+            if (inputCount == 8 || (inputCount >= 9 && inputType(8) == OperandType::BOOL)) {
+                return 7;
+            }
+            return inputCount >= 11 ? std::optional<uint32_t>(10) : std::nullopt;
+        case OperationType::AVERAGE_POOL_2D:
+        case OperationType::MAX_POOL_2D:
+        case OperationType::L2_POOL_2D:
+            // Implicit padding has 7 or 8 inputs, explicit padding has 10 or 11 inputs.
+            if (inputCount == 7 || inputCount == 8) return 6;
+            if (inputCount == 10 || inputCount == 11) return 9;
+            return std::nullopt;
+        default:
+            return std::nullopt;
+    }
+}
+
+std::optional<FusedActivationFunc> getActivationOfOperation(OperationType type) {
+    switch (type) {
+        case OperationType::RELU:
+            return FusedActivationFunc::RELU;
+        case OperationType::RELU1:
+            return FusedActivationFunc::RELU1;
+        case OperationType::RELU6:
+            return FusedActivationFunc::RELU6;
+        default:
+            return std::nullopt;
+    }
+}
+
+// Fuses "activation" = RELU/RELU1/RELU6(X) into the operation producing X.
+//
+// The quantized RELU kernels clamp to the same range as CalculateActivationRange* computes for
+// a fused activation, so this is exact as long as X and the activation output share their
+// quantization parameters.
+bool fuseActivation(FusionState* state, uint32_t activationIndex) {
+    const Operation& activation = state->operation(activationIndex);
+    const auto activationFunc = getActivationOfOperation(activation.type);
+    if (!activationFunc.has_value() || activation.inputs.size() != 1 ||
+        activation.outputs.size() != 1) {
+        return false;
+    }
+    const uint32_t intermediate = activation.inputs[0];
+    const uint32_t output = activation.outputs[0];
+    if (!state->isSingleUseTemporary(intermediate)) {
+        return false;
+    }
+    const Operand& intermediateOperand = state->operand(intermediate);
+    const Operand& outputOperand = state->operand(output);
+    if (!isFusableTensorType(intermediateOperand.type) ||
+        intermediateOperand.type != outputOperand.type ||
+        intermediateOperand.scale != outputOperand.scale ||
+        intermediateOperand.zeroPoint != outputOperand.zeroPoint) {
+        return false;
+    }
+
+    const uint32_t producerIndex = state->producer(intermediate);
+    const Operation& producer = state->operation(producerIndex);
+    if (producer.outputs.size() != 1) {
+        return false;
+    }
+    const auto activationInput = getFusedActivationInputIndex(*state, producer);
+    if (!activationInput.has_value()) {
+        return false;
+    }
+    const auto currentActivation = state->getScalarInt32(producer.inputs[*activationInput]);
+    if (currentActivation != static_cast<int32_t>(FusedActivationFunc::NONE)) {
+        return false;
+    }
+
+    const uint32_t newActivation = state->addScalarInt32(static_cast<int32_t>(*activationFunc));
+    state->replaceInput(producerIndex, *activationInput, newActivation);
+    state->removeOperation(activationIndex);
+    state->setOutput(producerIndex, output);
+    return true;
+}
+
+// Fuses CONV_2D(PAD(X), ...) into CONV_2D(X, ...) with explicit padding.
+//
+// CONV_2D treats padded elements as the zero point of its input, which is also what PAD writes,
+// so adding the PAD amounts to the explicit padding of CONV_2D is exact. Only spatial padding can
+// be folded.
+bool fusePadIntoConv(FusionState* state, uint32_t convIndex) {
+    const Operation& conv = state->operation(convIndex);
+    if (conv.type != OperationType::CONV_2D || conv.inputs.size() < 7) {
+        return false;
+    }
+    const uint32_t padded = conv.inputs[0];
+    if (!state->isSingleUseTemporary(padded)) {
+        return false;
+    }
+    const uint32_t padIndex = state->producer(padded);
+    const Operation& pad = state->operation(padIndex);
+    if (pad.type != OperationType::PAD || pad.inputs.size() != 2) {
+        return false;
+    }
+    const uint32_t unpadded = pad.inputs[0];
+    const Operand& unpaddedOperand = state->operand(unpadded);
+    const Operand& paddedOperand = state->operand(padded);
+    if (!isFusableTensorType(paddedOperand.type) || unpaddedOperand.type != paddedOperand.type ||
+        unpaddedOperand.scale != paddedOperand.scale ||
+        unpaddedOperand.zeroPoint != paddedOperand.zeroPoint) {
+        return false;
+    }
+    const auto paddings = state->getConstantValues<int32_t>(pad.inputs[1]);
+    if (!paddings.has_value() || paddings->size() != 8) {
+        return false;
+    }
+
+    // Decode the signature of CONV_2D. See Conv2dParam::initialize.
+    const uint32_t inputCount = conv.inputs.size();
+    const bool useImplicitPadding =
+            inputCount == 7 ||
+            (inputCount >= 8 && state->operand(conv.inputs[7]).type == OperandType::BOOL);
+    const uint32_t layoutIndex = useImplicitPadding ? 7 : 10;
+    bool useNchw = false;
+    if (inputCount > layoutIndex) {
+        const auto layout = state->getConstantValues<bool8>(conv.inputs[layoutIndex]);
+        if (!layout.has_value() || layout->size() != 1) {
+            return false;
+        }
+        useNchw = layout->front();
+    }
+    const uint32_t heightDim = useNchw ? 2 : 1;
+    const uint32_t widthDim = useNchw ? 3 : 2;
+    const uint32_t channelDim = useNchw ? 1 : 3;
+    const auto& p = *paddings;
+    if (p[0] != 0 || p[1] != 0 || p[2 * channelDim] != 0 || p[2 * channelDim + 1] != 0) {
+        return false;
+    }
+
+    // Explicit padding as {left, right, top, bottom}.
+    int32_t explicitPadding[4] = {0, 0, 0, 0};
+    if (useImplicitPadding) {
+        if (state->getScalarInt32(conv.inputs[3]) != static_cast<int32_t>(kPaddingValid)) {
+            return false;
+        }
+    } else {
+        for (uint32_t i = 0; i < 4; ++i) {
+            const auto value = state->getScalarInt32(conv.inputs[3 + i]);
+            if (!value.has_value()) {
+                return false;
+            }
+            explicitPadding[i] = *value;
+        }
+    }
+    explicitPadding[0] += p[2 * widthDim];
+    explicitPadding[1] += p[2 * widthDim + 1];
+    explicitPadding[2] += p[2 * heightDim];
+    explicitPadding[3] += p[2 * heightDim + 1];
+
+    // Build the explicit padding signature:
+    // {input, filter, bias, left, right, top, bottom, strideW, strideH, activation,
+    //  [layout, [dilationW, dilationH]]}
+    std::vector<uint32_t> newInputs = {unpadded, conv.inputs[1], conv.inputs[2]};
+    for (int32_t padding : explicitPadding) {
+        newInputs.push_back(state->addScalarInt32(padding));
+    }
+    const uint32_t firstTrailingInput = useImplicitPadding ? 4 : 7;
+    newInputs.insert(newInputs.end(), conv.inputs.begin() + firstTrailingInput, conv.inputs.end());
+
+    state->removeOperation(padIndex);
+    state->setInputs(convIndex, std::move(newInputs));
+    return true;
+}
+
+// Describes how an operation that can run on NHWC data in place of NCHW data uses its operands.
+struct LayoutUsage {
+    // Positions in Operation::inputs of the tensors that have the layout of the output.
+    std::vector<uint32_t> dataInputs;
+    // Position of the BOOL input selecting NCHW, if the operation has one.
+    std::optional<uint32_t> layoutInput;
+    // Position of the constant TENSOR_INT32 input holding the output shape in the layout of the
+    // output, if the operation has one. It is permuted along with the layout.
+    std::optional<uint32_t> outputShapeInput;
+};
+
+// Returns the position of the input selecting the layout of the first input and the only output
+// of the operation, or std::nullopt if the operation has no such input.
+std::optional<uint32_t> getLayoutInputIndex(const Model& model, const Operation& operation) {
+    const uint32_t inputCount = operation.inputs.size();
+    auto isBool = [&model, &operation, inputCount](uint32_t i) {
+        return i < inputCount &&
+               model.main.operands[operation.inputs[i]].type == OperandType::BOOL;
+    };
+    uint32_t index = 0;
+    switch (operation.type) {
+        case OperationType::CONV_2D:
+            // Implicit padding has the layout at input 7, explicit padding at input 10.
+            index = isBool(7) ? 7 : 10;
+            break;
+        case OperationType::DEPTHWISE_CONV_2D:
+            // Implicit padding has the layout at input 8, explicit padding at input 11.
+            index = isBool(8) ? 8 : 11;
+            break;
+        case OperationType::AVERAGE_POOL_2D:
+        case OperationType::MAX_POOL_2D:
+        case OperationType::L2_POOL_2D:
+            index = inputCount <= 8 ? 7 : 10;
+            break;
+        case OperationType::TRANSPOSE_CONV_2D:
+            index = inputCount <= 9 ? 8 : 10;
+            break;
+        case OperationType::RESIZE_BILINEAR:
+        case OperationType::RESIZE_NEAREST_NEIGHBOR:
+            index = 3;
+            break;
+        case OperationType::INSTANCE_NORMALIZATION:
+            index = 4;
+            break;
+        case OperationType::ROI_ALIGN:
+            index = 9;
+            break;
+        case OperationType::ROI_POOLING:
+            index = 7;
+            break;
+        case OperationType::DEPTH_TO_SPACE:
+        case OperationType::SPACE_TO_DEPTH:
+        case OperationType::BATCH_TO_SPACE_ND:
+            index = 2;
+            break;
+        case OperationType::SPACE_TO_BATCH_ND:
+            index = 3;
+            break;
+        default:
+            return std::nullopt;
+    }
+    return isBool(index) ? std::optional<uint32_t>(index) : std::nullopt;
+}
+
+// Returns the number of leading tensor inputs of an operation that computes each output element
+// from the input elements at the same position, or 0 for other operations.
+uint32_t getNumberOfElementwiseInputs(OperationType type) {
+    switch (type) {
+        case OperationType::ABS:
+        case OperationType::ELU:
+        case OperationType::EXP:
+        case OperationType::FLOOR:
+        case OperationType::HARD_SWISH:
+        case OperationType::LOGISTIC:
+        case OperationType::NEG:
+        case OperationType::RELU:
+        case OperationType::RELU1:
+        case OperationType::RELU6:
+        case OperationType::RSQRT:
+        case OperationType::SQRT:
+        case OperationType::TANH:
+            return 1;
+        case OperationType::ADD:
+        case OperationType::SUB:
+        case OperationType::MUL:
+        case OperationType::DIV:
+        case OperationType::MAXIMUM:
+        case OperationType::MINIMUM:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+// Returns how the operation uses the layout of its operands if it can run on NHWC data in place
+// of NCHW data: either it has a layout input currently set to NCHW, or it computes each output
+// element from the input elements at the same position.
+std::optional<LayoutUsage> getLayoutUsage(const Model& model, const Operation& operation) {
+    if (operation.outputs.size() != 1 || operation.inputs.empty()) {
+        return std::nullopt;
+    }
+    const auto& operands = model.main.operands;
+    if (const auto layoutInput = getLayoutInputIndex(model, operation); layoutInput.has_value()) {
+        const auto useNchw = getConstantValues<bool8>(model, operation.inputs[*layoutInput]);
+        if (!useNchw.has_value() || useNchw->size() != 1 || !useNchw->front()) {
+            return std::nullopt;
+        }
+        LayoutUsage usage = {.dataInputs = {0}, .layoutInput = layoutInput};
+        // TRANSPOSE_CONV_2D with implicit padding computes the padding from the height and width
+        // of its output_shape input, which are read according to the layout.
+        if (operation.type == OperationType::TRANSPOSE_CONV_2D && *layoutInput == 8) {
+            constexpr uint32_t kOutputShapeInput = 3;
+            const uint32_t outputShape = operation.inputs[kOutputShapeInput];
+            const auto values = getConstantValues<int32_t>(model, outputShape);
+            if (operands[outputShape].type != OperandType::TENSOR_INT32 || !values.has_value() ||
+                values->size() != 4) {
+                return std::nullopt;
+            }
+            usage.outputShapeInput = kOutputShapeInput;
+        }
+        return usage;
+    }
+    const uint32_t numElementwiseInputs = getNumberOfElementwiseInputs(operation.type);
+    if (numElementwiseInputs == 0 || operation.inputs.size() < numElementwiseInputs) {
+        return std::nullopt;
+    }
+    LayoutUsage usage = {.dataInputs = {0}};
+    if (numElementwiseInputs == 2) {
+        // Broadcasting depends on the order of the dimensions, so both inputs must have the fully
+        // specified shape of the output.
+        const std::vector<uint32_t>& dimensions = operands[operation.outputs[0]].dimensions;
+        if (std::count(dimensions.begin(), dimensions.end(), 0u) != 0 ||
+            operands[operation.inputs[0]].dimensions != dimensions ||
+            operands[operation.inputs[1]].dimensions != dimensions) {
+            return std::nullopt;
+        }
+        usage.dataInputs.push_back(1);
+    }
+    return usage;
+}
+
+// Returns true if the operand can be stored in NHWC order and transposed by TRANSPOSE.
+bool isTransposableTensor(const Operand& operand) {
+    return isFusableTensorType(operand.type) && operand.dimensions.size() == 4;
+}
+
+std::vector<uint32_t> toNhwc(const std::vector<uint32_t>& nchw) {
+    return {nchw[0], nchw[2], nchw[3], nchw[1]};
+}
+
+uint32_t findRoot(std::vector<uint32_t>* parents, uint32_t i) {
+    while ((*parents)[i] != i) {
+        (*parents)[i] = (*parents)[(*parents)[i]];
+        i = (*parents)[i];
+    }
+    return i;
+}
+
+// Whether the value of an operand with this lifetime is available before execution.
+bool isKnownBeforeExecution(Operand::LifeTime lifetime) {
+    return lifetime == Operand::LifeTime::CONSTANT_COPY ||
+           lifetime == Operand::LifeTime::CONSTANT_REFERENCE ||
+           lifetime == Operand::LifeTime::POINTER || lifetime == Operand::LifeTime::NO_VALUE;
+}
+
+// The largest factor by which folding an operation may grow the constant data of the model.
+// DEQUANTIZE of 8-bit weights grows it by 4. Operations such as TILE or FILL can produce outputs
+// far larger than their inputs, which are cheaper to recompute than to keep in memory.
+constexpr uint64_t kMaxFoldedSizeGrowth = 4;
+
+// Whether an operation can be executed when the model is prepared, given which operands have a
+// value at that point.
+bool canFoldOperation(const Model::Subgraph& subgraph, const Operation& operation,
+                      const std::vector<bool>& isConstant,
+                      const IOperationResolver* operationResolver) {
+    if (operation.type == OperationType::OEM_OPERATION ||
+        (isExtension(operation.type) &&
+         operationResolver->findOperation(operation.type) == nullptr)) {
+        return false;
+    }
+    uint64_t inputSize = 0;
+    for (uint32_t input : operation.inputs) {
+        if (!isConstant[input]) return false;
+        const Operand& operand = subgraph.operands[input];
+        // The inputs computed by other folded operations are temporaries of a known size.
+        inputSize += isKnownBeforeExecution(operand.lifetime)
+                             ? operand.location.length
+                             : nonExtensionOperandSizeOfData(operand);
+    }
+    uint64_t outputSize = 0;
+    for (uint32_t output : operation.outputs) {
+        const Operand& operand = subgraph.operands[output];
+        if (operand.lifetime != Operand::LifeTime::TEMPORARY_VARIABLE ||
+            isExtension(operand.type) || tensorHasUnspecifiedDimensions(operand) ||
+            nonExtensionOperandSizeOfDataOverflowsUInt32(operand.type, operand.dimensions)) {
+            return false;
+        }
+        outputSize += nonExtensionOperandSizeOfData(operand);
+    }
+    return outputSize <= ANEURALNETWORKS_MAX_SIZE_OF_IMMEDIATELY_COPIED_VALUES ||
+           outputSize <= kMaxFoldedSizeGrowth * inputSize;
+}
+
+// The largest fraction of non-zero weights for which FULLY_CONNECTED is run with sparse weights.
+// The sparse kernel loads an index for every weight and gathers the matching inputs instead of
+// streaming them, so it is only faster when most of the weights are zero.
+constexpr double kMaxSparseWeightsDensity = 0.4;
+
+// The operands holding the weights of a FULLY_CONNECTED operation as compressed sparse rows. See
+// fully_connected_sparse::kNumInputs.
+struct SparseWeights {
+    uint32_t values;
+    uint32_t dimensions;
+    uint32_t rowSegments;
+    uint32_t columnIndices;
+};
+
+// Returns the value of a constant operand, or nullptr if it is not available.
+const uint8_t* getConstantData(const Model& model, const std::vector<RunTimePoolInfo>& poolInfos,
+                               const Operand& operand) {
+    switch (operand.lifetime) {
+        case Operand::LifeTime::CONSTANT_COPY:
+            return model.operandValues.data() + operand.location.offset;
+        case Operand::LifeTime::CONSTANT_REFERENCE:
+            return operand.location.poolIndex < poolInfos.size()
+                           ? poolInfos[operand.location.poolIndex].getBuffer() +
+                                     operand.location.offset
+                           : nullptr;
+        case Operand::LifeTime::POINTER:
+            return std::visit(
+                    [](auto* pointer) { return static_cast<const uint8_t*>(pointer); },
+                    operand.location.pointer);
+        default:
+            return nullptr;
+    }
+}
+
+// Adds the compressed sparse rows of constant TENSOR_FLOAT32 weights of shape [num_units,
+// input_size] to the main subgraph. Returns std::nullopt if too many weights are non-zero.
+std::optional<SparseWeights> addSparseWeights(Model* model,
+                                              const std::vector<RunTimePoolInfo>& poolInfos,
+                                              uint32_t weightsIndex) {
+    const Operand& weights = model->main.operands[weightsIndex];
+    const float* weightsData =
+            reinterpret_cast<const float*>(getConstantData(*model, poolInfos, weights));
+    if (weightsData == nullptr) {
+        return std::nullopt;
+    }
+    const uint32_t numUnits = weights.dimensions[0];
+    const uint32_t inputSize = weights.dimensions[1];
+    const size_t weightCount = size_t{numUnits} * inputSize;
+
+    std::vector<float> values;
+    std::vector<int32_t> columnIndices;
+    std::vector<int32_t> rowSegments = {0};
+    rowSegments.reserve(numUnits + 1);
+    for (uint32_t unit = 0; unit < numUnits; ++unit) {
+        const float* row = weightsData + size_t{unit} * inputSize;
+        for (uint32_t i = 0; i < inputSize; ++i) {
+            if (row[i] != 0.0f) {
+                values.push_back(row[i]);
+                columnIndices.push_back(i);
+            }
+        }
+        if (values.size() > weightCount * kMaxSparseWeightsDensity) {
+            return std::nullopt;
+        }
+        rowSegments.push_back(values.size());
+    }
+    if (values.empty()) {
+        return std::nullopt;
+    }
+
+    const uint32_t nonZeroCount = values.size();
+    const int32_t dimensions[] = {static_cast<int32_t>(numUnits), static_cast<int32_t>(inputSize)};
+    return SparseWeights{
+            .values = addConstantOperand(model, OperandType::TENSOR_FLOAT32, {nonZeroCount},
+                                         values.data(), values.size() * sizeof(float)),
+            .dimensions = addConstantOperand(model, OperandType::TENSOR_INT32, {2}, dimensions,
+                                             sizeof(dimensions)),
+            .rowSegments = addConstantOperand(model, OperandType::TENSOR_INT32, {numUnits + 1},
+                                              rowSegments.data(),
+                                              rowSegments.size() * sizeof(int32_t)),
+            .columnIndices = addConstantOperand(model, OperandType::TENSOR_INT32, {nonZeroCount},
+                                                columnIndices.data(),
+                                                columnIndices.size() * sizeof(int32_t)),
+    };
+}
+
+}  // namespace
+
+uint32_t fuseOperationsForCpu(Model* model) {
+    CHECK(model != nullptr);
+    FusionState state(model);
+
+    const uint32_t operationCount = model->main.operations.size();
+    bool changed = false;
+    for (uint32_t i = 0; i < operationCount; ++i) {
+        if (state.isRemoved(i)) continue;
+        changed |= fusePadIntoConv(&state, i);
+    }
+    // Run after PAD has been folded so that the fused CONV_2D is the producer seen by the
+    // activation.
+    for (uint32_t i = 0; i < operationCount; ++i) {
+        if (state.isRemoved(i)) continue;
+        changed |= fuseActivation(&state, i);
+    }
+    if (!changed) {
+        return 0;
+    }
+
+    const uint32_t removed = state.eraseRemovedOperations();
+    removeDeadOperands(model);
+    VLOG(CPUEXE) << "fuseOperationsForCpu removed " << removed << " of " << operationCount
+                 << " operations";
+    return removed;
+}
+
+uint32_t assignLayoutsForCpu(Model* model) {
+    CHECK(model != nullptr);
+    Model::Subgraph& main = model->main;
+    const uint32_t operationCount = main.operations.size();
+    const uint32_t operandCount = main.operands.size();
+
+    std::vector<std::optional<LayoutUsage>> usages(operationCount);
+    std::vector<uint32_t> producers(operandCount, kNoProducer);
+    for (uint32_t i = 0; i < operationCount; ++i) {
+        usages[i] = getLayoutUsage(*model, main.operations[i]);
+        for (uint32_t output : main.operations[i].outputs) {
+            producers[output] = i;
+        }
+    }
+
+    // A temporary can be kept in NHWC order if its producer and all of its consumers can run on
+    // NHWC data and only use it as a data tensor.
+    std::vector<bool> keepInNhwc(operandCount, false);
+    for (uint32_t i = 0; i < operandCount; ++i) {
+        const Operand& operand = main.operands[i];
+        keepInNhwc[i] = operand.lifetime == Operand::LifeTime::TEMPORARY_VARIABLE &&
+                        isTransposableTensor(operand) && producers[i] != kNoProducer &&
+                        usages[producers[i]].has_value();
+    }
+    for (uint32_t i = 0; i < operationCount; ++i) {
+        const Operation& operation = main.operations[i];
+        for (uint32_t position = 0; position < operation.inputs.size(); ++position) {
+            const bool isDataInput =
+                    usages[i].has_value() &&
+                    std::count(usages[i]->dataInputs.begin(), usages[i]->dataInputs.end(),
+                               position) != 0;
+            if (!isDataInput) {
+                keepInNhwc[operation.inputs[position]] = false;
+            }
+        }
+    }
+
+    // Operations connected by NHWC temporaries must switch to NHWC together. Group them and
+    // compare, for each group, the conversions done by the kernels with the TRANSPOSE operations
+    // needed at the boundary of the group.
+    std::vector<uint32_t> groups(operationCount);
+    std::iota(groups.begin(), groups.end(), 0);
+    for (uint32_t i = 0; i < operationCount; ++i) {
+        for (uint32_t input : main.operations[i].inputs) {
+            if (keepInNhwc[input]) {
+                groups[findRoot(&groups, i)] = findRoot(&groups, producers[input]);
+            }
+        }
+    }
+    std::vector<int32_t> savedConversions(operationCount, 0);
+    std::vector<bool> isConvertible(operationCount, true);
+    std::set<std::pair<uint32_t, uint32_t>> groupInputs;
+    for (uint32_t i = 0; i < operationCount; ++i) {
+        if (!usages[i].has_value()) continue;
+        const uint32_t group = findRoot(&groups, i);
+        const Operation& operation = main.operations[i];
+        if (usages[i]->layoutInput.has_value()) {
+            // The kernel converts its input to NHWC and its output back to NCHW.
+            savedConversions[group] += 2;
+        }
+        for (uint32_t position : usages[i]->dataInputs) {
+            const uint32_t input = operation.inputs[position];
+            if (keepInNhwc[input]) continue;
+            isConvertible[group] =
+                    isConvertible[group] && isTransposableTensor(main.operands[input]);
+            // An input shared by several operations of the group is transposed once.
+            if (groupInputs.emplace(group, input).second) {
+                savedConversions[group]--;
+            }
+        }
+        const uint32_t output = operation.outputs[0];
+        if (!keepInNhwc[output]) {
+            isConvertible[group] =
+                    isConvertible[group] && isTransposableTensor(main.operands[output]);
+            savedConversions[group]--;
+        }
+    }
+    std::vector<bool> useNhwc(operationCount, false);
+    uint32_t convertedCount = 0;
+    for (uint32_t i = 0; i < operationCount; ++i) {
+        const uint32_t group = findRoot(&groups, i);
+        useNhwc[i] = usages[i].has_value() && isConvertible[group] && savedConversions[group] > 0;
+        if (useNhwc[i] && usages[i]->layoutInput.has_value()) {
+            convertedCount++;
+        }
+    }
+    if (convertedCount == 0) {
+        return 0;
+    }
+
+    // Rebuild the operations, transposing the inputs of each group right before their first use
+    // and the outputs right after they are written.
+    const int32_t toNhwcPermutation[] = {0, 2, 3, 1};
+    const int32_t toNchwPermutation[] = {0, 3, 1, 2};
+    const uint32_t toNhwcOperand = addConstantOperand(model, OperandType::TENSOR_INT32, {4},
+                                                      toNhwcPermutation, sizeof(toNhwcPermutation));
+    const uint32_t toNchwOperand = addConstantOperand(model, OperandType::TENSOR_INT32, {4},
+                                                      toNchwPermutation, sizeof(toNchwPermutation));
+    const bool8 nhwcLayout = false;
+    const uint32_t nhwcLayoutOperand =
+            addConstantOperand(model, OperandType::BOOL, {}, &nhwcLayout, sizeof(nhwcLayout));
+    auto addNhwcTemporary = [model](uint32_t nchwOperand) {
+        Operand operand = model->main.operands[nchwOperand];
+        operand.dimensions = toNhwc(operand.dimensions);
+        operand.lifetime = Operand::LifeTime::TEMPORARY_VARIABLE;
+        operand.location = {};
+        model->main.operands.push_back(std::move(operand));
+        return static_cast<uint32_t>(model->main.operands.size() - 1);
+    };
+
+    std::vector<uint32_t> nhwcCopies(operandCount, kNoProducer);
+    std::vector<Operation> operations;
+    operations.reserve(operationCount);
+    for (uint32_t i = 0; i < operationCount; ++i) {
+        Operation& operation = main.operations[i];
+        if (!useNhwc[i]) {
+            operations.push_back(std::move(operation));
+            continue;
+        }
+        for (uint32_t position : usages[i]->dataInputs) {
+            const uint32_t input = operation.inputs[position];
+            if (keepInNhwc[input]) continue;
+            if (nhwcCopies[input] == kNoProducer) {
+                nhwcCopies[input] = addNhwcTemporary(input);
+                operations.push_back({.type = OperationType::TRANSPOSE,
+                                      .inputs = {input, toNhwcOperand},
+                                      .outputs = {nhwcCopies[input]}});
+            }
+            operation.inputs[position] = nhwcCopies[input];
+        }
+        if (usages[i]->layoutInput.has_value()) {
+            operation.inputs[*usages[i]->layoutInput] = nhwcLayoutOperand;
+        }
+        if (usages[i]->outputShapeInput.has_value()) {
+            uint32_t& outputShape = operation.inputs[*usages[i]->outputShapeInput];
+            const std::vector<int32_t> nchw =
+                    getConstantValues<int32_t>(*model, outputShape).value();
+            const int32_t nhwc[] = {nchw[0], nchw[2], nchw[3], nchw[1]};
+            outputShape =
+                    addConstantOperand(model, OperandType::TENSOR_INT32, {4}, nhwc, sizeof(nhwc));
+        }
+        const uint32_t output = operation.outputs[0];
+        if (keepInNhwc[output]) {
+            operations.push_back(std::move(operation));
+        } else {
+            const uint32_t nhwcOutput = addNhwcTemporary(output);
+            operation.outputs[0] = nhwcOutput;
+            operations.push_back(std::move(operation));
+            operations.push_back({.type = OperationType::TRANSPOSE,
+                                  .inputs = {nhwcOutput, toNchwOperand},
+                                  .outputs = {output}});
+        }
+    }
+    for (uint32_t i = 0; i < operandCount; ++i) {
+        if (keepInNhwc[i] && useNhwc[producers[i]]) {
+            main.operands[i].dimensions = toNhwc(main.operands[i].dimensions);
+        }
+    }
+    main.operations = std::move(operations);
+    removeDeadOperands(model);
+    VLOG(CPUEXE) << "assignLayoutsForCpu switched " << convertedCount
+                 << " operations to NHWC, adding "
+                 << main.operations.size() - operationCount << " TRANSPOSE operations";
+    return convertedCount;
+}
+
+ConstantFoldingResult foldConstantsForCpu(Model* model,
+                                          const IOperationResolver* operationResolver) {
+    CHECK(model != nullptr);
+    CHECK(operationResolver != nullptr);
+    Model::Subgraph& main = model->main;
+    const uint32_t operationCount = main.operations.size();
+    const uint32_t operandCount = main.operands.size();
+
+    // Operations are sorted in execution order, so a single pass also finds the operations whose
+    // inputs are computed by other folded operations.
+    std::vector<bool> isConstant(operandCount);
+    for (uint32_t i = 0; i < operandCount; ++i) {
+        isConstant[i] = isKnownBeforeExecution(main.operands[i].lifetime);
+    }
+    std::vector<bool> isFolded(operationCount, false);
+    Model folding = {.relaxComputationFloat32toFloat16 = model->relaxComputationFloat32toFloat16};
+    folding.main.operands = main.operands;
+    for (uint32_t i = 0; i < operationCount; ++i) {
+        const Operation& operation = main.operations[i];
+        if (!canFoldOperation(main, operation, isConstant, operationResolver)) continue;
+        isFolded[i] = true;
+        folding.main.operations.push_back(operation);
+        for (uint32_t output : operation.outputs) {
+            isConstant[output] = true;
+        }
+    }
+
+    // Only the folded values read by the remaining operations need to be kept. They become the
+    // outputs of the folding model, written either to a host buffer that is later copied into the
+    // model or directly to the new memory pool.
+    constexpr uint32_t kCopiedValuesPool = 0;
+    constexpr uint32_t kNewMemoryPool = 1;
+    std::vector<bool> isKept(operandCount, false);
+    Request request;
+    size_t copiedValuesSize = 0;
+    size_t newMemorySize = 0;
+    for (uint32_t i = 0; i < operationCount; ++i) {
+        if (isFolded[i]) continue;
+        for (uint32_t input : main.operations[i].inputs) {
+            if (!isConstant[input] || isKept[input] ||
+                isKnownBeforeExecution(main.operands[input].lifetime)) {
+                continue;
+            }
+            isKept[input] = true;
+            folding.main.outputIndexes.push_back(input);
+            folding.main.operands[input].lifetime = Operand::LifeTime::SUBGRAPH_OUTPUT;
+
+            const uint32_t length = nonExtensionOperandSizeOfData(main.operands[input]);
+            DataLocation location = {.length = length};
+            if (length <= ANEURALNETWORKS_MAX_SIZE_OF_IMMEDIATELY_COPIED_VALUES) {
+                location.poolIndex = kCopiedValuesPool;
+                location.offset = roundUp(copiedValuesSize, kMinMemoryAlignment);
+                copiedValuesSize = location.offset + length;
+            } else {
+                const size_t offset = roundUp(newMemorySize, kDefaultRequestMemoryAlignment);
+                if (offset + length > std::numeric_limits<uint32_t>::max()) {
+                    VLOG(CPUEXE) << "foldConstantsForCpu: folded values do not fit in a pool";
+                    return {};
+                }
+                location.poolIndex = kNewMemoryPool;
+                location.offset = offset;
+                newMemorySize = offset + length;
+            }
+            request.outputs.push_back(
+                    {.lifetime = Request::Argument::LifeTime::POOL, .location = location});
+        }
+    }
+    if (request.outputs.empty()) {
+        return {};
+    }
+
+    std::vector<RunTimePoolInfo> modelPoolInfos;
+    if (!setRunTimePoolInfosFromCanonicalMemories(&modelPoolInfos, model->pools)) {
+        VLOG(CPUEXE) << "foldConstantsForCpu: failed to map the model pools";
+        return {};
+    }
+    std::vector<uint8_t> copiedValues(copiedValuesSize);
+    std::vector<RunTimePoolInfo> requestPoolInfos = {
+            RunTimePoolInfo::createFromExistingBuffer(copiedValues.data(), copiedValues.size())};
+    SharedMemory newMemory;
+    if (newMemorySize > 0) {
+        auto memory = createSharedMemory(newMemorySize);
+        if (!memory.has_value()) {
+            VLOG(CPUEXE) << "foldConstantsForCpu: failed to allocate " << newMemorySize
+                         << " bytes: " << memory.error().message;
+            return {};
+        }
+        newMemory = std::move(memory).value();
+        auto poolInfo = RunTimePoolInfo::createFromMemory(newMemory);
+        if (!poolInfo.has_value()) {
+            VLOG(CPUEXE) << "foldConstantsForCpu: failed to map the new pool";
+            return {};
+        }
+        requestPoolInfos.push_back(std::move(*poolInfo));
+    }
+
+    // Lend the constant values of the model to the folding model instead of copying them.
+    folding.operandValues = std::move(model->operandValues);
+    CpuExecutor executor(operationResolver);
+    const int result = executor.run(folding, request, modelPoolInfos, requestPoolInfos);
+    model->operandValues = std::move(folding.operandValues);
+    if (result != ANEURALNETWORKS_NO_ERROR) {
+        VLOG(CPUEXE) << "foldConstantsForCpu: failed to execute "
+                     << folding.main.operations.size() << " operations with constant inputs";
+        return {};
+    }
+
+    ConstantFoldingResult folded = {
+            .operationCount = static_cast<uint32_t>(folding.main.operations.size())};
+    const uint32_t newPoolIndex = model->pools.size();
+    if (newMemory != nullptr) {
+        model->pools.push_back(std::move(newMemory));
+    }
+    for (size_t i = 0; i < request.outputs.size(); ++i) {
+        Operand& operand = main.operands[folding.main.outputIndexes[i]];
+        const DataLocation& location = request.outputs[i].location;
+        if (location.poolIndex == kCopiedValuesPool) {
+            operand.lifetime = Operand::LifeTime::CONSTANT_COPY;
+            operand.location = model->operandValues.append(
+                    copiedValues.data() + location.offset, location.length);
+        } else {
+            operand.lifetime = Operand::LifeTime::CONSTANT_REFERENCE;
+            operand.location = {.poolIndex = newPoolIndex,
+                                .offset = location.offset,
+                                .length = location.length};
+        }
+        folded.byteCount += location.length;
+    }
+    std::vector<Operation> operations;
+    operations.reserve(operationCount - folded.operationCount);
+    for (uint32_t i = 0; i < operationCount; ++i) {
+        if (!isFolded[i]) {
+            operations.push_back(std::move(main.operations[i]));
+        }
+    }
+    main.operations = std::move(operations);
+    removeDeadOperands(model);
+    VLOG(CPUEXE) << "foldConstantsForCpu folded " << folded.operationCount << " of "
+                 << operationCount << " operations into " << folded.byteCount
+                 << " bytes of constants";
+    return folded;
+}
+
+uint32_t sparsifyWeightsForCpu(Model* model) {
+    CHECK(model != nullptr);
+    Model::Subgraph& main = model->main;
+    auto isCandidate = [&main](const Operation& operation) {
+        if (operation.type != OperationType::FULLY_CONNECTED ||
+            operation.inputs.size() != fully_connected::kNumInputs) {
+            return false;
+        }
+        const Operand& input = main.operands[operation.inputs[fully_connected::kInputTensor]];
+        const Operand& weights = main.operands[operation.inputs[fully_connected::kWeightsTensor]];
+        return input.type == OperandType::TENSOR_FLOAT32 &&
+               weights.type == OperandType::TENSOR_FLOAT32 && weights.dimensions.size() == 2 &&
+               !tensorHasUnspecifiedDimensions(weights) &&
+               (weights.lifetime == Operand::LifeTime::CONSTANT_COPY ||
+                weights.lifetime == Operand::LifeTime::CONSTANT_REFERENCE ||
+                weights.lifetime == Operand::LifeTime::POINTER);
+    };
+    if (std::none_of(main.operations.begin(), main.operations.end(), isCandidate)) {
+        return 0;
+    }
+
+    std::vector<RunTimePoolInfo> poolInfos;
+    if (!setRunTimePoolInfosFromCanonicalMemories(&poolInfos, model->pools)) {
+        VLOG(CPUEXE) << "sparsifyWeightsForCpu: failed to map the model pools";
+        return 0;
+    }
+    // Weights shared by several operations are only compressed once.
+    std::map<uint32_t, std::optional<SparseWeights>> sparseWeights;
+    uint32_t sparsifiedCount = 0;
+    for (Operation& operation : main.operations) {
+        if (!isCandidate(operation)) continue;
+        const uint32_t weightsIndex = operation.inputs[fully_connected::kWeightsTensor];
+        auto it = sparseWeights.find(weightsIndex);
+        if (it == sparseWeights.end()) {
+            it = sparseWeights
+                         .emplace(weightsIndex, addSparseWeights(model, poolInfos, weightsIndex))
+                         .first;
+        }
+        if (!it->second.has_value()) continue;
+        operation.type = kOperationFullyConnectedSparse;
+        operation.inputs[fully_connected_sparse::kWeightsTensor] = it->second->values;
+        operation.inputs.insert(operation.inputs.end(), {it->second->dimensions,
+                                                         it->second->rowSegments,
+                                                         it->second->columnIndices});
+        ++sparsifiedCount;
+    }
+    if (sparsifiedCount == 0) {
+        return 0;
+    }
+
+    removeDeadOperands(model);
+    VLOG(CPUEXE) << "sparsifyWeightsForCpu switched " << sparsifiedCount
+                 << " FULLY_CONNECTED operations to " << fully_connected_sparse::kOperationName;
+    return sparsifiedCount;
+}
+
+}  // namespace android::nn
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "CpuParallelFor"
+
+#include "CpuParallelFor.h"
+
+#include <android-base/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "LegacyUtils.h"
+#include "Tracing.h"
+
+namespace android::nn {
+namespace {
+
+// Splitting the work into more chunks than threads lets threads that finish early, or that start
+// late because the core was busy, pick up the remaining work.
+constexpr uint32_t kChunksPerThread = 4;
+
+// The deadline set by ScopedCpuDeadline on this thread.
+thread_local OptionalTimePoint tDeadline;
+
+// Whether this thread is currently running a chunk of a parallelFor call.
+thread_local bool tIsRunningChunk = false;
+
+uint32_t getDefaultThreadCount() {
+    // Leave some cores to the rest of the system on devices with many cores, so that a slow
+    // core does not hold up the whole operation. See the comment on ScopedOpenmpSettings.
+    const uint32_t numCores = std::max(std::thread::hardware_concurrency(), 1u);
+    if (numCores >= 8) {
+        return numCores - 4;
+    }
+    if (numCores >= 4) {
+        return numCores - 2;
+    }
+    return numCores;
+}
+
+// A parallelFor call in progress. Chunks are claimed in order by the calling thread and by the
+// worker threads until none are left.
+class Job {
+   public:
+    Job(uint32_t size, uint32_t numChunks, const OptionalTimePoint& deadline,
+        const std::function<bool(uint32_t, uint32_t)>& fn)
+        : mSize(size), mNumChunks(numChunks), mDeadline(deadline), mFn(fn) {}
+
+    // Runs chunks until all of them have been claimed.
+    void runChunks() {
+        const bool wasRunningChunk = tIsRunningChunk;
+        tIsRunningChunk = true;
+        for (uint32_t chunk = mNextChunk.fetch_add(1, std::memory_order_relaxed);
+             chunk < mNumChunks; chunk = mNextChunk.fetch_add(1, std::memory_order_relaxed)) {
+            runChunk(chunk);
+        }
+        tIsRunningChunk = wasRunningChunk;
+    }
+
+    void waitUntilFinished() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mFinishedCondition.wait(lock, [this] {
+            return mNumFinishedChunks.load(std::memory_order_acquire) == mNumChunks;
+        });
+    }
+
+    bool hasFailed() const { return mFailed.load(std::memory_order_relaxed); }
+    bool hasMissedDeadline() const { return mMissedDeadline.load(std::memory_order_relaxed); }
+
+   private:
+    void runChunk(uint32_t chunk) {
+        if (!mFailed.load(std::memory_order_relaxed)) {
+            if (hasDeadlinePassed(mDeadline)) {
+                mMissedDeadline.store(true, std::memory_order_relaxed);
+                mFailed.store(true, std::memory_order_relaxed);
+            } else {
+                const uint32_t begin = static_cast<uint64_t>(mSize) * chunk / mNumChunks;
+                const uint32_t end = static_cast<uint64_t>(mSize) * (chunk + 1) / mNumChunks;
+                if (!mFn(begin, end)) {
+                    mFailed.store(true, std::memory_order_relaxed);
+                }
+            }
+        }
+        if (mNumFinishedChunks.fetch_add(1, std::memory_order_acq_rel) + 1 == mNumChunks) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mFinishedCondition.notify_all();
+        }
+    }
+
+    const uint32_t mSize;
+    const uint32_t mNumChunks;
+    const OptionalTimePoint mDeadline;
+    // Only called while the parallelFor call that owns fn is waiting for the job to finish.
+    const std::function<bool(uint32_t, uint32_t)>& mFn;
+
+    std::atomic<uint32_t> mNextChunk = 0;
+    std::atomic<uint32_t> mNumFinishedChunks = 0;
+    std::atomic<bool> mFailed = false;
+    std::atomic<bool> mMissedDeadline = false;
+
+    std::mutex mMutex;
+    std::condition_variable mFinishedCondition;
+};
+
+// Worker threads shared by all the parallelFor calls in the process.
+class ThreadPool {
+   public:
+    static ThreadPool& get() {
+        // Intentionally leaked, so that worker threads are never joined during static
+        // destruction.
+        static ThreadPool* const pool = new ThreadPool();
+        return *pool;
+    }
+
+    uint32_t getThreadCount() const { return mThreadCount.load(std::memory_order_relaxed); }
+
+    void setThreadCount(uint32_t threadCount) {
+        std::lock_guard<std::mutex> configurationLock(mConfigurationMutex);
+        stopWorkers();
+        mThreadCount.store(threadCount, std::memory_order_relaxed);
+        startWorkers(threadCount - 1);
+    }
+
+    // Runs the job on the calling thread and on the worker threads. Returns when all the chunks
+    // of the job have finished.
+    void run(const std::shared_ptr<Job>& job, uint32_t numChunks) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mJobs.push_back(job);
+        }
+        const uint32_t numHelpers = numChunks - 1;
+        if (numHelpers + 1 >= getThreadCount()) {
+            mWorkAvailable.notify_all();
+        } else {
+            for (uint32_t i = 0; i < numHelpers; ++i) {
+                mWorkAvailable.notify_one();
+            }
+        }
+
+        job->runChunks();
+
+        // All the chunks have been claimed, so there is no point in waking up more workers.
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            auto it = std::find(mJobs.begin(), mJobs.end(), job);
+            if (it != mJobs.end()) {
+                mJobs.erase(it);
+            }
+        }
+        job->waitUntilFinished();
+    }
+
+   private:
+    ThreadPool() {
+        const uint32_t threadCount = getDefaultThreadCount();
+        mThreadCount.store(threadCount, std::memory_order_relaxed);
+        startWorkers(threadCount - 1);
+    }
+
+    void startWorkers(uint32_t numWorkers) {
+        mWorkers.reserve(numWorkers);
+        for (uint32_t i = 0; i < numWorkers; ++i) {
+            mWorkers.emplace_back([this] { workerLoop(); });
+        }
+        VLOG(CPUEXE) << "Started " << numWorkers << " CPU worker threads";
+    }
+
+    void stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mWorkAvailable.notify_all();
+        for (auto& worker : mWorkers) {
+            worker.join();
+        }
+        mWorkers.clear();
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = false;
+    }
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (true) {
+            mWorkAvailable.wait(lock, [this] { return mStopping || !mJobs.empty(); });
+            if (mStopping) {
+                return;
+            }
+            std::shared_ptr<Job> job = mJobs.front();
+            lock.unlock();
+            job->runChunks();
+            lock.lock();
+            // All the chunks of the job have been claimed.
+            if (!mJobs.empty() && mJobs.front() == job) {
+                mJobs.pop_front();
+            }
+        }
+    }
+
+    // Serializes changes to the set of worker threads.
+    std::mutex mConfigurationMutex;
+    std::atomic<uint32_t> mThreadCount = 1;
+    std::vector<std::thread> mWorkers;
+
+    // Protects mJobs and mStopping.
+    std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::deque<std::shared_ptr<Job>> mJobs;
+    bool mStopping = false;
+};
+
+}  // namespace
+
+void setCpuThreadCount(uint32_t threadCount) {
+    ThreadPool::get().setThreadCount(threadCount == 0 ? getDefaultThreadCount() : threadCount);
+}
+
+uint32_t getCpuThreadCount() {
+    return ThreadPool::get().getThreadCount();
+}
+
+ScopedCpuDeadline::ScopedCpuDeadline(const OptionalTimePoint& deadline)
+    : mPreviousDeadline(tDeadline) {
+    tDeadline = deadline;
+}
+
+ScopedCpuDeadline::~ScopedCpuDeadline() {
+    tDeadline = mPreviousDeadline;
+}
+
+bool parallelFor(uint32_t size, uint32_t minChunkSize,
+                 const std::function<bool(uint32_t begin, uint32_t end)>& fn) {
+    if (size == 0) {
+        return true;
+    }
+    const uint32_t threadCount = tIsRunningChunk ? 1 : getCpuThreadCount();
+    const uint32_t maxChunks = size / std::max(minChunkSize, 1u);
+    const uint32_t numChunks =
+            threadCount > 1 ? std::clamp(maxChunks, 1u, threadCount * kChunksPerThread) : 1;
+    if (numChunks == 1) {
+        if (hasDeadlinePassed(tDeadline)) {
+            LOG(ERROR) << "parallelFor: deadline passed before execution started";
+            return false;
+        }
+        return fn(0, size);
+    }
+
+    NNTRACE_COMP("parallelFor");
+    auto job = std::make_shared<Job>(size, numChunks, tDeadline, fn);
+    ThreadPool::get().run(job, numChunks);
+    if (job->hasMissedDeadline()) {
+        LOG(ERROR) << "parallelFor: deadline passed before all chunks were executed";
+    }
+    return !job->hasFailed();
+}
+
+}  // namespace android::nn
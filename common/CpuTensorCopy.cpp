@@ -0,0 +1,270 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "CpuTensorCopy"
+
+#include "CpuTensorCopy.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "CpuParallelFor.h"
+#include "LegacyUtils.h"
+
+namespace android::nn {
+namespace {
+
+// Copies that read and write along different axes are done in tiles of kTileSize x kTileSize
+// elements, so that the cache lines read and written by a tile stay in L1 until it is done.
+constexpr uint32_t kTileSize = 16;
+
+// Strided rows shorter than this read few enough cache lines that the lines are still in L1 for
+// the next row, which then reads their next elements, so they are copied without tiles.
+constexpr uint32_t kMinTiledRowSize = 128;
+
+// Copying fewer bytes than this takes less time than handing them over to another thread. Larger
+// elements, such as the single element that a contiguous copy is merged into, are split into
+// pieces of this size so that they can be copied in parallel too.
+constexpr size_t kMinBytesPerChunk = 1 << 16;
+
+// Copies size elements of ElementSize bytes, inputStride and outputStride bytes apart. The loop is
+// unrolled so that strided rows are not limited by its overhead.
+template <size_t ElementSize>
+void copyRow(const uint8_t* input, uint8_t* output, uint32_t size, int64_t inputStride,
+             int64_t outputStride, size_t /*elementSize*/) {
+    uint32_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        std::memcpy(output, input, ElementSize);
+        std::memcpy(output + outputStride, input + inputStride, ElementSize);
+        std::memcpy(output + 2 * outputStride, input + 2 * inputStride, ElementSize);
+        std::memcpy(output + 3 * outputStride, input + 3 * inputStride, ElementSize);
+        input += 4 * inputStride;
+        output += 4 * outputStride;
+    }
+    for (; i < size; ++i) {
+        std::memcpy(output, input, ElementSize);
+        input += inputStride;
+        output += outputStride;
+    }
+}
+
+// Copies size elements of elementSize bytes, inputStride and outputStride bytes apart.
+void copyRowWithMemcpy(const uint8_t* input, uint8_t* output, uint32_t size, int64_t inputStride,
+                       int64_t outputStride, size_t elementSize) {
+    for (uint32_t i = 0; i < size; ++i) {
+        std::memcpy(output + i * outputStride, input + i * inputStride, elementSize);
+    }
+}
+
+using RowCopier = void (*)(const uint8_t* input, uint8_t* output, uint32_t size,
+                           int64_t inputStride, int64_t outputStride, size_t elementSize);
+
+RowCopier getRowCopier(size_t elementSize) {
+    switch (elementSize) {
+        case 1:
+            return copyRow<1>;
+        case 2:
+            return copyRow<2>;
+        case 4:
+            return copyRow<4>;
+        case 8:
+            return copyRow<8>;
+        default:
+            return copyRowWithMemcpy;
+    }
+}
+
+// A simplified copy, with strides in bytes. Every index of the outer axes copies a row along
+// rowAxis, or, if tileAxis is set, a strip of kTileSize indexes of tileAxis times rowAxis.
+struct CopyPlan {
+    size_t elementSize = 0;
+    std::vector<CopyAxis> outerAxes;
+    CopyAxis rowAxis = {.size = 1};
+    std::optional<CopyAxis> tileAxis;
+};
+
+CopyPlan makeCopyPlan(size_t elementSize, const std::vector<CopyAxis>& axes) {
+    CopyPlan plan = {.elementSize = elementSize};
+    std::vector<CopyAxis> simplified;
+    const auto bytesPerElement = static_cast<int64_t>(elementSize);
+    for (const CopyAxis& axis : axes) {
+        if (axis.size == 1) continue;
+        simplified.push_back({.size = axis.size,
+                              .inputStride = axis.inputStride * bytesPerElement,
+                              .outputStride = axis.outputStride * bytesPerElement});
+    }
+
+    // Write the output in order, so that axes that are contiguous in the output are adjacent.
+    std::stable_sort(simplified.begin(), simplified.end(),
+                     [](const CopyAxis& a, const CopyAxis& b) {
+                         return std::abs(a.outputStride) > std::abs(b.outputStride);
+                     });
+
+    // Merge each axis into the next one if stepping along it is the same as stepping past the end
+    // of the next one, in both tensors.
+    std::vector<CopyAxis> merged;
+    for (const CopyAxis& axis : simplified) {
+        if (!merged.empty()) {
+            CopyAxis& previous = merged.back();
+            if (previous.inputStride == axis.inputStride * axis.size &&
+                previous.outputStride == axis.outputStride * axis.size) {
+                previous = {.size = previous.size * axis.size,
+                            .inputStride = axis.inputStride,
+                            .outputStride = axis.outputStride};
+                continue;
+            }
+        }
+        merged.push_back(axis);
+    }
+
+    // An innermost axis that is contiguous in both tensors is one large element.
+    if (!merged.empty() && merged.back().inputStride == static_cast<int64_t>(plan.elementSize) &&
+        merged.back().outputStride == static_cast<int64_t>(plan.elementSize)) {
+        plan.elementSize *= merged.back().size;
+        merged.pop_back();
+    }
+    if (merged.empty()) {
+        return plan;
+    }
+
+    plan.rowAxis = merged.back();
+    merged.pop_back();
+
+    // If long rows are written contiguously but read with a stride, look for an axis that is read
+    // contiguously, and copy tiles of both axes.
+    const auto elementStride = static_cast<int64_t>(plan.elementSize);
+    if (plan.elementSize <= sizeof(uint64_t) && plan.rowAxis.outputStride == elementStride &&
+        plan.rowAxis.inputStride != elementStride && plan.rowAxis.size >= kMinTiledRowSize) {
+        const auto tileAxis =
+                std::find_if(merged.begin(), merged.end(), [elementStride](const CopyAxis& axis) {
+                    return axis.inputStride == elementStride && axis.size >= kTileSize;
+                });
+        if (tileAxis != merged.end()) {
+            plan.tileAxis = *tileAxis;
+            merged.erase(tileAxis);
+        }
+    }
+    plan.outerAxes = std::move(merged);
+    return plan;
+}
+
+bool runCopyPlan(const CopyPlan& plan, const uint8_t* input, uint8_t* output) {
+    const RowCopier copyRows = getRowCopier(plan.elementSize);
+    const CopyAxis& row = plan.rowAxis;
+    // Every index of the outer axes is copied in parts: strips of kTileSize indexes of the tile
+    // axis, or pieces of at most kMinBytesPerChunk bytes of every element of the row.
+    const size_t pieceSize = std::min(plan.elementSize, kMinBytesPerChunk);
+    const uint64_t numParts = plan.tileAxis ? (plan.tileAxis->size + kTileSize - 1) / kTileSize
+                                            : (plan.elementSize + pieceSize - 1) / pieceSize;
+    uint64_t numTasks = numParts;
+    for (const CopyAxis& axis : plan.outerAxes) {
+        numTasks *= axis.size;
+    }
+    NN_RET_CHECK_LE(numTasks, std::numeric_limits<uint32_t>::max());
+
+    const auto copyTasks = [&](uint32_t begin, uint32_t end) {
+        // Decompose the first task into an index of each outer axis, then step through the
+        // following ones like an odometer.
+        const size_t numOuterAxes = plan.outerAxes.size();
+        std::vector<uint32_t> index(numOuterAxes);
+        int64_t inputOffset = 0;
+        int64_t outputOffset = 0;
+        uint64_t remainder = begin / numParts;
+        for (size_t k = numOuterAxes; k-- > 0;) {
+            const CopyAxis& axis = plan.outerAxes[k];
+            index[k] = remainder % axis.size;
+            remainder /= axis.size;
+            inputOffset += index[k] * axis.inputStride;
+            outputOffset += index[k] * axis.outputStride;
+        }
+        uint64_t part = begin % numParts;
+        for (uint32_t task = begin; task < end; ++task) {
+            if (!plan.tileAxis) {
+                const size_t pieceBegin = part * pieceSize;
+                const size_t pieceEnd = std::min(pieceBegin + pieceSize, plan.elementSize);
+                copyRows(input + inputOffset + pieceBegin, output + outputOffset + pieceBegin,
+                         row.size, row.inputStride, row.outputStride, pieceEnd - pieceBegin);
+            } else {
+                const CopyAxis& tile = *plan.tileAxis;
+                const uint32_t tileBegin = part * kTileSize;
+                const uint32_t tileEnd = std::min(tileBegin + kTileSize, tile.size);
+                for (uint32_t rowBegin = 0; rowBegin < row.size; rowBegin += kTileSize) {
+                    const uint32_t rowSize = std::min(kTileSize, row.size - rowBegin);
+                    for (uint32_t i = tileBegin; i < tileEnd; ++i) {
+                        copyRows(input + inputOffset + i * tile.inputStride +
+                                         rowBegin * row.inputStride,
+                                 output + outputOffset + i * tile.outputStride +
+                                         rowBegin * row.outputStride,
+                                 rowSize, row.inputStride, row.outputStride, plan.elementSize);
+                    }
+                }
+            }
+            if (++part < numParts) continue;
+            part = 0;
+            for (size_t k = numOuterAxes; k-- > 0;) {
+                const CopyAxis& axis = plan.outerAxes[k];
+                inputOffset += axis.inputStride;
+                outputOffset += axis.outputStride;
+                if (++index[k] < axis.size) break;
+                inputOffset -= static_cast<int64_t>(axis.size) * axis.inputStride;
+                outputOffset -= static_cast<int64_t>(axis.size) * axis.outputStride;
+                index[k] = 0;
+            }
+        }
+        return true;
+    };
+    const uint64_t bytesPerTask = static_cast<uint64_t>(row.size) *
+                                  (plan.tileAxis ? kTileSize * plan.elementSize : pieceSize);
+    const uint64_t minTasksPerChunk = (kMinBytesPerChunk + bytesPerTask - 1) / bytesPerTask;
+    return parallelFor(static_cast<uint32_t>(numTasks),
+                       static_cast<uint32_t>(std::min<uint64_t>(minTasksPerChunk, numTasks)),
+                       copyTasks);
+}
+
+}  // namespace
+
+std::vector<int64_t> getContiguousStrides(const std::vector<uint32_t>& dimensions) {
+    std::vector<int64_t> strides(dimensions.size());
+    int64_t stride = 1;
+    for (size_t i = dimensions.size(); i-- > 0;) {
+        strides[i] = stride;
+        stride *= dimensions[i];
+    }
+    return strides;
+}
+
+bool copyTensor(const void* input, void* output, size_t elementSize, std::vector<CopyAxis> axes) {
+    const auto isEmpty = [](const CopyAxis& axis) { return axis.size == 0; };
+    if (elementSize == 0 || std::any_of(axes.begin(), axes.end(), isEmpty)) {
+        return true;
+    }
+    return runCopyPlan(makeCopyPlan(elementSize, axes), static_cast<const uint8_t*>(input),
+                       static_cast<uint8_t*>(output));
+}
+
+bool fillTensor(const void* value, void* output, size_t elementSize, std::vector<CopyAxis> axes) {
+    for (CopyAxis& axis : axes) {
+        axis.inputStride = 0;
+    }
+    return copyTensor(value, output, elementSize, std::move(axes));
+}
+
+}  // namespace android::nn
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "CpuTensorCopy.h"
+
+namespace android::nn {
+namespace {
+
+TEST(CopyTensorTest, ContiguousAxesAreMerged) {
+    // Copies the first 4 columns of a [2, 3, 8] tensor. The two outer axes merge into one axis of
+    // 6 rows, and each row of 4 floats becomes one element.
+    std::vector<float> input(2 * 3 * 8);
+    for (size_t i = 0; i < input.size(); ++i) input[i] = i;
+    std::vector<float> output(2 * 3 * 4, -1.0f);
+    EXPECT_TRUE(copyTensor(input.data(), output.data(), sizeof(float),
+                           {{.size = 2, .inputStride = 24, .outputStride = 12},
+                            {.size = 1, .inputStride = 8, .outputStride = 4},
+                            {.size = 3, .inputStride = 8, .outputStride = 4},
+                            {.size = 4, .inputStride = 1, .outputStride = 1}}));
+    for (uint32_t row = 0; row < 6; ++row) {
+        for (uint32_t column = 0; column < 4; ++column) {
+            EXPECT_EQ(output[row * 4 + column], input[row * 8 + column])
+                    << "row " << row << " column " << column;
+        }
+    }
+}
+
+TEST(CopyTensorTest, NegativeStridesReadBackwards) {
+    // Reverses both axes of a [3, 5] tensor.
+    std::vector<int32_t> input(3 * 5);
+    for (size_t i = 0; i < input.size(); ++i) input[i] = i;
+    std::vector<int32_t> output(3 * 5, -1);
+    EXPECT_TRUE(copyTensor(input.data() + input.size() - 1, output.data(), sizeof(int32_t),
+                           {{.size = 3, .inputStride = -5, .outputStride = 5},
+                            {.size = 5, .inputStride = -1, .outputStride = 1}}));
+    for (size_t i = 0; i < output.size(); ++i) {
+        EXPECT_EQ(output[i], static_cast<int32_t>(output.size() - 1 - i)) << "index " << i;
+    }
+}
+
+TEST(CopyTensorTest, TransposeIsCopiedInTiles) {
+    // Rows long enough to be tiled, with sizes that are not multiples of the tile size.
+    constexpr uint32_t kRows = 150;
+    constexpr uint32_t kColumns = 130;
+    std::vector<uint16_t> input(kRows * kColumns);
+    for (size_t i = 0; i < input.size(); ++i) input[i] = i;
+    std::vector<uint16_t> output(kRows * kColumns);
+    EXPECT_TRUE(copyTensor(input.data(), output.data(), sizeof(uint16_t),
+                           {{.size = kColumns, .inputStride = 1, .outputStride = kRows},
+                            {.size = kRows, .inputStride = kColumns, .outputStride = 1}}));
+    for (uint32_t column = 0; column < kColumns; ++column) {
+        for (uint32_t row = 0; row < kRows; ++row) {
+            ASSERT_EQ(output[column * kRows + row], input[row * kColumns + column])
+                    << "row " << row << " column " << column;
+        }
+    }
+}
+
+TEST(CopyTensorTest, LargeContiguousCopyIsComplete) {
+    // A contiguous copy merges into a single element, which is split into pieces across threads.
+    // The size is not a multiple of the piece size.
+    std::vector<uint8_t> input(3 * 1024 * 1024 + 7);
+    for (size_t i = 0; i < input.size(); ++i) input[i] = i % 251;
+    std::vector<uint8_t> output(input.size());
+    EXPECT_TRUE(copyTensor(input.data(), output.data(), 1,
+                           {{.size = static_cast<uint32_t>(input.size()),
+                             .inputStride = 1,
+                             .outputStride = 1}}));
+    EXPECT_EQ(output, input);
+}
+
+TEST(CopyTensorTest, LargeRowsAreComplete) {
+    // Copies the first kRowSize bytes of each of 3 rows, which become 3 elements of kRowSize bytes
+    // that are each split into pieces.
+    constexpr uint32_t kRowSize = 200 * 1000;
+    constexpr uint32_t kInputRowSize = kRowSize + 16;
+    std::vector<uint8_t> input(3 * kInputRowSize);
+    for (size_t i = 0; i < input.size(); ++i) input[i] = i % 251;
+    std::vector<uint8_t> output(3 * kRowSize);
+    EXPECT_TRUE(copyTensor(input.data(), output.data(), 1,
+                           {{.size = 3, .inputStride = kInputRowSize, .outputStride = kRowSize},
+                            {.size = kRowSize, .inputStride = 1, .outputStride = 1}}));
+    for (uint32_t row = 0; row < 3; ++row) {
+        EXPECT_TRUE(std::equal(output.begin() + row * kRowSize,
+                               output.begin() + (row + 1) * kRowSize,
+                               input.begin() + row * kInputRowSize))
+                << "row " << row;
+    }
+}
+
+TEST(CopyTensorTest, EmptyCopyWritesNothing) {
+    const float input = 1.0f;
+    float output = -1.0f;
+    EXPECT_TRUE(copyTensor(&input, &output, sizeof(float),
+                           {{.size = 0, .inputStride = 1, .outputStride = 1},
+                            {.size = 4, .inputStride = 1, .outputStride = 1}}));
+    EXPECT_EQ(output, -1.0f);
+}
+
+TEST(FillTensorTest, OnlyPadRegionsAreWritten) {
+    // Pads a [2, 3] block by one element on every side of a [4, 5] tensor, one region at a time.
+    constexpr uint32_t kHeight = 4;
+    constexpr uint32_t kWidth = 5;
+    std::vector<float> output(kHeight * kWidth, 1.0f);
+    const float padValue = -2.0f;
+    // The top and bottom rows.
+    for (uint32_t row : {0u, kHeight - 1}) {
+        EXPECT_TRUE(fillTensor(&padValue, output.data() + row * kWidth, sizeof(float),
+                               {{.size = kWidth, .inputStride = 1, .outputStride = 1}}));
+    }
+    // The left and right columns of the rows in between.
+    for (uint32_t column : {0u, kWidth - 1}) {
+        EXPECT_TRUE(fillTensor(&padValue, output.data() + kWidth + column, sizeof(float),
+                               {{.size = kHeight - 2, .inputStride = 1, .outputStride = kWidth},
+                                {.size = 1, .inputStride = 1, .outputStride = 1}}));
+    }
+    for (uint32_t row = 0; row < kHeight; ++row) {
+        for (uint32_t column = 0; column < kWidth; ++column) {
+            const bool isPad =
+                    row == 0 || row == kHeight - 1 || column == 0 || column == kWidth - 1;
+            EXPECT_EQ(output[row * kWidth + column], isPad ? padValue : 1.0f)
+                    << "row " << row << " column " << column;
+        }
+    }
+}
+
+}  // namespace
+}  // namespace android::nn
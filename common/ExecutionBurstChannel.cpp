@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ExecutionBurstChannel"
+
+#include "ExecutionBurstChannel.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace android::nn {
+namespace {
+
+// Each observed latency moves the expected latency by 1/kLatencyWeight of the difference, so
+// that a few outliers do not change the schedule much.
+constexpr int64_t kLatencyWeight = 8;
+
+}  // namespace
+
+BurstPollingPolicy::BurstPollingPolicy(std::chrono::microseconds pollingTimeWindow)
+    : kPollingTimeWindow(std::max(pollingTimeWindow, std::chrono::microseconds{0})) {}
+
+BurstPollingPolicy::Schedule BurstPollingPolicy::getSchedule() const {
+    if (kPollingTimeWindow.count() == 0) {
+        return {};
+    }
+    // Until a latency is observed, poll right away as if the packet was already close.
+    if (!mHasLatency) {
+        return {.waitBeforePolling = std::chrono::nanoseconds{0},
+                .pollingDuration = kPollingTimeWindow};
+    }
+    // Center the polling time window on the expected arrival of the packet.
+    const std::chrono::nanoseconds waitBeforePolling =
+            std::max(mExpectedLatency - kPollingTimeWindow / 2, std::chrono::nanoseconds{0});
+    return {.waitBeforePolling = waitBeforePolling, .pollingDuration = kPollingTimeWindow};
+}
+
+void BurstPollingPolicy::recordLatency(std::chrono::nanoseconds latency) {
+    if (!mHasLatency) {
+        mExpectedLatency = latency;
+        mHasLatency = true;
+        return;
+    }
+    mExpectedLatency += (latency - mExpectedLatency) / kLatencyWeight;
+}
+
+}  // namespace android::nn
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ExecutionBurstChannel.h"
+#include "ExecutionBurstController.h"
+#include "ExecutionBurstServer.h"
+#include "HalInterfaces.h"
+
+namespace android::nn {
+namespace {
+
+constexpr V1_2::Timing kNoTiming = {std::numeric_limits<uint64_t>::max(),
+                                    std::numeric_limits<uint64_t>::max()};
+
+// The request and result channels of a burst whose controller and server are in the same process,
+// connected by InProcessBurstChannel. The server thread answers every request after spinning for
+// the execution time, as a driver computing on the CPU would.
+class InProcessBurst {
+   public:
+    InProcessBurst(std::chrono::microseconds executionTime,
+                   std::chrono::microseconds pollingTimeWindow) {
+        auto requestChannel = std::make_shared<InProcessBurstChannel<V1_2::FmqRequestDatum>>(
+                kExecutionBurstChannelLength);
+        auto resultChannel = std::make_shared<InProcessBurstChannel<V1_2::FmqResultDatum>>(
+                kExecutionBurstChannelLength);
+        mRequestChannelSender = std::make_unique<RequestChannelSender>(requestChannel);
+        mResultChannelReceiver =
+                std::make_unique<ResultChannelReceiver>(resultChannel, pollingTimeWindow);
+        mRequestChannelReceiver =
+                std::make_unique<RequestChannelReceiver>(requestChannel, pollingTimeWindow);
+        mResultChannelSender = std::make_unique<ResultChannelSender>(resultChannel);
+        mServer = std::thread([this, executionTime] { serve(executionTime); });
+    }
+
+    ~InProcessBurst() {
+        mRequestChannelReceiver->invalidate();
+        mServer.join();
+    }
+
+    bool compute(const V1_0::Request& request, const std::vector<int32_t>& slots) {
+        if (!mRequestChannelSender->send(request, V1_2::MeasureTiming::NO, slots)) {
+            return false;
+        }
+        return mResultChannelReceiver->getBlocking().has_value();
+    }
+
+   private:
+    void serve(std::chrono::microseconds executionTime) {
+        while (mRequestChannelReceiver->getBlocking()) {
+            const auto end = std::chrono::steady_clock::now() + executionTime;
+            while (std::chrono::steady_clock::now() < end) {
+            }
+            mResultChannelSender->send(V1_0::ErrorStatus::NONE, {}, kNoTiming);
+        }
+    }
+
+    std::unique_ptr<RequestChannelSender> mRequestChannelSender;
+    std::unique_ptr<ResultChannelReceiver> mResultChannelReceiver;
+    std::unique_ptr<RequestChannelReceiver> mRequestChannelReceiver;
+    std::unique_ptr<ResultChannelSender> mResultChannelSender;
+    std::thread mServer;
+};
+
+// A request with one image input and one output, as sent for a classification model.
+V1_0::Request createRequest() {
+    V1_0::Request request;
+    request.inputs = {{/*.hasNoValue=*/false,
+                       /*.location=*/{/*.poolIndex=*/0, /*.offset=*/0, /*.length=*/150528},
+                       /*.dimensions=*/{1, 224, 224, 3}}};
+    request.outputs = {{/*.hasNoValue=*/false,
+                        /*.location=*/{/*.poolIndex=*/1, /*.offset=*/0, /*.length=*/4004},
+                        /*.dimensions=*/{1, 1001}}};
+    request.pools.resize(2);
+    return request;
+}
+
+// Arguments: the execution time and the polling time window, in microseconds.
+// The real time is the latency of a round trip. The CPU time is the time spent by the controller
+// thread, mostly polling for the result.
+void BM_InProcessBurstRoundTrip(benchmark::State& state) {
+    InProcessBurst burst(std::chrono::microseconds{state.range(0)},
+                         std::chrono::microseconds{state.range(1)});
+    const V1_0::Request request = createRequest();
+    const std::vector<int32_t> slots = {0, 1};
+    for (auto _ : state) {
+        if (!burst.compute(request, slots)) {
+            state.SkipWithError("Burst execution failed");
+            break;
+        }
+    }
+}
+
+void addRoundTripArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"execution_us", "polling_us"});
+    for (int64_t executionTime : {0, 100, 2000}) {
+        for (int64_t pollingTimeWindow : {0, 50, 1000}) {
+            benchmark->Args({executionTime, pollingTimeWindow});
+        }
+    }
+    benchmark->Unit(benchmark::kMicrosecond)->UseRealTime();
+}
+
+BENCHMARK(BM_InProcessBurstRoundTrip)->Apply(addRoundTripArguments);
+
+}  // namespace
+}  // namespace android::nn
+
+BENCHMARK_MAIN();
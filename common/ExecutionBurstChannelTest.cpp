@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ExecutionBurstChannel.h"
+
+namespace android::nn {
+namespace {
+
+TEST(BurstPollingPolicyTest, PollingWindowFollowsExpectedLatency) {
+    using namespace std::chrono_literals;
+    const BurstPollingPolicy noPolling(0us);
+    EXPECT_EQ(noPolling.getSchedule().waitBeforePolling, 0ns);
+    EXPECT_EQ(noPolling.getSchedule().pollingDuration, 0ns);
+
+    BurstPollingPolicy policy(100us);
+    EXPECT_EQ(policy.getSchedule().waitBeforePolling, 0ns);
+    EXPECT_EQ(policy.getSchedule().pollingDuration, 100us);
+
+    // Long executions are waited for until the window around their expected completion.
+    policy.recordLatency(10ms);
+    EXPECT_EQ(policy.getSchedule().waitBeforePolling, 10ms - 50us);
+    EXPECT_EQ(policy.getSchedule().pollingDuration, 100us);
+
+    // Once executions become short, polling starts right away again.
+    for (int i = 0; i < 100; ++i) {
+        policy.recordLatency(10us);
+    }
+    EXPECT_EQ(policy.getSchedule().waitBeforePolling, 0ns);
+}
+
+TEST(InProcessBurstChannelTest, PacketsAreReceivedWholeAndInOrder) {
+    using namespace std::chrono_literals;
+    constexpr uint32_t kNumPackets = 100;
+    constexpr uint32_t kPacketSize = 3;
+    // The channel length is not a multiple of the packet size, so that packets wrap around.
+    auto channel = std::make_shared<InProcessBurstChannel<uint32_t>>(2 * kPacketSize + 1);
+    for (const auto pollingTimeWindow : {0us, 50us}) {
+        BurstPacketReceiver<uint32_t> receiver(channel, pollingTimeWindow,
+                                               /*recordLatencies=*/true);
+        std::thread sender([&channel] {
+            for (uint32_t i = 0; i < kNumPackets; ++i) {
+                const uint32_t packet[kPacketSize] = {i, i + 1, i + 2};
+                // Like the burst controller and server, only send a packet once the previous
+                // one was received.
+                while (channel->availableToRead() > 0) {
+                    std::this_thread::yield();
+                }
+                ASSERT_TRUE(channel->writeBlocking(packet, kPacketSize));
+            }
+        });
+        std::vector<uint32_t> packet;
+        for (uint32_t i = 0; i < kNumPackets; ++i) {
+            ASSERT_TRUE(receiver.getPacketBlocking(&packet));
+            EXPECT_EQ(packet, (std::vector<uint32_t>{i, i + 1, i + 2}));
+        }
+        sender.join();
+    }
+}
+
+TEST(InProcessBurstChannelTest, OnlyRecordedLatenciesDelayPolling) {
+    using namespace std::chrono_literals;
+    auto channel = std::make_shared<InProcessBurstChannel<uint32_t>>(4);
+    for (const bool recordLatencies : {false, true}) {
+        BurstPacketReceiver<uint32_t> receiver(channel, 50us, recordLatencies);
+        std::thread sender([&channel] {
+            std::this_thread::sleep_for(10ms);
+            const uint32_t packet = 0;
+            ASSERT_TRUE(channel->writeBlocking(&packet, 1));
+        });
+        std::vector<uint32_t> packet;
+        ASSERT_TRUE(receiver.getPacketBlocking(&packet));
+        sender.join();
+        const auto waitBeforePolling = receiver.getPollingPolicy().getSchedule().waitBeforePolling;
+        if (recordLatencies) {
+            EXPECT_GE(waitBeforePolling, 10ms - 25us);
+        } else {
+            EXPECT_EQ(waitBeforePolling, 0ns);
+        }
+    }
+}
+
+TEST(InProcessBurstChannelTest, InvalidationUnblocksReceiver) {
+    auto channel = std::make_shared<InProcessBurstChannel<uint32_t>>(4);
+    BurstPacketReceiver<uint32_t> receiver(channel, std::chrono::microseconds{0},
+                                           /*recordLatencies=*/true);
+    std::thread waiter([&receiver] {
+        std::vector<uint32_t> packet;
+        EXPECT_FALSE(receiver.getPacketBlocking(&packet));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    receiver.invalidate(0);
+    waiter.join();
+    EXPECT_FALSE(receiver.isValid());
+}
+
+}  // namespace
+}  // namespace android::nn
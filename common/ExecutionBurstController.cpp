@@ -21,15 +21,14 @@
 #include <android-base/logging.h>
 
 #include <algorithm>
-#include <cstring>
 #include <limits>
 #include <memory>
 #include <string>
-#include <thread>
 #include <tuple>
 #include <utility>
 #include <vector>
 
+#include "FmqBurstChannel.h"
 #include "HalInterfaces.h"
 #include "Tracing.h"
 #include "Utils.h"
@@ -69,6 +68,14 @@ class BurstContextDeathHandler : public hardware::hidl_death_recipient {
 // serialize a request into a packet
 std::vector<FmqRequestDatum> serialize(const V1_0::Request& request, V1_2::MeasureTiming measure,
                                        const std::vector<int32_t>& slots) {
+    std::vector<FmqRequestDatum> data;
+    serialize(request, measure, slots, &data);
+    return data;
+}
+
+// serialize a request into an existing packet buffer
+void serialize(const V1_0::Request& request, V1_2::MeasureTiming measure,
+               const std::vector<int32_t>& slots, std::vector<FmqRequestDatum>* packet) {
     // count how many elements need to be sent for a request
     size_t count = 2 + request.inputs.size() + request.outputs.size() + request.pools.size();
     for (const auto& input : request.inputs) {
@@ -78,8 +85,9 @@ std::vector<FmqRequestDatum> serialize(const V1_0::Request& request, V1_2::Measu
         count += output.dimensions.size();
     }
 
-    // create buffer to temporarily store elements
-    std::vector<FmqRequestDatum> data;
+    // reuse the buffer to store elements
+    std::vector<FmqRequestDatum>& data = *packet;
+    data.clear();
     data.reserve(count);
 
     // package packetInfo
@@ -142,9 +150,6 @@ std::vector<FmqRequestDatum> serialize(const V1_0::Request& request, V1_2::Measu
         datum.measureTiming(measure);
         data.push_back(datum);
     }
-
-    // return packet
-    return data;
 }
 
 // deserialize a packet into the result
@@ -255,21 +260,25 @@ ResultChannelReceiver::create(size_t channelLength, std::chrono::microseconds po
 
 ResultChannelReceiver::ResultChannelReceiver(std::unique_ptr<FmqResultChannel> fmqResultChannel,
                                              std::chrono::microseconds pollingTimeWindow)
-    : mFmqResultChannel(std::move(fmqResultChannel)), kPollingTimeWindow(pollingTimeWindow) {}
+    : ResultChannelReceiver(std::make_shared<FmqBurstChannel<FmqResultDatum>>(
+                                    std::move(fmqResultChannel)),
+                            pollingTimeWindow) {}
+
+ResultChannelReceiver::ResultChannelReceiver(
+        std::shared_ptr<IBurstChannel<FmqResultDatum>> channel,
+        std::chrono::microseconds pollingTimeWindow)
+    : mReceiver(std::move(channel), pollingTimeWindow, /*recordLatencies=*/true) {}
 
 std::optional<std::tuple<V1_0::ErrorStatus, std::vector<V1_2::OutputShape>, V1_2::Timing>>
 ResultChannelReceiver::getBlocking() {
-    const auto packet = getPacketBlocking();
-    if (!packet) {
+    if (!getPacketBlocking(&mPacket)) {
         return std::nullopt;
     }
 
-    return deserialize(*packet);
+    return deserialize(mPacket);
 }
 
 void ResultChannelReceiver::invalidate() {
-    mValid = false;
-
     // force unblock
     // ExecutionBurstController waits on a result packet after sending a
     // request. If the driver containing ExecutionBurstServer crashes, the
@@ -281,75 +290,15 @@ void ResultChannelReceiver::invalidate() {
     datum.packetInformation({/*.packetSize=*/0,
                              /*.errorStatus=*/V1_0::ErrorStatus::GENERAL_FAILURE,
                              /*.numberOfOperands=*/0});
-    mFmqResultChannel->writeBlocking(&datum, 1);
+    mReceiver.invalidate(datum);
 }
 
-std::optional<std::vector<FmqResultDatum>> ResultChannelReceiver::getPacketBlocking() {
-    if (!mValid) {
-        return std::nullopt;
-    }
-
-    // First spend time polling if results are available in FMQ instead of
-    // waiting on the futex. Polling is more responsive (yielding lower
-    // latencies), but can take up more power, so only poll for a limited period
-    // of time.
-
-    auto& getCurrentTime = std::chrono::high_resolution_clock::now;
-    const auto timeToStopPolling = getCurrentTime() + kPollingTimeWindow;
-
-    while (getCurrentTime() < timeToStopPolling) {
-        // if class is being torn down, immediately return
-        if (!mValid.load(std::memory_order_relaxed)) {
-            return std::nullopt;
-        }
-
-        // Check if data is available. If it is, immediately retrieve it and
-        // return.
-        const size_t available = mFmqResultChannel->availableToRead();
-        if (available > 0) {
-            std::vector<FmqResultDatum> packet(available);
-            const bool success = mFmqResultChannel->read(packet.data(), available);
-            if (!success) {
-                LOG(ERROR) << "Error receiving packet";
-                return std::nullopt;
-            }
-            return std::make_optional(std::move(packet));
-        }
-
-        std::this_thread::yield();
-    }
-
-    // If we get to this point, we either stopped polling because it was taking
-    // too long or polling was not allowed. Instead, perform a blocking call
-    // which uses a futex to save power.
-
-    // wait for result packet and read first element of result packet
-    FmqResultDatum datum;
-    bool success = mFmqResultChannel->readBlocking(&datum, 1);
-
-    // retrieve remaining elements
-    // NOTE: all of the data is already available at this point, so there's no
-    // need to do a blocking wait to wait for more data. This is known because
-    // in FMQ, all writes are published (made available) atomically. Currently,
-    // the producer always publishes the entire packet in one function call, so
-    // if the first element of the packet is available, the remaining elements
-    // are also available.
-    const size_t count = mFmqResultChannel->availableToRead();
-    std::vector<FmqResultDatum> packet(count + 1);
-    std::memcpy(&packet.front(), &datum, sizeof(datum));
-    success &= mFmqResultChannel->read(packet.data() + 1, count);
-
-    if (!mValid) {
-        return std::nullopt;
-    }
-
-    // ensure packet was successfully received
-    if (!success) {
-        LOG(ERROR) << "Error receiving packet";
-        return std::nullopt;
-    }
-
-    return std::make_optional(std::move(packet));
+bool ResultChannelReceiver::getPacketBlocking(std::vector<FmqResultDatum>* packet) {
+    // Polling the channel is more responsive (yielding lower latencies) than
+    // waiting on the futex, but can take up more power, so the receiver only
+    // polls for a limited period of time around the expected arrival of the
+    // result.
+    return mReceiver.getPacketBlocking(packet);
 }
 
 std::pair<std::unique_ptr<RequestChannelSender>, const FmqRequestDescriptor*>
@@ -367,12 +316,16 @@ RequestChannelSender::create(size_t channelLength) {
 }
 
 RequestChannelSender::RequestChannelSender(std::unique_ptr<FmqRequestChannel> fmqRequestChannel)
-    : mFmqRequestChannel(std::move(fmqRequestChannel)) {}
+    : RequestChannelSender(
+              std::make_shared<FmqBurstChannel<FmqRequestDatum>>(std::move(fmqRequestChannel))) {}
+
+RequestChannelSender::RequestChannelSender(std::shared_ptr<IBurstChannel<FmqRequestDatum>> channel)
+    : mChannel(std::move(channel)) {}
 
 bool RequestChannelSender::send(const V1_0::Request& request, V1_2::MeasureTiming measure,
                                 const std::vector<int32_t>& slots) {
-    const std::vector<FmqRequestDatum> serialized = serialize(request, measure, slots);
-    return sendPacket(serialized);
+    serialize(request, measure, slots, &mPacket);
+    return sendPacket(mPacket);
 }
 
 bool RequestChannelSender::sendPacket(const std::vector<FmqRequestDatum>& packet) {
@@ -380,7 +333,7 @@ bool RequestChannelSender::sendPacket(const std::vector<FmqRequestDatum>& packet
         return false;
     }
 
-    if (packet.size() > mFmqRequestChannel->availableToWrite()) {
+    if (packet.size() > mChannel->availableToWrite()) {
         LOG(ERROR)
                 << "RequestChannelSender::sendPacket -- packet size exceeds size available in FMQ";
         return false;
@@ -388,7 +341,7 @@ bool RequestChannelSender::sendPacket(const std::vector<FmqRequestDatum>& packet
 
     // Always send the packet with "blocking" because this signals the futex and
     // unblocks the consumer if it is waiting on the futex.
-    return mFmqRequestChannel->writeBlocking(packet.data(), packet.size());
+    return mChannel->writeBlocking(packet.data(), packet.size());
 }
 
 void RequestChannelSender::invalidate() {
@@ -21,7 +21,6 @@
 #include <android-base/logging.h>
 
 #include <algorithm>
-#include <cstring>
 #include <limits>
 #include <map>
 #include <memory>
@@ -30,6 +29,7 @@
 #include <utility>
 #include <vector>
 
+#include "FmqBurstChannel.h"
 #include "HalInterfaces.h"
 #include "Tracing.h"
 #include "Utils.h"
@@ -114,14 +114,23 @@ class DefaultBurstExecutorWithCache : public ExecutionBurstServer::IBurstExecuto
 std::vector<FmqResultDatum> serialize(V1_0::ErrorStatus errorStatus,
                                       const std::vector<V1_2::OutputShape>& outputShapes,
                                       V1_2::Timing timing) {
+    std::vector<FmqResultDatum> data;
+    serialize(errorStatus, outputShapes, timing, &data);
+    return data;
+}
+
+// serialize result into an existing packet buffer
+void serialize(V1_0::ErrorStatus errorStatus, const std::vector<V1_2::OutputShape>& outputShapes,
+               V1_2::Timing timing, std::vector<FmqResultDatum>* packet) {
     // count how many elements need to be sent for a request
     size_t count = 2 + outputShapes.size();
     for (const auto& outputShape : outputShapes) {
         count += outputShape.dimensions.size();
     }
 
-    // create buffer to temporarily store elements
-    std::vector<FmqResultDatum> data;
+    // reuse the buffer to store elements
+    std::vector<FmqResultDatum>& data = *packet;
+    data.clear();
     data.reserve(count);
 
     // package packetInfo
@@ -158,9 +167,6 @@ std::vector<FmqResultDatum> serialize(V1_0::ErrorStatus errorStatus,
         datum.executionTiming(timing);
         data.push_back(datum);
     }
-
-    // return result
-    return data;
 }
 
 // deserialize request
@@ -340,21 +346,25 @@ std::unique_ptr<RequestChannelReceiver> RequestChannelReceiver::create(
 
 RequestChannelReceiver::RequestChannelReceiver(std::unique_ptr<FmqRequestChannel> fmqRequestChannel,
                                                std::chrono::microseconds pollingTimeWindow)
-    : mFmqRequestChannel(std::move(fmqRequestChannel)), kPollingTimeWindow(pollingTimeWindow) {}
+    : RequestChannelReceiver(std::make_shared<FmqBurstChannel<FmqRequestDatum>>(
+                                     std::move(fmqRequestChannel)),
+                             pollingTimeWindow) {}
+
+RequestChannelReceiver::RequestChannelReceiver(
+        std::shared_ptr<IBurstChannel<FmqRequestDatum>> channel,
+        std::chrono::microseconds pollingTimeWindow)
+    : mReceiver(std::move(channel), pollingTimeWindow, /*recordLatencies=*/false) {}
 
 std::optional<std::tuple<V1_0::Request, std::vector<int32_t>, V1_2::MeasureTiming>>
 RequestChannelReceiver::getBlocking() {
-    const auto packet = getPacketBlocking();
-    if (!packet) {
+    if (!getPacketBlocking(&mPacket)) {
         return std::nullopt;
     }
 
-    return deserialize(*packet);
+    return deserialize(mPacket);
 }
 
 void RequestChannelReceiver::invalidate() {
-    mTeardown = true;
-
     // force unblock
     // ExecutionBurstServer is by default waiting on a request packet. If the
     // client process destroys its burst object, the server may still be waiting
@@ -365,90 +375,24 @@ void RequestChannelReceiver::invalidate() {
     FmqRequestDatum datum;
     datum.packetInformation({/*.packetSize=*/0, /*.numberOfInputOperands=*/0,
                              /*.numberOfOutputOperands=*/0, /*.numberOfPools=*/0});
-    mFmqRequestChannel->writeBlocking(&datum, 1);
+    mReceiver.invalidate(datum);
 }
 
-std::optional<std::vector<FmqRequestDatum>> RequestChannelReceiver::getPacketBlocking() {
-
-    if (mTeardown) {
-        return std::nullopt;
-    }
-
-    // First spend time polling if results are available in FMQ instead of
-    // waiting on the futex. Polling is more responsive (yielding lower
-    // latencies), but can take up more power, so only poll for a limited period
-    // of time.
-
-    auto& getCurrentTime = std::chrono::high_resolution_clock::now;
-    const auto timeToStopPolling = getCurrentTime() + kPollingTimeWindow;
-
-    while (getCurrentTime() < timeToStopPolling) {
-        // if class is being torn down, immediately return
-        if (mTeardown.load(std::memory_order_relaxed)) {
-            return std::nullopt;
-        }
-
-        // Check if data is available. If it is, immediately retrieve it and
-        // return.
-        const size_t available = mFmqRequestChannel->availableToRead();
-        if (available > 0) {
-            // This is the first point when we know an execution is occurring,
-            // so begin to collect systraces. Note that a similar systrace does
-            // not exist at the corresponding point in
-            // ResultChannelReceiver::getPacketBlocking because the execution is
-            // already in flight.
-            NNTRACE_FULL(NNTRACE_LAYER_IPC, NNTRACE_PHASE_EXECUTION,
-                         "ExecutionBurstServer getting packet");
-            std::vector<FmqRequestDatum> packet(available);
-            const bool success = mFmqRequestChannel->read(packet.data(), available);
-            if (!success) {
-                LOG(ERROR) << "Error receiving packet";
-                return std::nullopt;
-            }
-            return std::make_optional(std::move(packet));
-        }
-
-        std::this_thread::yield();
+bool RequestChannelReceiver::getPacketBlocking(std::vector<FmqRequestDatum>* packet) {
+    // Polling the channel is more responsive (yielding lower latencies) than
+    // waiting on the futex, but can take up more power, so the receiver only
+    // polls for a limited period of time around the expected arrival of the
+    // request.
+    if (!mReceiver.getPacketBlocking(packet)) {
+        return false;
     }
 
-    // If we get to this point, we either stopped polling because it was taking
-    // too long or polling was not allowed. Instead, perform a blocking call
-    // which uses a futex to save power.
-
-    // wait for request packet and read first element of request packet
-    FmqRequestDatum datum;
-    bool success = mFmqRequestChannel->readBlocking(&datum, 1);
-
     // This is the first point when we know an execution is occurring, so begin
     // to collect systraces. Note that a similar systrace does not exist at the
     // corresponding point in ResultChannelReceiver::getPacketBlocking because
     // the execution is already in flight.
     NNTRACE_FULL(NNTRACE_LAYER_IPC, NNTRACE_PHASE_EXECUTION, "ExecutionBurstServer getting packet");
-
-    // retrieve remaining elements
-    // NOTE: all of the data is already available at this point, so there's no
-    // need to do a blocking wait to wait for more data. This is known because
-    // in FMQ, all writes are published (made available) atomically. Currently,
-    // the producer always publishes the entire packet in one function call, so
-    // if the first element of the packet is available, the remaining elements
-    // are also available.
-    const size_t count = mFmqRequestChannel->availableToRead();
-    std::vector<FmqRequestDatum> packet(count + 1);
-    std::memcpy(&packet.front(), &datum, sizeof(datum));
-    success &= mFmqRequestChannel->read(packet.data() + 1, count);
-
-    // terminate loop
-    if (mTeardown) {
-        return std::nullopt;
-    }
-
-    // ensure packet was successfully received
-    if (!success) {
-        LOG(ERROR) << "Error receiving packet";
-        return std::nullopt;
-    }
-
-    return std::make_optional(std::move(packet));
+    return true;
 }
 
 // ResultChannelSender methods
@@ -471,17 +415,21 @@ std::unique_ptr<ResultChannelSender> ResultChannelSender::create(
 }
 
 ResultChannelSender::ResultChannelSender(std::unique_ptr<FmqResultChannel> fmqResultChannel)
-    : mFmqResultChannel(std::move(fmqResultChannel)) {}
+    : ResultChannelSender(
+              std::make_shared<FmqBurstChannel<FmqResultDatum>>(std::move(fmqResultChannel))) {}
+
+ResultChannelSender::ResultChannelSender(std::shared_ptr<IBurstChannel<FmqResultDatum>> channel)
+    : mChannel(std::move(channel)) {}
 
 bool ResultChannelSender::send(V1_0::ErrorStatus errorStatus,
                                const std::vector<V1_2::OutputShape>& outputShapes,
                                V1_2::Timing timing) {
-    const std::vector<FmqResultDatum> serialized = serialize(errorStatus, outputShapes, timing);
-    return sendPacket(serialized);
+    serialize(errorStatus, outputShapes, timing, &mPacket);
+    return sendPacket(mPacket);
 }
 
 bool ResultChannelSender::sendPacket(const std::vector<FmqResultDatum>& packet) {
-    if (packet.size() > mFmqResultChannel->availableToWrite()) {
+    if (packet.size() > mChannel->availableToWrite()) {
         LOG(ERROR)
                 << "ResultChannelSender::sendPacket -- packet size exceeds size available in FMQ";
         const std::vector<FmqResultDatum> errorPacket =
@@ -489,12 +437,12 @@ bool ResultChannelSender::sendPacket(const std::vector<FmqResultDatum>& packet)
 
         // Always send the packet with "blocking" because this signals the futex
         // and unblocks the consumer if it is waiting on the futex.
-        return mFmqResultChannel->writeBlocking(errorPacket.data(), errorPacket.size());
+        return mChannel->writeBlocking(errorPacket.data(), errorPacket.size());
     }
 
     // Always send the packet with "blocking" because this signals the futex and
     // unblocks the consumer if it is waiting on the futex.
-    return mFmqResultChannel->writeBlocking(packet.data(), packet.size());
+    return mChannel->writeBlocking(packet.data(), packet.size());
 }
 
 // ExecutionBurstServer methods
@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <new>
 #include <sstream>
 #include <vector>
 
@@ -34,6 +35,62 @@ namespace nn {
 
 namespace {
 
+void* allocateAligned(size_t size) {
+    return ::operator new(size, std::align_val_t{ScratchWorkspace::kAlignment}, std::nothrow);
+}
+
+void freeAligned(void* block) {
+    ::operator delete(block, std::align_val_t{ScratchWorkspace::kAlignment});
+}
+
+}  // namespace
+
+ScratchWorkspace::~ScratchWorkspace() {
+    reset();
+    freeAligned(mBlock);
+}
+
+void* ScratchWorkspace::allocate(size_t size) {
+    // Bounding the size keeps mUsed from overflowing.
+    if (size > std::numeric_limits<uint32_t>::max()) {
+        LOG(ERROR) << "ScratchWorkspace::allocate -- size " << size << " is too large";
+        return nullptr;
+    }
+    const size_t alignedSize = std::max(size + (kAlignment - 1), kAlignment) & ~(kAlignment - 1);
+    const size_t offset = mUsed.fetch_add(alignedSize, std::memory_order_relaxed);
+    if (offset <= mCapacity && alignedSize <= mCapacity - offset) {
+        return mBlock + offset;
+    }
+
+    // The allocation gets its own block until the next reset() grows mBlock.
+    void* block = allocateAligned(alignedSize);
+    if (block == nullptr) {
+        LOG(ERROR) << "ScratchWorkspace::allocate -- failed to allocate " << alignedSize
+                   << " bytes";
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mOverflowMutex);
+    mOverflowBlocks.push_back(block);
+    ++mNumAllocations;
+    return block;
+}
+
+void ScratchWorkspace::reset() {
+    for (void* block : mOverflowBlocks) {
+        freeAligned(block);
+    }
+    mOverflowBlocks.clear();
+    const size_t used = mUsed.exchange(0, std::memory_order_relaxed);
+    if (used > mCapacity) {
+        freeAligned(mBlock);
+        mBlock = static_cast<uint8_t*>(allocateAligned(used));
+        mCapacity = mBlock != nullptr ? used : 0;
+        ++mNumAllocations;
+    }
+}
+
+namespace {
+
 void CalculateActivationRangeImpl(int32_t activation, const Shape& outputShape, int32_t qmin,
                                   int32_t qmax, int32_t* act_min, int32_t* act_max) {
     const auto scale = outputShape.scale;
@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ShapeInference"
+
+#include "ShapeInference.h"
+
+#include <android-base/logging.h>
+#include <android-base/macros.h>
+
+#include <optional>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "CpuExecutor.h"
+#include "LegacyUtils.h"
+#include "OperationsExecutionUtils.h"
+#include "nnapi/TypeUtils.h"
+#include "nnapi/Types.h"
+
+namespace android::nn {
+namespace {
+
+// Whether an operand of a non-extension type has dimensions that are not fully specified.
+bool hasUnspecifiedDimensions(OperandType type, const Dimensions& dimensions) {
+    return !isNonExtensionScalar(type) && tensorHasUnspecifiedDimensions(type, dimensions);
+}
+
+// The values of the constant operands of a model. Memory pools are only mapped when a value they
+// hold is read.
+class ConstantValues {
+    DISALLOW_IMPLICIT_CONSTRUCTORS(ConstantValues);
+
+   public:
+    explicit ConstantValues(const Model& model) : kModel(model), mPools(model.pools.size()) {}
+
+    // Returns the value of an operand, or nullptr if it is not known before execution or its
+    // memory pool cannot be mapped.
+    const void* get(const Operand& operand) {
+        const DataLocation& location = operand.location;
+        switch (operand.lifetime) {
+            case Operand::LifeTime::CONSTANT_COPY:
+                if (location.offset + location.length > kModel.operandValues.size()) {
+                    return nullptr;
+                }
+                return kModel.operandValues.data() + location.offset;
+            case Operand::LifeTime::CONSTANT_REFERENCE: {
+                const RunTimePoolInfo* pool = getPool(location.poolIndex);
+                if (pool == nullptr ||
+                    static_cast<uint64_t>(location.offset) + location.length > pool->getSize()) {
+                    return nullptr;
+                }
+                return pool->getBuffer() + location.offset;
+            }
+            case Operand::LifeTime::POINTER:
+                return std::visit([](auto* pointer) { return static_cast<const void*>(pointer); },
+                                  location.pointer);
+            default:
+                return nullptr;
+        }
+    }
+
+   private:
+    const RunTimePoolInfo* getPool(uint32_t poolIndex) {
+        if (poolIndex >= mPools.size()) {
+            return nullptr;
+        }
+        auto& pool = mPools[poolIndex];
+        if (!pool.has_value()) {
+            pool.emplace(RunTimePoolInfo::createFromMemory(kModel.pools[poolIndex]));
+        }
+        return pool->has_value() ? &pool->value() : nullptr;
+    }
+
+    const Model& kModel;
+    // An empty outer optional means that the pool has not been mapped yet, an empty inner
+    // optional that it cannot be mapped.
+    std::vector<std::optional<std::optional<RunTimePoolInfo>>> mPools;
+};
+
+// Runs the prepare() function of an operation on the shapes known before execution.
+//
+// Inputs whose value is only known during execution read as zeros. prepare() rarely reads them,
+// and the shapes it computes after reading one are not used (see readsRuntimeValue()).
+class ShapeInferenceContext : public IOperationExecutionContext {
+    DISALLOW_IMPLICIT_CONSTRUCTORS(ShapeInferenceContext);
+
+   public:
+    ShapeInferenceContext(const Operation& operation, const std::vector<Operand>& operands,
+                          const std::vector<Dimensions>& dimensions, ConstantValues* constants,
+                          ScratchWorkspace* scratchWorkspace)
+        : kOperation(operation),
+          kOperands(operands),
+          kDimensions(dimensions),
+          mConstants(constants),
+          mScratchWorkspace(scratchWorkspace) {
+        mOutputDimensions.reserve(operation.outputs.size());
+        for (uint32_t output : operation.outputs) {
+            mOutputDimensions.push_back(dimensions[output]);
+        }
+    }
+
+    uint32_t getNumInputs() const override { return kOperation.inputs.size(); }
+    OperandType getInputType(uint32_t index) const override { return getInput(index).type; }
+    Shape getInputShape(uint32_t index) const override {
+        return getInputShapeView(index).toShape();
+    }
+    ShapeView getInputShapeView(uint32_t index) const override {
+        const Operand& operand = getInput(index);
+        return ShapeView(operand.type, kDimensions[kOperation.inputs[index]], operand.scale,
+                         operand.zeroPoint, operand.extraParams);
+    }
+    const void* getInputBuffer(uint32_t index) const override;
+    const Operand::ExtraParams& getInputExtraParams(uint32_t index) const override {
+        return getInput(index).extraParams;
+    }
+
+    uint32_t getNumOutputs() const override { return kOperation.outputs.size(); }
+    OperandType getOutputType(uint32_t index) const override { return getOutput(index).type; }
+    Shape getOutputShape(uint32_t index) const override {
+        return getOutputShapeView(index).toShape();
+    }
+    ShapeView getOutputShapeView(uint32_t index) const override {
+        const Operand& operand = getOutput(index);
+        return ShapeView(operand.type, mOutputDimensions[index], operand.scale, operand.zeroPoint,
+                         operand.extraParams);
+    }
+    // Outputs have no buffer before execution.
+    void* getOutputBuffer(uint32_t /*index*/) override { return nullptr; }
+
+    bool setOutputShape(uint32_t index, const Shape& shape) override;
+
+    bool isOmittedInput(uint32_t index) const override {
+        return getInput(index).lifetime == Operand::LifeTime::NO_VALUE;
+    }
+    bool isOmittedOutput(uint32_t index) const override {
+        return getOutput(index).lifetime == Operand::LifeTime::NO_VALUE;
+    }
+
+    ScratchWorkspace* getScratchWorkspace() override { return mScratchWorkspace; }
+
+    // Whether prepare() read the value of an input that is only known during execution, in which
+    // case the output shapes may differ between executions.
+    bool readsRuntimeValue() const { return mReadsRuntimeValue; }
+
+    // The dimensions of an output, combined from its declared dimensions and the shape set by
+    // prepare().
+    const Dimensions& getOutputDimensions(uint32_t index) const {
+        return mOutputDimensions.at(index);
+    }
+
+   private:
+    const Operand& getInput(uint32_t index) const {
+        CHECK(index < kOperation.inputs.size());
+        return kOperands[kOperation.inputs[index]];
+    }
+    const Operand& getOutput(uint32_t index) const {
+        CHECK(index < kOperation.outputs.size());
+        return kOperands[kOperation.outputs[index]];
+    }
+
+    const Operation& kOperation;
+    const std::vector<Operand>& kOperands;
+    const std::vector<Dimensions>& kDimensions;
+    ConstantValues* mConstants;
+    ScratchWorkspace* mScratchWorkspace;
+    std::vector<Dimensions> mOutputDimensions;
+    mutable bool mReadsRuntimeValue = false;
+    mutable std::vector<std::vector<uint8_t>> mZeroBuffers;
+};
+
+const void* ShapeInferenceContext::getInputBuffer(uint32_t index) const {
+    const Operand& operand = getInput(index);
+    if (operand.lifetime == Operand::LifeTime::NO_VALUE) {
+        return nullptr;
+    }
+    if (const void* value = mConstants->get(operand); value != nullptr) {
+        return value;
+    }
+    mReadsRuntimeValue = true;
+    const uint32_t length =
+            nonExtensionOperandSizeOfData(operand.type, kDimensions[kOperation.inputs[index]]);
+    return mZeroBuffers.emplace_back(length).data();
+}
+
+bool ShapeInferenceContext::setOutputShape(uint32_t index, const Shape& shape) {
+    CHECK(index < mOutputDimensions.size());
+    auto combined = combineDimensions(shape.dimensions, mOutputDimensions[index]);
+    if (!combined.has_value()) {
+        VLOG(MODEL) << "inferTemporaryShapes: invalid dimensions for output " << index << " of "
+                    << kOperation.type << ": " << combined.error();
+        return false;
+    }
+    mOutputDimensions[index] = std::move(combined).value();
+    return true;
+}
+
+// Returns the registration whose prepare() function computes the output shapes of an operation,
+// or nullptr if they cannot be computed before execution.
+const OperationRegistration* findInferableOperation(const Model::Subgraph& subgraph,
+                                                    const Operation& operation,
+                                                    const std::vector<Dimensions>& dimensions,
+                                                    ConstantValues* constants,
+                                                    const IOperationResolver* operationResolver) {
+    if (operation.type == OperationType::OEM_OPERATION || isExtension(operation.type)) {
+        return nullptr;
+    }
+    const OperationRegistration* registration = operationResolver->findOperation(operation.type);
+    if (registration == nullptr || registration->prepare == nullptr) {
+        return nullptr;
+    }
+    // There is nothing to infer if the outputs are already specified.
+    bool hasUnspecifiedOutput = false;
+    for (uint32_t output : operation.outputs) {
+        const Operand& operand = subgraph.operands[output];
+        if (isExtension(operand.type)) {
+            return nullptr;
+        }
+        if (operand.lifetime == Operand::LifeTime::NO_VALUE) {
+            if (!registration->flags.allowOmittedOperand) {
+                return nullptr;
+            }
+            continue;
+        }
+        hasUnspecifiedOutput |= hasUnspecifiedDimensions(operand.type, dimensions[output]);
+    }
+    if (!hasUnspecifiedOutput) {
+        return nullptr;
+    }
+    for (uint32_t input : operation.inputs) {
+        const Operand& operand = subgraph.operands[input];
+        if (operand.lifetime == Operand::LifeTime::NO_VALUE) {
+            if (!registration->flags.allowOmittedOperand) {
+                return nullptr;
+            }
+            continue;
+        }
+        if (isExtension(operand.type) || operand.lifetime == Operand::LifeTime::SUBGRAPH ||
+            hasUnspecifiedDimensions(operand.type, dimensions[input])) {
+            return nullptr;
+        }
+        // Scalars and TENSOR_INT32 operands hold parameters such as axes, sizes and paddings,
+        // which prepare() reads and may divide by or index with.
+        if ((isNonExtensionScalar(operand.type) || operand.type == OperandType::TENSOR_INT32) &&
+            constants->get(operand) == nullptr) {
+            return nullptr;
+        }
+    }
+    return registration;
+}
+
+}  // namespace
+
+uint32_t inferTemporaryShapes(Model* model, const IOperationResolver* operationResolver) {
+    CHECK(model != nullptr);
+    CHECK(operationResolver != nullptr);
+    Model::Subgraph& main = model->main;
+
+    // The dimensions known so far, including those inferred for operands that are not
+    // temporaries, which are propagated but not written to the model.
+    std::vector<Dimensions> dimensions;
+    dimensions.reserve(main.operands.size());
+    for (const Operand& operand : main.operands) {
+        dimensions.push_back(operand.dimensions);
+    }
+
+    ConstantValues constants(*model);
+    ScratchWorkspace scratchWorkspace;
+    uint32_t inferredCount = 0;
+    // Operations are sorted in execution order, so a single pass propagates the shapes through
+    // the whole subgraph.
+    for (const Operation& operation : main.operations) {
+        const OperationRegistration* registration = findInferableOperation(
+                main, operation, dimensions, &constants, operationResolver);
+        if (registration == nullptr) continue;
+        ShapeInferenceContext context(operation, main.operands, dimensions, &constants,
+                                      &scratchWorkspace);
+        const bool prepared = registration->prepare(&context);
+        scratchWorkspace.reset();
+        if (!prepared || context.readsRuntimeValue()) {
+            VLOG(MODEL) << "inferTemporaryShapes: cannot infer the output shapes of "
+                        << operation.type;
+            continue;
+        }
+        for (uint32_t i = 0; i < operation.outputs.size(); ++i) {
+            const uint32_t output = operation.outputs[i];
+            Operand& operand = main.operands[output];
+            const Dimensions& inferred = context.getOutputDimensions(i);
+            if (operand.lifetime == Operand::LifeTime::NO_VALUE ||
+                hasUnspecifiedDimensions(operand.type, inferred) ||
+                nonExtensionOperandSizeOfDataOverflowsUInt32(operand.type, inferred)) {
+                continue;
+            }
+            dimensions[output] = inferred;
+            if (operand.lifetime == Operand::LifeTime::TEMPORARY_VARIABLE &&
+                hasUnspecifiedDimensions(operand.type, operand.dimensions)) {
+                operand.dimensions = inferred;
+                ++inferredCount;
+            }
+        }
+    }
+    VLOG(MODEL) << "inferTemporaryShapes specified the dimensions of " << inferredCount
+                << " temporaries";
+    return inferredCount;
+}
+
+}  // namespace android::nn
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+#include "SizeClassPool.h"
+
+namespace android::nn {
+namespace {
+
+TEST(SizeClassPoolTest, SizeClassesBoundUnusedSpace) {
+    EXPECT_EQ(getSizeClass(1), 64u);
+    EXPECT_EQ(getSizeClass(64), 64u);
+    EXPECT_EQ(getSizeClass(65), 80u);
+    EXPECT_EQ(getSizeClass(128), 128u);
+    EXPECT_EQ(getSizeClass(129), 160u);
+    for (size_t size = 1; size < 100000; size += 7) {
+        const size_t sizeClass = getSizeClass(size);
+        EXPECT_GE(sizeClass, size);
+        EXPECT_LE(sizeClass, std::max<size_t>(64, size + size / 4));
+    }
+}
+
+TEST(SizeClassPoolTest, ReleasedResourcesAreReusedUpToLimit) {
+    SizeClassPool<std::unique_ptr<int>> pool(/*maxCachedResources=*/10, /*maxCachedBytes=*/100);
+    EXPECT_FALSE(pool.acquire(64).has_value());
+    pool.release(64, std::make_unique<int>(1));
+    pool.release(64, std::make_unique<int>(2));
+    EXPECT_EQ(pool.getStatistics().cachedBytes, 64u);
+    EXPECT_EQ(pool.getStatistics().numDiscards, 1u);
+    EXPECT_FALSE(pool.acquire(32).has_value());
+    auto resource = pool.acquire(64);
+    ASSERT_TRUE(resource.has_value());
+    EXPECT_EQ(**resource, 1);
+
+    pool.release(32, std::move(*resource));
+    pool.trim();
+    EXPECT_FALSE(pool.acquire(32).has_value());
+    const PoolStatistics statistics = pool.getStatistics();
+    EXPECT_EQ(statistics.numAcquires, 4u);
+    EXPECT_EQ(statistics.numReuses, 1u);
+    EXPECT_EQ(statistics.numReleases, 3u);
+    EXPECT_EQ(statistics.numTrims, 1u);
+    EXPECT_EQ(statistics.numCachedResources, 0u);
+    EXPECT_EQ(statistics.cachedBytes, 0u);
+}
+
+TEST(SizeClassPoolTest, NumberOfCachedResourcesIsLimited) {
+    SizeClassPool<std::unique_ptr<int>> pool(/*maxCachedResources=*/2, /*maxCachedBytes=*/1000);
+    for (int i = 0; i < 3; ++i) {
+        pool.release(64, std::make_unique<int>(i));
+    }
+    EXPECT_EQ(pool.getStatistics().numCachedResources, 2u);
+    EXPECT_EQ(pool.getStatistics().numDiscards, 1u);
+}
+
+}  // namespace
+}  // namespace android::nn
@@ -17,18 +17,29 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <limits>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "CpuExecutor.h"
+#include "CpuInternalOperations.h"
+#include "CpuOperationFusion.h"
+#include "CpuParallelFor.h"
 #include "HalInterfaces.h"
 #include "MemoryUtils.h"
 #include "OperationsExecutionUtils.h"
 #include "QuantUtils.h"
+#include "ShapeInference.h"
 #include "Utils.h"
 #include "ValidateHal.h"
 #include "nnapi/TypeUtils.h"
 #include "nnapi/Types.h"
+#include "nnapi/Validation.h"
 
 namespace android {
 namespace nn {
@@ -36,6 +47,7 @@ namespace wrapper {
 
 namespace {
 using ::testing::ElementsAreArray;
+using ::testing::HasSubstr;
 }  // namespace
 
 TEST(CalculateBroadcastedShapeTest, Basic) {
@@ -217,6 +229,1083 @@ TEST(ValidateRequestTest, ScalarOutput) {
     EXPECT_TRUE(validateRequest(request, model, /*allowUnspecifiedOutput=*/false));
 }
 
+TEST(FuseOperationsForCpuTest, ActivationIsFusedIntoProducer) {
+    Model model;
+    const int32_t activation = static_cast<int32_t>(FusedActivationFunc::NONE);
+    const Operand tensor = {.type = OperandType::TENSOR_FLOAT32, .dimensions = {2}};
+    auto makeOperand = [&tensor](Operand::LifeTime lifetime) {
+        Operand operand = tensor;
+        operand.lifetime = lifetime;
+        return operand;
+    };
+    model.main.operands = {
+            makeOperand(Operand::LifeTime::SUBGRAPH_INPUT),
+            makeOperand(Operand::LifeTime::SUBGRAPH_INPUT),
+            {.type = OperandType::INT32,
+             .lifetime = Operand::LifeTime::CONSTANT_COPY,
+             .location = model.operandValues.append(reinterpret_cast<const uint8_t*>(&activation),
+                                                    sizeof(activation))},
+            makeOperand(Operand::LifeTime::TEMPORARY_VARIABLE),
+            makeOperand(Operand::LifeTime::SUBGRAPH_OUTPUT),
+    };
+    model.main.operations = {
+            {.type = OperationType::ADD, .inputs = {0, 1, 2}, .outputs = {3}},
+            {.type = OperationType::RELU6, .inputs = {3}, .outputs = {4}},
+    };
+    model.main.inputIndexes = {0, 1};
+    model.main.outputIndexes = {4};
+    ASSERT_TRUE(validate(model).ok());
+
+    EXPECT_EQ(fuseOperationsForCpu(&model), 1u);
+    ASSERT_TRUE(validate(model).ok());
+    ASSERT_EQ(model.main.operations.size(), 1u);
+    const Operation& add = model.main.operations[0];
+    EXPECT_EQ(add.type, OperationType::ADD);
+    ASSERT_EQ(add.outputs.size(), 1u);
+    EXPECT_EQ(add.outputs[0], model.main.outputIndexes[0]);
+    const Operand& fusedActivation = model.main.operands[add.inputs[2]];
+    ASSERT_EQ(fusedActivation.lifetime, Operand::LifeTime::CONSTANT_COPY);
+    int32_t value;
+    std::memcpy(&value, model.operandValues.data() + fusedActivation.location.offset,
+                sizeof(value));
+    EXPECT_EQ(value, static_cast<int32_t>(FusedActivationFunc::RELU6));
+}
+
+TEST(FuseOperationsForCpuTest, SharedIntermediateIsNotFused) {
+    Model model;
+    const int32_t activation = static_cast<int32_t>(FusedActivationFunc::NONE);
+    const Operand tensor = {.type = OperandType::TENSOR_FLOAT32, .dimensions = {2}};
+    auto makeOperand = [&tensor](Operand::LifeTime lifetime) {
+        Operand operand = tensor;
+        operand.lifetime = lifetime;
+        return operand;
+    };
+    model.main.operands = {
+            makeOperand(Operand::LifeTime::SUBGRAPH_INPUT),
+            makeOperand(Operand::LifeTime::SUBGRAPH_INPUT),
+            {.type = OperandType::INT32,
+             .lifetime = Operand::LifeTime::CONSTANT_COPY,
+             .location = model.operandValues.append(reinterpret_cast<const uint8_t*>(&activation),
+                                                    sizeof(activation))},
+            makeOperand(Operand::LifeTime::TEMPORARY_VARIABLE),
+            makeOperand(Operand::LifeTime::SUBGRAPH_OUTPUT),
+            makeOperand(Operand::LifeTime::SUBGRAPH_OUTPUT),
+    };
+    model.main.operations = {
+            {.type = OperationType::ADD, .inputs = {0, 1, 2}, .outputs = {3}},
+            {.type = OperationType::RELU, .inputs = {3}, .outputs = {4}},
+            {.type = OperationType::ADD, .inputs = {3, 1, 2}, .outputs = {5}},
+    };
+    model.main.inputIndexes = {0, 1};
+    model.main.outputIndexes = {4, 5};
+    ASSERT_TRUE(validate(model).ok());
+
+    EXPECT_EQ(fuseOperationsForCpu(&model), 0u);
+    EXPECT_EQ(model.main.operations.size(), 3u);
+}
+
+// Builds CONV_2D followed by MAX_POOL_2D, both in NCHW, on a 1x2x4x4 input. The pooling is
+// omitted if withPooling is false.
+Model createNchwConvModel(bool withPooling) {
+    Model model;
+    auto addConstant = [&model](OperandType type, std::vector<uint32_t> dimensions,
+                                const void* data, size_t length) {
+        model.main.operands.push_back({.type = type,
+                                       .dimensions = std::move(dimensions),
+                                       .lifetime = Operand::LifeTime::CONSTANT_COPY,
+                                       .location = model.operandValues.append(
+                                               static_cast<const uint8_t*>(data), length)});
+        return static_cast<uint32_t>(model.main.operands.size() - 1);
+    };
+    const Operand tensor = {.type = OperandType::TENSOR_FLOAT32, .dimensions = {1, 2, 4, 4}};
+    auto addTensor = [&model, &tensor](Operand::LifeTime lifetime) {
+        Operand operand = tensor;
+        operand.lifetime = lifetime;
+        model.main.operands.push_back(std::move(operand));
+        return static_cast<uint32_t>(model.main.operands.size() - 1);
+    };
+    const float filter[] = {1.0f, 2.0f, 3.0f, 4.0f};
+    const float bias[] = {0.5f, -0.5f};
+    const int32_t padding = kPaddingSame, one = 1, two = 2;
+    const int32_t activation = static_cast<int32_t>(FusedActivationFunc::NONE);
+    const bool8 useNchw = true;
+
+    const uint32_t input = addTensor(Operand::LifeTime::SUBGRAPH_INPUT);
+    const uint32_t filterOperand =
+            addConstant(OperandType::TENSOR_FLOAT32, {2, 1, 1, 2}, filter, sizeof(filter));
+    const uint32_t biasOperand = addConstant(OperandType::TENSOR_FLOAT32, {2}, bias, sizeof(bias));
+    const uint32_t paddingOperand = addConstant(OperandType::INT32, {}, &padding, sizeof(padding));
+    const uint32_t oneOperand = addConstant(OperandType::INT32, {}, &one, sizeof(one));
+    const uint32_t twoOperand = addConstant(OperandType::INT32, {}, &two, sizeof(two));
+    const uint32_t activationOperand =
+            addConstant(OperandType::INT32, {}, &activation, sizeof(activation));
+    const uint32_t layoutOperand = addConstant(OperandType::BOOL, {}, &useNchw, sizeof(useNchw));
+    const uint32_t convOutput = addTensor(withPooling ? Operand::LifeTime::TEMPORARY_VARIABLE
+                                                      : Operand::LifeTime::SUBGRAPH_OUTPUT);
+    model.main.operations.push_back({.type = OperationType::CONV_2D,
+                                     .inputs = {input, filterOperand, biasOperand, paddingOperand,
+                                                oneOperand, oneOperand, activationOperand,
+                                                layoutOperand},
+                                     .outputs = {convOutput}});
+    uint32_t output = convOutput;
+    if (withPooling) {
+        output = addTensor(Operand::LifeTime::SUBGRAPH_OUTPUT);
+        model.main.operations.push_back(
+                {.type = OperationType::MAX_POOL_2D,
+                 .inputs = {convOutput, paddingOperand, oneOperand, oneOperand, twoOperand,
+                            twoOperand, activationOperand, layoutOperand},
+                 .outputs = {output}});
+    }
+    model.main.inputIndexes = {input};
+    model.main.outputIndexes = {output};
+    return model;
+}
+
+TEST(AssignLayoutsForCpuTest, NchwChainRunsInNhwc) {
+    Model model = createNchwConvModel(/*withPooling=*/true);
+    ASSERT_TRUE(validate(model).ok());
+
+    EXPECT_EQ(assignLayoutsForCpu(&model), 2u);
+    ASSERT_TRUE(validate(model).ok());
+    ASSERT_EQ(model.main.operations.size(), 4u);
+    EXPECT_EQ(model.main.operations[0].type, OperationType::TRANSPOSE);
+    EXPECT_EQ(model.main.operations[1].type, OperationType::CONV_2D);
+    EXPECT_EQ(model.main.operations[2].type, OperationType::MAX_POOL_2D);
+    EXPECT_EQ(model.main.operations[3].type, OperationType::TRANSPOSE);
+    EXPECT_EQ(model.main.operations[0].inputs[0], model.main.inputIndexes[0]);
+    EXPECT_EQ(model.main.operations[3].outputs[0], model.main.outputIndexes[0]);
+
+    const Operation& conv = model.main.operations[1];
+    const Operand& intermediate = model.main.operands[conv.outputs[0]];
+    EXPECT_EQ(intermediate.dimensions, (std::vector<uint32_t>{1, 4, 4, 2}));
+    const Operand& layout = model.main.operands[conv.inputs[7]];
+    ASSERT_EQ(layout.lifetime, Operand::LifeTime::CONSTANT_COPY);
+    EXPECT_EQ(model.operandValues.data()[layout.location.offset], 0);
+    const Operand& output = model.main.operands[model.main.outputIndexes[0]];
+    EXPECT_EQ(output.dimensions, (std::vector<uint32_t>{1, 2, 4, 4}));
+}
+
+TEST(AssignLayoutsForCpuTest, SingleNchwOperationIsNotRewritten) {
+    Model model = createNchwConvModel(/*withPooling=*/false);
+    ASSERT_TRUE(validate(model).ok());
+
+    EXPECT_EQ(assignLayoutsForCpu(&model), 0u);
+    ASSERT_EQ(model.main.operations.size(), 1u);
+    EXPECT_EQ(model.main.operations[0].type, OperationType::CONV_2D);
+}
+
+// Builds two TRANSPOSE_CONV_2D operations in NCHW, upsampling a 1x2x2x3 input to 1x2x3x6 and then
+// to 1x2x5x12. The operations use implicit padding, which is computed from their output_shape
+// input, if implicitPadding is true, and explicit padding otherwise. The heights are odd and the
+// widths even so that the padding differs between the two.
+Model createNchwTransposeConvModel(bool implicitPadding) {
+    Model model;
+    auto addOperand = [&model](OperandType type, std::vector<uint32_t> dimensions,
+                               Operand::LifeTime lifetime, const void* data = nullptr,
+                               size_t length = 0) {
+        Operand operand = {.type = type, .dimensions = std::move(dimensions), .lifetime = lifetime};
+        if (data != nullptr) {
+            operand.location =
+                    model.operandValues.append(static_cast<const uint8_t*>(data), length);
+        }
+        model.main.operands.push_back(std::move(operand));
+        return static_cast<uint32_t>(model.main.operands.size() - 1);
+    };
+    auto addScalar = [&addOperand](OperandType type, const auto& value) {
+        return addOperand(type, {}, Operand::LifeTime::CONSTANT_COPY, &value, sizeof(value));
+    };
+    std::vector<float> filter(2 * 3 * 3 * 2);
+    for (size_t i = 0; i < filter.size(); ++i) {
+        filter[i] = static_cast<float>(i % 7) * 0.25f - 0.5f;
+    }
+    const float bias[] = {0.5f, -0.5f};
+    const int32_t activation = static_cast<int32_t>(FusedActivationFunc::NONE);
+    const bool8 useNchw = true;
+
+    const uint32_t input = addOperand(OperandType::TENSOR_FLOAT32, {1, 2, 2, 3},
+                                      Operand::LifeTime::SUBGRAPH_INPUT);
+    const uint32_t filterOperand =
+            addOperand(OperandType::TENSOR_FLOAT32, {2, 3, 3, 2}, Operand::LifeTime::CONSTANT_COPY,
+                       filter.data(), filter.size() * sizeof(float));
+    const uint32_t biasOperand = addOperand(OperandType::TENSOR_FLOAT32, {2},
+                                            Operand::LifeTime::CONSTANT_COPY, bias, sizeof(bias));
+    const uint32_t zero = addScalar(OperandType::INT32, int32_t{0});
+    const uint32_t one = addScalar(OperandType::INT32, int32_t{1});
+    const uint32_t two = addScalar(OperandType::INT32, int32_t{2});
+    const uint32_t paddingSame = addScalar(OperandType::INT32, int32_t{kPaddingSame});
+    const uint32_t activationOperand = addScalar(OperandType::INT32, activation);
+    const uint32_t layoutOperand = addScalar(OperandType::BOOL, useNchw);
+    auto addTransposeConv = [&](uint32_t convInput, std::vector<uint32_t> outputDimensions,
+                                Operand::LifeTime lifetime) {
+        const uint32_t output =
+                addOperand(OperandType::TENSOR_FLOAT32, outputDimensions, lifetime);
+        std::vector<uint32_t> inputs = {convInput, filterOperand, biasOperand};
+        if (implicitPadding) {
+            const std::vector<int32_t> outputShape(outputDimensions.begin(),
+                                                   outputDimensions.end());
+            inputs.push_back(addOperand(OperandType::TENSOR_INT32, {4},
+                                        Operand::LifeTime::CONSTANT_COPY, outputShape.data(),
+                                        outputShape.size() * sizeof(int32_t)));
+            inputs.insert(inputs.end(), {paddingSame, two, two});
+        } else {
+            // The padding computed for kPaddingSame: with a 3x3 filter and a stride of 2, one row
+            // at each end for an odd height and one column at the end for an even width.
+            inputs.insert(inputs.end(), {zero, one, one, one, two, two});
+        }
+        inputs.insert(inputs.end(), {activationOperand, layoutOperand});
+        model.main.operations.push_back({.type = OperationType::TRANSPOSE_CONV_2D,
+                                         .inputs = std::move(inputs),
+                                         .outputs = {output}});
+        return output;
+    };
+    const uint32_t intermediate =
+            addTransposeConv(input, {1, 2, 3, 6}, Operand::LifeTime::TEMPORARY_VARIABLE);
+    const uint32_t output =
+            addTransposeConv(intermediate, {1, 2, 5, 12}, Operand::LifeTime::SUBGRAPH_OUTPUT);
+    model.main.inputIndexes = {input};
+    model.main.outputIndexes = {output};
+    return model;
+}
+
+// Runs a model with a single TENSOR_FLOAT32 input and output on the CPU.
+std::vector<float> runFloatModel(const Model& model, std::vector<float> input,
+                                 size_t outputSize) {
+    std::vector<float> output(outputSize);
+    const Request request = {
+            .inputs = {{.lifetime = Request::Argument::LifeTime::POINTER,
+                        .location = {.pointer = static_cast<const void*>(input.data()),
+                                     .length = static_cast<uint32_t>(input.size() *
+                                                                     sizeof(float))}}},
+            .outputs = {{.lifetime = Request::Argument::LifeTime::POINTER,
+                         .location = {.pointer = static_cast<void*>(output.data()),
+                                      .length = static_cast<uint32_t>(outputSize *
+                                                                      sizeof(float))}}},
+    };
+    CpuExecutor executor;
+    EXPECT_EQ(executor.run(model, request, {}, {}), ANEURALNETWORKS_NO_ERROR);
+    return output;
+}
+
+TEST(AssignLayoutsForCpuTest, TransposeConvResultsAreUnchanged) {
+    std::vector<float> input(1 * 2 * 2 * 3);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = static_cast<float>(i) * 0.5f - 2.0f;
+    }
+    constexpr size_t kOutputSize = 1 * 2 * 5 * 12;
+    for (bool implicitPadding : {true, false}) {
+        SCOPED_TRACE(implicitPadding ? "implicit padding" : "explicit padding");
+        Model model = createNchwTransposeConvModel(implicitPadding);
+        ASSERT_TRUE(validate(model).ok());
+        const std::vector<float> expected = runFloatModel(model, input, kOutputSize);
+
+        EXPECT_EQ(assignLayoutsForCpu(&model), 2u);
+        ASSERT_TRUE(validate(model).ok());
+        const Operation& conv = model.main.operations[1];
+        ASSERT_EQ(conv.type, OperationType::TRANSPOSE_CONV_2D);
+        if (implicitPadding) {
+            // The output_shape input is permuted along with the layout.
+            const Operand& outputShape = model.main.operands[conv.inputs[3]];
+            ASSERT_EQ(outputShape.lifetime, Operand::LifeTime::CONSTANT_COPY);
+            std::vector<int32_t> values(4);
+            std::memcpy(values.data(), model.operandValues.data() + outputShape.location.offset,
+                        sizeof(int32_t) * values.size());
+            EXPECT_THAT(values, ElementsAreArray({1, 3, 6, 2}));
+        }
+        EXPECT_THAT(runFloatModel(model, input, kOutputSize), ElementsAreArray(expected));
+    }
+}
+
+// Builds DEQUANTIZE of size quantized weights followed by ADD of the dequantized weights to the
+// model input. The weights are an input of the model instead of a constant if constantWeights is
+// false.
+Model createDequantizedWeightsModel(uint32_t size, bool constantWeights) {
+    Model model;
+    std::vector<uint8_t> weights(size);
+    for (uint32_t i = 0; i < size; ++i) {
+        weights[i] = static_cast<uint8_t>(i);
+    }
+    const int32_t activation = static_cast<int32_t>(FusedActivationFunc::NONE);
+    const Operand tensor = {.type = OperandType::TENSOR_FLOAT32, .dimensions = {size}};
+    auto makeOperand = [&tensor](Operand::LifeTime lifetime) {
+        Operand operand = tensor;
+        operand.lifetime = lifetime;
+        return operand;
+    };
+    model.main.operands = {
+            {.type = OperandType::TENSOR_QUANT8_ASYMM,
+             .dimensions = {size},
+             .scale = 0.5f,
+             .zeroPoint = 2,
+             .lifetime = constantWeights ? Operand::LifeTime::CONSTANT_COPY
+                                         : Operand::LifeTime::SUBGRAPH_INPUT},
+            makeOperand(Operand::LifeTime::TEMPORARY_VARIABLE),
+            makeOperand(Operand::LifeTime::SUBGRAPH_INPUT),
+            {.type = OperandType::INT32,
+             .lifetime = Operand::LifeTime::CONSTANT_COPY,
+             .location = model.operandValues.append(reinterpret_cast<const uint8_t*>(&activation),
+                                                    sizeof(activation))},
+            makeOperand(Operand::LifeTime::SUBGRAPH_OUTPUT),
+    };
+    if (constantWeights) {
+        model.main.operands[0].location = model.operandValues.append(weights.data(), size);
+    }
+    model.main.operations = {
+            {.type = OperationType::DEQUANTIZE, .inputs = {0}, .outputs = {1}},
+            {.type = OperationType::ADD, .inputs = {2, 1, 3}, .outputs = {4}},
+    };
+    model.main.inputIndexes = {2};
+    if (!constantWeights) {
+        model.main.inputIndexes.insert(model.main.inputIndexes.begin(), 0);
+    }
+    model.main.outputIndexes = {4};
+    return model;
+}
+
+// Returns the values of the dequantized weights of createDequantizedWeightsModel.
+std::vector<float> getDequantizedWeights(uint32_t size) {
+    std::vector<float> values(size);
+    for (uint32_t i = 0; i < size; ++i) {
+        values[i] = (static_cast<float>(i) - 2.0f) * 0.5f;
+    }
+    return values;
+}
+
+TEST(FoldConstantsForCpuTest, SmallValuesAreCopiedIntoModel) {
+    constexpr uint32_t kSize = 4;
+    Model model = createDequantizedWeightsModel(kSize, /*constantWeights=*/true);
+    ASSERT_TRUE(validate(model).ok());
+
+    const ConstantFoldingResult result = foldConstantsForCpu(&model);
+    EXPECT_EQ(result.operationCount, 1u);
+    EXPECT_EQ(result.byteCount, kSize * sizeof(float));
+    ASSERT_TRUE(validate(model).ok());
+    ASSERT_EQ(model.main.operations.size(), 1u);
+    const Operation& add = model.main.operations[0];
+    EXPECT_EQ(add.type, OperationType::ADD);
+    const Operand& weights = model.main.operands[add.inputs[1]];
+    ASSERT_EQ(weights.lifetime, Operand::LifeTime::CONSTANT_COPY);
+    ASSERT_EQ(weights.location.length, kSize * sizeof(float));
+    std::vector<float> values(kSize);
+    std::memcpy(values.data(), model.operandValues.data() + weights.location.offset,
+                weights.location.length);
+    EXPECT_EQ(values, getDequantizedWeights(kSize));
+}
+
+TEST(FoldConstantsForCpuTest, LargeValuesAreStoredInNewPool) {
+    constexpr uint32_t kSize = 64;
+    Model model = createDequantizedWeightsModel(kSize, /*constantWeights=*/true);
+    ASSERT_TRUE(validate(model).ok());
+
+    const ConstantFoldingResult result = foldConstantsForCpu(&model);
+    EXPECT_EQ(result.operationCount, 1u);
+    EXPECT_EQ(result.byteCount, kSize * sizeof(float));
+    ASSERT_TRUE(validate(model).ok());
+    ASSERT_EQ(model.main.operations.size(), 1u);
+    const Operand& weights = model.main.operands[model.main.operations[0].inputs[1]];
+    ASSERT_EQ(weights.lifetime, Operand::LifeTime::CONSTANT_REFERENCE);
+    ASSERT_LT(weights.location.poolIndex, model.pools.size());
+    const auto pool = RunTimePoolInfo::createFromMemory(model.pools[weights.location.poolIndex]);
+    ASSERT_TRUE(pool.has_value());
+    std::vector<float> values(kSize);
+    std::memcpy(values.data(), pool->getBuffer() + weights.location.offset,
+                weights.location.length);
+    EXPECT_EQ(values, getDequantizedWeights(kSize));
+}
+
+TEST(FoldConstantsForCpuTest, OperationWithInputDependentValueIsNotFolded) {
+    Model model = createDequantizedWeightsModel(4, /*constantWeights=*/false);
+    ASSERT_TRUE(validate(model).ok());
+
+    const ConstantFoldingResult result = foldConstantsForCpu(&model);
+    EXPECT_EQ(result.operationCount, 0u);
+    EXPECT_EQ(result.byteCount, 0u);
+    EXPECT_EQ(model.main.operations.size(), 2u);
+}
+
+TEST(FoldConstantsForCpuTest, OperationWithMuchLargerOutputIsNotFolded) {
+    // TILE of 4 constant values into 4096 values, added to an input.
+    constexpr uint32_t kSize = 4;
+    constexpr int32_t kMultiple = 1024;
+    const float values[kSize] = {1.0f, 2.0f, 3.0f, 4.0f};
+    const int32_t activation = static_cast<int32_t>(FusedActivationFunc::NONE);
+    const Operand tiled = {.type = OperandType::TENSOR_FLOAT32, .dimensions = {kSize * kMultiple}};
+    auto makeOperand = [&tiled](Operand::LifeTime lifetime) {
+        Operand operand = tiled;
+        operand.lifetime = lifetime;
+        return operand;
+    };
+    Model model;
+    model.main.operands = {
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {kSize},
+             .lifetime = Operand::LifeTime::CONSTANT_COPY,
+             .location = model.operandValues.append(reinterpret_cast<const uint8_t*>(values),
+                                                    sizeof(values))},
+            {.type = OperandType::TENSOR_INT32,
+             .dimensions = {1},
+             .lifetime = Operand::LifeTime::CONSTANT_COPY,
+             .location = model.operandValues.append(reinterpret_cast<const uint8_t*>(&kMultiple),
+                                                    sizeof(kMultiple))},
+            makeOperand(Operand::LifeTime::TEMPORARY_VARIABLE),
+            makeOperand(Operand::LifeTime::SUBGRAPH_INPUT),
+            {.type = OperandType::INT32,
+             .lifetime = Operand::LifeTime::CONSTANT_COPY,
+             .location = model.operandValues.append(reinterpret_cast<const uint8_t*>(&activation),
+                                                    sizeof(activation))},
+            makeOperand(Operand::LifeTime::SUBGRAPH_OUTPUT),
+    };
+    model.main.operations = {
+            {.type = OperationType::TILE, .inputs = {0, 1}, .outputs = {2}},
+            {.type = OperationType::ADD, .inputs = {3, 2, 4}, .outputs = {5}},
+    };
+    model.main.inputIndexes = {3};
+    model.main.outputIndexes = {5};
+    ASSERT_TRUE(validate(model).ok());
+
+    const ConstantFoldingResult result = foldConstantsForCpu(&model);
+    EXPECT_EQ(result.operationCount, 0u);
+    EXPECT_EQ(result.byteCount, 0u);
+    EXPECT_EQ(model.main.operations.size(), 2u);
+}
+
+// Builds ADD of a 2x3 input and a broadcast 3 input into a temporary, TRANSPOSE of the
+// temporary into a second temporary, and ADD of the second temporary to itself. Neither the
+// temporaries nor the output have specified dimensions. The dimensions of the first input are
+// {firstDimension, 3}, and the permutation is an input of the model instead of a constant if
+// constantPermutation is false.
+Model createBroadcastTransposeModel(uint32_t firstDimension, bool constantPermutation) {
+    Model model;
+    const int32_t activation = static_cast<int32_t>(FusedActivationFunc::NONE);
+    const std::vector<int32_t> permutation = {1, 0};
+    const Operand::LifeTime permutationLifetime = constantPermutation
+                                                          ? Operand::LifeTime::CONSTANT_COPY
+                                                          : Operand::LifeTime::SUBGRAPH_INPUT;
+    model.main.operands = {
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {firstDimension, 3},
+             .lifetime = Operand::LifeTime::SUBGRAPH_INPUT},
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {3},
+             .lifetime = Operand::LifeTime::SUBGRAPH_INPUT},
+            {.type = OperandType::INT32,
+             .lifetime = Operand::LifeTime::CONSTANT_COPY,
+             .location = model.operandValues.append(reinterpret_cast<const uint8_t*>(&activation),
+                                                    sizeof(activation))},
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {0, 0},
+             .lifetime = Operand::LifeTime::TEMPORARY_VARIABLE},
+            {.type = OperandType::TENSOR_INT32, .dimensions = {2}, .lifetime = permutationLifetime},
+            {.type = OperandType::TENSOR_FLOAT32,
+             .lifetime = Operand::LifeTime::TEMPORARY_VARIABLE},
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {0, 0},
+             .lifetime = Operand::LifeTime::SUBGRAPH_OUTPUT},
+    };
+    model.main.inputIndexes = {0, 1};
+    if (constantPermutation) {
+        model.main.operands[4].location =
+                model.operandValues.append(reinterpret_cast<const uint8_t*>(permutation.data()),
+                                           permutation.size() * sizeof(int32_t));
+    } else {
+        model.main.inputIndexes.push_back(4);
+    }
+    model.main.operations = {
+            {.type = OperationType::ADD, .inputs = {0, 1, 2}, .outputs = {3}},
+            {.type = OperationType::TRANSPOSE, .inputs = {3, 4}, .outputs = {5}},
+            {.type = OperationType::ADD, .inputs = {5, 5, 2}, .outputs = {6}},
+    };
+    model.main.outputIndexes = {6};
+    return model;
+}
+
+TEST(InferTemporaryShapesTest, TemporariesOfSpecifiedInputsAreSpecified) {
+    Model model = createBroadcastTransposeModel(2, /*constantPermutation=*/true);
+    ASSERT_TRUE(validate(model).ok());
+
+    EXPECT_EQ(inferTemporaryShapes(&model), 2u);
+    ASSERT_TRUE(validate(model).ok());
+    EXPECT_EQ(model.main.operands[3].dimensions, (std::vector<uint32_t>{2, 3}));
+    EXPECT_EQ(model.main.operands[5].dimensions, (std::vector<uint32_t>{3, 2}));
+    EXPECT_EQ(model.main.operands[6].dimensions, (std::vector<uint32_t>{0, 0}));
+}
+
+TEST(InferTemporaryShapesTest, TemporariesOfUnspecifiedInputsAreNotSpecified) {
+    Model model = createBroadcastTransposeModel(0, /*constantPermutation=*/true);
+    ASSERT_TRUE(validate(model).ok());
+
+    EXPECT_EQ(inferTemporaryShapes(&model), 0u);
+    EXPECT_EQ(model.main.operands[3].dimensions, (std::vector<uint32_t>{0, 0}));
+    EXPECT_TRUE(model.main.operands[5].dimensions.empty());
+}
+
+TEST(InferTemporaryShapesTest, OperationWithInputDependentParameterIsSkipped) {
+    Model model = createBroadcastTransposeModel(2, /*constantPermutation=*/false);
+    ASSERT_TRUE(validate(model).ok());
+
+    EXPECT_EQ(inferTemporaryShapes(&model), 1u);
+    EXPECT_EQ(model.main.operands[3].dimensions, (std::vector<uint32_t>{2, 3}));
+    EXPECT_TRUE(model.main.operands[5].dimensions.empty());
+}
+
+// Builds FULLY_CONNECTED with constant 4x8 weights of which nonZeroCount are non-zero.
+Model createFullyConnectedModel(uint32_t nonZeroCount) {
+    constexpr uint32_t kNumUnits = 4;
+    constexpr uint32_t kInputSize = 8;
+    Model model;
+    std::vector<float> weights(kNumUnits * kInputSize, 0.0f);
+    for (uint32_t i = 0; i < nonZeroCount; ++i) {
+        weights[(i * 7) % weights.size()] = static_cast<float>(i + 1);
+    }
+    const std::vector<float> bias(kNumUnits, 0.5f);
+    const int32_t activation = static_cast<int32_t>(FusedActivationFunc::NONE);
+    model.main.operands = {
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {1, kInputSize},
+             .lifetime = Operand::LifeTime::SUBGRAPH_INPUT},
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {kNumUnits, kInputSize},
+             .lifetime = Operand::LifeTime::CONSTANT_COPY,
+             .location = model.operandValues.append(
+                     reinterpret_cast<const uint8_t*>(weights.data()),
+                     weights.size() * sizeof(float))},
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {kNumUnits},
+             .lifetime = Operand::LifeTime::CONSTANT_COPY,
+             .location = model.operandValues.append(reinterpret_cast<const uint8_t*>(bias.data()),
+                                                    bias.size() * sizeof(float))},
+            {.type = OperandType::INT32,
+             .lifetime = Operand::LifeTime::CONSTANT_COPY,
+             .location = model.operandValues.append(reinterpret_cast<const uint8_t*>(&activation),
+                                                    sizeof(activation))},
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {1, kNumUnits},
+             .lifetime = Operand::LifeTime::SUBGRAPH_OUTPUT},
+    };
+    model.main.operations = {
+            {.type = OperationType::FULLY_CONNECTED, .inputs = {0, 1, 2, 3}, .outputs = {4}},
+    };
+    model.main.inputIndexes = {0};
+    model.main.outputIndexes = {4};
+    return model;
+}
+
+TEST(SparsifyWeightsForCpuTest, MostlyZeroWeightsAreCompressed) {
+    Model model = createFullyConnectedModel(/*nonZeroCount=*/6);
+    ASSERT_TRUE(validate(model).ok());
+
+    EXPECT_EQ(sparsifyWeightsForCpu(&model), 1u);
+    ASSERT_EQ(model.main.operations.size(), 1u);
+    const Operation& fullyConnected = model.main.operations[0];
+    EXPECT_EQ(fullyConnected.type, kOperationFullyConnectedSparse);
+    ASSERT_EQ(fullyConnected.inputs.size(), fully_connected_sparse::kNumInputs);
+    auto getValues = [&model, &fullyConnected](uint32_t input) {
+        const Operand& operand = model.main.operands[fullyConnected.inputs[input]];
+        EXPECT_EQ(operand.lifetime, Operand::LifeTime::CONSTANT_COPY);
+        std::vector<int32_t> values(operand.location.length / sizeof(int32_t));
+        std::memcpy(values.data(), model.operandValues.data() + operand.location.offset,
+                    operand.location.length);
+        return values;
+    };
+    // The non-zero weights are at positions 0, 7, 14, 21, 28 and 35 % 32 = 3.
+    EXPECT_EQ(getValues(4), (std::vector<int32_t>{4, 8}));
+    EXPECT_EQ(getValues(5), (std::vector<int32_t>{0, 3, 4, 5, 6}));
+    EXPECT_EQ(getValues(6), (std::vector<int32_t>{0, 3, 7, 6, 5, 4}));
+    std::vector<float> weights(6);
+    const Operand& weightsOperand = model.main.operands[fullyConnected.inputs[1]];
+    ASSERT_EQ(weightsOperand.location.length, weights.size() * sizeof(float));
+    std::memcpy(weights.data(), model.operandValues.data() + weightsOperand.location.offset,
+                weightsOperand.location.length);
+    EXPECT_EQ(weights, (std::vector<float>{1.0f, 6.0f, 2.0f, 3.0f, 4.0f, 5.0f}));
+}
+
+TEST(SparsifyWeightsForCpuTest, DenseWeightsAreNotCompressed) {
+    Model model = createFullyConnectedModel(/*nonZeroCount=*/20);
+    ASSERT_TRUE(validate(model).ok());
+
+    EXPECT_EQ(sparsifyWeightsForCpu(&model), 0u);
+    ASSERT_EQ(model.main.operations.size(), 1u);
+    EXPECT_EQ(model.main.operations[0].inputs.size(), 4u);
+}
+
+TEST(SparsifyWeightsForCpuTest, NonFiniteInputsGiveDenseResults) {
+    const Model denseModel = createFullyConnectedModel(/*nonZeroCount=*/6);
+    Model sparseModel = denseModel;
+    ASSERT_EQ(sparsifyWeightsForCpu(&sparseModel), 1u);
+
+    constexpr float kInf = std::numeric_limits<float>::infinity();
+    constexpr float kNaN = std::numeric_limits<float>::quiet_NaN();
+    // Activation NONE clamps infinite outputs to the float range.
+    constexpr float kMax = std::numeric_limits<float>::max();
+    // Unit 0 has non-zero weights 1, 6 and 2 for inputs 0, 3 and 7. Units 1, 2 and 3 each have a
+    // single non-zero weight, for inputs 6, 5 and 4, so they multiply every other input by zero.
+    struct TestCase {
+        std::vector<float> input;
+        std::vector<float> expectedOutput;
+    };
+    const TestCase testCases[] = {
+            {{1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f}, {9.5f, 3.5f, 4.5f, 5.5f}},
+            {{kInf, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f}, {kMax, kNaN, kNaN, kNaN}},
+            {{kInf, 1.0f, 1.0f, -kInf, 1.0f, 1.0f, 1.0f, 1.0f}, {kNaN, kNaN, kNaN, kNaN}},
+            {{kInf, 1.0f, 1.0f, kInf, 1.0f, 1.0f, 1.0f, 1.0f}, {kMax, kNaN, kNaN, kNaN}},
+            {{1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, kInf, 1.0f}, {kNaN, kMax, kNaN, kNaN}},
+            {{1.0f, 1.0f, 1.0f, 1.0f, kNaN, 1.0f, 1.0f, 1.0f}, {kNaN, kNaN, kNaN, kNaN}},
+    };
+    for (const TestCase& testCase : testCases) {
+        SCOPED_TRACE(::testing::PrintToString(testCase.input));
+        const std::vector<float> denseOutput = runFloatModel(denseModel, testCase.input, 4);
+        const std::vector<float> sparseOutput = runFloatModel(sparseModel, testCase.input, 4);
+        for (size_t i = 0; i < testCase.expectedOutput.size(); ++i) {
+            const float expected = testCase.expectedOutput[i];
+            if (std::isnan(expected)) {
+                EXPECT_TRUE(std::isnan(denseOutput[i])) << "unit " << i;
+                EXPECT_TRUE(std::isnan(sparseOutput[i])) << "unit " << i;
+            } else {
+                EXPECT_EQ(denseOutput[i], expected) << "unit " << i;
+                EXPECT_EQ(sparseOutput[i], expected) << "unit " << i;
+            }
+        }
+    }
+}
+
+TEST(SparsifyWeightsForCpuTest, InvalidCompressedRowsAreRejected) {
+    Model model = createFullyConnectedModel(/*nonZeroCount=*/6);
+    ASSERT_EQ(sparsifyWeightsForCpu(&model), 1u);
+
+    // The valid row segments are {0, 3, 4, 5, 6} and the valid column indices {0, 3, 7, 6, 5, 4}.
+    struct TestCase {
+        const char* name;
+        uint32_t input;
+        std::vector<int32_t> values;
+    };
+    const TestCase testCases[] = {
+            {"decreasing row segments", fully_connected_sparse::kWeightsRowSegments,
+             {0, 9, 4, 5, 6}},
+            {"column index past the input", fully_connected_sparse::kWeightsColumnIndices,
+             {0, 3, 8, 6, 5, 4}},
+            {"negative column index", fully_connected_sparse::kWeightsColumnIndices,
+             {0, 3, -1, 6, 5, 4}},
+    };
+    std::vector<float> input(8, 1.0f);
+    std::vector<float> output(4);
+    const Request request = {
+            .inputs = {{.lifetime = Request::Argument::LifeTime::POINTER,
+                        .location = {.pointer = static_cast<const void*>(input.data()),
+                                     .length = static_cast<uint32_t>(input.size() *
+                                                                     sizeof(float))}}},
+            .outputs = {{.lifetime = Request::Argument::LifeTime::POINTER,
+                         .location = {.pointer = static_cast<void*>(output.data()),
+                                      .length = static_cast<uint32_t>(output.size() *
+                                                                      sizeof(float))}}},
+    };
+    for (const TestCase& testCase : testCases) {
+        SCOPED_TRACE(testCase.name);
+        Model invalidModel = model;
+        uint32_t& operandIndex = invalidModel.main.operations[0].inputs[testCase.input];
+        Operand operand = invalidModel.main.operands[operandIndex];
+        operand.location = invalidModel.operandValues.append(
+                reinterpret_cast<const uint8_t*>(testCase.values.data()),
+                testCase.values.size() * sizeof(int32_t));
+        operandIndex = invalidModel.main.operands.size();
+        invalidModel.main.operands.push_back(operand);
+        CpuExecutor executor;
+        EXPECT_EQ(executor.run(invalidModel, request, {}, {}), ANEURALNETWORKS_OP_FAILED);
+    }
+}
+
+TEST(ParallelForTest, EveryIndexIsProcessedOnce) {
+    constexpr uint32_t kSize = 1000;
+    std::vector<std::atomic<uint32_t>> counts(kSize);
+    EXPECT_TRUE(parallelFor(kSize, 1, [&counts](uint32_t begin, uint32_t end) {
+        EXPECT_LT(begin, end);
+        for (uint32_t i = begin; i < end; ++i) {
+            counts[i]++;
+        }
+        return true;
+    }));
+    for (uint32_t i = 0; i < kSize; ++i) {
+        EXPECT_EQ(counts[i].load(), 1u) << "index " << i;
+    }
+}
+
+TEST(ParallelForTest, SmallLoopIsNotSplit) {
+    uint32_t numCalls = 0;
+    EXPECT_TRUE(parallelFor(10, 10, [&numCalls](uint32_t begin, uint32_t end) {
+        EXPECT_EQ(begin, 0u);
+        EXPECT_EQ(end, 10u);
+        numCalls++;
+        return true;
+    }));
+    EXPECT_EQ(numCalls, 1u);
+}
+
+TEST(ParallelForTest, FailureIsReported) {
+    EXPECT_FALSE(parallelFor(1000, 1, [](uint32_t begin, uint32_t end) {
+        return !(begin <= 500 && 500 < end);
+    }));
+}
+
+TEST(ParallelForTest, PassedDeadlineSkipsWork) {
+    const ScopedCpuDeadline deadline(Clock::now() - std::chrono::seconds(1));
+    std::atomic<uint32_t> numCalls = 0;
+    EXPECT_FALSE(parallelFor(1000, 1, [&numCalls](uint32_t, uint32_t) {
+        numCalls++;
+        return true;
+    }));
+    EXPECT_EQ(numCalls.load(), 0u);
+}
+
+TEST(ParallelForTest, ThreadCountCanBeChanged) {
+    const uint32_t defaultThreadCount = getCpuThreadCount();
+    setCpuThreadCount(1);
+    EXPECT_EQ(getCpuThreadCount(), 1u);
+    uint32_t numCalls = 0;
+    EXPECT_TRUE(parallelFor(1000, 1, [&numCalls](uint32_t, uint32_t) {
+        numCalls++;
+        return true;
+    }));
+    EXPECT_EQ(numCalls, 1u);
+    setCpuThreadCount(0);
+    EXPECT_EQ(getCpuThreadCount(), defaultThreadCount);
+}
+
+TEST(ScratchWorkspaceTest, AllocationsAreAlignedAndDistinct) {
+    ScratchWorkspace workspace;
+    uint8_t* first = workspace.allocate<uint8_t>(1);
+    float* second = workspace.allocate<float>(100);
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(first) % ScratchWorkspace::kAlignment, 0u);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(second) % ScratchWorkspace::kAlignment, 0u);
+    EXPECT_NE(static_cast<void*>(first), static_cast<void*>(second));
+    std::memset(second, 0, 100 * sizeof(float));
+}
+
+TEST(ScratchWorkspaceTest, CapacityGrowsToPeakUsageAndIsReused) {
+    ScratchWorkspace workspace;
+    EXPECT_EQ(workspace.getCapacity(), 0u);
+    ASSERT_NE(workspace.allocate(1000), nullptr);
+    ASSERT_NE(workspace.allocate(3000), nullptr);
+    workspace.reset();
+    const size_t capacity = workspace.getCapacity();
+    EXPECT_GE(capacity, 4000u);
+
+    void* first = workspace.allocate(3000);
+    ASSERT_NE(first, nullptr);
+    workspace.reset();
+    EXPECT_EQ(workspace.allocate(3000), first);
+    workspace.reset();
+    EXPECT_EQ(workspace.getCapacity(), capacity);
+}
+
+TEST(ScratchWorkspaceTest, ConcurrentAllocationsDoNotOverlap) {
+    ScratchWorkspace workspace;
+    constexpr uint32_t kNumAllocations = 256;
+    constexpr size_t kSize = 100;
+    std::vector<uint8_t*> allocations(kNumAllocations);
+    for (int pass = 0; pass < 2; ++pass) {
+        EXPECT_TRUE(parallelFor(kNumAllocations, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i) {
+                allocations[i] = workspace.allocate<uint8_t>(kSize);
+                if (allocations[i] == nullptr) return false;
+                std::memset(allocations[i], i, kSize);
+            }
+            return true;
+        }));
+        for (uint32_t i = 0; i < kNumAllocations; ++i) {
+            EXPECT_EQ(allocations[i][0], static_cast<uint8_t>(i));
+            EXPECT_EQ(allocations[i][kSize - 1], static_cast<uint8_t>(i));
+        }
+        workspace.reset();
+    }
+}
+
+TEST(CpuExecutorTest, OperationsAreProfiled) {
+    Model model;
+    const int32_t activation = static_cast<int32_t>(FusedActivationFunc::NONE);
+    const Operand tensor = {.type = OperandType::TENSOR_FLOAT32, .dimensions = {2}};
+    auto makeOperand = [&tensor](Operand::LifeTime lifetime) {
+        Operand operand = tensor;
+        operand.lifetime = lifetime;
+        return operand;
+    };
+    model.main.operands = {
+            makeOperand(Operand::LifeTime::SUBGRAPH_INPUT),
+            makeOperand(Operand::LifeTime::SUBGRAPH_INPUT),
+            {.type = OperandType::INT32,
+             .lifetime = Operand::LifeTime::CONSTANT_COPY,
+             .location = model.operandValues.append(reinterpret_cast<const uint8_t*>(&activation),
+                                                    sizeof(activation))},
+            makeOperand(Operand::LifeTime::TEMPORARY_VARIABLE),
+            makeOperand(Operand::LifeTime::SUBGRAPH_OUTPUT),
+    };
+    model.main.operations = {
+            {.type = OperationType::ADD, .inputs = {0, 1, 2}, .outputs = {3}},
+            {.type = OperationType::MUL, .inputs = {3, 1, 2}, .outputs = {4}},
+    };
+    model.main.inputIndexes = {0, 1};
+    model.main.outputIndexes = {4};
+    ASSERT_TRUE(validate(model).ok());
+
+    const std::vector<float> input0 = {1.0f, 2.0f};
+    const std::vector<float> input1 = {3.0f, 4.0f};
+    std::vector<float> output(2);
+    auto makeArgument = [](auto pointer) {
+        return Request::Argument{
+                .lifetime = Request::Argument::LifeTime::POINTER,
+                .location = {.pointer = pointer, .length = 2 * sizeof(float)},
+        };
+    };
+    const Request request = {
+            .inputs = {makeArgument(static_cast<const void*>(input0.data())),
+                       makeArgument(static_cast<const void*>(input1.data()))},
+            .outputs = {makeArgument(static_cast<void*>(output.data()))},
+    };
+
+    CpuExecutor executor;
+    executor.setProfiling(true);
+    ASSERT_EQ(executor.run(model, request, {}, {}), ANEURALNETWORKS_NO_ERROR);
+    EXPECT_THAT(output, ElementsAreArray({12.0f, 24.0f}));
+
+    const std::vector<OperationProfile>& profiles = executor.getOperationProfiles();
+    ASSERT_EQ(profiles.size(), 2u);
+    const OperationProfile& add = profiles[0];
+    EXPECT_EQ(add.type, OperationType::ADD);
+    ASSERT_EQ(add.inputs.size(), 3u);
+    EXPECT_EQ(add.inputs[0].type, OperandType::TENSOR_FLOAT32);
+    EXPECT_THAT(add.inputs[0].dimensions, ElementsAreArray({2u}));
+    EXPECT_EQ(add.inputs[2].type, OperandType::INT32);
+    ASSERT_EQ(add.outputs.size(), 1u);
+    EXPECT_THAT(add.outputs[0].dimensions, ElementsAreArray({2u}));
+    EXPECT_EQ(add.bytesRead, 4 * sizeof(float) + sizeof(int32_t));
+    EXPECT_EQ(add.bytesWritten, 2 * sizeof(float));
+    // The temporary output of ADD is allocated by the executor, unlike the model output of MUL.
+    EXPECT_GE(add.numAllocations, 1u);
+    const OperationProfile& mul = profiles[1];
+    EXPECT_EQ(mul.type, OperationType::MUL);
+    EXPECT_EQ(mul.depth, 0u);
+    EXPECT_GE(mul.startTime, add.startTime + add.duration);
+
+    const std::string trace = toChromeTrace(profiles);
+    EXPECT_THAT(trace, HasSubstr("\"name\":\"ADD\""));
+    EXPECT_THAT(trace, HasSubstr("\"name\":\"MUL\""));
+    EXPECT_THAT(trace, HasSubstr("\"inputs\":\"TENSOR_FLOAT32[2], TENSOR_FLOAT32[2], INT32[]\""));
+}
+
+TEST(CpuExecutorTest, ScratchWorkspacesAreReusedAcrossExecutions) {
+    Model model;
+    const float beta = 1.0f;
+    const int32_t axis = -1;
+    model.main.operands = {
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {2, 64},
+             .lifetime = Operand::LifeTime::SUBGRAPH_INPUT},
+            {.type = OperandType::FLOAT32,
+             .lifetime = Operand::LifeTime::CONSTANT_COPY,
+             .location = model.operandValues.append(reinterpret_cast<const uint8_t*>(&beta),
+                                                    sizeof(beta))},
+            {.type = OperandType::INT32,
+             .lifetime = Operand::LifeTime::CONSTANT_COPY,
+             .location = model.operandValues.append(reinterpret_cast<const uint8_t*>(&axis),
+                                                    sizeof(axis))},
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {2, 64},
+             .lifetime = Operand::LifeTime::SUBGRAPH_OUTPUT},
+    };
+    model.main.operations = {
+            {.type = OperationType::LOG_SOFTMAX, .inputs = {0, 1, 2}, .outputs = {3}}};
+    model.main.inputIndexes = {0};
+    model.main.outputIndexes = {3};
+    ASSERT_TRUE(validate(model).ok());
+
+    const std::vector<float> input(128, 1.0f);
+    std::vector<float> output(128);
+    const Request request = {
+            .inputs = {{.lifetime = Request::Argument::LifeTime::POINTER,
+                        .location = {.pointer = static_cast<const void*>(input.data()),
+                                     .length = 128 * sizeof(float)}}},
+            .outputs = {{.lifetime = Request::Argument::LifeTime::POINTER,
+                         .location = {.pointer = static_cast<void*>(output.data()),
+                                      .length = 128 * sizeof(float)}}},
+    };
+
+    // Like the drivers, every execution uses a new executor with the pool of the prepared model.
+    // Only the first execution allocates scratch memory for LOG_SOFTMAX.
+    ScratchWorkspacePool pool;
+    auto countAllocations = [&model, &request, &pool] {
+        CpuExecutor executor;
+        executor.setScratchWorkspacePool(&pool);
+        executor.setProfiling(true);
+        EXPECT_EQ(executor.run(model, request, {}, {}), ANEURALNETWORKS_NO_ERROR);
+        const std::vector<OperationProfile>& profiles = executor.getOperationProfiles();
+        EXPECT_EQ(profiles.size(), 1u);
+        return profiles.empty() ? 0u : profiles[0].numAllocations;
+    };
+    EXPECT_GE(countAllocations(), 1u);
+    EXPECT_EQ(countAllocations(), 0u);
+    EXPECT_EQ(countAllocations(), 0u);
+    EXPECT_FLOAT_EQ(output[0], -std::log(64.0f));
+}
+
+// Builds two WHILE loops over the same subgraphs. Each iteration doubles the size of x with TILE
+// and squares c with POW, while c < limit. The loops run 2 and 1 iterations.
+Model createGrowingLoopModel() {
+    Model model;
+    auto appendValue = [&model](const auto& value) {
+        return model.operandValues.append(reinterpret_cast<const uint8_t*>(&value), sizeof(value));
+    };
+    const Operand unknownSizeInput = {.type = OperandType::TENSOR_FLOAT32,
+                                      .dimensions = {0},
+                                      .lifetime = Operand::LifeTime::SUBGRAPH_INPUT};
+    const Operand scalarInput = {.type = OperandType::TENSOR_FLOAT32,
+                                 .dimensions = {1},
+                                 .lifetime = Operand::LifeTime::SUBGRAPH_INPUT};
+    Operand unknownSizeOutput = unknownSizeInput;
+    unknownSizeOutput.lifetime = Operand::LifeTime::SUBGRAPH_OUTPUT;
+    Operand scalarOutput = scalarInput;
+    scalarOutput.lifetime = Operand::LifeTime::SUBGRAPH_OUTPUT;
+
+    const Model::Subgraph condition = {
+            .operands = {unknownSizeInput,
+                         scalarInput,
+                         scalarInput,
+                         {.type = OperandType::TENSOR_BOOL8,
+                          .dimensions = {1},
+                          .lifetime = Operand::LifeTime::SUBGRAPH_OUTPUT}},
+            .operations = {{.type = OperationType::LESS, .inputs = {1, 2}, .outputs = {3}}},
+            .inputIndexes = {0, 1, 2},
+            .outputIndexes = {3},
+    };
+    const Model::Subgraph body = {
+            .operands = {unknownSizeInput,
+                         scalarInput,
+                         scalarInput,
+                         {.type = OperandType::TENSOR_INT32,
+                          .dimensions = {1},
+                          .lifetime = Operand::LifeTime::CONSTANT_COPY,
+                          .location = appendValue(int32_t{2})},
+                         {.type = OperandType::TENSOR_FLOAT32,
+                          .dimensions = {1},
+                          .lifetime = Operand::LifeTime::CONSTANT_COPY,
+                          .location = appendValue(2.0f)},
+                         unknownSizeOutput,
+                         scalarOutput},
+            .operations = {{.type = OperationType::TILE, .inputs = {0, 3}, .outputs = {5}},
+                           {.type = OperationType::POW, .inputs = {1, 4}, .outputs = {6}}},
+            .inputIndexes = {0, 1, 2},
+            .outputIndexes = {5, 6},
+    };
+    model.referenced = {condition, body};
+
+    Operand temporary = unknownSizeOutput;
+    temporary.lifetime = Operand::LifeTime::TEMPORARY_VARIABLE;
+    Operand scalarTemporary = scalarOutput;
+    scalarTemporary.lifetime = Operand::LifeTime::TEMPORARY_VARIABLE;
+    Operand limit = scalarInput;
+    limit.lifetime = Operand::LifeTime::CONSTANT_COPY;
+    model.main.operands = {
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {2},
+             .lifetime = Operand::LifeTime::SUBGRAPH_INPUT},
+            scalarInput,
+            {.type = OperandType::SUBGRAPH,
+             .lifetime = Operand::LifeTime::SUBGRAPH,
+             .location = {.offset = 0}},
+            {.type = OperandType::SUBGRAPH,
+             .lifetime = Operand::LifeTime::SUBGRAPH,
+             .location = {.offset = 1}},
+            limit,
+            limit,
+            temporary,
+            scalarTemporary,
+            unknownSizeOutput,
+            scalarOutput,
+    };
+    model.main.operands[4].location = appendValue(10.0f);
+    model.main.operands[5].location = appendValue(100.0f);
+    model.main.operations = {
+            {.type = OperationType::WHILE, .inputs = {2, 3, 0, 1, 4}, .outputs = {6, 7}},
+            {.type = OperationType::WHILE, .inputs = {2, 3, 6, 7, 5}, .outputs = {8, 9}},
+    };
+    model.main.inputIndexes = {0, 1};
+    model.main.outputIndexes = {8, 9};
+    return model;
+}
+
+TEST(CpuExecutorTest, WhileLoopOutputGrowsAcrossIterations) {
+    const Model model = createGrowingLoopModel();
+    ASSERT_TRUE(validate(model).ok());
+
+    const std::vector<float> x = {1.0f, 2.0f};
+    const float c = 2.0f;
+    std::vector<float> y(16);
+    float finalC = 0.0f;
+    auto makeArgument = [](auto pointer, size_t length) {
+        return Request::Argument{
+                .lifetime = Request::Argument::LifeTime::POINTER,
+                .location = {.pointer = pointer, .length = static_cast<uint32_t>(length)},
+        };
+    };
+    const Request request = {
+            .inputs = {makeArgument(static_cast<const void*>(x.data()), x.size() * sizeof(float)),
+                       makeArgument(static_cast<const void*>(&c), sizeof(c))},
+            .outputs = {makeArgument(static_cast<void*>(y.data()), y.size() * sizeof(float)),
+                        makeArgument(static_cast<void*>(&finalC), sizeof(finalC))},
+    };
+
+    // The first loop squares c from 2 to 4 and 16, and the second one from 16 to 256, so x grows
+    // from 2 to 4, 8 and 16 elements, with each iteration writing a larger output than the
+    // buffers of the previous ones.
+    CpuExecutor executor;
+    ASSERT_EQ(executor.run(model, request, {}, {}), ANEURALNETWORKS_NO_ERROR);
+    const std::vector<OutputShape>& outputShapes = executor.getOutputShapes();
+    ASSERT_EQ(outputShapes.size(), 2u);
+    EXPECT_THAT(outputShapes[0].dimensions, ElementsAreArray({16u}));
+    EXPECT_TRUE(outputShapes[0].isSufficient);
+    for (size_t i = 0; i < y.size(); ++i) {
+        EXPECT_EQ(y[i], x[i % x.size()]) << "element " << i;
+    }
+    EXPECT_EQ(finalC, 256.0f);
+}
+
+TEST(CpuExecutorTest, OperationProfilesAreCapped) {
+    const Model model = createGrowingLoopModel();
+    const std::vector<float> x = {1.0f, 2.0f};
+    const float c = 2.0f;
+    std::vector<float> y(16);
+    float finalC = 0.0f;
+    auto makeArgument = [](auto pointer, size_t length) {
+        return Request::Argument{
+                .lifetime = Request::Argument::LifeTime::POINTER,
+                .location = {.pointer = pointer, .length = static_cast<uint32_t>(length)},
+        };
+    };
+    const Request request = {
+            .inputs = {makeArgument(static_cast<const void*>(x.data()), x.size() * sizeof(float)),
+                       makeArgument(static_cast<const void*>(&c), sizeof(c))},
+            .outputs = {makeArgument(static_cast<void*>(y.data()), y.size() * sizeof(float)),
+                        makeArgument(static_cast<void*>(&finalC), sizeof(finalC))},
+    };
+
+    CpuExecutor executor;
+    executor.setProfiling(true);
+    ASSERT_EQ(executor.run(model, request, {}, {}), ANEURALNETWORKS_NO_ERROR);
+    const size_t numOperations = executor.getOperationProfiles().size();
+    EXPECT_EQ(executor.getNumUnprofiledOperations(), 0u);
+
+    // The loops execute their operations several times, so the cap is reached within the first
+    // WHILE operation.
+    constexpr size_t kMaxOperationProfiles = 4;
+    ASSERT_GT(numOperations, kMaxOperationProfiles);
+    CpuExecutor cappedExecutor;
+    cappedExecutor.setProfiling(true, kMaxOperationProfiles);
+    ASSERT_EQ(cappedExecutor.run(model, request, {}, {}), ANEURALNETWORKS_NO_ERROR);
+    const std::vector<OperationProfile>& profiles = cappedExecutor.getOperationProfiles();
+    ASSERT_EQ(profiles.size(), kMaxOperationProfiles);
+    EXPECT_EQ(profiles[0].type, OperationType::WHILE);
+    EXPECT_EQ(cappedExecutor.getNumUnprofiledOperations(), numOperations - kMaxOperationProfiles);
+    EXPECT_EQ(finalC, 256.0f);
+}
+
 class CombineDimensionsTest : public ::testing::Test {
    protected:
     void testCompatible(const std::vector<uint32_t>& lhs, const std::vector<uint32_t>& rhs,
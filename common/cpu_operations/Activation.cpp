@@ -396,7 +396,7 @@ bool prepare(OperationType opType, IOperationExecutionContext* context) {
 
 bool executeRelu(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     switch (context->getInputType(kInputTensor)) {
         case OperandType::TENSOR_FLOAT16:
             return reluFloat(context->getInputBuffer<_Float16>(kInputTensor),
@@ -425,7 +425,7 @@ bool executeRelu(IOperationExecutionContext* context) {
 
 bool executeRelu1(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     switch (context->getInputType(kInputTensor)) {
         case OperandType::TENSOR_FLOAT16:
             return relu1Float(context->getInputBuffer<_Float16>(kInputTensor),
@@ -454,7 +454,7 @@ bool executeRelu1(IOperationExecutionContext* context) {
 
 bool executeRelu6(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     switch (context->getInputType(kInputTensor)) {
         case OperandType::TENSOR_FLOAT16:
             return relu6Float(context->getInputBuffer<_Float16>(kInputTensor),
@@ -483,7 +483,7 @@ bool executeRelu6(IOperationExecutionContext* context) {
 
 bool executeLogistic(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     switch (context->getInputType(kInputTensor)) {
         case OperandType::TENSOR_FLOAT16:
             return logisticFloat(context->getInputBuffer<_Float16>(kInputTensor),
@@ -512,7 +512,7 @@ bool executeLogistic(IOperationExecutionContext* context) {
 
 bool executeTanh(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     switch (context->getInputType(kInputTensor)) {
         case OperandType::TENSOR_FLOAT16:
             return tanhFloat16(context->getInputBuffer<_Float16>(kInputTensor),
@@ -541,7 +541,7 @@ bool executeTanh(IOperationExecutionContext* context) {
 
 bool executeHardSwish(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     switch (context->getInputType(kInputTensor)) {
         case OperandType::TENSOR_FLOAT16: {
             const Shape& inputShape = context->getInputShape(kInputTensor);
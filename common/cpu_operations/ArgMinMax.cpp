@@ -20,7 +20,10 @@
 
 #include "ArgMinMax.h"
 
+#include <functional>
+
 #include "CpuOperationUtils.h"
+#include "CpuSelection.h"
 #include "Operations.h"
 #include "Tracing.h"
 
@@ -28,26 +31,18 @@ namespace android {
 namespace nn {
 
 template <typename In, typename Out>
-static void argMinMaxImpl(const In* inputData, const Shape& inputShape, int32_t axis, bool isArgMin,
+static bool argMinMaxImpl(const In* inputData, const Shape& inputShape, int32_t axis, bool isArgMin,
                           Out* outputData, const Shape& /*outputShape*/) {
-    const int outerSize = getNumberOfElements(inputShape, 0, axis);
-    const int axisSize = getSizeOfDimension(inputShape, axis);
-    const int innerSize =
+    const uint32_t outerSize = getNumberOfElements(inputShape, 0, axis);
+    const uint32_t axisSize = getSizeOfDimension(inputShape, axis);
+    const uint32_t innerSize =
             getNumberOfElements(inputShape, axis + 1, getNumberOfDimensions(inputShape));
-    for (int outer = 0; outer < outerSize; ++outer) {
-        for (int inner = 0; inner < innerSize; ++inner) {
-            auto minMaxValue = inputData[outer * axisSize * innerSize + inner];
-            int minMaxIndex = 0;
-            for (int i = 1; i < axisSize; ++i) {
-                const auto& value = inputData[(outer * axisSize + i) * innerSize + inner];
-                if ((isArgMin && value < minMaxValue) || (!isArgMin && value > minMaxValue)) {
-                    minMaxValue = value;
-                    minMaxIndex = i;
-                }
-            }
-            outputData[outer * innerSize + inner] = minMaxIndex;
-        }
+    if (isArgMin) {
+        return argExtremum<In, std::less<In>>(inputData, outerSize, axisSize, innerSize,
+                                              outputData);
     }
+    return argExtremum<In, std::greater<In>>(inputData, outerSize, axisSize, innerSize,
+                                             outputData);
 }
 
 bool argMinMaxGeneric(const uint8_t* inputData, const Shape& inputShape, int32 axis, bool isArgMin,
@@ -58,9 +53,8 @@ bool argMinMaxGeneric(const uint8_t* inputData, const Shape& inputShape, int32 a
 #define NNAPI_IMPL_ARG_MIN_MAX(operandType, dataType)                                           \
     if (inputShape.type == operandType) {                                                       \
         NNTRACE_COMP_SWITCH("argMinMaxImpl::" #dataType);                                       \
-        argMinMaxImpl(reinterpret_cast<const dataType*>(inputData), inputShape, axis, isArgMin, \
-                      reinterpret_cast<int32_t*>(outputData), outputShape);                     \
-        return true;                                                                            \
+        return argMinMaxImpl(reinterpret_cast<const dataType*>(inputData), inputShape, axis,    \
+                             isArgMin, reinterpret_cast<int32_t*>(outputData), outputShape);    \
     }
 
     NNAPI_IMPL_ARG_MIN_MAX(OperandType::TENSOR_FLOAT16, _Float16);
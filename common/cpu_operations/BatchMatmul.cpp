@@ -21,14 +21,15 @@
 #pragma clang diagnostic ignored "-Wunused-parameter"
 #pragma clang diagnostic ignored "-Wsign-compare"
 #pragma clang diagnostic ignored "-Winvalid-partial-specialization"
-#include <tensorflow/lite/kernels/internal/reference/reference_ops.h>
-#include <tensorflow/lite/kernels/internal/runtime_shape.h>
+#include <tensorflow/lite/kernels/internal/common.h>
 #pragma clang diagnostic pop
 
+#include <algorithm>
 #include <limits>
-#include <memory>
+#include <type_traits>
 #include <vector>
 
+#include "CpuGemm.h"
 #include "CpuOperationUtils.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
@@ -71,130 +72,112 @@ std::vector<uint32_t> computeOutputDimensions(const Shape& LHSTensorShape,
     return outputTensorDimensions;
 }
 
-// Swaps row and column dimensions for a shape.
-Shape swapRowColumnDims(const Shape& shape) {
-    Shape swappedShape = shape;
-    uint32_t numDims = getNumberOfDimensions(shape);
-    swappedShape.dimensions[numDims - 2] = shape.dimensions[numDims - 1];
-    swappedShape.dimensions[numDims - 1] = shape.dimensions[numDims - 2];
-    return swappedShape;
-}
-
-// Transposes a matrix.
+// Describes one input of the multiplication in place, including the transposition requested by
+// adj and the broadcasting of its batch dimensions to those of the output.
 template <typename T>
-void transposeRowsColumns(const T* inputData, const Shape& inputShape, T* outputData) {
-    Shape transposedShape = swapRowColumnDims(inputShape);
-    tflite::TransposeParams params;
-    int rank = getNumberOfDimensions(inputShape);
-    params.perm_count = rank;
-    for (int i = 0; i < rank - 2; ++i) {
-        params.perm[i] = i;
+bool getGemmInput(const T* data, const Shape& shape, bool adj, const Shape& outputShape,
+                  ScratchWorkspace* workspace, std::vector<size_t>* storage,
+                  GemmInput<T>* input) {
+    const uint32_t numDims = getNumberOfDimensions(shape);
+    for (uint32_t i = 0; i < numDims - 2; ++i) {
+        const uint32_t size = getSizeOfDimension(shape, i);
+        NN_RET_CHECK(size == 1 || size == getSizeOfDimension(outputShape, i))
+                << "Batch dimensions cannot be broadcast.";
     }
-    params.perm[rank - 2] = rank - 1;
-    params.perm[rank - 1] = rank - 2;
-    tflite::reference_ops::Transpose(params, convertShapeToTflshape(inputShape), inputData,
-                                     convertShapeToTflshape(transposedShape), outputData);
+    const uint32_t numBatches = getNumberOfElements(outputShape, 0, numDims - 2);
+    size_t* batchOffsets = allocateTemporaryBuffer<size_t>(numBatches, workspace, storage);
+    NN_RET_CHECK(batchOffsets != nullptr);
+    const size_t matrixSize = static_cast<size_t>(getSizeOfDimension(shape, numDims - 2)) *
+                              getSizeOfDimension(shape, numDims - 1);
+    for (uint32_t batch = 0; batch < numBatches; ++batch) {
+        size_t inputBatch = 0;
+        for (uint32_t i = 0, remaining = batch; i < numDims - 2; ++i) {
+            const uint32_t outputBatchSize = getNumberOfElements(outputShape, i + 1, numDims - 2);
+            const uint32_t index = remaining / outputBatchSize;
+            remaining %= outputBatchSize;
+            const uint32_t size = getSizeOfDimension(shape, i);
+            inputBatch = inputBatch * size + (size == 1 ? 0 : index);
+        }
+        batchOffsets[batch] = inputBatch * matrixSize;
+    }
+    const size_t numColumns = getSizeOfDimension(shape, numDims - 1);
+    input->data = data;
+    input->batchOffsets = batchOffsets;
+    input->rowStride = adj ? 1 : numColumns;
+    input->columnStride = adj ? numColumns : 1;
+    return true;
 }
 
-// Creates a temporary space in heap.
-// Note that it is caller's responsibility to free the memory.
-template <typename T>
-std::unique_ptr<T[]> getTempData(uint32_t numElems) {
-    return std::unique_ptr<T[]>(new (std::nothrow) T[numElems]);
+// Returns the dimensions of the multiplication of LHS <..., A, B> and RHS <..., B, C>.
+GemmDimensions getGemmDimensions(const Shape& inputLHSShape, bool adjX,
+                                 const Shape& outputShape) {
+    const uint32_t numDims = getNumberOfDimensions(outputShape);
+    GemmDimensions dims;
+    dims.batches = getNumberOfElements(outputShape, 0, numDims - 2);
+    dims.rows = getSizeOfDimension(outputShape, numDims - 2);
+    dims.depth = getSizeOfDimension(inputLHSShape, adjX ? numDims - 2 : numDims - 1);
+    dims.columns = getSizeOfDimension(outputShape, numDims - 1);
+    return dims;
 }
 
 // Performs batch matmul.
 // LHS <..., A, B>  X  RHS<..., B, C>
-// We assume that LHS and RHS are both row oriented (adjacent values in memory
-// are in the same row) and will output in the same memory layout. However,
-// TFLite's fast GEMM libraries assume RCC layout (LHS row oriented,
-// RHS column oriented, output column oriented). Therefore, we perform
-// RHS <..., C, B> X LHS <..., B, A>
-// where output is a C X A column-oriented, which is equivalent to
-// A X C row-oriented.
+// The transposition requested by adjX and adjY and the broadcasting of the batch dimensions are
+// handled by the strides and batch offsets of the GEMM inputs, so neither input is copied.
 template <typename T>
 bool batchMatMulGeneric(const T* inputLHSData, const Shape& inputLHSShape, const T* inputRHSData,
                         const Shape& inputRHSShape, const bool adjX, const bool adjY, T* outputData,
-                        const Shape& outputShape) {
+                        const Shape& outputShape, ScratchWorkspace* workspace) {
     NNTRACE_TRANS("batchMatMulGeneric");
     // Only performs transpose without conjugation for adjoint since complex number is not
-    // supported.
-    NNTRACE_COMP_SWITCH("reference_ops::Transpose");
-    const T* realInputLHSData = inputLHSData;
-    const T* realInputRHSData = inputRHSData;
-    auto tempInputLHSData = getTempData<T>(getNumberOfElements(inputLHSShape));
-    auto tempInputRHSData = getTempData<T>(getNumberOfElements(inputRHSShape));
-    // For LHS, it's passed as RHS and column-oriented.
-    // If adjX is false, needs to swap shape but no need to do data transpose.
-    // If adjX is true, no need to swap shape but needs to do data transpose.
-    // For RHS, it's passed as LHS and row-oriented.
-    // If adjY is false, needs to swap shape also needs to do data transpose.
-    // If adjY is true, no need to swap shape also no need to do data transpose.
-    if (adjX) {
-        transposeRowsColumns(inputLHSData, inputLHSShape, tempInputLHSData.get());
-        realInputLHSData = tempInputLHSData.get();
-    }
-    if (!adjY) {
-        transposeRowsColumns(inputRHSData, inputRHSShape, tempInputRHSData.get());
-        realInputRHSData = tempInputRHSData.get();
-    }
-    Shape realInputLHSShape = adjX ? inputLHSShape : swapRowColumnDims(inputLHSShape);
-    Shape realInputRHSShape = adjY ? inputRHSShape : swapRowColumnDims(inputRHSShape);
-    NNTRACE_COMP_SWITCH("reference_ops::BatchMatMul");
-    tflite::reference_ops::BatchMatMul(convertShapeToTflshape(realInputRHSShape), realInputRHSData,
-                                       convertShapeToTflshape(realInputLHSShape), realInputLHSData,
-                                       convertShapeToTflshape(outputShape), outputData);
-    return true;
+    // supported. Float16 products are accumulated in float32.
+    using AccT = std::conditional_t<std::is_same_v<T, int32_t>, int32_t, float>;
+    std::vector<size_t> lhsStorage, rhsStorage;
+    GemmInput<T> lhs, rhs;
+    NN_RET_CHECK(getGemmInput(inputLHSData, inputLHSShape, adjX, outputShape, workspace,
+                              &lhsStorage, &lhs));
+    NN_RET_CHECK(getGemmInput(inputRHSData, inputRHSShape, adjY, outputShape, workspace,
+                              &rhsStorage, &rhs));
+    NNTRACE_COMP_SWITCH("batchGemm");
+    return batchGemm<AccT>(
+            getGemmDimensions(inputLHSShape, adjX, outputShape), lhs, rhs, outputData,
+            [](AccT sum) { return static_cast<T>(sum); }, workspace);
 }
 
 // Performs batch matmul for quantized types.
 template <typename T>
 bool batchMatMulQuantized(const T* inputLHSData, const Shape& inputLHSShape, const T* inputRHSData,
                           const Shape& inputRHSShape, const bool adjX, const bool adjY,
-                          T* outputData, const Shape& outputShape) {
+                          T* outputData, const Shape& outputShape, ScratchWorkspace* workspace) {
     NNTRACE_TRANS("batchMatMulQuantized");
-    NNTRACE_COMP_SWITCH("reference_ops::Transpose");
-    const T* realInputLHSData = inputLHSData;
-    const T* realInputRHSData = inputRHSData;
-    auto tempInputLHSData = getTempData<T>(getNumberOfElements(inputLHSShape));
-    auto tempInputRHSData = getTempData<T>(getNumberOfElements(inputRHSShape));
-    if (adjX) {
-        transposeRowsColumns(inputLHSData, inputLHSShape, tempInputLHSData.get());
-        realInputLHSData = tempInputLHSData.get();
-    }
-    if (!adjY) {
-        transposeRowsColumns(inputRHSData, inputRHSShape, tempInputRHSData.get());
-        realInputRHSData = tempInputRHSData.get();
-    }
-    Shape realInputLHSShape = adjX ? inputLHSShape : swapRowColumnDims(inputLHSShape);
-    Shape realInputRHSShape = adjY ? inputRHSShape : swapRowColumnDims(inputRHSShape);
-
-    NNTRACE_COMP_SWITCH("reference_ops::BatchMatMul");
-
     double realMultiplier = 0.0;
     int32_t outputMultiplier = 0;
     int32_t outputShift = 0;
-    NN_RET_CHECK(GetQuantizedConvolutionMultiplier(realInputLHSShape, realInputRHSShape,
-                                                   outputShape, &realMultiplier));
+    NN_RET_CHECK(GetQuantizedConvolutionMultiplier(inputLHSShape, inputRHSShape, outputShape,
+                                                   &realMultiplier));
     NN_RET_CHECK(QuantizeMultiplier(realMultiplier, &outputMultiplier, &outputShift));
-    tflite::FullyConnectedParams params;
-    params.input_offset = -realInputLHSShape.offset;
-    params.weights_offset = -realInputRHSShape.offset;
-    params.output_offset = outputShape.offset;
-    params.output_multiplier = outputMultiplier;
-    params.output_shift = outputShift;
-    // BatchMatMul has no fused activation functions. Therefore, sets
-    // output activation min and max to min and max of int8_t.
-    params.quantized_activation_min = std::numeric_limits<int8_t>::min();
-    params.quantized_activation_max = std::numeric_limits<int8_t>::max();
-    params.lhs_cacheable = false;
-    params.rhs_cacheable = false;
+    const int32_t outputOffset = outputShape.offset;
+    // BatchMatMul has no fused activation functions. Therefore, clamps the output to the range
+    // of T.
+    auto requantize = [outputMultiplier, outputShift, outputOffset](int32_t sum) {
+        const int32_t value = tflite::MultiplyByQuantizedMultiplier(sum, outputMultiplier,
+                                                                    outputShift) +
+                              outputOffset;
+        return static_cast<T>(std::clamp<int32_t>(value, std::numeric_limits<T>::min(),
+                                                  std::numeric_limits<T>::max()));
+    };
 
-    tflite::reference_ops::BatchMatMul<T, int32_t>(
-            params, convertShapeToTflshape(realInputRHSShape), realInputRHSData,
-            convertShapeToTflshape(realInputLHSShape), realInputLHSData,
-            convertShapeToTflshape(outputShape), outputData);
-    return true;
+    std::vector<size_t> lhsStorage, rhsStorage;
+    GemmInput<T> lhs, rhs;
+    NN_RET_CHECK(getGemmInput(inputLHSData, inputLHSShape, adjX, outputShape, workspace,
+                              &lhsStorage, &lhs));
+    NN_RET_CHECK(getGemmInput(inputRHSData, inputRHSShape, adjY, outputShape, workspace,
+                              &rhsStorage, &rhs));
+    lhs.zeroPoint = inputLHSShape.offset;
+    rhs.zeroPoint = inputRHSShape.offset;
+    NNTRACE_COMP_SWITCH("batchGemm");
+    return batchGemm<int32_t>(getGemmDimensions(inputLHSShape, adjX, outputShape), lhs, rhs,
+                              outputData, requantize, workspace);
 }
 
 }  // namespace
@@ -236,7 +219,8 @@ bool execute(IOperationExecutionContext* context) {
                                       context->getInputValue<bool>(kInputLHSAdj),
                                       context->getInputValue<bool>(kInputRHSAdj),
                                       context->getOutputBuffer<float>(kOutputTensor),
-                                      context->getOutputShape(kOutputTensor));
+                                      context->getOutputShape(kOutputTensor),
+                                      context->getScratchWorkspace());
         case OperandType::TENSOR_FLOAT16:
             return batchMatMulGeneric(context->getInputBuffer<_Float16>(kInputLHSTensor),
                                       context->getInputShape(kInputLHSTensor),
@@ -245,7 +229,8 @@ bool execute(IOperationExecutionContext* context) {
                                       context->getInputValue<bool>(kInputLHSAdj),
                                       context->getInputValue<bool>(kInputRHSAdj),
                                       context->getOutputBuffer<_Float16>(kOutputTensor),
-                                      context->getOutputShape(kOutputTensor));
+                                      context->getOutputShape(kOutputTensor),
+                                      context->getScratchWorkspace());
         case OperandType::TENSOR_INT32:
             return batchMatMulGeneric(context->getInputBuffer<int32_t>(kInputLHSTensor),
                                       context->getInputShape(kInputLHSTensor),
@@ -254,7 +239,8 @@ bool execute(IOperationExecutionContext* context) {
                                       context->getInputValue<bool>(kInputLHSAdj),
                                       context->getInputValue<bool>(kInputRHSAdj),
                                       context->getOutputBuffer<int32_t>(kOutputTensor),
-                                      context->getOutputShape(kOutputTensor));
+                                      context->getOutputShape(kOutputTensor),
+                                      context->getScratchWorkspace());
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
             return batchMatMulQuantized(context->getInputBuffer<int8_t>(kInputLHSTensor),
                                         context->getInputShape(kInputLHSTensor),
@@ -263,7 +249,8 @@ bool execute(IOperationExecutionContext* context) {
                                         context->getInputValue<bool>(kInputLHSAdj),
                                         context->getInputValue<bool>(kInputRHSAdj),
                                         context->getOutputBuffer<int8_t>(kOutputTensor),
-                                        context->getOutputShape(kOutputTensor));
+                                        context->getOutputShape(kOutputTensor),
+                                        context->getScratchWorkspace());
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation " << kOperationName;
     }
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "CpuGemm.h"
+#include "CpuParallelFor.h"
+#include "OperationsExecutionUtils.h"
+
+namespace android::nn {
+namespace {
+
+// The BATCH_MATMUL operations of the self-attention layers of a transformer with 12 heads of 64
+// values, for a sequence of the given length:
+// - Query x Key^T: <12, seq, 64> x <12, seq, 64> with adjY.
+// - Scores x Value: <12, seq, seq> x <12, seq, 64>.
+// The feed-forward projection <1, seq, 768> x <1, 768, 3072> is included for comparison.
+enum class AttentionMatMul { kQueryKey, kScoresValue, kFeedForward };
+
+struct BatchMatMulCase {
+    GemmDimensions dims;
+    bool adjY = false;
+};
+
+BatchMatMulCase getCase(AttentionMatMul matMul, uint32_t sequenceLength) {
+    switch (matMul) {
+        case AttentionMatMul::kQueryKey:
+            return {{12, sequenceLength, 64, sequenceLength}, true};
+        case AttentionMatMul::kScoresValue:
+            return {{12, sequenceLength, sequenceLength, 64}, false};
+        case AttentionMatMul::kFeedForward:
+            return {{1, sequenceLength, 768, 3072}, false};
+    }
+    return {};
+}
+
+class BatchMatMulFixture {
+   public:
+    explicit BatchMatMulFixture(const BatchMatMulCase& testCase) : mCase(testCase) {
+        const GemmDimensions& dims = mCase.dims;
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+        mLhs.resize(static_cast<size_t>(dims.batches) * dims.rows * dims.depth);
+        mRhs.resize(static_cast<size_t>(dims.batches) * dims.depth * dims.columns);
+        mOutput.resize(static_cast<size_t>(dims.batches) * dims.rows * dims.columns);
+        for (float& value : mLhs) value = distribution(random);
+        for (float& value : mRhs) value = distribution(random);
+        for (uint32_t b = 0; b < dims.batches; ++b) {
+            mLhsOffsets.push_back(static_cast<size_t>(b) * dims.rows * dims.depth);
+            mRhsOffsets.push_back(static_cast<size_t>(b) * dims.depth * dims.columns);
+        }
+    }
+
+    bool runGemm(ScratchWorkspace* workspace) {
+        const GemmDimensions& dims = mCase.dims;
+        const GemmInput<float> lhs = {.data = mLhs.data(),
+                                      .batchOffsets = mLhsOffsets.data(),
+                                      .rowStride = dims.depth,
+                                      .columnStride = 1};
+        const GemmInput<float> rhs = {.data = mRhs.data(),
+                                      .batchOffsets = mRhsOffsets.data(),
+                                      .rowStride = mCase.adjY ? 1 : dims.columns,
+                                      .columnStride = mCase.adjY ? dims.depth : 1};
+        const bool success = batchGemm<float>(
+                dims, lhs, rhs, mOutput.data(), [](float sum) { return sum; }, workspace);
+        workspace->reset();
+        return success;
+    }
+
+    // Mirrors the previous implementation of BATCH_MATMUL, which transposed the RHS into a
+    // temporary unless adjY was set and then ran a triple loop over every batch.
+    void runReference() {
+        const GemmDimensions& dims = mCase.dims;
+        std::vector<float> transposedRhs(mRhs.size());
+        const float* rhs = mRhs.data();
+        if (!mCase.adjY) {
+            for (uint32_t b = 0; b < dims.batches; ++b) {
+                const float* in = mRhs.data() + mRhsOffsets[b];
+                float* out = transposedRhs.data() + mRhsOffsets[b];
+                for (uint32_t k = 0; k < dims.depth; ++k) {
+                    for (uint32_t c = 0; c < dims.columns; ++c) {
+                        out[c * dims.depth + k] = in[k * dims.columns + c];
+                    }
+                }
+            }
+            rhs = transposedRhs.data();
+        }
+        for (uint32_t b = 0; b < dims.batches; ++b) {
+            const float* lhsBatch = mLhs.data() + mLhsOffsets[b];
+            const float* rhsBatch = rhs + mRhsOffsets[b];
+            float* outBatch = mOutput.data() + static_cast<size_t>(b) * dims.rows * dims.columns;
+            for (uint32_t r = 0; r < dims.rows; ++r) {
+                for (uint32_t c = 0; c < dims.columns; ++c) {
+                    float total = 0.0f;
+                    for (uint32_t k = 0; k < dims.depth; ++k) {
+                        total += lhsBatch[r * dims.depth + k] * rhsBatch[c * dims.depth + k];
+                    }
+                    outBatch[r * dims.columns + c] = total;
+                }
+            }
+        }
+    }
+
+    uint64_t getMultiplyAccumulateCount() const {
+        const GemmDimensions& dims = mCase.dims;
+        return static_cast<uint64_t>(dims.batches) * dims.rows * dims.depth * dims.columns;
+    }
+
+   private:
+    const BatchMatMulCase mCase;
+    std::vector<float> mLhs;
+    std::vector<float> mRhs;
+    std::vector<float> mOutput;
+    std::vector<size_t> mLhsOffsets;
+    std::vector<size_t> mRhsOffsets;
+};
+
+void setCounters(benchmark::State& state, const BatchMatMulFixture& fixture) {
+    state.counters["MACs"] = benchmark::Counter(
+            static_cast<double>(fixture.getMultiplyAccumulateCount()),
+            benchmark::Counter::kIsIterationInvariantRate, benchmark::Counter::kIs1000);
+}
+
+// Arguments: the AttentionMatMul, the sequence length and the number of CPU threads.
+void BM_BatchMatMulGemm(benchmark::State& state) {
+    BatchMatMulFixture fixture(getCase(static_cast<AttentionMatMul>(state.range(0)),
+                                       static_cast<uint32_t>(state.range(1))));
+    setCpuThreadCount(static_cast<uint32_t>(state.range(2)));
+    ScratchWorkspace workspace;
+    for (auto _ : state) {
+        if (!fixture.runGemm(&workspace)) {
+            state.SkipWithError("batchGemm failed");
+            break;
+        }
+    }
+    setCounters(state, fixture);
+    setCpuThreadCount(0);
+}
+
+// Arguments: the AttentionMatMul and the sequence length.
+void BM_BatchMatMulReference(benchmark::State& state) {
+    BatchMatMulFixture fixture(getCase(static_cast<AttentionMatMul>(state.range(0)),
+                                       static_cast<uint32_t>(state.range(1))));
+    for (auto _ : state) {
+        fixture.runReference();
+    }
+    setCounters(state, fixture);
+}
+
+void addGemmArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"matmul", "seq", "threads"});
+    for (int64_t matMul : {0, 1, 2}) {
+        for (int64_t sequenceLength : {128, 384}) {
+            for (int64_t threadCount : {1, 4}) {
+                benchmark->Args({matMul, sequenceLength, threadCount});
+            }
+        }
+    }
+    benchmark->Unit(benchmark::kMicrosecond)->UseRealTime();
+}
+
+void addReferenceArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"matmul", "seq"});
+    for (int64_t matMul : {0, 1, 2}) {
+        for (int64_t sequenceLength : {128, 384}) {
+            benchmark->Args({matMul, sequenceLength});
+        }
+    }
+    benchmark->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK(BM_BatchMatMulGemm)->Apply(addGemmArguments);
+BENCHMARK(BM_BatchMatMulReference)->Apply(addReferenceArguments);
+
+}  // namespace
+}  // namespace android::nn
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "CpuGemm.h"
+#include "OperationsExecutionUtils.h"
+
+namespace android::nn {
+namespace {
+
+TEST(BatchGemmTest, TransposedInputsAreReadInPlace) {
+    // Two batches of a 5 x 300 LHS stored transposed and a 300 x 9 RHS shared by both batches.
+    constexpr GemmDimensions kDims = {.batches = 2, .rows = 5, .depth = 300, .columns = 9};
+    std::vector<int8_t> lhsData(kDims.batches * kDims.depth * kDims.rows);
+    std::vector<int8_t> rhsData(kDims.depth * kDims.columns);
+    for (size_t i = 0; i < lhsData.size(); ++i) lhsData[i] = static_cast<int8_t>(i % 7 - 3);
+    for (size_t i = 0; i < rhsData.size(); ++i) rhsData[i] = static_cast<int8_t>(i % 5 - 2);
+    const std::vector<size_t> lhsOffsets = {0, kDims.depth * kDims.rows};
+    const std::vector<size_t> rhsOffsets = {0, 0};
+    const GemmInput<int8_t> lhs = {.data = lhsData.data(),
+                                   .batchOffsets = lhsOffsets.data(),
+                                   .rowStride = 1,
+                                   .columnStride = kDims.rows,
+                                   .zeroPoint = 1};
+    const GemmInput<int8_t> rhs = {.data = rhsData.data(),
+                                   .batchOffsets = rhsOffsets.data(),
+                                   .rowStride = kDims.columns,
+                                   .columnStride = 1,
+                                   .zeroPoint = -2};
+
+    std::vector<int32_t> output(kDims.batches * kDims.rows * kDims.columns);
+    ScratchWorkspace workspace;
+    ASSERT_TRUE(batchGemm<int32_t>(
+            kDims, lhs, rhs, output.data(), [](int32_t sum) { return sum; }, &workspace));
+
+    for (uint32_t b = 0; b < kDims.batches; ++b) {
+        for (uint32_t r = 0; r < kDims.rows; ++r) {
+            for (uint32_t c = 0; c < kDims.columns; ++c) {
+                int32_t expected = 0;
+                for (uint32_t k = 0; k < kDims.depth; ++k) {
+                    expected += (lhsData[lhsOffsets[b] + k * kDims.rows + r] - 1) *
+                                (rhsData[k * kDims.columns + c] + 2);
+                }
+                EXPECT_EQ(output[(b * kDims.rows + r) * kDims.columns + c], expected);
+            }
+        }
+    }
+}
+
+TEST(BatchGemmTest, OutputStageIsAppliedToEverySum) {
+    constexpr GemmDimensions kDims = {.batches = 1, .rows = 3, .depth = 2, .columns = 2};
+    const std::vector<float> lhsData = {1, 2, 3, 4, 5, 6};
+    const std::vector<float> rhsData = {1, 0, 0, 1};
+    const std::vector<size_t> offsets = {0};
+    const GemmInput<float> lhs = {.data = lhsData.data(),
+                                   .batchOffsets = offsets.data(),
+                                   .rowStride = 2,
+                                   .columnStride = 1};
+    const GemmInput<float> rhs = {.data = rhsData.data(),
+                                   .batchOffsets = offsets.data(),
+                                   .rowStride = 2,
+                                   .columnStride = 1};
+
+    std::vector<int32_t> output(kDims.rows * kDims.columns);
+    ASSERT_TRUE(batchGemm<float>(
+            kDims, lhs, rhs, output.data(),
+            [](float sum) { return static_cast<int32_t>(sum * 10); }, nullptr));
+    EXPECT_EQ(output, (std::vector<int32_t>{10, 20, 30, 40, 50, 60}));
+}
+
+TEST(BatchGemmTest, DistinctRhsArePackedOnce) {
+    // Batches 0 and 2 share an RHS and batch 1 has its own. The rows are split across several
+    // tasks, each of which reads the RHS packed before the work was split.
+    constexpr GemmDimensions kDims = {.batches = 3, .rows = 300, .depth = 70, .columns = 20};
+    constexpr size_t kLhsSize = kDims.rows * kDims.depth;
+    constexpr size_t kRhsSize = kDims.depth * kDims.columns;
+    std::vector<float> lhsData(kDims.batches * kLhsSize);
+    std::vector<float> rhsData(2 * kRhsSize);
+    for (size_t i = 0; i < lhsData.size(); ++i) lhsData[i] = static_cast<float>(i % 7) - 3;
+    for (size_t i = 0; i < rhsData.size(); ++i) rhsData[i] = static_cast<float>(i % 5) - 2;
+    const std::vector<size_t> lhsOffsets = {0, kLhsSize, 2 * kLhsSize};
+    const std::vector<size_t> rhsOffsets = {kRhsSize, 0, kRhsSize};
+    const GemmInput<float> lhs = {.data = lhsData.data(),
+                                  .batchOffsets = lhsOffsets.data(),
+                                  .rowStride = kDims.depth,
+                                  .columnStride = 1};
+    const GemmInput<float> rhs = {.data = rhsData.data(),
+                                  .batchOffsets = rhsOffsets.data(),
+                                  .rowStride = kDims.columns,
+                                  .columnStride = 1};
+
+    std::vector<float> output(kDims.batches * kDims.rows * kDims.columns);
+    ScratchWorkspace workspace;
+    ASSERT_TRUE(batchGemm<float>(
+            kDims, lhs, rhs, output.data(), [](float sum) { return sum; }, &workspace));
+
+    for (uint32_t b = 0; b < kDims.batches; ++b) {
+        for (uint32_t r = 0; r < kDims.rows; ++r) {
+            for (uint32_t c = 0; c < kDims.columns; ++c) {
+                float expected = 0;
+                for (uint32_t k = 0; k < kDims.depth; ++k) {
+                    expected += lhsData[lhsOffsets[b] + r * kDims.depth + k] *
+                                rhsData[rhsOffsets[b] + k * kDims.columns + c];
+                }
+                EXPECT_EQ(output[(b * kDims.rows + r) * kDims.columns + c], expected);
+            }
+        }
+    }
+}
+
+}  // namespace
+}  // namespace android::nn
@@ -333,8 +333,8 @@ bool BidirectionalSequenceLSTM::Prepare(const Operation& operation, RunTimeOpera
 
     if (has_aux_input) {
         // Check that aux_input has the same dimensions (except last) as the input.
-        NN_CHECK_EQ(aux_input_->shape().dimensions[0], input_->shape().dimensions[0]);
-        NN_CHECK_EQ(aux_input_->shape().dimensions[1], input_->shape().dimensions[1]);
+        NN_CHECK_EQ(aux_input_->dimensions[0], input_->dimensions[0]);
+        NN_CHECK_EQ(aux_input_->dimensions[1], input_->dimensions[1]);
     }
 
     if (has_fw_aux_weights) {
@@ -439,7 +439,7 @@ bool BidirectionalSequenceLSTM::Prepare(const Operation& operation, RunTimeOpera
 bool BidirectionalSequenceLSTM::Eval() {
     const uint32_t n_fw_output = SizeOfDimension(fw_recurrent_to_output_weights_, 1);
     const uint32_t n_bw_output = SizeOfDimension(bw_recurrent_to_output_weights_, 1);
-    std::vector<uint32_t> fw_output_dims = input_->shape().dimensions;
+    std::vector<uint32_t> fw_output_dims = input_->dimensions;
     fw_output_dims[2] = n_fw_output;
     std::vector<uint32_t> bw_output_dims = fw_output_dims;
     bw_output_dims[2] = n_bw_output;
@@ -473,8 +473,8 @@ bool BidirectionalSequenceLSTM::Eval() {
                 fw_output_cell_state_buffer = GetBuffer<float>(fw_output_cell_state_);
             } else {
                 fw_output_activation_state.resize(
-                        getNumberOfElements(fw_activation_state_->shape()));
-                fw_output_cell_state.resize(getNumberOfElements(fw_cell_state_->shape()));
+                        getNumberOfElements(fw_activation_state_->shapeView()));
+                fw_output_cell_state.resize(getNumberOfElements(fw_cell_state_->shapeView()));
 
                 fw_output_activation_state_buffer = fw_output_activation_state.data();
                 fw_output_cell_state_buffer = fw_output_cell_state.data();
@@ -525,8 +525,8 @@ bool BidirectionalSequenceLSTM::Eval() {
                 bw_output_cell_state_buffer = GetBuffer<float>(bw_output_cell_state_);
             } else {
                 bw_output_activation_state.resize(
-                        getNumberOfElements(bw_activation_state_->shape()));
-                bw_output_cell_state.resize(getNumberOfElements(bw_cell_state_->shape()));
+                        getNumberOfElements(bw_activation_state_->shapeView()));
+                bw_output_cell_state.resize(getNumberOfElements(bw_cell_state_->shapeView()));
 
                 bw_output_activation_state_buffer = bw_output_activation_state.data();
                 bw_output_cell_state_buffer = bw_output_cell_state.data();
@@ -597,8 +597,8 @@ bool BidirectionalSequenceLSTM::Eval() {
                 fw_output_cell_state_buffer = GetBuffer<_Float16>(fw_output_cell_state_);
             } else {
                 fw_output_activation_state.resize(
-                        getNumberOfElements(fw_activation_state_->shape()));
-                fw_output_cell_state.resize(getNumberOfElements(fw_cell_state_->shape()));
+                        getNumberOfElements(fw_activation_state_->shapeView()));
+                fw_output_cell_state.resize(getNumberOfElements(fw_cell_state_->shapeView()));
 
                 fw_output_activation_state_buffer = fw_output_activation_state.data();
                 fw_output_cell_state_buffer = fw_output_cell_state.data();
@@ -650,8 +650,8 @@ bool BidirectionalSequenceLSTM::Eval() {
                 bw_output_cell_state_buffer = GetBuffer<_Float16>(bw_output_cell_state_);
             } else {
                 bw_output_activation_state.resize(
-                        getNumberOfElements(bw_activation_state_->shape()));
-                bw_output_cell_state.resize(getNumberOfElements(bw_cell_state_->shape()));
+                        getNumberOfElements(bw_activation_state_->shapeView()));
+                bw_output_cell_state.resize(getNumberOfElements(bw_cell_state_->shapeView()));
 
                 bw_output_activation_state_buffer = bw_output_activation_state.data();
                 bw_output_cell_state_buffer = bw_output_cell_state.data();
@@ -449,7 +449,7 @@ bool prepare(IOperationExecutionContext* context) {
 
 bool executeAdd(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     switch (context->getInputType(kInputTensor1)) {
         case OperandType::TENSOR_FLOAT16:
             return addFloat16(context->getInputBuffer<_Float16>(kInputTensor1),
@@ -499,7 +499,7 @@ bool executeAdd(IOperationExecutionContext* context) {
 
 bool executeMul(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     switch (context->getInputType(kInputTensor1)) {
         case OperandType::TENSOR_FLOAT16:
             return mulFloat16(context->getInputBuffer<_Float16>(kInputTensor1),
@@ -549,7 +549,7 @@ bool executeMul(IOperationExecutionContext* context) {
 
 bool executeSub(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     switch (context->getInputType(kInputTensor1)) {
         case OperandType::TENSOR_FLOAT16:
             return subFloat16(context->getInputBuffer<_Float16>(kInputTensor1),
@@ -599,7 +599,7 @@ bool executeSub(IOperationExecutionContext* context) {
 
 bool executeDiv(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     switch (context->getInputType(kInputTensor1)) {
         case OperandType::TENSOR_FLOAT16:
             return divFloat16(context->getInputBuffer<_Float16>(kInputTensor1),
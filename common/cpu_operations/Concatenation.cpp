@@ -39,6 +39,7 @@
 #pragma clang diagnostic pop
 
 #include "CpuOperationUtils.h"
+#include "CpuTensorCopy.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 namespace android {
@@ -94,6 +95,35 @@ bool concatenation<uint8_t>(const std::vector<const uint8_t*>& inputDataPtrs,
     return true;
 }
 
+// Whether every input has the scale and zero point of the output, in which case concatenation
+// copies the inputs unchanged.
+bool hasOutputQuantization(const std::vector<Shape>& inputShapes, const Shape& outputShape) {
+    return std::all_of(inputShapes.begin(), inputShapes.end(), [&outputShape](const Shape& shape) {
+        return shape.scale == outputShape.scale && shape.offset == outputShape.offset;
+    });
+}
+
+// Copies each input to its slice of every row of the output along the axis.
+template <typename T>
+bool concatenationByCopy(const std::vector<const T*>& inputDataPtrs,
+                         const std::vector<Shape>& inputShapes, int32_t axis, T* outputData,
+                         const Shape& outputShape) {
+    NNTRACE_TRANS("concatenationByCopy");
+    const uint32_t numDimensions = getNumberOfDimensions(outputShape);
+    const uint32_t outerSize = getNumberOfElements(outputShape, 0, axis);
+    const uint32_t outputInnerSize = getNumberOfElements(outputShape, axis, numDimensions);
+    uint32_t outputOffset = 0;
+    for (size_t i = 0; i < inputDataPtrs.size(); ++i) {
+        const uint32_t innerSize = getNumberOfElements(inputShapes[i], axis, numDimensions);
+        NN_RET_CHECK(copyTensor(
+                inputDataPtrs[i], outputData + outputOffset, sizeof(T),
+                {{.size = outerSize, .inputStride = innerSize, .outputStride = outputInnerSize},
+                 {.size = innerSize, .inputStride = 1, .outputStride = 1}}));
+        outputOffset += innerSize;
+    }
+    return true;
+}
+
 template <typename T>
 inline bool concatenation(IOperationExecutionContext* context) {
     uint32_t inputCount = context->getNumInputs() - 1;
@@ -105,35 +135,51 @@ inline bool concatenation(IOperationExecutionContext* context) {
         inputDatas.push_back(buffer);
         inputShapes.push_back(context->getInputShape(i));
     }
-    return concatenation(inputDatas, inputShapes, context->getInputValue<int32_t>(inputCount),
-                         context->getOutputBuffer<T>(kOutputTensor),
-                         context->getOutputShape(kOutputTensor));
+    const int32_t axis = context->getInputValue<int32_t>(inputCount);
+    const Shape outputShape = context->getOutputShape(kOutputTensor);
+    T* outputData = context->getOutputBuffer<T>(kOutputTensor);
+    if (hasOutputQuantization(inputShapes, outputShape)) {
+        return concatenationByCopy(inputDatas, inputShapes, axis, outputData, outputShape);
+    }
+    return concatenation(inputDatas, inputShapes, axis, outputData, outputShape);
 }
 
 template <>
 inline bool concatenation<int8_t>(IOperationExecutionContext* context) {
     uint32_t inputCount = context->getNumInputs() - 1;
+    const int32_t axis = context->getInputValue<int32_t>(inputCount);
+    std::vector<Shape> inputShapes;
+    for (uint32_t i = 0; i < inputCount; ++i) {
+        inputShapes.push_back(context->getInputShape(i));
+    }
+    Shape outputShape(context->getOutputShape(kOutputTensor));
+    if (hasOutputQuantization(inputShapes, outputShape)) {
+        std::vector<const int8_t*> inputDatas;
+        for (uint32_t i = 0; i < inputCount; ++i) {
+            inputDatas.push_back(context->getInputBuffer<int8_t>(i));
+        }
+        return concatenationByCopy(inputDatas, inputShapes, axis,
+                                   context->getOutputBuffer<int8_t>(kOutputTensor), outputShape);
+    }
+
     std::vector<std::vector<uint8_t>> inputs_uint8(inputCount);
     for (uint32_t i = 0; i < inputCount; ++i) {
-        const auto currentSize = getNumberOfElements(context->getInputShape(i));
+        const auto currentSize = getNumberOfElements(context->getInputShapeView(i));
         inputs_uint8[i].resize(currentSize);
         if (currentSize != 0) {
             convertInt8ToUInt8(context->getInputBuffer<int8_t>(i), &inputs_uint8[i]);
         }
     }
     std::vector<const uint8_t*> inputDatas;
-    std::vector<Shape> inputShapes;
     for (uint32_t i = 0; i < inputCount; ++i) {
         inputDatas.push_back(inputs_uint8[i].data());
-        inputShapes.push_back(context->getInputShape(i));
         inputShapes[i].offset += 128;
     }
 
-    std::vector<uint8_t> output_uint8(getNumberOfElements(context->getOutputShape(kOutputTensor)));
-    Shape outputShape(context->getOutputShape(kOutputTensor));
+    std::vector<uint8_t> output_uint8(
+            getNumberOfElements(context->getOutputShapeView(kOutputTensor)));
     outputShape.offset += 128;
-    NN_RET_CHECK(concatenation(inputDatas, inputShapes, context->getInputValue<int32_t>(inputCount),
-                               output_uint8.data(), outputShape));
+    NN_RET_CHECK(concatenation(inputDatas, inputShapes, axis, output_uint8.data(), outputShape));
 
     convertUInt8ToInt8(output_uint8, context->getOutputBuffer<int8_t>(kOutputTensor));
 
@@ -175,7 +221,7 @@ bool prepare(IOperationExecutionContext* context) {
 
 bool execute(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     switch (context->getInputType(0)) {
         case OperandType::TENSOR_FLOAT16:
             return concatenation<_Float16>(context);
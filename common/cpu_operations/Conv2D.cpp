@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <iterator>
 #include <memory>
+#include <type_traits>
 #include <vector>
 
 #include "LegacyUtils.h"
@@ -49,12 +50,8 @@ namespace conv_2d {
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 namespace {
 
-// If possible we will use this static buffer for the tensor.
-constexpr size_t kStaticBufferSize = 1605632;
-[[maybe_unused]] char static_scratch_buffer[kStaticBufferSize];
-
-// executionMutex is used to protect concurrent access of the static_scratch_buffer
-// and other non-threadsafe resources like gemmlowp::GemmContext.
+// executionMutex is used to protect concurrent access of non-threadsafe
+// resources like gemmlowp::GemmContext.
 // std::mutex is safe for pthreads on Android.
 std::mutex executionMutex;
 
@@ -152,7 +149,6 @@ struct Conv2dParam {
                                                                                   \
     Type* im2colData = nullptr;                                                   \
     uint64_t im2colByteSize = sizeof(Type);                                       \
-    std::unique_ptr<Type[]> im2colGuard;                                          \
     for (int i = 0; i < 4; i++) {                                                 \
         im2colByteSize *= im2colDim.sizes[i];                                     \
     }                                                                             \
@@ -161,15 +157,15 @@ struct Conv2dParam {
         LOG(ERROR) << "Conv size is too large, not enough memory";                \
         return false;                                                             \
     }                                                                             \
-    if (im2colByteSize <= kStaticBufferSize) {                                    \
-        im2colData = reinterpret_cast<Type*>(static_scratch_buffer);              \
-    } else {                                                                      \
-        im2colData = new (std::nothrow) Type[im2colByteSize / sizeof(Type)];      \
+    const bool need_im2colData =                                                  \
+            needim2colData(filterShape, stride_width, stride_height,              \
+                           dilation_width_factor, dilation_height_factor);        \
+    if (need_im2colData) {                                                        \
+        im2colData = workspace->allocate<Type>(im2colByteSize / sizeof(Type));    \
         if (im2colData == nullptr) {                                              \
             LOG(ERROR) << "Conv size is too large, not enough memory";            \
             return false;                                                         \
         }                                                                         \
-        im2colGuard.reset(im2colData);                                            \
     }
 
 bool needim2colData(const Shape& filterShape, int32_t stride_width, int32_t stride_height,
@@ -193,7 +189,7 @@ bool convNhwc(const float* inputData, const Shape& inputShape, const float* filt
               int32_t padding_left, int32_t /*padding_right*/, int32_t padding_top,
               int32_t /*padding_bottom*/, int32_t stride_width, int32_t stride_height,
               int32_t dilation_width_factor, int32_t dilation_height_factor, int32_t activation,
-              float* outputData, const Shape& outputShape) {
+              float* outputData, const Shape& outputShape, ScratchWorkspace* workspace) {
     NNTRACE_TRANS("convFloat32");
 
     ANDROID_NN_CONV_PARAMETERS(float)
@@ -201,13 +197,8 @@ bool convNhwc(const float* inputData, const Shape& inputShape, const float* filt
     float output_activation_min, output_activation_max;
     CalculateActivationRangeFloat(activation, &output_activation_min, &output_activation_max);
 
-    // Prevent concurrent executions that may access the scratch buffer.
-    std::unique_lock<std::mutex> lock(executionMutex);
     NNTRACE_COMP_SWITCH("optimized_ops::Conv");
 
-    const bool need_im2colData = needim2colData(filterShape, stride_width, stride_height,
-                                                dilation_width_factor, dilation_height_factor);
-
     tflite::optimized_ops::Conv(
             inputData, convertShapeToDims(inputShape), filterData, convertShapeToDims(filterShape),
             biasData, convertShapeToDims(biasShape), stride_width, stride_height,
@@ -222,7 +213,7 @@ bool convNhwc(const uint8_t* inputData, const Shape& inputShape, const uint8_t*
               int32_t padding_left, int32_t /*padding_right*/, int32_t padding_top,
               int32_t /*padding_bottom*/, int32_t stride_width, int32_t stride_height,
               int32_t dilation_width_factor, int32_t dilation_height_factor, int32_t activation,
-              uint8_t* outputData, const Shape& outputShape) {
+              uint8_t* outputData, const Shape& outputShape, ScratchWorkspace* workspace) {
     NNTRACE_TRANS("convQuant8");
 
     ANDROID_NN_CONV_PARAMETERS(uint8_t)
@@ -247,17 +238,13 @@ bool convNhwc(const uint8_t* inputData, const Shape& inputShape, const uint8_t*
 
     static gemmlowp::GemmContext gemm_context;
 
-    // Prevent concurrent executions that may access the scratch buffer and
-    // gemm_context.
+    // Prevent concurrent executions that may access gemm_context.
     std::unique_lock<std::mutex> lock(executionMutex);
     // Alow gemmlowp automatically decide how many threads to use.
     gemm_context.set_max_num_threads(0);
 
     NNTRACE_COMP_SWITCH("optimized_ops::Conv");
 
-    const bool need_im2colData = needim2colData(filterShape, stride_width, stride_height,
-                                                dilation_width_factor, dilation_height_factor);
-
     tflite::optimized_ops::Conv(inputData, convertShapeToDims(inputShape), inputOffset, filterData,
                                 convertShapeToDims(filterShape), filterOffset, biasData,
                                 convertShapeToDims(biasShape), stride_width, stride_height,
@@ -276,76 +263,129 @@ bool convNhwc(const int8_t* inputData, Shape inputShape, const int8_t* filterDat
               int32_t padding_left, int32_t padding_right, int32_t padding_top,
               int32_t padding_bottom, int32_t stride_width, int32_t stride_height,
               int32_t dilation_width_factor, int32_t dilation_height_factor, int32_t activation,
-              int8_t* outputData, Shape outputShape) {
+              int8_t* outputData, Shape outputShape, ScratchWorkspace* workspace) {
     NNTRACE_TRANS("convQuant8");
 
-    std::vector<uint8_t> unsignedInput(getNumberOfElements(inputShape));
-    convertInt8ToUInt8(inputData, &unsignedInput);
-    inputShape.offset += 128;
+    const uint32_t inputSize = getNumberOfElements(inputShape);
+    const uint32_t filterSize = getNumberOfElements(filterShape);
+    const uint32_t outputSize = getNumberOfElements(outputShape);
+    uint8_t* unsignedInput = workspace->allocate<uint8_t>(inputSize);
+    uint8_t* unsignedFilter = workspace->allocate<uint8_t>(filterSize);
+    uint8_t* unsignedOutput = workspace->allocate<uint8_t>(outputSize);
+    NN_RET_CHECK(unsignedInput != nullptr && unsignedFilter != nullptr &&
+                 unsignedOutput != nullptr);
 
-    std::vector<uint8_t> unsignedFilter(getNumberOfElements(filterShape));
-    convertInt8ToUInt8(filterData, &unsignedFilter);
+    convertInt8ToUInt8(inputData, inputSize, unsignedInput);
+    inputShape.offset += 128;
+    convertInt8ToUInt8(filterData, filterSize, unsignedFilter);
     filterShape.offset += 128;
-
-    std::vector<uint8_t> unsignedOutput(getNumberOfElements(outputShape));
     outputShape.offset += 128;
 
-    NN_RET_CHECK(convNhwc(unsignedInput.data(), inputShape, unsignedFilter.data(), filterShape,
-                          biasData, biasShape, padding_left, padding_right, padding_top,
-                          padding_bottom, stride_width, stride_height, dilation_width_factor,
-                          dilation_height_factor, activation, unsignedOutput.data(), outputShape));
+    NN_RET_CHECK(convNhwc(unsignedInput, inputShape, unsignedFilter, filterShape, biasData,
+                          biasShape, padding_left, padding_right, padding_top, padding_bottom,
+                          stride_width, stride_height, dilation_width_factor,
+                          dilation_height_factor, activation, unsignedOutput, outputShape,
+                          workspace));
 
-    convertUInt8ToInt8(unsignedOutput, outputData);
+    convertUInt8ToInt8(unsignedOutput, outputSize, outputData);
 
     return true;
 }
 
-bool convNhwc(const _Float16* inputData, const Shape& inputShape, const _Float16* filterData,
-              const Shape& filterShape, const _Float16* biasData, const Shape& biasShape,
+// The filter and bias are converted to float32 by the caller, once for all the bands of rows.
+bool convNhwc(const _Float16* inputData, const Shape& inputShape, const float* filterData,
+              const Shape& filterShape, const float* biasData, const Shape& biasShape,
               int32_t padding_left, int32_t padding_right, int32_t padding_top,
               int32_t padding_bottom, int32_t stride_width, int32_t stride_height,
               int32_t dilation_width_factor, int32_t dilation_height_factor, int32_t activation,
-              _Float16* outputData, const Shape& outputShape) {
+              _Float16* outputData, const Shape& outputShape, ScratchWorkspace* workspace) {
     NNTRACE_TRANS("convFloat16");
 
-    std::vector<float> inputData_float32(getNumberOfElements(inputShape));
-    std::vector<float> filterData_float32(getNumberOfElements(filterShape));
-    std::vector<float> biasData_float32(getNumberOfElements(biasShape));
-    std::vector<float> outputData_float32(getNumberOfElements(outputShape));
+    const uint32_t inputSize = getNumberOfElements(inputShape);
+    const uint32_t outputSize = getNumberOfElements(outputShape);
+    float* inputData_float32 = workspace->allocate<float>(inputSize);
+    float* outputData_float32 = workspace->allocate<float>(outputSize);
+    NN_RET_CHECK(inputData_float32 != nullptr && outputData_float32 != nullptr);
 
-    convertFloat16ToFloat32(inputData, &inputData_float32);
-    convertFloat16ToFloat32(filterData, &filterData_float32);
-    convertFloat16ToFloat32(biasData, &biasData_float32);
+    convertFloat16ToFloat32(inputData, inputSize, inputData_float32);
 
-    convNhwc(inputData_float32.data(), inputShape, filterData_float32.data(), filterShape,
-             biasData_float32.data(), biasShape, padding_left, padding_right, padding_top,
-             padding_bottom, stride_width, stride_height, dilation_width_factor,
-             dilation_height_factor, activation, outputData_float32.data(), outputShape);
-    convertFloat32ToFloat16(outputData_float32, outputData);
+    NN_RET_CHECK(convNhwc(inputData_float32, inputShape, filterData, filterShape, biasData,
+                          biasShape, padding_left, padding_right, padding_top, padding_bottom,
+                          stride_width, stride_height, dilation_width_factor,
+                          dilation_height_factor, activation, outputData_float32, outputShape,
+                          workspace));
+    convertFloat32ToFloat16(outputData_float32, outputSize, outputData);
 
     return true;
 }
 
+int32_t getEffectiveFilterHeight(const Shape& filterShape, int32_t dilationHeightFactor) {
+    const int32_t filterHeight = getSizeOfDimension(filterShape, 1);
+    return dilationHeightFactor * (filterHeight - 1) + 1;
+}
+
+// Returns the number of multiply-accumulates needed to compute one row of an NHWC output.
+uint64_t getCostPerOutputRow(const Shape& filterShape, const Shape& outputShape) {
+    return uint64_t{getSizeOfDimension(outputShape, 2)} * getNumberOfElements(filterShape);
+}
+
+// Output rows are computed in bands on several threads, see parallelForNhwcRows.
 template <typename T_Input, typename T_Filter, typename T_Bias>
 bool conv(const T_Input* inputData, const Shape& inputShape, const T_Filter* filterData,
           const Shape& filterShape, const T_Bias* biasData, const Shape& biasShape,
           int32_t padding_left, int32_t padding_right, int32_t padding_top, int32_t padding_bottom,
           int32_t stride_width, int32_t stride_height, int32_t dilation_width_factor,
           int32_t dilation_height_factor, int32_t activation, bool useNchw, T_Input* outputData,
-          const Shape& outputShape) {
-    InputWithLayout<T_Input> input(useNchw);
-    OutputWithLayout<T_Input> output(useNchw);
+          const Shape& outputShape, ScratchWorkspace* workspace) {
+    InputWithLayout<T_Input> input(useNchw, workspace);
+    OutputWithLayout<T_Input> output(useNchw, workspace);
     NN_RET_CHECK(input.initialize(inputData, inputShape));
     NN_RET_CHECK(output.initialize(outputData, outputShape));
-    NN_RET_CHECK(convNhwc(input.getNhwcBuffer(), input.getNhwcShape(), filterData, filterShape,
-                          biasData, biasShape, padding_left, padding_right, padding_top,
-                          padding_bottom, stride_width, stride_height, dilation_width_factor,
-                          dilation_height_factor, activation, output.getNhwcBuffer(),
-                          output.getNhwcShape()));
+    auto convBand = [&](const T_Input* bandInputData, const Shape& bandInputShape,
+                        T_Input* bandOutputData, const Shape& bandOutputShape,
+                        int32_t bandPaddingTop) {
+        return convNhwc(bandInputData, bandInputShape, filterData, filterShape, biasData,
+                        biasShape, padding_left, padding_right, bandPaddingTop, padding_bottom,
+                        stride_width, stride_height, dilation_width_factor,
+                        dilation_height_factor, activation, bandOutputData, bandOutputShape,
+                        workspace);
+    };
+    if constexpr (std::is_same_v<T_Input, uint8_t> || std::is_same_v<T_Input, int8_t>) {
+        // gemmlowp already spreads quantized convolutions over its own threads.
+        NN_RET_CHECK(convBand(input.getNhwcBuffer(), input.getNhwcShape(),
+                              output.getNhwcBuffer(), output.getNhwcShape(), padding_top));
+    } else {
+        NN_RET_CHECK(parallelForNhwcRows(
+                input.getNhwcBuffer(), input.getNhwcShape(), output.getNhwcBuffer(),
+                output.getNhwcShape(), padding_top, padding_bottom, stride_height,
+                getEffectiveFilterHeight(filterShape, dilation_height_factor),
+                getCostPerOutputRow(filterShape, output.getNhwcShape()), convBand));
+    }
     NN_RET_CHECK(output.commit());
     return true;
 }
 
+bool conv(const _Float16* inputData, const Shape& inputShape, const _Float16* filterData,
+          const Shape& filterShape, const _Float16* biasData, const Shape& biasShape,
+          int32_t padding_left, int32_t padding_right, int32_t padding_top, int32_t padding_bottom,
+          int32_t stride_width, int32_t stride_height, int32_t dilation_width_factor,
+          int32_t dilation_height_factor, int32_t activation, bool useNchw, _Float16* outputData,
+          const Shape& outputShape, ScratchWorkspace* workspace) {
+    // Converted once here rather than in every band of rows.
+    const uint32_t filterSize = getNumberOfElements(filterShape);
+    const uint32_t biasSize = getNumberOfElements(biasShape);
+    float* filterData_float32 = workspace->allocate<float>(filterSize);
+    float* biasData_float32 = workspace->allocate<float>(biasSize);
+    NN_RET_CHECK(filterData_float32 != nullptr && biasData_float32 != nullptr);
+    convertFloat16ToFloat32(filterData, filterSize, filterData_float32);
+    convertFloat16ToFloat32(biasData, biasSize, biasData_float32);
+
+    return conv(inputData, inputShape, filterData_float32, filterShape, biasData_float32,
+                biasShape, padding_left, padding_right, padding_top, padding_bottom, stride_width,
+                stride_height, dilation_width_factor, dilation_height_factor, activation, useNchw,
+                outputData, outputShape, workspace);
+}
+
 bool convQuant8PerChannelNhwc(const uint8_t* inputData, const Shape& inputShape,
                               const int8_t* filterData, const Shape& filterShape,
                               const float* filterScales, const int32_t* biasData,
@@ -509,16 +549,25 @@ bool convQuant8PerChannel(const T* inputData, const Shape& inputShape, const int
                           int32_t paddingRight, int32_t paddingTop, int32_t paddingBottom,
                           int32_t strideWidth, int32_t strideHeight, int32_t dilationWidthFactor,
                           int32_t dilationHeightFactor, int32_t activation, bool useNchw,
-                          T* outputData, const Shape& outputShape) {
-    InputWithLayout<T> input(useNchw);
-    OutputWithLayout<T> output(useNchw);
+                          T* outputData, const Shape& outputShape, ScratchWorkspace* workspace) {
+    InputWithLayout<T> input(useNchw, workspace);
+    OutputWithLayout<T> output(useNchw, workspace);
     NN_RET_CHECK(input.initialize(inputData, inputShape));
     NN_RET_CHECK(output.initialize(outputData, outputShape));
-    NN_RET_CHECK(convQuant8PerChannelNhwc(
-            input.getNhwcBuffer(), input.getNhwcShape(), filterData, filterShape, filterScales,
-            biasData, biasShape, paddingLeft, paddingRight, paddingTop, paddingBottom, strideWidth,
-            strideHeight, dilationWidthFactor, dilationHeightFactor, activation,
-            output.getNhwcBuffer(), output.getNhwcShape()));
+    auto convBand = [&](const T* bandInputData, const Shape& bandInputShape, T* bandOutputData,
+                        const Shape& bandOutputShape, int32_t bandPaddingTop) {
+        return convQuant8PerChannelNhwc(bandInputData, bandInputShape, filterData, filterShape,
+                                        filterScales, biasData, biasShape, paddingLeft,
+                                        paddingRight, bandPaddingTop, paddingBottom, strideWidth,
+                                        strideHeight, dilationWidthFactor, dilationHeightFactor,
+                                        activation, bandOutputData, bandOutputShape);
+    };
+    NN_RET_CHECK(parallelForNhwcRows(input.getNhwcBuffer(), input.getNhwcShape(),
+                                     output.getNhwcBuffer(), output.getNhwcShape(), paddingTop,
+                                     paddingBottom, strideHeight,
+                                     getEffectiveFilterHeight(filterShape, dilationHeightFactor),
+                                     getCostPerOutputRow(filterShape, output.getNhwcShape()),
+                                     convBand));
     NN_RET_CHECK(output.commit());
     return true;
 }
@@ -592,7 +641,7 @@ bool prepare(IOperationExecutionContext* context) {
 
 bool execute(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     Conv2dParam param;
     NN_RET_CHECK(param.initialize(context));
     switch (context->getInputType(kInputTensor)) {
@@ -607,7 +656,8 @@ bool execute(IOperationExecutionContext* context) {
                         param.stride_width, param.stride_height, param.dilation_width_factor,
                         param.dilation_height_factor, param.activation, param.useNchw,
                         context->getOutputBuffer<float>(kOutputTensor),
-                        context->getOutputShape(kOutputTensor));
+                        context->getOutputShape(kOutputTensor),
+                        context->getScratchWorkspace());
         case OperandType::TENSOR_FLOAT16:
             return conv(context->getInputBuffer<_Float16>(kInputTensor),
                         context->getInputShape(kInputTensor),
@@ -619,7 +669,8 @@ bool execute(IOperationExecutionContext* context) {
                         param.stride_width, param.stride_height, param.dilation_width_factor,
                         param.dilation_height_factor, param.activation, param.useNchw,
                         context->getOutputBuffer<_Float16>(kOutputTensor),
-                        context->getOutputShape(kOutputTensor));
+                        context->getOutputShape(kOutputTensor),
+                        context->getScratchWorkspace());
         case OperandType::TENSOR_QUANT8_ASYMM:
             if (context->getInputType(kFilterTensor) ==
                 OperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL) {
@@ -637,7 +688,8 @@ bool execute(IOperationExecutionContext* context) {
                         param.stride_width, param.stride_height, param.dilation_width_factor,
                         param.dilation_height_factor, param.activation, param.useNchw,
                         context->getOutputBuffer<uint8_t>(kOutputTensor),
-                        context->getOutputShape(kOutputTensor));
+                        context->getOutputShape(kOutputTensor),
+                        context->getScratchWorkspace());
             } else if (context->getInputType(kFilterTensor) == OperandType::TENSOR_QUANT8_ASYMM) {
                 return conv(context->getInputBuffer<uint8_t>(kInputTensor),
                             context->getInputShape(kInputTensor),
@@ -649,7 +701,8 @@ bool execute(IOperationExecutionContext* context) {
                             param.stride_width, param.stride_height, param.dilation_width_factor,
                             param.dilation_height_factor, param.activation, param.useNchw,
                             context->getOutputBuffer<uint8_t>(kOutputTensor),
-                            context->getOutputShape(kOutputTensor));
+                            context->getOutputShape(kOutputTensor),
+                            context->getScratchWorkspace());
             } else {
                 NN_RET_CHECK_FAIL() << "Unsupported filter type for operation " << kOperationName;
             }
@@ -670,7 +723,8 @@ bool execute(IOperationExecutionContext* context) {
                         param.stride_width, param.stride_height, param.dilation_width_factor,
                         param.dilation_height_factor, param.activation, param.useNchw,
                         context->getOutputBuffer<int8_t>(kOutputTensor),
-                        context->getOutputShape(kOutputTensor));
+                        context->getOutputShape(kOutputTensor),
+                        context->getScratchWorkspace());
             } else if (context->getInputType(kFilterTensor) ==
                        OperandType::TENSOR_QUANT8_ASYMM_SIGNED) {
                 return conv(context->getInputBuffer<int8_t>(kInputTensor),
@@ -683,7 +737,8 @@ bool execute(IOperationExecutionContext* context) {
                             param.stride_width, param.stride_height, param.dilation_width_factor,
                             param.dilation_height_factor, param.activation, param.useNchw,
                             context->getOutputBuffer<int8_t>(kOutputTensor),
-                            context->getOutputShape(kOutputTensor));
+                            context->getOutputShape(kOutputTensor),
+                            context->getScratchWorkspace());
             } else {
                 NN_RET_CHECK_FAIL() << "Unsupported filter type for operation " << kOperationName;
             }
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_OPERATIONS_CPU_EXECUTOR_TEST_UTILS_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_OPERATIONS_CPU_EXECUTOR_TEST_UTILS_H
+
+#include <nnapi/Types.h>
+
+#include <utility>
+#include <vector>
+
+// Helpers for the tests that run a canonical model directly on CpuExecutor.
+
+namespace android::nn::test {
+
+// Returns a CONSTANT_COPY operand of model holding values. Scalars have no dimensions.
+template <typename T>
+Operand createConstantOperand(Model* model, OperandType type, std::vector<uint32_t> dimensions,
+                              const std::vector<T>& values) {
+    return {.type = type,
+            .dimensions = std::move(dimensions),
+            .lifetime = Operand::LifeTime::CONSTANT_COPY,
+            .location = model->operandValues.append(reinterpret_cast<const uint8_t*>(values.data()),
+                                                    values.size() * sizeof(T))};
+}
+
+// Returns a request argument for the count elements at pointer.
+template <typename T>
+Request::Argument createPointerArgument(T* pointer, size_t count) {
+    return {.lifetime = Request::Argument::LifeTime::POINTER,
+            .location = {.pointer = pointer, .length = static_cast<uint32_t>(count * sizeof(T))}};
+}
+
+}  // namespace android::nn::test
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_OPERATIONS_CPU_EXECUTOR_TEST_UTILS_H
@@ -18,10 +18,10 @@
 
 #include "Densify.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
-#include <iostream>
 #include <numeric>
 #include <vector>
 
@@ -40,154 +40,123 @@ namespace nn {
 namespace densify_op {
 
 /**
- * getFlattenedIndex:
- * Gets the index of destData where indices points to. Uses shape and origRank
- * for calculations.
+ * getLevelStrides:
+ * Returns, for each level of the traversal order, the distance in destData between consecutive
+ * indices of that level. A dense dimension i is split into its own level and the levels of the
+ * blocks that blockMap maps to it, with origIdx[i] = (levelIdx * blockSize + blockIdx) for each
+ * block in traversal order.
  */
-uint64_t getFlattenedIndex(const std::vector<int32_t>& indices, const std::vector<uint32_t>& shape,
-                           const int origRank) {
-    uint64_t index = 0;
-    int subElems = 1;
-    // origRank = size of destDims
-    for (int i = origRank - 1; i >= 0; i--) {
-        index += uint64_t(indices[i] * subElems);
-        subElems *= shape[i];
+std::vector<uint64_t> getLevelStrides(const std::vector<uint32_t>& destDims,
+                                      const int32_t* traversalOrder, uint32_t levelCount,
+                                      const std::vector<int32_t>& blockSize,
+                                      const int32_t* blockMap) {
+    const uint32_t origRank = destDims.size();
+    std::vector<uint64_t> destStrides(origRank, 1);
+    for (int i = static_cast<int>(origRank) - 2; i >= 0; i--) {
+        destStrides[i] = destStrides[i + 1] * destDims[i + 1];
     }
-    return index;
+    std::vector<uint64_t> levelStrides(levelCount);
+    // Blocks traversed later are nested inside the earlier ones.
+    for (uint32_t level = levelCount; level-- > origRank;) {
+        const int blockIdx = traversalOrder[level] - origRank;
+        const int origDim = blockMap[blockIdx];
+        levelStrides[level] = destStrides[origDim];
+        destStrides[origDim] *= blockSize[blockIdx];
+    }
+    for (uint32_t level = 0; level < origRank; level++) {
+        levelStrides[level] = destStrides[traversalOrder[level]];
+    }
+    return levelStrides;
 }
 
 /**
- * populate (Recursive Function):
- * Used to populate the destData with elements from srcData one value at a time.
+ * populate:
+ * Writes the elements of srcData to destData, walking the levels of the traversal order
+ * depth-first without recursion.
  * Inputs:
  * * srcData = input data of non-zero values.
- * * indices = used to determine the index in destData where we write srcData to. Uses block
- *   dimension.
- * * level = used to keep track of recursion level. Each recursive instance exits when level == size
- *   of traversal order.
- * * prevIdx = used to keep placement in array segments and srcData.
  * * destData = dense output data. Input being written to.
- * * destDims = shape of the output tensor. Used to calculate the flattened idx.
  * * dimFormat = dimension format for each entry in traversal order. The format is either DENSE
- *   (dimFormat[i] == 0) or SPARSE_CSR (dimFormat[i] == 1). Format is significant to determine how
- *   recursive iterations will occur and what metadata is stored in dimMetadata.
- * * traversalOrder = contains n+k elements. The first n elements are a permutation of the dense
- *   tensor shape. The last k elements are a permutation of the block dimensions. Used to determine
- *   order of traversal paths.
- * * blockSize = dense size of blocks. The last k elements of dimensions.
- * * blockMap = Used to determine how the block dimension maps to the original tensor dimension.
- * * dimMetadata = metadata varies depending on dimFormat values. If format is DENSE,
- *   dimMetadata[i*2][0] is the total number of elements in the dense tensor on the ith traversal
- *   path, and recursive iterations are through a standard for loop from 0 to dimMetadata[i*2][0].
- *   If format is SPARSE_CSR, dimMetadata[i*2] is a vector of array segments and
- *   dimMetadata[i*2+1] is a vector of array indices. The next recursive iterations will be
- *   looping through the array segments vector (since array segments are the same as row pointers in
- *   CSR format, the ith entry should never be greater than the ith+1 entry) and modifying the input
- *   indices with elements from the array indices vector.
- * * origRank = the size of destDims. Used for calculating flattened index of indices.
+ *   (dimFormat[i] == 0) or SPARSE_CSR (dimFormat[i] == 1).
+ * * dimensions = for a DENSE level, the number of indices of the level.
+ * * arraySegments, arrayIndices = for a SPARSE_CSR level, the array segments and array indices.
+ *   The indices of the level for parent position p are arrayIndices[arraySegments[p]] to
+ *   arrayIndices[arraySegments[p + 1] - 1] (like row pointers and column indices in CSR format).
+ * * levelStrides = see getLevelStrides.
  */
 template <typename T>
-void populate(const T* srcData, std::vector<int32_t>* indices, uint32_t level, uint32_t prevIdx,
-              T* destData, const std::vector<uint32_t>& destDims,
-              const std::vector<int32_t>& dimFormat, const int32_t* traversalOrder,
-              const std::vector<int32_t>& blockSize, const int32_t* blockMap,
-              const std::vector<std::vector<int32_t>>& dimMetadata, const int origRank) {
-    if (level == (*indices).size()) {  // level == size of traversal order
-        std::vector<int> origIdx(origRank);
-        size_t i = 0;
-        // Calculating origIdx using dense tensor dimensions
-        for (; i < origIdx.size(); i++) {
-            int origDim = traversalOrder[i];
-            origIdx[origDim] = (*indices)[i];
-        }
-        // Modifying origIdx using block dimensions
-        for (; i < (*indices).size(); i++) {
-            const int blockIdx = traversalOrder[i] - origRank;
-            const int origDim = blockMap[blockIdx];
-            origIdx[origDim] = origIdx[origDim] * blockSize[blockIdx] + (*indices)[i];
+void populate(const T* srcData, T* destData, const std::vector<int32_t>& dimFormat,
+              const int32_t* dimensions, const std::vector<const int32_t*>& arraySegments,
+              const std::vector<const int32_t*>& arrayIndices,
+              const std::vector<uint64_t>& levelStrides) {
+    const uint32_t levelCount = dimFormat.size();
+    // For each level being walked, the next and end positions among the entries of the level and
+    // the offset in destData contributed by the levels above it.
+    std::vector<int32_t> position(levelCount);
+    std::vector<int32_t> end(levelCount);
+    std::vector<uint64_t> offset(levelCount);
+    // Positions the level at the entries that belong to the given position of the parent level.
+    auto enterLevel = [&](uint32_t level, int32_t parentPosition) {
+        if (dimFormat[level] == DENSE) {
+            position[level] = parentPosition * dimensions[level];
+            end[level] = position[level] + dimensions[level];
+        } else {
+            position[level] = arraySegments[level][parentPosition];
+            end[level] = arraySegments[level][parentPosition + 1];
         }
-        // Writing srcData to destData
-        destData[getFlattenedIndex(origIdx, destDims, origRank)] = srcData[prevIdx];
-        return;
-    }
-    const int metadataIdx = 2 * level;
-    if (dimFormat[level] == DENSE) {  // DENSE dimension format
-        const int shapeOfLevel = dimMetadata[metadataIdx].front();
-        for (int i = 0; i < shapeOfLevel; i++) {
-            (*indices)[level] = i;
-            populate(srcData, indices, level + 1, prevIdx * shapeOfLevel + i, destData, destDims,
-                     dimFormat, traversalOrder, blockSize, blockMap, dimMetadata, origRank);
+    };
+
+    uint32_t level = 0;
+    offset[0] = 0;
+    enterLevel(0, 0);
+    while (true) {
+        if (position[level] == end[level]) {
+            if (level == 0) break;
+            level--;
+            continue;
         }
-    } else {  // SPARSE_CSR dimension format
-        const auto& arraySegments = dimMetadata[metadataIdx];
-        const auto& arrayIndices = dimMetadata[metadataIdx + 1];
-        for (int i = arraySegments[prevIdx]; i < arraySegments[prevIdx + 1]; i++) {
-            (*indices)[level] = arrayIndices[i];
-            populate(srcData, indices, level + 1, i, destData, destDims, dimFormat, traversalOrder,
-                     blockSize, blockMap, dimMetadata, origRank);
+        const int32_t current = position[level]++;
+        // The index of the entry within its level.
+        const int32_t index = dimFormat[level] == DENSE
+                                      ? current - (end[level] - dimensions[level])
+                                      : arrayIndices[level][current];
+        const uint64_t destOffset = offset[level] + index * levelStrides[level];
+        if (level + 1 == levelCount) {
+            destData[destOffset] = srcData[current];
+        } else {
+            level++;
+            offset[level] = destOffset;
+            enterLevel(level, current);
         }
     }
 }
 
-/**
- * arrToVector:
- * Converts a T array into an T vector.
- */
-template <typename T>
-std::vector<T> arrToVector(const T* arr, uint32_t size) {
-    return arr == nullptr ? std::vector<T>() : std::vector<T>(arr, arr + size);
-}
-
 template <typename T>
 inline bool densify(IOperationExecutionContext* context) {
-    // Getting all inputs
-    std::vector<Shape> inputShapes;
-    const uint32_t inputCount = context->getNumInputs();
-    inputShapes.reserve(inputCount);
     const T* srcData = context->getInputBuffer<T>(kInputTensor);
-    inputShapes.push_back(context->getInputShape(kInputTensor));
     const int32_t* traversalOrder = context->getInputBuffer<int32_t>(kInputTravOrder);
-    inputShapes.push_back(context->getInputShape(kInputTravOrder));
     const int32_t* blockMap = context->getInputBuffer<int32_t>(kInputBlockMap);
-    inputShapes.push_back(context->getInputShape(kInputBlockMap));
     const int32_t* dimFormatPtr = context->getInputBuffer<int32_t>(kInputDimFormat);
-    inputShapes.push_back(context->getInputShape(kInputDimFormat));
-    const int32_t* dimensionsPtr = context->getInputBuffer<int32_t>(kInputDimensions);
-    inputShapes.push_back(context->getInputShape(kInputDimensions));
-
-    std::vector<const int32_t*> dimMetadataPtrs;
-    for (uint32_t i = kInputArrSeg; i < inputCount; i++) {
-        inputShapes.push_back(context->getInputShape(i));
-        const int32_t* metadata = context->getInputBuffer<int32_t>(i);
-        dimMetadataPtrs.push_back(metadata);
-    }
-    Shape destShape = context->getOutputShape(kOutputTensor);
-
-    // Organizing dimFormat, dimensions, dimMetadata into vectors
-    std::vector<int32_t> dimFormat(
-            inputShapes[kInputDimFormat].dimensions.front());  // size of dimFormatPtr
-    std::vector<int32_t> dimensions(dimFormat.size());
-    std::vector<std::vector<int32_t>> dimMetadata(2 * dimFormat.size());
-    for (size_t i = 0; i < dimFormat.size(); i++) {
-        dimFormat[i] = dimFormatPtr[i];
-        dimensions[i] = dimensionsPtr[i];
-        if (dimFormat[i] == 0) {
-            dimMetadata[i * 2] = {dimensions[i]};
-        } else {
-            dimMetadata[i * 2] =  // array segments
-                    arrToVector(dimMetadataPtrs[i * 2],
-                                inputShapes[i * 2 + kInputArrSeg].dimensions.front());
-            dimMetadata[i * 2 + 1] =  // array indices
-                    arrToVector(dimMetadataPtrs[i * 2 + 1],
-                                inputShapes[i * 2 + kInputArrIdx].dimensions.front());
+    const int32_t* dimensions = context->getInputBuffer<int32_t>(kInputDimensions);
+    const uint32_t levelCount = context->getInputShapeView(kInputDimFormat).dimensions()[0];
+    const uint32_t blockCount = context->getInputShapeView(kInputBlockMap).dimensions()[0];
+    const Shape destShape = context->getOutputShape(kOutputTensor);
+
+    // Organizing dimFormat and dimMetadata by level
+    std::vector<int32_t> dimFormat(dimFormatPtr, dimFormatPtr + levelCount);
+    std::vector<const int32_t*> arraySegments(levelCount, nullptr);
+    std::vector<const int32_t*> arrayIndices(levelCount, nullptr);
+    for (uint32_t i = 0; i < levelCount; i++) {
+        if (dimFormat[i] != DENSE) {
+            arraySegments[i] = context->getInputBuffer<int32_t>(kInputArrSeg + 2 * i);
+            arrayIndices[i] = context->getInputBuffer<int32_t>(kInputArrIdx + 2 * i);
         }
     }
 
     // Creating blockSize vector
     const int origRank = destShape.dimensions.size();
-    std::vector<int32_t> blockSize(
-            inputShapes[kInputBlockMap].dimensions.front());  // size of block map
-    for (uint32_t i = 0; i < inputShapes[kInputBlockMap].dimensions.front(); i++) {
+    std::vector<int32_t> blockSize(blockCount);
+    for (uint32_t i = 0; i < blockCount; i++) {
         const int32_t origDim = traversalOrder[origRank + i];
         blockSize[i] = dimensions[origDim];
     }
@@ -197,22 +166,19 @@ inline bool densify(IOperationExecutionContext* context) {
             std::accumulate(destShape.dimensions.begin(), destShape.dimensions.end(),
                             static_cast<size_t>(1), std::multiplies<>{});
     T zeroPoint = T();
-    if (const OperandType type = inputShapes.front().type;
+    if (const OperandType type = context->getInputType(kInputTensor);
         type == OperandType::TENSOR_QUANT8_ASYMM ||
         type == OperandType::TENSOR_QUANT8_ASYMM_SIGNED ||
         type == OperandType::TENSOR_QUANT16_ASYMM) {
-        zeroPoint = static_cast<T>(inputShapes.front().offset);
+        zeroPoint = static_cast<T>(context->getInputShapeView(kInputTensor).offset());
     }
 
     T* destData = context->getOutputBuffer<T>(kOutputTensor);
-    for (size_t i = 0; i < denseTotal; i++) {
-        destData[i] = zeroPoint;
-    }
+    std::fill(destData, destData + denseTotal, zeroPoint);
 
-    std::vector<int32_t> indices(
-            inputShapes[kInputTravOrder].dimensions.front());  // size of traversal order
-    populate(srcData, &indices, 0u, 0u, destData, destShape.dimensions, dimFormat, traversalOrder,
-             blockSize, blockMap, dimMetadata, origRank);
+    populate(srcData, destData, dimFormat, dimensions, arraySegments, arrayIndices,
+             getLevelStrides(destShape.dimensions, traversalOrder, levelCount, blockSize,
+                             blockMap));
     return true;
 }
 
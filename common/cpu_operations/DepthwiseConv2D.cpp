@@ -474,7 +474,7 @@ bool prepare(IOperationExecutionContext* context) {
 
 bool execute(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     DepthwiseConv2dParam param;
     NN_RET_CHECK(param.initialize(context));
     switch (context->getInputType(kInputTensor)) {
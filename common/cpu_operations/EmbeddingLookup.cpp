@@ -34,11 +34,11 @@ EmbeddingLookup::EmbeddingLookup(const Operation& operation, RunTimeOperandInfo*
 
 bool EmbeddingLookup::Eval() {
     NNTRACE_COMP("EmbeddingLookup::Eval");
-    const int row_size = value_->shape().dimensions[0];
+    const int row_size = value_->dimensions[0];
     const int total_bytes = nonExtensionOperandSizeOfData(value_->type, value_->dimensions);
     const int row_bytes = total_bytes / row_size;
 
-    for (uint32_t i = 0; i < lookup_->shape().dimensions[0]; i++) {
+    for (uint32_t i = 0; i < lookup_->dimensions[0]; i++) {
         int idx = (reinterpret_cast<int*>(lookup_->buffer))[i];
         if (idx >= row_size || idx < 0) {
             LOG(ERROR) << "Embedding Lookup: index out of bounds.";
@@ -29,7 +29,7 @@ namespace {
 template <typename T>
 bool executeTyped(IOperationExecutionContext* context) {
     T* output = context->getOutputBuffer<T>(kOutputTensor);
-    const int numElements = getNumberOfElements(context->getOutputShape(kOutputTensor));
+    const int numElements = getNumberOfElements(context->getOutputShapeView(kOutputTensor));
     const T value = context->getInputValue<T>(kValueScalar);
     for (int i = 0; i < numElements; ++i) {
         output[i] = value;
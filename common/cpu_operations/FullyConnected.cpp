@@ -49,10 +49,10 @@ namespace {
 // std::mutex is safe for pthreads on Android.
 static std::mutex executionMutex;
 
-bool fullyConnectedFloat32(const float* inputData, const Shape& inputShape,
-                           const float* weightsData, const Shape& weightsShape,
-                           const float* biasData, const Shape& biasShape, int32_t activation,
-                           float* outputData, const Shape& outputShape) {
+bool fullyConnectedFloat32Block(const float* inputData, const Shape& inputShape,
+                                const float* weightsData, const Shape& weightsShape,
+                                const float* biasData, const Shape& biasShape, int32_t activation,
+                                float* outputData, const Shape& outputShape) {
     NNTRACE_TRANS("fullyConnectedFloat32");
     float output_activation_min, output_activation_max;
     CalculateActivationRangeFloat(activation, &output_activation_min, &output_activation_max);
@@ -79,6 +79,44 @@ bool fullyConnectedFloat32(const float* inputData, const Shape& inputShape,
     return true;
 }
 
+// Splits the output units across threads when there is a single batch, and the batches otherwise,
+// so that every block reads contiguous input and weights and writes contiguous output.
+bool fullyConnectedFloat32(const float* inputData, const Shape& inputShape,
+                           const float* weightsData, const Shape& weightsShape,
+                           const float* biasData, const Shape& biasShape, int32_t activation,
+                           float* outputData, const Shape& outputShape) {
+    const uint32_t batchSize = getSizeOfDimension(outputShape, 0);
+    const uint32_t numUnits = getSizeOfDimension(outputShape, 1);
+    const uint32_t inputSize = getSizeOfDimension(weightsShape, 1);
+    if (batchSize == 1) {
+        auto computeUnits = [&](uint32_t begin, uint32_t end) {
+            Shape blockWeightsShape = weightsShape;
+            blockWeightsShape.dimensions[0] = end - begin;
+            Shape blockBiasShape = biasShape;
+            blockBiasShape.dimensions[0] = end - begin;
+            Shape blockOutputShape = outputShape;
+            blockOutputShape.dimensions[1] = end - begin;
+            return fullyConnectedFloat32Block(inputData, inputShape,
+                                              weightsData + size_t{begin} * inputSize,
+                                              blockWeightsShape, biasData + begin, blockBiasShape,
+                                              activation, outputData + begin, blockOutputShape);
+        };
+        return parallelFor(numUnits, getParallelForMinChunkSize(inputSize), computeUnits);
+    }
+    auto computeBatches = [&](uint32_t begin, uint32_t end) {
+        Shape blockInputShape = inputShape;
+        blockInputShape.dimensions = {end - begin, inputSize};
+        Shape blockOutputShape = outputShape;
+        blockOutputShape.dimensions[0] = end - begin;
+        return fullyConnectedFloat32Block(inputData + size_t{begin} * inputSize, blockInputShape,
+                                          weightsData, weightsShape, biasData, biasShape,
+                                          activation, outputData + size_t{begin} * numUnits,
+                                          blockOutputShape);
+    };
+    return parallelFor(batchSize, getParallelForMinChunkSize(uint64_t{numUnits} * inputSize),
+                       computeBatches);
+}
+
 bool fullyConnectedFloat16(const _Float16* inputData, const Shape& inputShape,
                            const _Float16* weightsData, const Shape& weightsShape,
                            const _Float16* biasData, const Shape& biasShape, int32_t activation,
@@ -190,7 +228,7 @@ bool prepare(IOperationExecutionContext* context) {
 
 bool execute(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     switch (context->getInputType(kInputTensor)) {
         case OperandType::TENSOR_FLOAT32:
             return fullyConnectedFloat32(context->getInputBuffer<float>(kInputTensor),
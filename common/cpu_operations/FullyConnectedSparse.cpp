@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Operations"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "CpuInternalOperations.h"
+#include "FullyConnected.h"
+#include "OperationResolver.h"
+#include "Tracing.h"
+
+#ifdef NN_INCLUDE_CPU_IMPLEMENTATION
+#include "CpuOperationUtils.h"
+#include "CpuParallelFor.h"
+#endif  // NN_INCLUDE_CPU_IMPLEMENTATION
+
+namespace android {
+namespace nn {
+namespace fully_connected_sparse {
+
+#ifdef NN_INCLUDE_CPU_IMPLEMENTATION
+namespace {
+
+// Computes the output with weights stored as compressed sparse rows, skipping the zero weights.
+// Output units are split across threads.
+//
+// The dense kernel multiplies every input by its weight, and 0 * inf and 0 * NaN are NaN. The
+// output of a unit is therefore NaN as soon as a non-finite input meets one of its zero weights,
+// that is, when its non-zero weights do not cover every non-finite input of the batch.
+bool fullyConnectedSparseFloat32(const float* inputData, const Shape& inputShape,
+                                 const float* weightsData, const int32_t* rowSegments,
+                                 const int32_t* columnIndices, const float* biasData,
+                                 int32_t activation, float* outputData, const Shape& outputShape,
+                                 ScratchWorkspace* workspace) {
+    NNTRACE_TRANS("fullyConnectedSparseFloat32");
+    float outputActivationMin, outputActivationMax;
+    CalculateActivationRangeFloat(activation, &outputActivationMin, &outputActivationMax);
+
+    const uint32_t batchSize = getSizeOfDimension(outputShape, 0);
+    const uint32_t numUnits = getSizeOfDimension(outputShape, 1);
+    const uint32_t inputSize = getNumberOfElements(inputShape) / batchSize;
+
+    std::vector<uint32_t> nonFiniteCountsStorage;
+    uint32_t* nonFiniteCounts =
+            allocateTemporaryBuffer(batchSize, workspace, &nonFiniteCountsStorage);
+    NN_RET_CHECK(nonFiniteCounts != nullptr);
+    for (uint32_t b = 0; b < batchSize; ++b) {
+        const float* input = inputData + size_t{b} * inputSize;
+        nonFiniteCounts[b] = std::count_if(input, input + inputSize,
+                                           [](float value) { return !std::isfinite(value); });
+    }
+
+    auto computeUnits = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t b = 0; b < batchSize; ++b) {
+            const float* input = inputData + size_t{b} * inputSize;
+            float* output = outputData + size_t{b} * numUnits;
+            for (uint32_t unit = begin; unit < end; ++unit) {
+                float sum = biasData[unit];
+                for (int32_t i = rowSegments[unit]; i < rowSegments[unit + 1]; ++i) {
+                    sum += weightsData[i] * input[columnIndices[i]];
+                }
+                if (nonFiniteCounts[b] != 0) {
+                    const uint32_t coveredCount = std::count_if(
+                            columnIndices + rowSegments[unit], columnIndices + rowSegments[unit + 1],
+                            [input](int32_t column) { return !std::isfinite(input[column]); });
+                    if (coveredCount < nonFiniteCounts[b]) {
+                        sum = std::numeric_limits<float>::quiet_NaN();
+                    }
+                }
+                output[unit] = std::min(std::max(sum, outputActivationMin), outputActivationMax);
+            }
+        }
+        return true;
+    };
+    NNTRACE_COMP_SWITCH("fullyConnectedSparseFloat32");
+    const uint64_t weightsPerUnit = rowSegments[numUnits] / numUnits + 1;
+    return parallelFor(numUnits, getParallelForMinChunkSize(weightsPerUnit * batchSize),
+                       computeUnits);
+}
+
+// Returns the dense shape of the weights after checking the compressed sparse rows against it.
+bool getWeightsShape(const IOperationExecutionContext* context, Shape* weights) {
+    const Shape dimensions = context->getInputShape(kWeightsDimensions);
+    NN_RET_CHECK_EQ(getNumberOfElements(dimensions), 2u);
+    const int32_t* dimensionsData = context->getInputBuffer<int32_t>(kWeightsDimensions);
+    NN_RET_CHECK_GT(dimensionsData[0], 0);
+    NN_RET_CHECK_GT(dimensionsData[1], 0);
+    const uint32_t numUnits = dimensionsData[0];
+    const uint32_t nonZeroCount = getNumberOfElements(*weights);
+    NN_RET_CHECK_EQ(getNumberOfElements(context->getInputShape(kWeightsRowSegments)),
+                    numUnits + 1);
+    NN_RET_CHECK_EQ(getNumberOfElements(context->getInputShape(kWeightsColumnIndices)),
+                    nonZeroCount);
+    const int32_t* rowSegments = context->getInputBuffer<int32_t>(kWeightsRowSegments);
+    NN_RET_CHECK_EQ(rowSegments[0], 0);
+    NN_RET_CHECK_EQ(static_cast<uint32_t>(rowSegments[numUnits]), nonZeroCount);
+    // The kernel reads the weights of each unit and the inputs they multiply without bounds checks.
+    for (uint32_t unit = 0; unit < numUnits; ++unit) {
+        NN_RET_CHECK_LE(rowSegments[unit], rowSegments[unit + 1]);
+    }
+    const int32_t* columnIndices = context->getInputBuffer<int32_t>(kWeightsColumnIndices);
+    for (uint32_t i = 0; i < nonZeroCount; ++i) {
+        NN_RET_CHECK_GE(columnIndices[i], 0);
+        NN_RET_CHECK_LT(columnIndices[i], dimensionsData[1]);
+    }
+    weights->dimensions = {numUnits, static_cast<uint32_t>(dimensionsData[1])};
+    return true;
+}
+
+}  // namespace
+
+bool prepare(IOperationExecutionContext* context) {
+    NN_RET_CHECK_EQ(context->getNumInputs(), kNumInputs);
+    NN_RET_CHECK(context->getInputType(kInputTensor) == OperandType::TENSOR_FLOAT32)
+            << "Unsupported tensor type for operation " << kOperationName;
+    Shape input = context->getInputShape(kInputTensor);
+    Shape weights = context->getInputShape(kWeightsTensor);
+    NN_RET_CHECK(getWeightsShape(context, &weights));
+    Shape bias = context->getInputShape(kBiasTensor);
+    Shape output = context->getOutputShape(kOutputTensor);
+    NN_RET_CHECK(fully_connected::validateShapes(input, weights, bias, &output));
+    return context->setOutputShape(kOutputTensor, output);
+}
+
+bool execute(IOperationExecutionContext* context) {
+    // Bypass execution in the case of zero-sized input.
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
+    return fullyConnectedSparseFloat32(
+            context->getInputBuffer<float>(kInputTensor), context->getInputShape(kInputTensor),
+            context->getInputBuffer<float>(kWeightsTensor),
+            context->getInputBuffer<int32_t>(kWeightsRowSegments),
+            context->getInputBuffer<int32_t>(kWeightsColumnIndices),
+            context->getInputBuffer<float>(kBiasTensor),
+            context->getInputValue<int32_t>(kActivationScalar),
+            context->getOutputBuffer<float>(kOutputTensor), context->getOutputShape(kOutputTensor),
+            context->getScratchWorkspace());
+}
+#endif  // NN_INCLUDE_CPU_IMPLEMENTATION
+
+}  // namespace fully_connected_sparse
+}  // namespace nn
+}  // namespace android
@@ -240,7 +240,7 @@ bool prepare(IOperationExecutionContext* context) {
 bool execute(IOperationExecutionContext* context) {
     NNTRACE_TRANS("axisAlignedBBoxTransform");
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     switch (context->getInputType(kRoiTensor)) {
         case OperandType::TENSOR_FLOAT16: {
             return bboxTransformFloat16(context->getInputBuffer<_Float16>(kRoiTensor),
@@ -304,42 +304,112 @@ namespace box_with_nms_limit {
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 namespace {
 
-// TODO(xusongw): Reduce code duplication with hard/soft nms path.
+// The candidates of a single NMS call. Their scores and boxes are gathered into separate arrays,
+// so that the IoU of the selected box with all the remaining candidates is computed by a loop
+// over contiguous memory that the compiler can vectorize. The buffers are reused by subsequent
+// calls.
+class NmsCandidates {
+   public:
+    // Gathers the candidates select[0, selectLength).
+    template <typename GetRoiBase>
+    void gather(const float* scoresData, GetRoiBase getRoiBase, const uint32_t* select,
+                uint32_t selectLength) {
+        resize(selectLength);
+        for (uint32_t i = 0; i < selectLength; i++) {
+            const float* roi = getRoiBase(select[i]);
+            mIndexes[i] = select[i];
+            mScores[i] = scoresData[select[i]];
+            mX1[i] = roi[0];
+            mY1[i] = roi[1];
+            mX2[i] = roi[2];
+            mY2[i] = roi[3];
+            mAreas[i] = (roi[2] - roi[0]) * (roi[3] - roi[1]);
+        }
+    }
+
+    // Stores the IoU of each candidate in [begin, end) with candidate selected into getIoU().
+    void computeIoU(uint32_t selected, uint32_t begin, uint32_t end) {
+        const float x1 = mX1[selected], y1 = mY1[selected];
+        const float x2 = mX2[selected], y2 = mY2[selected];
+        const float area = mAreas[selected];
+        for (uint32_t i = begin; i < end; i++) {
+            // Same as getIoUAxisAligned(roi[i], roi[selected]).
+            const float w = std::max(std::min(mX2[i], x2) - std::max(mX1[i], x1), 0.0f);
+            const float h = std::max(std::min(mY2[i], y2) - std::max(mY1[i], y1), 0.0f);
+            const float areaIntersect = w * h;
+            const float areaUnion = mAreas[i] + area - areaIntersect;
+            mIoU[i] = areaIntersect / areaUnion;
+        }
+    }
+
+    void swap(uint32_t i, uint32_t j) {
+        std::swap(mIndexes[i], mIndexes[j]);
+        std::swap(mScores[i], mScores[j]);
+        std::swap(mX1[i], mX1[j]);
+        std::swap(mY1[i], mY1[j]);
+        std::swap(mX2[i], mX2[j]);
+        std::swap(mY2[i], mY2[j]);
+        std::swap(mAreas[i], mAreas[j]);
+        std::swap(mIoU[i], mIoU[j]);
+    }
+
+    uint32_t* getIndexes() { return mIndexes.data(); }
+    float* getScores() { return mScores.data(); }
+    const float* getIoU() const { return mIoU.data(); }
+    uint8_t* getSuppressed() { return mSuppressed.data(); }
+
+   private:
+    void resize(uint32_t size) {
+        for (auto* buffer : {&mScores, &mX1, &mY1, &mX2, &mY2, &mAreas, &mIoU}) {
+            buffer->resize(size);
+        }
+        mIndexes.resize(size);
+        mSuppressed.assign(size, 0);
+    }
+
+    std::vector<uint32_t> mIndexes;
+    std::vector<float> mScores;
+    std::vector<float> mX1, mY1, mX2, mY2, mAreas;
+    std::vector<float> mIoU;
+    std::vector<uint8_t> mSuppressed;
+};
 
 // Inplace hard NMS within range [select, select + selectLength).
+// The candidates are visited once in decreasing score order, each selected box suppressing the
+// remaining candidates that overlap it too much.
+template <typename GetRoiBase>
 uint32_t* hardNmsSingleClass(const float* scoresData, float iouThreshold, int32_t maxNumDetections,
-                             std::function<const float*(uint32_t)> getRoiBase, uint32_t* select,
-                             uint32_t selectLength) {
-    uint32_t *selectStart = select, *selectEnd = select + selectLength, numDetections = 0;
+                             GetRoiBase getRoiBase, uint32_t* select, uint32_t selectLength,
+                             NmsCandidates* candidates) {
     if (maxNumDetections < 0) {
         maxNumDetections = selectLength;
     }
-    while (selectStart < selectEnd && numDetections < static_cast<uint32_t>(maxNumDetections)) {
-        // find max score and swap to the front
-        auto& maxScore = *std::max_element(selectStart, selectEnd,
-                                           [&scoresData](const uint32_t& lhs, const uint32_t& rhs) {
-                                               return scoresData[lhs] < scoresData[rhs];
-                                           });
-        std::swap(maxScore, *selectStart);
-
-        // Calculate IoU of the rest, swap to the end (disgard) if needed.
-        for (uint32_t* i = selectStart + 1; i < selectEnd; i++) {
-            float iou = getIoUAxisAligned(getRoiBase(*i), getRoiBase(*selectStart));
-            if (iou >= iouThreshold) {
-                std::swap(*i--, *(--selectEnd));
-            }
+    // Equal scores are visited in index order, so that the result is deterministic.
+    std::sort(select, select + selectLength, [&scoresData](uint32_t lhs, uint32_t rhs) {
+        return scoresData[lhs] > scoresData[rhs] ||
+               (scoresData[lhs] == scoresData[rhs] && lhs < rhs);
+    });
+    candidates->gather(scoresData, getRoiBase, select, selectLength);
+    const float* iou = candidates->getIoU();
+    uint8_t* suppressed = candidates->getSuppressed();
+    uint32_t numDetections = 0;
+    for (uint32_t i = 0;
+         i < selectLength && numDetections < static_cast<uint32_t>(maxNumDetections); i++) {
+        if (suppressed[i]) continue;
+        select[numDetections++] = candidates->getIndexes()[i];
+        candidates->computeIoU(i, i + 1, selectLength);
+        for (uint32_t j = i + 1; j < selectLength; j++) {
+            suppressed[j] |= iou[j] >= iouThreshold;
         }
-        selectStart++;
-        numDetections++;
     }
-    return selectStart;
+    return select + numDetections;
 }
 
+template <typename GetRoiBase>
 void hardNmsMultiClass(const float* scoresData, uint32_t numClasses, uint32_t numRois,
                        float scoreThreshold, float iouThreshold, int32_t maxNumDetections,
-                       int32_t maxNumDetectionsPerClass,
-                       std::function<const float*(uint32_t)> getRoiBase,
-                       std::vector<uint32_t>* select) {
+                       int32_t maxNumDetectionsPerClass, GetRoiBase getRoiBase,
+                       std::vector<uint32_t>* select, NmsCandidates* candidates) {
     // Exclude class 0 (background)
     for (uint32_t c = 1; c < numClasses; c++) {
         uint32_t size = select->size();
@@ -353,7 +423,7 @@ void hardNmsMultiClass(const float* scoresData, uint32_t numClasses, uint32_t nu
         uint32_t* selectStart = select->data() + size;
         uint32_t selectLength = select->size() - size;
         uint32_t* selectEnd = hardNmsSingleClass(scoresData, iouThreshold, maxNumDetectionsPerClass,
-                                                 getRoiBase, selectStart, selectLength);
+                                                 getRoiBase, selectStart, selectLength, candidates);
         select->resize(selectEnd - select->data());
     }
 
@@ -369,41 +439,50 @@ void hardNmsMultiClass(const float* scoresData, uint32_t numClasses, uint32_t nu
 }
 
 // Inplace soft NMS within range [select, select + selectLength).
-using SoftNmsKernel = std::function<float(float)>;
+// The scores of the candidates decay as boxes that overlap them are selected, so the next box is
+// the one with the highest remaining score rather than the next one in a sorted order.
+template <typename GetRoiBase, typename SoftNmsKernel>
 uint32_t* softNmsSingleClass(float* scoresData, float scoreThreshold, int32_t maxNumDetections,
-                             std::function<const float*(uint32_t)> getRoiBase, SoftNmsKernel kernel,
-                             uint32_t* select, uint32_t selectLength) {
-    uint32_t *selectStart = select, *selectEnd = select + selectLength, numDetections = 0;
+                             GetRoiBase getRoiBase, SoftNmsKernel kernel, uint32_t* select,
+                             uint32_t selectLength, NmsCandidates* candidates) {
+    candidates->gather(scoresData, getRoiBase, select, selectLength);
+    float* scores = candidates->getScores();
+    const float* iou = candidates->getIoU();
+    uint32_t selectStart = 0, selectEnd = selectLength, numDetections = 0;
     if (maxNumDetections < 0) {
         maxNumDetections = selectLength;
     }
     while (selectStart < selectEnd && numDetections < static_cast<uint32_t>(maxNumDetections)) {
         // find max score and swap to the front
-        auto& maxScore = *std::max_element(selectStart, selectEnd,
-                                           [&scoresData](const uint32_t& lhs, const uint32_t& rhs) {
-                                               return scoresData[lhs] < scoresData[rhs];
-                                           });
-        std::swap(maxScore, *selectStart);
-
-        // Calculate IoU of the rest, swap to the end (disgard) if needed.
-        for (uint32_t* i = selectStart + 1; i < selectEnd; i++) {
-            float iou = getIoUAxisAligned(getRoiBase(*i), getRoiBase(*selectStart));
-            scoresData[*i] *= kernel(iou);
-            if (scoresData[*i] < scoreThreshold) {
-                std::swap(*i--, *(--selectEnd));
+        const uint32_t maxScore =
+                std::max_element(scores + selectStart, scores + selectEnd) - scores;
+        candidates->swap(maxScore, selectStart);
+
+        // Decay the scores of the rest, swap to the end (disgard) if needed.
+        candidates->computeIoU(selectStart, selectStart + 1, selectEnd);
+        for (uint32_t i = selectStart + 1; i < selectEnd; i++) {
+            scores[i] *= kernel(iou[i]);
+            if (scores[i] < scoreThreshold) {
+                candidates->swap(i--, --selectEnd);
             }
         }
         selectStart++;
         numDetections++;
     }
-    return selectStart;
+    const uint32_t* indexes = candidates->getIndexes();
+    for (uint32_t i = 0; i < selectLength; i++) {
+        select[i] = indexes[i];
+        scoresData[indexes[i]] = scores[i];
+    }
+    return select + selectStart;
 }
 
+template <typename GetRoiBase, typename SoftNmsKernel>
 void softNmsMultiClass(float* scoresData, uint32_t numClasses, uint32_t numRois,
                        float scoreThreshold, float nmsScoreThreshold, int32_t maxNumDetections,
-                       int32_t maxNumDetectionsPerClass,
-                       std::function<const float*(uint32_t)> getRoiBase, SoftNmsKernel kernel,
-                       std::vector<uint32_t>* select) {
+                       int32_t maxNumDetectionsPerClass, GetRoiBase getRoiBase,
+                       SoftNmsKernel kernel, std::vector<uint32_t>* select,
+                       NmsCandidates* candidates) {
     // Exclude class 0 (background)
     for (uint32_t c = 1; c < numClasses; c++) {
         uint32_t size = select->size();
@@ -418,7 +497,7 @@ void softNmsMultiClass(float* scoresData, uint32_t numClasses, uint32_t numRois,
         uint32_t selectLength = select->size() - size;
         uint32_t* selectEnd =
                 softNmsSingleClass(scoresData, nmsScoreThreshold, maxNumDetectionsPerClass,
-                                   getRoiBase, kernel, selectStart, selectLength);
+                                   getRoiBase, kernel, selectStart, selectLength, candidates);
         select->resize(selectEnd - select->data());
     }
 
@@ -433,31 +512,19 @@ void softNmsMultiClass(float* scoresData, uint32_t numClasses, uint32_t numRois,
     select->resize(maxNumDetections);
 }
 
+template <typename SoftNmsKernel>
 bool boxWithNmsLimitFloat32Compute(float* scoresData, const Shape& scoresShape,
-                                   const float* roiData, const Shape& /*roiShape*/,
-                                   const int32_t* batchesData, const Shape& /*batchesShape*/,
+                                   const float* roiData, const int32_t* batchesData,
                                    float scoreThreshold, int32_t maxNumDetections,
-                                   int32_t softNmsKernel, float iouThreshold, float sigma,
-                                   float nmsScoreThreshold, std::vector<uint32_t>* batchSplitIn,
+                                   SoftNmsKernel kernel, float nmsScoreThreshold,
+                                   std::vector<uint32_t>* batchSplitIn,
                                    std::vector<uint32_t>* batchSplitOut,
                                    std::vector<uint32_t>* selected) {
-    SoftNmsKernel kernel = nullptr;
-    if (softNmsKernel == 0) {
-        kernel = [&iouThreshold](float iou) { return iou < iouThreshold ? 1.0f : 0.0f; };
-    } else if (softNmsKernel == 1) {
-        kernel = [&iouThreshold](float iou) { return iou < iouThreshold ? 1.0f : 1.0f - iou; };
-    } else if (softNmsKernel == 2) {
-        kernel = [&sigma](float iou) { return std::exp(-1.0f * iou * iou / sigma); };
-    } else {
-        NN_RET_CHECK_FAIL() << "Unsupported soft NMS kernel " << softNmsKernel;
-    }
-
     const uint32_t kRoiDim = 4;
     uint32_t numRois = getSizeOfDimension(scoresShape, 0);
     uint32_t numClasses = getSizeOfDimension(scoresShape, 1);
 
     // We assume boxes of the same batch are grouped together.
-    std::vector<uint32_t> batch;
     int32_t ind = -1;
     for (uint32_t i = 0; i < numRois; i++) {
         if (batchesData[i] == ind) {
@@ -471,6 +538,8 @@ bool boxWithNmsLimitFloat32Compute(float* scoresData, const Shape& scoresShape,
     float* scoresBase = scoresData;
     const float* roiBase = roiData;
     selected->clear();
+    std::vector<uint32_t> result;
+    NmsCandidates candidates;
     for (uint32_t b = 0; b < batchSplitIn->size(); b++) {
         for (uint32_t i = 0; i < batchSplitIn->at(b); i++) {
             const float* roi = roiBase + i * kRoiDim;
@@ -478,11 +547,12 @@ bool boxWithNmsLimitFloat32Compute(float* scoresData, const Shape& scoresShape,
             NN_RET_CHECK_LE(roi[0], roi[2]);
             NN_RET_CHECK_LE(roi[1], roi[3]);
         }
-        std::vector<uint32_t> result;
+        result.clear();
         softNmsMultiClass(
                 scoresBase, numClasses, batchSplitIn->at(b), scoreThreshold, nmsScoreThreshold,
                 maxNumDetections, maxNumDetections,
-                [&roiBase](uint32_t ind) { return roiBase + ind * kRoiDim; }, kernel, &result);
+                [roiBase](uint32_t ind) { return roiBase + ind * kRoiDim; }, kernel, &result,
+                &candidates);
         // Sort again by class.
         std::sort(result.begin(), result.end(),
                   [&scoresBase, numClasses](const uint32_t& lhs, const uint32_t& rhs) {
@@ -498,6 +568,31 @@ bool boxWithNmsLimitFloat32Compute(float* scoresData, const Shape& scoresShape,
     return true;
 }
 
+bool boxWithNmsLimitFloat32Compute(float* scoresData, const Shape& scoresShape,
+                                   const float* roiData, const Shape& /*roiShape*/,
+                                   const int32_t* batchesData, const Shape& /*batchesShape*/,
+                                   float scoreThreshold, int32_t maxNumDetections,
+                                   int32_t softNmsKernel, float iouThreshold, float sigma,
+                                   float nmsScoreThreshold, std::vector<uint32_t>* batchSplitIn,
+                                   std::vector<uint32_t>* batchSplitOut,
+                                   std::vector<uint32_t>* selected) {
+    auto compute = [&](auto kernel) {
+        return boxWithNmsLimitFloat32Compute(scoresData, scoresShape, roiData, batchesData,
+                                             scoreThreshold, maxNumDetections, kernel,
+                                             nmsScoreThreshold, batchSplitIn, batchSplitOut,
+                                             selected);
+    };
+    if (softNmsKernel == 0) {
+        return compute([iouThreshold](float iou) { return iou < iouThreshold ? 1.0f : 0.0f; });
+    } else if (softNmsKernel == 1) {
+        return compute(
+                [iouThreshold](float iou) { return iou < iouThreshold ? 1.0f : 1.0f - iou; });
+    } else if (softNmsKernel == 2) {
+        return compute([sigma](float iou) { return std::exp(-1.0f * iou * iou / sigma); });
+    }
+    NN_RET_CHECK_FAIL() << "Unsupported soft NMS kernel " << softNmsKernel;
+}
+
 template <typename T>
 T castTo(float val, const Shape&) {
     return val;
@@ -719,7 +814,7 @@ bool prepare(IOperationExecutionContext* context) {
 bool execute(IOperationExecutionContext* context) {
     NNTRACE_TRANS("boxWithNMSLimit");
     // Bypass execution in the case of zero numRois.
-    if (getSizeOfDimension(context->getInputShape(kScoreTensor), 0) == 0) return true;
+    if (getSizeOfDimension(context->getInputShapeView(kScoreTensor), 0) == 0) return true;
     switch (context->getInputType(kScoreTensor)) {
         case OperandType::TENSOR_FLOAT16: {
             return boxWithNmsLimitFloat16(
@@ -895,6 +990,7 @@ bool generateProposalsNhwcFloat32Compute(const float* scoresData, const Shape& s
     Shape tempImageInfoShape = imageInfoShape;
     tempImageInfoShape.dimensions = {1, imageInfoLength};
 
+    box_with_nms_limit::NmsCandidates nmsCandidates;
     for (uint32_t b = 0; b < numBatches; b++) {
         // Apply bboxDeltas to anchor locations.
         float tempImageInfo[] = {imageInfoBase[0], imageInfoBase[1]};
@@ -926,7 +1022,7 @@ bool generateProposalsNhwcFloat32Compute(const float* scoresData, const Shape& s
                 [&roiTransformedBuffer](uint32_t ind) {
                     return roiTransformedBuffer.data() + ind * kRoiDim;
                 },
-                select.data(), select.size());
+                select.data(), select.size(), &nmsCandidates);
         uint32_t selectSize = selectEnd - select.data();
         select.resize(selectSize);
 
@@ -1277,6 +1373,7 @@ bool detectionPostprocessFloat32(const float* scoreData, const Shape& scoreShape
     int32_t* classOutBase = classOutData;
     std::vector<float> roiBuffer(numAnchors * kRoiDim);
     std::vector<float> scoreBuffer(numAnchors);
+    box_with_nms_limit::NmsCandidates nmsCandidates;
     for (uint32_t b = 0; b < numBatches; b++) {
         const float* anchorBase = anchorData;
         for (uint32_t a = 0; a < numAnchors; a++) {
@@ -1300,7 +1397,7 @@ bool detectionPostprocessFloat32(const float* scoreData, const Shape& scoreShape
                     [&roiBuffer, numClasses](uint32_t ind) {
                         return roiBuffer.data() + (ind / numClasses) * kRoiDim;
                     },
-                    &select);
+                    &select, &nmsCandidates);
             for (uint32_t i = 0; i < select.size(); i++) {
                 uint32_t ind = select[i];
                 scoreOutBase[i] = scoreBase[ind];
@@ -1325,7 +1422,7 @@ bool detectionPostprocessFloat32(const float* scoreData, const Shape& scoreShape
             uint32_t* selectEnd = box_with_nms_limit::hardNmsSingleClass(
                     maxScores.data(), iouThreshold, maxNumDetections,
                     [&roiBuffer](uint32_t ind) { return roiBuffer.data() + ind * kRoiDim; },
-                    select.data(), select.size());
+                    select.data(), select.size(), &nmsCandidates);
             select.resize(selectEnd - select.data());
             float* scoreOutPtr = scoreOutBase;
             float* roiOutPtr = roiOutBase;
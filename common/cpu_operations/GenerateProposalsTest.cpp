@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "CpuExecutor.h"
+#include "CpuExecutorTestUtils.h"
+#include "OperationsUtils.h"
+#include "nnapi/Types.h"
+#include "nnapi/Validation.h"
+
+namespace android::nn {
+namespace {
+
+using ::testing::ElementsAreArray;
+using test::createConstantOperand;
+using test::createPointerArgument;
+
+TEST(GenerateProposalsTest, HardNmsKeepsLowerIndexOfEqualScores) {
+    // Three anchors at a single position, used as is by zero deltas. Anchors 0 and 1 overlap with
+    // an IoU of 2/3 and have the same score. Anchor 2 has the highest score and overlaps neither.
+    // Swapping anchor 2 to the front, as a selection by max_element does, would put anchor 1
+    // ahead of anchor 0.
+    const std::vector<float> scores = {0.5f, 0.5f, 0.9f};
+    Model model;
+    model.main.operands = {
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {1, 1, 1, 3},
+             .lifetime = Operand::LifeTime::SUBGRAPH_INPUT},
+            createConstantOperand(&model, OperandType::TENSOR_FLOAT32, {1, 1, 1, 12},
+                                  std::vector<float>(12, 0.0f)),
+            createConstantOperand(&model, OperandType::TENSOR_FLOAT32, {3, 4},
+                                  std::vector<float>{0, 0, 10, 10, 2, 0, 12, 10, 50, 50, 60, 60}),
+            createConstantOperand(&model, OperandType::TENSOR_FLOAT32, {1, 2},
+                                  std::vector<float>{100.0f, 100.0f}),
+            createConstantOperand(&model, OperandType::FLOAT32, {}, std::vector<float>{1.0f}),
+            createConstantOperand(&model, OperandType::FLOAT32, {}, std::vector<float>{1.0f}),
+            createConstantOperand(&model, OperandType::INT32, {}, std::vector<int32_t>{-1}),
+            createConstantOperand(&model, OperandType::INT32, {}, std::vector<int32_t>{-1}),
+            createConstantOperand(&model, OperandType::FLOAT32, {}, std::vector<float>{0.5f}),
+            createConstantOperand(&model, OperandType::FLOAT32, {}, std::vector<float>{1.0f}),
+            createConstantOperand(&model, OperandType::BOOL, {}, std::vector<bool8>{false}),
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {2},
+             .lifetime = Operand::LifeTime::SUBGRAPH_OUTPUT},
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {2, 4},
+             .lifetime = Operand::LifeTime::SUBGRAPH_OUTPUT},
+            {.type = OperandType::TENSOR_INT32,
+             .dimensions = {2},
+             .lifetime = Operand::LifeTime::SUBGRAPH_OUTPUT},
+    };
+    model.main.operations = {
+            {.type = OperationType::GENERATE_PROPOSALS,
+             .inputs = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10},
+             .outputs = {11, 12, 13}},
+    };
+    model.main.inputIndexes = {0};
+    model.main.outputIndexes = {11, 12, 13};
+    ASSERT_TRUE(validate(model).ok());
+
+    std::vector<float> scoresOut(2);
+    std::vector<float> roiOut(8);
+    std::vector<int32_t> batchesOut(2);
+    const Request request = {
+            .inputs = {createPointerArgument(scores.data(), scores.size())},
+            .outputs = {createPointerArgument(scoresOut.data(), scoresOut.size()),
+                        createPointerArgument(roiOut.data(), roiOut.size()),
+                        createPointerArgument(batchesOut.data(), batchesOut.size())},
+    };
+    CpuExecutor executor;
+    ASSERT_EQ(executor.run(model, request, {}, {}), ANEURALNETWORKS_NO_ERROR);
+    EXPECT_THAT(scoresOut, ElementsAreArray({0.9f, 0.5f}));
+    EXPECT_THAT(roiOut, ElementsAreArray({50.0f, 50.0f, 60.0f, 60.0f, 0.0f, 0.0f, 10.0f, 10.0f}));
+    EXPECT_THAT(batchesOut, ElementsAreArray({0, 0}));
+}
+
+}  // namespace
+}  // namespace android::nn
@@ -44,12 +44,12 @@ HashtableLookup::HashtableLookup(const Operation& operation, RunTimeOperandInfo*
 
 bool HashtableLookup::Eval() {
     NNTRACE_COMP("HashtableLookup::Eval");
-    const int num_rows = value_->shape().dimensions[0];
+    const int num_rows = value_->dimensions[0];
     const int row_bytes =
             nonExtensionOperandSizeOfData(value_->type, value_->dimensions) / num_rows;
     void* pointer = nullptr;
 
-    for (int i = 0; i < static_cast<int>(lookup_->shape().dimensions[0]); i++) {
+    for (int i = 0; i < static_cast<int>(lookup_->dimensions[0]); i++) {
         int idx = -1;
         pointer = bsearch(lookup_->buffer + sizeof(int) * i, key_->buffer, num_rows, sizeof(int),
                           greater);
@@ -18,48 +18,27 @@
 
 #include "LogSoftmax.h"
 
-#include <algorithm>
-#include <cmath>
-#include <vector>
-
 #include "OperationResolver.h"
 #include "OperationsExecutionUtils.h"
 #include "Tracing.h"
 
+#ifdef NN_INCLUDE_CPU_IMPLEMENTATION
+#include "CpuSoftmax.h"
+#endif  // NN_INCLUDE_CPU_IMPLEMENTATION
+
 namespace android {
 namespace nn {
 namespace log_softmax {
 
+#ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 template <typename T>
-inline bool compute(const T* input, const Shape& shape, T beta, uint32_t axis, T* output) {
-    const uint32_t outerSize = getNumberOfElements(shape, 0, axis);
-    const uint32_t axisSize = getSizeOfDimension(shape, axis);
-    const uint32_t innerSize = getNumberOfElements(shape, axis + 1, getNumberOfDimensions(shape));
-    for (uint32_t outer = 0; outer < outerSize; ++outer) {
-        for (uint32_t inner = 0; inner < innerSize; ++inner) {
-            // We subtract the maximum value from each element to ensure
-            // numerical stability, taking advantage of the following equality:
-            // exp(x[i])/sum(exp(x[i])) == exp(x[i]+C)/sum(exp(x[i]+C))
-            T maxValue = input[outer * axisSize * innerSize + inner];
-            for (uint32_t i = 1; i < axisSize; ++i) {
-                maxValue = std::max(maxValue, input[(outer * axisSize + i) * innerSize + inner]);
-            }
-
-            T sum = 0;
-            for (uint32_t i = 0; i < axisSize; ++i) {
-                sum += std::exp(static_cast<double>(
-                        (input[(outer * axisSize + i) * innerSize + inner] - maxValue) * beta));
-            }
-
-            const T logSum = std::log(static_cast<double>(sum));
-            for (uint32_t i = 0; i < axisSize; ++i) {
-                output[(outer * axisSize + i) * innerSize + inner] =
-                        (input[(outer * axisSize + i) * innerSize + inner] - maxValue) * beta -
-                        logSum;
-            }
-        }
-    }
-    return true;
+inline bool compute(const T* input, const Shape& shape, float beta, uint32_t axis, T* output,
+                    ScratchWorkspace* workspace) {
+    const SoftmaxDimensions dims = {
+            .outerSize = getNumberOfElements(shape, 0, axis),
+            .axisSize = getSizeOfDimension(shape, axis),
+            .innerSize = getNumberOfElements(shape, axis + 1, getNumberOfDimensions(shape))};
+    return softmaxFloat(input, dims, beta, /*isLogSoftmax=*/true, output, workspace);
 }
 
 bool prepare(IOperationExecutionContext* context) {
@@ -74,16 +53,19 @@ bool execute(IOperationExecutionContext* context) {
             return compute(context->getInputBuffer<_Float16>(kInputTensor),
                            context->getInputShape(kInputTensor),
                            context->getInputValue<_Float16>(kInputBeta), axis,
-                           context->getOutputBuffer<_Float16>(kOutputTensor));
+                           context->getOutputBuffer<_Float16>(kOutputTensor),
+                           context->getScratchWorkspace());
         case OperandType::TENSOR_FLOAT32:
             return compute(context->getInputBuffer<float>(kInputTensor),
                            context->getInputShape(kInputTensor),
                            context->getInputValue<float>(kInputBeta), axis,
-                           context->getOutputBuffer<float>(kOutputTensor));
+                           context->getOutputBuffer<float>(kOutputTensor),
+                           context->getScratchWorkspace());
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation " << kOperationName;
     }
 }
+#endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 }  // namespace log_softmax
 
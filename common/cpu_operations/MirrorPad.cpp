@@ -25,10 +25,10 @@
 #include "OperationsExecutionUtils.h"
 
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
-#include <limits>
 #include <vector>
 
 #include "CpuOperationUtils.h"
+#include "CpuTensorCopy.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 namespace android {
@@ -71,116 +71,61 @@ bool prepare(IOperationExecutionContext* context) {
 
 /*-- begin execution ------------------------------------------------------------------*/
 
-// Based on
-// http://cs/android/external/tensorflow/tensorflow/lite/kernels/mirror_pad.cc;l=163;rcl=84f01780a69b5900cfddf2b44d696f92e0aac331
-
-// The structure of that code is largely preserved, for simplicity of comparison.
-
-// The TFLite implementation is multithreaded.  The NNAPI implementation is not.
-
 namespace {
 
-// In adapting the TFLite implementation to NNAPI, we introduce conversions from
-// conventional NNAPI types (typically uint32_t) to int, which is the
-// conventional TFLite type.  This function checks that such a conversion is
-// value-preserving.
+// Copies the input to the interior of the output, then mirrors the interior into the padding one
+// axis at a time, from the last axis to the first. The padding before and after axis i spans the
+// interior of the axes before it and the whole of the axes after it, which have already been
+// padded, and is copied from the interior along axis i read backwards.
 template <typename T>
-bool checkAsInt(T) {
-    // Making the assertion expression dependent on the template type (via
-    // incorportation of "&& sizeof(T)") ensures that the static_assert will
-    // only be evaluated if this function body is instantiated (we expect only
-    // the explicit specializations to be used).  Alternatively, we could omit
-    // the body entirely, in which case an unexpected choice of T would result
-    // in a link-time failure rather than a compile-time failure.
-    static_assert(false && sizeof(T), "Unimplemented");
-    return false;
-}
-template <>
-bool checkAsInt(uint32_t val) {
-    static_assert(sizeof(int) <= sizeof(uint32_t));
-    NN_RET_CHECK_LE(val, uint32_t(std::numeric_limits<int>::max()))
-            << kOperationName << " cannot represent value as int";
-    return true;
-}
-
-// Wrapper for data computed by the eval function.
-template <typename T>
-struct EvalData {
-    EvalData(const int* thePaddingTensor, Shape theInputTensorShape,
-             std::vector<int> theOutputDimsNumElements, std::vector<int> theInputDimsNumElements,
-             const T* theInputData, int theOffset, T* theOutputData, int theNumDims)
-        : paddingTensor(thePaddingTensor),
-          inputTensorShape(std::move(theInputTensorShape)),
-          outputDimsNumElements(std::move(theOutputDimsNumElements)),
-          inputDimsNumElements(std::move(theInputDimsNumElements)),
-          inputData(theInputData),
-          offset(theOffset),
-          outputData(theOutputData),
-          numDims(theNumDims) {}
-    const int32_t* paddingTensor = nullptr;
-    Shape inputTensorShape;
-    // Holds number of elements at the nth dimension.
-    // value at last dimension = 1, at second to last = sizeof last dimension.
-    std::vector<int> outputDimsNumElements;
-    std::vector<int> inputDimsNumElements;
-    const T* inputData = nullptr;
-
-    int offset = -1;
-    T* outputData = nullptr;
-    int numDims = 0;
-};
-
-// Helper function that obtains the left and right padding amounts.
-void getPadding(const int32_t* paddingTensor, int dimension, int32_t* leftPad, int32_t* rightPad) {
-    *leftPad = *(paddingTensor + dimension * 2);
-    *rightPad = *(paddingTensor + dimension * 2 + 1);
-}
-
-// Given dimension index and the left/right padding amounts.
-// Returns the corresponding dimension in the input array.
-int getInputDimension(int paddedDimension, const int leftPad, const int /* rightPad */,
-                      const int inputDimSize, const int offset) {
-    if (paddedDimension < leftPad) {
-        const int originalInd = leftPad + offset - 1;
-        return originalInd - (std::min(paddedDimension, originalInd - offset));
+bool mirrorPad(const T* inputData, const Shape& inputShape, const int32_t* padding, int32_t mode,
+               T* outputData, const Shape& outputShape) {
+    const uint32_t numDims = getNumberOfDimensions(inputShape);
+    const std::vector<int64_t> inputStrides = getContiguousStrides(inputShape.dimensions);
+    const std::vector<int64_t> outputStrides = getContiguousStrides(outputShape.dimensions);
+    std::vector<CopyAxis> axes(numDims);
+    std::vector<int64_t> regionOffsets(numDims + 1, 0);
+    for (uint32_t i = 0; i < numDims; ++i) {
+        regionOffsets[i + 1] = regionOffsets[i] + padding[i * 2] * outputStrides[i];
+        axes[i] = {.size = getSizeOfDimension(inputShape, i),
+                   .inputStride = inputStrides[i],
+                   .outputStride = outputStrides[i]};
     }
-    paddedDimension -= leftPad;
-    if (paddedDimension >= inputDimSize) {
-        paddedDimension -= inputDimSize;
-        const int originalInd = inputDimSize - (1 + offset);
-        return originalInd - std::min(paddedDimension, originalInd);
-    }
-    return paddedDimension;
-}
+    NN_RET_CHECK(copyTensor(inputData, outputData + regionOffsets[numDims], sizeof(T), axes));
 
-// Given an index in output array, returns the index of the value in input
-// array.
-template <typename T>
-int getFlatIndex(int index, const EvalData<T>& evalData) {
-    int flatIndex = 0;
-    for (int i = 0, nD = evalData.numDims; i < nD; ++i) {
-        int32_t leftPad, rightPad;
-        getPadding(evalData.paddingTensor, i, &leftPad, &rightPad);
-        const int dimensionIndex = index / evalData.outputDimsNumElements[i];
-        // getSizeOfDimension() undergoes checkAsInt() in eval().
-        const int indexInInput = getInputDimension(
-                dimensionIndex, leftPad, rightPad,
-                int(getSizeOfDimension(evalData.inputTensorShape, i)), evalData.offset);
-        flatIndex += indexInInput * evalData.inputDimsNumElements[i];
-        index %= evalData.outputDimsNumElements[i];
+    // The reflected padding excludes the edge of the interior, the symmetric padding repeats it.
+    const int64_t offset = mode == kModeReflect ? 1 : 0;
+    for (uint32_t i = 0; i < numDims; ++i) {
+        axes[i].inputStride = outputStrides[i];
     }
-    return flatIndex;
-}
-
-template <typename T>
-void run(const EvalData<T>& evalData, const int outputSize) {
-    // See MirrorPadWorkerTask::Run().
-    const auto* inputData = evalData.inputData;
-    auto* outputData = evalData.outputData;
-    for (int i = 0; i < outputSize; ++i) {
-        outputData[i] = inputData[getFlatIndex(i, evalData)];
+    for (uint32_t i = numDims; i-- > 0;) {
+        const int64_t leftPadding = padding[i * 2];
+        const int64_t rightPadding = padding[i * 2 + 1];
+        const int64_t inputSize = getSizeOfDimension(inputShape, i);
+        const int64_t stride = outputStrides[i];
+        T* region = outputData + regionOffsets[i];
+        // The source of an empty padding may lie outside of the output, so it is not computed.
+        if (leftPadding > 0) {
+            axes[i] = {.size = static_cast<uint32_t>(leftPadding),
+                       .inputStride = -stride,
+                       .outputStride = stride};
+            NN_RET_CHECK(copyTensor(region + (2 * leftPadding - 1 + offset) * stride, region,
+                                    sizeof(T), axes));
+        }
+        if (rightPadding > 0) {
+            axes[i] = {.size = static_cast<uint32_t>(rightPadding),
+                       .inputStride = -stride,
+                       .outputStride = stride};
+            NN_RET_CHECK(copyTensor(region + (leftPadding + inputSize - 1 - offset) * stride,
+                                    region + (leftPadding + inputSize) * stride, sizeof(T), axes));
+        }
+        axes[i] = {.size = getSizeOfDimension(outputShape, i),
+                   .inputStride = stride,
+                   .outputStride = stride};
     }
+    return true;
 }
+
 }  // namespace
 
 bool eval(IOperationExecutionContext* context) {
@@ -188,45 +133,12 @@ bool eval(IOperationExecutionContext* context) {
     const int32_t* padding = context->getInputBuffer<int32_t>(kInputPaddingTensor);
     const int32_t mode = context->getInputValue<int32_t>(kInputModeScalar);
     const Shape outputShape = context->getOutputShape(kOutputTensor);
-    const auto tensorType = context->getInputType(kInputTensor);
-
-    const uint32_t inputDims = getNumberOfDimensions(inputShape);
-    NN_RET_CHECK(checkAsInt(inputDims));
-    const int numDims = int(inputDims);
-
-    // checkAsInt() the individual dimensions here so we do not need to do so
-    // elsewhere.
-    for (int i = 0; i < numDims; ++i) {
-        const auto inputDim = getSizeOfDimension(inputShape, i);
-        NN_RET_CHECK(checkAsInt(inputDim));
-        const auto outputDim = getSizeOfDimension(outputShape, i);
-        NN_RET_CHECK(checkAsInt(outputDim));
-    }
-
-    std::vector<int> outputDimsNumElements(inputDims, 1);
-    std::vector<int> inputDimsNumElements(inputDims, 1);
-    for (int i = numDims - 2; i >= 0; i--) {
-        outputDimsNumElements[i] =
-                outputDimsNumElements[i + 1] * int(getSizeOfDimension(outputShape, i + 1));
-        inputDimsNumElements[i] =
-                inputDimsNumElements[i + 1] * int(getSizeOfDimension(inputShape, i + 1));
-    }
 
-    const int32_t offset = mode != kModeReflect ? 0 : 1;
-
-    const auto outputSize = getNumberOfElements(outputShape);
-
-#define MIRROR_PAD_CASE(operandType, dataType)                                               \
-    case OperandType::operandType: {                                                         \
-        const EvalData evalData(padding, inputShape, std::move(outputDimsNumElements),       \
-                                std::move(inputDimsNumElements),                             \
-                                context->getInputBuffer<dataType>(kInputTensor), offset,     \
-                                context->getOutputBuffer<dataType>(kOutputTensor), numDims); \
-        NN_RET_CHECK(checkAsInt(outputSize));                                                \
-        run(evalData, int(outputSize));                                                      \
-        return true;                                                                         \
-    }
-    switch (tensorType) {
+#define MIRROR_PAD_CASE(operandType, dataType)                                                 \
+    case OperandType::operandType:                                                             \
+        return mirrorPad(context->getInputBuffer<dataType>(kInputTensor), inputShape, padding, \
+                         mode, context->getOutputBuffer<dataType>(kOutputTensor), outputShape);
+    switch (context->getInputType(kInputTensor)) {
         MIRROR_PAD_CASE(TENSOR_FLOAT16, _Float16)
         MIRROR_PAD_CASE(TENSOR_FLOAT32, float)
         MIRROR_PAD_CASE(TENSOR_QUANT8_ASYMM, uint8_t)
@@ -235,6 +147,7 @@ bool eval(IOperationExecutionContext* context) {
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation " << kOperationName;
     }
+#undef MIRROR_PAD_CASE
 }
 
 /*-- end execution --------------------------------------------------------------------*/
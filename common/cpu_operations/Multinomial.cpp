@@ -91,7 +91,7 @@ bool Multinomial::Eval() {
     NNTRACE_COMP("Multinomial::Eval");
     switch (input_->type) {
         case OperandType::TENSOR_FLOAT16: {
-            std::vector<float> inputDataFloat32(getNumberOfElements(input_->shape()));
+            std::vector<float> inputDataFloat32(getNumberOfElements(input_->shapeView()));
             convertFloat16ToFloat32(GetBuffer<_Float16>(input_), &inputDataFloat32);
             EvalFloat32(inputDataFloat32.data());
             break;
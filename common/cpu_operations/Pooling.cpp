@@ -253,41 +253,65 @@ bool maxPoolNhwc(const _Float16* inputData, const Shape& inputShape, const Pooli
     return true;
 }
 
+// Output rows are computed in bands on several threads, see parallelForNhwcRows.
+template <typename T>
+bool parallelForPoolingRows(const T* inputData, const Shape& inputShape, const PoolingParam& param,
+                            T* outputData, const Shape& outputShape,
+                            bool (*poolNhwc)(const T*, const Shape&, const PoolingParam&, T*,
+                                             const Shape&)) {
+    const uint64_t costPerOutputRow = uint64_t{getSizeOfDimension(outputShape, 2)} *
+                                      getSizeOfDimension(outputShape, 3) * param.filter_width *
+                                      param.filter_height;
+    return parallelForNhwcRows(
+            inputData, inputShape, outputData, outputShape, param.padding_top,
+            param.padding_bottom, param.stride_height, param.filter_height, costPerOutputRow,
+            [&](const T* bandInputData, const Shape& bandInputShape, T* bandOutputData,
+                const Shape& bandOutputShape, int32_t bandPaddingTop) {
+                PoolingParam bandParam = param;
+                bandParam.padding_top = bandPaddingTop;
+                return poolNhwc(bandInputData, bandInputShape, bandParam, bandOutputData,
+                                bandOutputShape);
+            });
+}
+
 template <typename T>
 bool averagePool(const T* inputData, const Shape& inputShape, const PoolingParam& param,
-                 T* outputData, const Shape& outputShape) {
-    InputWithLayout<T> input(param.useNchw);
-    OutputWithLayout<T> output(param.useNchw);
+                 T* outputData, const Shape& outputShape, ScratchWorkspace* workspace) {
+    InputWithLayout<T> input(param.useNchw, workspace);
+    OutputWithLayout<T> output(param.useNchw, workspace);
     NN_RET_CHECK(input.initialize(inputData, inputShape));
     NN_RET_CHECK(output.initialize(outputData, outputShape));
-    NN_RET_CHECK(averagePoolNhwc(input.getNhwcBuffer(), input.getNhwcShape(), param,
-                                 output.getNhwcBuffer(), output.getNhwcShape()));
+    NN_RET_CHECK(parallelForPoolingRows(input.getNhwcBuffer(), input.getNhwcShape(), param,
+                                        output.getNhwcBuffer(), output.getNhwcShape(),
+                                        averagePoolNhwc));
     NN_RET_CHECK(output.commit());
     return true;
 }
 
 template <typename T>
 bool l2Pool(const T* inputData, const Shape& inputShape, const PoolingParam& param, T* outputData,
-            const Shape& outputShape) {
-    InputWithLayout<T> input(param.useNchw);
-    OutputWithLayout<T> output(param.useNchw);
+            const Shape& outputShape, ScratchWorkspace* workspace) {
+    InputWithLayout<T> input(param.useNchw, workspace);
+    OutputWithLayout<T> output(param.useNchw, workspace);
     NN_RET_CHECK(input.initialize(inputData, inputShape));
     NN_RET_CHECK(output.initialize(outputData, outputShape));
-    NN_RET_CHECK(l2PoolNhwc(input.getNhwcBuffer(), input.getNhwcShape(), param,
-                            output.getNhwcBuffer(), output.getNhwcShape()));
+    NN_RET_CHECK(parallelForPoolingRows(input.getNhwcBuffer(), input.getNhwcShape(), param,
+                                        output.getNhwcBuffer(), output.getNhwcShape(),
+                                        l2PoolNhwc));
     NN_RET_CHECK(output.commit());
     return true;
 }
 
 template <typename T>
 bool maxPool(const T* inputData, const Shape& inputShape, const PoolingParam& param, T* outputData,
-             const Shape& outputShape) {
-    InputWithLayout<T> input(param.useNchw);
-    OutputWithLayout<T> output(param.useNchw);
+             const Shape& outputShape, ScratchWorkspace* workspace) {
+    InputWithLayout<T> input(param.useNchw, workspace);
+    OutputWithLayout<T> output(param.useNchw, workspace);
     NN_RET_CHECK(input.initialize(inputData, inputShape));
     NN_RET_CHECK(output.initialize(outputData, outputShape));
-    NN_RET_CHECK(maxPoolNhwc(input.getNhwcBuffer(), input.getNhwcShape(), param,
-                             output.getNhwcBuffer(), output.getNhwcShape()));
+    NN_RET_CHECK(parallelForPoolingRows(input.getNhwcBuffer(), input.getNhwcShape(), param,
+                                        output.getNhwcBuffer(), output.getNhwcShape(),
+                                        maxPoolNhwc));
     NN_RET_CHECK(output.commit());
     return true;
 }
@@ -329,11 +353,12 @@ bool prepare(IOperationExecutionContext* context) {
         return name(context->getInputBuffer<cppType>(kInputTensor),   \
                     context->getInputShape(kInputTensor), param,      \
                     context->getOutputBuffer<cppType>(kOutputTensor), \
-                    context->getOutputShape(kOutputTensor))
+                    context->getOutputShape(kOutputTensor),           \
+                    context->getScratchWorkspace())
 
 bool executeAveragePool(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     PoolingParam param;
     NN_RET_CHECK(param.initialize(context));
     switch (context->getInputType(kInputTensor)) {
@@ -348,7 +373,7 @@ bool executeAveragePool(IOperationExecutionContext* context) {
 
 bool executeL2Pool(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     PoolingParam param;
     NN_RET_CHECK(param.initialize(context));
     switch (context->getInputType(kInputTensor)) {
@@ -361,7 +386,7 @@ bool executeL2Pool(IOperationExecutionContext* context) {
 
 bool executeMaxPool(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     PoolingParam param;
     NN_RET_CHECK(param.initialize(context));
     switch (context->getInputType(kInputTensor)) {
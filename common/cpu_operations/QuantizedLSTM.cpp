@@ -211,7 +211,7 @@ void assignWeightsSubmatrix(const RunTimeOperandInfo* submatrix, const int32_t o
                             const int32_t offset_column, const std::vector<uint32_t>& weightsDims,
                             uint8_t* weights) {
     const uint8_t* submatrixValues = GetBuffer<uint8_t>(submatrix);
-    const std::vector<uint32_t> submatrixDims = submatrix->shape().dimensions;
+    const std::vector<uint32_t> submatrixDims = submatrix->dimensions;
     for (uint32_t i = 0; i < submatrixDims[0] * submatrixDims[1]; ++i) {
         const uint32_t row = i / submatrixDims[1];
         const uint32_t column = i % submatrixDims[1];
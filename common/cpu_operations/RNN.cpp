@@ -89,7 +89,7 @@ bool RNN::Eval() {
                               recurrent_weights_->shape(), activation_,
                               reinterpret_cast<_Float16*>(output_->buffer));
             memcpy(hidden_state_out_->buffer, output_->buffer,
-                   sizeof(_Float16) * getNumberOfElements(output_->shape()));
+                   sizeof(_Float16) * getNumberOfElements(output_->shapeView()));
             break;
         }
         case OperandType::TENSOR_FLOAT32: {
@@ -101,7 +101,7 @@ bool RNN::Eval() {
                            recurrent_weights_->shape(), activation_,
                            reinterpret_cast<float*>(output_->buffer));
             memcpy(hidden_state_out_->buffer, output_->buffer,
-                   sizeof(float) * getNumberOfElements(output_->shape()));
+                   sizeof(float) * getNumberOfElements(output_->shapeView()));
             break;
         }
         default: {
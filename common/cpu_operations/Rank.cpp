@@ -33,7 +33,7 @@ bool prepare(IOperationExecutionContext* context) {
 
 bool execute(IOperationExecutionContext* context) {
     *context->getOutputBuffer<int32_t>(kOutputScalar) =
-            getNumberOfDimensions(context->getInputShape(kInputTensor));
+            getNumberOfDimensions(context->getInputShapeView(kInputTensor));
     return true;
 }
 
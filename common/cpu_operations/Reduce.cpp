@@ -48,15 +48,17 @@ inline bool compute(IOperationExecutionContext* context, T init, T func(T, T)) {
     const Shape outputShape = context->getOutputShape(kOutputTensor);
     const uint32_t inputRank = getNumberOfDimensions(inputShape);
     const uint32_t numAxes = getNumberOfElements(axesShape);
-    std::vector<int> tempIndex(inputShape.dimensions.size());
-    std::vector<int> tempAxes(numAxes);
+    ScratchWorkspace* workspace = context->getScratchWorkspace();
+    int* tempIndex = workspace->allocate<int>(inputShape.dimensions.size());
+    int* tempAxes = workspace->allocate<int>(numAxes);
+    NN_RET_CHECK(tempIndex != nullptr && tempAxes != nullptr);
     return tflite::reference_ops::ReduceGeneric<T>(
             context->getInputBuffer<T>(kInputTensor),
             reinterpret_cast<const int32_t*>(inputShape.dimensions.data()), inputRank,
             context->getOutputBuffer<T>(kOutputTensor),
             reinterpret_cast<const int32_t*>(outputShape.dimensions.data()),
             outputShape.dimensions.size(), context->getInputBuffer<int32_t>(kInputAxes), numAxes,
-            context->getInputValue<bool8>(kInputKeepDims), tempIndex.data(), tempAxes.data(), init,
+            context->getInputValue<bool8>(kInputKeepDims), tempIndex, tempAxes, init,
             func);
 }
 
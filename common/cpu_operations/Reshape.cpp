@@ -29,6 +29,7 @@
 #include <vector>
 
 #include "CpuOperationUtils.h"
+#include "CpuTensorCopy.h"
 #include "LegacyUtils.h"
 #include "Operations.h"
 #include "Reshape.h"
@@ -92,99 +93,41 @@ bool padGeneric(const T* inputData, const Shape& inputShape, const int32_t* padd
                 T* outputData, const Shape& outputShape) {
     NNTRACE_TRANS("padGeneric");
 
-    // Based on
-    // http://google3/third_party/tensorflow/contrib/lite/kernels/internal/optimized/optimized_ops.h?l=6194&rcl=213557260
-
-    // TFLite runtime calls are currently fixed at 4 dimensions. Copy inputs so
-    // we can pad them to 4 dims (yes, we are "padding the padding").
-    int32_t numInputDims = static_cast<int32_t>(getNumberOfDimensions(inputShape));
+    const uint32_t numInputDims = getNumberOfDimensions(inputShape);
     NN_OPS_CHECK(numInputDims <= 4);
-    std::vector<int> leftPaddings(4 - numInputDims, 0);
-    std::vector<int> rightPaddings(4 - numInputDims, 0);
-    for (int32_t i = 0; i < numInputDims; ++i) {
-        leftPaddings.push_back(paddings[i * 2]);
-        rightPaddings.push_back(paddings[i * 2 + 1]);
+    const std::vector<int64_t> inputStrides = getContiguousStrides(inputShape.dimensions);
+    const std::vector<int64_t> outputStrides = getContiguousStrides(outputShape.dimensions);
+    std::vector<CopyAxis> axes(numInputDims);
+    int64_t interiorOffset = 0;
+    for (uint32_t i = 0; i < numInputDims; ++i) {
+        interiorOffset += paddings[i * 2] * outputStrides[i];
+        axes[i] = {.size = getSizeOfDimension(inputShape, i),
+                   .inputStride = inputStrides[i],
+                   .outputStride = outputStrides[i]};
     }
-    const int leftBPadding = leftPaddings[0];
-    const int leftHPadding = leftPaddings[1];
-    const int leftWPadding = leftPaddings[2];
-    const int leftDPadding = leftPaddings[3];
-    const int rightBPadding = rightPaddings[0];
-    const int rightHPadding = rightPaddings[1];
-    const int rightWPadding = rightPaddings[2];
-    const int rightDPadding = rightPaddings[3];
-
-    const auto extInputShape =
-            tflite::RuntimeShape::ExtendedShape(4, convertShapeToTflshape(inputShape));
-    const auto extOutputShape =
-            tflite::RuntimeShape::ExtendedShape(4, convertShapeToTflshape(outputShape));
-
-    const int outputBatch = extOutputShape.Dims(0);
-    const int outputHeight = extOutputShape.Dims(1);
-    const int outputWidth = extOutputShape.Dims(2);
-    const int outputDepth = extOutputShape.Dims(3);
-
-    const int inputDepth = extInputShape.Dims(3);
 
     NNTRACE_COMP_SWITCH("padGeneric");
+    NN_RET_CHECK(copyTensor(inputData, outputData + interiorOffset, sizeof(T), axes));
 
-    if (leftBPadding != 0) {
-        tflite::optimized_ops::TypedMemset<T>(
-                outputData, padValue, leftBPadding * outputHeight * outputWidth * outputDepth);
+    // The padding before and after axis i spans the interior of the axes before it and the whole
+    // of the axes after it, so that every padded element is written once.
+    for (uint32_t i = 0; i < numInputDims; ++i) {
+        axes[i].size = getSizeOfDimension(outputShape, i);
     }
-    for (int outB = leftBPadding; outB < outputBatch - rightBPadding; ++outB) {
-        if (leftHPadding != 0) {
-            tflite::optimized_ops::TypedMemset<T>(
-                    outputData + tflite::Offset(extOutputShape, outB, 0, 0, 0), padValue,
-                    leftHPadding * outputWidth * outputDepth);
-        }
-        for (int outH = leftHPadding; outH < outputHeight - rightHPadding; ++outH) {
-            if (leftWPadding != 0) {
-                tflite::optimized_ops::TypedMemset<T>(
-                        outputData + tflite::Offset(extOutputShape, outB, outH, 0, 0), padValue,
-                        leftWPadding * outputDepth);
-            }
-            for (int outW = leftWPadding; outW < outputWidth - rightWPadding; ++outW) {
-                if (leftDPadding != 0) {
-                    tflite::optimized_ops::TypedMemset<T>(
-                            outputData + tflite::Offset(extOutputShape, outB, outH, outW, 0),
-                            padValue, leftDPadding);
-                }
-
-                T* out =
-                        outputData + tflite::Offset(extOutputShape, outB, outH, outW, leftDPadding);
-                const T* in =
-                        inputData + tflite::Offset(extInputShape, outB - leftBPadding,
-                                                   outH - leftHPadding, outW - leftWPadding, 0);
-                memcpy(out, in, inputDepth * sizeof(T));
-
-                if (rightDPadding != 0) {
-                    tflite::optimized_ops::TypedMemset<T>(
-                            outputData + tflite::Offset(extOutputShape, outB, outH, outW,
-                                                        outputDepth - rightDPadding),
-                            padValue, rightDPadding);
-                }
-            }
-            if (rightWPadding != 0) {
-                tflite::optimized_ops::TypedMemset<T>(
-                        outputData + tflite::Offset(extOutputShape, outB, outH,
-                                                    outputWidth - rightWPadding, 0),
-                        padValue, rightWPadding * outputDepth);
-            }
-        }
-        if (rightHPadding != 0) {
-            tflite::optimized_ops::TypedMemset<T>(
-                    outputData + tflite::Offset(extOutputShape, outB, outputHeight - rightHPadding,
-                                                0, 0),
-                    padValue, rightHPadding * outputWidth * outputDepth);
-        }
+    int64_t regionOffset = 0;
+    for (uint32_t i = 0; i < numInputDims; ++i) {
+        const uint32_t inputSize = getSizeOfDimension(inputShape, i);
+        const int32_t leftPadding = paddings[i * 2];
+        axes[i].size = leftPadding;
+        NN_RET_CHECK(fillTensor(&padValue, outputData + regionOffset, sizeof(T), axes));
+        axes[i].size = paddings[i * 2 + 1];
+        NN_RET_CHECK(fillTensor(&padValue,
+                                outputData + regionOffset +
+                                        (leftPadding + inputSize) * outputStrides[i],
+                                sizeof(T), axes));
+        axes[i].size = inputSize;
+        regionOffset += leftPadding * outputStrides[i];
     }
-    if (rightBPadding != 0) {
-        tflite::optimized_ops::TypedMemset<T>(
-                outputData + tflite::Offset(extOutputShape, outputBatch - rightBPadding, 0, 0, 0),
-                padValue, rightBPadding * outputHeight * outputWidth * outputDepth);
-    }
-
     return true;
 }
 template bool padGeneric<float>(const float* inputData, const Shape& inputShape,
@@ -20,20 +20,14 @@
 
 #include <algorithm>
 #include <functional>
-#include <vector>
 
 #include "OperationResolver.h"
 #include "Tracing.h"
 #include "nnapi/Validation.h"
 
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wunused-parameter"
-#pragma clang diagnostic ignored "-Wsign-compare"
-#include <tensorflow/lite/kernels/internal/reference/reference_ops.h>
-#pragma clang diagnostic pop
-
 #include "CpuOperationUtils.h"
+#include "CpuResize.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 namespace android {
@@ -44,114 +38,41 @@ namespace resize_image {
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 namespace {
 
-inline float scaleHalfPixel(const int x, const float scale) {
-    return (static_cast<float>(x) + 0.5f) * scale;
-}
-
-inline float scaleLegacy(const int x, const float scale) {
-    return static_cast<float>(x) * scale;
-}
-
-inline float calculateResizeScale(int32_t inSize, int32_t outSize, bool alignCorners) {
-    return (alignCorners && outSize > 1) ? (inSize - 1) / static_cast<float>(outSize - 1)
-                                         : inSize / static_cast<float>(outSize);
-}
-
-template <typename T>
-bool resizeNearestNeighbor(const T* inputData, const Shape& inputShape, bool alignCorners,
-                           bool halfPixelCenters, T* outputData, const Shape& outputShape) {
-    const int batchSize = getSizeOfDimension(inputShape, 0);
-    const int inHeight = getSizeOfDimension(inputShape, 1);
-    const int inWidth = getSizeOfDimension(inputShape, 2);
-    const int channels = getSizeOfDimension(inputShape, 3);
-    const int outHeight = getSizeOfDimension(outputShape, 1);
-    const int outWidth = getSizeOfDimension(outputShape, 2);
-
-    const float heightScale = calculateResizeScale(inHeight, outHeight, alignCorners);
-    const float widthScale = calculateResizeScale(inWidth, outWidth, alignCorners);
-
-    const std::function<float(const int, const float)> scaler =
-            halfPixelCenters ? scaleHalfPixel : scaleLegacy;
-
-    for (int b = 0; b < batchSize; ++b) {
-        for (int y = 0; y < outHeight; ++y) {
-            int inY = std::min((alignCorners) ? static_cast<int>(roundf(scaler(y, heightScale)))
-                                              : static_cast<int>(floorf(scaler(y, heightScale))),
-                               inHeight - 1);
-            if (halfPixelCenters) {
-                inY = std::max(static_cast<int>(0), inY);
-            }
-            for (int x = 0; x < outWidth; ++x) {
-                int inX = std::min((alignCorners) ? static_cast<int>(roundf(scaler(x, widthScale)))
-                                                  : static_cast<int>(floorf(scaler(x, widthScale))),
-                                   inWidth - 1);
-                if (halfPixelCenters) {
-                    inX = std::max(static_cast<int>(0), inX);
-                }
-                std::copy_n(inputData + b * inHeight * inWidth * channels +
-                                    inY * inWidth * channels + inX * channels,
-                            channels,
-                            outputData + b * outHeight * outWidth * channels +
-                                    y * outWidth * channels + x * channels);
-            }
-        }
-    }
-
-    return true;
-}
-
 template <typename T>
 bool resizeImageOpNhwc(OperationType opType, const T* inputData, const Shape& inputShape,
                        bool alignCorners, bool halfPixelCenters, T* outputData,
-                       const Shape& outputShape) {
+                       const Shape& outputShape, ScratchWorkspace* workspace) {
     NNTRACE_TRANS("resizeImageOpNhwc");
-    int32_t height = static_cast<int32_t>(getSizeOfDimension(outputShape, 1));
-    int32_t width = static_cast<int32_t>(getSizeOfDimension(outputShape, 2));
-    // We have to fake a tensor here, to satisfy tflite implementation.
-    int32_t outDimData[2] = {height, width};
-    Shape outDimShape;
-    outDimShape.dimensions = {2};
+    const ResizeDimensions dims = {.batches = getSizeOfDimension(inputShape, 0),
+                                   .inHeight = getSizeOfDimension(inputShape, 1),
+                                   .inWidth = getSizeOfDimension(inputShape, 2),
+                                   .channels = getSizeOfDimension(inputShape, 3),
+                                   .outHeight = getSizeOfDimension(outputShape, 1),
+                                   .outWidth = getSizeOfDimension(outputShape, 2)};
+    const ResizeOptions options = {.alignCorners = alignCorners,
+                                   .halfPixelCenters = halfPixelCenters};
 
     if (opType == OperationType::RESIZE_BILINEAR) {
-        NNTRACE_COMP_SWITCH("optimized_ops::ResizeBilinear");
-        tflite::reference_ops::ResizeBilinear(
-                {.align_corners = alignCorners, .half_pixel_centers = halfPixelCenters},
-                convertShapeToTflshape(inputShape), inputData, convertShapeToTflshape(outDimShape),
-                outDimData, convertShapeToTflshape(outputShape), outputData);
+        NNTRACE_COMP_SWITCH("resizeBilinearNhwc");
+        return resizeBilinearNhwc(dims, options, inputData, outputData, workspace);
     } else if (opType == OperationType::RESIZE_NEAREST_NEIGHBOR) {
-        // Align corners = true is not supported.
-        NNTRACE_COMP_SWITCH("ResizeNearestNeighbor");
-        resizeNearestNeighbor(inputData, inputShape, alignCorners, halfPixelCenters, outputData,
-                              outputShape);
+        NNTRACE_COMP_SWITCH("resizeNearestNeighborNhwc");
+        return resizeNearestNeighborNhwc(dims, options, inputData, outputData, workspace);
     }
-    return true;
-}
-
-template <>
-bool resizeImageOpNhwc<_Float16>(OperationType opType, const _Float16* inputData,
-                                 const Shape& inputShape, bool alignCorners, bool halfPixelCenters,
-                                 _Float16* outputData, const Shape& outputShape) {
-    NNTRACE_TRANS("resizeImageOpNhwcFloat16");
-    std::vector<float> inputData_float32(getNumberOfElements(inputShape));
-    convertFloat16ToFloat32(inputData, &inputData_float32);
-    std::vector<float> outputData_float32(getNumberOfElements(outputShape));
-    NN_RET_CHECK(resizeImageOpNhwc(opType, inputData_float32.data(), inputShape, alignCorners,
-                                   halfPixelCenters, outputData_float32.data(), outputShape));
-    convertFloat32ToFloat16(outputData_float32, outputData);
-    return true;
+    NN_RET_CHECK_FAIL() << "Unsupported operation " << opType;
 }
 
 template <typename T>
 bool resizeImageOp(OperationType opType, const T* inputData, const Shape& inputShape, bool useNchw,
                    bool alignCorners, bool halfPixelCenters, T* outputData,
-                   const Shape& outputShape) {
-    InputWithLayout<T> input(useNchw);
-    OutputWithLayout<T> output(useNchw);
+                   const Shape& outputShape, ScratchWorkspace* workspace) {
+    InputWithLayout<T> input(useNchw, workspace);
+    OutputWithLayout<T> output(useNchw, workspace);
     NN_RET_CHECK(input.initialize(inputData, inputShape));
     NN_RET_CHECK(output.initialize(outputData, outputShape));
     NN_RET_CHECK(resizeImageOpNhwc(opType, input.getNhwcBuffer(), input.getNhwcShape(),
                                    alignCorners, halfPixelCenters, output.getNhwcBuffer(),
-                                   output.getNhwcShape()));
+                                   output.getNhwcShape(), workspace));
     NN_RET_CHECK(output.commit());
     return true;
 }
@@ -219,7 +140,7 @@ bool prepare(OperationType opType, IOperationExecutionContext* context) {
 
 bool execute(OperationType opType, IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
 
     const bool useNchw = getOptionalScalar(context, kLayoutScalar);
     const bool alignCorners = getOptionalScalar(context, kAlignCornersScalar);
@@ -231,22 +152,26 @@ bool execute(OperationType opType, IOperationExecutionContext* context) {
                                  context->getInputShape(kInputTensor), useNchw, alignCorners,
                                  halfPixelCenters,
                                  context->getOutputBuffer<_Float16>(kOutputTensor),
-                                 context->getOutputShape(kOutputTensor));
+                                 context->getOutputShape(kOutputTensor),
+                                 context->getScratchWorkspace());
         case OperandType::TENSOR_FLOAT32:
             return resizeImageOp(opType, context->getInputBuffer<float>(kInputTensor),
                                  context->getInputShape(kInputTensor), useNchw, alignCorners,
                                  halfPixelCenters, context->getOutputBuffer<float>(kOutputTensor),
-                                 context->getOutputShape(kOutputTensor));
+                                 context->getOutputShape(kOutputTensor),
+                                 context->getScratchWorkspace());
         case OperandType::TENSOR_QUANT8_ASYMM:
             return resizeImageOp(opType, context->getInputBuffer<uint8_t>(kInputTensor),
                                  context->getInputShape(kInputTensor), useNchw, alignCorners,
                                  halfPixelCenters, context->getOutputBuffer<uint8_t>(kOutputTensor),
-                                 context->getOutputShape(kOutputTensor));
+                                 context->getOutputShape(kOutputTensor),
+                                 context->getScratchWorkspace());
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
             return resizeImageOp(opType, context->getInputBuffer<int8_t>(kInputTensor),
                                  context->getInputShape(kInputTensor), useNchw, alignCorners,
                                  halfPixelCenters, context->getOutputBuffer<int8_t>(kOutputTensor),
-                                 context->getOutputShape(kOutputTensor));
+                                 context->getOutputShape(kOutputTensor),
+                                 context->getScratchWorkspace());
 
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation " << opType;
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "CpuParallelFor.h"
+#include "CpuResize.h"
+#include "OperationsExecutionUtils.h"
+
+namespace android::nn {
+namespace {
+
+constexpr uint32_t kChannels = 3;
+
+// Square RGB images resized from the first size to the second, as in the preprocessing of vision
+// models with 224x224, 320x320 and 512x512 inputs.
+constexpr int64_t kResizeCases[][2] = {{224, 320}, {224, 512}, {320, 512},
+                                       {512, 224}, {512, 320}, {320, 224}};
+
+ResizeDimensions getDimensions(const benchmark::State& state) {
+    const auto inSize = static_cast<uint32_t>(state.range(0));
+    const auto outSize = static_cast<uint32_t>(state.range(1));
+    return {.batches = 1,
+            .inHeight = inSize,
+            .inWidth = inSize,
+            .channels = kChannels,
+            .outHeight = outSize,
+            .outWidth = outSize};
+}
+
+template <typename T>
+class ResizeFixture {
+   public:
+    explicit ResizeFixture(const ResizeDimensions& dims) : mDims(dims) {
+        std::mt19937 random(1);
+        std::uniform_int_distribution<int> distribution(0, 127);
+        mInput.resize(static_cast<size_t>(dims.batches) * dims.inHeight * dims.inWidth *
+                      dims.channels);
+        mOutput.resize(static_cast<size_t>(dims.batches) * dims.outHeight * dims.outWidth *
+                       dims.channels);
+        for (T& value : mInput) value = static_cast<T>(distribution(random));
+    }
+
+    bool runBilinear(ScratchWorkspace* workspace) {
+        const bool success = resizeBilinearNhwc(mDims, {.halfPixelCenters = true}, mInput.data(),
+                                                mOutput.data(), workspace);
+        workspace->reset();
+        return success;
+    }
+
+    bool runNearestNeighbor(ScratchWorkspace* workspace) {
+        const bool success = resizeNearestNeighborNhwc(mDims, {.halfPixelCenters = true},
+                                                       mInput.data(), mOutput.data(), workspace);
+        workspace->reset();
+        return success;
+    }
+
+    // Mirrors the previous implementation of RESIZE_BILINEAR, the TFLite reference kernel, which
+    // computes the input coordinates of every output pixel and indexes the tensors in 4D.
+    void runBilinearReference() {
+        const ResizeDimensions& d = mDims;
+        const auto offset = [](uint32_t height, uint32_t width, uint32_t depth, uint32_t b,
+                               int32_t y, int32_t x, uint32_t c) {
+            return ((b * height + y) * width + x) * depth + c;
+        };
+        const auto interpolation = [](float value, float scale, int32_t size, float* scaled,
+                                      int32_t* lower, int32_t* upper) {
+            *scaled = (value + 0.5f) * scale - 0.5f;
+            *lower = std::max(static_cast<int32_t>(std::floor(*scaled)), 0);
+            *upper = std::min(static_cast<int32_t>(std::ceil(*scaled)), size - 1);
+        };
+        const float heightScale = static_cast<float>(d.inHeight) / d.outHeight;
+        const float widthScale = static_cast<float>(d.inWidth) / d.outWidth;
+        for (uint32_t b = 0; b < d.batches; ++b) {
+            for (uint32_t y = 0; y < d.outHeight; ++y) {
+                float inY;
+                int32_t y0, y1;
+                interpolation(y, heightScale, d.inHeight, &inY, &y0, &y1);
+                for (uint32_t x = 0; x < d.outWidth; ++x) {
+                    float inX;
+                    int32_t x0, x1;
+                    interpolation(x, widthScale, d.inWidth, &inX, &x0, &x1);
+                    for (uint32_t c = 0; c < d.channels; ++c) {
+                        const auto in = [&](int32_t y, int32_t x) {
+                            return static_cast<float>(
+                                    mInput[offset(d.inHeight, d.inWidth, d.channels, b, y, x, c)]);
+                        };
+                        mOutput[offset(d.outHeight, d.outWidth, d.channels, b, y, x, c)] =
+                                static_cast<T>(in(y0, x0) * (1 - (inY - y0)) * (1 - (inX - x0)) +
+                                               in(y1, x0) * (inY - y0) * (1 - (inX - x0)) +
+                                               in(y0, x1) * (1 - (inY - y0)) * (inX - x0) +
+                                               in(y1, x1) * (inY - y0) * (inX - x0));
+                    }
+                }
+            }
+        }
+    }
+
+    // Mirrors the previous implementation of RESIZE_NEAREST_NEIGHBOR, which computed the input
+    // coordinates of every output pixel through a std::function.
+    void runNearestNeighborReference() {
+        const ResizeDimensions& d = mDims;
+        const std::function<float(const int, const float)> scaler = [](int x, float scale) {
+            return (static_cast<float>(x) + 0.5f) * scale;
+        };
+        const float heightScale = static_cast<float>(d.inHeight) / d.outHeight;
+        const float widthScale = static_cast<float>(d.inWidth) / d.outWidth;
+        for (uint32_t b = 0; b < d.batches; ++b) {
+            for (uint32_t y = 0; y < d.outHeight; ++y) {
+                int inY = std::min(static_cast<int>(floorf(scaler(y, heightScale))),
+                                   static_cast<int>(d.inHeight) - 1);
+                inY = std::max(0, inY);
+                for (uint32_t x = 0; x < d.outWidth; ++x) {
+                    int inX = std::min(static_cast<int>(floorf(scaler(x, widthScale))),
+                                       static_cast<int>(d.inWidth) - 1);
+                    inX = std::max(0, inX);
+                    std::copy_n(mInput.data() + ((b * d.inHeight + inY) * d.inWidth + inX) *
+                                                        d.channels,
+                                d.channels,
+                                mOutput.data() + ((b * d.outHeight + y) * d.outWidth + x) *
+                                                         d.channels);
+                }
+            }
+        }
+    }
+
+   private:
+    const ResizeDimensions mDims;
+    std::vector<T> mInput;
+    std::vector<T> mOutput;
+};
+
+void setCounters(benchmark::State& state, const ResizeDimensions& dims) {
+    state.counters["pixels"] =
+            benchmark::Counter(static_cast<double>(dims.batches) * dims.outHeight * dims.outWidth,
+                               benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// Arguments: the input size, the output size and the number of threads.
+template <typename T>
+void BM_ResizeBilinear(benchmark::State& state) {
+    const ResizeDimensions dims = getDimensions(state);
+    ResizeFixture<T> fixture(dims);
+    setCpuThreadCount(static_cast<uint32_t>(state.range(2)));
+    ScratchWorkspace workspace;
+    for (auto _ : state) {
+        if (!fixture.runBilinear(&workspace)) {
+            state.SkipWithError("resizeBilinearNhwc failed");
+            break;
+        }
+    }
+    setCpuThreadCount(0);
+    setCounters(state, dims);
+}
+
+// Arguments: the input size, the output size and the number of threads.
+template <typename T>
+void BM_ResizeNearestNeighbor(benchmark::State& state) {
+    const ResizeDimensions dims = getDimensions(state);
+    ResizeFixture<T> fixture(dims);
+    setCpuThreadCount(static_cast<uint32_t>(state.range(2)));
+    ScratchWorkspace workspace;
+    for (auto _ : state) {
+        if (!fixture.runNearestNeighbor(&workspace)) {
+            state.SkipWithError("resizeNearestNeighborNhwc failed");
+            break;
+        }
+    }
+    setCpuThreadCount(0);
+    setCounters(state, dims);
+}
+
+// Arguments: the input size and the output size.
+void BM_ResizeBilinearReference(benchmark::State& state) {
+    const ResizeDimensions dims = getDimensions(state);
+    ResizeFixture<float> fixture(dims);
+    for (auto _ : state) {
+        fixture.runBilinearReference();
+    }
+    setCounters(state, dims);
+}
+
+// Arguments: the input size and the output size.
+void BM_ResizeNearestNeighborReference(benchmark::State& state) {
+    const ResizeDimensions dims = getDimensions(state);
+    ResizeFixture<float> fixture(dims);
+    for (auto _ : state) {
+        fixture.runNearestNeighborReference();
+    }
+    setCounters(state, dims);
+}
+
+void addResizeArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"in", "out", "threads"});
+    for (const auto& [inSize, outSize] : kResizeCases) {
+        for (int64_t threadCount : {1, 4}) {
+            benchmark->Args({inSize, outSize, threadCount});
+        }
+    }
+    benchmark->Unit(benchmark::kMicrosecond)->UseRealTime();
+}
+
+void addReferenceArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"in", "out"});
+    for (const auto& [inSize, outSize] : kResizeCases) {
+        benchmark->Args({inSize, outSize});
+    }
+    benchmark->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK_TEMPLATE(BM_ResizeBilinear, float)->Apply(addResizeArguments);
+BENCHMARK_TEMPLATE(BM_ResizeBilinear, _Float16)->Apply(addResizeArguments);
+BENCHMARK_TEMPLATE(BM_ResizeBilinear, uint8_t)->Apply(addResizeArguments);
+BENCHMARK_TEMPLATE(BM_ResizeBilinear, int8_t)->Apply(addResizeArguments);
+BENCHMARK(BM_ResizeBilinearReference)->Apply(addReferenceArguments);
+BENCHMARK_TEMPLATE(BM_ResizeNearestNeighbor, float)->Apply(addResizeArguments);
+BENCHMARK_TEMPLATE(BM_ResizeNearestNeighbor, uint8_t)->Apply(addResizeArguments);
+BENCHMARK(BM_ResizeNearestNeighborReference)->Apply(addReferenceArguments);
+
+}  // namespace
+}  // namespace android::nn
@@ -43,6 +43,99 @@ namespace roi_align {
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 namespace {
 
+// A sampling point along the width or the height of the input, as the element offsets of the two
+// surrounding input positions and the bilinear interpolation weight of each of them.
+template <typename T>
+struct SamplingPoint {
+    uint32_t offset1;
+    uint32_t offset2;
+    T weight1;
+    T weight2;
+};
+
+// Computes the samplingRatio sampling points of each of the outSize bins of a ROI along one axis.
+// The points only depend on the bin position along that axis, so they are computed once per ROI
+// and shared by every output cell and channel.
+template <typename T>
+void computeSamplingPoints(T roiStart, T stepSize, T binSize, uint32_t outSize,
+                           uint32_t samplingRatio, uint32_t inSize, uint32_t stride,
+                           std::vector<SamplingPoint<T>>* points) {
+    points->clear();
+    for (uint32_t i = 0; i < outSize; i++) {
+        T start = stepSize * i + roiStart;
+        for (uint32_t ind = 0; ind < samplingRatio; ind++) {
+            T position = start + binSize / 2 + binSize * ind;
+            uint32_t index1 = std::floor(static_cast<float>(position));
+            uint32_t index2 = index1 + 1;
+            T distance1 = position - static_cast<T>(index1);
+
+            // dealing with out of bound samples
+            if (index1 >= inSize - 1) {
+                index1 = index2 = inSize - 1;
+                distance1 = 0;
+            }
+
+            T distance2 = 1.0f - distance1;
+            points->push_back({index1 * stride, index2 * stride, distance2, distance1});
+        }
+    }
+}
+
+// The sampling grid of a ROI.
+template <typename T>
+struct SamplingGrid {
+    uint32_t hSamplingRatio;
+    uint32_t wSamplingRatio;
+    std::vector<SamplingPoint<T>> hPoints;
+    std::vector<SamplingPoint<T>> wPoints;
+};
+
+template <typename T>
+void computeSamplingGrid(T hRoiStart, T wRoiStart, T roiHeight, T roiWidth,
+                         int32_t heightSamplingRatio, int32_t widthSamplingRatio,
+                         uint32_t outHeight, uint32_t outWidth, uint32_t inHeight,
+                         uint32_t inWidth, uint32_t inDepth, SamplingGrid<T>* grid) {
+    T wStepSize = roiWidth / static_cast<T>(outWidth);
+    T hStepSize = roiHeight / static_cast<T>(outHeight);
+
+    // if samplingRatio = 0, use adaptive value of ceil(roiWidth/outWidth), same for height
+    grid->wSamplingRatio = widthSamplingRatio > 0 ? widthSamplingRatio
+                                                  : std::ceil(static_cast<float>(wStepSize));
+    grid->hSamplingRatio = heightSamplingRatio > 0 ? heightSamplingRatio
+                                                   : std::ceil(static_cast<float>(hStepSize));
+    T wBinSize = wStepSize / static_cast<T>(grid->wSamplingRatio);
+    T hBinSize = hStepSize / static_cast<T>(grid->hSamplingRatio);
+    computeSamplingPoints(wRoiStart, wStepSize, wBinSize, outWidth, grid->wSamplingRatio, inWidth,
+                          inDepth, &grid->wPoints);
+    computeSamplingPoints(hRoiStart, hStepSize, hBinSize, outHeight, grid->hSamplingRatio,
+                          inHeight, inWidth * inDepth, &grid->hPoints);
+}
+
+// Calls fn(ws, in1, in2, in3, in4) for every sampling point of output cell (i, j), where in1 to in4
+// point to the channels of the four input positions surrounding the sampling point and ws holds
+// their bilinear interpolation weights.
+template <typename T_Input, typename T_Roi, typename Function>
+inline void forEachSamplingPoint(const SamplingGrid<T_Roi>& grid, const T_Input* batchBase,
+                                 uint32_t i, uint32_t j, Function fn) {
+    const SamplingPoint<T_Roi>* hPoints = grid.hPoints.data() + i * grid.hSamplingRatio;
+    const SamplingPoint<T_Roi>* wPoints = grid.wPoints.data() + j * grid.wSamplingRatio;
+    for (uint32_t yInd = 0; yInd < grid.hSamplingRatio; yInd++) {
+        const SamplingPoint<T_Roi>& y = hPoints[yInd];
+        for (uint32_t xInd = 0; xInd < grid.wSamplingRatio; xInd++) {
+            const SamplingPoint<T_Roi>& x = wPoints[xInd];
+            const T_Roi ws[] = {x.weight1 * y.weight1, x.weight2 * y.weight1,
+                                x.weight1 * y.weight2, x.weight2 * y.weight2};
+            fn(ws, batchBase + y.offset1 + x.offset1, batchBase + y.offset1 + x.offset2,
+               batchBase + y.offset2 + x.offset1, batchBase + y.offset2 + x.offset2);
+        }
+    }
+}
+
+// Returns the minChunkSize to pass to parallelFor when processing one ROI at a time.
+inline uint32_t getRoiMinChunkSize(uint32_t outHeight, uint32_t outWidth, uint32_t inDepth) {
+    return getParallelForMinChunkSize(static_cast<uint64_t>(outHeight) * outWidth * inDepth * 4);
+}
+
 template <typename T_Input, typename T_Roi>
 inline bool roiAlignNhwc(const T_Input* inputData, const Shape& inputShape, const T_Roi* roiData,
                          const Shape& roiShape, const int32_t* batchSplitData,
@@ -62,110 +155,75 @@ inline bool roiAlignNhwc(const T_Input* inputData, const Shape& inputShape, cons
     uint32_t outHeight = getSizeOfDimension(outputShape, 1);
     uint32_t outWidth = getSizeOfDimension(outputShape, 2);
     uint32_t numRois = getSizeOfDimension(roiShape, 0);
-    uint32_t roiInfoLength = getSizeOfDimension(roiShape, 1);
-
-    T_Input* outPtr = outputData;
-    const T_Roi* roiDataEnd = roiData + numRois * roiInfoLength;
-    uint32_t roiIndex = 0;
-    for (const T_Roi* roiInfo = roiData; roiInfo < roiDataEnd; roiInfo += kRoiDim, roiIndex++) {
-        uint32_t batchId = static_cast<uint32_t>(batchSplitData[roiIndex]);
-        // Check for malformed data
-        // 1. invalid batch id
-        // 2. Region out of bound: x1|x2|y1|y2 < 0 || x1|x2 > inWidth || y1|y2 > inHeight
-        // 3. Invalid region: x2 < x1 || y2 < y1
-        NN_RET_CHECK_GE(batchId, 0u);
-        NN_RET_CHECK_LT(batchId, numBatches);
-        NN_RET_CHECK(roiInfo[0] >= 0);
-        NN_RET_CHECK(roiInfo[1] >= 0);
-        NN_RET_CHECK(roiInfo[2] >= 0);
-        NN_RET_CHECK(roiInfo[3] >= 0);
-        NN_RET_CHECK(roiInfo[0] * widthScale <= inWidth);
-        NN_RET_CHECK(roiInfo[1] * heightScale <= inHeight);
-        NN_RET_CHECK(roiInfo[2] * widthScale <= inWidth);
-        NN_RET_CHECK(roiInfo[3] * heightScale <= inHeight);
-        NN_RET_CHECK(roiInfo[0] <= roiInfo[2]);
-        NN_RET_CHECK(roiInfo[1] <= roiInfo[3]);
-
-        T_Roi wRoiStart = roiInfo[0] * widthScale;
-        T_Roi hRoiStart = roiInfo[1] * heightScale;
-        T_Roi wRoiEnd = roiInfo[2] * widthScale;
-        T_Roi hRoiEnd = roiInfo[3] * heightScale;
-
-        T_Roi roiWidth = std::max(static_cast<float>(wRoiEnd - wRoiStart), 1.0f);
-        T_Roi roiHeight = std::max(static_cast<float>(hRoiEnd - hRoiStart), 1.0f);
-        T_Roi wStepSize = roiWidth / static_cast<T_Roi>(outWidth);
-        T_Roi hStepSize = roiHeight / static_cast<T_Roi>(outHeight);
-
-        // if samplingRatio = 0, use adaptive value of ceil(roiWidth/outWidth), same for height
-        uint32_t wSamplingRatio = widthSamplingRatio > 0 ? widthSamplingRatio
-                                                         : std::ceil(static_cast<float>(wStepSize));
-        uint32_t hSamplingRatio = heightSamplingRatio > 0
-                                          ? heightSamplingRatio
-                                          : std::ceil(static_cast<float>(hStepSize));
-        int32_t numSamplingPoints = wSamplingRatio * hSamplingRatio;
-        T_Roi wBinSize = wStepSize / static_cast<T_Roi>(wSamplingRatio);
-        T_Roi hBinSize = hStepSize / static_cast<T_Roi>(hSamplingRatio);
-
-        const T_Input* batchBase = inputData + batchId * inHeight * inWidth * inDepth;
-        for (uint32_t i = 0; i < outHeight; i++) {
-            for (uint32_t j = 0; j < outWidth; j++) {
-                T_Roi wStart = wStepSize * j + wRoiStart;
-                [[maybe_unused]] T_Roi wEnd = wStepSize * (j + 1) + wRoiStart;
-                T_Roi hStart = hStepSize * i + hRoiStart;
-                [[maybe_unused]] T_Roi hEnd = hStepSize * (i + 1) + hRoiStart;
-
-                // initialize output to zero
-                for (uint32_t k = 0; k < inDepth; k++) outPtr[k] = 0;
-
-                // calculate the sum of the sampling points
-                for (uint32_t yInd = 0; yInd < hSamplingRatio; yInd++) {
-                    for (uint32_t xInd = 0; xInd < wSamplingRatio; xInd++) {
-                        T_Roi y = hStart + hBinSize / 2 + hBinSize * yInd;
-                        T_Roi x = wStart + wBinSize / 2 + wBinSize * xInd;
-
-                        // bilinear interpolation of point (x,y)
-                        // w.r.t box [(x1,y1), (x1,y2), (x2,y1), (x2,y2)]
-                        uint32_t x1 = std::floor(static_cast<float>(x));
-                        uint32_t y1 = std::floor(static_cast<float>(y));
-                        uint32_t x2 = x1 + 1, y2 = y1 + 1;
-                        T_Roi dx1 = x - static_cast<T_Roi>(x1);
-                        T_Roi dy1 = y - static_cast<T_Roi>(y1);
-
-                        // dealing with out of bound samples
-                        if (x1 >= inWidth - 1) {
-                            x1 = x2 = inWidth - 1;
-                            dx1 = 0;
-                        }
-                        if (y1 >= inHeight - 1) {
-                            y1 = y2 = inHeight - 1;
-                            dy1 = 0;
-                        }
-
-                        T_Roi dx2 = 1.0f - dx1, dy2 = 1.0f - dy1;
-                        T_Roi ws[] = {dx2 * dy2, dx1 * dy2, dx2 * dy1, dx1 * dy1};
-                        uint32_t offsets[] = {y1 * inWidth * inDepth + x1 * inDepth,
-                                              y1 * inWidth * inDepth + x2 * inDepth,
-                                              y2 * inWidth * inDepth + x1 * inDepth,
-                                              y2 * inWidth * inDepth + x2 * inDepth};
-
-                        for (uint32_t k = 0; k < inDepth; k++) {
-                            T_Input interpolation = 0;
-                            for (uint32_t c = 0; c < 4; c++) {
-                                interpolation += ws[c] * batchBase[offsets[c] + k];
-                            }
-                            outPtr[k] += interpolation;
-                        }
-                    }
-                }
 
-                // take average
-                for (uint32_t k = 0; k < inDepth; k++)
-                    outPtr[k] /= static_cast<T_Input>(numSamplingPoints);
-                outPtr += inDepth;
+    auto computeRois = [&](uint32_t begin, uint32_t end) -> bool {
+        SamplingGrid<T_Roi> grid;
+        for (uint32_t roiIndex = begin; roiIndex < end; roiIndex++) {
+            const T_Roi* roiInfo = roiData + roiIndex * kRoiDim;
+            uint32_t batchId = static_cast<uint32_t>(batchSplitData[roiIndex]);
+            // Check for malformed data
+            // 1. invalid batch id
+            // 2. Region out of bound: x1|x2|y1|y2 < 0 || x1|x2 > inWidth || y1|y2 > inHeight
+            // 3. Invalid region: x2 < x1 || y2 < y1
+            NN_RET_CHECK_GE(batchId, 0u);
+            NN_RET_CHECK_LT(batchId, numBatches);
+            NN_RET_CHECK(roiInfo[0] >= 0);
+            NN_RET_CHECK(roiInfo[1] >= 0);
+            NN_RET_CHECK(roiInfo[2] >= 0);
+            NN_RET_CHECK(roiInfo[3] >= 0);
+            NN_RET_CHECK(roiInfo[0] * widthScale <= inWidth);
+            NN_RET_CHECK(roiInfo[1] * heightScale <= inHeight);
+            NN_RET_CHECK(roiInfo[2] * widthScale <= inWidth);
+            NN_RET_CHECK(roiInfo[3] * heightScale <= inHeight);
+            NN_RET_CHECK(roiInfo[0] <= roiInfo[2]);
+            NN_RET_CHECK(roiInfo[1] <= roiInfo[3]);
+
+            T_Roi wRoiStart = roiInfo[0] * widthScale;
+            T_Roi hRoiStart = roiInfo[1] * heightScale;
+            T_Roi wRoiEnd = roiInfo[2] * widthScale;
+            T_Roi hRoiEnd = roiInfo[3] * heightScale;
+
+            T_Roi roiWidth = std::max(static_cast<float>(wRoiEnd - wRoiStart), 1.0f);
+            T_Roi roiHeight = std::max(static_cast<float>(hRoiEnd - hRoiStart), 1.0f);
+            computeSamplingGrid(hRoiStart, wRoiStart, roiHeight, roiWidth, heightSamplingRatio,
+                                widthSamplingRatio, outHeight, outWidth, inHeight, inWidth,
+                                inDepth, &grid);
+            int32_t numSamplingPoints = grid.wSamplingRatio * grid.hSamplingRatio;
+
+            const T_Input* batchBase = inputData + batchId * inHeight * inWidth * inDepth;
+            T_Input* outPtr = outputData + roiIndex * outHeight * outWidth * inDepth;
+            for (uint32_t i = 0; i < outHeight; i++) {
+                for (uint32_t j = 0; j < outWidth; j++) {
+                    // initialize output to zero
+                    std::fill(outPtr, outPtr + inDepth, T_Input(0));
+
+                    // calculate the sum of the sampling points
+                    forEachSamplingPoint(
+                            grid, batchBase, i, j,
+                            [outPtr, inDepth](const T_Roi* ws, const T_Input* __restrict in1,
+                                              const T_Input* __restrict in2,
+                                              const T_Input* __restrict in3,
+                                              const T_Input* __restrict in4) {
+                                for (uint32_t k = 0; k < inDepth; k++) {
+                                    T_Input interpolation = 0;
+                                    interpolation += ws[0] * in1[k];
+                                    interpolation += ws[1] * in2[k];
+                                    interpolation += ws[2] * in3[k];
+                                    interpolation += ws[3] * in4[k];
+                                    outPtr[k] += interpolation;
+                                }
+                            });
+
+                    // take average
+                    for (uint32_t k = 0; k < inDepth; k++)
+                        outPtr[k] /= static_cast<T_Input>(numSamplingPoints);
+                    outPtr += inDepth;
+                }
             }
         }
-    }
-    return true;
+        return true;
+    };
+    return parallelFor(numRois, getRoiMinChunkSize(outHeight, outWidth, inDepth), computeRois);
 }
 
 template <typename T_Input>
@@ -177,7 +235,7 @@ inline bool roiAlignQuantNhwc(const T_Input* inputData, const Shape& inputShape,
                               const Shape& outputShape) {
     NNTRACE_TRANS("RoiAlignQuant8");
 
-    constexpr float wScale = 1.0f / 255.0f;
+    static constexpr float wScale = 1.0f / 255.0f;
     constexpr uint32_t kRoiDim = 4;
     const float heightScale = 1.0f / heightStride;
     const float widthScale = 1.0f / widthStride;
@@ -189,116 +247,91 @@ inline bool roiAlignQuantNhwc(const T_Input* inputData, const Shape& inputShape,
     uint32_t outHeight = getSizeOfDimension(outputShape, 1);
     uint32_t outWidth = getSizeOfDimension(outputShape, 2);
     uint32_t numRois = getSizeOfDimension(roiShape, 0);
-    uint32_t roiInfoLength = getSizeOfDimension(roiShape, 1);
-
-    T_Input* outPtr = outputData;
-    const uint16_t* roiDataEnd = roiData + numRois * roiInfoLength;
-    uint32_t roiIndex = 0;
-    for (const uint16_t* roiInfo = roiData; roiInfo < roiDataEnd; roiInfo += kRoiDim, roiIndex++) {
-        uint32_t batchId = static_cast<uint32_t>(batchSplitData[roiIndex]);
-        float wRoiStart = static_cast<float>(roiInfo[0]) * widthScale * 0.125f;
-        float hRoiStart = static_cast<float>(roiInfo[1]) * heightScale * 0.125f;
-        float wRoiEnd = static_cast<float>(roiInfo[2]) * widthScale * 0.125f;
-        float hRoiEnd = static_cast<float>(roiInfo[3]) * heightScale * 0.125f;
-
-        // Check for malformed data
-        // 1. invalid batch id
-        // 2. Region out of bound: x1|x2|y1|y2 < 0 || x1|x2 > inWidth || y1|y2 > inHeight
-        // 3. Invalid region: x2 < x1 || y2 < y1
-        NN_RET_CHECK_GE(batchId, 0u);
-        NN_RET_CHECK_LT(batchId, numBatches);
-        NN_RET_CHECK(wRoiStart <= inWidth);
-        NN_RET_CHECK(hRoiStart <= inHeight);
-        NN_RET_CHECK(wRoiEnd <= inWidth);
-        NN_RET_CHECK(hRoiEnd <= inHeight);
-        NN_RET_CHECK_LE(wRoiStart, wRoiEnd);
-        NN_RET_CHECK_LE(hRoiStart, hRoiEnd);
-
-        float roiWidth = std::max(wRoiEnd - wRoiStart, 1.0f);
-        float roiHeight = std::max(hRoiEnd - hRoiStart, 1.0f);
-        float wStepSize = roiWidth / static_cast<float>(outWidth);
-        float hStepSize = roiHeight / static_cast<float>(outHeight);
-
-        // if samplingRatio = 0, use adaptive value of ceil(roiWidth/outWidth), same for height
-        uint32_t wSamplingRatio =
-                widthSamplingRatio > 0 ? widthSamplingRatio : std::ceil(wStepSize);
-        uint32_t hSamplingRatio =
-                heightSamplingRatio > 0 ? heightSamplingRatio : std::ceil(hStepSize);
-        int32_t numSamplingPoints = wSamplingRatio * hSamplingRatio;
-        float wBinSize = wStepSize / static_cast<float>(wSamplingRatio);
-        float hBinSize = hStepSize / static_cast<float>(hSamplingRatio);
-
-        float realMultiplier = inputShape.scale * wScale / outputShape.scale / numSamplingPoints;
-        int32_t outputMultiplier = 0;
-        int32_t outputShift = 0;
-        if (!QuantizeMultiplierSmallerThanOne(realMultiplier, &outputMultiplier, &outputShift)) {
-            return false;
-        }
+    const int32_t inputOffset = inputShape.offset;
+
+    auto computeRois = [&](uint32_t begin, uint32_t end) -> bool {
+        SamplingGrid<float> grid;
+        std::vector<int32_t> outTemp(inDepth);
+        for (uint32_t roiIndex = begin; roiIndex < end; roiIndex++) {
+            const uint16_t* roiInfo = roiData + roiIndex * kRoiDim;
+            uint32_t batchId = static_cast<uint32_t>(batchSplitData[roiIndex]);
+            float wRoiStart = static_cast<float>(roiInfo[0]) * widthScale * 0.125f;
+            float hRoiStart = static_cast<float>(roiInfo[1]) * heightScale * 0.125f;
+            float wRoiEnd = static_cast<float>(roiInfo[2]) * widthScale * 0.125f;
+            float hRoiEnd = static_cast<float>(roiInfo[3]) * heightScale * 0.125f;
+
+            // Check for malformed data
+            // 1. invalid batch id
+            // 2. Region out of bound: x1|x2|y1|y2 < 0 || x1|x2 > inWidth || y1|y2 > inHeight
+            // 3. Invalid region: x2 < x1 || y2 < y1
+            NN_RET_CHECK_GE(batchId, 0u);
+            NN_RET_CHECK_LT(batchId, numBatches);
+            NN_RET_CHECK(wRoiStart <= inWidth);
+            NN_RET_CHECK(hRoiStart <= inHeight);
+            NN_RET_CHECK(wRoiEnd <= inWidth);
+            NN_RET_CHECK(hRoiEnd <= inHeight);
+            NN_RET_CHECK_LE(wRoiStart, wRoiEnd);
+            NN_RET_CHECK_LE(hRoiStart, hRoiEnd);
+
+            float roiWidth = std::max(wRoiEnd - wRoiStart, 1.0f);
+            float roiHeight = std::max(hRoiEnd - hRoiStart, 1.0f);
+            computeSamplingGrid(hRoiStart, wRoiStart, roiHeight, roiWidth, heightSamplingRatio,
+                                widthSamplingRatio, outHeight, outWidth, inHeight, inWidth,
+                                inDepth, &grid);
+            int32_t numSamplingPoints = grid.wSamplingRatio * grid.hSamplingRatio;
+
+            float realMultiplier =
+                    inputShape.scale * wScale / outputShape.scale / numSamplingPoints;
+            int32_t outputMultiplier = 0;
+            int32_t outputShift = 0;
+            if (!QuantizeMultiplierSmallerThanOne(realMultiplier, &outputMultiplier,
+                                                  &outputShift)) {
+                return false;
+            }
 
-        const T_Input* batchBase = inputData + batchId * inHeight * inWidth * inDepth;
-        for (uint32_t i = 0; i < outHeight; i++) {
-            for (uint32_t j = 0; j < outWidth; j++) {
-                float wStart = wStepSize * j + wRoiStart;
-                [[maybe_unused]] float wEnd = wStepSize * (j + 1) + wRoiStart;
-                float hStart = hStepSize * i + hRoiStart;
-                [[maybe_unused]] float hEnd = hStepSize * (i + 1) + hRoiStart;
-
-                std::vector<int32_t> outTemp(inDepth, 0);
-                // calculate the sum of the sampling points
-                for (uint32_t yInd = 0; yInd < hSamplingRatio; yInd++) {
-                    for (uint32_t xInd = 0; xInd < wSamplingRatio; xInd++) {
-                        float y = hStart + hBinSize / 2 + hBinSize * yInd;
-                        float x = wStart + wBinSize / 2 + wBinSize * xInd;
-
-                        // bilinear interpolation of point (x,y)
-                        // w.r.t box [(x1,y1), (x1,y2), (x2,y1), (x2,y2)]
-                        uint32_t x1 = std::floor(x), y1 = std::floor(y);
-                        uint32_t x2 = x1 + 1, y2 = y1 + 1;
-                        float dx1 = x - static_cast<float>(x1);
-                        float dy1 = y - static_cast<float>(y1);
-
-                        // dealing with out of bound samples
-                        if (x1 >= inWidth - 1) {
-                            x1 = x2 = inWidth - 1;
-                            dx1 = 0;
-                        }
-                        if (y1 >= inHeight - 1) {
-                            y1 = y2 = inHeight - 1;
-                            dy1 = 0;
-                        }
-
-                        float dx2 = 1.0f - dx1, dy2 = 1.0f - dy1;
-                        float ws[] = {dx2 * dy2, dx1 * dy2, dx2 * dy1, dx1 * dy1};
-                        uint32_t offsets[] = {y1 * inWidth * inDepth + x1 * inDepth,
-                                              y1 * inWidth * inDepth + x2 * inDepth,
-                                              y2 * inWidth * inDepth + x1 * inDepth,
-                                              y2 * inWidth * inDepth + x2 * inDepth};
-
-                        for (uint32_t k = 0; k < inDepth; k++) {
-                            int32_t interpolation = 0;
-                            for (uint32_t c = 0; c < 4; c++) {
-                                int32_t wQuant = static_cast<int32_t>(std::round(ws[c] / wScale));
-                                interpolation +=
-                                        wQuant * (static_cast<int32_t>(batchBase[offsets[c] + k]) -
-                                                  inputShape.offset);
-                            }
-                            outTemp[k] += interpolation;
-                        }
+            const T_Input* batchBase = inputData + batchId * inHeight * inWidth * inDepth;
+            T_Input* outPtr = outputData + roiIndex * outHeight * outWidth * inDepth;
+            for (uint32_t i = 0; i < outHeight; i++) {
+                for (uint32_t j = 0; j < outWidth; j++) {
+                    std::fill(outTemp.begin(), outTemp.end(), 0);
+                    // calculate the sum of the sampling points
+                    forEachSamplingPoint(
+                            grid, batchBase, i, j,
+                            [&outTemp, inDepth, inputOffset](
+                                    const float* ws, const T_Input* __restrict in1,
+                                    const T_Input* __restrict in2, const T_Input* __restrict in3,
+                                    const T_Input* __restrict in4) {
+                                int32_t wQuant[4];
+                                for (uint32_t c = 0; c < 4; c++) {
+                                    wQuant[c] = static_cast<int32_t>(std::round(ws[c] / wScale));
+                                }
+                                int32_t* __restrict out = outTemp.data();
+                                for (uint32_t k = 0; k < inDepth; k++) {
+                                    out[k] += wQuant[0] * (static_cast<int32_t>(in1[k]) -
+                                                           inputOffset) +
+                                              wQuant[1] * (static_cast<int32_t>(in2[k]) -
+                                                           inputOffset) +
+                                              wQuant[2] * (static_cast<int32_t>(in3[k]) -
+                                                           inputOffset) +
+                                              wQuant[3] * (static_cast<int32_t>(in4[k]) -
+                                                           inputOffset);
+                                }
+                            });
+
+                    // take average and cast to output quantization
+                    for (uint32_t k = 0; k < inDepth; k++) {
+                        int32_t raw_out = tflite::MultiplyByQuantizedMultiplier(
+                                                  outTemp[k], outputMultiplier, -outputShift) +
+                                          outputShape.offset;
+                        outPtr[k] = saturateCast<T_Input>(raw_out);
                     }
+                    outPtr += inDepth;
                 }
-
-                // take average and cast to output quantization
-                for (uint32_t k = 0; k < inDepth; k++) {
-                    int32_t raw_out = tflite::MultiplyByQuantizedMultiplier(
-                                              outTemp[k], outputMultiplier, -outputShift) +
-                                      outputShape.offset;
-                    outPtr[k] = saturateCast<T_Input>(raw_out);
-                }
-                outPtr += inDepth;
             }
         }
-    }
-    return true;
+        return true;
+    };
+    return parallelFor(numRois, getRoiMinChunkSize(outHeight, outWidth, inDepth), computeRois);
 }
 
 template <typename T_Input, typename T_Roi>
@@ -306,9 +339,9 @@ inline bool roiAlign(const T_Input* inputData, const Shape& inputShape, const T_
                      const Shape& roiShape, const int32_t* batchSplitData,
                      const Shape& batchSplitShape, float heightStride, float widthStride,
                      int32_t heightSamplingRatio, int32_t widthSamplingRatio, bool useNchw,
-                     T_Input* outputData, const Shape& outputShape) {
-    InputWithLayout<T_Input> input(useNchw);
-    OutputWithLayout<T_Input> output(useNchw);
+                     T_Input* outputData, const Shape& outputShape, ScratchWorkspace* workspace) {
+    InputWithLayout<T_Input> input(useNchw, workspace);
+    OutputWithLayout<T_Input> output(useNchw, workspace);
     NN_RET_CHECK(input.initialize(inputData, inputShape));
     NN_RET_CHECK(output.initialize(outputData, outputShape));
     if constexpr (std::is_same_v<T_Roi, uint16_t> &&
@@ -389,7 +422,7 @@ bool prepare(IOperationExecutionContext* context) {
 
 bool execute(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getInputShape(kRoiTensor)) == 0) return true;
+    if (getNumberOfElements(context->getInputShapeView(kRoiTensor)) == 0) return true;
     switch (context->getInputType(kInputTensor)) {
         case OperandType::TENSOR_FLOAT16:
             return roiAlign(context->getInputBuffer<_Float16>(kInputTensor),
@@ -404,7 +437,8 @@ bool execute(IOperationExecutionContext* context) {
                             context->getInputValue<int32_t>(kWidthSamplingRatioScalar),
                             context->getInputValue<bool>(kLayoutScalar),
                             context->getOutputBuffer<_Float16>(kOutputTensor),
-                            context->getOutputShape(kOutputTensor));
+                            context->getOutputShape(kOutputTensor),
+                            context->getScratchWorkspace());
         case OperandType::TENSOR_FLOAT32:
             return roiAlign(context->getInputBuffer<float>(kInputTensor),
                             context->getInputShape(kInputTensor),
@@ -418,7 +452,8 @@ bool execute(IOperationExecutionContext* context) {
                             context->getInputValue<int32_t>(kWidthSamplingRatioScalar),
                             context->getInputValue<bool>(kLayoutScalar),
                             context->getOutputBuffer<float>(kOutputTensor),
-                            context->getOutputShape(kOutputTensor));
+                            context->getOutputShape(kOutputTensor),
+                            context->getScratchWorkspace());
         case OperandType::TENSOR_QUANT8_ASYMM:
             return roiAlign(context->getInputBuffer<uint8_t>(kInputTensor),
                             context->getInputShape(kInputTensor),
@@ -432,7 +467,8 @@ bool execute(IOperationExecutionContext* context) {
                             context->getInputValue<int32_t>(kWidthSamplingRatioScalar),
                             context->getInputValue<bool>(kLayoutScalar),
                             context->getOutputBuffer<uint8_t>(kOutputTensor),
-                            context->getOutputShape(kOutputTensor));
+                            context->getOutputShape(kOutputTensor),
+                            context->getScratchWorkspace());
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
             return roiAlign(context->getInputBuffer<int8_t>(kInputTensor),
                             context->getInputShape(kInputTensor),
@@ -446,7 +482,8 @@ bool execute(IOperationExecutionContext* context) {
                             context->getInputValue<int32_t>(kWidthSamplingRatioScalar),
                             context->getInputValue<bool>(kLayoutScalar),
                             context->getOutputBuffer<int8_t>(kOutputTensor),
-                            context->getOutputShape(kOutputTensor));
+                            context->getOutputShape(kOutputTensor),
+                            context->getScratchWorkspace());
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation " << kOperationName;
     }
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "CpuExecutor.h"
+#include "CpuExecutorTestUtils.h"
+#include "OperationsUtils.h"
+#include "nnapi/Types.h"
+#include "nnapi/Validation.h"
+
+namespace android::nn {
+namespace {
+
+using ::testing::ElementsAreArray;
+using test::createConstantOperand;
+using test::createPointerArgument;
+
+TEST(RoiAlignTest, SamplingPointsAreInterpolatedAndClamped) {
+    // A 4x4 input with two channels, x + 10 * y and 100 + x. Both are linear, so the bilinear
+    // interpolation at a sampling point equals the channel at that point.
+    std::vector<float> input;
+    for (uint32_t y = 0; y < 4; y++) {
+        for (uint32_t x = 0; x < 4; x++) {
+            input.push_back(x + 10.0f * y);
+            input.push_back(100.0f + x);
+        }
+    }
+    Model model;
+    model.main.operands = {
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {1, 4, 4, 2},
+             .lifetime = Operand::LifeTime::SUBGRAPH_INPUT},
+            // The second ROI reaches the last row and column, so that half of its sampling points
+            // are clamped to them.
+            createConstantOperand(&model, OperandType::TENSOR_FLOAT32, {2, 4},
+                                  std::vector<float>{0.5f, 1.0f, 2.5f, 3.0f, 2, 2, 4, 4}),
+            createConstantOperand(&model, OperandType::TENSOR_INT32, {2},
+                                  std::vector<int32_t>{0, 0}),
+            createConstantOperand(&model, OperandType::INT32, {}, std::vector<int32_t>{2}),
+            createConstantOperand(&model, OperandType::INT32, {}, std::vector<int32_t>{2}),
+            createConstantOperand(&model, OperandType::FLOAT32, {}, std::vector<float>{1.0f}),
+            createConstantOperand(&model, OperandType::FLOAT32, {}, std::vector<float>{1.0f}),
+            createConstantOperand(&model, OperandType::INT32, {}, std::vector<int32_t>{2}),
+            createConstantOperand(&model, OperandType::INT32, {}, std::vector<int32_t>{2}),
+            createConstantOperand(&model, OperandType::BOOL, {}, std::vector<bool8>{false}),
+            {.type = OperandType::TENSOR_FLOAT32,
+             .dimensions = {2, 2, 2, 2},
+             .lifetime = Operand::LifeTime::SUBGRAPH_OUTPUT},
+    };
+    model.main.operations = {
+            {.type = OperationType::ROI_ALIGN,
+             .inputs = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9},
+             .outputs = {10}},
+    };
+    model.main.inputIndexes = {0};
+    model.main.outputIndexes = {10};
+    ASSERT_TRUE(validate(model).ok());
+
+    std::vector<float> output(16);
+    const Request request = {
+            .inputs = {createPointerArgument(input.data(), input.size())},
+            .outputs = {createPointerArgument(output.data(), output.size())},
+    };
+    CpuExecutor executor;
+    ASSERT_EQ(executor.run(model, request, {}, {}), ANEURALNETWORKS_NO_ERROR);
+    // Each output cell averages two sampling points per axis, at a quarter and three quarters of
+    // the bin. The first ROI samples columns 0.75 to 2.25 and rows 1.25 to 2.75. The second one
+    // samples columns and rows 2.25 and 2.75 in its first bin, and 3 twice in its second bin.
+    EXPECT_THAT(output, ElementsAreArray({16.0f, 101.0f, 17.0f, 102.0f, 26.0f, 101.0f, 27.0f,
+                                          102.0f, 27.5f, 102.5f, 28.0f, 103.0f, 32.5f, 102.5f,
+                                          33.0f, 103.0f}));
+}
+
+}  // namespace
+}  // namespace android::nn
@@ -113,25 +113,26 @@ bool SVDF::Eval() {
     NNTRACE_TRANS("SVDF::Eval");
     switch (input_->type) {
         case OperandType::TENSOR_FLOAT16: {
-            std::vector<float> inputDataFloat32(getNumberOfElements(input_->shape()));
+            std::vector<float> inputDataFloat32(getNumberOfElements(input_->shapeView()));
             convertFloat16ToFloat32(reinterpret_cast<_Float16*>(input_->buffer), &inputDataFloat32);
-            std::vector<float> inputStateDataFloat32(getNumberOfElements(state_in_->shape()));
+            std::vector<float> inputStateDataFloat32(getNumberOfElements(state_in_->shapeView()));
             convertFloat16ToFloat32(reinterpret_cast<_Float16*>(state_in_->buffer),
                                     &inputStateDataFloat32);
-            std::vector<float> biasDataFloat32(getNumberOfElements(bias_->shape()));
+            std::vector<float> biasDataFloat32(getNumberOfElements(bias_->shapeView()));
             if (!IsNullInput(bias_)) {
                 convertFloat16ToFloat32(reinterpret_cast<_Float16*>(bias_->buffer),
                                         &biasDataFloat32);
             }
             std::vector<float> weightsFeatureDataFloat32(
-                    getNumberOfElements(weights_feature_->shape()));
+                    getNumberOfElements(weights_feature_->shapeView()));
             convertFloat16ToFloat32(reinterpret_cast<_Float16*>(weights_feature_->buffer),
                                     &weightsFeatureDataFloat32);
-            std::vector<float> weightsTimeDataFloat32(getNumberOfElements(weights_time_->shape()));
+            std::vector<float> weightsTimeDataFloat32(
+                    getNumberOfElements(weights_time_->shapeView()));
             convertFloat16ToFloat32(reinterpret_cast<_Float16*>(weights_time_->buffer),
                                     &weightsTimeDataFloat32);
-            std::vector<float> outputDataFloat32(getNumberOfElements(output_->shape()));
-            std::vector<float> outputStateDataFloat32(getNumberOfElements(state_out_->shape()));
+            std::vector<float> outputDataFloat32(getNumberOfElements(output_->shapeView()));
+            std::vector<float> outputStateDataFloat32(getNumberOfElements(state_out_->shapeView()));
 
             EvalFloat32(inputDataFloat32.data(), inputStateDataFloat32.data(),
                         biasDataFloat32.data(), weightsFeatureDataFloat32.data(),
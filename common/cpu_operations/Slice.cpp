@@ -18,13 +18,14 @@
 
 #include "Slice.h"
 
+#include <utility>
 #include <vector>
 
-#include "IndexedShapeWrapper.h"
 #include "OperationResolver.h"
 
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 #include "CpuOperationUtils.h"
+#include "CpuTensorCopy.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 namespace android {
@@ -35,55 +36,34 @@ namespace slice {
 namespace {
 
 template <typename T>
-void addVectors(const std::vector<T>& a, const std::vector<T>& b, std::vector<T>* res) {
-    for (size_t i = 0; i < res->size(); ++i) {
-        res->at(i) = a[i] + b[i];
+bool evalGeneric(const T* inputData, const ShapeView& inputShape, const int32_t* beginData,
+                 T* outputData, const ShapeView& outputShape) {
+    const uint32_t numDims = getNumberOfDimensions(inputShape);
+    const std::vector<int64_t> inputStrides = getContiguousStrides(inputShape.dimensions());
+    const std::vector<int64_t> outputStrides = getContiguousStrides(outputShape.dimensions());
+    std::vector<CopyAxis> axes(numDims);
+    int64_t inputOffset = 0;
+    for (uint32_t i = 0; i < numDims; ++i) {
+        inputOffset += beginData[i] * inputStrides[i];
+        axes[i] = {.size = getSizeOfDimension(outputShape, i),
+                   .inputStride = inputStrides[i],
+                   .outputStride = outputStrides[i]};
     }
-}
-
-template <typename T>
-bool evalGeneric(const T* inputData, const Shape& inputShape, const int32_t* beginData,
-                 const Shape& beginShape, const int32_t* /*sizeData*/, const Shape& /*sizeShape*/,
-                 T* outputData, const Shape& outputShape) {
-    [[maybe_unused]] const int outputSize = getNumberOfElements(outputShape);
-    const IndexedShapeWrapper indexedOutput = IndexedShapeWrapper(outputShape);
-    const IndexedShapeWrapper indexedInput = IndexedShapeWrapper(inputShape);
-    std::vector<uint32_t> outputIndex(getNumberOfDimensions(outputShape), 0);
-    std::vector<uint32_t> beginIndex(getSizeOfDimension(beginShape, 0));
-    std::vector<uint32_t> inputIndex(getNumberOfDimensions(inputShape));
-
-    for (size_t i = 0; i < beginIndex.size(); ++i) {
-        beginIndex[i] = static_cast<uint32_t>(beginData[i]);
-    }
-
-    bool lastIndex = false;
-    uint32_t outputOffset;
-    uint32_t inputOffset;
-
-    do {
-        addVectors(outputIndex, beginIndex, &inputIndex);
-
-        NN_RET_CHECK(indexedOutput.indexToFlatIndex(outputIndex, &outputOffset));
-        NN_RET_CHECK(indexedInput.indexToFlatIndex(inputIndex, &inputOffset));
-
-        outputData[outputOffset] = inputData[inputOffset];
-        NN_RET_CHECK(indexedOutput.nextIndexInplace(&outputIndex, &lastIndex));
-    } while (!lastIndex);
-    return true;
+    return copyTensor(inputData + inputOffset, outputData, sizeof(T), std::move(axes));
 }
 
 }  // namespace
 
 bool prepare(IOperationExecutionContext* context) {
-    const Shape& inputShape = context->getInputShape(kInputTensor);
+    const ShapeView inputShape = context->getInputShapeView(kInputTensor);
     const uint32_t n_dims = getNumberOfDimensions(inputShape);
     NN_RET_CHECK(n_dims > 0);
 
-    const Shape& beginShape = context->getInputShape(kBeginTensor);
+    const ShapeView beginShape = context->getInputShapeView(kBeginTensor);
     NN_RET_CHECK_EQ(getNumberOfDimensions(beginShape), 1u);
     NN_RET_CHECK_EQ(getSizeOfDimension(beginShape, 0), n_dims);
 
-    const Shape& sizeShape = context->getInputShape(kSizeTensor);
+    const ShapeView sizeShape = context->getInputShapeView(kSizeTensor);
     NN_RET_CHECK_EQ(getNumberOfDimensions(sizeShape), 1u);
     NN_RET_CHECK_EQ(getSizeOfDimension(sizeShape, 0), n_dims);
 
@@ -109,53 +89,38 @@ bool prepare(IOperationExecutionContext* context) {
 
 bool execute(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     switch (context->getInputType(kInputTensor)) {
         case OperandType::TENSOR_FLOAT16:
             return evalGeneric(context->getInputBuffer<_Float16>(kInputTensor),
-                               context->getInputShape(kInputTensor),
+                               context->getInputShapeView(kInputTensor),
                                context->getInputBuffer<int32_t>(kBeginTensor),
-                               context->getInputShape(kBeginTensor),
-                               context->getInputBuffer<int32_t>(kSizeTensor),
-                               context->getInputShape(kSizeTensor),
                                context->getOutputBuffer<_Float16>(kOutputTensor),
-                               context->getOutputShape(kOutputTensor));
+                               context->getOutputShapeView(kOutputTensor));
         case OperandType::TENSOR_FLOAT32:
             return evalGeneric(context->getInputBuffer<float>(kInputTensor),
-                               context->getInputShape(kInputTensor),
+                               context->getInputShapeView(kInputTensor),
                                context->getInputBuffer<int32_t>(kBeginTensor),
-                               context->getInputShape(kBeginTensor),
-                               context->getInputBuffer<int32_t>(kSizeTensor),
-                               context->getInputShape(kSizeTensor),
                                context->getOutputBuffer<float>(kOutputTensor),
-                               context->getOutputShape(kOutputTensor));
+                               context->getOutputShapeView(kOutputTensor));
         case OperandType::TENSOR_INT32:
             return evalGeneric(context->getInputBuffer<int32_t>(kInputTensor),
-                               context->getInputShape(kInputTensor),
+                               context->getInputShapeView(kInputTensor),
                                context->getInputBuffer<int32_t>(kBeginTensor),
-                               context->getInputShape(kBeginTensor),
-                               context->getInputBuffer<int32_t>(kSizeTensor),
-                               context->getInputShape(kSizeTensor),
                                context->getOutputBuffer<int32_t>(kOutputTensor),
-                               context->getOutputShape(kOutputTensor));
+                               context->getOutputShapeView(kOutputTensor));
         case OperandType::TENSOR_QUANT8_ASYMM:
             return evalGeneric(context->getInputBuffer<uint8_t>(kInputTensor),
-                               context->getInputShape(kInputTensor),
+                               context->getInputShapeView(kInputTensor),
                                context->getInputBuffer<int32_t>(kBeginTensor),
-                               context->getInputShape(kBeginTensor),
-                               context->getInputBuffer<int32_t>(kSizeTensor),
-                               context->getInputShape(kSizeTensor),
                                context->getOutputBuffer<uint8_t>(kOutputTensor),
-                               context->getOutputShape(kOutputTensor));
+                               context->getOutputShapeView(kOutputTensor));
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
             return evalGeneric(context->getInputBuffer<int8_t>(kInputTensor),
-                               context->getInputShape(kInputTensor),
+                               context->getInputShapeView(kInputTensor),
                                context->getInputBuffer<int32_t>(kBeginTensor),
-                               context->getInputShape(kBeginTensor),
-                               context->getInputBuffer<int32_t>(kSizeTensor),
-                               context->getInputShape(kSizeTensor),
                                context->getOutputBuffer<int8_t>(kOutputTensor),
-                               context->getOutputShape(kOutputTensor));
+                               context->getOutputShapeView(kOutputTensor));
         default:
             NN_RET_CHECK_FAIL() << "Unsupported tensor type for operation " << kOperationName;
     }
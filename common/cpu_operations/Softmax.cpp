@@ -19,9 +19,7 @@
 #include "Softmax.h"
 
 #include <algorithm>
-#include <cfloat>
 #include <limits>
-#include <vector>
 
 #include "OperationResolver.h"
 #include "Tracing.h"
@@ -37,6 +35,7 @@
 #pragma clang diagnostic pop
 
 #include "CpuOperationUtils.h"
+#include "CpuSoftmax.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 namespace android {
@@ -47,153 +46,143 @@ namespace softmax {
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 namespace {
 
-inline bool softmaxSlowFloat32(const float* inputData, const Shape& inputShape, const float beta,
-                               int32_t axis, float* outputData, const Shape& /*outputShape*/) {
-    NNTRACE_TRANS("softmaxFloatSlow32");
-    const uint32_t outerSize = getNumberOfElements(inputShape, 0, axis);
-    const uint32_t axisSize = getSizeOfDimension(inputShape, axis);
-    const uint32_t innerSize =
-            getNumberOfElements(inputShape, axis + 1, getNumberOfDimensions(inputShape));
-    for (uint32_t outer = 0; outer < outerSize; ++outer) {
-        const float* inputBeg = inputData + outer * axisSize * innerSize;
-        const float* inputEnd = inputBeg + axisSize * innerSize;
-        float* outputBeg = outputData + outer * axisSize * innerSize;
-        for (uint32_t inner = 0; inner < innerSize; ++inner, ++inputBeg, ++inputEnd, ++outputBeg) {
-            // Find max
-            float maxValue = -FLT_MAX;
-            for (const float* p = inputBeg; p < inputEnd; p += innerSize) {
-                maxValue = std::max(maxValue, *p);
-            }
-            // Compute sum
-            float sum = 0.0f;
-            for (const float* p = inputBeg; p < inputEnd; p += innerSize) {
-                sum += std::exp((*p - maxValue) * beta);
-            }
-            // Compute result
-            float* pOut = outputBeg;
-            for (const float* p = inputBeg; p < inputEnd; p += innerSize, pOut += innerSize) {
-                *pOut = std::exp((*p - maxValue) * beta) / sum;
-            }
-        }
-    }
-    return true;
+SoftmaxDimensions getSoftmaxDimensions(const Shape& shape, int32_t axis) {
+    return {.outerSize = getNumberOfElements(shape, 0, axis),
+            .axisSize = getSizeOfDimension(shape, axis),
+            .innerSize = getNumberOfElements(shape, axis + 1, getNumberOfDimensions(shape))};
 }
 
-bool softmaxFloat32(const float* inputData, const Shape& inputShape, const float beta, int32_t axis,
-                    float* outputData, const Shape& outputShape) {
-    int32_t ndim = getNumberOfDimensions(inputShape);
-    NN_CHECK(handleNegativeAxis(inputShape, &axis));
-    // TFLite optimized implementation only supports computation along the last axis
-    if (axis == ndim - 1) {
-        NNTRACE_COMP("optimized_ops::Softmax::float");
-        tflite::SoftmaxParams param = {.beta = beta};
-        tflite::optimized_ops::Softmax(param, convertShapeToTflshape(inputShape), inputData,
-                                       convertShapeToTflshape(outputShape), outputData);
-        return true;
-    } else {
-        return softmaxSlowFloat32(inputData, inputShape, beta, axis, outputData, outputShape);
+template <typename T>
+bool softmaxFloatImpl(const T* inputData, const Shape& inputShape, const float beta, int32_t axis,
+                      T* outputData, ScratchWorkspace* workspace) {
+    NNTRACE_TRANS("softmaxFloat");
+    NN_RET_CHECK(handleNegativeAxis(inputShape, &axis));
+    return nn::softmaxFloat(inputData, getSoftmaxDimensions(inputShape, axis), beta,
+                            /*isLogSoftmax=*/false, outputData, workspace);
+}
+
+// The representation chosen for the input to the exp() function is Q5.26.
+// We need to leave extra space since values that we skip might be as large as
+// -32 before multiplying by input_beta_multiplier, and therefore as large as
+// -16 afterwards.  Note that exp(-8) is definitely not insignificant to
+// accumulation, but exp(-16) definitely is.
+constexpr int32_t kScaledDiffIntegerBits = 5;
+constexpr int kAccumulationIntegerBits = 12;
+using FixedPointScaledDiff = gemmlowp::FixedPoint<int32_t, kScaledDiffIntegerBits>;
+using FixedPointAccum = gemmlowp::FixedPoint<int32_t, kAccumulationIntegerBits>;
+using FixedPoint0 = gemmlowp::FixedPoint<int32_t, 0>;
+
+// The exponentials of the 256 possible differences between an 8-bit input and the maximum of its
+// row, indexed by the negated difference, for one value of beta * inputScale.
+struct QuantizedExpTable {
+    int32_t inputMultiplier = 0;
+    int32_t inputLeftShift = 0;
+    float diffMin = 0.0f;
+    bool initialized = false;
+    // exp() of the difference in Q0.31, or 0 if the difference is below diffMin, which then
+    // contributes nothing to the sum and produces the smallest output.
+    int32_t exps[256];
+    // The same values rescaled to the Q12.19 accumulator of the sum of exponentials.
+    int32_t accumulands[256];
+};
+
+// Returns the table for the given parameters, which is recomputed only when they change between
+// executions on the calling thread. The table is only read while the caller is blocked, so it can
+// be shared with the worker threads of parallelFor.
+const QuantizedExpTable& getQuantizedExpTable(int32_t inputMultiplier, int32_t inputLeftShift,
+                                              float diffMin) {
+    thread_local QuantizedExpTable table;
+    if (table.initialized && table.inputMultiplier == inputMultiplier &&
+        table.inputLeftShift == inputLeftShift && table.diffMin == diffMin) {
+        return table;
+    }
+    for (int32_t i = 0; i < 256; ++i) {
+        const int32_t input_diff = -i;
+        FixedPoint0 exp_in_0 = FixedPoint0::Zero();
+        if (input_diff >= diffMin) {
+            const int32_t input_diff_rescaled = tflite::MultiplyByQuantizedMultiplierGreaterThanOne(
+                    input_diff, inputMultiplier, inputLeftShift);
+            exp_in_0 = exp_on_negative_values(FixedPointScaledDiff::FromRaw(input_diff_rescaled));
+        }
+        table.exps[i] = exp_in_0.raw();
+        table.accumulands[i] = gemmlowp::Rescale<kAccumulationIntegerBits>(exp_in_0).raw();
     }
+    table.inputMultiplier = inputMultiplier;
+    table.inputLeftShift = inputLeftShift;
+    table.diffMin = diffMin;
+    table.initialized = true;
+    return table;
 }
 
-bool softmaxFloat16(const _Float16* inputData, const Shape& inputShape, const float beta,
-                    int32_t axis, _Float16* outputData, const Shape& outputShape) {
-    NNTRACE_TRANS("softmaxFloat16");
-    std::vector<float> inputData_float32(getNumberOfElements(inputShape));
-    convertFloat16ToFloat32(inputData, &inputData_float32);
-    std::vector<float> outputData_float32(getNumberOfElements(outputShape));
+// Normalizes the axisSize elements of data that are stride elements apart, with the exponentials
+// looked up in table.
+template <typename T>
+void softmaxQuant8Row(const T* inputData, uint32_t axisSize, uint32_t stride,
+                      const QuantizedExpTable& table, T* outputData) {
+    // Find max
+    T maxValue = std::is_same_v<T, int8_t> ? -128 : 0;
+    for (uint32_t i = 0; i < axisSize; ++i) {
+        maxValue = std::max(maxValue, inputData[i * stride]);
+    }
 
-    softmaxFloat32(inputData_float32.data(), inputShape, beta, axis, outputData_float32.data(),
-                   outputShape);
-    convertFloat32ToFloat16(outputData_float32, outputData);
+    // Compute sum
+    const auto expIndex = [maxValue](T value) {
+        return static_cast<int32_t>(maxValue) - static_cast<int32_t>(value);
+    };
+    FixedPointAccum sum_of_exps = FixedPointAccum::Zero();
+    for (uint32_t i = 0; i < axisSize; ++i) {
+        sum_of_exps = sum_of_exps + FixedPointAccum::FromRaw(
+                                            table.accumulands[expIndex(inputData[i * stride])]);
+    }
 
-    return true;
+    uint32_t fixed_sum_of_exps = static_cast<uint32_t>(sum_of_exps.raw());
+    int32_t headroom_plus_one = tflite::CountLeadingZeros(fixed_sum_of_exps);
+    // This is the number of bits to the left of the binary point above 1.0.
+    // Consider fixed_sum_of_exps=1.25.  In that case shifted_scale=0.8 and
+    // no later adjustment will be needed.
+    int32_t num_bits_over_unit = kAccumulationIntegerBits - headroom_plus_one;
+    int32_t shifted_sum_minus_one = static_cast<int32_t>((fixed_sum_of_exps << headroom_plus_one) -
+                                                         (static_cast<uint32_t>(1) << 31));
+
+    FixedPoint0 shifted_scale = gemmlowp::one_over_one_plus_x_for_x_in_0_1(
+            FixedPoint0::FromRaw(shifted_sum_minus_one));
+
+    // Compute result
+    constexpr int32_t q_min = std::numeric_limits<T>::min();
+    constexpr int32_t q_max = std::numeric_limits<T>::max();
+    for (uint32_t i = 0; i < axisSize; ++i) {
+        const FixedPoint0 exp_in_0 =
+                FixedPoint0::FromRaw(table.exps[expIndex(inputData[i * stride])]);
+        int32_t unsat_output = gemmlowp::RoundingDivideByPOT((shifted_scale * exp_in_0).raw(),
+                                                             num_bits_over_unit + 31 - 8);
+        if (std::is_same_v<T, int8_t>) {
+            unsat_output -= 128;
+        }
+        outputData[i * stride] = static_cast<T>(std::max(std::min(unsat_output, q_max), q_min));
+    }
 }
 
 template <typename T>
-bool softmaxQuant8Impl(const T* inputData, const Shape& inputShape, const float /*beta*/,
-                       int32_t axis, int32_t inputMultiplier, int32_t inputLeftShift, float diffMin,
-                       T* outputData, const Shape& /*outputShape*/) {
+bool softmaxQuant8Impl(const T* inputData, const Shape& inputShape, int32_t axis,
+                       int32_t inputMultiplier, int32_t inputLeftShift, float diffMin,
+                       T* outputData) {
     NNTRACE_TRANS("softmaxQuant8");
-    // The representation chosen for the input to the exp() function is Q5.26.
-    // We need to leave extra space since values that we skip might be as large as
-    // -32 before multiplying by input_beta_multiplier, and therefore as large as
-    // -16 afterwards.  Note that exp(-8) is definitely not insignificant to
-    // accumulation, but exp(-16) definitely is.
-    static const int32_t kScaledDiffIntegerBits = 5;
-    static const int kAccumulationIntegerBits = 12;
-    using FixedPointScaledDiff = gemmlowp::FixedPoint<int32_t, kScaledDiffIntegerBits>;
-    using FixedPointAccum = gemmlowp::FixedPoint<int32_t, kAccumulationIntegerBits>;
-    using FixedPoint0 = gemmlowp::FixedPoint<int32_t, 0>;
-
-    const uint32_t outerSize = getNumberOfElements(inputShape, 0, axis);
-    const uint32_t axisSize = getSizeOfDimension(inputShape, axis);
-    const uint32_t innerSize =
-            getNumberOfElements(inputShape, axis + 1, getNumberOfDimensions(inputShape));
-    for (uint32_t outer = 0; outer < outerSize; ++outer) {
-        const T* inputBeg = inputData + outer * axisSize * innerSize;
-        const T* inputEnd = inputBeg + axisSize * innerSize;
-        T* outputBeg = outputData + outer * axisSize * innerSize;
-        for (uint32_t inner = 0; inner < innerSize; ++inner, ++inputBeg, ++inputEnd, ++outputBeg) {
-            // Find max
-            T maxValue = std::is_same_v<T, int8_t> ? -128 : 0;
-            for (const T* p = inputBeg; p < inputEnd; p += innerSize) {
-                maxValue = std::max(maxValue, *p);
-            }
-
-            // Compute sum
-            FixedPointAccum sum_of_exps = FixedPointAccum::Zero();
-            for (const T* p = inputBeg; p < inputEnd; p += innerSize) {
-                int32_t input_diff = static_cast<int32_t>(*p) - maxValue;
-                if (input_diff >= diffMin) {
-                    const int32_t input_diff_rescaled =
-                            tflite::MultiplyByQuantizedMultiplierGreaterThanOne(
-                                    input_diff, inputMultiplier, inputLeftShift);
-                    const auto scaled_diff_f8 = FixedPointScaledDiff::FromRaw(input_diff_rescaled);
-                    sum_of_exps = sum_of_exps + gemmlowp::Rescale<kAccumulationIntegerBits>(
-                                                        exp_on_negative_values(scaled_diff_f8));
-                }
-            }
-
-            uint32_t fixed_sum_of_exps = static_cast<uint32_t>(sum_of_exps.raw());
-            int32_t headroom_plus_one = tflite::CountLeadingZeros(fixed_sum_of_exps);
-            // This is the number of bits to the left of the binary point above 1.0.
-            // Consider fixed_sum_of_exps=1.25.  In that case shifted_scale=0.8 and
-            // no later adjustment will be needed.
-            int32_t num_bits_over_unit = kAccumulationIntegerBits - headroom_plus_one;
-            int32_t shifted_sum_minus_one = static_cast<int32_t>(
-                    (fixed_sum_of_exps << headroom_plus_one) - (static_cast<uint32_t>(1) << 31));
-
-            FixedPoint0 shifted_scale = gemmlowp::one_over_one_plus_x_for_x_in_0_1(
-                    FixedPoint0::FromRaw(shifted_sum_minus_one));
-
-            // Compute result
-            constexpr int32_t q_min = std::numeric_limits<T>::min();
-            constexpr int32_t q_max = std::numeric_limits<T>::max();
-            T* pOut = outputBeg;
-            for (const T* p = inputBeg; p < inputEnd; p += innerSize, pOut += innerSize) {
-                int32_t input_diff = static_cast<int32_t>(*p) - maxValue;
-                if (input_diff >= diffMin) {
-                    const int32_t input_diff_rescaled =
-                            tflite::MultiplyByQuantizedMultiplierGreaterThanOne(
-                                    input_diff, inputMultiplier, inputLeftShift);
-                    const auto scaled_diff_f8 = FixedPointScaledDiff::FromRaw(input_diff_rescaled);
-
-                    FixedPoint0 exp_in_0 = exp_on_negative_values(scaled_diff_f8);
-                    int32_t unsat_output = gemmlowp::RoundingDivideByPOT(
-                            (shifted_scale * exp_in_0).raw(), num_bits_over_unit + 31 - 8);
-                    if (std::is_same_v<T, int8_t>) {
-                        unsat_output -= 128;
-                    }
-
-                    *pOut = static_cast<T>(std::max(std::min(unsat_output, q_max), q_min));
-
-                } else {
-                    *pOut = std::is_same_v<T, int8_t> ? -128 : 0;
-                }
+    const QuantizedExpTable& table =
+            getQuantizedExpTable(inputMultiplier, inputLeftShift, diffMin);
+    const SoftmaxDimensions dims = getSoftmaxDimensions(inputShape, axis);
+    const uint32_t sliceSize = dims.axisSize * dims.innerSize;
+    auto computeOuterRange = [&](uint32_t outerBegin, uint32_t outerEnd) {
+        for (uint32_t outer = outerBegin; outer < outerEnd; ++outer) {
+            for (uint32_t inner = 0; inner < dims.innerSize; ++inner) {
+                const size_t offset = static_cast<size_t>(outer) * sliceSize + inner;
+                softmaxQuant8Row(inputData + offset, dims.axisSize, dims.innerSize, table,
+                                 outputData + offset);
             }
         }
-    }
-    return true;
+        return true;
+    };
+    return parallelFor(dims.outerSize, getParallelForMinChunkSize(uint64_t{sliceSize}),
+                       computeOuterRange);
 }
 
 template <typename T>
@@ -210,7 +199,6 @@ bool softmaxQuant8(const T* inputData, const Shape& inputShape, const float beta
         return false;
     }
 
-    static const int32_t kScaledDiffIntegerBits = 5;
     const double input_beta_real_multiplier =
             std::min(1.0 * beta * inputShape.scale * (1 << (31 - kScaledDiffIntegerBits)),
                      (1LL << 31) - 1.0);
@@ -222,8 +210,8 @@ bool softmaxQuant8(const T* inputData, const Shape& inputShape, const float beta
     }
     int32_t diffMin = -CalculateInputRadius(kScaledDiffIntegerBits, inputLeftShift);
 
-    return softmaxQuant8Impl(inputData, inputShape, beta, axis, inputMultiplier, inputLeftShift,
-                             diffMin, outputData, outputShape);
+    return softmaxQuant8Impl(inputData, inputShape, axis, inputMultiplier, inputLeftShift, diffMin,
+                             outputData);
 }
 
 }  // namespace
@@ -242,23 +230,23 @@ bool prepare(IOperationExecutionContext* context) {
 
 bool execute(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     int32_t axis = (context->getNumInputs() == kNumInputs)
                            ? context->getInputValue<int32_t>(kAxisScalar)
                            : -1;
     switch (context->getInputType(kInputTensor)) {
         case OperandType::TENSOR_FLOAT16:
-            return softmaxFloat16(context->getInputBuffer<_Float16>(kInputTensor),
-                                  context->getInputShape(kInputTensor),
-                                  context->getInputValue<_Float16>(kBetaScalar), axis,
-                                  context->getOutputBuffer<_Float16>(kOutputTensor),
-                                  context->getOutputShape(kOutputTensor));
+            return softmaxFloatImpl(context->getInputBuffer<_Float16>(kInputTensor),
+                                    context->getInputShape(kInputTensor),
+                                    context->getInputValue<_Float16>(kBetaScalar), axis,
+                                    context->getOutputBuffer<_Float16>(kOutputTensor),
+                                    context->getScratchWorkspace());
         case OperandType::TENSOR_FLOAT32:
-            return softmaxFloat32(context->getInputBuffer<float>(kInputTensor),
-                                  context->getInputShape(kInputTensor),
-                                  context->getInputValue<float>(kBetaScalar), axis,
-                                  context->getOutputBuffer<float>(kOutputTensor),
-                                  context->getOutputShape(kOutputTensor));
+            return softmaxFloatImpl(context->getInputBuffer<float>(kInputTensor),
+                                    context->getInputShape(kInputTensor),
+                                    context->getInputValue<float>(kBetaScalar), axis,
+                                    context->getOutputBuffer<float>(kOutputTensor),
+                                    context->getScratchWorkspace());
         case OperandType::TENSOR_QUANT8_ASYMM:
             return softmaxQuant8(context->getInputBuffer<uint8_t>(kInputTensor),
                                  context->getInputShape(kInputTensor),
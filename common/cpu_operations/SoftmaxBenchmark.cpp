@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "CpuParallelFor.h"
+#include "CpuSoftmax.h"
+#include "OperationsExecutionUtils.h"
+
+namespace android::nn {
+namespace {
+
+// Shapes of NLP models as {outerSize, axisSize, innerSize}: the logits of a language model over
+// its vocabulary, attention scores of 12 heads over 128 tokens, and a softmax over the first of
+// two axes of 128 x 768 activations.
+constexpr int64_t kSoftmaxCases[][3] = {
+        {1, 32000, 1}, {8, 32000, 1}, {1536, 128, 1}, {1, 128, 768}};
+
+SoftmaxDimensions getDimensions(const benchmark::State& state) {
+    return {.outerSize = static_cast<uint32_t>(state.range(0)),
+            .axisSize = static_cast<uint32_t>(state.range(1)),
+            .innerSize = static_cast<uint32_t>(state.range(2))};
+}
+
+template <typename T>
+class SoftmaxFixture {
+   public:
+    explicit SoftmaxFixture(const SoftmaxDimensions& dims) : mDims(dims) {
+        std::mt19937 random(1);
+        std::normal_distribution<float> distribution(0.0f, 4.0f);
+        mInput.resize(static_cast<size_t>(dims.outerSize) * dims.axisSize * dims.innerSize);
+        mOutput.resize(mInput.size());
+        for (T& value : mInput) value = static_cast<T>(distribution(random));
+    }
+
+    bool run(bool isLogSoftmax, ScratchWorkspace* workspace) {
+        const bool success = softmaxFloat(mInput.data(), mDims, 1.0f, isLogSoftmax,
+                                          mOutput.data(), workspace);
+        workspace->reset();
+        return success;
+    }
+
+    // Mirrors the previous implementation of SOFTMAX: the TFLite optimized kernel for contiguous
+    // rows, three Eigen passes over each row, and scalar loops over strided rows otherwise.
+    void runReference() {
+        const uint32_t sliceSize = mDims.axisSize * mDims.innerSize;
+        for (uint32_t outer = 0; outer < mDims.outerSize; ++outer) {
+            const float* in = mInput.data() + static_cast<size_t>(outer) * sliceSize;
+            float* out = mOutput.data() + static_cast<size_t>(outer) * sliceSize;
+            if (mDims.innerSize == 1) {
+                const Eigen::Map<const Eigen::ArrayXf> x(in, mDims.axisSize);
+                Eigen::Map<Eigen::ArrayXf> y(out, mDims.axisSize);
+                y = (x - x.maxCoeff()).exp();
+                y *= 1.0f / y.sum();
+                continue;
+            }
+            for (uint32_t inner = 0; inner < mDims.innerSize; ++inner) {
+                float maxValue = -FLT_MAX;
+                for (uint32_t i = 0; i < mDims.axisSize; ++i) {
+                    maxValue = std::max(maxValue, in[i * mDims.innerSize + inner]);
+                }
+                float sum = 0.0f;
+                for (uint32_t i = 0; i < mDims.axisSize; ++i) {
+                    sum += std::exp(in[i * mDims.innerSize + inner] - maxValue);
+                }
+                for (uint32_t i = 0; i < mDims.axisSize; ++i) {
+                    out[i * mDims.innerSize + inner] =
+                            std::exp(in[i * mDims.innerSize + inner] - maxValue) / sum;
+                }
+            }
+        }
+    }
+
+   private:
+    const SoftmaxDimensions mDims;
+    std::vector<T> mInput;
+    std::vector<T> mOutput;
+};
+
+void setCounters(benchmark::State& state, const SoftmaxDimensions& dims) {
+    state.counters["elements"] = benchmark::Counter(
+            static_cast<double>(dims.outerSize) * dims.axisSize * dims.innerSize,
+            benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// Arguments: the outer, axis and inner sizes and the number of threads.
+template <typename T, bool kIsLogSoftmax>
+void BM_Softmax(benchmark::State& state) {
+    const SoftmaxDimensions dims = getDimensions(state);
+    SoftmaxFixture<T> fixture(dims);
+    setCpuThreadCount(static_cast<uint32_t>(state.range(3)));
+    ScratchWorkspace workspace;
+    for (auto _ : state) {
+        if (!fixture.run(kIsLogSoftmax, &workspace)) {
+            state.SkipWithError("softmaxFloat failed");
+            break;
+        }
+    }
+    setCpuThreadCount(0);
+    setCounters(state, dims);
+}
+
+// Arguments: the outer, axis and inner sizes.
+void BM_SoftmaxReference(benchmark::State& state) {
+    const SoftmaxDimensions dims = getDimensions(state);
+    SoftmaxFixture<float> fixture(dims);
+    for (auto _ : state) {
+        fixture.runReference();
+    }
+    setCounters(state, dims);
+}
+
+void addSoftmaxArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"outer", "axis", "inner", "threads"});
+    for (const auto& [outerSize, axisSize, innerSize] : kSoftmaxCases) {
+        for (int64_t threadCount : {1, 4}) {
+            benchmark->Args({outerSize, axisSize, innerSize, threadCount});
+        }
+    }
+    benchmark->Unit(benchmark::kMicrosecond)->UseRealTime();
+}
+
+void addReferenceArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"outer", "axis", "inner"});
+    for (const auto& [outerSize, axisSize, innerSize] : kSoftmaxCases) {
+        benchmark->Args({outerSize, axisSize, innerSize});
+    }
+    benchmark->Unit(benchmark::kMicrosecond);
+}
+
+BENCHMARK_TEMPLATE(BM_Softmax, float, false)->Apply(addSoftmaxArguments);
+BENCHMARK_TEMPLATE(BM_Softmax, _Float16, false)->Apply(addSoftmaxArguments);
+BENCHMARK_TEMPLATE(BM_Softmax, float, true)->Apply(addSoftmaxArguments);
+BENCHMARK(BM_SoftmaxReference)->Apply(addReferenceArguments);
+
+}  // namespace
+}  // namespace android::nn
@@ -20,6 +20,7 @@
 
 #include <vector>
 
+#include "CpuTensorCopy.h"
 #include "Operations.h"
 #include "OperationsExecutionUtils.h"
 #include "Tracing.h"
@@ -32,23 +33,25 @@ bool splitGeneric(const Scalar* inputData, const Shape& inputShape, int32_t axis
                   const std::vector<Scalar*>* outputDataPtrs,
                   const std::vector<Shape>& outputShapes) {
     NN_CHECK(handleNegativeAxis(inputShape, &axis));
-    int outerSize = 1;
+    uint32_t outerSize = 1;
     for (int i = 0; i < axis; ++i) {
         outerSize *= inputShape.dimensions[i];
     }
-    int baseInnerSize = 1;
+    uint32_t baseInnerSize = 1;
     int concatDimensions = getNumberOfDimensions(inputShape);
     for (int i = axis + 1; i < concatDimensions; ++i) {
         baseInnerSize *= inputShape.dimensions[i];
     }
 
+    const int64_t inputStride = static_cast<int64_t>(inputShape.dimensions[axis]) * baseInnerSize;
     const Scalar* inputPtr = inputData;
-    for (int k = 0; k < outerSize; k++) {
-        for (size_t i = 0; i < outputDataPtrs->size(); ++i) {
-            const int copySize = outputShapes[i].dimensions[axis] * baseInnerSize;
-            memcpy(outputDataPtrs->at(i) + k * copySize, inputPtr, copySize * sizeof(Scalar));
-            inputPtr += copySize;
-        }
+    for (size_t i = 0; i < outputDataPtrs->size(); ++i) {
+        const uint32_t copySize = outputShapes[i].dimensions[axis] * baseInnerSize;
+        NN_RET_CHECK(copyTensor(inputPtr, outputDataPtrs->at(i), sizeof(Scalar),
+                                {{.size = outerSize, .inputStride = inputStride,
+                                  .outputStride = copySize},
+                                 {.size = copySize, .inputStride = 1, .outputStride = 1}}));
+        inputPtr += copySize;
     }
 
     return true;
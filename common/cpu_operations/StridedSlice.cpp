@@ -20,6 +20,8 @@
 
 #include "StridedSlice.h"
 
+#include <cmath>
+#include <utility>
 #include <vector>
 
 #include "OperationResolver.h"
@@ -27,13 +29,8 @@
 #include "Tracing.h"
 
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wunused-parameter"
-#pragma clang diagnostic ignored "-Wsign-compare"
-#include <tensorflow/lite/kernels/internal/reference/legacy_reference_ops.h>
-#pragma clang diagnostic pop
-
 #include "CpuOperationUtils.h"
+#include "CpuTensorCopy.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 namespace android {
@@ -43,41 +40,73 @@ namespace strided_slice {
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 namespace {
 
+// The indexes of an axis of the input that are sliced: size indexes from begin, stride apart.
+struct SlicedAxis {
+    int32_t begin = 0;
+    int32_t stride = 1;
+    uint32_t size = 0;
+    bool isShrunk = false;
+};
+
+bool getSlicedAxes(const Shape& inputShape, const int32_t* beginData, const int32_t* endData,
+                   const int32_t* stridesData, int32_t beginMask, int32_t endMask,
+                   int32_t shrinkAxisMask, std::vector<SlicedAxis>* slicedAxes) {
+    const uint32_t numInputDims = getNumberOfDimensions(inputShape);
+    slicedAxes->resize(numInputDims);
+    for (int32_t idx = 0; idx < static_cast<int32_t>(numInputDims); idx++) {
+        int32_t dim = static_cast<int32_t>(getSizeOfDimension(inputShape, idx));
+        int32_t stride = stridesData[idx];
+        // stride value has to be non-zero
+        NN_OPS_CHECK(stride != 0);
+        bool positiveStride = stride > 0;
+
+        int32_t begin = beginMask & (1 << idx) ? positiveStride ? 0 : dim - 1
+                                               : ClampedIndex(beginData[idx], dim, positiveStride);
+        int32_t end = endMask & (1 << idx) ? positiveStride ? dim : -1
+                                           : ClampedIndex(endData[idx], dim, positiveStride);
+
+        // This is valid for both positive and negative strides
+        int32_t outDim = ceil((end - begin) / static_cast<float>(stride));
+        outDim = outDim < 0 ? 0 : static_cast<uint32_t>(outDim);
+        const bool isShrunk = shrinkAxisMask & (1 << idx);
+        if (isShrunk) {
+            // Only positive stride is allowed on non-range indexing (i.e. shrinkMask is set).
+            NN_RET_CHECK_GT(stride, 0) << "index = " << idx;
+            NN_RET_CHECK_EQ(outDim, 1) << "index = " << idx;
+        }
+        (*slicedAxes)[idx] = {.begin = begin,
+                              .stride = stride,
+                              .size = static_cast<uint32_t>(outDim),
+                              .isShrunk = isShrunk};
+    }
+    return true;
+}
+
 template <typename T>
 bool compute(const T* inputData, const Shape& inputShape, const int32_t* beginData,
              const int32_t* endData, const int32_t* stridesData, int32_t beginMask, int32_t endMask,
-             int32_t shrinkAxisMask, T* outputData, const Shape& outputShape) {
+             int32_t shrinkAxisMask, T* outputData, const Shape& /*outputShape*/) {
     NNTRACE_TRANS("stridedSlice");
-    // This Op only supports 1-4D cases and since we use the reference 4D
-    // implementation, the 1-3D tensors are mapped to 4D.
-    const int kMaxDim = 4;
-
-    std::vector<int> starts;
-    std::vector<int> stops;
-    std::vector<int> strides;
-
-    int32_t numInputDims = static_cast<int32_t>(getNumberOfDimensions(inputShape));
-    for (int32_t idx = numInputDims - 1; idx >= 0; --idx) {
-        starts.emplace_back(beginData[idx]);
-        stops.emplace_back(endData[idx]);
-        strides.emplace_back(stridesData[idx]);
+    std::vector<SlicedAxis> slicedAxes;
+    NN_RET_CHECK(getSlicedAxes(inputShape, beginData, endData, stridesData, beginMask, endMask,
+                               shrinkAxisMask, &slicedAxes));
+
+    // Shrunk axes are copied as axes of size 1, so the output is walked as if they were kept.
+    std::vector<uint32_t> outputDims;
+    for (const SlicedAxis& slicedAxis : slicedAxes) {
+        outputDims.push_back(slicedAxis.size);
     }
-
-    for (int i = numInputDims; i < kMaxDim; i++) {
-        starts.emplace_back(0);
-        stops.emplace_back(1);
-        strides.emplace_back(1);
+    const std::vector<int64_t> inputStrides = getContiguousStrides(inputShape.dimensions);
+    const std::vector<int64_t> outputStrides = getContiguousStrides(outputDims);
+    std::vector<CopyAxis> axes(slicedAxes.size());
+    int64_t inputOffset = 0;
+    for (size_t i = 0; i < slicedAxes.size(); ++i) {
+        inputOffset += slicedAxes[i].begin * inputStrides[i];
+        axes[i] = {.size = slicedAxes[i].size,
+                   .inputStride = slicedAxes[i].stride * inputStrides[i],
+                   .outputStride = outputStrides[i]};
     }
-
-    beginMask = ReverseMaskBits(beginMask, numInputDims);
-    endMask = ReverseMaskBits(endMask, numInputDims);
-    shrinkAxisMask = ReverseMaskBits(shrinkAxisMask, numInputDims);
-
-    tflite::reference_ops::StridedSlice(inputData, convertShapeToDims(inputShape), beginMask,
-                                        endMask, shrinkAxisMask, starts, stops, strides, outputData,
-                                        convertShapeToDims(outputShape));
-
-    return true;
+    return copyTensor(inputData + inputOffset, outputData, sizeof(T), std::move(axes));
 }
 
 template <typename T>
@@ -125,28 +154,13 @@ bool prepare(IOperationExecutionContext* context) {
     const int32_t shrinkAxisMask = context->getInputValue<int32_t>(kShrinkAxisMask);
 
     // Determine size of output tensor and map indices
+    std::vector<SlicedAxis> slicedAxes;
+    NN_RET_CHECK(getSlicedAxes(inputShape, beginData, endData, stridesData, beginMask, endMask,
+                               shrinkAxisMask, &slicedAxes));
     std::vector<uint32_t> outDims;
-    for (int32_t idx = 0; idx < static_cast<int32_t>(numInputDims); idx++) {
-        int32_t dim = static_cast<int32_t>(getSizeOfDimension(inputShape, idx));
-        int32_t stride = stridesData[idx];
-        // stride value has to be non-zero
-        NN_OPS_CHECK(stride != 0);
-        bool positiveStride = stride > 0;
-
-        int32_t begin = beginMask & (1 << idx) ? positiveStride ? 0 : dim - 1
-                                               : ClampedIndex(beginData[idx], dim, positiveStride);
-        int32_t end = endMask & (1 << idx) ? positiveStride ? dim : -1
-                                           : ClampedIndex(endData[idx], dim, positiveStride);
-
-        // This is valid for both positive and negative strides
-        int32_t outDim = ceil((end - begin) / static_cast<float>(stride));
-        outDim = outDim < 0 ? 0 : static_cast<uint32_t>(outDim);
-        if (!(shrinkAxisMask & (1 << idx))) {
-            outDims.push_back(outDim);
-        } else {
-            // Only positive stride is allowed on non-range indexing (i.e. shrinkMask is set).
-            NN_RET_CHECK_GT(stride, 0) << "index = " << idx;
-            NN_RET_CHECK_EQ(outDim, 1) << "index = " << idx;
+    for (const SlicedAxis& slicedAxis : slicedAxes) {
+        if (!slicedAxis.isShrunk) {
+            outDims.push_back(slicedAxis.size);
         }
     }
 
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "CpuParallelFor.h"
+#include "CpuTensorCopy.h"
+
+namespace android::nn {
+namespace {
+
+// An NCHW activation of a convolutional network: 64 channels of 56 x 56.
+constexpr uint32_t kChannels = 64;
+constexpr uint32_t kHeight = 56;
+constexpr uint32_t kWidth = 56;
+constexpr uint32_t kNumElements = kChannels * kHeight * kWidth;
+
+class ActivationFixture {
+   public:
+    ActivationFixture() : mInput(kNumElements), mOutput(kNumElements) {
+        std::iota(mInput.begin(), mInput.end(), 0.0f);
+    }
+
+    // Transposes NCHW to NHWC.
+    bool runTranspose() {
+        return copyTensor(
+                mInput.data(), mOutput.data(), sizeof(float),
+                {{.size = kHeight, .inputStride = kWidth, .outputStride = kWidth * kChannels},
+                 {.size = kWidth, .inputStride = 1, .outputStride = kChannels},
+                 {.size = kChannels, .inputStride = kHeight * kWidth, .outputStride = 1}});
+    }
+
+    // Mirrors the previous implementation of TRANSPOSE, the TFLite reference kernel, which
+    // computed the offsets of every element from its index in each tensor.
+    void runTransposeReference() {
+        uint32_t outputIndex[4];
+        uint32_t inputIndex[4];
+        for (outputIndex[0] = 0; outputIndex[0] < mOutputDims[0]; ++outputIndex[0]) {
+            for (outputIndex[1] = 0; outputIndex[1] < mOutputDims[1]; ++outputIndex[1]) {
+                for (outputIndex[2] = 0; outputIndex[2] < mOutputDims[2]; ++outputIndex[2]) {
+                    for (outputIndex[3] = 0; outputIndex[3] < mOutputDims[3]; ++outputIndex[3]) {
+                        for (uint32_t k = 0; k < 4; ++k) {
+                            inputIndex[mPerm[k]] = outputIndex[k];
+                        }
+                        mOutput[getOffset(mOutputDims, outputIndex)] =
+                                mInput[getOffset(mInputDims, inputIndex)];
+                    }
+                }
+            }
+        }
+    }
+
+    // Concatenates the channels with themselves along the last axis of NHWC.
+    bool runConcatenation(std::vector<float>* output) {
+        for (uint32_t i = 0; i < 2; ++i) {
+            if (!copyTensor(mInput.data(), output->data() + i * kChannels, sizeof(float),
+                            {{.size = kHeight * kWidth,
+                              .inputStride = kChannels,
+                              .outputStride = 2 * kChannels},
+                             {.size = kChannels, .inputStride = 1, .outputStride = 1}})) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+   private:
+    static uint32_t getOffset(const std::array<uint32_t, 4>& dims, const uint32_t* index) {
+        return ((index[0] * dims[1] + index[1]) * dims[2] + index[2]) * dims[3] + index[3];
+    }
+
+    std::array<uint32_t, 4> mInputDims = {1, kChannels, kHeight, kWidth};
+    std::array<uint32_t, 4> mOutputDims = {1, kHeight, kWidth, kChannels};
+    std::array<uint32_t, 4> mPerm = {0, 2, 3, 1};
+    std::vector<float> mInput;
+    std::vector<float> mOutput;
+};
+
+void setCounters(benchmark::State& state) {
+    state.counters["elements"] =
+            benchmark::Counter(kNumElements, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// Arguments: the number of threads.
+void BM_Transpose(benchmark::State& state) {
+    ActivationFixture fixture;
+    setCpuThreadCount(static_cast<uint32_t>(state.range(0)));
+    for (auto _ : state) {
+        if (!fixture.runTranspose()) {
+            state.SkipWithError("copyTensor failed");
+            break;
+        }
+    }
+    setCpuThreadCount(0);
+    setCounters(state);
+}
+
+void BM_TransposeReference(benchmark::State& state) {
+    ActivationFixture fixture;
+    for (auto _ : state) {
+        fixture.runTransposeReference();
+    }
+    setCounters(state);
+}
+
+// Arguments: the number of threads.
+void BM_Concatenation(benchmark::State& state) {
+    ActivationFixture fixture;
+    std::vector<float> output(2 * kNumElements);
+    setCpuThreadCount(static_cast<uint32_t>(state.range(0)));
+    for (auto _ : state) {
+        if (!fixture.runConcatenation(&output)) {
+            state.SkipWithError("copyTensor failed");
+            break;
+        }
+    }
+    setCpuThreadCount(0);
+    setCounters(state);
+}
+
+BENCHMARK(BM_Transpose)
+        ->ArgName("threads")
+        ->Arg(1)
+        ->Arg(4)
+        ->Unit(benchmark::kMicrosecond)
+        ->UseRealTime();
+BENCHMARK(BM_TransposeReference)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Concatenation)
+        ->ArgName("threads")
+        ->Arg(1)
+        ->Arg(4)
+        ->Unit(benchmark::kMicrosecond)
+        ->UseRealTime();
+
+}  // namespace
+}  // namespace android::nn
@@ -18,9 +18,10 @@
 
 #include "Tile.h"
 
-#include <algorithm>
 #include <utility>
+#include <vector>
 
+#include "CpuTensorCopy.h"
 #include "Tracing.h"
 
 namespace android {
@@ -30,45 +31,22 @@ namespace tile {
 namespace {
 
 template <typename T>
-void CopyMultipleTimes(const T* in_data, int32_t in_size, int32_t multiplier, T* out_data) {
-    for (int i = 0; i < multiplier; ++i) {
-        const T* in_end = in_data + in_size;
-        T* new_out_data = std::copy(in_data, in_end, out_data);
-        in_data = out_data;
-        out_data = new_out_data;
+bool tileImpl(const T* inputData, const Shape& inputShape, const int32_t* multiples, T* outputData,
+              const Shape& outputShape) {
+    const std::vector<int64_t> inputStrides = getContiguousStrides(inputShape.dimensions);
+    const std::vector<int64_t> outputStrides = getContiguousStrides(outputShape.dimensions);
+    // Each output axis is split into the copies of the input along it, which all read the same
+    // input, and the index within a copy.
+    std::vector<CopyAxis> axes;
+    for (size_t i = 0; i < inputShape.dimensions.size(); ++i) {
+        const uint32_t size = inputShape.dimensions[i];
+        axes.push_back({.size = static_cast<uint32_t>(multiples[i]),
+                        .inputStride = 0,
+                        .outputStride = outputStrides[i] * size});
+        axes.push_back(
+                {.size = size, .inputStride = inputStrides[i], .outputStride = outputStrides[i]});
     }
-}
-
-template <typename T, typename M>
-std::pair<int, int> TileOneDimension(const Shape& input_shape, const T* in_data,
-                                     const M* multipliers, T* out_data, int dimension) {
-    const int dimension_size = input_shape.dimensions[dimension];
-    if (static_cast<size_t>(dimension) == input_shape.dimensions.size() - 1) {
-        CopyMultipleTimes(in_data, dimension_size, multipliers[dimension], out_data);
-        return std::make_pair(dimension_size,
-                              dimension_size * static_cast<int>(multipliers[dimension]));
-    }
-    int total_stride_size = 0, total_tiled_stride_size = 0;
-    const T* copy_from_data = in_data;
-    T* copy_to_data = out_data;
-    for (int i = 0; i < dimension_size; ++i) {
-        int stride_size = 0, tiled_stride_size = 0;
-        std::tie(stride_size, tiled_stride_size) = TileOneDimension(
-                input_shape, copy_from_data, multipliers, copy_to_data, dimension + 1);
-        copy_from_data += stride_size;
-        copy_to_data += tiled_stride_size;
-        total_stride_size += stride_size;
-        total_tiled_stride_size += tiled_stride_size;
-    }
-    CopyMultipleTimes(out_data, total_tiled_stride_size, multipliers[dimension] - 1,
-                      out_data + total_tiled_stride_size);
-    return std::make_pair(total_stride_size, total_tiled_stride_size * multipliers[dimension]);
-}
-
-template <typename T>
-void tileImpl(const T* inputData, const Shape& inputShape, const int32_t* multiples, T* outputData,
-              const Shape& /*outputShape*/) {
-    TileOneDimension(inputShape, inputData, multiples, outputData, 0);
+    return copyTensor(inputData, outputData, sizeof(T), std::move(axes));
 }
 
 }  // namespace
@@ -90,12 +68,11 @@ bool prepare(const Shape& input, const int32_t* multiples, const Shape& /*multip
 bool eval(const uint8_t* inputData, const Shape& inputShape, const int32_t* multiples,
           uint8_t* outputData, const Shape& outputShape) {
     NNTRACE_TRANS("tile::eval");
-#define ANDROID_NN_IMPL_TILE(operandType, dataType)                                   \
-    case operandType: {                                                               \
-        NNTRACE_COMP_SWITCH("tileImpl::" #dataType);                                  \
-        tileImpl(reinterpret_cast<const dataType*>(inputData), inputShape, multiples, \
-                 reinterpret_cast<dataType*>(outputData), outputShape);               \
-        return true;                                                                  \
+#define ANDROID_NN_IMPL_TILE(operandType, dataType)                                          \
+    case operandType: {                                                                      \
+        NNTRACE_COMP_SWITCH("tileImpl::" #dataType);                                         \
+        return tileImpl(reinterpret_cast<const dataType*>(inputData), inputShape, multiples, \
+                        reinterpret_cast<dataType*>(outputData), outputShape);               \
     }
 
     switch (inputShape.type) {
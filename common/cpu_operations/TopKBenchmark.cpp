@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "CpuParallelFor.h"
+#include "CpuSelection.h"
+#include "OperationsExecutionUtils.h"
+
+namespace android::nn {
+namespace {
+
+// The logits of a language model over its vocabulary, for each sequence of a beam search.
+constexpr uint32_t kVocabularySize = 32000;
+
+class LogitsFixture {
+   public:
+    LogitsFixture(uint32_t numRows, uint32_t k) : mNumRows(numRows), mK(k) {
+        std::mt19937 random(1);
+        std::normal_distribution<float> distribution(0.0f, 4.0f);
+        mLogits.resize(static_cast<size_t>(numRows) * kVocabularySize);
+        for (float& value : mLogits) value = distribution(random);
+        mValues.resize(static_cast<size_t>(numRows) * k);
+        mIndices.resize(static_cast<size_t>(numRows) * k);
+    }
+
+    bool runTopK(ScratchWorkspace* workspace) {
+        const bool success = topK(mLogits.data(), mNumRows, kVocabularySize, mK, mValues.data(),
+                                  mIndices.data(), workspace);
+        workspace->reset();
+        return success;
+    }
+
+    // Mirrors the previous implementation of TOPK_V2, which partitioned and sorted a copy of
+    // every row.
+    void runTopKReference() {
+        std::vector<std::pair<float, int32_t>> values(kVocabularySize);
+        for (uint32_t row = 0; row < mNumRows; ++row) {
+            const float* in = mLogits.data() + static_cast<size_t>(row) * kVocabularySize;
+            for (uint32_t i = 0; i < kVocabularySize; ++i) {
+                values[i] = std::make_pair(in[i], i);
+            }
+            std::nth_element(values.begin(), values.end() - mK, values.end());
+            std::sort(values.end() - mK, values.end());
+            std::reverse(values.begin(), values.end());
+            for (uint32_t i = 0; i < mK; ++i) {
+                mValues[row * mK + i] = values[i].first;
+                mIndices[row * mK + i] = values[i].second;
+            }
+        }
+    }
+
+    bool runArgMax() {
+        return argExtremum<float, std::greater<float>>(mLogits.data(), mNumRows, kVocabularySize,
+                                                       1, mIndices.data());
+    }
+
+    // Mirrors the previous implementation of ARGMAX, a scalar scan.
+    void runArgMaxReference() {
+        for (uint32_t row = 0; row < mNumRows; ++row) {
+            const float* in = mLogits.data() + static_cast<size_t>(row) * kVocabularySize;
+            float maxValue = in[0];
+            int32_t maxIndex = 0;
+            for (uint32_t i = 1; i < kVocabularySize; ++i) {
+                if (in[i] > maxValue) {
+                    maxValue = in[i];
+                    maxIndex = i;
+                }
+            }
+            mIndices[row] = maxIndex;
+        }
+    }
+
+   private:
+    const uint32_t mNumRows;
+    const uint32_t mK;
+    std::vector<float> mLogits;
+    std::vector<float> mValues;
+    std::vector<int32_t> mIndices;
+};
+
+void setCounters(benchmark::State& state, uint32_t numRows) {
+    state.counters["elements"] =
+            benchmark::Counter(static_cast<double>(numRows) * kVocabularySize,
+                               benchmark::Counter::kIsIterationInvariantRate);
+}
+
+// Arguments: the number of rows, k and the number of threads.
+void BM_TopK(benchmark::State& state) {
+    const auto numRows = static_cast<uint32_t>(state.range(0));
+    LogitsFixture fixture(numRows, static_cast<uint32_t>(state.range(1)));
+    setCpuThreadCount(static_cast<uint32_t>(state.range(2)));
+    ScratchWorkspace workspace;
+    for (auto _ : state) {
+        if (!fixture.runTopK(&workspace)) {
+            state.SkipWithError("topK failed");
+            break;
+        }
+    }
+    setCounters(state, numRows);
+    setCpuThreadCount(0);
+}
+
+// Arguments: the number of rows and k.
+void BM_TopKReference(benchmark::State& state) {
+    const auto numRows = static_cast<uint32_t>(state.range(0));
+    LogitsFixture fixture(numRows, static_cast<uint32_t>(state.range(1)));
+    for (auto _ : state) {
+        fixture.runTopKReference();
+    }
+    setCounters(state, numRows);
+}
+
+// Arguments: the number of rows and the number of threads.
+void BM_ArgMax(benchmark::State& state) {
+    const auto numRows = static_cast<uint32_t>(state.range(0));
+    LogitsFixture fixture(numRows, 1);
+    setCpuThreadCount(static_cast<uint32_t>(state.range(1)));
+    for (auto _ : state) {
+        if (!fixture.runArgMax()) {
+            state.SkipWithError("argExtremum failed");
+            break;
+        }
+    }
+    setCounters(state, numRows);
+    setCpuThreadCount(0);
+}
+
+// Arguments: the number of rows.
+void BM_ArgMaxReference(benchmark::State& state) {
+    const auto numRows = static_cast<uint32_t>(state.range(0));
+    LogitsFixture fixture(numRows, 1);
+    for (auto _ : state) {
+        fixture.runArgMaxReference();
+    }
+    setCounters(state, numRows);
+}
+
+void addTopKArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"rows", "k", "threads"});
+    for (int64_t numRows : {1, 8}) {
+        for (int64_t k : {1, 5, 64, 4096}) {
+            for (int64_t threadCount : {1, 4}) {
+                benchmark->Args({numRows, k, threadCount});
+            }
+        }
+    }
+    benchmark->Unit(benchmark::kMicrosecond)->UseRealTime();
+}
+
+void addTopKReferenceArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"rows", "k"});
+    for (int64_t numRows : {1, 8}) {
+        for (int64_t k : {1, 5, 64, 4096}) {
+            benchmark->Args({numRows, k});
+        }
+    }
+    benchmark->Unit(benchmark::kMicrosecond);
+}
+
+void addArgMaxArguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"rows", "threads"});
+    for (int64_t numRows : {1, 8}) {
+        for (int64_t threadCount : {1, 4}) {
+            benchmark->Args({numRows, threadCount});
+        }
+    }
+    benchmark->Unit(benchmark::kMicrosecond)->UseRealTime();
+}
+
+BENCHMARK(BM_TopK)->Apply(addTopKArguments);
+BENCHMARK(BM_TopKReference)->Apply(addTopKReferenceArguments);
+BENCHMARK(BM_ArgMax)->Apply(addArgMaxArguments);
+BENCHMARK(BM_ArgMaxReference)->ArgName("rows")->Arg(1)->Arg(8)->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+}  // namespace android::nn
@@ -18,41 +18,27 @@
 
 #include "TopK_V2.h"
 
-#include <algorithm>
-#include <utility>
-#include <vector>
-
 #include "OperationResolver.h"
 #include "OperationsExecutionUtils.h"
 
+#ifdef NN_INCLUDE_CPU_IMPLEMENTATION
+#include "CpuSelection.h"
+#endif  // NN_INCLUDE_CPU_IMPLEMENTATION
+
 namespace android {
 namespace nn {
 namespace topk_v2 {
+
+#ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 namespace {
 
 template <typename T>
 bool evalGeneric(const T* inputData, const Shape& inputShape, const int32_t k, T* valuesData,
-                 int32_t* indicesData) {
-    const int rowSize = inputShape.dimensions.back();
-    const int totalSize = getNumberOfElements(inputShape);
-    std::vector<std::pair<T, int32_t>> values(rowSize);
-    T* curOutputValue = valuesData;
-    int32_t* curOutputIndex = indicesData;
-    for (int rowBegin = 0; rowBegin < totalSize; rowBegin += rowSize) {
-        for (int i = 0; i < rowSize; ++i) {
-            values[i] = std::make_pair(inputData[rowBegin + i], i);
-        }
-        std::nth_element(values.begin(), values.begin() + (rowSize - k), values.end());
-        std::sort(values.begin() + (rowSize - k), values.end());
-        std::reverse(values.begin(), values.end());
-        for (int i = 0; i < k; ++i) {
-            *curOutputValue = values[i].first;
-            *curOutputIndex = values[i].second;
-            curOutputValue++;
-            curOutputIndex++;
-        }
-    }
-    return true;
+                 int32_t* indicesData, ScratchWorkspace* workspace) {
+    const uint32_t rowSize = inputShape.dimensions.back();
+    const uint32_t numRows = getNumberOfElements(inputShape) / rowSize;
+    return topK(inputData, numRows, rowSize, static_cast<uint32_t>(k), valuesData, indicesData,
+                workspace);
 }
 
 template <typename T>
@@ -61,7 +47,8 @@ bool executeTyped(IOperationExecutionContext* context) {
                        context->getInputShape(kInputTensor),
                        context->getInputValue<int32_t>(kTopKScalar),
                        context->getOutputBuffer<T>(kOutputValuesTensor),
-                       context->getOutputBuffer<int32_t>(kOutputIndicesTensor));
+                       context->getOutputBuffer<int32_t>(kOutputIndicesTensor),
+                       context->getScratchWorkspace());
 }
 
 }  // namespace
@@ -108,6 +95,7 @@ bool execute(IOperationExecutionContext* context) {
         }
     }
 }
+#endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 }  // namespace topk_v2
 
@@ -24,15 +24,9 @@
 #include "Tracing.h"
 
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wunused-parameter"
-#pragma clang diagnostic ignored "-Wsign-compare"
-#pragma clang diagnostic ignored "-Winvalid-partial-specialization"
-#include <tensorflow/lite/kernels/internal/optimized/legacy_optimized_ops.h>
-#include <tensorflow/lite/kernels/internal/reference/reference_ops.h>
-#pragma clang diagnostic pop
-
-#include "CpuOperationUtils.h"
+#include <utility>
+
+#include "CpuTensorCopy.h"
 #endif  // NN_INCLUDE_CPU_IMPLEMENTATION
 
 namespace android {
@@ -44,29 +38,21 @@ namespace {
 
 template <typename T>
 bool transposeGeneric(const T* inputData, const Shape& inputShape, const int32_t* perm,
-                      const Shape& permShape, T* outputData, const Shape& outputShape) {
+                      T* outputData, const Shape& outputShape) {
     NNTRACE_TRANS("transposeGeneric");
-    // Reverse the permuted axes and convert to 4D due to the way Dims are
-    // constructed.
-    const int32_t kOutputDimensionNum = 4;
-
-    // permData can be NO_VALUE representing a regular 2D matrix transpose
-    int32_t permSize = perm == nullptr ? 2 : static_cast<int32_t>(getSizeOfDimension(permShape, 0));
-    int32_t perm_tmp[2] = {1, 0};
-    if (perm == nullptr) {
-        perm = perm_tmp;
-    }
-    int32_t reversed_perm[kOutputDimensionNum];
-    for (int32_t output_k = 0, input_k = permSize - 1; output_k < permSize; ++output_k, --input_k) {
-        reversed_perm[output_k] = permSize - perm[input_k] - 1;
-    }
-    for (int32_t k = permSize; k < kOutputDimensionNum; ++k) {
-        reversed_perm[k] = k;
+    const uint32_t numDims = getNumberOfDimensions(inputShape);
+    const std::vector<int64_t> inputStrides = getContiguousStrides(inputShape.dimensions);
+    const std::vector<int64_t> outputStrides = getContiguousStrides(outputShape.dimensions);
+    std::vector<CopyAxis> axes(numDims);
+    for (uint32_t i = 0; i < numDims; ++i) {
+        // permData can be NO_VALUE representing a regular 2D matrix transpose
+        const uint32_t inputAxis = perm == nullptr ? numDims - 1 - i : perm[i];
+        axes[i] = {.size = getSizeOfDimension(outputShape, i),
+                   .inputStride = inputStrides[inputAxis],
+                   .outputStride = outputStrides[i]};
     }
-    NNTRACE_COMP_SWITCH("reference_ops::Transpose");
-    tflite::reference_ops::Transpose(inputData, convertShapeToDims(inputShape), outputData,
-                                     convertShapeToDims(outputShape), reversed_perm);
-    return true;
+    NNTRACE_COMP_SWITCH("copyTensor");
+    return copyTensor(inputData, outputData, sizeof(T), std::move(axes));
 }
 
 }  // namespace
@@ -111,35 +97,31 @@ bool prepare(IOperationExecutionContext* context) {
 
 bool execute(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
 
     switch (context->getInputType(kInputTensor)) {
         case OperandType::TENSOR_FLOAT32:
             return transposeGeneric(context->getInputBuffer<float>(kInputTensor),
                                     context->getInputShape(kInputTensor),
                                     context->getInputBuffer<int32_t>(kPermTensor),
-                                    context->getInputShape(kPermTensor),
                                     context->getOutputBuffer<float>(kOutputTensor),
                                     context->getOutputShape(kOutputTensor));
         case OperandType::TENSOR_FLOAT16:
             return transposeGeneric(context->getInputBuffer<_Float16>(kInputTensor),
                                     context->getInputShape(kInputTensor),
                                     context->getInputBuffer<int32_t>(kPermTensor),
-                                    context->getInputShape(kPermTensor),
                                     context->getOutputBuffer<_Float16>(kOutputTensor),
                                     context->getOutputShape(kOutputTensor));
         case OperandType::TENSOR_QUANT8_ASYMM:
             return transposeGeneric(context->getInputBuffer<uint8_t>(kInputTensor),
                                     context->getInputShape(kInputTensor),
                                     context->getInputBuffer<int32_t>(kPermTensor),
-                                    context->getInputShape(kPermTensor),
                                     context->getOutputBuffer<uint8_t>(kOutputTensor),
                                     context->getOutputShape(kOutputTensor));
         case OperandType::TENSOR_QUANT8_ASYMM_SIGNED:
             return transposeGeneric(context->getInputBuffer<int8_t>(kInputTensor),
                                     context->getInputShape(kInputTensor),
                                     context->getInputBuffer<int32_t>(kPermTensor),
-                                    context->getInputShape(kPermTensor),
                                     context->getOutputBuffer<int8_t>(kOutputTensor),
                                     context->getOutputShape(kOutputTensor));
         default:
@@ -43,14 +43,6 @@ namespace transpose_conv_2d {
 #ifdef NN_INCLUDE_CPU_IMPLEMENTATION
 namespace {
 
-// If possible we will use this static buffer for the tensor.
-constexpr size_t kStaticBufferSize = 1605632;
-[[maybe_unused]] char static_scratch_buffer[kStaticBufferSize];
-
-// executionMutex is used to protect concurrent access of the static_scratch_buffer.
-// std::mutex is safe for pthreads on Android.
-std::mutex executionMutex;
-
 struct TransposeConv2dParam {
     int32_t paddingLeft, paddingRight;
     int32_t paddingTop, paddingBottom;
@@ -70,8 +62,8 @@ struct TransposeConv2dParam {
             Shape filterShape = context->getInputShape(kFilterTensor);
             int32_t filterWidth = getSizeOfDimension(filterShape, 2);
             int32_t filterHeight = getSizeOfDimension(filterShape, 1);
-            NN_RET_CHECK_EQ(getNumberOfDimensions(context->getInputShape(3)), 1u);
-            NN_RET_CHECK_EQ(getSizeOfDimension(context->getInputShape(3), 0), 4u);
+            NN_RET_CHECK_EQ(getNumberOfDimensions(context->getInputShapeView(3)), 1u);
+            NN_RET_CHECK_EQ(getSizeOfDimension(context->getInputShapeView(3), 0), 4u);
             const int32_t* outputShapeData = context->getInputBuffer<int32_t>(3);
             int32_t outputWidth = useNchw ? outputShapeData[3] : outputShapeData[2];
             int32_t outputHeight = useNchw ? outputShapeData[2] : outputShapeData[1];
@@ -122,7 +114,7 @@ struct TransposeConv2dParam {
 bool transposeConvNhwc(const float* inputData, const Shape& inputShape, const float* filterData,
                        const Shape& filterShape, const float* biasData, const Shape& /*biasShape*/,
                        const TransposeConv2dParam& param, float* outputData,
-                       const Shape& outputShape) {
+                       const Shape& outputShape, ScratchWorkspace* /*workspace*/) {
     NNTRACE_TRANS("transposeConvFloat32");
     ANDROID_NN_TRANSPOSE_CONV_PARAMETERS
 
@@ -178,22 +170,16 @@ bool transposeConvNhwc(const float* inputData, const Shape& inputShape, const fl
 template <typename T>
 bool transposeConvNhwc(const T* inputData, const Shape& inputShape, const T* filterData,
                        const Shape& filterShape, const int32_t* biasData, const Shape& biasShape,
-                       const TransposeConv2dParam& param, T* outputData, const Shape& outputShape) {
+                       const TransposeConv2dParam& param, T* outputData, const Shape& outputShape,
+                       ScratchWorkspace* workspace) {
     NNTRACE_TRANS("transposeConvQuant8");
     ANDROID_NN_TRANSPOSE_CONV_PARAMETERS
 
-    int32_t* tempBuffer = nullptr;
-    std::unique_ptr<int32_t[]> bufferGuard;
     uint32_t tempBufferByteSize = getNumberOfElements(outputShape) * sizeof(int32_t);
-    if (tempBufferByteSize <= kStaticBufferSize) {
-        tempBuffer = reinterpret_cast<int32_t*>(static_scratch_buffer);
-    } else {
-        tempBuffer = new (std::nothrow) int32_t[tempBufferByteSize / sizeof(int32_t)];
-        if (tempBuffer == nullptr) {
-            LOG(ERROR) << "ConvTranspose size is too large, not enough memory";
-            return false;
-        }
-        bufferGuard.reset(tempBuffer);
+    int32_t* tempBuffer = workspace->allocate<int32_t>(getNumberOfElements(outputShape));
+    if (tempBuffer == nullptr) {
+        LOG(ERROR) << "ConvTranspose size is too large, not enough memory";
+        return false;
     }
 
     int32_t inputOffset = -inputShape.offset;
@@ -213,8 +199,6 @@ bool transposeConvNhwc(const T* inputData, const Shape& inputShape, const T* fil
     CalculateActivationRange<T>(activation, outputShape, &outputActivationMin,
                                 &outputActivationMax);
 
-    // Prevent concurrent executions that may access the scratch buffer
-    std::unique_lock<std::mutex> lock(executionMutex);
     memset(tempBuffer, 0, tempBufferByteSize);
 
     const T* inputPtr = inputData;
@@ -274,21 +258,27 @@ bool transposeConvNhwc(const _Float16* inputData, const Shape& inputShape,
                        const _Float16* filterData, const Shape& filterShape,
                        const _Float16* biasData, const Shape& biasShape,
                        const TransposeConv2dParam& param, _Float16* outputData,
-                       const Shape& outputShape) {
+                       const Shape& outputShape, ScratchWorkspace* workspace) {
     NNTRACE_TRANS("transposeConvFloat16");
-    std::vector<float> inputData_float32(getNumberOfElements(inputShape));
-    std::vector<float> filterData_float32(getNumberOfElements(filterShape));
-    std::vector<float> biasData_float32(getNumberOfElements(biasShape));
-    std::vector<float> outputData_float32(getNumberOfElements(outputShape));
-
-    convertFloat16ToFloat32(inputData, &inputData_float32);
-    convertFloat16ToFloat32(filterData, &filterData_float32);
-    convertFloat16ToFloat32(biasData, &biasData_float32);
-
-    transposeConvNhwc(inputData_float32.data(), inputShape, filterData_float32.data(), filterShape,
-                      biasData_float32.data(), biasShape, param, outputData_float32.data(),
-                      outputShape);
-    convertFloat32ToFloat16(outputData_float32, outputData);
+    const uint32_t inputSize = getNumberOfElements(inputShape);
+    const uint32_t filterSize = getNumberOfElements(filterShape);
+    const uint32_t biasSize = getNumberOfElements(biasShape);
+    const uint32_t outputSize = getNumberOfElements(outputShape);
+    float* inputData_float32 = workspace->allocate<float>(inputSize);
+    float* filterData_float32 = workspace->allocate<float>(filterSize);
+    float* biasData_float32 = workspace->allocate<float>(biasSize);
+    float* outputData_float32 = workspace->allocate<float>(outputSize);
+    NN_RET_CHECK(inputData_float32 != nullptr && filterData_float32 != nullptr &&
+                 biasData_float32 != nullptr && outputData_float32 != nullptr);
+
+    convertFloat16ToFloat32(inputData, inputSize, inputData_float32);
+    convertFloat16ToFloat32(filterData, filterSize, filterData_float32);
+    convertFloat16ToFloat32(biasData, biasSize, biasData_float32);
+
+    transposeConvNhwc(inputData_float32, inputShape, filterData_float32, filterShape,
+                      biasData_float32, biasShape, param, outputData_float32, outputShape,
+                      workspace);
+    convertFloat32ToFloat16(outputData_float32, outputSize, outputData);
 
     return true;
 }
@@ -297,14 +287,14 @@ template <typename T_Input, typename T_Filter, typename T_Bias>
 bool transposeConv(const T_Input* inputData, const Shape& inputShape, const T_Filter* filterData,
                    const Shape& filterShape, const T_Bias* biasData, const Shape& biasShape,
                    const TransposeConv2dParam& param, T_Input* outputData,
-                   const Shape& outputShape) {
-    InputWithLayout<T_Input> input(param.useNchw);
-    OutputWithLayout<T_Input> output(param.useNchw);
+                   const Shape& outputShape, ScratchWorkspace* workspace) {
+    InputWithLayout<T_Input> input(param.useNchw, workspace);
+    OutputWithLayout<T_Input> output(param.useNchw, workspace);
     NN_RET_CHECK(input.initialize(inputData, inputShape));
     NN_RET_CHECK(output.initialize(outputData, outputShape));
     NN_RET_CHECK(transposeConvNhwc(input.getNhwcBuffer(), input.getNhwcShape(), filterData,
                                    filterShape, biasData, biasShape, param, output.getNhwcBuffer(),
-                                   output.getNhwcShape()));
+                                   output.getNhwcShape(), workspace));
     NN_RET_CHECK(output.commit());
     return true;
 }
@@ -314,22 +304,16 @@ bool transposeConvQuant8PerChannelNhwc(const T* inputData, const Shape& inputSha
                                        const int8_t* filterData, const Shape& filterShape,
                                        const float* filterScales, const int32_t* biasData,
                                        const Shape& biasShape, const TransposeConv2dParam& param,
-                                       T* outputData, const Shape& outputShape) {
+                                       T* outputData, const Shape& outputShape,
+                                       ScratchWorkspace* workspace) {
     NNTRACE_TRANS("transposeConvQuant8PerChannel");
     ANDROID_NN_TRANSPOSE_CONV_PARAMETERS
 
-    int32_t* tempBuffer = nullptr;
-    std::unique_ptr<int32_t[]> bufferGuard;
     uint32_t tempBufferByteSize = getNumberOfElements(outputShape) * sizeof(int32_t);
-    if (tempBufferByteSize <= kStaticBufferSize) {
-        tempBuffer = reinterpret_cast<int32_t*>(static_scratch_buffer);
-    } else {
-        tempBuffer = new (std::nothrow) int32_t[tempBufferByteSize / sizeof(int32_t)];
-        if (tempBuffer == nullptr) {
-            LOG(ERROR) << "ConvTranspose size is too large, not enough memory";
-            return false;
-        }
-        bufferGuard.reset(tempBuffer);
+    int32_t* tempBuffer = workspace->allocate<int32_t>(getNumberOfElements(outputShape));
+    if (tempBuffer == nullptr) {
+        LOG(ERROR) << "ConvTranspose size is too large, not enough memory";
+        return false;
     }
 
     int32_t inputOffset = -inputShape.offset;
@@ -355,8 +339,6 @@ bool transposeConvQuant8PerChannelNhwc(const T* inputData, const Shape& inputSha
     CalculateActivationRange<T>(activation, outputShape, &outputActivationMin,
                                 &outputActivationMax);
 
-    // Prevent concurrent executions that may access the scratch buffer
-    std::unique_lock<std::mutex> lock(executionMutex);
     memset(tempBuffer, 0, tempBufferByteSize);
 
     const T* inputPtr = inputData;
@@ -417,14 +399,16 @@ bool transposeConvQuant8PerChannel(const T* inputData, const Shape& inputShape,
                                    const int8_t* filterData, const Shape& filterShape,
                                    const float* filterScales, const int32_t* biasData,
                                    const Shape& biasShape, const TransposeConv2dParam& param,
-                                   T* outputData, const Shape& outputShape) {
-    InputWithLayout<T> input(param.useNchw);
-    OutputWithLayout<T> output(param.useNchw);
+                                   T* outputData, const Shape& outputShape,
+                                   ScratchWorkspace* workspace) {
+    InputWithLayout<T> input(param.useNchw, workspace);
+    OutputWithLayout<T> output(param.useNchw, workspace);
     NN_RET_CHECK(input.initialize(inputData, inputShape));
     NN_RET_CHECK(output.initialize(outputData, outputShape));
     NN_RET_CHECK(transposeConvQuant8PerChannelNhwc(
             input.getNhwcBuffer(), input.getNhwcShape(), filterData, filterShape, filterScales,
-            biasData, biasShape, param, output.getNhwcBuffer(), output.getNhwcShape()));
+            biasData, biasShape, param, output.getNhwcBuffer(), output.getNhwcShape(),
+            workspace));
     NN_RET_CHECK(output.commit());
     return true;
 }
@@ -493,7 +477,7 @@ bool prepare(IOperationExecutionContext* context) {
 
 bool execute(IOperationExecutionContext* context) {
     // Bypass execution in the case of zero-sized input.
-    if (getNumberOfElements(context->getOutputShape(kOutputTensor)) == 0) return true;
+    if (getNumberOfElements(context->getOutputShapeView(kOutputTensor)) == 0) return true;
     TransposeConv2dParam param;
     NN_RET_CHECK(param.initialize(context));
     switch (context->getInputType(kInputTensor)) {
@@ -505,7 +489,8 @@ bool execute(IOperationExecutionContext* context) {
                                  context->getInputBuffer<float>(kBiasTensor),
                                  context->getInputShape(kBiasTensor), param,
                                  context->getOutputBuffer<float>(kOutputTensor),
-                                 context->getOutputShape(kOutputTensor));
+                                 context->getOutputShape(kOutputTensor),
+                                 context->getScratchWorkspace());
         case OperandType::TENSOR_FLOAT16:
             return transposeConv(context->getInputBuffer<_Float16>(kInputTensor),
                                  context->getInputShape(kInputTensor),
@@ -514,7 +499,8 @@ bool execute(IOperationExecutionContext* context) {
                                  context->getInputBuffer<_Float16>(kBiasTensor),
                                  context->getInputShape(kBiasTensor), param,
                                  context->getOutputBuffer<_Float16>(kOutputTensor),
-                                 context->getOutputShape(kOutputTensor));
+                                 context->getOutputShape(kOutputTensor),
+                                 context->getScratchWorkspace());
         case OperandType::TENSOR_QUANT8_ASYMM:
             if (context->getInputType(kFilterTensor) ==
                 OperandType::TENSOR_QUANT8_SYMM_PER_CHANNEL) {
@@ -529,7 +515,8 @@ bool execute(IOperationExecutionContext* context) {
                         context->getInputBuffer<int32_t>(kBiasTensor),
                         context->getInputShape(kBiasTensor), param,
                         context->getOutputBuffer<uint8_t>(kOutputTensor),
-                        context->getOutputShape(kOutputTensor));
+                        context->getOutputShape(kOutputTensor),
+                        context->getScratchWorkspace());
             } else if (context->getInputType(kFilterTensor) == OperandType::TENSOR_QUANT8_ASYMM) {
                 return transposeConv(context->getInputBuffer<uint8_t>(kInputTensor),
                                      context->getInputShape(kInputTensor),
@@ -538,7 +525,8 @@ bool execute(IOperationExecutionContext* context) {
                                      context->getInputBuffer<int32_t>(kBiasTensor),
                                      context->getInputShape(kBiasTensor), param,
                                      context->getOutputBuffer<uint8_t>(kOutputTensor),
-                                     context->getOutputShape(kOutputTensor));
+                                     context->getOutputShape(kOutputTensor),
+                                     context->getScratchWorkspace());
             } else {
                 NN_RET_CHECK_FAIL() << "Unsupported filter type for operation " << kOperationName;
             }
@@ -556,7 +544,8 @@ bool execute(IOperationExecutionContext* context) {
                         context->getInputBuffer<int32_t>(kBiasTensor),
                         context->getInputShape(kBiasTensor), param,
                         context->getOutputBuffer<int8_t>(kOutputTensor),
-                        context->getOutputShape(kOutputTensor));
+                        context->getOutputShape(kOutputTensor),
+                        context->getScratchWorkspace());
             } else if (context->getInputType(kFilterTensor) ==
                        OperandType::TENSOR_QUANT8_ASYMM_SIGNED) {
                 return transposeConv(context->getInputBuffer<int8_t>(kInputTensor),
@@ -566,7 +555,8 @@ bool execute(IOperationExecutionContext* context) {
                                      context->getInputBuffer<int32_t>(kBiasTensor),
                                      context->getInputShape(kBiasTensor), param,
                                      context->getOutputBuffer<int8_t>(kOutputTensor),
-                                     context->getOutputShape(kOutputTensor));
+                                     context->getOutputShape(kOutputTensor),
+                                     context->getScratchWorkspace());
             } else {
                 NN_RET_CHECK_FAIL() << "Unsupported filter type for operation " << kOperationName;
             }
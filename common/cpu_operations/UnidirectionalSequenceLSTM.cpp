@@ -289,8 +289,9 @@ bool prepare(IOperationExecutionContext* context) {
 }
 
 bool execute(IOperationExecutionContext* context) {
-    const auto outputStateSize = getNumberOfElements(context->getInputShape(kOutputStateInTensor));
-    const auto cellStateSize = getNumberOfElements(context->getInputShape(kCellStateInTensor));
+    const auto outputStateSize =
+            getNumberOfElements(context->getInputShapeView(kOutputStateInTensor));
+    const auto cellStateSize = getNumberOfElements(context->getInputShapeView(kCellStateInTensor));
     const bool use_cifg = !hasTensor(context, kInputToInputWeightsTensor);
     const auto scratchSize = use_cifg ? 3 * cellStateSize : 4 * cellStateSize;
     const bool useStateOutTensors = (context->getNumOutputs() == kNumOutputsWithState);
@@ -20,6 +20,8 @@
 #include <android-base/macros.h>
 #include <android-base/thread_annotations.h>
 
+#include <array>
+#include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -30,21 +32,36 @@
 
 #include "CpuExecutor.h"
 #include "LegacyUtils.h"
+#include "SizeClassPool.h"
 #include "nnapi/Types.h"
 #include "nnapi/Validation.h"
 
 namespace android::nn {
 
 // This class manages a CPU buffer allocated on heap and provides validation methods.
+//
+// The initialized state is atomic and the dimensions are only locked if the initial dimensions
+// are not fully specified, so that concurrent executions validating the same buffer do not
+// serialize.
+//
+// The heap buffers are allocated in size classes and returned to a process-wide pool when the
+// ManagedBuffer is destroyed, so that clients that allocate and free device memories repeatedly do
+// not churn the heap.
 class ManagedBuffer {
    public:
     static std::shared_ptr<ManagedBuffer> create(uint32_t size, std::set<PreparedModelRole> roles,
                                                  const Operand& operand);
 
-    // Prefer ManagedBuffer::create.
-    ManagedBuffer(std::unique_ptr<uint8_t[]> buffer, uint32_t size,
+    // Prefer ManagedBuffer::create. "capacity" is the allocated size of "buffer", which is at least
+    // "size". The buffer is released to the pool when the ManagedBuffer is destroyed.
+    ManagedBuffer(std::unique_ptr<uint8_t[]> buffer, uint32_t size, size_t capacity,
                   std::set<PreparedModelRole> roles, const Operand& operand);
 
+    // The statistics of the pool of heap buffers, and a way to free the buffers it caches, such as
+    // when the process is low on memory.
+    static PoolStatistics getPoolStatistics();
+    static void trimPool();
+
     RunTimePoolInfo createRunTimePoolInfo() const {
         return RunTimePoolInfo::createFromExistingBuffer(kBuffer.get(), kSize);
     }
@@ -61,17 +78,33 @@ class ManagedBuffer {
     void setInitialized(bool initialized);
 
    private:
+    // Checks that the dimensions of an input of a request are compatible with the dimensions set
+    // by the last updateDimensions.
+    ErrorStatus validateInputDimensions(const Dimensions& dimensions) const;
+
+    // Releases the buffer to the pool instead of deleting it.
+    struct BufferDeleter {
+        size_t capacity;
+        void operator()(uint8_t* buffer) const;
+    };
+
     mutable std::mutex mMutex;
-    const std::unique_ptr<uint8_t[]> kBuffer;
+    const std::unique_ptr<uint8_t[], BufferDeleter> kBuffer;
     const uint32_t kSize;
     const std::set<PreparedModelRole> kRoles;
     const OperandType kOperandType;
     const Dimensions kInitialDimensions;
+    // If the initial dimensions are fully specified, updateDimensions cannot change them and
+    // mUpdatedDimensions is never read.
+    const bool kHasFixedDimensions;
     Dimensions mUpdatedDimensions GUARDED_BY(mMutex);
-    bool mInitialized GUARDED_BY(mMutex) = false;
+    std::atomic<bool> mInitialized = false;
 };
 
 // Keep track of all ManagedBuffers and assign each with a unique token.
+//
+// get() is lock-free, so that concurrent executions looking up their memory domain tokens do not
+// serialize. add() and free() are serialized by a mutex.
 class BufferTracker : public std::enable_shared_from_this<BufferTracker> {
     DISALLOW_COPY_AND_ASSIGN(BufferTracker);
 
@@ -98,21 +131,40 @@ class BufferTracker : public std::enable_shared_from_this<BufferTracker> {
 
     // Prefer BufferTracker::create.
     BufferTracker();
+    ~BufferTracker();
 
     std::unique_ptr<Token> add(std::shared_ptr<ManagedBuffer> buffer);
     std::shared_ptr<ManagedBuffer> get(Request::MemoryDomainToken token) const;
 
    private:
+    // An entry of the token table. A reader announces itself in numReaders before loading buffer
+    // and only copies owner if buffer is set. free() clears buffer and waits for the readers to
+    // leave before it releases owner, and add() only assigns owner while buffer is null, so owner
+    // is never written while it is being copied.
+    struct alignas(64) Slot {
+        std::atomic<ManagedBuffer*> buffer = nullptr;
+        std::atomic<uint32_t> numReaders = 0;
+        std::shared_ptr<ManagedBuffer> owner;
+    };
+
+    // The slots are allocated in segments that are never moved or freed before the tracker, so
+    // that get() can access them without locking.
+    static constexpr uint32_t kSegmentSize = 1024;
+    static constexpr uint32_t kMaxSegments = 1024;
+
+    // Returns nullptr if the segment of the token is not allocated.
+    Slot* getSlot(uint32_t index) const;
+
     void free(Request::MemoryDomainToken token);
 
     mutable std::mutex mMutex;
     std::stack<Request::MemoryDomainToken, std::vector<Request::MemoryDomainToken>> mFreeTokens
             GUARDED_BY(mMutex);
 
-    // Since the tokens are allocated in a non-sparse way, we use a vector to represent the mapping.
-    // The index of the vector is the token. When the token gets freed, the corresponding entry is
-    // set to nullptr. mTokenToBuffers[0] is always set to nullptr because 0 is an invalid token.
-    std::vector<std::shared_ptr<ManagedBuffer>> mTokenToBuffers GUARDED_BY(mMutex);
+    // The tokens are allocated in a non-sparse way, so the token is the index of its slot. Slot 0
+    // is never set because 0 is an invalid token.
+    uint32_t mNumTokens GUARDED_BY(mMutex) = 1;
+    std::array<std::atomic<Slot*>, kMaxSegments> mSegments = {};
 };
 
 }  // namespace android::nn
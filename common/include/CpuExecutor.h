@@ -18,11 +18,15 @@
 #define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_EXECUTOR_H
 
 #include <android-base/macros.h>
+#include <android-base/thread_annotations.h>
 #include <nnapi/Types.h>
 
 #include <algorithm>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
 #include <vector>
 
 #include "ControlFlow.h"
@@ -73,6 +77,14 @@ struct RunTimeOperandInfo {
 
     Operand::ExtraParams extraParams;
 
+    // A buffer that the executor allocated for an earlier value of the operand, such as the one
+    // of the previous iteration of a WHILE loop.  If buffer is null when the operand is computed,
+    // setInfoAndAllocateIfNeeded uses the spare buffer if it is large enough, and frees it
+    // otherwise.
+    uint8_t* spareBuffer = nullptr;
+    // The length of the spare buffer.
+    uint32_t spareLength = 0;
+
     Shape shape() const {
         return {
                 .type = type,
@@ -83,6 +95,11 @@ struct RunTimeOperandInfo {
         };
     }
 
+    // Same as shape() but does not copy the dimensions.
+    ShapeView shapeView() const {
+        return ShapeView(type, dimensions, scale, zeroPoint, extraParams);
+    }
+
     bool isSufficient() const {
         if (isExtension(type)) {
             // We don't know sizes of extension types.
@@ -126,6 +143,53 @@ bool setRunTimePoolInfosFromCanonicalMemories(std::vector<RunTimePoolInfo>* pool
 bool setRunTimePoolInfosFromMemoryPools(std::vector<RunTimePoolInfo>* poolInfos,
                                         const std::vector<Request::MemoryPool>& pools);
 
+// What CpuExecutor recorded about one execution of an operation when profiling is enabled.
+struct OperationProfile {
+    struct Operand {
+        OperandType type{};
+        // The dimensions at the end of the operation, with the unspecified ones deduced.
+        std::vector<uint32_t> dimensions;
+        bool isOmitted = false;
+    };
+
+    OperationType type{};
+    std::vector<Operand> inputs;
+    std::vector<Operand> outputs;
+    // The number of control flow operations that the operation is nested in.
+    uint32_t depth = 0;
+    // When the operation started, relative to the start of CpuExecutor::run, and how long it took.
+    // The time of an IF or WHILE operation includes the operations of its subgraphs.
+    Duration startTime{};
+    Duration duration{};
+    // The sizes of the input and output tensors, which the operation reads and writes at least
+    // once.
+    uint64_t bytesRead = 0;
+    uint64_t bytesWritten = 0;
+    // The buffers that the executor allocated for the outputs and the scratch memory of the
+    // operation. Allocations made by the kernels themselves are not counted.
+    uint32_t numAllocations = 0;
+};
+
+// Returns the profiles as a trace in the Chrome trace event format, which chrome://tracing and
+// Perfetto can open.
+std::string toChromeTrace(const std::vector<OperationProfile>& profiles);
+
+// Keeps the scratch workspaces of finished executions so that later executions reuse their
+// memory instead of growing a new workspace. A prepared model owns one pool, which holds as many
+// workspaces as it had concurrent executions. Thread-safe.
+class ScratchWorkspacePool {
+   public:
+    // Returns a workspace of a finished execution, or a new one if there is none.
+    std::unique_ptr<ScratchWorkspace> acquire();
+
+    // Returns a workspace acquired from this pool.
+    void release(std::unique_ptr<ScratchWorkspace> workspace);
+
+   private:
+    std::mutex mMutex;
+    std::vector<std::unique_ptr<ScratchWorkspace>> mWorkspaces GUARDED_BY(mMutex);
+};
+
 // This class is used to execute a model on the CPU.
 class CpuExecutor {
    public:
@@ -158,6 +222,36 @@ class CpuExecutor {
     void setDeadline(const TimePoint& deadline) { mDeadline = deadline; }
     void setLoopTimeout(uint64_t duration) { mLoopTimeoutDuration = duration; }
 
+    // Makes run() take its scratch workspace from the pool and return it afterwards. Without a
+    // pool, the executor owns a workspace that only later runs of the same executor reuse. The
+    // pool must outlive the executor.
+    void setScratchWorkspacePool(ScratchWorkspacePool* pool) { mScratchWorkspacePool = pool; }
+
+    // The default number of profiles that run() records at most. WHILE loops can execute their
+    // operations any number of times, and the profiles of further operations are not recorded.
+    static constexpr size_t kDefaultMaxOperationProfiles = 1 << 14;
+
+    // Makes run() record an OperationProfile for every operation it executes, including the
+    // operations of control flow subgraphs, until maxOperationProfiles profiles are recorded.
+    // Profiling is disabled by default.
+    void setProfiling(bool enabled, size_t maxOperationProfiles = kDefaultMaxOperationProfiles) {
+        mProfiling = enabled;
+        mMaxOperationProfiles = maxOperationProfiles;
+    }
+
+    // Returns the profiles of the operations executed by run(), in the order they started.
+    const std::vector<OperationProfile>& getOperationProfiles() const {
+        CHECK(mFinished) << "getOperationProfiles() called by an unfinished CpuExecutor.";
+        return mOperationProfiles;
+    }
+
+    // Returns the number of operations executed by run() whose profiles were not recorded because
+    // the maximum number of profiles had been reached.
+    uint64_t getNumUnprofiledOperations() const {
+        CHECK(mFinished) << "getNumUnprofiledOperations() called by an unfinished CpuExecutor.";
+        return mNumUnprofiledOperations;
+    }
+
    private:
     // Creates runtime info from what's in the model.
     std::vector<RunTimeOperandInfo> initializeRunTimeInfo(const Model::Subgraph& subgraph);
@@ -169,11 +263,27 @@ class CpuExecutor {
                             RunTimeOperandInfo* operands);
     // Runs one subgraph.
     int executeSubgraph(const Model::Subgraph& subgraph, RunTimeOperandInfo* operands);
+    // Runs one operation of the graph, recording its profile.
+    int executeOperationWithProfiling(const Operation& operation, RunTimeOperandInfo* operands);
     // Runs one operation of the graph.
     int executeOperation(const Operation& operation, RunTimeOperandInfo* operands);
     int executeIfOperation(const Operation& operation, RunTimeOperandInfo* operands);
     int executeWhileOperation(const Operation& operation, RunTimeOperandInfo* operands);
 
+    // The runtime info of a subgraph that WHILE loops execute, which does not change from one
+    // loop to the next.
+    struct LoopSubgraphInfo {
+        std::vector<RunTimeOperandInfo> operands;
+        // The temporaries whose size is only known at execution time.
+        std::vector<uint32_t> dynamicTemporaries;
+    };
+    // Returns the info prepared for the subgraph by an earlier loop of the same run(), or prepares
+    // it if there is none or a loop that is still running holds it.
+    std::unique_ptr<LoopSubgraphInfo> acquireLoopSubgraphInfo(const Model::Subgraph& subgraph);
+    // Keeps the info for the next loop over the subgraph. Its temporaries must have been freed.
+    void releaseLoopSubgraphInfo(const Model::Subgraph& subgraph,
+                                 std::unique_ptr<LoopSubgraphInfo> info);
+
     void setOutputShapes(const std::vector<uint32_t>& outputIndexes,
                          const std::vector<RunTimeOperandInfo>& operands);
 
@@ -182,6 +292,9 @@ class CpuExecutor {
     const uint8_t* mModelOperandValues = nullptr;
     const std::vector<RunTimePoolInfo>* mModelPoolInfos = nullptr;
     const std::vector<Model::Subgraph>* mReferencedSubgraphs = nullptr;
+    // The info of the subgraphs executed by WHILE loops so far. Only valid while run() is being
+    // executed.
+    std::map<const Model::Subgraph*, std::unique_ptr<LoopSubgraphInfo>> mLoopSubgraphInfos;
 
     // The output operand shapes returning to the runtime.
     std::vector<OutputShape> mOutputShapes;
@@ -198,6 +311,20 @@ class CpuExecutor {
     // WHILE loop.
     uint64_t mLoopTimeoutDuration = operation_while::kTimeoutNsDefault;
 
+    // Temporary memory for the operation being executed, reset after each
+    // operation. Taken from mScratchWorkspacePool, if set, for the duration of run().
+    std::unique_ptr<ScratchWorkspace> mScratchWorkspace;
+    ScratchWorkspacePool* mScratchWorkspacePool = nullptr;
+
+    // Whether run() records mOperationProfiles.
+    bool mProfiling = false;
+    std::vector<OperationProfile> mOperationProfiles;
+    size_t mMaxOperationProfiles = kDefaultMaxOperationProfiles;
+    uint64_t mNumUnprofiledOperations = 0;
+    // The start of run() and the current nesting of control flow operations, while profiling.
+    TimePoint mProfilingStart;
+    uint32_t mProfilingDepth = 0;
+
     [[maybe_unused]] const IOperationResolver* mOperationResolver;
 };
 
@@ -273,11 +400,11 @@ inline int NumOutputs(const Operation& operation) {
 }
 
 inline size_t NumDimensions(const RunTimeOperandInfo* operand) {
-    return operand->shape().dimensions.size();
+    return operand->dimensions.size();
 }
 
 inline uint32_t SizeOfDimension(const RunTimeOperandInfo* operand, int i) {
-    return operand->shape().dimensions[i];
+    return operand->dimensions[i];
 }
 
 inline RunTimeOperandInfo* GetInput(const Operation& operation, RunTimeOperandInfo* operands,
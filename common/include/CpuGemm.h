@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_GEMM_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_GEMM_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "CpuParallelFor.h"
+#include "OperationsExecutionUtils.h"
+
+namespace android::nn {
+
+// One operand of batchGemm. Element (row, column) of the matrix of batch b is
+// data[batchOffsets[b] + row * rowStride + column * columnStride], so that transposed matrices
+// and matrices shared by several batches are read in place.
+template <typename T>
+struct GemmInput {
+    const T* data = nullptr;
+    const size_t* batchOffsets = nullptr;
+    size_t rowStride = 0;
+    size_t columnStride = 0;
+    // Subtracted from every element, for quantized operands.
+    int32_t zeroPoint = 0;
+};
+
+struct GemmDimensions {
+    uint32_t batches = 0;
+    // The output of each batch is a rows x columns matrix, the sum of depth products.
+    uint32_t rows = 0;
+    uint32_t depth = 0;
+    uint32_t columns = 0;
+};
+
+namespace gemm_internal {
+
+// The micro-kernel computes a kRowsPerPanel x kColumnsPerPanel tile of the output, which is small
+// enough for its accumulators to stay in vector registers.
+constexpr uint32_t kRowsPerPanel = 4;
+constexpr uint32_t kColumnsPerPanel = 8;
+// Blocks of the operands are sized so that a block of the LHS stays in L1 and a block of the
+// packed RHS in L2 while they are multiplied.
+constexpr uint32_t kRowsPerBlock = 64;
+constexpr uint32_t kDepthPerBlock = 256;
+constexpr uint32_t kColumnsPerBlock = 512;
+
+inline uint32_t roundUp(uint32_t value, uint32_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// Returns a buffer for count elements, allocated from workspace if it is not null and held by
+// storage otherwise.
+template <typename T>
+T* allocate(size_t count, ScratchWorkspace* workspace, std::vector<T>* storage) {
+    if (workspace != nullptr) {
+        return workspace->allocate<T>(count);
+    }
+    storage->resize(count);
+    return storage->data();
+}
+
+// Packs the given panel of the RHS of a batch, that is its columns [panel * kColumnsPerPanel,
+// (panel + 1) * kColumnsPerPanel), into packed, the packed RHS of the batch. The panel stores its
+// depth rows one after the other, padded with zeros past the last column.
+template <typename AccT, typename T>
+void packRhsPanel(const GemmDimensions& dims, const GemmInput<T>& rhs, const T* data,
+                  uint32_t panel, AccT* packed) {
+    const uint32_t column0 = panel * kColumnsPerPanel;
+    const uint32_t numColumns = std::min(kColumnsPerPanel, dims.columns - column0);
+    AccT* out = packed + static_cast<size_t>(panel) * dims.depth * kColumnsPerPanel;
+    for (uint32_t k = 0; k < dims.depth; ++k) {
+        const T* in = data + k * rhs.rowStride + column0 * rhs.columnStride;
+        for (uint32_t c = 0; c < numColumns; ++c) {
+            out[c] = static_cast<AccT>(in[c * rhs.columnStride]) - rhs.zeroPoint;
+        }
+        std::fill(out + numColumns, out + kColumnsPerPanel, AccT(0));
+        out += kColumnsPerPanel;
+    }
+}
+
+// Packs rows [row0, row0 + numRows) and depth [k0, k0 + depth) of the LHS of a batch into panels
+// of kRowsPerPanel rows, storing the rows of each depth index next to each other.
+template <typename AccT, typename T>
+void packLhs(const GemmInput<T>& lhs, const T* data, uint32_t row0, uint32_t numRows, uint32_t k0,
+             uint32_t depth, AccT* packed) {
+    for (uint32_t panelRow = 0; panelRow < numRows; panelRow += kRowsPerPanel) {
+        const uint32_t panelRows = std::min(kRowsPerPanel, numRows - panelRow);
+        for (uint32_t k = 0; k < depth; ++k) {
+            const T* in = data + (row0 + panelRow) * lhs.rowStride + (k0 + k) * lhs.columnStride;
+            for (uint32_t r = 0; r < panelRows; ++r) {
+                packed[r] = static_cast<AccT>(in[r * lhs.rowStride]) - lhs.zeroPoint;
+            }
+            std::fill(packed + panelRows, packed + kRowsPerPanel, AccT(0));
+            packed += kRowsPerPanel;
+        }
+    }
+}
+
+// Adds the product of a packed LHS panel and a packed RHS panel to a tile of acc.
+template <typename AccT>
+void multiplyPanels(uint32_t depth, const AccT* lhs, const AccT* rhs, AccT* acc,
+                    uint32_t accStride) {
+    AccT sums[kRowsPerPanel][kColumnsPerPanel] = {};
+    for (uint32_t k = 0; k < depth; ++k) {
+        for (uint32_t r = 0; r < kRowsPerPanel; ++r) {
+            const AccT lhsValue = lhs[r];
+            for (uint32_t c = 0; c < kColumnsPerPanel; ++c) {
+                sums[r][c] += lhsValue * rhs[c];
+            }
+        }
+        lhs += kRowsPerPanel;
+        rhs += kColumnsPerPanel;
+    }
+    for (uint32_t r = 0; r < kRowsPerPanel; ++r) {
+        for (uint32_t c = 0; c < kColumnsPerPanel; ++c) {
+            acc[r * accStride + c] += sums[r][c];
+        }
+    }
+}
+
+}  // namespace gemm_internal
+
+/**
+ * @brief Computes output[b] = lhs[b] x rhs[b] for every batch b, where lhs[b] is a rows x depth
+ * matrix and rhs[b] a depth x columns matrix.
+ *
+ * The operands are read through their strides and packed into contiguous panels, converted to
+ * AccT and with their zero point subtracted, so that the inner loop reads memory sequentially
+ * whatever their orientation. Each distinct RHS is packed once, before the work is split, into a
+ * buffer shared by all the batches that use it. The LHS is packed block by block by the task that
+ * multiplies it. Products are accumulated in AccT and outputStage(AccT) converts each sum to an
+ * element of the row-major output. The work is split across batches and blocks of rows with
+ * parallelFor.
+ *
+ * @param dims The dimensions of the matrices.
+ * @param lhs The left-hand side operand.
+ * @param rhs The right-hand side operand.
+ * @param output The batches x rows x columns output.
+ * @param outputStage Converts an accumulated sum to an output element.
+ * @param workspace Provides the packing buffers, or nullptr to allocate them on the heap.
+ * @return false if parallelFor failed or the packing buffers could not be allocated.
+ */
+template <typename AccT, typename T, typename OutT, typename OutputStage>
+bool batchGemm(const GemmDimensions& dims, const GemmInput<T>& lhs, const GemmInput<T>& rhs,
+               OutT* output, const OutputStage& outputStage, ScratchWorkspace* workspace) {
+    using namespace gemm_internal;
+    if (dims.batches == 0 || dims.rows == 0 || dims.columns == 0) {
+        return true;
+    }
+    const uint32_t paddedColumns = roundUp(dims.columns, kColumnsPerPanel);
+    const uint32_t rowsPerBlock = std::min(kRowsPerBlock, roundUp(dims.rows, kRowsPerPanel));
+    const uint32_t depthPerBlock = std::max(std::min(kDepthPerBlock, dims.depth), 1u);
+    const uint32_t columnsPerBlock = std::min(kColumnsPerBlock, paddedColumns);
+    const uint32_t numRowBlocks = (dims.rows + rowsPerBlock - 1) / rowsPerBlock;
+    const uint32_t numPanels = paddedColumns / kColumnsPerPanel;
+    const size_t packedRhsSize = static_cast<size_t>(dims.depth) * paddedColumns;
+
+    // Batches that share their RHS share its packed copy.
+    std::vector<uint32_t> packedRhsIndices(dims.batches);
+    std::vector<size_t> distinctRhsOffsets;
+    std::unordered_map<size_t, uint32_t> rhsOffsetToIndex;
+    for (uint32_t batch = 0; batch < dims.batches; ++batch) {
+        const auto [it, inserted] =
+                rhsOffsetToIndex.emplace(rhs.batchOffsets[batch], distinctRhsOffsets.size());
+        if (inserted) {
+            distinctRhsOffsets.push_back(rhs.batchOffsets[batch]);
+        }
+        packedRhsIndices[batch] = it->second;
+    }
+    std::vector<AccT> rhsStorage;
+    AccT* packedRhs = allocate<AccT>(distinctRhsOffsets.size() * packedRhsSize, workspace,
+                                     &rhsStorage);
+    if (packedRhs == nullptr) {
+        return false;
+    }
+    auto packRhsPanels = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t task = begin; task < end; ++task) {
+            const uint32_t index = task / numPanels;
+            packRhsPanel(dims, rhs, rhs.data + distinctRhsOffsets[index], task % numPanels,
+                         packedRhs + index * packedRhsSize);
+        }
+        return true;
+    };
+    const uint64_t costPerPanel = static_cast<uint64_t>(dims.depth) * kColumnsPerPanel;
+    if (!parallelFor(static_cast<uint32_t>(distinctRhsOffsets.size()) * numPanels,
+                     getParallelForMinChunkSize(costPerPanel), packRhsPanels)) {
+        return false;
+    }
+
+    const uint64_t costPerTask = static_cast<uint64_t>(rowsPerBlock) * dims.depth * dims.columns;
+    auto computeTasks = [&](uint32_t begin, uint32_t end) {
+        std::vector<AccT> lhsStorage, accStorage;
+        AccT* packedLhs = allocate<AccT>(static_cast<size_t>(rowsPerBlock) * depthPerBlock,
+                                         workspace, &lhsStorage);
+        AccT* acc = allocate<AccT>(static_cast<size_t>(rowsPerBlock) * columnsPerBlock, workspace,
+                                   &accStorage);
+        if (packedLhs == nullptr || acc == nullptr) {
+            return false;
+        }
+        for (uint32_t task = begin; task < end; ++task) {
+            const uint32_t batch = task / numRowBlocks;
+            const uint32_t row0 = task % numRowBlocks * rowsPerBlock;
+            const uint32_t numRows = std::min(rowsPerBlock, dims.rows - row0);
+            const uint32_t paddedRows = roundUp(numRows, kRowsPerPanel);
+            const T* lhsData = lhs.data + lhs.batchOffsets[batch];
+            const AccT* batchRhs = packedRhs + packedRhsIndices[batch] * packedRhsSize;
+            OutT* out = output + (static_cast<size_t>(batch) * dims.rows + row0) * dims.columns;
+            for (uint32_t column0 = 0; column0 < paddedColumns; column0 += columnsPerBlock) {
+                const uint32_t blockColumns = std::min(columnsPerBlock, paddedColumns - column0);
+                std::fill(acc, acc + static_cast<size_t>(paddedRows) * columnsPerBlock, AccT(0));
+                for (uint32_t k0 = 0; k0 < dims.depth; k0 += depthPerBlock) {
+                    const uint32_t depth = std::min(depthPerBlock, dims.depth - k0);
+                    packLhs(lhs, lhsData, row0, numRows, k0, depth, packedLhs);
+                    for (uint32_t c = 0; c < blockColumns; c += kColumnsPerPanel) {
+                        const AccT* rhsPanel = batchRhs +
+                                               static_cast<size_t>(column0 + c) * dims.depth +
+                                               static_cast<size_t>(k0) * kColumnsPerPanel;
+                        for (uint32_t r = 0; r < paddedRows; r += kRowsPerPanel) {
+                            multiplyPanels(depth, packedLhs + r * depth, rhsPanel,
+                                           acc + r * columnsPerBlock + c, columnsPerBlock);
+                        }
+                    }
+                }
+                const uint32_t numColumns = std::min(blockColumns, dims.columns - column0);
+                for (uint32_t r = 0; r < numRows; ++r) {
+                    const AccT* in = acc + r * columnsPerBlock;
+                    OutT* outRow = out + r * dims.columns + column0;
+                    for (uint32_t c = 0; c < numColumns; ++c) {
+                        outRow[c] = outputStage(in[c]);
+                    }
+                }
+            }
+        }
+        return true;
+    };
+    return parallelFor(dims.batches * numRowBlocks, getParallelForMinChunkSize(costPerTask),
+                       computeTasks);
+}
+
+}  // namespace android::nn
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_GEMM_H
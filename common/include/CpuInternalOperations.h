@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_INTERNAL_OPERATIONS_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_INTERNAL_OPERATIONS_H
+
+#include "OperationResolver.h"
+#include "nnapi/Types.h"
+
+namespace android::nn {
+
+// Operations that the CPU rewrite passes emit and that only CpuExecutor executes. They are not
+// part of the NNAPI specification: they are never validated, never reported as supported and must
+// not appear in a model that leaves the CPU path. Their types lie outside the ranges used by
+// NNAPI, experimental and extension operations.
+constexpr int32_t kStartOfCpuInternalOperations = 30000;
+
+// FULLY_CONNECTED with TENSOR_FLOAT32 weights stored as compressed sparse rows. Emitted by
+// sparsifyWeightsForCpu.
+constexpr OperationType kOperationFullyConnectedSparse =
+        static_cast<OperationType>(kStartOfCpuInternalOperations);
+
+// Returns the registration of a CPU-internal operation, or nullptr if type is not the type of
+// such an operation.
+const OperationRegistration* findCpuInternalOperation(OperationType type);
+
+namespace fully_connected_sparse {
+
+constexpr char kOperationName[] = "FULLY_CONNECTED_SPARSE";
+
+constexpr uint32_t kNumInputs = 7;
+// The inputs of FULLY_CONNECTED, except that the weights tensor only holds the non-zero weights,
+// ordered by output unit.
+constexpr uint32_t kInputTensor = 0;
+constexpr uint32_t kWeightsTensor = 1;
+constexpr uint32_t kBiasTensor = 2;
+constexpr uint32_t kActivationScalar = 3;
+// A TENSOR_INT32 of shape [2] holding the dense shape of the weights.
+constexpr uint32_t kWeightsDimensions = 4;
+// A TENSOR_INT32 of shape [num_units + 1]. The weights of output unit i are at positions
+// [rowSegments[i], rowSegments[i + 1]) of the weights tensor.
+constexpr uint32_t kWeightsRowSegments = 5;
+// A TENSOR_INT32 holding the input index of each non-zero weight.
+constexpr uint32_t kWeightsColumnIndices = 6;
+
+constexpr uint32_t kNumOutputs = 1;
+constexpr uint32_t kOutputTensor = 0;
+
+bool prepare(IOperationExecutionContext* context);
+bool execute(IOperationExecutionContext* context);
+
+}  // namespace fully_connected_sparse
+
+}  // namespace android::nn
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_INTERNAL_OPERATIONS_H
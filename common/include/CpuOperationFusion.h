@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_OPERATION_FUSION_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_OPERATION_FUSION_H
+
+#include "OperationResolver.h"
+#include "nnapi/Types.h"
+
+namespace android::nn {
+
+/**
+ * @brief Rewrites the main subgraph of a model so that CpuExecutor makes fewer passes over memory.
+ *
+ * The following chains are collapsed into a single operation whose kernel already implements the
+ * combined computation, so that the intermediate tensor is never materialized:
+ * - An operation with a fused activation parameter set to NONE (CONV_2D, DEPTHWISE_CONV_2D,
+ *   FULLY_CONNECTED, ADD, SUB, MUL, DIV, AVERAGE_POOL_2D, MAX_POOL_2D, L2_POOL_2D) followed by
+ *   RELU, RELU1 or RELU6 becomes the operation with the corresponding fused activation.
+ * - PAD of the spatial dimensions followed by CONV_2D with explicit padding or implicit VALID
+ *   padding becomes CONV_2D with the padding amounts added to its explicit padding.
+ *
+ * A chain is only rewritten when the intermediate operand is a temporary with a single consumer
+ * and the result is bit-exact with executing the chain operation by operation. The inputs and
+ * outputs of the main subgraph are preserved in order and type, so requests for the original model
+ * remain valid for the rewritten model. Operands and pools that become unused are removed.
+ *
+ * The rewritten model is intended for CPU execution only and must not be reported back to clients.
+ *
+ * @pre model != nullptr
+ *
+ * @param model The model to rewrite.
+ * @return The number of operations removed from the main subgraph.
+ */
+uint32_t fuseOperationsForCpu(Model* model);
+
+/**
+ * @brief Rewrites the main subgraph of a model so that chains of NCHW operations run in NHWC.
+ *
+ * Operations with a layout input set to NCHW convert their data input to NHWC and their output
+ * back to NCHW on every execution. This pass switches such operations to NHWC and stores the
+ * temporaries between them in NHWC order, so that the data is only transposed where it enters or
+ * leaves the chain. Elementwise operations whose tensor inputs have the shape of their output are
+ * also kept in NHWC when they are part of a chain. TRANSPOSE operations are inserted at the
+ * boundaries of each chain, which is only rewritten when that removes more conversions than it
+ * adds.
+ *
+ * The inputs and outputs of the main subgraph are preserved in order, type and layout. The
+ * rewritten model is intended for CPU execution only and must not be reported back to clients.
+ *
+ * @pre model != nullptr
+ *
+ * @param model The model to rewrite.
+ * @return The number of operations with a layout input that were switched to NHWC.
+ */
+uint32_t assignLayoutsForCpu(Model* model);
+
+// The work removed from every execution by foldConstantsForCpu.
+struct ConstantFoldingResult {
+    // The number of operations removed from the main subgraph.
+    uint32_t operationCount = 0;
+    // The total size in bytes of the constant operands that replace their outputs.
+    size_t byteCount = 0;
+};
+
+/**
+ * @brief Precomputes the operations of the main subgraph whose inputs are all constant.
+ *
+ * Such operations, e.g. DEQUANTIZE or DENSIFY of weights, produce the same values on every
+ * execution. This pass runs them once with CpuExecutor and replaces their outputs that are still
+ * consumed by other operations with constant operands. Values small enough to be copied into the
+ * model become CONSTANT_COPY operands, the others become CONSTANT_REFERENCE operands in a new
+ * memory pool. Only operations whose outputs are temporaries with fully specified dimensions are
+ * folded, and operations whose outputs are much larger than their inputs, e.g. TILE, are left to
+ * run on every execution. If the folded operations fail to execute, the model is left unchanged.
+ *
+ * The inputs and outputs of the main subgraph are preserved in order and type. The rewritten
+ * model is intended for CPU execution only and must not be reported back to clients.
+ *
+ * @pre model != nullptr
+ * @pre operationResolver != nullptr
+ *
+ * @param model The model to rewrite.
+ * @param operationResolver The resolver of the CpuExecutor that will execute the model.
+ * @return The number of folded operations and the size of the values computed for them.
+ */
+ConstantFoldingResult foldConstantsForCpu(
+        Model* model,
+        const IOperationResolver* operationResolver = BuiltinOperationResolver::get());
+
+/**
+ * @brief Stores the constant weights of FULLY_CONNECTED operations as compressed sparse rows when
+ * most of them are zero.
+ *
+ * Pruned models, including models whose weights are produced by DENSIFY of a constant once
+ * foldConstantsForCpu has run, multiply mostly zeros. This pass turns such operations into the
+ * CPU-internal kOperationFullyConnectedSparse, whose weights are the non-zero values and the
+ * inputs described in CpuInternalOperations.h, so that the kernel skips the zero weights. The
+ * results are those of FULLY_CONNECTED, including NaN outputs where a zero weight meets a
+ * non-finite input.
+ *
+ * The rewritten model is intended for CPU execution only and must not be reported back to
+ * clients.
+ *
+ * @pre model != nullptr
+ *
+ * @param model The model to rewrite.
+ * @return The number of operations switched to sparse weights.
+ */
+uint32_t sparsifyWeightsForCpu(Model* model);
+
+}  // namespace android::nn
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_OPERATION_FUSION_H
@@ -25,6 +25,7 @@
 #include <limits>
 #include <vector>
 
+#include "CpuParallelFor.h"
 #include "OperationsExecutionUtils.h"
 
 namespace android {
@@ -58,40 +59,58 @@ inline tflite::RuntimeShape convertShapeToTflshape(const Shape& shape) {
     return tflite::RuntimeShape(tflShapeDim.size(), tflShapeDim.data());
 }
 
-inline void convertFloat16ToFloat32(const _Float16* input, std::vector<float>* output) {
+inline void convertFloat16ToFloat32(const _Float16* input, size_t size, float* output) {
     CHECK(input != nullptr);
     CHECK(output != nullptr);
-    for (size_t i = 0; i < output->size(); ++i) {
-        (*output)[i] = static_cast<float>(input[i]);
+    for (size_t i = 0; i < size; ++i) {
+        output[i] = static_cast<float>(input[i]);
     }
 }
 
-inline void convertFloat32ToFloat16(const std::vector<float>& input, _Float16* output) {
+inline void convertFloat16ToFloat32(const _Float16* input, std::vector<float>* output) {
     CHECK(output != nullptr);
-    for (size_t i = 0; i < input.size(); ++i) {
+    convertFloat16ToFloat32(input, output->size(), output->data());
+}
+
+inline void convertFloat32ToFloat16(const float* input, size_t size, _Float16* output) {
+    CHECK(output != nullptr);
+    for (size_t i = 0; i < size; ++i) {
         output[i] = input[i];
     }
 }
 
+inline void convertFloat32ToFloat16(const std::vector<float>& input, _Float16* output) {
+    convertFloat32ToFloat16(input.data(), input.size(), output);
+}
+
 // Convert int8 quantized values to uint8 assuming that the scale is the same
 // and the distance between offsets is 128.
-inline void convertInt8ToUInt8(const int8_t* input, std::vector<uint8_t>* output) {
+inline void convertInt8ToUInt8(const int8_t* input, size_t size, uint8_t* output) {
     CHECK(input != nullptr);
     CHECK(output != nullptr);
-    for (size_t i = 0; i < output->size(); ++i) {
-        (*output)[i] = static_cast<uint8_t>(static_cast<int32_t>(input[i]) + 128);
+    for (size_t i = 0; i < size; ++i) {
+        output[i] = static_cast<uint8_t>(static_cast<int32_t>(input[i]) + 128);
     }
 }
 
+inline void convertInt8ToUInt8(const int8_t* input, std::vector<uint8_t>* output) {
+    CHECK(output != nullptr);
+    convertInt8ToUInt8(input, output->size(), output->data());
+}
+
 // Convert uint8 quantized values to int8 assuming that the scale is the same
 // and the distance between offsets is 128.
-inline void convertUInt8ToInt8(const std::vector<uint8_t>& input, int8_t* output) {
+inline void convertUInt8ToInt8(const uint8_t* input, size_t size, int8_t* output) {
     CHECK(output != nullptr);
-    for (size_t i = 0; i < input.size(); ++i) {
+    for (size_t i = 0; i < size; ++i) {
         output[i] = static_cast<int8_t>(static_cast<int32_t>(input[i]) - 128);
     }
 }
 
+inline void convertUInt8ToInt8(const std::vector<uint8_t>& input, int8_t* output) {
+    convertUInt8ToInt8(input.data(), input.size(), output);
+}
+
 template <typename T>
 inline void convertQuantToFloat32(const T* input, float scale, int32_t zeroPoint,
                                   std::vector<float>* output) {
@@ -115,15 +134,13 @@ inline void convertFloat32ToQuant(const std::vector<float>& input, float scale,
 }
 
 template <typename T>
-inline bool convertNchwToNhwc(const T* nchw, const Shape& nchwShape, std::vector<T>* nhwc,
-                              Shape* nhwcShape) {
+inline bool convertNchwToNhwc(const T* nchw, const Shape& nchwShape, T* nhwc, Shape* nhwcShape) {
     NN_RET_CHECK_EQ(getNumberOfDimensions(nchwShape), 4u)
             << "Error converting a non-4-D tensor to NHWC layout";
     *nhwcShape = nchwShape;
     const auto& fromDim = nchwShape.dimensions;
     nhwcShape->dimensions = {fromDim[0], fromDim[2], fromDim[3], fromDim[1]};
-    nhwc->resize(getNumberOfElements(nchwShape));
-    auto to = nhwc->data();
+    auto to = nhwc;
     uint32_t spatialSize = fromDim[2] * fromDim[3];
     for (uint32_t n = 0; n < fromDim[0]; n++) {
         for (uint32_t hw = 0; hw < spatialSize; hw++) {
@@ -137,11 +154,18 @@ inline bool convertNchwToNhwc(const T* nchw, const Shape& nchwShape, std::vector
 }
 
 template <typename T>
-inline bool convertNhwcToNchw(const std::vector<T>& nhwc, const Shape& nhwcShape, T* nchw) {
+inline bool convertNchwToNhwc(const T* nchw, const Shape& nchwShape, std::vector<T>* nhwc,
+                              Shape* nhwcShape) {
+    nhwc->resize(getNumberOfElements(nchwShape));
+    return convertNchwToNhwc(nchw, nchwShape, nhwc->data(), nhwcShape);
+}
+
+template <typename T>
+inline bool convertNhwcToNchw(const T* nhwc, const Shape& nhwcShape, T* nchw) {
     NN_RET_CHECK_EQ(getNumberOfDimensions(nhwcShape), 4u)
             << "Error converting a non-4-D tensor to NCHW layout";
     const auto& fromDim = nhwcShape.dimensions;
-    const auto from = nhwc.data();
+    const auto from = nhwc;
     uint32_t spatialSize = fromDim[1] * fromDim[2];
     for (uint32_t n = 0; n < fromDim[0]; n++) {
         for (uint32_t c = 0; c < fromDim[3]; c++) {
@@ -154,34 +178,59 @@ inline bool convertNhwcToNchw(const std::vector<T>& nhwc, const Shape& nhwcShape
     return true;
 }
 
+template <typename T>
+inline bool convertNhwcToNchw(const std::vector<T>& nhwc, const Shape& nhwcShape, T* nchw) {
+    return convertNhwcToNchw(nhwc.data(), nhwcShape, nchw);
+}
+
+// Returns a buffer for count elements, allocated from workspace if it is not null and held by
+// storage otherwise.
+template <typename T>
+inline T* allocateTemporaryBuffer(size_t count, ScratchWorkspace* workspace,
+                                  std::vector<T>* storage) {
+    if (workspace != nullptr) {
+        return workspace->allocate<T>(count);
+    }
+    storage->resize(count);
+    return storage->data();
+}
+
+// The NHWC copy of an NCHW tensor is allocated from workspace if it is not null.
 template <typename T>
 class InputWithLayout {
    public:
-    InputWithLayout(bool useNchw) : mDataOriginal(nullptr), mUseNchw(useNchw) {}
+    InputWithLayout(bool useNchw, ScratchWorkspace* workspace = nullptr)
+        : mDataOriginal(nullptr), mDataNhwc(nullptr), mUseNchw(useNchw), mWorkspace(workspace) {}
 
     bool initialize(const T* data, const Shape& shape) {
         mDataOriginal = data;
         mShape = shape;
         if (mUseNchw) {
-            return convertNchwToNhwc(mDataOriginal, shape, &mDataNhwc, &mShape);
+            mDataNhwc = allocateTemporaryBuffer(getNumberOfElements(shape), mWorkspace,
+                                                &mDataNhwcStorage);
+            NN_RET_CHECK(mDataNhwc != nullptr);
+            return convertNchwToNhwc(mDataOriginal, shape, mDataNhwc, &mShape);
         }
         return true;
     }
 
-    const T* getNhwcBuffer() { return mUseNchw ? mDataNhwc.data() : mDataOriginal; }
+    const T* getNhwcBuffer() { return mUseNchw ? mDataNhwc : mDataOriginal; }
     const Shape& getNhwcShape() { return mShape; }
 
    private:
     const T* mDataOriginal;
-    std::vector<T> mDataNhwc;
+    T* mDataNhwc;
+    std::vector<T> mDataNhwcStorage;
     Shape mShape;
     bool mUseNchw;
+    ScratchWorkspace* mWorkspace;
 };
 
 template <typename T>
 class OutputWithLayout {
    public:
-    OutputWithLayout(bool useNchw) : mDataOriginal(nullptr), mUseNchw(useNchw) {}
+    OutputWithLayout(bool useNchw, ScratchWorkspace* workspace = nullptr)
+        : mDataOriginal(nullptr), mDataNhwc(nullptr), mUseNchw(useNchw), mWorkspace(workspace) {}
 
     bool initialize(T* data, const Shape& shape) {
         NN_RET_CHECK_EQ(getNumberOfDimensions(shape), 4u);
@@ -190,12 +239,14 @@ class OutputWithLayout {
         if (mUseNchw) {
             const auto& dim = shape.dimensions;
             mShape.dimensions = {dim[0], dim[2], dim[3], dim[1]};
-            mDataNhwc.resize(getNumberOfElements(shape));
+            mDataNhwc = allocateTemporaryBuffer(getNumberOfElements(shape), mWorkspace,
+                                                &mDataNhwcStorage);
+            NN_RET_CHECK(mDataNhwc != nullptr);
         }
         return true;
     }
 
-    T* getNhwcBuffer() { return mUseNchw ? mDataNhwc.data() : mDataOriginal; }
+    T* getNhwcBuffer() { return mUseNchw ? mDataNhwc : mDataOriginal; }
     const Shape& getNhwcShape() { return mShape; }
     bool commit() {
         if (mUseNchw) {
@@ -206,11 +257,79 @@ class OutputWithLayout {
 
    private:
     T* mDataOriginal;
-    std::vector<T> mDataNhwc;
+    T* mDataNhwc;
+    std::vector<T> mDataNhwcStorage;
     Shape mShape;
     bool mUseNchw;
+    ScratchWorkspace* mWorkspace;
 };
 
+// Computes a windowed NHWC operation, such as a convolution or a pooling, on bands of output rows
+// that may run concurrently.
+//
+// fn(bandInput, bandInputShape, bandOutput, bandOutputShape, bandPaddingTop) computes a band of
+// output rows of a single batch from the input rows read by their windows. bandPaddingTop is the
+// top padding relative to the first of these input rows; the bottom padding is implied by the
+// band shapes. When the operation is not split, fn receives the whole tensors and paddingTop.
+template <typename T_Input, typename T_Output, typename Function>
+bool parallelForNhwcRows(const T_Input* inputData, const Shape& inputShape, T_Output* outputData,
+                         const Shape& outputShape, int32_t paddingTop, int32_t paddingBottom,
+                         int32_t strideHeight, int32_t effectiveFilterHeight,
+                         uint64_t costPerOutputRow, Function fn) {
+    NN_RET_CHECK_EQ(getNumberOfDimensions(inputShape), 4u);
+    NN_RET_CHECK_EQ(getNumberOfDimensions(outputShape), 4u);
+    const uint32_t numBatches = getSizeOfDimension(outputShape, 0);
+    const uint32_t inputHeight = getSizeOfDimension(inputShape, 1);
+    const uint32_t outputHeight = getSizeOfDimension(outputShape, 1);
+    const size_t inputRowSize =
+            getSizeOfDimension(inputShape, 2) * getSizeOfDimension(inputShape, 3);
+    const size_t outputRowSize =
+            getSizeOfDimension(outputShape, 2) * getSizeOfDimension(outputShape, 3);
+
+    // Splitting requires the windows of all the output rows to overlap the input.
+    if (paddingTop >= effectiveFilterHeight || paddingBottom >= effectiveFilterHeight) {
+        return fn(inputData, inputShape, outputData, outputShape, paddingTop);
+    }
+
+    const uint32_t numRows = numBatches * outputHeight;
+    return parallelFor(
+            numRows, getParallelForMinChunkSize(costPerOutputRow),
+            [&](uint32_t begin, uint32_t end) {
+                if (begin == 0 && end == numRows) {
+                    return fn(inputData, inputShape, outputData, outputShape, paddingTop);
+                }
+                for (uint32_t row = begin; row < end;) {
+                    const uint32_t batch = row / outputHeight;
+                    const uint32_t outputBegin = row % outputHeight;
+                    const uint32_t outputEnd = std::min(outputHeight, outputBegin + (end - row));
+                    const int32_t firstWindowBegin =
+                            static_cast<int32_t>(outputBegin) * strideHeight - paddingTop;
+                    const int32_t lastWindowEnd =
+                            static_cast<int32_t>(outputEnd - 1) * strideHeight - paddingTop +
+                            effectiveFilterHeight;
+                    const int32_t inputBegin = std::max(firstWindowBegin, 0);
+                    const int32_t inputEnd =
+                            std::min(lastWindowEnd, static_cast<int32_t>(inputHeight));
+                    NN_RET_CHECK_LT(inputBegin, inputEnd);
+
+                    Shape bandInputShape = inputShape;
+                    bandInputShape.dimensions[0] = 1;
+                    bandInputShape.dimensions[1] = inputEnd - inputBegin;
+                    Shape bandOutputShape = outputShape;
+                    bandOutputShape.dimensions[0] = 1;
+                    bandOutputShape.dimensions[1] = outputEnd - outputBegin;
+                    const size_t inputOffset = size_t{batch} * inputHeight + inputBegin;
+                    const size_t outputOffset = size_t{batch} * outputHeight + outputBegin;
+                    const T_Input* bandInput = inputData + inputOffset * inputRowSize;
+                    T_Output* bandOutput = outputData + outputOffset * outputRowSize;
+                    NN_RET_CHECK(fn(bandInput, bandInputShape, bandOutput, bandOutputShape,
+                                    inputBegin - firstWindowBegin));
+                    row += outputEnd - outputBegin;
+                }
+                return true;
+            });
+}
+
 template <typename T>
 inline void CalculateActivationRange(int32_t activation, const Shape& outputShape,
                                      int32_t* outputActivationMin, int32_t* outputActivationMax);
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_PARALLEL_FOR_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_PARALLEL_FOR_H
+
+#include <android-base/macros.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "nnapi/Types.h"
+
+namespace android::nn {
+
+/**
+ * @brief Sets the number of threads that may execute a single CPU operation.
+ *
+ * The count includes the thread calling parallelFor, so 1 disables intra-operation parallelism.
+ * 0 restores the default, which is derived from the number of cores. Threads that are no longer
+ * needed are stopped before this function returns.
+ *
+ * @param threadCount The maximum number of threads, or 0 for the default.
+ */
+void setCpuThreadCount(uint32_t threadCount);
+
+/**
+ * @brief Returns the number of threads that may execute a single CPU operation.
+ */
+uint32_t getCpuThreadCount();
+
+/**
+ * @brief Sets the deadline observed by parallelFor calls made on the current thread.
+ *
+ * The previous deadline of the thread is restored when the object goes out of scope.
+ */
+class ScopedCpuDeadline {
+   public:
+    explicit ScopedCpuDeadline(const OptionalTimePoint& deadline);
+    ~ScopedCpuDeadline();
+    DISALLOW_COPY_AND_ASSIGN(ScopedCpuDeadline);
+
+   private:
+    OptionalTimePoint mPreviousDeadline;
+};
+
+/**
+ * @brief Splits [0, size) into contiguous chunks and calls fn once for each chunk, possibly
+ * concurrently from several threads.
+ *
+ * The calling thread takes part in the computation and the call returns only after every chunk
+ * has either run or been skipped. Chunks hold at least minChunkSize indexes, except possibly for
+ * the last one, so that small loops run on the calling thread without synchronization. Calls
+ * made from within fn run sequentially on the thread executing fn.
+ *
+ * Chunks that have not started when the deadline set by ScopedCpuDeadline has passed, or after
+ * an earlier chunk has failed, are skipped.
+ *
+ * @param size The number of indexes to process.
+ * @param minChunkSize The minimum number of indexes worth handing to another thread.
+ * @param fn Processes [begin, end) and returns false on failure.
+ * @return true if fn was called for every index and never returned false.
+ */
+bool parallelFor(uint32_t size, uint32_t minChunkSize,
+                 const std::function<bool(uint32_t begin, uint32_t end)>& fn);
+
+// Amount of work, in multiply-accumulates or comparable arithmetic operations, below which it is
+// cheaper to compute a chunk on the current thread than to hand it over to another one.
+constexpr uint64_t kParallelForMinChunkCost = 1 << 16;
+
+// Returns the minChunkSize to pass to parallelFor when processing one index costs costPerIndex.
+inline uint32_t getParallelForMinChunkSize(uint64_t costPerIndex) {
+    const uint64_t minChunkSize =
+            (kParallelForMinChunkCost + costPerIndex - 1) / std::max<uint64_t>(costPerIndex, 1);
+    return std::clamp<uint64_t>(minChunkSize, 1, std::numeric_limits<uint32_t>::max());
+}
+
+}  // namespace android::nn
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_PARALLEL_FOR_H
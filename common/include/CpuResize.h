@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_RESIZE_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_RESIZE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "CpuParallelFor.h"
+#include "OperationsExecutionUtils.h"
+
+namespace android::nn {
+
+// The sizes of an NHWC resize.
+struct ResizeDimensions {
+    uint32_t batches = 0;
+    uint32_t inHeight = 0;
+    uint32_t inWidth = 0;
+    uint32_t channels = 0;
+    uint32_t outHeight = 0;
+    uint32_t outWidth = 0;
+};
+
+struct ResizeOptions {
+    bool alignCorners = false;
+    bool halfPixelCenters = false;
+};
+
+namespace resize_internal {
+
+inline float calculateResizeScale(uint32_t inSize, uint32_t outSize, bool alignCorners) {
+    return (alignCorners && outSize > 1) ? (inSize - 1) / static_cast<float>(outSize - 1)
+                                         : inSize / static_cast<float>(outSize);
+}
+
+// Returns a buffer for count elements, allocated from workspace if it is not null and held by
+// storage otherwise.
+template <typename T>
+T* allocate(size_t count, ScratchWorkspace* workspace, std::vector<T>* storage) {
+    if (workspace != nullptr) {
+        return workspace->allocate<T>(count);
+    }
+    storage->resize(count);
+    return storage->data();
+}
+
+// The two input rows or columns that an output row or column is interpolated from. Offsets are
+// in elements, relative to the start of an image or row, so that the inner loops only add them.
+template <typename WeightT>
+struct BilinearTap {
+    size_t lowerOffset;
+    size_t upperOffset;
+    WeightT lowerWeight;
+    WeightT upperWeight;
+};
+
+// Computes the taps of one axis as the float TFLite reference kernel does, so that the output
+// does not depend on the kernel that computes it.
+inline void computeBilinearTaps(uint32_t inSize, uint32_t outSize, size_t stride,
+                                const ResizeOptions& options, BilinearTap<float>* taps) {
+    const float scale = calculateResizeScale(inSize, outSize, options.alignCorners);
+    const int32_t last = static_cast<int32_t>(inSize) - 1;
+    for (uint32_t i = 0; i < outSize; ++i) {
+        const float value = static_cast<float>(i);
+        const float scaled = options.halfPixelCenters ? (value + 0.5f) * scale - 0.5f
+                                                      : value * scale;
+        const int32_t lower = std::max(static_cast<int32_t>(std::floor(scaled)), 0);
+        const int32_t upper = std::min(static_cast<int32_t>(std::ceil(scaled)), last);
+        taps[i] = {.lowerOffset = lower * stride,
+                   .upperOffset = upper * stride,
+                   .lowerWeight = 1 - (scaled - lower),
+                   .upperWeight = scaled - lower};
+    }
+}
+
+// Computes the taps of one axis in 10 bit fixed point, as the integer TFLite reference kernel
+// does for TENSOR_QUANT8_ASYMM_SIGNED.
+inline void computeBilinearTaps(uint32_t inSize, uint32_t outSize, size_t stride,
+                                const ResizeOptions& options, BilinearTap<int32_t>* taps) {
+    constexpr int32_t kOne = 1 << 10;
+    const int32_t in = static_cast<int32_t>(inSize);
+    const int32_t out = static_cast<int32_t>(outSize);
+    const int32_t scale = (options.alignCorners && out > 1)
+                                  ? (kOne * (in - 1) + (out - 1) / 2) / (out - 1)
+                                  : (kOne * in + out / 2) / out;
+    for (int32_t i = 0; i < out; ++i) {
+        const int32_t scaled =
+                options.halfPixelCenters ? i * scale + scale / 2 - kOne / 2 : i * scale;
+        const int32_t lower = std::max(scaled / kOne, 0);
+        const int32_t upper = std::min((scaled + kOne - 1) / kOne, in - 1);
+        taps[i] = {.lowerOffset = lower * stride,
+                   .upperOffset = upper * stride,
+                   .lowerWeight = kOne - (scaled - kOne * lower),
+                   .upperWeight = scaled - kOne * lower};
+    }
+}
+
+// Interpolates the channels of one output pixel. The float and fixed point versions compute the
+// same expressions as the TFLite reference kernels, in the same order, so that the results are
+// identical while the loop over the channels vectorizes.
+template <uint32_t kChannels, typename T>
+inline void interpolatePixel(const T* topLeft, const T* bottomLeft, const T* topRight,
+                             const T* bottomRight, const BilinearTap<float>& y,
+                             const BilinearTap<float>& x, uint32_t channels, T* out) {
+    // Integer types are rounded to nearest, floating point types are not rounded.
+    constexpr float kRoundingOffset = std::is_integral_v<T> ? 0.5f : 0.0f;
+    for (uint32_t c = 0; c < (kChannels != 0 ? kChannels : channels); ++c) {
+        out[c] = static_cast<T>(static_cast<float>(topLeft[c]) * y.lowerWeight * x.lowerWeight +
+                                static_cast<float>(bottomLeft[c]) * y.upperWeight * x.lowerWeight +
+                                static_cast<float>(topRight[c]) * y.lowerWeight * x.upperWeight +
+                                static_cast<float>(bottomRight[c]) * y.upperWeight * x.upperWeight +
+                                kRoundingOffset);
+    }
+}
+
+template <uint32_t kChannels, typename T>
+inline void interpolatePixel(const T* topLeft, const T* bottomLeft, const T* topRight,
+                             const T* bottomRight, const BilinearTap<int32_t>& y,
+                             const BilinearTap<int32_t>& x, uint32_t channels, T* out) {
+    const int64_t topLeftWeight = static_cast<int64_t>(y.lowerWeight) * x.lowerWeight;
+    const int64_t bottomLeftWeight = static_cast<int64_t>(y.upperWeight) * x.lowerWeight;
+    const int64_t topRightWeight = static_cast<int64_t>(y.lowerWeight) * x.upperWeight;
+    const int64_t bottomRightWeight = static_cast<int64_t>(y.upperWeight) * x.upperWeight;
+    for (uint32_t c = 0; c < (kChannels != 0 ? kChannels : channels); ++c) {
+        const int64_t sum = topLeft[c] * topLeftWeight + bottomLeft[c] * bottomLeftWeight +
+                            topRight[c] * topRightWeight + bottomRight[c] * bottomRightWeight;
+        // Rounds half away from zero, from 20 fractional bits.
+        const int64_t round = sum > 0 ? (1 << 19) : -(1 << 19);
+        out[c] = static_cast<T>((sum + round) / (1 << 20));
+    }
+}
+
+// Interpolates one output row from the input rows top and bottom. kChannels is the number of
+// channels if it is known at compile time, which lets the common RGB and RGBA images be unrolled,
+// and 0 otherwise.
+template <uint32_t kChannels, typename T, typename WeightT>
+void interpolateRow(const T* top, const T* bottom, const BilinearTap<WeightT>& y,
+                    const BilinearTap<WeightT>* columnTaps, uint32_t outWidth, uint32_t channels,
+                    T* out) {
+    for (uint32_t i = 0; i < outWidth; ++i) {
+        const BilinearTap<WeightT>& x = columnTaps[i];
+        interpolatePixel<kChannels>(top + x.lowerOffset, bottom + x.lowerOffset,
+                                    top + x.upperOffset, bottom + x.upperOffset, y, x, channels,
+                                    out);
+        out += channels;
+    }
+}
+
+// TENSOR_QUANT8_ASYMM_SIGNED is interpolated in fixed point, every other type in float.
+template <typename T>
+using BilinearWeight = std::conditional_t<std::is_same_v<T, int8_t>, int32_t, float>;
+
+// Returns the minChunkSize to pass to parallelFor when processing one output row at a time.
+inline uint32_t getResizeMinChunkSize(const ResizeDimensions& dims, uint64_t costPerElement) {
+    return getParallelForMinChunkSize(static_cast<uint64_t>(dims.outWidth) * dims.channels *
+                                      costPerElement);
+}
+
+}  // namespace resize_internal
+
+// Resizes NHWC images with bilinear interpolation, as RESIZE_BILINEAR.
+//
+// The input rows and columns and the interpolation weights of every output row and column are
+// computed once per call, into buffers allocated from workspace if it is not null. Output rows
+// are then computed in parallel, each pixel with a loop over its channels that is unrolled for 1, 3
+// and 4 channels.
+template <typename T>
+bool resizeBilinearNhwc(const ResizeDimensions& dims, const ResizeOptions& options,
+                        const T* inputData, T* outputData, ScratchWorkspace* workspace) {
+    using namespace resize_internal;
+    using Tap = BilinearTap<BilinearWeight<T>>;
+    const size_t inRowSize = static_cast<size_t>(dims.inWidth) * dims.channels;
+    const size_t inImageSize = dims.inHeight * inRowSize;
+    const size_t outRowSize = static_cast<size_t>(dims.outWidth) * dims.channels;
+
+    std::vector<Tap> storage;
+    Tap* const rowTaps = allocate(dims.outHeight + dims.outWidth, workspace, &storage);
+    if (rowTaps == nullptr) {
+        return false;
+    }
+    Tap* const columnTaps = rowTaps + dims.outHeight;
+    computeBilinearTaps(dims.inHeight, dims.outHeight, inRowSize, options, rowTaps);
+    computeBilinearTaps(dims.inWidth, dims.outWidth, dims.channels, options, columnTaps);
+
+    const auto computeRows = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t row = begin; row < end; ++row) {
+            const uint32_t b = row / dims.outHeight;
+            const Tap& y = rowTaps[row % dims.outHeight];
+            const T* top = inputData + b * inImageSize + y.lowerOffset;
+            const T* bottom = inputData + b * inImageSize + y.upperOffset;
+            T* out = outputData + row * outRowSize;
+            switch (dims.channels) {
+                case 1:
+                    interpolateRow<1>(top, bottom, y, columnTaps, dims.outWidth, 1, out);
+                    break;
+                case 3:
+                    interpolateRow<3>(top, bottom, y, columnTaps, dims.outWidth, 3, out);
+                    break;
+                case 4:
+                    interpolateRow<4>(top, bottom, y, columnTaps, dims.outWidth, 4, out);
+                    break;
+                default:
+                    interpolateRow<0>(top, bottom, y, columnTaps, dims.outWidth, dims.channels,
+                                      out);
+                    break;
+            }
+        }
+        return true;
+    };
+    return parallelFor(dims.batches * dims.outHeight, getResizeMinChunkSize(dims, 8), computeRows);
+}
+
+// Resizes NHWC images by copying the nearest input pixel, as RESIZE_NEAREST_NEIGHBOR.
+//
+// The input row and column of every output row and column are computed once per call, into
+// buffers allocated from workspace if it is not null. Output rows are then copied in parallel.
+template <typename T>
+bool resizeNearestNeighborNhwc(const ResizeDimensions& dims, const ResizeOptions& options,
+                               const T* inputData, T* outputData, ScratchWorkspace* workspace) {
+    using namespace resize_internal;
+    const size_t inRowSize = static_cast<size_t>(dims.inWidth) * dims.channels;
+    const size_t inImageSize = dims.inHeight * inRowSize;
+    const size_t outRowSize = static_cast<size_t>(dims.outWidth) * dims.channels;
+
+    std::vector<size_t> storage;
+    size_t* const rowOffsets = allocate(dims.outHeight + dims.outWidth, workspace, &storage);
+    if (rowOffsets == nullptr) {
+        return false;
+    }
+    size_t* const columnOffsets = rowOffsets + dims.outHeight;
+    const auto computeOffsets = [&options](uint32_t inSize, uint32_t outSize, size_t stride,
+                                           size_t* offsets) {
+        const float scale = calculateResizeScale(inSize, outSize, options.alignCorners);
+        for (uint32_t i = 0; i < outSize; ++i) {
+            const float scaled = options.halfPixelCenters
+                                         ? (static_cast<float>(i) + 0.5f) * scale
+                                         : static_cast<float>(i) * scale;
+            int32_t index = std::min(options.alignCorners ? static_cast<int32_t>(roundf(scaled))
+                                                          : static_cast<int32_t>(floorf(scaled)),
+                                     static_cast<int32_t>(inSize) - 1);
+            if (options.halfPixelCenters) {
+                index = std::max(index, 0);
+            }
+            offsets[i] = index * stride;
+        }
+    };
+    computeOffsets(dims.inHeight, dims.outHeight, inRowSize, rowOffsets);
+    computeOffsets(dims.inWidth, dims.outWidth, dims.channels, columnOffsets);
+
+    const auto computeRows = [&](uint32_t begin, uint32_t end) {
+        for (uint32_t row = begin; row < end; ++row) {
+            const uint32_t b = row / dims.outHeight;
+            const T* in = inputData + b * inImageSize + rowOffsets[row % dims.outHeight];
+            T* out = outputData + row * outRowSize;
+            // Consecutive output rows that read the same input row are copied from the first.
+            if (row != begin && row % dims.outHeight != 0 &&
+                rowOffsets[row % dims.outHeight] == rowOffsets[row % dims.outHeight - 1]) {
+                std::copy_n(out - outRowSize, outRowSize, out);
+                continue;
+            }
+            for (uint32_t i = 0; i < dims.outWidth; ++i) {
+                std::copy_n(in + columnOffsets[i], dims.channels, out);
+                out += dims.channels;
+            }
+        }
+        return true;
+    };
+    return parallelFor(dims.batches * dims.outHeight, getResizeMinChunkSize(dims, 1), computeRows);
+}
+
+}  // namespace android::nn
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_RESIZE_H
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_SELECTION_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_SELECTION_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "CpuOperationUtils.h"
+#include "CpuParallelFor.h"
+#include "OperationsExecutionUtils.h"
+
+namespace android::nn {
+
+namespace selection_internal {
+
+// The scans keep this many independent running extrema, which the compiler keeps in vector
+// registers, instead of one that each element depends on.
+constexpr uint32_t kScanLanes = 16;
+
+// TOPK_V2 uses a heap of the k best elements of a row if k is at most 1/kHeapSelectionRatio of
+// the row, and partitions a copy of the whole row otherwise.
+constexpr uint32_t kHeapSelectionRatio = 16;
+
+// Returns the extremum of data[0, size), size > 0, according to Better, which is std::greater for
+// the maximum and std::less for the minimum. Elements for which Better is false both ways with the
+// running extremum, such as NaN, are skipped unless they are data[0], which is then returned.
+template <typename T, typename Better>
+T scanExtremum(const T* data, uint32_t size) {
+    const Better better;
+    T lanes[kScanLanes];
+    std::fill_n(lanes, kScanLanes, data[0]);
+    uint32_t i = 0;
+    for (; i + kScanLanes <= size; i += kScanLanes) {
+        for (uint32_t lane = 0; lane < kScanLanes; ++lane) {
+            lanes[lane] = better(data[i + lane], lanes[lane]) ? data[i + lane] : lanes[lane];
+        }
+    }
+    T extremum = data[0];
+    for (; i < size; ++i) {
+        extremum = better(data[i], extremum) ? data[i] : extremum;
+    }
+    for (uint32_t lane = 0; lane < kScanLanes; ++lane) {
+        extremum = better(lanes[lane], extremum) ? lanes[lane] : extremum;
+    }
+    return extremum;
+}
+
+// Whether element a at aIndex comes before element b at bIndex in the output of TOPK_V2: larger
+// values come first and, among equal values, larger indexes.
+template <typename T>
+bool ranksBefore(const T& a, int32_t aIndex, const T& b, int32_t bIndex) {
+    return b < a || (!(a < b) && bIndex < aIndex);
+}
+
+template <typename T>
+bool ranksBefore(const std::pair<T, int32_t>& a, const std::pair<T, int32_t>& b) {
+    return ranksBefore(a.first, a.second, b.first, b.second);
+}
+
+// Finds the largest value of row and the last index that holds it. Returns false if the scan
+// cannot tell, which only happens for unordered values such as NaN.
+template <typename T>
+bool topOne(const T* row, uint32_t rowSize, T* value, int32_t* index) {
+    const T maximum = scanExtremum<T, std::greater<T>>(row, rowSize);
+    for (uint32_t i = rowSize; i > 0; --i) {
+        if (row[i - 1] == maximum) {
+            *value = maximum;
+            *index = static_cast<int32_t>(i - 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Selects the k best elements of row with a heap whose top is the worst of them, so that most
+// elements are rejected after one comparison. heap has room for k elements.
+template <typename T>
+void topKWithHeap(const T* row, uint32_t rowSize, uint32_t k, std::pair<T, int32_t>* heap,
+                  T* values, int32_t* indices) {
+    const auto compare = [](const std::pair<T, int32_t>& a, const std::pair<T, int32_t>& b) {
+        return ranksBefore(a, b);
+    };
+    for (uint32_t i = 0; i < k; ++i) {
+        heap[i] = {row[i], static_cast<int32_t>(i)};
+    }
+    std::make_heap(heap, heap + k, compare);
+    for (uint32_t i = k; i < rowSize; ++i) {
+        // Later elements win ties, so any element that is not smaller than the top replaces it.
+        if (row[i] < heap[0].first) {
+            continue;
+        }
+        std::pop_heap(heap, heap + k, compare);
+        heap[k - 1] = {row[i], static_cast<int32_t>(i)};
+        std::push_heap(heap, heap + k, compare);
+    }
+    std::sort_heap(heap, heap + k, compare);
+    for (uint32_t i = 0; i < k; ++i) {
+        values[i] = heap[i].first;
+        indices[i] = heap[i].second;
+    }
+}
+
+// Selects the k best elements of row by partitioning a copy of it. buffer has room for rowSize
+// elements.
+template <typename T>
+void topKWithPartition(const T* row, uint32_t rowSize, uint32_t k, std::pair<T, int32_t>* buffer,
+                       T* values, int32_t* indices) {
+    const auto compare = [](const std::pair<T, int32_t>& a, const std::pair<T, int32_t>& b) {
+        return ranksBefore(a, b);
+    };
+    for (uint32_t i = 0; i < rowSize; ++i) {
+        buffer[i] = {row[i], static_cast<int32_t>(i)};
+    }
+    std::nth_element(buffer, buffer + (k - 1), buffer + rowSize, compare);
+    std::sort(buffer, buffer + k, compare);
+    for (uint32_t i = 0; i < k; ++i) {
+        values[i] = buffer[i].first;
+        indices[i] = buffer[i].second;
+    }
+}
+
+}  // namespace selection_internal
+
+// Computes TOPK_V2 over numRows rows of rowSize elements: the k largest values of each row in
+// descending order and their indexes. Equal values are ordered by descending index.
+//
+// Rows are processed in parallel. k == 1 is a vectorized scan, small values of k keep a heap of
+// the k best elements, and larger values of k partition a copy of the row allocated from
+// workspace if it is not null.
+template <typename T>
+bool topK(const T* inputData, uint32_t numRows, uint32_t rowSize, uint32_t k, T* valuesData,
+          int32_t* indicesData, ScratchWorkspace* workspace) {
+    using namespace selection_internal;
+    const bool useHeap = static_cast<uint64_t>(k) * kHeapSelectionRatio <= rowSize;
+    const uint32_t bufferSize = useHeap ? k : rowSize;
+    const auto computeRows = [&](uint32_t begin, uint32_t end) -> bool {
+        std::vector<std::pair<T, int32_t>> bufferStorage;
+        std::pair<T, int32_t>* buffer = nullptr;
+        const auto getBuffer = [&buffer, &bufferStorage, bufferSize, workspace] {
+            if (buffer == nullptr) {
+                buffer = allocateTemporaryBuffer(bufferSize, workspace, &bufferStorage);
+            }
+            return buffer;
+        };
+        for (uint32_t row = begin; row < end; ++row) {
+            const T* in = inputData + static_cast<size_t>(row) * rowSize;
+            T* values = valuesData + static_cast<size_t>(row) * k;
+            int32_t* indices = indicesData + static_cast<size_t>(row) * k;
+            if (k == 1 && topOne(in, rowSize, values, indices)) {
+                continue;
+            }
+            NN_RET_CHECK(getBuffer() != nullptr);
+            if (useHeap) {
+                topKWithHeap(in, rowSize, k, buffer, values, indices);
+            } else {
+                topKWithPartition(in, rowSize, k, buffer, values, indices);
+            }
+        }
+        return true;
+    };
+    const uint64_t costPerRow = useHeap ? rowSize : static_cast<uint64_t>(rowSize) * 8;
+    return parallelFor(numRows, getParallelForMinChunkSize(costPerRow), computeRows);
+}
+
+// Computes ARGMAX or ARGMIN over the middle axis of a tensor of outerSize x axisSize x innerSize
+// elements: the index of the first extremum of each of the outerSize x innerSize rows along the
+// axis. As in a sequential scan, NaN values are skipped unless the row starts with one, whose
+// index is then returned.
+//
+// Outer slices are processed in parallel. Contiguous rows (innerSize == 1) are scanned for their
+// extremum with a vectorized reduction, then for its first index. Otherwise the running extrema
+// of the innerSize rows of a slice are updated together, which vectorizes across rows.
+template <typename T, typename Better>
+bool argExtremum(const T* inputData, uint32_t outerSize, uint32_t axisSize, uint32_t innerSize,
+                 int32_t* outputData) {
+    using namespace selection_internal;
+    const Better better;
+    const auto computeSlices = [&](uint32_t begin, uint32_t end) {
+        std::vector<T> extrema(innerSize == 1 ? 0 : innerSize);
+        for (uint32_t outer = begin; outer < end; ++outer) {
+            const T* in = inputData + static_cast<size_t>(outer) * axisSize * innerSize;
+            int32_t* out = outputData + static_cast<size_t>(outer) * innerSize;
+            if (innerSize == 1) {
+                const T extremum = scanExtremum<T, Better>(in, axisSize);
+                // The extremum is only missing if it is NaN, which means that in[0] is NaN.
+                const T* found = std::find(in, in + axisSize, extremum);
+                out[0] = found != in + axisSize ? static_cast<int32_t>(found - in) : 0;
+                continue;
+            }
+            std::copy_n(in, innerSize, extrema.data());
+            std::fill_n(out, innerSize, 0);
+            for (uint32_t i = 1; i < axisSize; ++i) {
+                const T* values = in + static_cast<size_t>(i) * innerSize;
+                for (uint32_t inner = 0; inner < innerSize; ++inner) {
+                    const bool isBetter = better(values[inner], extrema[inner]);
+                    extrema[inner] = isBetter ? values[inner] : extrema[inner];
+                    out[inner] = isBetter ? static_cast<int32_t>(i) : out[inner];
+                }
+            }
+        }
+        return true;
+    };
+    return parallelFor(
+            outerSize,
+            getParallelForMinChunkSize(static_cast<uint64_t>(axisSize) * innerSize * 2),
+            computeSlices);
+}
+
+}  // namespace android::nn
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_SELECTION_H
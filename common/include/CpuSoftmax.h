@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_SOFTMAX_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_SOFTMAX_H
+
+#include <Eigen/Core>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "CpuOperationUtils.h"
+#include "CpuParallelFor.h"
+#include "OperationsExecutionUtils.h"
+
+namespace android::nn {
+
+// The view of a tensor that SOFTMAX and LOG_SOFTMAX normalize along its middle axis.
+struct SoftmaxDimensions {
+    uint32_t outerSize = 0;
+    uint32_t axisSize = 0;
+    uint32_t innerSize = 0;
+};
+
+namespace softmax_internal {
+
+// Contiguous rows are processed in blocks of kBlockSize elements, and slices along another axis in
+// blocks of kBlockSize columns, so that a block stays in L1 between the passes over it.
+constexpr uint32_t kBlockSize = 256;
+
+using ConstArrayMap = Eigen::Map<const Eigen::ArrayXf>;
+using ArrayMap = Eigen::Map<Eigen::ArrayXf>;
+
+// Returns size values of data as float: data itself for float, or their conversion into buffer.
+template <typename T>
+const float* loadAsFloat(const T* data, uint32_t size, float* buffer) {
+    if constexpr (std::is_same_v<T, float>) {
+        return data;
+    } else {
+        std::transform(data, data + size, buffer,
+                       [](T value) { return static_cast<float>(value); });
+        return buffer;
+    }
+}
+
+// Returns where to compute size float values that go to data: data itself for float, or buffer,
+// which storeFromFloat then converts to data.
+template <typename T>
+float* getFloatOutput(T* data, float* buffer) {
+    if constexpr (std::is_same_v<T, float>) {
+        return data;
+    } else {
+        return buffer;
+    }
+}
+
+template <typename T>
+void storeFromFloat(const float* values, uint32_t size, T* data) {
+    if constexpr (!std::is_same_v<T, float>) {
+        std::transform(values, values + size, data,
+                       [](float value) { return static_cast<T>(value); });
+    }
+}
+
+// Normalizes a contiguous row with a single pass over its input, followed by a pass over its
+// output.
+//
+// The maximum and the sum of exponentials are computed online: each block is exponentiated
+// relative to the largest value seen so far, which blockMaxima records, and the sum is rescaled
+// when a block raises the maximum. For float softmax, the exponentials are written to the output
+// right away, and the second pass only rescales each block by a single factor. Other cases
+// recompute the output from the input in the second pass.
+//
+// buffer holds kBlockSize floats and blockMaxima one float per block of the row.
+template <typename T>
+void normalizeRow(const T* input, uint32_t size, float beta, bool isLogSoftmax, T* output,
+                  float* buffer, float* blockMaxima) {
+    constexpr bool kStoresExponentials = std::is_same_v<T, float>;
+    float maximum = 0.0f;
+    float sum = 0.0f;
+    for (uint32_t begin = 0, block = 0; begin < size; begin += kBlockSize, ++block) {
+        const uint32_t n = std::min(kBlockSize, size - begin);
+        const ConstArrayMap x(loadAsFloat(input + begin, n, buffer), n);
+        const float blockMaximum = x.maxCoeff();
+        if (block == 0) {
+            maximum = blockMaximum;
+        } else if (blockMaximum > maximum) {
+            sum *= std::exp((maximum - blockMaximum) * beta);
+            maximum = blockMaximum;
+        }
+        blockMaxima[block] = maximum;
+        if (kStoresExponentials && !isLogSoftmax) {
+            ArrayMap e(getFloatOutput(output + begin, buffer), n);
+            e = ((x - maximum) * beta).exp();
+            sum += e.sum();
+        } else {
+            sum += ((x - maximum) * beta).exp().sum();
+        }
+    }
+
+    const float logSum = std::log(sum);
+    for (uint32_t begin = 0, block = 0; begin < size; begin += kBlockSize, ++block) {
+        const uint32_t n = std::min(kBlockSize, size - begin);
+        ArrayMap out(getFloatOutput(output + begin, buffer), n);
+        if (kStoresExponentials && !isLogSoftmax) {
+            out *= std::exp((blockMaxima[block] - maximum) * beta) / sum;
+            continue;
+        }
+        const ConstArrayMap x(loadAsFloat(input + begin, n, buffer), n);
+        if (isLogSoftmax) {
+            out = (x - maximum) * beta - logSum;
+        } else {
+            out = ((x - maximum) * beta).exp() * (1.0f / sum);
+        }
+        storeFromFloat(out.data(), n, output + begin);
+    }
+}
+
+// Normalizes columns [column, column + width) of a slice of axisSize rows of rowStride elements,
+// along its rows. Each pass reads the block of every row in turn, and updates the maxima and sums
+// of all the columns together, so that the passes are vectorized across columns.
+//
+// buffer, maxima and sums each hold width floats.
+template <typename T>
+void normalizeColumns(const T* input, uint32_t axisSize, uint32_t rowStride, uint32_t width,
+                      float beta, bool isLogSoftmax, T* output, float* buffer, float* maxima,
+                      float* sums) {
+    constexpr bool kStoresExponentials = std::is_same_v<T, float>;
+    ArrayMap maximum(maxima, width);
+    ArrayMap sum(sums, width);
+    const auto row = [rowStride](auto* data, uint32_t i) {
+        return data + static_cast<size_t>(i) * rowStride;
+    };
+
+    maximum = ConstArrayMap(loadAsFloat(input, width, buffer), width);
+    for (uint32_t i = 1; i < axisSize; ++i) {
+        maximum = maximum.max(ConstArrayMap(loadAsFloat(row(input, i), width, buffer), width));
+    }
+
+    sum.setZero();
+    for (uint32_t i = 0; i < axisSize; ++i) {
+        const ConstArrayMap x(loadAsFloat(row(input, i), width, buffer), width);
+        if (kStoresExponentials && !isLogSoftmax) {
+            ArrayMap e(getFloatOutput(row(output, i), buffer), width);
+            e = ((x - maximum) * beta).exp();
+            sum += e;
+        } else {
+            sum += ((x - maximum) * beta).exp();
+        }
+    }
+
+    if (isLogSoftmax) {
+        sum = sum.log();
+    } else {
+        sum = sum.inverse();
+    }
+    for (uint32_t i = 0; i < axisSize; ++i) {
+        ArrayMap out(getFloatOutput(row(output, i), buffer), width);
+        if (kStoresExponentials && !isLogSoftmax) {
+            out *= sum;
+            continue;
+        }
+        const ConstArrayMap x(loadAsFloat(row(input, i), width, buffer), width);
+        if (isLogSoftmax) {
+            out = (x - maximum) * beta - sum;
+        } else {
+            out = ((x - maximum) * beta).exp() * sum;
+        }
+        storeFromFloat(out.data(), width, row(output, i));
+    }
+}
+
+}  // namespace softmax_internal
+
+// Computes SOFTMAX, or LOG_SOFTMAX if isLogSoftmax is true, of float or float16 data along the
+// middle axis of dims. Float16 is computed in float, one block at a time.
+//
+// Contiguous rows (innerSize == 1) are normalized with an online maximum and sum, and other axes
+// one block of columns at a time. The exponentials are vectorized by Eigen. Rows or blocks of
+// columns are processed in parallel, with buffers allocated from workspace if it is not null.
+template <typename T>
+bool softmaxFloat(const T* inputData, const SoftmaxDimensions& dims, float beta,
+                  bool isLogSoftmax, T* outputData, ScratchWorkspace* workspace) {
+    using namespace softmax_internal;
+    const uint32_t sliceSize = dims.axisSize * dims.innerSize;
+    if (dims.innerSize == 1) {
+        const uint32_t numBlocks = (dims.axisSize + kBlockSize - 1) / kBlockSize;
+        const auto computeRows = [&](uint32_t begin, uint32_t end) -> bool {
+            std::vector<float> bufferStorage;
+            float* buffer =
+                    allocateTemporaryBuffer(kBlockSize + numBlocks, workspace, &bufferStorage);
+            NN_RET_CHECK(buffer != nullptr);
+            for (uint32_t row = begin; row < end; ++row) {
+                normalizeRow(inputData + static_cast<size_t>(row) * sliceSize, dims.axisSize, beta,
+                             isLogSoftmax, outputData + static_cast<size_t>(row) * sliceSize,
+                             buffer, buffer + kBlockSize);
+            }
+            return true;
+        };
+        return parallelFor(dims.outerSize, getParallelForMinChunkSize(uint64_t{dims.axisSize} * 8),
+                           computeRows);
+    }
+
+    const uint32_t numColumnBlocks = (dims.innerSize + kBlockSize - 1) / kBlockSize;
+    const auto computeColumnBlocks = [&](uint32_t begin, uint32_t end) -> bool {
+        std::vector<float> bufferStorage;
+        float* buffer = allocateTemporaryBuffer(kBlockSize * 3, workspace, &bufferStorage);
+        NN_RET_CHECK(buffer != nullptr);
+        for (uint32_t index = begin; index < end; ++index) {
+            const uint32_t outer = index / numColumnBlocks;
+            const uint32_t column = index % numColumnBlocks * kBlockSize;
+            const size_t offset = static_cast<size_t>(outer) * sliceSize + column;
+            normalizeColumns(inputData + offset, dims.axisSize, dims.innerSize,
+                             std::min(kBlockSize, dims.innerSize - column), beta, isLogSoftmax,
+                             outputData + offset, buffer, buffer + kBlockSize,
+                             buffer + 2 * kBlockSize);
+        }
+        return true;
+    };
+    const uint64_t costPerColumnBlock =
+            uint64_t{dims.axisSize} * std::min(kBlockSize, dims.innerSize) * 8;
+    return parallelFor(dims.outerSize * numColumnBlocks,
+                       getParallelForMinChunkSize(costPerColumnBlock), computeColumnBlocks);
+}
+
+}  // namespace android::nn
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_SOFTMAX_H
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_TENSOR_COPY_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_TENSOR_COPY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace android::nn {
+
+/**
+ * @brief One axis of a strided copy.
+ *
+ * The axis has size indexes. Consecutive indexes are inputStride elements apart in the input and
+ * outputStride elements apart in the output.
+ */
+struct CopyAxis {
+    uint32_t size = 0;
+    int64_t inputStride = 0;
+    int64_t outputStride = 0;
+};
+
+/**
+ * @brief Returns the strides, in elements, of the axes of a contiguous tensor with the given
+ * dimensions.
+ */
+std::vector<int64_t> getContiguousStrides(const std::vector<uint32_t>& dimensions);
+
+/**
+ * @brief Copies a strided region of a tensor to a strided region of another.
+ *
+ * For every index (i_0, ..., i_n-1) below the sizes of axes, copies the element at
+ * input + sum(i_k * axes[k].inputStride) to output + sum(i_k * axes[k].outputStride), where
+ * offsets are in elements of elementSize bytes. Input strides may be negative to read backwards,
+ * or zero to repeat an element. No two indexes may write the same output element, and the
+ * elements read must not be written by the copy.
+ *
+ * The copy is first simplified: axes of size 1 are dropped, axes that are contiguous with the
+ * next one in both tensors are merged, and innermost axes that are contiguous in both tensors
+ * become larger elements, which are copied with memcpy. Long rows that are written along a
+ * different axis than they are read are copied in tiles that stay in cache. Independent rows,
+ * tiles and pieces of large elements are copied in parallel, so that even a fully contiguous copy
+ * uses several threads.
+ *
+ * @param input The first element of the input region.
+ * @param output The first element of the output region.
+ * @param elementSize The size of an element in bytes.
+ * @param axes The axes of the copy, outermost first.
+ * @return true on success.
+ */
+bool copyTensor(const void* input, void* output, size_t elementSize, std::vector<CopyAxis> axes);
+
+/**
+ * @brief Writes the element of elementSize bytes at value to every element of a strided region
+ * of a tensor.
+ *
+ * The input strides of axes are ignored. See copyTensor.
+ */
+bool fillTensor(const void* value, void* output, size_t elementSize, std::vector<CopyAxis> axes);
+
+}  // namespace android::nn
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_CPU_TENSOR_COPY_H
@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_EXECUTION_BURST_CHANNEL_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_EXECUTION_BURST_CHANNEL_H
+
+#include <android-base/logging.h>
+#include <android-base/macros.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android::nn {
+
+/**
+ * IBurstChannel is the transport of the packets sent in one direction of a burst.
+ *
+ * The channel has a single reader and a single writer, and the packet written by one call to
+ * writeBlocking becomes available to the reader all at once. This is the contract of the
+ * synchronized FMQ used between processes, which FmqBurstChannel adapts, and of
+ * InProcessBurstChannel, which is used when both ends of the burst are in the same process.
+ */
+template <typename Datum>
+class IBurstChannel {
+    DISALLOW_COPY_AND_ASSIGN(IBurstChannel);
+
+   public:
+    IBurstChannel() = default;
+    virtual ~IBurstChannel() = default;
+
+    /**
+     * @return The number of elements that can be read without waiting.
+     */
+    virtual size_t availableToRead() const = 0;
+
+    /**
+     * @return The number of elements that can be written without waiting.
+     */
+    virtual size_t availableToWrite() const = 0;
+
+    /**
+     * Reads elements that are already available.
+     *
+     * @return 'true' if count elements were read, 'false' if fewer were available.
+     */
+    virtual bool read(Datum* data, size_t count) = 0;
+
+    /**
+     * Waits until count elements are available and reads them.
+     *
+     * @param timeout How long to wait before giving up, or zero to wait indefinitely.
+     * @return 'true' if count elements were read, 'false' on error or timeout.
+     */
+    virtual bool readBlocking(Datum* data, size_t count, std::chrono::nanoseconds timeout) = 0;
+
+    /**
+     * Writes a packet and wakes up the reader if it is waiting in readBlocking.
+     *
+     * Callers check availableToWrite first: whether writing more elements than are available
+     * waits or fails depends on the transport.
+     *
+     * @return 'true' if the packet was written, 'false' otherwise.
+     */
+    virtual bool writeBlocking(const Datum* data, size_t count) = 0;
+};
+
+/**
+ * BurstPollingPolicy decides how a burst receiver spends the time until its next packet arrives.
+ *
+ * Polling the channel yields lower latencies than waiting on it, but keeps a core busy. Instead of
+ * always polling for the whole polling time window as soon as it starts to wait, the receiver
+ * polls for that window around the time at which the packet is expected, and waits on the
+ * channel before then. The expected latency is a moving average of the latencies observed by the
+ * receiver, so that a receiver waiting on long executions no longer spins for nothing, while a
+ * receiver waiting on executions shorter than the window polls right away.
+ */
+class BurstPollingPolicy {
+   public:
+    struct Schedule {
+        // How long to wait on the channel before starting to poll.
+        std::chrono::nanoseconds waitBeforePolling{0};
+        // How long to poll before waiting on the channel until the packet arrives.
+        std::chrono::nanoseconds pollingDuration{0};
+    };
+
+    /**
+     * @param pollingTimeWindow The longest time the receiver is allowed to poll for a packet.
+     *     Zero disables polling.
+     */
+    explicit BurstPollingPolicy(std::chrono::microseconds pollingTimeWindow);
+
+    /**
+     * @return How to wait for the next packet.
+     */
+    Schedule getSchedule() const;
+
+    /**
+     * Records the time it took for a packet to arrive once the receiver started to wait for it.
+     */
+    void recordLatency(std::chrono::nanoseconds latency);
+
+   private:
+    const std::chrono::nanoseconds kPollingTimeWindow;
+    bool mHasLatency = false;
+    std::chrono::nanoseconds mExpectedLatency{0};
+};
+
+/**
+ * BurstPacketReceiver implements the receiving end of an IBurstChannel, following a
+ * BurstPollingPolicy. It is shared by the request and result channel receivers.
+ */
+template <typename Datum>
+class BurstPacketReceiver {
+    DISALLOW_IMPLICIT_CONSTRUCTORS(BurstPacketReceiver);
+
+   public:
+    /**
+     * @param channel The channel to receive packets from.
+     * @param pollingTimeWindow See BurstPollingPolicy.
+     * @param recordLatencies Whether the time spent waiting for each packet is recorded as a
+     *     latency. This only holds for a receiver that starts to wait when the packet is
+     *     requested, such as the result receiver of a controller. The request receiver of a server
+     *     would record the idle time between requests instead, so it always polls right away.
+     */
+    BurstPacketReceiver(std::shared_ptr<IBurstChannel<Datum>> channel,
+                        std::chrono::microseconds pollingTimeWindow, bool recordLatencies)
+        : mChannel(std::move(channel)),
+          kRecordLatencies(recordLatencies),
+          mPollingPolicy(pollingTimeWindow) {
+        CHECK(mChannel != nullptr);
+    }
+
+    /**
+     * Receives the next packet.
+     *
+     * This method will block until either:
+     * 1) The packet has been retrieved, or
+     * 2) The receiver has been invalidated
+     *
+     * @param packet Receives the packet. Its capacity is reused across calls.
+     * @return 'true' if a packet was received, 'false' on error or if the receiver was
+     *     invalidated.
+     */
+    bool getPacketBlocking(std::vector<Datum>* packet);
+
+    /**
+     * Marks the receiver as invalid, unblocking any current or future calls to
+     * getPacketBlocking.
+     *
+     * @param wakeUpDatum Written to the channel to wake up a reader waiting on it.
+     */
+    void invalidate(const Datum& wakeUpDatum) {
+        mValid = false;
+        mChannel->writeBlocking(&wakeUpDatum, 1);
+    }
+
+    bool isValid() const { return mValid.load(std::memory_order_relaxed); }
+
+    const BurstPollingPolicy& getPollingPolicy() const { return mPollingPolicy; }
+
+   private:
+    bool readPacket(const Datum* first, std::vector<Datum>* packet);
+
+    const std::shared_ptr<IBurstChannel<Datum>> mChannel;
+    const bool kRecordLatencies;
+    BurstPollingPolicy mPollingPolicy;
+    std::atomic<bool> mValid{true};
+};
+
+// Reads the elements of the packet that are available, after first if it was already read.
+template <typename Datum>
+bool BurstPacketReceiver<Datum>::readPacket(const Datum* first, std::vector<Datum>* packet) {
+    // NOTE: the writer publishes each packet in one call, so once any of its elements is
+    // available, all of them are.
+    const size_t offset = first != nullptr ? 1 : 0;
+    const size_t available = mChannel->availableToRead();
+    packet->resize(offset + available);
+    if (first != nullptr) {
+        packet->front() = *first;
+    }
+    return mChannel->read(packet->data() + offset, available);
+}
+
+template <typename Datum>
+bool BurstPacketReceiver<Datum>::getPacketBlocking(std::vector<Datum>* packet) {
+    if (!isValid()) {
+        return false;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    const BurstPollingPolicy::Schedule schedule = mPollingPolicy.getSchedule();
+    bool received = false;
+    bool success = true;
+
+    // Wait until the packet is expected to be close. This returns early if the packet arrives.
+    if (schedule.waitBeforePolling.count() > 0) {
+        Datum first;
+        if (mChannel->readBlocking(&first, 1, schedule.waitBeforePolling)) {
+            received = true;
+            success = readPacket(&first, packet);
+        }
+    }
+
+    // Poll for the packet.
+    if (!received && schedule.pollingDuration.count() > 0) {
+        const auto timeToStopPolling = Clock::now() + schedule.pollingDuration;
+        while (Clock::now() < timeToStopPolling) {
+            // if class is being torn down, immediately return
+            if (!isValid()) {
+                return false;
+            }
+            if (mChannel->availableToRead() > 0) {
+                received = true;
+                success = readPacket(nullptr, packet);
+                break;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    // Wait on the channel until the packet arrives, which saves power.
+    if (!received) {
+        Datum first;
+        success = mChannel->readBlocking(&first, 1, std::chrono::nanoseconds{0});
+        success &= readPacket(&first, packet);
+    }
+
+    if (!isValid()) {
+        return false;
+    }
+
+    // ensure packet was successfully received
+    if (!success) {
+        LOG(ERROR) << "Error receiving packet";
+        return false;
+    }
+
+    if (kRecordLatencies) {
+        mPollingPolicy.recordLatency(Clock::now() - start);
+    }
+    return true;
+}
+
+/**
+ * InProcessBurstChannel is an IBurstChannel for bursts whose controller and server are in the same
+ * process: a ring buffer allocated once, whose reader only takes a lock when it has to wait.
+ */
+template <typename Datum>
+class InProcessBurstChannel final : public IBurstChannel<Datum> {
+   public:
+    /**
+     * @param channelLength Number of elements in the ring buffer.
+     */
+    explicit InProcessBurstChannel(size_t channelLength) : mBuffer(channelLength) {}
+
+    size_t availableToRead() const override {
+        return mWriteIndex.load(std::memory_order_acquire) -
+               mReadIndex.load(std::memory_order_relaxed);
+    }
+
+    size_t availableToWrite() const override {
+        return mBuffer.size() - (mWriteIndex.load(std::memory_order_relaxed) -
+                                 mReadIndex.load(std::memory_order_acquire));
+    }
+
+    bool read(Datum* data, size_t count) override {
+        const uint64_t readIndex = mReadIndex.load(std::memory_order_relaxed);
+        if (mWriteIndex.load(std::memory_order_acquire) - readIndex < count) {
+            return false;
+        }
+        const size_t begin = readIndex % mBuffer.size();
+        const size_t firstPart = std::min(count, mBuffer.size() - begin);
+        std::copy_n(mBuffer.begin() + begin, firstPart, data);
+        std::copy_n(mBuffer.begin(), count - firstPart, data + firstPart);
+        mReadIndex.store(readIndex + count, std::memory_order_release);
+        return true;
+    }
+
+    bool readBlocking(Datum* data, size_t count, std::chrono::nanoseconds timeout) override {
+        if (count > mBuffer.size()) {
+            return false;
+        }
+        if (availableToRead() < count) {
+            // The reader announces that it is waiting before it checks for data, and the writer
+            // publishes data before it checks for a waiting reader, so that one of them always
+            // sees the other. Both use sequentially consistent accesses for this.
+            const auto isAvailable = [this, count] {
+                return mWriteIndex.load() - mReadIndex.load(std::memory_order_relaxed) >= count;
+            };
+            std::unique_lock<std::mutex> lock(mMutex);
+            mReaderWaiting.store(true);
+            if (timeout.count() > 0) {
+                mCondition.wait_for(lock, timeout, isAvailable);
+            } else {
+                mCondition.wait(lock, isAvailable);
+            }
+            mReaderWaiting.store(false, std::memory_order_relaxed);
+        }
+        return read(data, count);
+    }
+
+    bool writeBlocking(const Datum* data, size_t count) override {
+        // Receivers write to the channel to wake up its reader, so writes are serialized.
+        std::lock_guard<std::mutex> guard(mWriterMutex);
+        if (count > availableToWrite()) {
+            return false;
+        }
+        const uint64_t writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+        const size_t begin = writeIndex % mBuffer.size();
+        const size_t firstPart = std::min(count, mBuffer.size() - begin);
+        std::copy_n(data, firstPart, mBuffer.begin() + begin);
+        std::copy_n(data + firstPart, count - firstPart, mBuffer.begin());
+        mWriteIndex.store(writeIndex + count);
+        if (mReaderWaiting.load()) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCondition.notify_one();
+        }
+        return true;
+    }
+
+   private:
+    std::vector<Datum> mBuffer;
+    std::atomic<uint64_t> mReadIndex{0};
+    std::atomic<uint64_t> mWriteIndex{0};
+    std::atomic<bool> mReaderWaiting{false};
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::mutex mWriterMutex;
+};
+
+}  // namespace android::nn
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_EXECUTION_BURST_CHANNEL_H
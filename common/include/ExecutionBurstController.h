@@ -37,6 +37,8 @@
 #include <utility>
 #include <vector>
 
+#include "ExecutionBurstChannel.h"
+
 namespace android::nn {
 
 /**
@@ -59,6 +61,21 @@ std::vector<hardware::neuralnetworks::V1_2::FmqRequestDatum> serialize(
         const hardware::neuralnetworks::V1_0::Request& request,
         hardware::neuralnetworks::V1_2::MeasureTiming measure, const std::vector<int32_t>& slots);
 
+/**
+ * Function to serialize a request into an existing buffer, reusing its
+ * capacity.
+ *
+ * @param request Request object without the pool information.
+ * @param measure Whether to collect timing information for the execution.
+ * @param memoryIds Slot identifiers corresponding to memory resources for the
+ *     request.
+ * @param data Receives the serialized FMQ request data.
+ */
+void serialize(const hardware::neuralnetworks::V1_0::Request& request,
+               hardware::neuralnetworks::V1_2::MeasureTiming measure,
+               const std::vector<int32_t>& slots,
+               std::vector<hardware::neuralnetworks::V1_2::FmqRequestDatum>* data);
+
 /**
  * Deserialize the FMQ result data.
  *
@@ -89,6 +106,9 @@ hardware::neuralnetworks::V1_0::ErrorStatus legacyConvertResultCodeToErrorStatus
  * Because the receiver can wait on a packet that may never come (e.g., because
  * the sending side of the packet has been closed), this object can be
  * invalidated, unblocking the receiver.
+ *
+ * The receiver reuses its packet buffer, so getBlocking must not be called
+ * concurrently.
  */
 class ResultChannelReceiver {
     using FmqResultDescriptor =
@@ -106,7 +126,8 @@ class ResultChannelReceiver {
      * @param pollingTimeWindow How much time (in microseconds) the
      *     ResultChannelReceiver is allowed to poll the FMQ before waiting on
      *     the blocking futex. Polling may result in lower latencies at the
-     *     potential cost of more power usage.
+     *     potential cost of more power usage. The window is scheduled around
+     *     the expected arrival of the result, see BurstPollingPolicy.
      * @return A pair of ResultChannelReceiver and the FMQ descriptor on
      *     successful creation, both nullptr otherwise.
      */
@@ -135,21 +156,26 @@ class ResultChannelReceiver {
     void invalidate();
 
     // prefer calling ResultChannelReceiver::getBlocking
-    std::optional<std::vector<hardware::neuralnetworks::V1_2::FmqResultDatum>> getPacketBlocking();
+    bool getPacketBlocking(std::vector<hardware::neuralnetworks::V1_2::FmqResultDatum>* packet);
 
     ResultChannelReceiver(std::unique_ptr<FmqResultChannel> fmqResultChannel,
                           std::chrono::microseconds pollingTimeWindow);
+    ResultChannelReceiver(
+            std::shared_ptr<IBurstChannel<hardware::neuralnetworks::V1_2::FmqResultDatum>> channel,
+            std::chrono::microseconds pollingTimeWindow);
 
    private:
-    const std::unique_ptr<FmqResultChannel> mFmqResultChannel;
-    std::atomic<bool> mValid{true};
-    const std::chrono::microseconds kPollingTimeWindow;
+    BurstPacketReceiver<hardware::neuralnetworks::V1_2::FmqResultDatum> mReceiver;
+    std::vector<hardware::neuralnetworks::V1_2::FmqResultDatum> mPacket;
 };
 
 /**
  * RequestChannelSender is responsible for serializing the result packet of
  * information, sending it on the result channel, and signaling that the data is
  * available.
+ *
+ * The sender reuses its packet buffer, so send must not be called
+ * concurrently.
  */
 class RequestChannelSender {
     using FmqRequestDescriptor =
@@ -195,10 +221,15 @@ class RequestChannelSender {
     bool sendPacket(const std::vector<hardware::neuralnetworks::V1_2::FmqRequestDatum>& packet);
 
     RequestChannelSender(std::unique_ptr<FmqRequestChannel> fmqRequestChannel);
+    RequestChannelSender(
+            std::shared_ptr<IBurstChannel<hardware::neuralnetworks::V1_2::FmqRequestDatum>>
+                    channel);
 
    private:
-    const std::unique_ptr<FmqRequestChannel> mFmqRequestChannel;
+    const std::shared_ptr<IBurstChannel<hardware::neuralnetworks::V1_2::FmqRequestDatum>>
+            mChannel;
     std::atomic<bool> mValid{true};
+    std::vector<hardware::neuralnetworks::V1_2::FmqRequestDatum> mPacket;
 };
 
 /**
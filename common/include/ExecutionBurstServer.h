@@ -34,6 +34,8 @@
 #include <tuple>
 #include <vector>
 
+#include "ExecutionBurstChannel.h"
+
 namespace android::nn {
 
 using FmqRequestDescriptor =
@@ -56,6 +58,19 @@ std::vector<hardware::neuralnetworks::V1_2::FmqResultDatum> serialize(
         const std::vector<hardware::neuralnetworks::V1_2::OutputShape>& outputShapes,
         hardware::neuralnetworks::V1_2::Timing timing);
 
+/**
+ * Function to serialize results into an existing buffer, reusing its capacity.
+ *
+ * @param errorStatus Status of the execution.
+ * @param outputShapes Dynamic shapes of the output tensors.
+ * @param timing Timing information of the execution.
+ * @param data Receives the serialized FMQ result data.
+ */
+void serialize(hardware::neuralnetworks::V1_0::ErrorStatus errorStatus,
+               const std::vector<hardware::neuralnetworks::V1_2::OutputShape>& outputShapes,
+               hardware::neuralnetworks::V1_2::Timing timing,
+               std::vector<hardware::neuralnetworks::V1_2::FmqResultDatum>* data);
+
 /**
  * Deserialize the FMQ request data.
  *
@@ -78,6 +93,9 @@ deserialize(const std::vector<hardware::neuralnetworks::V1_2::FmqRequestDatum>&
  * Because the receiver can wait on a packet that may never come (e.g., because
  * the sending side of the packet has been closed), this object can be
  * invalidated, unblocking the receiver.
+ *
+ * The receiver reuses its packet buffer, so getBlocking must not be called
+ * concurrently.
  */
 class RequestChannelReceiver {
     using FmqRequestChannel =
@@ -94,7 +112,9 @@ class RequestChannelReceiver {
      * @param pollingTimeWindow How much time (in microseconds) the
      *     RequestChannelReceiver is allowed to poll the FMQ before waiting on
      *     the blocking futex. Polling may result in lower latencies at the
-     *     potential cost of more power usage.
+     *     potential cost of more power usage. The receiver polls as soon as
+     *     it starts to wait, because the time until the next request is the
+     *     idle time of the client rather than an execution latency.
      * @return RequestChannelReceiver on successful creation, nullptr otherwise.
      */
     static std::unique_ptr<RequestChannelReceiver> create(
@@ -123,19 +143,25 @@ class RequestChannelReceiver {
 
     RequestChannelReceiver(std::unique_ptr<FmqRequestChannel> fmqRequestChannel,
                            std::chrono::microseconds pollingTimeWindow);
+    RequestChannelReceiver(
+            std::shared_ptr<IBurstChannel<hardware::neuralnetworks::V1_2::FmqRequestDatum>>
+                    channel,
+            std::chrono::microseconds pollingTimeWindow);
 
    private:
-    std::optional<std::vector<hardware::neuralnetworks::V1_2::FmqRequestDatum>> getPacketBlocking();
+    bool getPacketBlocking(std::vector<hardware::neuralnetworks::V1_2::FmqRequestDatum>* packet);
 
-    const std::unique_ptr<FmqRequestChannel> mFmqRequestChannel;
-    std::atomic<bool> mTeardown{false};
-    const std::chrono::microseconds kPollingTimeWindow;
+    BurstPacketReceiver<hardware::neuralnetworks::V1_2::FmqRequestDatum> mReceiver;
+    std::vector<hardware::neuralnetworks::V1_2::FmqRequestDatum> mPacket;
 };
 
 /**
  * ResultChannelSender is responsible for serializing the result packet of
  * information, sending it on the result channel, and signaling that the data is
  * available.
+ *
+ * The sender reuses its packet buffer, so send must not be called
+ * concurrently.
  */
 class ResultChannelSender {
     using FmqResultChannel = hardware::MessageQueue<hardware::neuralnetworks::V1_2::FmqResultDatum,
@@ -168,9 +194,14 @@ class ResultChannelSender {
     bool sendPacket(const std::vector<hardware::neuralnetworks::V1_2::FmqResultDatum>& packet);
 
     ResultChannelSender(std::unique_ptr<FmqResultChannel> fmqResultChannel);
+    ResultChannelSender(
+            std::shared_ptr<IBurstChannel<hardware::neuralnetworks::V1_2::FmqResultDatum>>
+                    channel);
 
    private:
-    const std::unique_ptr<FmqResultChannel> mFmqResultChannel;
+    const std::shared_ptr<IBurstChannel<hardware::neuralnetworks::V1_2::FmqResultDatum>>
+            mChannel;
+    std::vector<hardware::neuralnetworks::V1_2::FmqResultDatum> mPacket;
 };
 
 /**
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_FMQ_BURST_CHANNEL_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_FMQ_BURST_CHANNEL_H
+
+#include <fmq/MessageQueue.h>
+
+#include <chrono>
+#include <memory>
+#include <utility>
+
+#include "ExecutionBurstChannel.h"
+
+namespace android::nn {
+
+/**
+ * FmqBurstChannel adapts a synchronized FMQ with an EventFlag to IBurstChannel, so that the burst
+ * controller and server can communicate across processes.
+ */
+template <typename Datum>
+class FmqBurstChannel final : public IBurstChannel<Datum> {
+   public:
+    using FmqChannel = hardware::MessageQueue<Datum, hardware::kSynchronizedReadWrite>;
+
+    explicit FmqBurstChannel(std::unique_ptr<FmqChannel> fmqChannel)
+        : mFmqChannel(std::move(fmqChannel)) {}
+
+    size_t availableToRead() const override { return mFmqChannel->availableToRead(); }
+
+    size_t availableToWrite() const override { return mFmqChannel->availableToWrite(); }
+
+    bool read(Datum* data, size_t count) override { return mFmqChannel->read(data, count); }
+
+    bool readBlocking(Datum* data, size_t count, std::chrono::nanoseconds timeout) override {
+        return mFmqChannel->readBlocking(data, count, timeout.count());
+    }
+
+    bool writeBlocking(const Datum* data, size_t count) override {
+        return mFmqChannel->writeBlocking(data, count);
+    }
+
+   private:
+    const std::unique_ptr<FmqChannel> mFmqChannel;
+};
+
+}  // namespace android::nn
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_FMQ_BURST_CHANNEL_H
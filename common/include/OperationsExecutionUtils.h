@@ -18,8 +18,12 @@
 #define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_OPERATIONS_EXECUTION_UTILS_H
 
 #include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <limits>
+#include <mutex>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "OperationsUtils.h"
@@ -35,6 +39,119 @@ enum PaddingScheme {
     kPaddingValid = 2,
 };
 
+// A non-owning view of the type, dimensions and quantization parameters of an
+// operand during operation execution.
+//
+// Unlike Shape, a ShapeView can be obtained without copying the dimensions, so
+// it should be preferred when an operation only needs to inspect the rank or a
+// few dimensions of an operand. The view refers to the operand's storage and is
+// invalidated when the operand's shape is updated, e.g. by setOutputShape().
+class ShapeView {
+   public:
+    ShapeView(OperandType type, const std::vector<uint32_t>& dimensions, float scale,
+              int32_t offset, const Operand::ExtraParams& extraParams)
+        : mType(type),
+          mDimensions(&dimensions),
+          mScale(scale),
+          mOffset(offset),
+          mExtraParams(&extraParams) {}
+
+    OperandType type() const { return mType; }
+    const std::vector<uint32_t>& dimensions() const { return *mDimensions; }
+    float scale() const { return mScale; }
+    int32_t offset() const { return mOffset; }
+    const Operand::ExtraParams& extraParams() const { return *mExtraParams; }
+
+    // Makes an owning copy, e.g. to pass to a kernel or to setOutputShape().
+    Shape toShape() const {
+        return {.type = mType,
+                .dimensions = *mDimensions,
+                .scale = mScale,
+                .offset = mOffset,
+                .extraParams = *mExtraParams};
+    }
+
+   private:
+    OperandType mType;
+    const std::vector<uint32_t>* mDimensions;
+    float mScale;
+    int32_t mOffset;
+    const Operand::ExtraParams* mExtraParams;
+};
+
+inline uint32_t getNumberOfDimensions(const ShapeView& shape) {
+    return shape.dimensions().size();
+}
+
+inline uint32_t getSizeOfDimension(const ShapeView& shape, uint32_t dimensionIdx) {
+    CHECK_LT(dimensionIdx, shape.dimensions().size());
+    return shape.dimensions()[dimensionIdx];
+}
+
+inline uint32_t getNumberOfElements(const ShapeView& shape) {
+    uint32_t count = 1;
+    for (uint32_t dimension : shape.dimensions()) {
+        count *= dimension;
+    }
+    return count;
+}
+
+inline uint32_t hasKnownRank(const ShapeView& shape) {
+    return !shape.dimensions().empty();
+}
+
+// A bump allocator for the temporary buffers of a single operation execution.
+//
+// Allocations are aligned to a cache line and are all released at once by reset(), which the
+// executor calls after each operation. The memory itself is kept: if an operation needed more
+// than the current block, reset() replaces the block with one that fits the whole operation, so
+// that after the first few operations kernels no longer allocate and reuse the same, likely
+// cached, memory.
+class ScratchWorkspace {
+   public:
+    static constexpr size_t kAlignment = 64;
+
+    ScratchWorkspace() = default;
+    ~ScratchWorkspace();
+    ScratchWorkspace(const ScratchWorkspace&) = delete;
+    ScratchWorkspace& operator=(const ScratchWorkspace&) = delete;
+
+    // Returns uninitialized memory for size bytes, or nullptr if out of memory. May be called
+    // concurrently, e.g. from the chunks of a parallelFor.
+    void* allocate(size_t size);
+
+    // Returns uninitialized memory for count objects of type T, or nullptr if out of memory.
+    template <typename T>
+    T* allocate(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        static_assert(alignof(T) <= kAlignment);
+        if (count > std::numeric_limits<size_t>::max() / sizeof(T)) {
+            return nullptr;
+        }
+        return static_cast<T*>(allocate(count * sizeof(T)));
+    }
+
+    // Invalidates all the allocations. Must not be called concurrently with allocate().
+    void reset();
+
+    size_t getCapacity() const { return mCapacity; }
+
+    // Returns the number of blocks allocated since construction. Must not be called concurrently
+    // with allocate().
+    size_t getNumAllocations() const { return mNumAllocations; }
+
+   private:
+    uint8_t* mBlock = nullptr;
+    size_t mCapacity = 0;
+    // Bytes requested since the last reset, including the ones that did not fit in mBlock.
+    std::atomic<size_t> mUsed = 0;
+    size_t mNumAllocations = 0;
+
+    // Allocations that did not fit in mBlock.
+    std::mutex mOverflowMutex;
+    std::vector<void*> mOverflowBlocks;
+};
+
 // Provides inputs and outputs during operation execution.
 class IOperationExecutionContext {
    public:
@@ -43,12 +160,16 @@ class IOperationExecutionContext {
     virtual uint32_t getNumInputs() const = 0;
     virtual OperandType getInputType(uint32_t index) const = 0;
     virtual Shape getInputShape(uint32_t index) const = 0;
+    // Same as getInputShape but does not copy the dimensions. See ShapeView.
+    virtual ShapeView getInputShapeView(uint32_t index) const = 0;
     virtual const void* getInputBuffer(uint32_t index) const = 0;
     virtual const Operand::ExtraParams& getInputExtraParams(uint32_t index) const = 0;
 
     virtual uint32_t getNumOutputs() const = 0;
     virtual OperandType getOutputType(uint32_t index) const = 0;
     virtual Shape getOutputShape(uint32_t index) const = 0;
+    // Same as getOutputShape but does not copy the dimensions. See ShapeView.
+    virtual ShapeView getOutputShapeView(uint32_t index) const = 0;
     virtual void* getOutputBuffer(uint32_t index) = 0;
 
     // Updates the output shape, allocating the buffer if necessary.
@@ -57,6 +178,9 @@ class IOperationExecutionContext {
     virtual bool isOmittedInput(uint32_t index) const = 0;
     virtual bool isOmittedOutput(uint32_t index) const = 0;
 
+    // Temporary memory that stays valid until the operation finishes executing.
+    virtual ScratchWorkspace* getScratchWorkspace() = 0;
+
     template <typename T>
     const T* getInputBuffer(uint32_t index) const {
         return reinterpret_cast<const T*>(getInputBuffer(index));
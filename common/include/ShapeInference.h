@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_SHAPE_INFERENCE_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_SHAPE_INFERENCE_H
+
+#include "OperationResolver.h"
+#include "nnapi/Types.h"
+
+namespace android::nn {
+
+/**
+ * @brief Specifies the dimensions of the temporaries of the main subgraph that are known before
+ * execution.
+ *
+ * The shapes of the main subgraph inputs that are fully specified and of the constants are
+ * propagated through the operations in execution order with the prepare() functions of the
+ * operation resolver, which CpuExecutor otherwise only calls during execution. A temporary whose
+ * declared dimensions are not fully specified gets the dimensions computed for it if they are
+ * fully specified.
+ *
+ * An operation is skipped, and so are the operations that depend on its outputs, if it is not
+ * registered with a prepare() function, if one of its inputs has dimensions that are not fully
+ * specified, or if one of its scalar or TENSOR_INT32 inputs has a value that is only known during
+ * execution. Output shapes computed from the value of any other input that is only known during
+ * execution are discarded. Operations whose prepare() fails are skipped, so that their errors are
+ * still reported during execution.
+ *
+ * The inputs and outputs of the main subgraph and the referenced subgraphs are left unchanged.
+ *
+ * @pre model != nullptr
+ * @pre operationResolver != nullptr
+ *
+ * @param model The model whose temporaries are specified.
+ * @param operationResolver The resolver providing the prepare() functions of the operations.
+ * @return The number of temporaries whose dimensions became fully specified.
+ */
+uint32_t inferTemporaryShapes(
+        Model* model,
+        const IOperationResolver* operationResolver = BuiltinOperationResolver::get());
+
+}  // namespace android::nn
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_SHAPE_INFERENCE_H
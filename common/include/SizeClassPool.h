@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_SIZE_CLASS_POOL_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_SIZE_CLASS_POOL_H
+
+#include <android-base/macros.h>
+#include <android-base/thread_annotations.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace android::nn {
+
+// Rounds an allocation size up to its size class, so that allocations of similar sizes can reuse
+// each other's memory. There are four size classes per power of two, which bounds the unused
+// part of an allocation to a quarter of its size.
+inline size_t getSizeClass(size_t size) {
+    constexpr size_t kMinSizeClass = 64;
+    if (size <= kMinSizeClass) {
+        return kMinSizeClass;
+    }
+    size_t power = kMinSizeClass;
+    while (power * 2 < size) {
+        power *= 2;
+    }
+    const size_t step = power / 4;
+    return (size + step - 1) / step * step;
+}
+
+struct PoolStatistics {
+    // The number of acquire() calls, and the number of them that reused a cached resource.
+    uint64_t numAcquires = 0;
+    uint64_t numReuses = 0;
+    // The number of release() calls, and the number of resources they destroyed instead of
+    // caching because the pool was full.
+    uint64_t numReleases = 0;
+    uint64_t numDiscards = 0;
+    // The number of trim() calls.
+    uint64_t numTrims = 0;
+    // The resources cached now.
+    uint64_t numCachedResources = 0;
+    uint64_t cachedBytes = 0;
+};
+
+// A cache of released resources, such as memory allocations, keyed by their size. An allocator
+// acquires a cached resource of the size it needs before it allocates a new one, and releases the
+// resource to the pool instead of freeing it. The pool holds at most maxCachedResources resources
+// and maxCachedBytes, and destroys the resources released beyond that. trim() destroys every
+// cached resource, for when memory is low.
+//
+// A reused resource keeps the contents it had when it was released.
+//
+// This class is thread-safe. Resources are destroyed without holding the lock.
+template <typename Resource>
+class SizeClassPool {
+    DISALLOW_COPY_AND_ASSIGN(SizeClassPool);
+
+   public:
+    SizeClassPool(size_t maxCachedResources, size_t maxCachedBytes)
+        : kMaxCachedResources(maxCachedResources), kMaxCachedBytes(maxCachedBytes) {}
+
+    // Takes a cached resource of the given size, or returns std::nullopt if there is none.
+    std::optional<Resource> acquire(size_t size) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        ++mStatistics.numAcquires;
+        const auto it = mResources.find(size);
+        if (it == mResources.end()) {
+            return std::nullopt;
+        }
+        // The most recently released resource is the most likely to be in the cache.
+        std::optional<Resource> resource = std::move(it->second.back());
+        it->second.pop_back();
+        if (it->second.empty()) {
+            mResources.erase(it);
+        }
+        ++mStatistics.numReuses;
+        --mStatistics.numCachedResources;
+        mStatistics.cachedBytes -= size;
+        return resource;
+    }
+
+    // Caches a resource of the given size, or destroys it if the pool is full.
+    void release(size_t size, Resource resource) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        ++mStatistics.numReleases;
+        if (mStatistics.numCachedResources >= kMaxCachedResources ||
+            mStatistics.cachedBytes + size > kMaxCachedBytes) {
+            // resource is destroyed when this function returns, after the lock is released.
+            ++mStatistics.numDiscards;
+            return;
+        }
+        mResources[size].push_back(std::move(resource));
+        ++mStatistics.numCachedResources;
+        mStatistics.cachedBytes += size;
+    }
+
+    // Destroys every cached resource.
+    void trim() {
+        // Declared before the lock so that the resources are destroyed after it is released.
+        std::map<size_t, std::vector<Resource>> resources;
+        std::lock_guard<std::mutex> lock(mMutex);
+        mResources.swap(resources);
+        ++mStatistics.numTrims;
+        mStatistics.numCachedResources = 0;
+        mStatistics.cachedBytes = 0;
+    }
+
+    PoolStatistics getStatistics() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mStatistics;
+    }
+
+   private:
+    mutable std::mutex mMutex;
+    const size_t kMaxCachedResources;
+    const size_t kMaxCachedBytes;
+    std::map<size_t, std::vector<Resource>> mResources GUARDED_BY(mMutex);
+    PoolStatistics mStatistics GUARDED_BY(mMutex);
+};
+
+}  // namespace android::nn
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_SIZE_CLASS_POOL_H
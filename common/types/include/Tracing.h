@@ -22,6 +22,8 @@
 #include <utils/Trace.h>
 #endif  // NN_COMPATIBILITY_LIBRARY_BUILD
 
+#include "nnapi/TraceRecorder.h"
+
 // Neural Networks API (NNAPI) systracing
 //
 // Primary goal of the tracing is to capture and present timings for NNAPI.
@@ -32,8 +34,10 @@
 //  1 Trace macros defined in this file and used throughout the codebase,
 //    modelled after and using atrace. These implement a naming convention for
 //    the tracepoints, interpreted by the systrace parser.
-//  2 Android systrace (atrace) on-device capture and host-based analysis.
-//  3 A systrace parser (TODO) to summarize the timings.
+//  2 Android systrace (atrace) on-device capture and host-based analysis, or
+//    the in-memory TraceRecorder (see nnapi/TraceRecorder.h) on hosts and
+//    wherever atrace is not available.
+//  3 A systrace parser (tools/systrace_parser) to summarize the timings.
 //
 // For an overview and introduction, please refer to the "NNAPI Systrace design
 // and HOWTO" (internal Docs for now). This header doesn't try to replicate all
@@ -121,8 +125,9 @@
 #define NNTRACE_FULL_SUBTRACT(layer, phase, detail) \
     NNTRACE_NAME_1(("[SUB][NN_" layer "_" phase "]" detail))
 // Raw macro without scoping requirements, for special cases
-#define NNTRACE_FULL_RAW(layer, phase, detail) \
-    android::ScopedTrace PASTE(___tracer, __LINE__)(ATRACE_TAG, ("[NN_" layer "_" phase "]" detail))
+#define NNTRACE_FULL_RAW(layer, phase, detail)                     \
+    ::android::nn::ScopedTrace NNTRACE_PASTE(___tracer, __LINE__)( \
+            ("[NN_" layer "_" phase "]" detail))
 
 // Tracing buckets - for calculating timing summaries over.
 //
@@ -151,28 +156,52 @@
 #define NNTRACE_LAYER_OTHER "LO"
 #define NNTRACE_LAYER_UTILITY "LU"  // Code used from multiple layers
 
-#ifndef NN_COMPATIBILITY_LIBRARY_BUILD
-
 // Implementation
 //
+// Traces a scope with atrace, if available, and with the TraceRecorder while
+// it is recording.
+namespace android::nn {
+
+class ScopedTrace {
+   public:
+    explicit ScopedTrace(const char* name)
+        :
+#ifndef NN_COMPATIBILITY_LIBRARY_BUILD
+          mAtrace(ATRACE_TAG, name),
+#endif  // NN_COMPATIBILITY_LIBRARY_BUILD
+          mIsRecorded(TraceRecorder::isRecording()) {
+        if (mIsRecorded) TraceRecorder::recordBegin(name);
+    }
+    ~ScopedTrace() {
+        if (mIsRecorded) TraceRecorder::recordEnd();
+    }
+    ScopedTrace(const ScopedTrace&) = delete;
+    ScopedTrace& operator=(const ScopedTrace&) = delete;
+
+   private:
+#ifndef NN_COMPATIBILITY_LIBRARY_BUILD
+    ::android::ScopedTrace mAtrace;
+#endif  // NN_COMPATIBILITY_LIBRARY_BUILD
+    const bool mIsRecorded;
+};
+
+}  // namespace android::nn
+
 // Almost same as ATRACE_NAME, but enforcing explicit distinction between
 // phase-per-scope and switching phases.
 //
 // Basic trace, one per scope allowed to enforce disjointness
-#define NNTRACE_NAME_1(name) ::android::ScopedTrace ___tracer_1(ATRACE_TAG, name)
+#define NNTRACE_NAME_1(name) ::android::nn::ScopedTrace ___tracer_1(name)
 // Switching trace, more than one per scope allowed, translated by
 // systrace_parser.py. This is mainly useful for tracing multiple phases through
 // one function / scope.
 #define NNTRACE_NAME_SWITCH(name)                                        \
-    ::android::ScopedTrace PASTE(___tracer, __LINE__)(ATRACE_TAG, name); \
+    ::android::nn::ScopedTrace NNTRACE_PASTE(___tracer, __LINE__)(name); \
     (void)___tracer_1  // ensure switch is only used after a basic trace
 
-#else
-
-#define NNTRACE_NAME_1(name)       // empty
-#define NNTRACE_NAME_SWITCH(name)  // empty
-
-#endif  // NN_COMPATIBILITY_LIBRARY_BUILD
+// Same as PASTE of utils/Trace.h, which is not available to all builds.
+#define NNTRACE_PASTE_IMPL(x, y) x##y
+#define NNTRACE_PASTE(x, y) NNTRACE_PASTE_IMPL(x, y)
 
 // Disallow use of raw ATRACE macros
 #undef ATRACE_NAME
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_TYPES_NNAPI_TRACE_RECORDER_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_TYPES_NNAPI_TRACE_RECORDER_H
+
+#include <atomic>
+#include <ostream>
+#include <string>
+
+namespace android::nn {
+
+// In-memory backend of the NNTRACE macros (see Tracing.h), for hosts and processes where atrace
+// is not available.
+//
+// While it is recording, every traced scope is recorded as a begin and an end event in a ring
+// buffer owned by the thread, which the thread writes without locking. The events are written as
+// a trace in the Chrome trace event format, which chrome://tracing and Perfetto open and
+// tools/systrace_parser analyzes. When a ring buffer is full, new scopes of its thread are dropped
+// until events are written out.
+//
+// Recording starts when the process starts if the environment variable NNAPI_TRACE_FILE is set.
+// The trace is then written to the file it names when the process exits. Otherwise, recording is
+// controlled with start() and stop(). When not recording, a traced scope costs one relaxed atomic
+// load.
+class TraceRecorder {
+   public:
+    static bool isRecording() { return sIsRecording.load(std::memory_order_relaxed); }
+
+    // Discards the events recorded so far and starts recording.
+    static void start();
+
+    // Stops recording new scopes. The scopes that are open still record their ends.
+    static void stop();
+
+    // Writes the events recorded since they were last written, as a Chrome trace.
+    static void writeChromeTrace(std::ostream& os);
+    static bool writeChromeTrace(const std::string& filename);
+
+    // Used by the NNTRACE macros. name must be a string literal.
+    static void recordBegin(const char* name);
+    static void recordEnd();
+
+   private:
+    static std::atomic<bool> sIsRecording;
+};
+
+}  // namespace android::nn
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_COMMON_TYPES_NNAPI_TRACE_RECORDER_H
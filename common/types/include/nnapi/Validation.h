@@ -80,6 +80,35 @@ Result<Version> validate(const std::vector<ExtensionNameAndPrefix>& extensionNam
 Result<Version> validateRequestForModel(const Request& request, const Model& model,
                                         bool allowUnspecifiedOutput = true);
 
+// The part of validateRequestForModel that depends only on the model: what each input and output
+// of the main subgraph allows a request argument to be. A driver that validates many requests
+// against the same model can create the plan once, when the model is prepared.
+struct RequestValidationPlan {
+    struct Argument {
+        OperandType type{};
+        // The dimensions of the operand in the model.
+        Dimensions dimensions;
+        bool isExtensionType = false;
+        // The model does not specify the rank of the tensor.
+        bool hasUnknownRank = false;
+        // The model sets at least one dimension of the tensor to 0.
+        bool hasUnspecifiedDimensions = false;
+        // The size of the operand with the model dimensions, or 0 if it is unknown.
+        size_t lengthOfModelShape = 0;
+    };
+    std::vector<Argument> inputs;
+    std::vector<Argument> outputs;
+};
+
+// Creates the plan to validate requests for the model.
+// This function assumes that `model` has already been validated.
+RequestValidationPlan createRequestValidationPlan(const Model& model);
+
+// Same as validateRequestForModel, but checks the arguments against a plan created by
+// createRequestValidationPlan for the model.
+Result<Version> validateRequestForModel(const Request& request, const RequestValidationPlan& plan,
+                                        bool allowUnspecifiedOutput = true);
+
 // Validate memory descriptor.
 enum class IOType { INPUT, OUTPUT };
 using PreparedModelRole = std::tuple<const IPreparedModel*, IOType, uint32_t>;
@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TraceRecorder"
+
+#include "TraceRecorder.h"
+
+#include <android-base/logging.h>
+#include <android-base/thread_annotations.h>
+#include <android-base/threads.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace android::nn {
+namespace {
+
+constexpr char kTraceFileVariable[] = "NNAPI_TRACE_FILE";
+
+// The number of events that the ring buffer of a thread holds, 256 KiB.
+constexpr uint64_t kTraceBufferCapacity = 1 << 14;
+
+struct TraceEvent {
+    int64_t timeNs;
+    // The name of the scope for a begin event, null for an end event.
+    const char* name;
+};
+
+int64_t getTimeNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+// Single-producer single-consumer ring buffer of the events of one thread. The thread produces
+// events without locking, and TraceRecorder consumes them while holding the registry lock.
+class TraceBuffer {
+   public:
+    TraceBuffer() : kThreadId(base::GetThreadId()) {}
+
+    // Producer side.
+
+    void recordBegin(const char* name) {
+        const uint64_t head = mHead.load(std::memory_order_relaxed);
+        const uint64_t tail = mTail.load(std::memory_order_acquire);
+        // A scope is only recorded if there is room left for its end and the ends of the open
+        // scopes, and if no enclosing scope was dropped, so that the ends match the begins.
+        if (mNumDroppedScopes > 0 || kTraceBufferCapacity - (head - tail) < mNumOpenScopes + 2) {
+            ++mNumDroppedScopes;
+            mTotalDroppedScopes.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        mEvents[head % kTraceBufferCapacity] = {.timeNs = getTimeNs(), .name = name};
+        mHead.store(head + 1, std::memory_order_release);
+        ++mNumOpenScopes;
+    }
+
+    void recordEnd() {
+        if (mNumDroppedScopes > 0) {
+            --mNumDroppedScopes;
+            return;
+        }
+        if (mNumOpenScopes == 0) {
+            return;
+        }
+        const uint64_t head = mHead.load(std::memory_order_relaxed);
+        mEvents[head % kTraceBufferCapacity] = {.timeNs = getTimeNs(), .name = nullptr};
+        mHead.store(head + 1, std::memory_order_release);
+        --mNumOpenScopes;
+    }
+
+    // Consumer side.
+
+    // Writes the events recorded since the last call as Chrome trace events. An end event is
+    // skipped if its begin event was discarded by clear().
+    void write(std::ostream& os, int processId, bool* isFirstEvent) {
+        const uint64_t tail = mTail.load(std::memory_order_relaxed);
+        const uint64_t head = mHead.load(std::memory_order_acquire);
+        for (uint64_t i = tail; i < head; ++i) {
+            const TraceEvent& event = mEvents[i % kTraceBufferCapacity];
+            if (event.name == nullptr) {
+                if (mNumOpenWrittenScopes == 0) {
+                    continue;
+                }
+                --mNumOpenWrittenScopes;
+            } else {
+                ++mNumOpenWrittenScopes;
+            }
+            os << (*isFirstEvent ? "\n" : ",\n") << "{\"ph\":\"" << (event.name ? 'B' : 'E')
+               << "\",\"pid\":" << processId << ",\"tid\":" << kThreadId
+               << ",\"ts\":" << event.timeNs / 1000 << '.' << std::setw(3) << std::setfill('0')
+               << event.timeNs % 1000 << std::setfill(' ');
+            if (event.name != nullptr) {
+                os << ",\"name\":\"";
+                for (const char* c = event.name; *c != '\0'; ++c) {
+                    if (*c == '"' || *c == '\\') os << '\\';
+                    os << *c;
+                }
+                os << '"';
+            }
+            os << '}';
+            *isFirstEvent = false;
+        }
+        mTail.store(head, std::memory_order_release);
+    }
+
+    // Discards the events recorded so far.
+    void clear() {
+        mTail.store(mHead.load(std::memory_order_acquire), std::memory_order_release);
+        mNumOpenWrittenScopes = 0;
+    }
+
+    bool isEmpty() const {
+        return mTail.load(std::memory_order_relaxed) == mHead.load(std::memory_order_acquire);
+    }
+
+    uint64_t takeTotalDroppedScopes() { return mTotalDroppedScopes.exchange(0); }
+
+   private:
+    const uint64_t kThreadId;
+    std::array<TraceEvent, kTraceBufferCapacity> mEvents;
+    std::atomic<uint64_t> mHead = 0;
+    std::atomic<uint64_t> mTail = 0;
+    std::atomic<uint64_t> mTotalDroppedScopes = 0;
+
+    // Only accessed by the producer.
+    uint64_t mNumOpenScopes = 0;
+    uint64_t mNumDroppedScopes = 0;
+
+    // Only accessed by the consumer.
+    uint64_t mNumOpenWrittenScopes = 0;
+};
+
+struct TraceRegistry {
+    std::mutex mutex;
+    // A buffer outlives its thread until its events are written.
+    std::vector<std::shared_ptr<TraceBuffer>> buffers GUARDED_BY(mutex);
+};
+
+TraceRegistry& getTraceRegistry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+TraceBuffer* getThreadTraceBuffer() {
+    thread_local const std::shared_ptr<TraceBuffer> buffer = [] {
+        auto buffer = std::make_shared<TraceBuffer>();
+        TraceRegistry& registry = getTraceRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.buffers.push_back(buffer);
+        return buffer;
+    }();
+    return buffer.get();
+}
+
+bool startRecordingFromEnvironment() {
+    if (std::getenv(kTraceFileVariable) == nullptr) {
+        return false;
+    }
+    // The registry is created first so that it is destroyed after the trace is written.
+    getTraceRegistry();
+    std::atexit([] {
+        if (const char* filename = std::getenv(kTraceFileVariable); filename != nullptr) {
+            TraceRecorder::writeChromeTrace(filename);
+        }
+    });
+    return true;
+}
+
+}  // namespace
+
+std::atomic<bool> TraceRecorder::sIsRecording = startRecordingFromEnvironment();
+
+void TraceRecorder::start() {
+    TraceRegistry& registry = getTraceRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const auto& buffer : registry.buffers) {
+        buffer->clear();
+    }
+    sIsRecording = true;
+}
+
+void TraceRecorder::stop() {
+    sIsRecording = false;
+}
+
+void TraceRecorder::writeChromeTrace(std::ostream& os) {
+    const int processId = getpid();
+    uint64_t numDroppedScopes = 0;
+    bool isFirstEvent = true;
+    os << "{\"traceEvents\":[";
+    {
+        TraceRegistry& registry = getTraceRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const auto& buffer : registry.buffers) {
+            buffer->write(os, processId, &isFirstEvent);
+            numDroppedScopes += buffer->takeTotalDroppedScopes();
+        }
+        // Forget the buffers of the threads that exited, once their events are written.
+        auto& buffers = registry.buffers;
+        buffers.erase(std::remove_if(buffers.begin(), buffers.end(),
+                                     [](const std::shared_ptr<TraceBuffer>& buffer) {
+                                         return buffer.use_count() == 1 && buffer->isEmpty();
+                                     }),
+                      buffers.end());
+    }
+    os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    if (numDroppedScopes > 0) {
+        LOG(WARNING) << "Dropped " << numDroppedScopes
+                     << " trace scopes because the trace buffers were full";
+    }
+}
+
+bool TraceRecorder::writeChromeTrace(const std::string& filename) {
+    std::ofstream file(filename);
+    writeChromeTrace(file);
+    file.close();
+    if (!file) {
+        LOG(ERROR) << "Failed to write the trace to " << filename;
+        return false;
+    }
+    return true;
+}
+
+void TraceRecorder::recordBegin(const char* name) {
+    getThreadTraceBuffer()->recordBegin(name);
+}
+
+void TraceRecorder::recordEnd() {
+    getThreadTraceBuffer()->recordEnd();
+}
+
+}  // namespace android::nn
@@ -1143,103 +1143,130 @@ Result<Version> validateTokenValuePair(const TokenValuePair& /*tokenValuePair*/)
     return kVersionFeatureLevel8;
 }
 
-Result<Version> validateRequestArgumentsForModel(
+RequestValidationPlan::Argument createRequestArgumentPlan(const Operand& operand) {
+    RequestValidationPlan::Argument argument = {
+            .type = operand.type,
+            .dimensions = operand.dimensions,
+            .isExtensionType = isExtension(operand.type),
+    };
+    const uint32_t modelRank = operand.dimensions.size();
+    const bool hasUnknownRank =
+            !argument.isExtensionType && !isNonExtensionScalar(operand.type) && modelRank == 0;
+    argument.hasUnknownRank = hasUnknownRank;
+    argument.hasUnspecifiedDimensions =
+            std::find(operand.dimensions.begin(), operand.dimensions.end(), 0) !=
+            operand.dimensions.end();
+    if (!argument.isExtensionType) {
+        argument.lengthOfModelShape =
+                getNonExtensionSize(operand.type, operand.dimensions).value_or(0);
+    }
+    return argument;
+}
+
+Result<Version> validateRequestArgumentsForPlan(
         const std::vector<Request::Argument>& requestArguments,
-        const std::vector<uint32_t>& operandIndexes, const std::vector<Operand>& operands,
-        bool isOutput, bool allowUnspecifiedOutput) {
+        const std::vector<RequestValidationPlan::Argument>& plan, bool isOutput,
+        bool allowUnspecifiedOutput) {
     auto version = kVersionFeatureLevel1;
     // The request should specify as many arguments as were described in the model.
     const std::string_view type = isOutput ? "output" : "input";
     const size_t requestArgumentCount = requestArguments.size();
-    NN_RET_CHECK_EQ(requestArgumentCount, operandIndexes.size())
+    NN_RET_CHECK_EQ(requestArgumentCount, plan.size())
             << "Request specifies " << requestArgumentCount << " " << type << "s but the model has "
-            << operandIndexes.size();
+            << plan.size();
     for (size_t requestArgumentIndex = 0; requestArgumentIndex < requestArgumentCount;
          requestArgumentIndex++) {
         const Request::Argument& requestArgument = requestArguments[requestArgumentIndex];
-        // Get the operand index for this argument. We extract it from the list
-        // that was provided in the call to ANeuralNetworksModel_identifyInputsAndOutputs.
-        // We assume in this function that the model has been validated already.
-        const uint32_t operandIndex = operandIndexes[requestArgumentIndex];
-        const Operand& operand = operands[operandIndex];
-        if (requestArgument.lifetime != Request::Argument::LifeTime::NO_VALUE) {
-            const bool isExtensionType = isExtension(operand.type);
-            // If the argument specified a dimension, validate it.
-            uint32_t modelRank = operand.dimensions.size();
-            uint32_t requestRank = requestArgument.dimensions.size();
-            if (requestRank == 0) {
-                // NOTE: validateRequestArguments cannot validate unknown tensor rank with
-                // extension operand type.
-                if (!isExtensionType && !isNonExtensionScalar(operand.type)) {
-                    if (modelRank <= 0) {
-                        NN_RET_CHECK(isOutput)
-                                << "Model has unknown input rank but the request does not "
-                                   "specify the rank.";
-                        NN_RET_CHECK(allowUnspecifiedOutput)
-                                << "Model has unknown output rank and request does not specify it.";
-                        // Unspecified output dimensions introduced in Android Q.
-                        version = combineVersions(version, kVersionFeatureLevel3);
-                    }
-                }
-                // Validate that all the dimensions are specified in the model.
-                for (size_t i = 0; i < modelRank; i++) {
-                    if (operand.dimensions[i] == 0) {
-                        NN_RET_CHECK(isOutput && allowUnspecifiedOutput)
-                                << "Model has dimension " << i
-                                << " set to 0 but the request does not specify the dimension.";
-                        // Unspecified output dimensions introduced in Android Q.
-                        version = combineVersions(version, kVersionFeatureLevel3);
-                    }
-                }
-            } else {
-                NN_RET_CHECK(modelRank == 0 || requestRank == modelRank)
-                        << "Request " << type << " " << requestArgumentIndex
-                        << " has number of dimensions (" << requestRank
-                        << ") different than the model's (" << modelRank << ")";
-                for (size_t i = 0; i < requestRank; i++) {
-                    NN_RET_CHECK(modelRank == 0 || operand.dimensions[i] == 0 ||
-                                 requestArgument.dimensions[i] == operand.dimensions[i])
+        if (requestArgument.lifetime == Request::Argument::LifeTime::NO_VALUE) {
+            continue;
+        }
+        const RequestValidationPlan::Argument& argument = plan[requestArgumentIndex];
+        const Dimensions& modelDimensions = argument.dimensions;
+        const uint32_t modelRank = modelDimensions.size();
+        const uint32_t requestRank = requestArgument.dimensions.size();
+        // The expected length of the argument, or 0 if it cannot be checked.
+        size_t expectedLength = 0;
+        if (requestRank == 0) {
+            // NOTE: validateRequestArguments cannot validate unknown tensor rank with
+            // extension operand type.
+            if (argument.hasUnknownRank) {
+                NN_RET_CHECK(isOutput)
+                        << "Model has unknown input rank but the request does not specify the "
+                           "rank.";
+                NN_RET_CHECK(allowUnspecifiedOutput)
+                        << "Model has unknown output rank and request does not specify it.";
+                // Unspecified output dimensions introduced in Android Q.
+                version = combineVersions(version, kVersionFeatureLevel3);
+            }
+            // Validate that all the dimensions are specified in the model.
+            if (argument.hasUnspecifiedDimensions) {
+                NN_RET_CHECK(isOutput && allowUnspecifiedOutput)
+                        << "Model has a dimension set to 0 but the request does not specify the "
+                           "dimension.";
+                // Unspecified output dimensions introduced in Android Q.
+                version = combineVersions(version, kVersionFeatureLevel3);
+            }
+            expectedLength = argument.lengthOfModelShape;
+        } else {
+            NN_RET_CHECK(modelRank == 0 || requestRank == modelRank)
+                    << "Request " << type << " " << requestArgumentIndex
+                    << " has number of dimensions (" << requestRank
+                    << ") different than the model's (" << modelRank << ")";
+            // The length is the size of the request dimensions, combined with the model ones.
+            bool isLengthKnown = !argument.isExtensionType;
+            if (isLengthKnown) {
+                expectedLength = getNonExtensionSize(argument.type);
+                isLengthKnown = !isNonExtensionScalar(argument.type);
+            }
+            for (size_t i = 0; i < requestRank; i++) {
+                const Dimension requestDimension = requestArgument.dimensions[i];
+                const Dimension modelDimension = modelRank == 0 ? 0 : modelDimensions[i];
+                NN_RET_CHECK(modelDimension == 0 || requestDimension == modelDimension)
+                        << "Request " << type << " " << requestArgumentIndex << " has dimension "
+                        << i << " of " << requestDimension << " different than the model's "
+                        << modelDimension;
+                if (requestDimension == 0) {
+                    NN_RET_CHECK(isOutput && allowUnspecifiedOutput)
                             << "Request " << type << " " << requestArgumentIndex
-                            << " has dimension " << i << " of " << requestArgument.dimensions[i]
-                            << " different than the model's " << operand.dimensions[i];
-                    if (requestArgument.dimensions[i] == 0) {
-                        NN_RET_CHECK(isOutput && allowUnspecifiedOutput)
-                                << "Request " << type << " " << requestArgumentIndex
-                                << " has dimension " << i << " of zero";
-                        // Unspecified output dimensions introduced in Android Q.
-                        version = combineVersions(version, kVersionFeatureLevel3);
-                    }
+                            << " has dimension " << i << " of zero";
+                    // Unspecified output dimensions introduced in Android Q.
+                    version = combineVersions(version, kVersionFeatureLevel3);
                 }
-            }
-            // NOTE: validateRequestArguments cannot validate DataLocation::length
-            // with extension operand type.
-            if (!isExtensionType && requestArgument.location.length != 0) {
-                const auto dimensions =
-                        NN_TRY(combineDimensions(operand.dimensions, requestArgument.dimensions));
-                const size_t expectedLength = getNonExtensionSize(operand.type, dimensions).value();
-                if (expectedLength != 0) {
-                    NN_RET_CHECK_EQ(requestArgument.location.length, expectedLength)
+                if (isLengthKnown) {
+                    const Dimension dimension =
+                            requestDimension != 0 ? requestDimension : modelDimension;
+                    NN_RET_CHECK(dimension == 0 ||
+                                 expectedLength <= std::numeric_limits<size_t>::max() / dimension)
                             << "Request " << type << " " << requestArgumentIndex
-                            << " expected a size of " << expectedLength << " but got "
-                            << requestArgument.location.length;
+                            << " has a size that overflows size_t";
+                    expectedLength *= dimension;
                 }
             }
         }
+        // NOTE: validateRequestArguments cannot validate DataLocation::length
+        // with extension operand type.
+        if (!argument.isExtensionType && requestArgument.location.length != 0 &&
+            expectedLength != 0) {
+            NN_RET_CHECK_EQ(requestArgument.location.length, expectedLength)
+                    << "Request " << type << " " << requestArgumentIndex << " expected a size of "
+                    << expectedLength << " but got " << requestArgument.location.length;
+        }
     }
     return version;
 }
 
-Result<Version> validateRequestForModelImpl(const Request& request, const Model& model,
-                                            bool allowUnspecifiedOutput) {
+Result<Version> validateRequestForPlanImpl(const Request& request,
+                                           const RequestValidationPlan& plan,
+                                           bool allowUnspecifiedOutput) {
     auto version = NN_TRY(validateRequest(request));
-    version = combineVersions(version,
-                              NN_TRY(validateRequestArgumentsForModel(
-                                      request.inputs, model.main.inputIndexes, model.main.operands,
-                                      /*isOutput=*/false, /*allowUnspecifiedOutput=*/true)));
     version = combineVersions(
-            version, NN_TRY(validateRequestArgumentsForModel(
-                             request.outputs, model.main.outputIndexes, model.main.operands,
-                             /*isOutput=*/true, allowUnspecifiedOutput)));
+            version, NN_TRY(validateRequestArgumentsForPlan(request.inputs, plan.inputs,
+                                                            /*isOutput=*/false,
+                                                            /*allowUnspecifiedOutput=*/true)));
+    version = combineVersions(
+            version, NN_TRY(validateRequestArgumentsForPlan(request.outputs, plan.outputs,
+                                                            /*isOutput=*/true,
+                                                            allowUnspecifiedOutput)));
     return version;
 }
 
@@ -1949,9 +1976,29 @@ Result<Version> validate(const std::vector<ExtensionNameAndPrefix>& extensionNam
     return validateExtensionNamesAndPrefixes(extensionNamesAndPrefixes);
 }
 
+RequestValidationPlan createRequestValidationPlan(const Model& model) {
+    const auto& operands = model.main.operands;
+    RequestValidationPlan plan;
+    plan.inputs.reserve(model.main.inputIndexes.size());
+    for (uint32_t index : model.main.inputIndexes) {
+        plan.inputs.push_back(createRequestArgumentPlan(operands[index]));
+    }
+    plan.outputs.reserve(model.main.outputIndexes.size());
+    for (uint32_t index : model.main.outputIndexes) {
+        plan.outputs.push_back(createRequestArgumentPlan(operands[index]));
+    }
+    return plan;
+}
+
 Result<Version> validateRequestForModel(const Request& request, const Model& model,
                                         bool allowUnspecifiedOutput) {
-    return validateRequestForModelImpl(request, model, allowUnspecifiedOutput);
+    return validateRequestForPlanImpl(request, createRequestValidationPlan(model),
+                                      allowUnspecifiedOutput);
+}
+
+Result<Version> validateRequestForModel(const Request& request, const RequestValidationPlan& plan,
+                                        bool allowUnspecifiedOutput) {
+    return validateRequestForPlanImpl(request, plan, allowUnspecifiedOutput);
 }
 
 Result<Version> validateMemoryDesc(
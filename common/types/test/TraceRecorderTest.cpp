@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "Tracing.h"
+#include "nnapi/TraceRecorder.h"
+
+namespace android::nn {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+TEST(TraceRecorderTest, ScopesAreWrittenAsChromeTrace) {
+    TraceRecorder::start();
+    {
+        NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "outer");
+        std::thread([] { NNTRACE_CPU(NNTRACE_PHASE_EXECUTION, "thread"); }).join();
+        NNTRACE_RT_SWITCH(NNTRACE_PHASE_RESULTS, "switch");
+    }
+    TraceRecorder::stop();
+    { NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "not recorded"); }
+
+    std::ostringstream trace;
+    TraceRecorder::writeChromeTrace(trace);
+    const std::string events = trace.str();
+    EXPECT_THAT(events, HasSubstr("\"name\":\"[NN_LR_PE]outer\""));
+    EXPECT_THAT(events, HasSubstr("\"name\":\"[NN_LC_PE]thread\""));
+    EXPECT_THAT(events, HasSubstr("\"name\":\"[SW][NN_LR_PR]switch\""));
+    EXPECT_THAT(events, Not(HasSubstr("not recorded")));
+    auto count = [&events](const std::string& pattern) {
+        size_t numMatches = 0;
+        for (size_t i = events.find(pattern); i != std::string::npos;
+             i = events.find(pattern, i + 1)) {
+            ++numMatches;
+        }
+        return numMatches;
+    };
+    EXPECT_EQ(count("\"ph\":\"B\""), 3u);
+    EXPECT_EQ(count("\"ph\":\"E\""), 3u);
+
+    // The events were taken by the previous write.
+    std::ostringstream emptyTrace;
+    TraceRecorder::writeChromeTrace(emptyTrace);
+    EXPECT_THAT(emptyTrace.str(), Not(HasSubstr("\"ph\"")));
+}
+
+}  // namespace
+}  // namespace android::nn
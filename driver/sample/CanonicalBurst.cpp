@@ -16,7 +16,6 @@
 
 #include "CanonicalBurst.h"
 
-#include <DefaultExecution.h>
 #include <android-base/logging.h>
 #include <nnapi/IBurst.h>
 #include <nnapi/IPreparedModel.h>
@@ -28,6 +27,8 @@
 #include <utility>
 #include <vector>
 
+#include "CanonicalExecution.h"
+
 namespace android::nn::sample {
 
 Burst::Burst(std::shared_ptr<const PreparedModel> preparedModel)
@@ -52,8 +53,7 @@ GeneralResult<SharedExecution> Burst::createReusableExecution(
         const nn::OptionalDuration& loopTimeoutDuration,
         const std::vector<TokenValuePair>& /*hints*/,
         const std::vector<ExtensionNameAndPrefix>& /*extensionNameToPrefix*/) const {
-    return std::make_shared<DefaultExecution>(kPreparedModel, request, measure,
-                                              loopTimeoutDuration);
+    return std::make_shared<Execution>(kPreparedModel, request, measure, loopTimeoutDuration);
 }
 
 }  // namespace android::nn::sample
@@ -16,6 +16,7 @@
 
 #include "CanonicalDevice.h"
 
+#include <CpuOperationFusion.h>
 #include <Tracing.h>
 #include <android-base/logging.h>
 #include <nnapi/IBuffer.h>
@@ -183,14 +184,25 @@ GeneralResult<SharedPreparedModel> Device::prepareModel(
         return NN_ERROR(ErrorStatus::MISSED_DEADLINE_PERSISTENT);
     }
 
+    // Compute the operations with constant inputs once instead of on every execution.
+    Model executionModel = model;
+    foldConstantsForCpu(&executionModel, &kOperationResolver);
+    // Collapse operation chains that CpuExecutor can run as a single kernel.
+    fuseOperationsForCpu(&executionModel);
+    // Keep NCHW chains in NHWC instead of converting around each operation.
+    assignLayoutsForCpu(&executionModel);
+    // Skip the zero weights of pruned FULLY_CONNECTED layers.
+    sparsifyWeightsForCpu(&executionModel);
+
     std::vector<RunTimePoolInfo> poolInfos;
-    if (!setRunTimePoolInfosFromCanonicalMemories(&poolInfos, model.pools)) {
+    if (!setRunTimePoolInfosFromCanonicalMemories(&poolInfos, executionModel.pools)) {
         return NN_ERROR() << "setRunTimePoolInfosFromCanonicalMemories failed";
     }
 
     // Create the prepared model.
-    return std::make_shared<const PreparedModel>(model, preference, priority, &kOperationResolver,
-                                                 kBufferTracker, std::move(poolInfos));
+    return std::make_shared<const PreparedModel>(std::move(executionModel), preference, priority,
+                                                 &kOperationResolver, kBufferTracker,
+                                                 std::move(poolInfos));
 }
 
 GeneralResult<SharedPreparedModel> Device::prepareModelFromCache(
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CanonicalExecution.h"
+
+#include <android-base/logging.h>
+#include <nnapi/IExecution.h>
+#include <nnapi/Result.h>
+#include <nnapi/Types.h>
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace android::nn::sample {
+
+Execution::Execution(std::shared_ptr<const PreparedModel> preparedModel, Request request,
+                     MeasureTiming measure, OptionalDuration loopTimeoutDuration)
+    : kPreparedModel(std::move(preparedModel)),
+      kRequest(std::move(request)),
+      kMeasure(measure),
+      kLoopTimeoutDuration(loopTimeoutDuration),
+      kValidationResult(kPreparedModel->validateRequest(kRequest,
+                                                        /*allowUnspecifiedOutput=*/true)) {
+    CHECK(kPreparedModel != nullptr);
+}
+
+ExecutionResult<std::pair<std::vector<OutputShape>, Timing>> Execution::compute(
+        const OptionalTimePoint& deadline) const {
+    if (!kValidationResult.ok()) {
+        return NN_ERROR(ErrorStatus::INVALID_ARGUMENT) << kValidationResult.error();
+    }
+    if (!mProfiling.load(std::memory_order_relaxed)) {
+        return kPreparedModel->executeRequest(kRequest, kMeasure, deadline, kLoopTimeoutDuration,
+                                              /*isRequestValidated=*/true);
+    }
+
+    std::vector<OperationProfile> operationProfiles;
+    auto result = kPreparedModel->executeRequest(kRequest, kMeasure, deadline,
+                                                 kLoopTimeoutDuration,
+                                                 /*isRequestValidated=*/true, &operationProfiles);
+    std::lock_guard<std::mutex> lock(mMutex);
+    mOperationProfiles = std::move(operationProfiles);
+    return result;
+}
+
+GeneralResult<std::pair<SyncFence, ExecuteFencedInfoCallback>> Execution::computeFenced(
+        const std::vector<SyncFence>& waitFor, const OptionalTimePoint& deadline,
+        const OptionalDuration& timeoutDurationAfterFence) const {
+    // A fenced computation cannot have unspecified output dimensions, which the request was not
+    // validated against, so the prepared model validates it again.
+    if (!mProfiling.load(std::memory_order_relaxed)) {
+        return kPreparedModel->executeFencedRequest(kRequest, waitFor, kMeasure, deadline,
+                                                    kLoopTimeoutDuration, timeoutDurationAfterFence,
+                                                    /*operationProfiles=*/nullptr);
+    }
+
+    std::vector<OperationProfile> operationProfiles;
+    auto result = kPreparedModel->executeFencedRequest(
+            kRequest, waitFor, kMeasure, deadline, kLoopTimeoutDuration, timeoutDurationAfterFence,
+            &operationProfiles);
+    std::lock_guard<std::mutex> lock(mMutex);
+    mOperationProfiles = std::move(operationProfiles);
+    return result;
+}
+
+void Execution::setOperationProfiling(bool enabled) {
+    mProfiling.store(enabled, std::memory_order_relaxed);
+}
+
+std::vector<OperationProfile> Execution::getOperationProfiles() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mOperationProfiles;
+}
+
+}  // namespace android::nn::sample
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PACKAGES_MODULES_NEURALNETWORKS_DRIVER_SAMPLE_CANONICAL_EXECUTION_H
+#define ANDROID_PACKAGES_MODULES_NEURALNETWORKS_DRIVER_SAMPLE_CANONICAL_EXECUTION_H
+
+#include <CpuExecutor.h>
+#include <android-base/thread_annotations.h>
+#include <nnapi/IExecution.h>
+#include <nnapi/Result.h>
+#include <nnapi/Types.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "CanonicalPreparedModel.h"
+
+namespace android::nn::sample {
+
+// Reusable execution of nn::sample::PreparedModel. The request is validated once, when the
+// execution is created, and is not validated again by each computation.
+class Execution final : public IExecution {
+   public:
+    Execution(std::shared_ptr<const PreparedModel> preparedModel, Request request,
+              MeasureTiming measure, OptionalDuration loopTimeoutDuration);
+
+    ExecutionResult<std::pair<std::vector<OutputShape>, Timing>> compute(
+            const OptionalTimePoint& deadline) const override;
+
+    GeneralResult<std::pair<SyncFence, ExecuteFencedInfoCallback>> computeFenced(
+            const std::vector<SyncFence>& waitFor, const OptionalTimePoint& deadline,
+            const OptionalDuration& timeoutDurationAfterFence) const override;
+
+    // Diagnostics: enables or disables profiling the operations of the following computations of
+    // this execution, with compute or computeFenced. Profiling is disabled by default.
+    void setOperationProfiling(bool enabled);
+
+    // Returns the profiles of the operations of the last profiled computation of this execution,
+    // even if it failed, which toChromeTrace turns into a trace. At most
+    // CpuExecutor::kDefaultMaxOperationProfiles profiles are kept.
+    std::vector<OperationProfile> getOperationProfiles() const;
+
+   private:
+    const std::shared_ptr<const PreparedModel> kPreparedModel;
+    const Request kRequest;
+    const MeasureTiming kMeasure;
+    const OptionalDuration kLoopTimeoutDuration;
+    // The result of validating kRequest for compute, which allows unspecified output dimensions.
+    const Result<Version> kValidationResult;
+
+    // Read by every computation, so it is not guarded by mMutex.
+    std::atomic<bool> mProfiling = false;
+    mutable std::mutex mMutex;
+    mutable std::vector<OperationProfile> mOperationProfiles GUARDED_BY(mMutex);
+};
+
+}  // namespace android::nn::sample
+
+#endif  // ANDROID_PACKAGES_MODULES_NEURALNETWORKS_DRIVER_SAMPLE_CANONICAL_EXECUTION_H
@@ -16,7 +16,6 @@
 
 #include "CanonicalPreparedModel.h"
 
-#include <DefaultExecution.h>
 #include <Tracing.h>
 #include <nnapi/IPreparedModel.h>
 #include <nnapi/Result.h>
@@ -31,6 +30,7 @@
 
 #include "CanonicalBurst.h"
 #include "CanonicalDevice.h"
+#include "CanonicalExecution.h"
 
 namespace android::nn::sample {
 namespace {
@@ -111,6 +111,16 @@ ErrorStatus updateDeviceMemories(ErrorStatus status, const Request& request,
     return ErrorStatus::NONE;
 }
 
+// Stores the profiles of a finished run of executor in operationProfiles.
+void keepOperationProfiles(const CpuExecutor& executor,
+                           std::vector<OperationProfile>* operationProfiles) {
+    if (const uint64_t numUnprofiled = executor.getNumUnprofiledOperations(); numUnprofiled > 0) {
+        LOG(WARNING) << "Only the first " << executor.getOperationProfiles().size()
+                     << " operations were profiled, " << numUnprofiled << " more were not";
+    }
+    *operationProfiles = executor.getOperationProfiles();
+}
+
 }  // namespace
 
 PreparedModel::PreparedModel(Model model, ExecutionPreference preference, Priority priority,
@@ -118,6 +128,7 @@ PreparedModel::PreparedModel(Model model, ExecutionPreference preference, Priori
                              std::shared_ptr<BufferTracker> bufferTracker,
                              std::vector<RunTimePoolInfo> poolInfos)
     : kModel(std::move(model)),
+      kRequestValidationPlan(createRequestValidationPlan(kModel)),
       kExecutionPreference(preference),
       kExecutionPriority(priority),
       kOperationResolver(*operationResolver),
@@ -131,14 +142,30 @@ ExecutionResult<std::pair<std::vector<OutputShape>, Timing>> PreparedModel::exec
         const Request& request, MeasureTiming measure, const OptionalTimePoint& deadline,
         const OptionalDuration& loopTimeoutDuration, const std::vector<TokenValuePair>& /*hints*/,
         const std::vector<ExtensionNameAndPrefix>& /*extensionNameToPrefix*/) const {
+    return executeRequest(request, measure, deadline, loopTimeoutDuration,
+                          /*isRequestValidated=*/false);
+}
+
+Result<Version> PreparedModel::validateRequest(const Request& request,
+                                               bool allowUnspecifiedOutput) const {
+    return validateRequestForModel(request, kRequestValidationPlan, allowUnspecifiedOutput);
+}
+
+ExecutionResult<std::pair<std::vector<OutputShape>, Timing>> PreparedModel::executeRequest(
+        const Request& request, MeasureTiming measure, const OptionalTimePoint& deadline,
+        const OptionalDuration& loopTimeoutDuration, bool isRequestValidated,
+        std::vector<OperationProfile>* operationProfiles) const {
     NNTRACE_FULL(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION, "sample::PreparedModel::execute");
     VLOG(DRIVER) << "sample::PreparedModel::execute(" << SHOW_IF_DEBUG(request) << ")";
 
     TimePoint driverStart, driverEnd, deviceStart, deviceEnd;
     if (measure == MeasureTiming::YES) driverStart = Clock::now();
 
-    if (const auto result = validateRequestForModel(request, kModel); !result.ok()) {
-        return NN_ERROR(ErrorStatus::INVALID_ARGUMENT) << result.error();
+    if (!isRequestValidated) {
+        if (const auto result = validateRequest(request, /*allowUnspecifiedOutput=*/true);
+            !result.ok()) {
+            return NN_ERROR(ErrorStatus::INVALID_ARGUMENT) << result.error();
+        }
     }
     if (hasDeadlinePassed(deadline)) {
         return NN_ERROR(ErrorStatus::MISSED_DEADLINE_PERSISTENT);
@@ -151,18 +178,21 @@ ExecutionResult<std::pair<std::vector<OutputShape>, Timing>> PreparedModel::exec
 
     NNTRACE_FULL_SWITCH(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION, "sample::Device::execute");
     auto executor = CpuExecutor(&kOperationResolver);
+    executor.setScratchWorkspacePool(&mScratchWorkspacePool);
     if (loopTimeoutDuration.has_value()) {
         executor.setLoopTimeout(loopTimeoutDuration->count());
     }
     if (deadline.has_value()) {
         executor.setDeadline(*deadline);
     }
+    executor.setProfiling(operationProfiles != nullptr);
 
     // Perform execution.
     if (measure == MeasureTiming::YES) deviceStart = Clock::now();
     int n = executor.run(kModel, request, kPoolInfos, requestPoolInfos);
     if (measure == MeasureTiming::YES) deviceEnd = Clock::now();
     VLOG(DRIVER) << "executor.run returned " << n;
+    if (operationProfiles != nullptr) keepOperationProfiles(executor, operationProfiles);
     ErrorStatus executionStatus = convertResultCodeToErrorStatus(n);
     const auto& outputShapes = executor.getOutputShapes();
 
@@ -192,6 +222,15 @@ GeneralResult<std::pair<SyncFence, ExecuteFencedInfoCallback>> PreparedModel::ex
         const OptionalDuration& timeoutDurationAfterFence,
         const std::vector<TokenValuePair>& /*hints*/,
         const std::vector<ExtensionNameAndPrefix>& /*extensionNameToPrefix*/) const {
+    return executeFencedRequest(request, waitFor, measure, deadline, loopTimeoutDuration,
+                                timeoutDurationAfterFence, /*operationProfiles=*/nullptr);
+}
+
+GeneralResult<std::pair<SyncFence, ExecuteFencedInfoCallback>> PreparedModel::executeFencedRequest(
+        const Request& request, const std::vector<SyncFence>& waitFor, MeasureTiming measure,
+        const OptionalTimePoint& deadline, const OptionalDuration& loopTimeoutDuration,
+        const OptionalDuration& timeoutDurationAfterFence,
+        std::vector<OperationProfile>* operationProfiles) const {
     NNTRACE_FULL(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION,
                  "sample::PreparedModel::executeFenced");
     VLOG(DRIVER) << "executeFenced(" << SHOW_IF_DEBUG(request) << ")";
@@ -199,8 +238,7 @@ GeneralResult<std::pair<SyncFence, ExecuteFencedInfoCallback>> PreparedModel::ex
     TimePoint driverStart, driverEnd, deviceStart, deviceEnd;
     if (measure == MeasureTiming::YES) driverStart = Clock::now();
 
-    if (const auto result =
-                validateRequestForModel(request, kModel, /*allowUnspecifiedOutput=*/false);
+    if (const auto result = validateRequest(request, /*allowUnspecifiedOutput=*/false);
         !result.ok()) {
         return NN_ERROR(ErrorStatus::INVALID_ARGUMENT) << result.error();
     }
@@ -240,16 +278,19 @@ GeneralResult<std::pair<SyncFence, ExecuteFencedInfoCallback>> PreparedModel::ex
     NNTRACE_FULL_SWITCH(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION,
                         "sample::PreparedModel::executeFenced");
     auto executor = CpuExecutor(&kOperationResolver);
+    executor.setScratchWorkspacePool(&mScratchWorkspacePool);
     if (loopTimeoutDuration.has_value()) {
         executor.setLoopTimeout(loopTimeoutDuration->count());
     }
     if (closestDeadline.has_value()) {
         executor.setDeadline(*closestDeadline);
     }
+    executor.setProfiling(operationProfiles != nullptr);
     if (measure == MeasureTiming::YES) deviceStart = Clock::now();
     int n = executor.run(kModel, request, kPoolInfos, requestPoolInfos);
     if (measure == MeasureTiming::YES) deviceEnd = Clock::now();
     VLOG(DRIVER) << "executor.run returned " << n;
+    if (operationProfiles != nullptr) keepOperationProfiles(executor, operationProfiles);
     ErrorStatus executionStatus = convertResultCodeToErrorStatus(n);
     if (executionStatus != ErrorStatus::NONE) {
         return NN_ERROR(executionStatus);
@@ -289,8 +330,7 @@ GeneralResult<SharedExecution> PreparedModel::createReusableExecution(
         const std::vector<ExtensionNameAndPrefix>& /*extensionNameToPrefix*/) const {
     NNTRACE_FULL(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION,
                  "sample::PreparedModel::createReusableExecution");
-    return std::make_shared<DefaultExecution>(shared_from_this(), request, measure,
-                                              loopTimeoutDuration);
+    return std::make_shared<Execution>(shared_from_this(), request, measure, loopTimeoutDuration);
 }
 
 GeneralResult<SharedBurst> PreparedModel::configureExecutionBurst() const {
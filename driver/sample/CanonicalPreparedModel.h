@@ -23,6 +23,7 @@
 #include <nnapi/IPreparedModel.h>
 #include <nnapi/Result.h>
 #include <nnapi/Types.h>
+#include <nnapi/Validation.h>
 
 #include <memory>
 #include <tuple>
@@ -60,13 +61,36 @@ class PreparedModel final : public IPreparedModel,
 
     std::any getUnderlyingResource() const override;
 
+    // Validates a request for the model of the prepared model.
+    Result<Version> validateRequest(const Request& request, bool allowUnspecifiedOutput) const;
+
+    // Same as execute, but skips validating the request if isRequestValidated is true. A reusable
+    // execution validates its request only once, when it is created. If operationProfiles is not
+    // null, the operations of the computation are profiled and their profiles are stored in it,
+    // even if the computation fails.
+    ExecutionResult<std::pair<std::vector<OutputShape>, Timing>> executeRequest(
+            const Request& request, MeasureTiming measure, const OptionalTimePoint& deadline,
+            const OptionalDuration& loopTimeoutDuration, bool isRequestValidated,
+            std::vector<OperationProfile>* operationProfiles = nullptr) const;
+
+    // Same as executeFenced, but profiles the operations of the computation into
+    // operationProfiles if it is not null, as executeRequest does.
+    GeneralResult<std::pair<SyncFence, ExecuteFencedInfoCallback>> executeFencedRequest(
+            const Request& request, const std::vector<SyncFence>& waitFor, MeasureTiming measure,
+            const OptionalTimePoint& deadline, const OptionalDuration& loopTimeoutDuration,
+            const OptionalDuration& timeoutDurationAfterFence,
+            std::vector<OperationProfile>* operationProfiles) const;
+
    private:
     const Model kModel;
+    const RequestValidationPlan kRequestValidationPlan;
     [[maybe_unused]] const ExecutionPreference kExecutionPreference;
     [[maybe_unused]] const Priority kExecutionPriority;
     const IOperationResolver& kOperationResolver;
     const std::shared_ptr<BufferTracker> kBufferTracker;
     const std::vector<RunTimePoolInfo> kPoolInfos;
+    // Shared by the executions of the model, so that they do not each grow a new workspace.
+    mutable ScratchWorkspacePool mScratchWorkspacePool;
 };
 
 }  // namespace android::nn::sample
@@ -135,6 +135,7 @@ class SamplePreparedModel : public aidl_hal::BnPreparedModel {
             const aidl_hal::Request& request, const aidl_hal::ExecutionConfig& config,
             std::shared_ptr<aidl_hal::IExecution>* execution) override;
     const aidl_hal::Model* getModel() const { return &mModel; }
+    ScratchWorkspacePool* getScratchWorkspacePool() const { return &mScratchWorkspacePool; }
 
    protected:
     aidl_hal::Model mModel;
@@ -143,6 +144,8 @@ class SamplePreparedModel : public aidl_hal::BnPreparedModel {
     const aidl_hal::ExecutionPreference kPreference;
     const uid_t kUserId;
     const aidl_hal::Priority kPriority;
+    // Shared by the executions of the model, so that they do not each grow a new workspace.
+    mutable ScratchWorkspacePool mScratchWorkspacePool;
 };
 
 class SampleFencedExecutionCallback : public aidl_hal::BnFencedExecutionCallback {
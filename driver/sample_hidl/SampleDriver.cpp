@@ -465,6 +465,7 @@ void asyncExecute(const V1_3::Request& request, V1_2::MeasureTiming measure, Tim
     NNTRACE_FULL_SWITCH(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION,
                         "SampleDriver::asyncExecute");
     CpuExecutor executor = driver.getExecutor();
+    executor.setScratchWorkspacePool(preparedModel->getScratchWorkspacePool());
     if (loopTimeoutDuration.getDiscriminator() !=
         V1_3::OptionalTimeoutDuration::hidl_discriminator::none) {
         executor.setLoopTimeout(loopTimeoutDuration.nanoseconds());
@@ -598,6 +599,7 @@ executeSynchronouslyBase(const V1_3::Request& request, V1_2::MeasureTiming measu
     NNTRACE_FULL_SWITCH(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION,
                         "SampleDriver::executeSynchronouslyBase");
     CpuExecutor executor = driver.getExecutor();
+    executor.setScratchWorkspacePool(preparedModel->getScratchWorkspacePool());
     if (loopTimeoutDuration.getDiscriminator() !=
         V1_3::OptionalTimeoutDuration::hidl_discriminator::none) {
         executor.setLoopTimeout(loopTimeoutDuration.nanoseconds());
@@ -711,6 +713,7 @@ hardware::Return<void> SamplePreparedModel::executeFenced(
     NNTRACE_FULL_SWITCH(NNTRACE_LAYER_DRIVER, NNTRACE_PHASE_EXECUTION,
                         "SamplePreparedModel::executeFenced");
     CpuExecutor executor = mDriver->getExecutor();
+    executor.setScratchWorkspacePool(&mScratchWorkspacePool);
     if (loopTimeoutDuration.getDiscriminator() !=
         V1_3::OptionalTimeoutDuration::hidl_discriminator::none) {
         executor.setLoopTimeout(loopTimeoutDuration.nanoseconds());
@@ -822,6 +825,7 @@ class BurstExecutorWithCache : public ExecutionBurstServer::IBurstExecutorWithCa
         // because burst does not support HAL 1.3 and hence does not support
         // WHILE loops.
         CpuExecutor executor = mDriver->getExecutor();
+        executor.setScratchWorkspacePool(&mScratchWorkspacePool);
         if (measure == V1_2::MeasureTiming::YES) deviceStart = Clock::now();
         int n = executor.run(uncheckedConvert(mModel), uncheckedConvert(fullRequest),
                              mModelPoolInfos, requestPoolInfos);
@@ -847,6 +851,7 @@ class BurstExecutorWithCache : public ExecutionBurstServer::IBurstExecutorWithCa
     const SampleDriver* const mDriver;
     const std::vector<RunTimePoolInfo> mModelPoolInfos;
     std::map<int32_t, std::optional<RunTimePoolInfo>> mMemoryCache;  // cached requestPoolInfos
+    ScratchWorkspacePool mScratchWorkspacePool;
 };
 
 // This is the amount of time the ExecutionBurstServer should spend polling the
@@ -168,6 +168,7 @@ class SamplePreparedModel : public V1_3::IPreparedModel {
                                          const V1_3::OptionalTimeoutDuration& duration,
                                          executeFenced_cb callback) override;
     const V1_3::Model* getModel() const { return &mModel; }
+    ScratchWorkspacePool* getScratchWorkspacePool() const { return &mScratchWorkspacePool; }
 
    protected:
     V1_3::Model mModel;
@@ -176,6 +177,8 @@ class SamplePreparedModel : public V1_3::IPreparedModel {
     const V1_1::ExecutionPreference kPreference;
     const uid_t kUserId;
     const V1_3::Priority kPriority;
+    // Shared by the executions of the model, so that they do not each grow a new workspace.
+    mutable ScratchWorkspacePool mScratchWorkspacePool;
 };
 
 class SampleFencedExecutionCallback : public V1_3::IFencedExecutionCallback {
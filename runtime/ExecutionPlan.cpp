@@ -122,7 +122,9 @@ int compile(const Device& device, const ModelBuilder& model, int executionPrefer
         std::copy(tokenPtr, tokenPtr + cacheToken->size(), cacheToken->begin());
     }
 
-    const ModelFactory makeModel = [&model] { return model.makeModel(); };
+    const ModelFactory makeModel = [&model] {
+        return model.makeModel(/*withInferredDimensions=*/true);
+    };
     const ExecutionPreference preference = static_cast<ExecutionPreference>(executionPreference);
     const Priority priority = convertToCanonicalPriority(compilationPriority);
     std::vector<ExtensionNameAndPrefix> extensionNameAndPrefix =
@@ -441,6 +443,83 @@ std::optional<DynamicTemporaries::LocationAndShape> DynamicTemporaries::lookup(
     return std::nullopt;
 }
 
+DynamicTemporaries::Lengths DynamicTemporaries::getLengths() const {
+    Lengths lengths;
+    lengths.reserve(mSourceOperandToTemporary.size());
+    for (const auto& [sourceOperandIndex, temp] : mSourceOperandToTemporary) {
+        lengths.emplace_back(sourceOperandIndex, temp.paddedLength);
+    }
+    return lengths;
+}
+
+void DynamicTemporaries::reserve(const Lengths& lengths) {
+    CHECK(mDeclared);
+    CHECK(mAllocatedStepIndexes.empty());
+    for (const auto& [sourceOperandIndex, length] : lengths) {
+        const auto it = mSourceOperandToTemporary.find(sourceOperandIndex);
+        if (it == mSourceOperandToTemporary.end()) {
+            continue;
+        }
+        InternalLocationAndShape& temp = it->second;
+        const uint32_t paddedLength = roundUp(length, temp.padding);
+        temp.paddedLength = std::max(temp.paddedLength, paddedLength);
+    }
+}
+
+std::list<DynamicTemporariesCache::Entry>::iterator DynamicTemporariesCache::find(
+        const Signature& signature) {
+    return std::find_if(mEntries.begin(), mEntries.end(),
+                        [&signature](const Entry& entry) { return entry.signature == signature; });
+}
+
+std::optional<DynamicTemporaries::Lengths> DynamicTemporariesCache::lookup(
+        const Signature& signature) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    const auto it = find(signature);
+    if (it == mEntries.end()) {
+        ++mStatistics.numMisses;
+        return std::nullopt;
+    }
+    ++mStatistics.numHits;
+    mEntries.splice(mEntries.begin(), mEntries, it);
+    return it->lengths;
+}
+
+void DynamicTemporariesCache::insert(Signature signature, DynamicTemporaries::Lengths lengths) {
+    size_t bytes = sizeof(Entry) + lengths.size() * sizeof(DynamicTemporaries::Lengths::value_type);
+    for (const auto& dimensions : signature) {
+        bytes += sizeof(dimensions) + (dimensions ? dimensions->size() * sizeof(uint32_t) : 0);
+    }
+    if (bytes > kMaxBytes) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    const auto it = find(signature);
+    if (it != mEntries.end()) {
+        mStatistics.bytes -= it->bytes;
+        mEntries.erase(it);
+    }
+    // Make room for the new entry.
+    while (!mEntries.empty() &&
+           (mEntries.size() >= kMaxEntries || mStatistics.bytes + bytes > kMaxBytes)) {
+        mStatistics.bytes -= mEntries.back().bytes;
+        mEntries.pop_back();
+    }
+    mEntries.push_front({std::move(signature), std::move(lengths), bytes});
+    mStatistics.bytes += bytes;
+    mStatistics.numEntries = mEntries.size();
+}
+
+void DynamicTemporariesCache::recordFallback() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    ++mStatistics.numFallbacks;
+}
+
+DynamicTemporariesCache::Statistics DynamicTemporariesCache::getStatistics() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStatistics;
+}
+
 ExecutionStep::ExecutionStep(ExecutionPlan* plan, uint32_t stepIndex, uint32_t sourceModelIndex,
                              std::shared_ptr<Device> device)
     : mPlan(plan),
@@ -1428,14 +1507,51 @@ std::shared_ptr<ExecutionPlan::Controller> ExecutionPlan::makeController(
                                    size, memoryPreference.alignment, memoryPreference.padding);
     });
     dynamicTemporaries.endDeclarations();
+    // Start from the lengths that the last execution with the same input shapes needed.
+    DynamicTemporariesCache::Signature inputShapes;
+    if (!dynamicTemporaries.empty()) {
+        const uint32_t inputCount = executionBuilder->getModel()->inputCount();
+        inputShapes.reserve(inputCount);
+        for (uint32_t i = 0; i < inputCount; i++) {
+            const ModelArgumentInfo& info = executionBuilder->getInputInfo(i);
+            inputShapes.push_back(info.state() == ModelArgumentInfo::HAS_NO_VALUE
+                                          ? std::nullopt
+                                          : std::make_optional(info.dimensions()));
+        }
+        if (const auto lengths = body->mDynamicTemporariesCache.lookup(inputShapes)) {
+            dynamicTemporaries.reserve(*lengths);
+        }
+    }
     dynamicTemporaries.vlogDump("finished declarations");
 
-    return std::shared_ptr<Controller>(new Controller(
+    auto controller = std::shared_ptr<Controller>(new Controller(
             this, executionBuilder, burstBuilder, totalSizeOfTemporaries,
             std::move(sourceOperandToLocationOfTemporary),
             std::move(sourceOperandToLocationOfTemporary2), body->mSourceOperandToInputIndex,
             body->mSourceOperandToOutputIndex, body->mSourceOperandToBoundaryConstantCopy,
             body->mSourceOperandToBoundaryConstantReference, std::move(dynamicTemporaries)));
+    controller->mInputShapes = std::move(inputShapes);
+    return controller;
+}
+
+void ExecutionPlan::recordDynamicTemporaries(const Controller& controller) const {
+    if (controller.mDynamicTemporaries.empty()) {
+        return;
+    }
+    const auto* body = compound();
+    body->mDynamicTemporariesCache.insert(controller.mInputShapes,
+                                          controller.mDynamicTemporaries.getLengths());
+    if (VLOG_IS_ON(EXECUTION)) {
+        const auto statistics = body->mDynamicTemporariesCache.getStatistics();
+        VLOG(EXECUTION) << "DynamicTemporariesCache: " << statistics.numHits << " hits, "
+                        << statistics.numMisses << " misses, " << statistics.numFallbacks
+                        << " fallbacks, " << statistics.numEntries
+                        << " entries, " << statistics.bytes << " bytes";
+    }
+}
+
+DynamicTemporariesCache::Statistics ExecutionPlan::getDynamicTemporariesCacheStatistics() const {
+    return compound()->mDynamicTemporariesCache.getStatistics();
 }
 
 // TODO: Find a better way to provide this functionality.
@@ -1460,6 +1576,7 @@ int ExecutionPlan::fallback(std::shared_ptr<Controller> controller,
         return ANEURALNETWORKS_OP_FAILED;
     }
 
+    compound()->mDynamicTemporariesCache.recordFallback();
     controller->mNextStepIndex = controller->mFallbackNextStepIndex;
     return next(controller, executor, burstController, mainModelOutputShapes);
 }
@@ -1588,6 +1705,7 @@ int ExecutionPlan::nextCompound(std::shared_ptr<Controller> controller,
     auto compoundBody = compound();
     if (controller->mNextStepIndex == compoundBody->mSteps.size()) {
         controller->mNextStepIndex = Controller::kBadStepIndex;  // end
+        recordDynamicTemporaries(*controller);
         return ANEURALNETWORKS_NO_ERROR;
     }
 
@@ -2538,7 +2656,8 @@ class CanDo {
 int ModelBuilder::findBestDeviceForEachOperation(
         uint32_t preference, const std::vector<std::shared_ptr<Device>>& devices,
         std::vector<int>* bestDeviceForOperation) const {
-    const MetaModel metaModel(makeModel(), DeviceManager::get()->strictSlicing());
+    const MetaModel metaModel(makeModel(/*withInferredDimensions=*/true),
+                              DeviceManager::get()->strictSlicing());
 
     const size_t deviceCount = devices.size();
     std::vector<CanDo> canDo(deviceCount);
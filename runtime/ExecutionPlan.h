@@ -22,14 +22,18 @@
 #include <LegacyUtils.h>
 #include <TokenHasher.h>
 #include <android-base/logging.h>
+#include <android-base/thread_annotations.h>
 #include <nnapi/IBurst.h>
 #include <nnapi/Types.h>
 
 #include <algorithm>
 #include <chrono>
 #include <functional>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <ostream>
 #include <set>
 #include <string>
@@ -193,6 +197,16 @@ class DynamicTemporaries {
     // Have any dynamic temporaries been declared?
     bool empty() const { return mSourceOperandToTemporary.empty(); }
 
+    // The padded length of every dynamic temporary, as learned so far.
+    using Lengths = std::vector<std::pair<SourceOperandIndex, uint32_t>>;
+    Lengths getLengths() const;
+
+    // Grow dynamic temporaries to lengths learned by a previous execution
+    // (see DynamicTemporariesCache), so that they are allocated big enough in
+    // the first place.  Must be called after endDeclarations() and before
+    // allocate().
+    void reserve(const Lengths& lengths);
+
    private:
     // The same as LocationAndShape, except that:
     // - the base of the location is represented not by memory but by defining stepIndex
@@ -220,6 +234,67 @@ class DynamicTemporaries {
     bool mDeclared = false;
 };
 
+// Remembers, for the most recent shapes of main model inputs, the lengths that
+// the dynamic temporaries of a compound plan turned out to need.  An execution
+// with input shapes seen before reserves those lengths up front (see
+// DynamicTemporaries::reserve()) instead of learning them step by step through
+// OUTPUT_INSUFFICIENT_SIZE and ExecutionPlan::fallback().
+//
+// Only lengths are reused, not dimensions: dimensions may depend on input
+// values, and the defining step reports them anyway.  A length that turns out
+// to be too small is handled by redeclare() as before.
+//
+// The cache evicts the least recently used entries to stay within a number of
+// entries and a number of bytes.  It is thread-safe.
+class DynamicTemporariesCache {
+    DISALLOW_COPY_AND_ASSIGN(DynamicTemporariesCache);
+
+   public:
+    // The dimensions of every main model input, or std::nullopt for an input
+    // that has no value.
+    using Signature = std::vector<std::optional<Dimensions>>;
+
+    struct Statistics {
+        uint64_t numHits = 0;
+        uint64_t numMisses = 0;
+        // The number of times a step was executed again because a dynamic temporary was too
+        // small, which the cache is meant to avoid.
+        uint64_t numFallbacks = 0;
+        size_t numEntries = 0;
+        size_t bytes = 0;
+    };
+
+    DynamicTemporariesCache(size_t maxEntries, size_t maxBytes)
+        : kMaxEntries(maxEntries), kMaxBytes(maxBytes) {}
+
+    // Returns the lengths recorded for the signature, if any.
+    std::optional<DynamicTemporaries::Lengths> lookup(const Signature& signature);
+
+    // Records the lengths for the signature, replacing any previous record.
+    void insert(Signature signature, DynamicTemporaries::Lengths lengths);
+
+    // Counts a step executed again because a dynamic temporary was too small.
+    void recordFallback();
+
+    Statistics getStatistics() const;
+
+   private:
+    struct Entry {
+        Signature signature;
+        DynamicTemporaries::Lengths lengths;
+        size_t bytes;
+    };
+
+    std::list<Entry>::iterator find(const Signature& signature) REQUIRES(mMutex);
+
+    const size_t kMaxEntries;
+    const size_t kMaxBytes;
+    mutable std::mutex mMutex;
+    // Most recently used first.
+    std::list<Entry> mEntries GUARDED_BY(mMutex);
+    Statistics mStatistics GUARDED_BY(mMutex);
+};
+
 // The location of a static temporary.
 struct StaticTemporaryLocation {
     // The offset relative to ExecutionPlan::Controller::mTemporaries during execution.
@@ -661,6 +736,9 @@ class ExecutionPlan {
         std::unique_ptr<MemoryAshmem> mTemporaries;
 
         DynamicTemporaries mDynamicTemporaries;
+        // The key of mDynamicTemporaries in the DynamicTemporariesCache of the plan.  Empty if
+        // there are no dynamic temporaries.
+        DynamicTemporariesCache::Signature mInputShapes;
 
         // Index of the next step to be processed by ExecutionPlan::next().
         size_t mNextStepIndex;
@@ -678,6 +756,9 @@ class ExecutionPlan {
     std::shared_ptr<Controller> makeController(ExecutionBuilder* executionBuilder,
                                                const BurstBuilder* burstBuilder) const;
 
+    // Only legal to call when mState == COMPOUND.
+    DynamicTemporariesCache::Statistics getDynamicTemporariesCacheStatistics() const;
+
     // Sets up a new StepExecutor and burstController (if applicable) if there
     // is a step to execute. See ExecutionPlan::Controller.
     // Handles control flow. See LogicalStep.
@@ -784,6 +865,11 @@ class ExecutionPlan {
     // Illegal to call for when mState == SIMPLE.
     void becomeCompoundIfEmpty();
 
+    // Records the lengths of the dynamic temporaries of an execution that reached the end of the
+    // plan, for the next executions with the same input shapes.  Called by nextCompound(), so
+    // that every kind of compound execution fills the cache.  See DynamicTemporariesCache.
+    void recordDynamicTemporaries(const Controller& controller) const;
+
     const Operand& getSourceOperand(const std::pair<uint32_t, uint32_t>& sourceOperandIndex) const {
         return getSourceModels()
                 .getModel(sourceOperandIndex.first)
@@ -940,6 +1026,13 @@ class ExecutionPlan {
 
         bool mHasDynamicTemporaries = false;
 
+        // The lengths of the dynamic temporaries of recent executions, by input shapes.  Models
+        // with dynamic input shapes typically cycle through a handful of them.
+        static constexpr size_t kDynamicTemporariesCacheEntries = 16;
+        static constexpr size_t kDynamicTemporariesCacheBytes = 64 * 1024;
+        mutable DynamicTemporariesCache mDynamicTemporariesCache{kDynamicTemporariesCacheEntries,
+                                                                 kDynamicTemporariesCacheBytes};
+
        private:
         void findTempsAsStepModelOutputs();
 
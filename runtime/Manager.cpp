@@ -19,6 +19,8 @@
 #include "Manager.h"
 
 #include <CpuExecutor.h>
+#include <CpuOperationFusion.h>
+#include <CpuParallelFor.h>
 #include <LegacyUtils.h>
 #include <MetaModel.h>
 #include <Tracing.h>
@@ -962,6 +964,7 @@ class CpuPreparedModel : public RuntimePreparedModel {
 
     const Model& getModel() const { return mModel; }
     const std::vector<RunTimePoolInfo>& getModelPoolInfos() const { return mModelPoolInfos; }
+    ScratchWorkspacePool* getScratchWorkspacePool() const { return &mScratchWorkspacePool; }
 
    private:
     // TFLite kernels prefers 64 bytes for padding and alignment.
@@ -970,6 +973,8 @@ class CpuPreparedModel : public RuntimePreparedModel {
 
     const Model mModel;
     const std::vector<RunTimePoolInfo> mModelPoolInfos;
+    // Shared by the executions of the model, so that they do not each grow a new workspace.
+    mutable ScratchWorkspacePool mScratchWorkspacePool;
 };
 
 class CpuExecution : public RuntimeExecution {
@@ -1061,6 +1066,15 @@ std::pair<int, std::unique_ptr<RuntimeMemory>> CpuDevice::allocate(const MemoryD
 }
 
 std::pair<int, std::shared_ptr<RuntimePreparedModel>> CpuPreparedModel::create(Model model) {
+    // Compute the operations with constant inputs once instead of on every execution.
+    foldConstantsForCpu(&model);
+    // Collapse operation chains that CpuExecutor can run as a single kernel.
+    fuseOperationsForCpu(&model);
+    // Keep NCHW chains in NHWC instead of converting around each operation.
+    assignLayoutsForCpu(&model);
+    // Skip the zero weights of pruned FULLY_CONNECTED layers.
+    sparsifyWeightsForCpu(&model);
+
     std::vector<RunTimePoolInfo> poolInfos;
     if (!setRunTimePoolInfosFromCanonicalMemories(&poolInfos, model.pools)) {
         return {ANEURALNETWORKS_UNMAPPABLE, nullptr};
@@ -1075,9 +1089,10 @@ static std::tuple<int, std::vector<OutputShape>, Timing> computeOnCpu(
         const Model& model, const Request& request,
         const std::vector<RunTimePoolInfo>& modelPoolInfos,
         const std::vector<RunTimePoolInfo>& requestPoolInfos, const OptionalTimePoint& deadline,
-        const OptionalDuration& loopTimeoutDuration) {
+        const OptionalDuration& loopTimeoutDuration, ScratchWorkspacePool* scratchWorkspacePool) {
     NNTRACE_RT(NNTRACE_PHASE_EXECUTION, "computeOnCpu");
     CpuExecutor executor;
+    executor.setScratchWorkspacePool(scratchWorkspacePool);
     if (loopTimeoutDuration.has_value()) {
         executor.setLoopTimeout(loopTimeoutDuration->count());
     }
@@ -1192,13 +1207,13 @@ std::tuple<int, std::vector<OutputShape>, Timing> CpuPreparedModel::execute(
         std::tuple<int, std::vector<OutputShape>, Timing> result = {};
         std::thread([this, &request, &requestPoolInfos, &deadline, &loopTimeoutDuration, &result] {
             result = computeOnCpu(mModel, request, mModelPoolInfos, requestPoolInfos, deadline,
-                                  loopTimeoutDuration);
+                                  loopTimeoutDuration, &mScratchWorkspacePool);
         }).join();
         return result;
     }
 
     return computeOnCpu(mModel, request, mModelPoolInfos, requestPoolInfos, deadline,
-                        loopTimeoutDuration);
+                        loopTimeoutDuration, &mScratchWorkspacePool);
 }
 
 std::pair<int, std::shared_ptr<RuntimeExecution>> CpuPreparedModel::createReusableExecution(
@@ -1229,13 +1244,14 @@ std::tuple<int, std::vector<OutputShape>, Timing> CpuExecution::compute(
         std::thread([this, &deadline, &result] {
             result = computeOnCpu(kPreparedModel.getModel(), kRequest,
                                   kPreparedModel.getModelPoolInfos(), kRequestPoolInfos, deadline,
-                                  kLoopTimeoutDuration);
+                                  kLoopTimeoutDuration, kPreparedModel.getScratchWorkspacePool());
         }).join();
         return result;
     }
 
     return computeOnCpu(kPreparedModel.getModel(), kRequest, kPreparedModel.getModelPoolInfos(),
-                        kRequestPoolInfos, deadline, kLoopTimeoutDuration);
+                        kRequestPoolInfos, deadline, kLoopTimeoutDuration,
+                        kPreparedModel.getScratchWorkspacePool());
 }
 
 std::tuple<int, int, ExecuteFencedInfoCallback, Timing> CpuExecution::computeFenced(
@@ -1367,6 +1383,9 @@ DeviceManager::DeviceManager() {
     mDebugNNCpuOnly = (getProp("debug.nn.cpuonly") != 0);
     mSyncExecCpu = (getProp("debug.nn.syncexec-cpu", 1) != 0);
     mSyncExecRuntime = (getProp("debug.nn.syncexec-runtime") != 0);
+    if (const uint32_t cpuThreads = getProp("debug.nn.cpu-threads"); cpuThreads != 0) {
+        setCpuThreadCount(cpuThreads);
+    }
 #endif  // NN_DEBUGGABLE
 }
 
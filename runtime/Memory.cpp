@@ -20,6 +20,7 @@
 
 #include <CpuExecutor.h>
 #include <LegacyUtils.h>
+#include <SizeClassPool.h>
 #include <android-base/scopeguard.h>
 #include <nnapi/IBurst.h>
 #include <nnapi/SharedMemory.h>
@@ -28,6 +29,7 @@
 #include <nnapi/Validation.h>
 
 #include <algorithm>
+#include <cstring>
 #include <memory>
 #include <set>
 #include <tuple>
@@ -212,6 +214,16 @@ std::optional<RunTimePoolInfo> RuntimeMemory::getRunTimePoolInfo() const {
     return mCachedRunTimePoolInfo;
 }
 
+void RuntimeMemory::releaseCachedReferences() {
+    // Destroyed after the lock is released, as destroying a cache hold may call into the burst.
+    std::set<IBurst::OptionalCacheHold> hold;
+    std::optional<RunTimePoolInfo> runTimePoolInfo;
+    std::lock_guard<std::mutex> guard(mMutex);
+    mHold.swap(hold);
+    mCachedRunTimePoolInfo.swap(runTimePoolInfo);
+    mHasCachedRunTimePoolInfo = false;
+}
+
 void RuntimeMemory::hold(const IBurst::OptionalCacheHold& cacheHold) const {
     if (cacheHold != nullptr) {
         std::lock_guard<std::mutex> guard(mMutex);
@@ -517,8 +529,46 @@ std::pair<int, std::unique_ptr<RuntimeMemory>> MemoryBuilder::allocate() const {
     return {n, std::move(memory)};
 }
 
+namespace {
+
+// The most regions and memory that the pool of ashmem regions keeps for reuse. Each pooled region
+// keeps its file descriptor open, so the number of regions is bounded as well as their size.
+constexpr size_t kMaxPooledAshmemRegions = 64;
+constexpr size_t kMaxPooledAshmemBytes = 16 * 1024 * 1024;
+// Smaller regions are not pooled, as they are cheap to create again and pooling them would spend
+// file descriptors on little memory.
+constexpr size_t kMinPooledAshmemBytes = 64 * 1024;
+
+struct PooledAshmem {
+    SharedMemory memory;
+    Mapping mapping;
+};
+
+using AshmemPool = SizeClassPool<PooledAshmem>;
+
+AshmemPool& getAshmemPool() {
+    // Never destroyed, as MemoryAshmem objects may outlive the static objects.
+    static AshmemPool* const pool = new AshmemPool(kMaxPooledAshmemRegions, kMaxPooledAshmemBytes);
+    return *pool;
+}
+
+}  // namespace
+
 std::pair<int, std::unique_ptr<MemoryAshmem>> MemoryAshmem::create(uint32_t size) {
+    if (auto pooled = getAshmemPool().acquire(size)) {
+        auto memory = std::make_unique<MemoryAshmem>(std::move(pooled->memory),
+                                                     std::move(pooled->mapping));
+        // A new region is zero-filled. A pooled one still holds the data of the memory that used
+        // it before, which may have been shared with a driver process.
+        std::memset(memory->getPointer(), 0, size);
+        return {ANEURALNETWORKS_NO_ERROR, std::move(memory)};
+    }
     auto memory = createSharedMemory(size);
+    if (!memory.has_value()) {
+        // Free the pooled regions and try again.
+        getAshmemPool().trim();
+        memory = createSharedMemory(size);
+    }
     if (!memory.has_value()) {
         LOG(ERROR) << "RuntimeMemory::create() failed: " << memory.error().message;
         return {convertErrorStatusToResultCode(memory.error().code), nullptr};
@@ -532,6 +582,14 @@ std::pair<int, std::unique_ptr<MemoryAshmem>> MemoryAshmem::create(uint32_t size
             std::make_unique<MemoryAshmem>(std::move(memory).value(), std::move(mapping).value())};
 }
 
+PoolStatistics MemoryAshmem::getPoolStatistics() {
+    return getAshmemPool().getStatistics();
+}
+
+void MemoryAshmem::trimPool() {
+    getAshmemPool().trim();
+}
+
 uint8_t* MemoryAshmem::getPointer() const {
     return static_cast<uint8_t*>(std::get<void*>(kMapping.pointer));
 }
@@ -539,6 +597,15 @@ uint8_t* MemoryAshmem::getPointer() const {
 MemoryAshmem::MemoryAshmem(SharedMemory memory, Mapping mapping)
     : RuntimeMemory(std::move(memory)), kMapping(std::move(mapping)) {}
 
+MemoryAshmem::~MemoryAshmem() {
+    // The region is only reused if no driver execution or burst cache still refers to it. The
+    // references held by the base class would otherwise only be dropped after this check.
+    releaseCachedReferences();
+    if (kMemory.use_count() == 1 && nn::getSize(kMemory) >= kMinPooledAshmemBytes) {
+        getAshmemPool().release(nn::getSize(kMemory), {.memory = kMemory, .mapping = kMapping});
+    }
+}
+
 std::pair<int, std::unique_ptr<MemoryFd>> MemoryFd::create(size_t size, int prot, int fd,
                                                            size_t offset) {
     auto memory = createSharedMemoryFromFd(size, prot, fd, offset);
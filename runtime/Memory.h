@@ -19,6 +19,7 @@
 
 #include <CpuExecutor.h>
 #include <LegacyUtils.h>
+#include <SizeClassPool.h>
 #include <android-base/macros.h>
 #include <android-base/scopeguard.h>
 #include <nnapi/IBuffer.h>
@@ -199,6 +200,11 @@ class RuntimeMemory {
     RuntimeMemory(SharedMemory memory, std::unique_ptr<MemoryValidatorBase> validator);
     explicit RuntimeMemory(SharedBuffer buffer);
 
+    // Drops the references to kMemory that this object holds besides kMemory itself: the cached
+    // RunTimePoolInfo and the burst cache holds. Used by destructors that check whether anything
+    // else still refers to kMemory.
+    void releaseCachedReferences();
+
     // The canonical representation for this memory.  We will use one of the
     // following values when communicating with the drivers.
     const SharedMemory kMemory = std::make_shared<const Memory>();
@@ -268,10 +274,19 @@ class MemoryAshmem : public RuntimeMemory {
     // shared with and accessed by one or more driver processes, MemoryAshmem
     // has shared ownership over the ashmem region.
     //
+    // The region of a destroyed MemoryAshmem is kept in a process-wide pool, keyed by its exact
+    // size, if nothing else refers to it and it is not too small. create() reuses a pooled region
+    // of the same size before it allocates a new one, and zero-fills it like a new region.
+    //
     // On success, returns ANEURALNETWORKS_NO_ERROR and a memory object.
     // On error, returns the appropriate NNAPI error code and nullptr.
     static std::pair<int, std::unique_ptr<MemoryAshmem>> create(uint32_t size);
 
+    // The statistics of the pool of ashmem regions, and a way to free the regions it caches, such
+    // as when the process is low on memory.
+    static PoolStatistics getPoolStatistics();
+    static void trimPool();
+
     // Get a pointer to the ashmem region of memory. The returned pointer is
     // valid for the lifetime of the MemoryAshmem object. This call always
     // returns non-null because it was validated during MemoryAshmem::create.
@@ -283,6 +298,7 @@ class MemoryAshmem : public RuntimeMemory {
 
     // prefer using MemoryAshmem::create
     MemoryAshmem(SharedMemory memory, Mapping mapped);
+    ~MemoryAshmem() override;
 
    private:
     const Mapping kMapping;
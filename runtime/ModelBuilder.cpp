@@ -21,12 +21,15 @@
 #include <GraphDump.h>
 #include <LegacyUtils.h>
 #include <ModelUtils.h>
+#include <ShapeInference.h>
 #include <android-base/logging.h>
 #include <nnapi/Validation.h>
 
 #include <algorithm>
-#include <map>
+#include <chrono>
+#include <limits>
 #include <memory>
+#include <queue>
 #include <set>
 #include <utility>
 #include <vector>
@@ -557,6 +560,9 @@ int ModelBuilder::finish() {
         graphDump("ModelBuilder::finish", modelForValidation, nullptr);
     }
 
+    // NOTE: Must inferShapesOfTemporaries() before simplifyModel(); otherwise, the
+    //       operand indexes of the Model would not match those of mOperands.
+    inferShapesOfTemporaries(modelForValidation);
     removeTrailingArgumentsWithDefaultValues();
     simplifyModel();
 
@@ -566,6 +572,21 @@ int ModelBuilder::finish() {
     return ANEURALNETWORKS_NO_ERROR;
 }
 
+void ModelBuilder::inferShapesOfTemporaries(const Model& model) {
+    Model inferredModel = model;
+    if (inferTemporaryShapes(&inferredModel) == 0) {
+        return;
+    }
+    const std::vector<Operand>& inferredOperands = inferredModel.main.operands;
+    CHECK_EQ(inferredOperands.size(), mOperands.size());
+    for (uint32_t i = 0; i < mOperands.size(); ++i) {
+        if (mOperands[i].dimensions != inferredOperands[i].dimensions) {
+            mDeclaredDimensions.emplace_back(i, std::move(mOperands[i].dimensions));
+            mOperands[i].dimensions = inferredOperands[i].dimensions;
+        }
+    }
+}
+
 static void logRemoval(const Operation& operation, uint32_t count,
                        const std::vector<Operand>& operands) {
     std::ostringstream message;
@@ -822,6 +843,24 @@ uint32_t ModelBuilder::getNumTrailingArgumentsToRemove(const Operation& operatio
     return 0;
 }
 
+// Returns the number of bytes a temporary operand keeps live while it is
+// waiting for its consumers, or 0 if that is not statically known.
+static uint64_t liveSizeOfTemporary(const Operand& operand) {
+    if (operand.lifetime != Operand::LifeTime::TEMPORARY_VARIABLE) {
+        return 0;
+    }
+    if (TypeManager::get()->isTensorType(operand.type) &&
+        (operand.dimensions.empty() ||
+         std::find(operand.dimensions.begin(), operand.dimensions.end(), 0u) !=
+                 operand.dimensions.end())) {
+        return 0;
+    }
+    if (TypeManager::get()->sizeOfDataOverflowsUInt32(operand.type, operand.dimensions)) {
+        return std::numeric_limits<uint32_t>::max();
+    }
+    return TypeManager::get()->getSizeOfData(operand);
+}
+
 bool ModelBuilder::sortIntoRunOrder() {
     // Note that this may be called before the model has been
     // validated, so we must code defensively.  However, we can assume
@@ -833,54 +872,179 @@ bool ModelBuilder::sortIntoRunOrder() {
         return true;
     }
 
-    // Tracks the operations that can be executed.
-    std::vector<uint32_t> sortedOperationIndexMap;
-    std::vector<uint32_t> opsReadyToRun;
-    std::vector<Operation> runOrder;
+    const auto startTime = std::chrono::steady_clock::now();
+    const uint32_t numOperations = operationCount();
+    const uint32_t numOperands = operandCount();
 
-    // Tracks how many inputs are needed for each operation to be ready to run.
-    std::multimap<uint32_t, uint32_t> operandToOperations;
-    std::vector<uint32_t> unknownInputCount(operationCount());
-    for (uint32_t operationIndex = 0; operationIndex < operationCount(); operationIndex++) {
-        uint32_t& count = unknownInputCount[operationIndex];
-        count = 0;
-        for (uint32_t operandIndex : mOperations[operationIndex].inputs) {
-            auto lifetime = mOperands[operandIndex].lifetime;
-            if (lifetime == Operand::LifeTime::TEMPORARY_VARIABLE ||
-                lifetime == Operand::LifeTime::SUBGRAPH_OUTPUT) {
-                count++;
-                operandToOperations.insert(
-                        std::pair<uint32_t, uint32_t>(operandIndex, operationIndex));
+    // Returns true if the operand must be written by an operation before any
+    // operation reading it can run.
+    auto isProduced = [this](uint32_t operandIndex) {
+        const auto lifetime = mOperands[operandIndex].lifetime;
+        return lifetime == Operand::LifeTime::TEMPORARY_VARIABLE ||
+               lifetime == Operand::LifeTime::SUBGRAPH_OUTPUT;
+    };
+
+    // Returns true if the operand index at "it" does not appear earlier in
+    // "indexes".  Operations have few inputs, so a linear search is cheap.
+    auto isFirstOccurrence = [](const std::vector<uint32_t>& indexes,
+                                std::vector<uint32_t>::const_iterator it) {
+        return std::find(indexes.begin(), it, *it) == it;
+    };
+
+    // Build a compressed sparse row (CSR) adjacency from each produced operand
+    // to the distinct operations consuming it.  consumers[consumerOffsets[i]]
+    // through consumers[consumerOffsets[i + 1] - 1] are the operations reading
+    // operand i.  An operation reading the same operand several times is only
+    // listed once.
+    std::vector<uint32_t> consumerOffsets(numOperands + 1, 0);
+    for (const Operation& operation : mOperations) {
+        for (auto it = operation.inputs.begin(); it != operation.inputs.end(); ++it) {
+            if (isProduced(*it) && isFirstOccurrence(operation.inputs, it)) {
+                consumerOffsets[*it + 1]++;
             }
         }
-        if (count == 0) {
-            opsReadyToRun.push_back(operationIndex);
+    }
+    for (uint32_t operandIndex = 0; operandIndex < numOperands; operandIndex++) {
+        consumerOffsets[operandIndex + 1] += consumerOffsets[operandIndex];
+    }
+    std::vector<uint32_t> consumers(consumerOffsets[numOperands]);
+    {
+        std::vector<uint32_t> insertPosition(consumerOffsets.begin(), consumerOffsets.end() - 1);
+        for (uint32_t operationIndex = 0; operationIndex < numOperations; operationIndex++) {
+            const Operation& operation = mOperations[operationIndex];
+            for (auto it = operation.inputs.begin(); it != operation.inputs.end(); ++it) {
+                if (isProduced(*it) && isFirstOccurrence(operation.inputs, it)) {
+                    consumers[insertPosition[*it]++] = operationIndex;
+                }
+            }
         }
     }
 
-    while (opsReadyToRun.size() > 0) {
+    // Tracks how many distinct produced inputs are still needed for each
+    // operation to be ready to run, and how many distinct operations still
+    // have to read each temporary before its storage can be released.
+    std::vector<uint32_t> unknownInputCount(numOperations, 0);
+    std::vector<uint32_t> remainingConsumerCount(numOperands);
+    std::vector<uint64_t> liveSize(numOperands);
+    for (uint32_t operandIndex = 0; operandIndex < numOperands; operandIndex++) {
+        remainingConsumerCount[operandIndex] =
+                consumerOffsets[operandIndex + 1] - consumerOffsets[operandIndex];
+        liveSize[operandIndex] = liveSizeOfTemporary(mOperands[operandIndex]);
+    }
+    for (uint32_t operandIndex = 0; operandIndex < numOperands; operandIndex++) {
+        for (uint32_t i = consumerOffsets[operandIndex]; i < consumerOffsets[operandIndex + 1];
+             i++) {
+            unknownInputCount[consumers[i]]++;
+        }
+    }
+
+    // The change in live temporary bytes caused by running an operation now:
+    // the temporaries it writes become live, and the temporaries for which it
+    // is the last remaining reader are released.  The value only decreases
+    // while an operation is waiting to run, as other readers of its inputs
+    // are scheduled.
+    std::vector<uint8_t> isDone(numOperations, false);
+    auto computeLiveDelta = [&](uint32_t operationIndex) {
+        const Operation& operation = mOperations[operationIndex];
+        int64_t delta = 0;
+        for (uint32_t operandIndex : operation.outputs) {
+            delta += liveSize[operandIndex];
+        }
+        for (auto it = operation.inputs.begin(); it != operation.inputs.end(); ++it) {
+            const uint32_t operandIndex = *it;
+            // If only one reader is left, it must be this operation.
+            if (isProduced(operandIndex) && remainingConsumerCount[operandIndex] == 1 &&
+                isFirstOccurrence(operation.inputs, it)) {
+                delta -= liveSize[operandIndex];
+            }
+        }
+        return delta;
+    };
+
+    // Among the operations that are ready to run, greedily pick the one that
+    // grows the set of live temporaries the least.  Ties are broken in favor
+    // of the operation that became ready (or was rescored) most recently,
+    // which keeps the depth-first flavor of a LIFO ordering so that chains of
+    // operations run back to back.  Entries whose delta is out of date are
+    // skipped when popped.
+    struct ReadyOperation {
+        int64_t liveDelta;
+        uint32_t sequence;
+        uint32_t operationIndex;
+        bool operator<(const ReadyOperation& other) const {
+            // std::priority_queue is a max-heap: the "largest" entry is the
+            // one with the smallest delta and, among those, the latest sequence.
+            if (liveDelta != other.liveDelta) return liveDelta > other.liveDelta;
+            return sequence < other.sequence;
+        }
+    };
+    std::vector<int64_t> currentLiveDelta(numOperations, 0);
+    std::priority_queue<ReadyOperation> opsReadyToRun;
+    uint32_t sequence = 0;
+    auto pushReady = [&](uint32_t operationIndex) {
+        const int64_t delta = computeLiveDelta(operationIndex);
+        currentLiveDelta[operationIndex] = delta;
+        opsReadyToRun.push({delta, sequence++, operationIndex});
+    };
+    for (uint32_t operationIndex = 0; operationIndex < numOperations; operationIndex++) {
+        if (unknownInputCount[operationIndex] == 0) {
+            pushReady(operationIndex);
+        }
+    }
+
+    std::vector<uint32_t> sortedOperationIndexMap;
+    sortedOperationIndexMap.reserve(numOperations);
+    std::vector<uint8_t> isWritten(numOperands, false);
+
+    while (!opsReadyToRun.empty()) {
         // Execute the next op
-        int opIndex = opsReadyToRun.back();
-        opsReadyToRun.pop_back();
+        const ReadyOperation next = opsReadyToRun.top();
+        opsReadyToRun.pop();
+        const uint32_t opIndex = next.operationIndex;
+        if (isDone[opIndex] || next.liveDelta != currentLiveDelta[opIndex]) {
+            continue;
+        }
+        isDone[opIndex] = true;
         const Operation& operation = mOperations[opIndex];
-
-        runOrder.push_back(mOperations[opIndex]);
         sortedOperationIndexMap.push_back(opIndex);
 
         // Mark all its outputs as known.
         for (uint32_t operandIndex : operation.outputs) {
-            auto range = operandToOperations.equal_range(operandIndex);
-            for (auto i = range.first; i != range.second; i++) {
-                uint32_t& count = unknownInputCount[i->second];
-                if (--count == 0) {
-                    opsReadyToRun.push_back(i->second);
+            if (isWritten[operandIndex]) {
+                // The operand has more than one writer; validation will
+                // reject the model, so do not release its readers twice.
+                continue;
+            }
+            isWritten[operandIndex] = true;
+            for (uint32_t i = consumerOffsets[operandIndex]; i < consumerOffsets[operandIndex + 1];
+                 i++) {
+                if (--unknownInputCount[consumers[i]] == 0) {
+                    pushReady(consumers[i]);
+                }
+            }
+        }
+
+        // When a single reader remains for an input, that reader's delta
+        // improves, so rescore it if it is already waiting to run.
+        for (auto it = operation.inputs.begin(); it != operation.inputs.end(); ++it) {
+            const uint32_t operandIndex = *it;
+            if (!isProduced(operandIndex) || !isFirstOccurrence(operation.inputs, it)) continue;
+            uint32_t& count = remainingConsumerCount[operandIndex];
+            CHECK_GT(count, 0u);
+            if (--count == 1 && liveSize[operandIndex] != 0) {
+                for (uint32_t i = consumerOffsets[operandIndex];
+                     i < consumerOffsets[operandIndex + 1]; i++) {
+                    const uint32_t consumer = consumers[i];
+                    if (!isDone[consumer] && unknownInputCount[consumer] == 0) {
+                        pushReady(consumer);
+                    }
                 }
             }
         }
     }
 
-    if (runOrder.size() != mOperations.size()) {
-        CHECK_LT(runOrder.size(), mOperations.size());
+    if (sortedOperationIndexMap.size() != mOperations.size()) {
+        CHECK_LT(sortedOperationIndexMap.size(), mOperations.size());
         // Graph must contain at least one cycle or one never-written
         // operand, because there is at least one Operation that never
         // became ready.
@@ -888,6 +1052,91 @@ bool ModelBuilder::sortIntoRunOrder() {
         return false;
     }
 
+    // Returns the peak number of live temporary bytes while the operations
+    // run in "order".  The outputs of an operation become live before the
+    // inputs for which it is the last reader are released.
+    auto getPeakLiveBytes = [&](const std::vector<uint32_t>& order) {
+        std::vector<uint32_t> remainingReaders(numOperands);
+        for (uint32_t operandIndex = 0; operandIndex < numOperands; operandIndex++) {
+            remainingReaders[operandIndex] =
+                    consumerOffsets[operandIndex + 1] - consumerOffsets[operandIndex];
+        }
+        std::vector<uint8_t> isLive(numOperands, false);
+        uint64_t liveBytes = 0;
+        uint64_t peakLiveBytes = 0;
+        for (uint32_t opIndex : order) {
+            const Operation& operation = mOperations[opIndex];
+            for (uint32_t operandIndex : operation.outputs) {
+                if (!isLive[operandIndex]) {
+                    isLive[operandIndex] = true;
+                    liveBytes += liveSize[operandIndex];
+                }
+            }
+            peakLiveBytes = std::max(peakLiveBytes, liveBytes);
+            for (auto it = operation.inputs.begin(); it != operation.inputs.end(); ++it) {
+                if (isProduced(*it) && isFirstOccurrence(operation.inputs, it) &&
+                    --remainingReaders[*it] == 0) {
+                    liveBytes -= std::min(liveBytes, liveSize[*it]);
+                }
+            }
+        }
+        return peakLiveBytes;
+    };
+
+    // The greedy choice does not look ahead, so on some graphs it ends up
+    // with a higher peak than the depth-first order operations were
+    // previously sorted into, in which the operation that became ready last
+    // runs first.  Compute that order too and keep it if its peak is lower.
+    std::vector<uint32_t> depthFirstOrder;
+    {
+        depthFirstOrder.reserve(numOperations);
+        std::fill(unknownInputCount.begin(), unknownInputCount.end(), 0);
+        for (uint32_t i = 0; i < consumerOffsets[numOperands]; i++) {
+            unknownInputCount[consumers[i]]++;
+        }
+        std::vector<uint32_t> readyStack;
+        for (uint32_t operationIndex = 0; operationIndex < numOperations; operationIndex++) {
+            if (unknownInputCount[operationIndex] == 0) {
+                readyStack.push_back(operationIndex);
+            }
+        }
+        std::fill(isWritten.begin(), isWritten.end(), false);
+        while (!readyStack.empty()) {
+            const uint32_t opIndex = readyStack.back();
+            readyStack.pop_back();
+            depthFirstOrder.push_back(opIndex);
+            for (uint32_t operandIndex : mOperations[opIndex].outputs) {
+                if (isWritten[operandIndex]) continue;
+                isWritten[operandIndex] = true;
+                for (uint32_t i = consumerOffsets[operandIndex];
+                     i < consumerOffsets[operandIndex + 1]; i++) {
+                    if (--unknownInputCount[consumers[i]] == 0) {
+                        readyStack.push_back(consumers[i]);
+                    }
+                }
+            }
+        }
+        CHECK_EQ(depthFirstOrder.size(), sortedOperationIndexMap.size());
+    }
+    uint64_t peakLiveBytes = getPeakLiveBytes(sortedOperationIndexMap);
+    const uint64_t depthFirstPeakLiveBytes = getPeakLiveBytes(depthFirstOrder);
+    if (depthFirstPeakLiveBytes < peakLiveBytes) {
+        sortedOperationIndexMap = std::move(depthFirstOrder);
+        peakLiveBytes = depthFirstPeakLiveBytes;
+    }
+
+    std::vector<Operation> runOrder;
+    runOrder.reserve(numOperations);
+    for (uint32_t opIndex : sortedOperationIndexMap) {
+        runOrder.push_back(std::move(mOperations[opIndex]));
+    }
+
+    VLOG(MODEL) << __func__ << " sorted " << numOperations << " operations in "
+                << std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - startTime)
+                           .count()
+                << "us, peak live temporary bytes " << peakLiveBytes;
+
     mSortedOperationIndexMap = std::move(sortedOperationIndexMap);
     mOperations = std::move(runOrder);
     return true;
@@ -896,11 +1145,12 @@ bool ModelBuilder::sortIntoRunOrder() {
 // A helper class to simplify state management when creating a Model.
 class ModelBuilder::ModelMaker {
    public:
-    static Model run(const ModelBuilder* model, bool simplifyModel);
+    static Model run(const ModelBuilder* model, bool simplifyModel, bool withInferredDimensions);
 
    private:
-    static Model::Subgraph makeSubgraph(const ModelBuilder* model);
-    explicit ModelMaker(bool simplifyModel) : mSimplifyModel(simplifyModel) {}
+    Model::Subgraph makeSubgraph(const ModelBuilder* model);
+    ModelMaker(bool simplifyModel, bool withInferredDimensions)
+        : mSimplifyModel(simplifyModel), mWithInferredDimensions(withInferredDimensions) {}
     Model makeModel(const ModelBuilder* mainModel);
     uint32_t addSubgraph(const ModelBuilder* refModel);
     void updateOperandLocations(const ModelBuilder* refModel, Model::Subgraph* subgraph);
@@ -908,6 +1158,7 @@ class ModelBuilder::ModelMaker {
     void addExtensionWithPrefix(uint16_t prefix);
 
     bool mSimplifyModel;
+    bool mWithInferredDimensions;
     std::vector<Model::Subgraph> mRefSubgraphs;
     Model::OperandValues mOperandValues;
     MemoryTracker mMemories;
@@ -919,14 +1170,15 @@ void ModelBuilder::simplifyModel() {
     mSimplifyModel = true;
 }
 
-Model ModelBuilder::makeModel() const {
+Model ModelBuilder::makeModel(bool withInferredDimensions) const {
     // TODO: Cache the Model to speed up subsequent calls.
-    return ModelMaker::run(this, mSimplifyModel);
+    return ModelMaker::run(this, mSimplifyModel, withInferredDimensions);
 }
 
-Model ModelBuilder::ModelMaker::run(const ModelBuilder* model, bool simplifyModel) {
+Model ModelBuilder::ModelMaker::run(const ModelBuilder* model, bool simplifyModel,
+                                    bool withInferredDimensions) {
     // run() ensures the state of ModelMaker is destroyed after the call.
-    return ModelMaker(simplifyModel).makeModel(model);
+    return ModelMaker(simplifyModel, withInferredDimensions).makeModel(model);
 }
 
 Model ModelBuilder::ModelMaker::makeModel(const ModelBuilder* mainModel) {
@@ -950,6 +1202,11 @@ Model ModelBuilder::ModelMaker::makeModel(const ModelBuilder* mainModel) {
 Model::Subgraph ModelBuilder::ModelMaker::makeSubgraph(const ModelBuilder* model) {
     Model::Subgraph subgraph;
     subgraph.operands = model->mOperands;
+    if (!mWithInferredDimensions) {
+        for (const auto& [operandIndex, dimensions] : model->mDeclaredDimensions) {
+            subgraph.operands[operandIndex].dimensions = dimensions;
+        }
+    }
     subgraph.operations = model->mOperations;
     subgraph.inputIndexes = model->mInputIndexes;
     subgraph.outputIndexes = model->mOutputIndexes;
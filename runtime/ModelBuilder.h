@@ -23,6 +23,7 @@
 #include <LegacyUtils.h>
 
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include "Memory.h"
@@ -74,7 +75,10 @@ class ModelBuilder {
                           const std::vector<std::shared_ptr<Device>>& devices,
                           bool explicitDeviceList = false);
 
-    Model makeModel() const;
+    // Returns the model as declared by the client. If withInferredDimensions is true, the
+    // temporaries specified by inferShapesOfTemporaries() have their inferred dimensions instead,
+    // which is what the drivers are asked to support and to prepare.
+    Model makeModel(bool withInferredDimensions = false) const;
 
     uint32_t operandCount() const {
         // We don't allow more than uint32_t worth of operands
@@ -186,6 +190,12 @@ class ModelBuilder {
     // Copies the large values to a shared memory, if we have any.
     int copyLargeValuesToSharedMemory();
 
+    // Specifies the dimensions of the temporaries that can be computed from the dimensions of the
+    // model inputs and of the constants, so that the partitioner does not have to treat them as
+    // dynamic temporaries. makeModel() still reports the dimensions as declared by the client,
+    // unless asked for the inferred ones.
+    void inferShapesOfTemporaries(const Model& model);
+
     // Mark that the model should be simplified during ModelBuilder::makeModel, removing arguments
     // from operations that already match the default values, dead operands, dead pools, dead
     // subgraphs, and dead extensions.
@@ -202,6 +212,9 @@ class ModelBuilder {
     bool mHasExtensionOperation = false;
     // The description of the operands of the graph.
     std::vector<Operand> mOperands;
+    // The operand index and the declared dimensions of the temporaries of mOperands whose
+    // dimensions were specified by inferShapesOfTemporaries().
+    std::vector<std::pair<uint32_t, Dimensions>> mDeclaredDimensions;
     // Is at least one of those operands an OEM operand?
     bool mHasOEMOperand = false;
     // The indexes of input operands of the model.
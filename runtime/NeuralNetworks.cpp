@@ -760,7 +760,7 @@ int ANeuralNetworksModel_getSupportedOperationsForDevices(
         return ANEURALNETWORKS_BAD_STATE;
     }
 
-    const Model canonicalModel = m->makeModel();
+    const Model canonicalModel = m->makeModel(/*withInferredDimensions=*/true);
     const std::vector<uint32_t>& opMap = m->getSortedOperationMapping();
     // init the output array to false for all the operations.
     std::fill(supportedOps, supportedOps + opMap.size(), false);
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks every generated test model on the host, both through CpuExecutor directly and through
+// the canonical sample driver. Besides the time per run reported by Google Benchmark, each
+// benchmark reports the p50, p90 and p99 latencies of its runs, and the number of allocations and
+// the peak of allocated memory of one run.
+//
+// Example:
+//   NeuralNetworksBenchmark_models --benchmark_filter='CpuExecutor/conv.*'
+//       --benchmark_out=new.json --benchmark_out_format=json
+//   tools/compare_model_benchmarks.py old.json new.json
+
+#include <CanonicalDevice.h>
+#include <CpuExecutor.h>
+#include <TestHarness.h>
+#include <android-base/logging.h>
+#include <benchmark/benchmark.h>
+#include <malloc.h>
+#include <nnapi/IDevice.h>
+#include <nnapi/IPreparedModel.h>
+#include <nnapi/Result.h>
+#include <nnapi/TestUtils.h>
+#include <nnapi/Types.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace android::nn {
+namespace {
+
+using ::test_helper::TestModel;
+using ::test_helper::TestModelManager;
+
+// The number of runs of a model before it is measured, which warm up the caches and any state
+// that is initialized lazily.
+constexpr int kNumWarmupRuns = 3;
+
+// The number of latencies reserved ahead of the measured runs. Google Benchmark usually runs far
+// fewer iterations than state.max_iterations, so the vector grows beyond this only when asked to.
+constexpr benchmark::IterationCount kNumReservedLatencies = 1 << 16;
+
+// Allocation statistics, which are only updated while isCountingAllocations is set.
+std::atomic<bool> isCountingAllocations = false;
+std::atomic<uint64_t> numAllocations = 0;
+std::atomic<int64_t> allocatedBytes = 0;
+std::atomic<int64_t> peakAllocatedBytes = 0;
+
+void countAllocation(void* pointer) {
+    if (!isCountingAllocations.load(std::memory_order_relaxed)) return;
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    const auto size = static_cast<int64_t>(malloc_usable_size(pointer));
+    const int64_t bytes = allocatedBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    int64_t peak = peakAllocatedBytes.load(std::memory_order_relaxed);
+    while (bytes > peak &&
+           !peakAllocatedBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {
+    }
+}
+
+void countDeallocation(void* pointer) {
+    if (pointer == nullptr || !isCountingAllocations.load(std::memory_order_relaxed)) return;
+    allocatedBytes.fetch_sub(static_cast<int64_t>(malloc_usable_size(pointer)),
+                             std::memory_order_relaxed);
+}
+
+// Runs a model once and returns whether the run succeeded.
+using RunFunction = std::function<bool()>;
+
+GeneralResult<RunFunction> prepareForCpuExecutor(const TestModel& testModel) {
+    auto model = std::make_shared<const Model>(NN_TRY(test::createModel(testModel)));
+    auto request = std::make_shared<const Request>(NN_TRY(test::createRequest(testModel)));
+    auto modelPoolInfos = std::make_shared<std::vector<RunTimePoolInfo>>();
+    NN_RET_CHECK(setRunTimePoolInfosFromCanonicalMemories(modelPoolInfos.get(), model->pools));
+    auto requestPoolInfos = std::make_shared<std::vector<RunTimePoolInfo>>();
+    NN_RET_CHECK(setRunTimePoolInfosFromMemoryPools(requestPoolInfos.get(), request->pools));
+    return [model, request, modelPoolInfos, requestPoolInfos] {
+        CpuExecutor executor;
+        return executor.run(*model, *request, *modelPoolInfos, *requestPoolInfos) ==
+               ANEURALNETWORKS_NO_ERROR;
+    };
+}
+
+GeneralResult<RunFunction> prepareForSampleDriver(const TestModel& testModel) {
+    static const SharedDevice device = std::make_shared<const sample::Device>("benchmark-driver");
+    const auto model = NN_TRY(test::createModel(testModel));
+    SharedPreparedModel preparedModel = NN_TRY(device->prepareModel(
+            model, ExecutionPreference::FAST_SINGLE_ANSWER, Priority::DEFAULT, /*deadline=*/{},
+            /*modelCache=*/{}, /*dataCache=*/{}, /*token=*/{}, /*hints=*/{},
+            /*extensionNameToPrefix=*/{}));
+    auto request = std::make_shared<const Request>(NN_TRY(test::createRequest(testModel)));
+    return [preparedModel = std::move(preparedModel), request] {
+        return preparedModel
+                ->execute(*request, MeasureTiming::NO, /*deadline=*/{},
+                          /*loopTimeoutDuration=*/{}, /*hints=*/{}, /*extensionNameToPrefix=*/{})
+                .has_value();
+    };
+}
+
+double getPercentile(const std::vector<double>& sortedValues, double percentile) {
+    const auto index = static_cast<size_t>(percentile / 100.0 * (sortedValues.size() - 1) + 0.5);
+    return sortedValues[index];
+}
+
+void BM_Model(benchmark::State& state, const TestModel* testModel,
+              GeneralResult<RunFunction> (*prepare)(const TestModel&)) {
+    const auto run = prepare(*testModel);
+    if (!run.has_value()) {
+        state.SkipWithError(("Failed to prepare the model: " + run.error().message).c_str());
+        return;
+    }
+    for (int i = 0; i < kNumWarmupRuns; ++i) {
+        if (!(*run)()) {
+            state.SkipWithError("Failed to run the model");
+            return;
+        }
+    }
+
+    std::vector<double> latencies;
+    latencies.reserve(std::min(state.max_iterations, kNumReservedLatencies));
+    for (auto _ : state) {
+        const auto start = std::chrono::steady_clock::now();
+        const bool success = (*run)();
+        const auto end = std::chrono::steady_clock::now();
+        if (!success) {
+            state.SkipWithError("Failed to run the model");
+            break;
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    if (state.error_occurred()) {
+        return;
+    }
+
+    // Count the allocations of one more run, outside of the measured ones.
+    numAllocations = 0;
+    allocatedBytes = 0;
+    peakAllocatedBytes = 0;
+    isCountingAllocations = true;
+    const bool success = (*run)();
+    isCountingAllocations = false;
+    if (!success) {
+        state.SkipWithError("Failed to run the model");
+        return;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    state.counters["p50_us"] = getPercentile(latencies, 50);
+    state.counters["p90_us"] = getPercentile(latencies, 90);
+    state.counters["p99_us"] = getPercentile(latencies, 99);
+    state.counters["allocations"] = static_cast<double>(numAllocations.load());
+    state.counters["peak_bytes"] = static_cast<double>(peakAllocatedBytes.load());
+}
+
+void registerBenchmarks() {
+    const auto testModels = TestModelManager::get().getTestModels(
+            [](const TestModel& testModel) { return !testModel.expectFailure; });
+    for (const auto& [name, testModel] : testModels) {
+        benchmark::RegisterBenchmark(("CpuExecutor/" + name).c_str(), BM_Model, testModel,
+                                     prepareForCpuExecutor)
+                ->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark(("SampleDriver/" + name).c_str(), BM_Model, testModel,
+                                     prepareForSampleDriver)
+                ->Unit(benchmark::kMicrosecond);
+    }
+}
+
+}  // namespace
+}  // namespace android::nn
+
+// Allocations are counted by replacing the global operator new and operator delete, and their
+// forms for over-aligned types. The other forms of them, such as the array and the sized ones,
+// call these.
+void* operator new(size_t size) {
+    void* pointer = std::malloc(size == 0 ? 1 : size);
+    CHECK(pointer != nullptr) << "Failed to allocate " << size << " bytes";
+    android::nn::countAllocation(pointer);
+    return pointer;
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    const auto alignmentBytes = static_cast<size_t>(alignment);
+    // aligned_alloc requires a size that is a multiple of the alignment.
+    const size_t alignedSize = std::max((size + alignmentBytes - 1) & ~(alignmentBytes - 1),
+                                        alignmentBytes);
+    void* pointer = std::aligned_alloc(alignmentBytes, alignedSize);
+    CHECK(pointer != nullptr) << "Failed to allocate " << size << " bytes aligned to "
+                              << alignmentBytes;
+    android::nn::countAllocation(pointer);
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+    android::nn::countDeallocation(pointer);
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t /*size*/) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t /*alignment*/) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t /*size*/, std::align_val_t /*alignment*/) noexcept {
+    operator delete(pointer);
+}
+
+int main(int argc, char** argv) {
+    android::nn::registerBenchmarks();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
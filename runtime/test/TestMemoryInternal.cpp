@@ -22,8 +22,10 @@
 #include <android/sharedmem.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <fstream>
 #include <string>
+#include <vector>
 
 #include "Manager.h"
 #include "Memory.h"
@@ -66,11 +68,14 @@ class MemoryLeakTest : public ::testing::Test {
 
 void MemoryLeakTest::SetUp() {
     mIsCpuOnly = android::nn::DeviceManager::get()->getUseCpuOnly();
+    // The regions of destroyed runtime memories are kept mapped for reuse, which is not a leak.
+    android::nn::MemoryAshmem::trimPool();
     mStartingMapCount = GetAshmemMappingsCount();
 }
 
 void MemoryLeakTest::TearDown() {
     android::nn::DeviceManager::get()->setUseCpuOnly(mIsCpuOnly);
+    android::nn::MemoryAshmem::trimPool();
     const size_t endingMapCount = GetAshmemMappingsCount();
     ASSERT_EQ(mStartingMapCount, endingMapCount);
 }
@@ -255,6 +260,70 @@ TEST_F(MemoryLeakTest, convTooLarge) {
 
     ASSERT_EQ(WrapperResult::OP_FAILED, r);
 }
+
+// Checks that the ashmem region of a device memory that was used by an execution is reused after
+// the memory is freed, and that it is zero-filled when it is reused.
+TEST_F(MemoryLeakTest, ExecutedDeviceMemoryIsReused) {
+    android::nn::DeviceManager::get()->setUseCpuOnly(true);
+
+    // Large enough for the region to be pooled.
+    constexpr uint32_t kNumElements = 64 * 1024;
+    constexpr uint32_t kSize = kNumElements * sizeof(float);
+    WrapperModel model;
+    WrapperOperandType tensorType(WrapperType::TENSOR_FLOAT32, {kNumElements});
+    WrapperOperandType scalarType(WrapperType::INT32, {});
+    int32_t activation(0);
+    auto a = model.addOperand(&tensorType);
+    auto b = model.addOperand(&tensorType);
+    auto c = model.addOperand(&tensorType);
+    auto f = model.addOperand(&scalarType);
+    model.setOperandValue(f, &activation, sizeof(activation));
+    model.addOperation(ANEURALNETWORKS_ADD, {a, b, f}, {c});
+    model.identifyInputsAndOutputs({a, b}, {c});
+    ASSERT_TRUE(model.isValid());
+    model.finish();
+    WrapperCompilation compilation(&model);
+    ASSERT_EQ(compilation.finish(), WrapperResult::NO_ERROR);
+
+    ANeuralNetworksMemoryDesc* desc = nullptr;
+    ASSERT_EQ(ANeuralNetworksMemoryDesc_create(&desc), ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(ANeuralNetworksMemoryDesc_addOutputRole(desc, compilation.getHandle(), 0, 1.0f),
+              ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(ANeuralNetworksMemoryDesc_finish(desc), ANEURALNETWORKS_NO_ERROR);
+    ANeuralNetworksMemory* annMemory = nullptr;
+    ASSERT_EQ(ANeuralNetworksMemory_createFromDesc(desc, &annMemory), ANEURALNETWORKS_NO_ERROR);
+    ANeuralNetworksMemoryDesc_free(desc);
+
+    const std::vector<float> input(kNumElements, 1.0f);
+    const android::nn::PoolStatistics before = android::nn::MemoryAshmem::getPoolStatistics();
+    {
+        WrapperMemory memory(annMemory);
+        WrapperExecution execution(&compilation);
+        ASSERT_EQ(execution.setInput(0, input.data(), kSize), WrapperResult::NO_ERROR);
+        ASSERT_EQ(execution.setInput(1, input.data(), kSize), WrapperResult::NO_ERROR);
+        ASSERT_EQ(execution.setOutputFromMemory(0, &memory, 0, 0), WrapperResult::NO_ERROR);
+        ASSERT_EQ(execution.compute(), WrapperResult::NO_ERROR);
+    }
+    const android::nn::PoolStatistics released = android::nn::MemoryAshmem::getPoolStatistics();
+    EXPECT_EQ(released.numReleases, before.numReleases + 1);
+    EXPECT_EQ(released.numDiscards, before.numDiscards);
+
+    const auto [n, ashmem] = android::nn::MemoryAshmem::create(kSize);
+    ASSERT_EQ(n, ANEURALNETWORKS_NO_ERROR);
+    EXPECT_EQ(android::nn::MemoryAshmem::getPoolStatistics().numReuses, released.numReuses + 1);
+    const uint8_t* data = ashmem->getPointer();
+    EXPECT_TRUE(std::all_of(data, data + kSize, [](uint8_t byte) { return byte == 0; }));
+}
+
+// Checks that small ashmem regions are not pooled.
+TEST_F(MemoryLeakTest, SmallAshmemIsNotPooled) {
+    const android::nn::PoolStatistics before = android::nn::MemoryAshmem::getPoolStatistics();
+    {
+        const auto [n, ashmem] = android::nn::MemoryAshmem::create(sizeof(Matrix3x4));
+        ASSERT_EQ(n, ANEURALNETWORKS_NO_ERROR);
+    }
+    EXPECT_EQ(android::nn::MemoryAshmem::getPoolStatistics().numReleases, before.numReleases);
+}
 #endif  // NNTEST_ONLY_PUBLIC_API
 
 }  // end namespace
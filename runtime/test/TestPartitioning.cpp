@@ -2248,6 +2248,85 @@ TEST_F(PartitioningTest, ZeroOutputStepModel) {
     checkExecutionPlanSteps(compilation.getExecutionPlan(), {cpuDeviceName});
 }
 
+// Test that a temporary whose shape can be computed from the shapes of the model inputs is not
+// treated as a dynamic temporary, as in the models of TestUnknownDimensions.
+//
+// opnd0 = model input
+// opnd1 = model input
+// opnd2 = ADD(opnd0, opnd1, FUSED_NONE)  // dimensions not specified
+// opnd3 = model input
+// opnd4 = MUL(opnd2, opnd3, FUSED_NONE)  // model output
+TEST_F(PartitioningTest, TemporaryOfSpecifiedInputsIsNotDynamic) {
+    const std::vector<std::vector<uint32_t>> inputDimensions = {{3, 3}, {0, 3}, {3, 0}, {0, 0}};
+    const auto devices = makeDevices({{"add", 0.9, 1 << kFirstEncodingADD},
+                                      {"mul", 0.9, 1 << kFirstEncodingMUL}});
+    size_t dynamicTemporaryCount = 0;
+    for (const auto& opnd0Dimensions : inputDimensions) {
+        for (const auto& opnd1Dimensions : inputDimensions) {
+            SCOPED_TRACE(testing::Message()
+                         << "opnd0: " << testing::PrintToString(opnd0Dimensions)
+                         << ", opnd1: " << testing::PrintToString(opnd1Dimensions));
+            PartitioningModel model;
+            uint32_t opnd0 = model.addOperand(
+                    WrapperOperandType{WrapperType::TENSOR_FLOAT32, opnd0Dimensions});
+            uint32_t opnd1 = model.addOperand(
+                    WrapperOperandType{WrapperType::TENSOR_FLOAT32, opnd1Dimensions});
+            uint32_t opnd2 = model.addOperation2To1V1_0(0, opnd0, opnd1, Dimensioned::NO);
+            uint32_t opnd3 =
+                    model.addOperand(WrapperOperandType{WrapperType::TENSOR_FLOAT32, {3, 3}});
+            uint32_t opnd4 = model.addOperation2To1V1_0(kFirstEncodingMUL, opnd2, opnd3,
+                                                        Dimensioned::NO);
+            model.identifyInputsAndOutputs({opnd0, opnd1, opnd3}, {opnd4});
+            model.finish();
+            ASSERT_TRUE(model.isValid());
+
+            ExecutionPlan plan;
+            ASSERT_EQ(model.partitionTheWork(devices, ExecutePreference::PREFER_LOW_POWER,
+                                             ExecutePriority::DEFAULT, {}, &plan),
+                      ANEURALNETWORKS_NO_ERROR);
+            ASSERT_EQ(plan.forTest_getKind(), ExecutionPlan::Kind::COMPOUND);
+            const bool specified = opnd0Dimensions == inputDimensions[0] &&
+                                   opnd1Dimensions == inputDimensions[0];
+            const auto dynamicTemporaries = plan.forTest_flatGetDynamicTemporaries();
+            EXPECT_EQ(dynamicTemporaries.empty(), specified);
+            dynamicTemporaryCount += dynamicTemporaries.size();
+        }
+    }
+    // Only the model whose inputs are all fully specified has no dynamic temporary.
+    EXPECT_EQ(dynamicTemporaryCount, inputDimensions.size() * inputDimensions.size() - 1);
+}
+
+// Test that a device that does not support unspecified dimensions is asked to support the
+// operations whose temporaries are specified by shape inference, rather than the declared model.
+//
+// opnd0 = model input
+// opnd1 = model input
+// opnd2 = ADD(opnd0, opnd1, FUSED_NONE)  // dimensions not specified
+// opnd3 = model input
+// opnd4 = MUL(opnd2, opnd3, FUSED_NONE)  // model output
+TEST_F(PartitioningTest, TemporaryOfSpecifiedInputsIsSupportedByV1_0Device) {
+    PartitioningModel model;
+    uint32_t opnd0 = model.addFloatOperand();
+    uint32_t opnd1 = model.addFloatOperand();
+    uint32_t opnd2 = model.addOperation2To1V1_0(0, opnd0, opnd1, Dimensioned::NO);
+    uint32_t opnd3 = model.addFloatOperand();
+    uint32_t opnd4 = model.addOperation2To1V1_0(kFirstEncodingMUL, opnd2, opnd3);
+    model.identifyInputsAndOutputs({opnd0, opnd1, opnd3}, {opnd4});
+    model.finish();
+    ASSERT_TRUE(model.isValid());
+
+    // Unspecified dimensions require V1_2, so the V1_0 device would only support MUL, and ADD
+    // would run on the CPU, if it were asked about the declared model.
+    const auto devices = makeDevices({{"V1_0", 0.5, HalVersion::V1_0, ~0U}});
+    ExecutionPlan plan;
+    ASSERT_EQ(model.partitionTheWork(devices, ExecutePreference::PREFER_LOW_POWER,
+                                     ExecutePriority::DEFAULT, {}, &plan),
+              ANEURALNETWORKS_NO_ERROR);
+    ASSERT_EQ(plan.forTest_getKind(), ExecutionPlan::Kind::SIMPLE);
+    ASSERT_NE(plan.forTest_simpleGetDevice().get(), nullptr);
+    EXPECT_EQ(plan.forTest_simpleGetDevice()->getName(), "V1_0");
+}
+
 // Test dynamic temporaries and related parts of the partitioning implementation.
 //
 // opnd0 = model input                   // tensor to pad
@@ -2605,6 +2684,34 @@ TEST_F(DynamicTemporariesTest, ModelOutput4InsufficientSizeWithoutDynamicTempora
     ASSERT_NO_FATAL_FAILURE(executeCompilationAndCompareOutput(true, false));
 }
 
+TEST_F(DynamicTemporariesTest, RepeatedInputShapesReuseLengths) {
+    // The purpose of this test is to confirm that the lengths of dynamic
+    // temporaries learned by an execution are reused by the next execution
+    // with the same input shapes, and that the reused lengths are correct.
+
+    ASSERT_NO_FATAL_FAILURE(makeModelAndValidate());
+    ASSERT_NO_FATAL_FAILURE(compileModelAndComparePlan());
+    const ExecutionPlan& plan = mCompilation->getExecutionPlan();
+
+    // The first execution learns the length of opnd3 through OUTPUT_INSUFFICIENT_SIZE and runs
+    // the step defining it again.
+    ASSERT_NO_FATAL_FAILURE(executeCompilationAndCompareOutput(true, true));
+    const auto firstStatistics = plan.getDynamicTemporariesCacheStatistics();
+    EXPECT_EQ(firstStatistics.numMisses, 1u);
+    EXPECT_EQ(firstStatistics.numHits, 0u);
+    EXPECT_GE(firstStatistics.numFallbacks, 1u);
+    EXPECT_EQ(firstStatistics.numEntries, 1u);
+
+    // The second execution allocates opnd3 big enough in the first place, so no step reports
+    // OUTPUT_INSUFFICIENT_SIZE and none is run again.
+    ASSERT_NO_FATAL_FAILURE(executeCompilationAndCompareOutput(true, true));
+    const auto secondStatistics = plan.getDynamicTemporariesCacheStatistics();
+    EXPECT_EQ(secondStatistics.numMisses, 1u);
+    EXPECT_EQ(secondStatistics.numHits, 1u);
+    EXPECT_EQ(secondStatistics.numFallbacks, firstStatistics.numFallbacks);
+    EXPECT_EQ(secondStatistics.numEntries, 1u);
+}
+
 // Test token rehashing during the compilation step.
 class CacheTest : public PartitioningTest {
    protected:
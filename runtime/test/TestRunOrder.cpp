@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <LegacyUtils.h>
+#include <gtest/gtest.h>
+#include <nnapi/Types.h>
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "ModelBuilder.h"
+#include "TestNeuralNetworksWrapper.h"
+
+// Tests the order into which ModelBuilder::sortIntoRunOrder() puts the operations of a model.
+
+namespace android::nn {
+namespace {
+
+using WrapperModel = test_wrapper::Model;
+using WrapperOperandType = test_wrapper::OperandType;
+using WrapperResult = test_wrapper::Result;
+using WrapperType = test_wrapper::Type;
+
+// Returns true if every operation in "order", a list of indexes of the operations of the subgraph,
+// runs after the operations writing its inputs, and every operation runs exactly once.
+bool isRunOrder(const Model::Subgraph& subgraph, const std::vector<uint32_t>& order) {
+    std::vector<uint32_t> sortedOrder = order;
+    std::sort(sortedOrder.begin(), sortedOrder.end());
+    for (uint32_t i = 0; i < sortedOrder.size(); ++i) {
+        if (sortedOrder[i] != i) return false;
+    }
+    if (sortedOrder.size() != subgraph.operations.size()) return false;
+
+    std::vector<bool> isWritten(subgraph.operands.size(), false);
+    for (uint32_t operationIndex : order) {
+        const Operation& operation = subgraph.operations[operationIndex];
+        for (uint32_t operandIndex : operation.inputs) {
+            const Operand::LifeTime lifetime = subgraph.operands[operandIndex].lifetime;
+            if ((lifetime == Operand::LifeTime::TEMPORARY_VARIABLE ||
+                 lifetime == Operand::LifeTime::SUBGRAPH_OUTPUT) &&
+                !isWritten[operandIndex]) {
+                return false;
+            }
+        }
+        for (uint32_t operandIndex : operation.outputs) {
+            isWritten[operandIndex] = true;
+        }
+    }
+    return true;
+}
+
+// Returns the peak number of bytes of temporaries that are live while the operations of the
+// subgraph run in "order". As in sortIntoRunOrder(), the outputs of an operation become live before
+// the inputs for which it is the last reader are released.
+uint64_t getPeakLiveBytes(const Model::Subgraph& subgraph, const std::vector<uint32_t>& order) {
+    std::vector<uint32_t> remainingReaders(subgraph.operands.size(), 0);
+    for (const Operation& operation : subgraph.operations) {
+        for (uint32_t operandIndex : operation.inputs) {
+            ++remainingReaders[operandIndex];
+        }
+    }
+    auto liveSize = [&subgraph](uint32_t operandIndex) -> uint64_t {
+        const Operand& operand = subgraph.operands[operandIndex];
+        return operand.lifetime == Operand::LifeTime::TEMPORARY_VARIABLE
+                       ? nonExtensionOperandSizeOfData(operand)
+                       : 0;
+    };
+    uint64_t liveBytes = 0;
+    uint64_t peakLiveBytes = 0;
+    for (uint32_t operationIndex : order) {
+        const Operation& operation = subgraph.operations[operationIndex];
+        for (uint32_t operandIndex : operation.outputs) {
+            liveBytes += liveSize(operandIndex);
+        }
+        peakLiveBytes = std::max(peakLiveBytes, liveBytes);
+        for (uint32_t operandIndex : operation.inputs) {
+            if (--remainingReaders[operandIndex] == 0) {
+                liveBytes -= liveSize(operandIndex);
+            }
+        }
+    }
+    return peakLiveBytes;
+}
+
+// Returns the indexes of the operations of the subgraph in the order they are stored.
+std::vector<uint32_t> getStoredOrder(const Model::Subgraph& subgraph) {
+    std::vector<uint32_t> order(subgraph.operations.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    return order;
+}
+
+// Returns the order that sortIntoRunOrder() chose before it accounted for live temporaries: the
+// operation that became ready last runs first. sortedToAdded maps the index of each operation of
+// the subgraph to the index at which the operation was added to the model, as the previous sort
+// depended on the order the operations were added in.
+std::vector<uint32_t> getPreviousOrder(const Model::Subgraph& subgraph,
+                                       const std::vector<uint32_t>& sortedToAdded) {
+    const uint32_t numOperations = subgraph.operations.size();
+    std::vector<uint32_t> addedToSorted(numOperations);
+    for (uint32_t i = 0; i < numOperations; ++i) {
+        addedToSorted[sortedToAdded[i]] = i;
+    }
+    auto isProduced = [&subgraph](uint32_t operandIndex) {
+        const Operand::LifeTime lifetime = subgraph.operands[operandIndex].lifetime;
+        return lifetime == Operand::LifeTime::TEMPORARY_VARIABLE ||
+               lifetime == Operand::LifeTime::SUBGRAPH_OUTPUT;
+    };
+    std::vector<uint32_t> unknownInputCount(numOperations, 0);
+    std::vector<uint32_t> opsReadyToRun;
+    for (uint32_t added = 0; added < numOperations; ++added) {
+        const Operation& operation = subgraph.operations[addedToSorted[added]];
+        unknownInputCount[added] = static_cast<uint32_t>(
+                std::count_if(operation.inputs.begin(), operation.inputs.end(), isProduced));
+        if (unknownInputCount[added] == 0) {
+            opsReadyToRun.push_back(added);
+        }
+    }
+    std::vector<uint32_t> order;
+    while (!opsReadyToRun.empty()) {
+        const uint32_t added = opsReadyToRun.back();
+        opsReadyToRun.pop_back();
+        order.push_back(addedToSorted[added]);
+        for (uint32_t operandIndex : subgraph.operations[addedToSorted[added]].outputs) {
+            for (uint32_t reader = 0; reader < numOperations; ++reader) {
+                for (uint32_t input : subgraph.operations[addedToSorted[reader]].inputs) {
+                    if (input == operandIndex && --unknownInputCount[reader] == 0) {
+                        opsReadyToRun.push_back(reader);
+                    }
+                }
+            }
+        }
+    }
+    return order;
+}
+
+class RunOrderTest : public ::testing::Test {
+   protected:
+    const WrapperOperandType kTypeActivation{WrapperType::INT32, {}};
+    const WrapperOperandType kTypeRow{WrapperType::TENSOR_FLOAT32, {1, 250}};
+    const WrapperOperandType kTypeMatrix{WrapperType::TENSOR_FLOAT32, {8, 250}};
+    const int32_t kActivation = ANEURALNETWORKS_FUSED_NONE;
+
+    uint32_t addRelu(WrapperModel* model, uint32_t input, const WrapperOperandType& type) {
+        const uint32_t output = model->addOperand(&type);
+        model->addOperation(ANEURALNETWORKS_RELU, {input}, {output});
+        return output;
+    }
+
+    uint32_t addAdd(WrapperModel* model, uint32_t input0, uint32_t input1,
+                    const WrapperOperandType& type) {
+        const uint32_t activation = model->addConstantOperand(&kTypeActivation, kActivation);
+        const uint32_t output = model->addOperand(&type);
+        model->addOperation(ANEURALNETWORKS_ADD, {input0, input1, activation}, {output});
+        return output;
+    }
+
+    // Returns the main subgraph of the finished model and the mapping from the index of each of
+    // its operations to the index of the operation in the order the operations were added.
+    std::pair<Model::Subgraph, std::vector<uint32_t>> finish(WrapperModel* model) {
+        EXPECT_EQ(model->finish(), WrapperResult::NO_ERROR);
+        const auto* modelBuilder = reinterpret_cast<const ModelBuilder*>(model->getHandle());
+        EXPECT_TRUE(modelBuilder->isValid());
+        return {modelBuilder->makeModel().main, modelBuilder->getSortedOperationMapping()};
+    }
+};
+
+// Builds
+//
+//   a = RELU(row)         // 1000 bytes
+//   b = RELU(row)         // 1000 bytes
+//   ab = ADD(a, b)        // 1000 bytes
+//   c = RELU(matrix)      // 8000 bytes
+//   output = ADD(ab, c)   // model output
+//
+// with the operation writing c added after the ones writing a and b. The previous depth-first sort
+// ran the operation that became ready last first, so c was live while a, b and ab were computed,
+// for a peak of 11000 bytes. Computing ab before c brings the peak down to 9000 bytes.
+TEST_F(RunOrderTest, LargeTemporaryIsWrittenLate) {
+    WrapperModel model;
+    const uint32_t row = model.addOperand(&kTypeRow);
+    const uint32_t matrix = model.addOperand(&kTypeMatrix);
+    const uint32_t a = addRelu(&model, row, kTypeRow);
+    const uint32_t b = addRelu(&model, row, kTypeRow);
+    const uint32_t c = addRelu(&model, matrix, kTypeMatrix);
+    const uint32_t ab = addAdd(&model, a, b, kTypeRow);
+    const uint32_t output = addAdd(&model, ab, c, kTypeMatrix);
+    model.identifyInputsAndOutputs({row, matrix}, {output});
+    const auto [subgraph, sortedToAdded] = finish(&model);
+    ASSERT_EQ(subgraph.operations.size(), 5u);
+
+    const std::vector<uint32_t> sortedOrder = getStoredOrder(subgraph);
+    EXPECT_TRUE(isRunOrder(subgraph, sortedOrder));
+    EXPECT_EQ(getPeakLiveBytes(subgraph, sortedOrder), 9000u);
+
+    const std::vector<uint32_t> previousOrder = getPreviousOrder(subgraph, sortedToAdded);
+    ASSERT_TRUE(isRunOrder(subgraph, previousOrder));
+    EXPECT_EQ(getPeakLiveBytes(subgraph, previousOrder), 11000u);
+}
+
+// Builds a ladder of 16 rungs
+//
+//   left[0] = RELU(input)
+//   right[0] = RELU(input)
+//   left[i] = ADD(left[i - 1], right[i - 1])
+//   right[i] = ADD(right[i - 1], right[i - 1])
+//   output = ADD(left[15], right[15])
+//
+// with the operations added in reverse. Every temporary is 1000 bytes. The order must still be a
+// run order, and its peak no higher than the one of the previous sort.
+TEST_F(RunOrderTest, ReversedLadderIsSorted) {
+    constexpr uint32_t kNumRungs = 16;
+    WrapperModel model;
+    const uint32_t input = model.addOperand(&kTypeRow);
+    // Operands are added first so that the operations can be added in reverse order.
+    std::vector<uint32_t> left(kNumRungs), right(kNumRungs);
+    for (uint32_t i = 0; i < kNumRungs; ++i) {
+        left[i] = model.addOperand(&kTypeRow);
+        right[i] = model.addOperand(&kTypeRow);
+    }
+    const uint32_t activation = model.addConstantOperand(&kTypeActivation, kActivation);
+    const uint32_t output = model.addOperand(&kTypeRow);
+    model.addOperation(ANEURALNETWORKS_ADD,
+                       {left[kNumRungs - 1], right[kNumRungs - 1], activation}, {output});
+    for (uint32_t i = kNumRungs - 1; i > 0; --i) {
+        model.addOperation(ANEURALNETWORKS_ADD, {left[i - 1], right[i - 1], activation},
+                           {left[i]});
+        model.addOperation(ANEURALNETWORKS_ADD, {right[i - 1], right[i - 1], activation},
+                           {right[i]});
+    }
+    model.addOperation(ANEURALNETWORKS_RELU, {input}, {left[0]});
+    model.addOperation(ANEURALNETWORKS_RELU, {input}, {right[0]});
+    model.identifyInputsAndOutputs({input}, {output});
+    const auto [subgraph, sortedToAdded] = finish(&model);
+    ASSERT_EQ(subgraph.operations.size(), 2 * kNumRungs + 1);
+
+    const std::vector<uint32_t> sortedOrder = getStoredOrder(subgraph);
+    EXPECT_TRUE(isRunOrder(subgraph, sortedOrder));
+    const std::vector<uint32_t> previousOrder = getPreviousOrder(subgraph, sortedToAdded);
+    ASSERT_TRUE(isRunOrder(subgraph, previousOrder));
+    EXPECT_LE(getPeakLiveBytes(subgraph, sortedOrder), getPeakLiveBytes(subgraph, previousOrder));
+}
+
+// Builds random graphs of RELU and ADD operations reading a row and a matrix, added in a random
+// order. A temporary is a matrix if any input of the operation writing it is one. The operands
+// that no operation reads are the outputs of the model. The order must be a run order, and its
+// peak no higher than the one of the previous sort.
+TEST_F(RunOrderTest, RandomGraphsAreSorted) {
+    constexpr uint32_t kNumGraphs = 100;
+    constexpr uint32_t kMaxNumOperations = 40;
+    for (uint32_t seed = 0; seed < kNumGraphs; ++seed) {
+        SCOPED_TRACE(seed);
+        std::mt19937 randomEngine(seed);
+        auto randUInt = [&randomEngine](uint32_t limit) {  // [0, limit)
+            return std::uniform_int_distribution<uint32_t>(0, limit - 1)(randomEngine);
+        };
+
+        WrapperModel model;
+        const uint32_t row = model.addOperand(&kTypeRow);
+        const uint32_t matrix = model.addOperand(&kTypeMatrix);
+        const uint32_t activation = model.addConstantOperand(&kTypeActivation, kActivation);
+        // The operands are added first so that the operations can be added in a random order.
+        std::vector<uint32_t> operands = {row, matrix};
+        std::vector<bool> isMatrix = {false, true};
+        std::vector<std::pair<std::vector<uint32_t>, uint32_t>> operations;
+        const uint32_t numOperations = 2 + randUInt(kMaxNumOperations - 1);
+        for (uint32_t i = 0; i < numOperations; ++i) {
+            // The first two operations read the inputs of the model, so that both are used.
+            const uint32_t numOperands = operands.size();
+            std::vector<uint32_t> inputs;
+            if (i < 2) {
+                inputs = {i};
+            } else if (randUInt(2) == 0) {
+                inputs = {randUInt(numOperands)};
+            } else {
+                inputs = {randUInt(numOperands), randUInt(numOperands)};
+            }
+            const bool outputIsMatrix =
+                    std::any_of(inputs.begin(), inputs.end(),
+                                [&isMatrix](uint32_t input) { return isMatrix[input]; });
+            operands.push_back(model.addOperand(outputIsMatrix ? &kTypeMatrix : &kTypeRow));
+            isMatrix.push_back(outputIsMatrix);
+            operations.emplace_back(std::move(inputs), numOperands);
+        }
+        std::shuffle(operations.begin(), operations.end(), randomEngine);
+
+        std::vector<bool> isRead(operands.size(), false);
+        for (const auto& [inputs, output] : operations) {
+            std::vector<uint32_t> operationInputs;
+            for (uint32_t input : inputs) {
+                isRead[input] = true;
+                operationInputs.push_back(operands[input]);
+            }
+            if (operationInputs.size() == 1) {
+                model.addOperation(ANEURALNETWORKS_RELU, operationInputs, {operands[output]});
+            } else {
+                operationInputs.push_back(activation);
+                model.addOperation(ANEURALNETWORKS_ADD, operationInputs, {operands[output]});
+            }
+        }
+        std::vector<uint32_t> outputs;
+        for (uint32_t i = 2; i < operands.size(); ++i) {
+            if (!isRead[i]) {
+                outputs.push_back(operands[i]);
+            }
+        }
+        model.identifyInputsAndOutputs({row, matrix}, outputs);
+        const auto [subgraph, sortedToAdded] = finish(&model);
+        ASSERT_EQ(subgraph.operations.size(), numOperations);
+
+        const std::vector<uint32_t> sortedOrder = getStoredOrder(subgraph);
+        EXPECT_TRUE(isRunOrder(subgraph, sortedOrder));
+        const std::vector<uint32_t> previousOrder = getPreviousOrder(subgraph, sortedToAdded);
+        ASSERT_TRUE(isRunOrder(subgraph, previousOrder));
+        EXPECT_LE(getPeakLiveBytes(subgraph, sortedOrder),
+                  getPeakLiveBytes(subgraph, previousOrder));
+    }
+}
+
+}  // namespace
+}  // namespace android::nn
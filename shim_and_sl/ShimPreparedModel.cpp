@@ -25,6 +25,7 @@
 #include <android-base/chrono_utils.h>
 #include <android-base/logging.h>
 #include <android-base/scopeguard.h>
+#include <android-base/thread_annotations.h>
 #include <android/binder_auto_utils.h>
 #include <nnapi/TypeUtils.h>
 #include <nnapi/hal/aidl/Conversions.h>
@@ -34,6 +35,8 @@
 #include <chrono>
 #include <limits>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <thread>
 #include <unordered_map>
 #include <utility>
@@ -44,40 +47,70 @@
 
 namespace aidl::android::hardware::neuralnetworks {
 
-ErrorStatus ShimPreparedModel::parseInputs(
-        const Request& request, bool measure, int64_t deadlineNs, int64_t loopTimeoutDurationNs,
-        ::android::nn::sl_wrapper::Execution* execution,
-        std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>>* requestMemoryPools,
-        const std::vector<TokenValuePair>& executionHints,
-        const std::vector<ExtensionNameAndPrefix>& extensionNameToPrefix) {
-    for (const auto& requestPool : request.pools) {
-        switch (requestPool.getTag()) {
-            case RequestMemoryPool::pool: {
-                const auto& memoryPool = requestPool.get<RequestMemoryPool::pool>();
-                std::shared_ptr<::android::nn::sl_wrapper::Memory> mem =
-                        convertFromHAL(mNnapi.get(), memoryPool);
-                if (!mem) {
-                    LOG(ERROR) << "Failed to convert request HAL memory pools into SL memory";
-                    return ErrorStatus::INVALID_ARGUMENT;
-                }
-
-                requestMemoryPools->push_back(mem);
-                break;
+std::shared_ptr<::android::nn::sl_wrapper::Memory> ShimPreparedModel::getRequestMemory(
+        const RequestMemoryPool& requestPool) const {
+    switch (requestPool.getTag()) {
+        case RequestMemoryPool::pool: {
+            const auto& memoryPool = requestPool.get<RequestMemoryPool::pool>();
+            std::shared_ptr<::android::nn::sl_wrapper::Memory> mem =
+                    convertFromHAL(mNnapi.get(), memoryPool);
+            if (!mem) {
+                LOG(ERROR) << "Failed to convert request HAL memory pools into SL memory";
             }
-            case RequestMemoryPool::token: {
-                int token = requestPool.get<RequestMemoryPool::token>();
+            return mem;
+        }
+        case RequestMemoryPool::token: {
+            int token = requestPool.get<RequestMemoryPool::token>();
+            return mBufferTracker->get(static_cast<uint32_t>(token));
+        }
+    }
+    return nullptr;
+}
 
-                auto memory = mBufferTracker->get(static_cast<uint32_t>(token));
-                if (memory == nullptr) {
-                    return ErrorStatus::INVALID_ARGUMENT;
-                }
+ErrorStatus ShimPreparedModel::getRequestMemoryPools(
+        const Request& request,
+        std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>>* requestMemoryPools) {
+    for (const auto& requestPool : request.pools) {
+        auto memory = getRequestMemory(requestPool);
+        if (memory == nullptr) {
+            return ErrorStatus::INVALID_ARGUMENT;
+        }
+        requestMemoryPools->push_back(std::move(memory));
+    }
+    return ErrorStatus::NONE;
+}
 
-                requestMemoryPools->push_back(memory);
-                break;
-            }
+ErrorStatus ShimPreparedModel::createExecution(
+        const Request& request,
+        const std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>>& requestMemoryPools,
+        bool measure, int64_t deadlineNs, int64_t loopTimeoutDurationNs, bool reusable,
+        const std::vector<TokenValuePair>& executionHints,
+        const std::vector<ExtensionNameAndPrefix>& extensionNameToPrefix,
+        std::shared_ptr<::android::nn::sl_wrapper::Execution>* execution) {
+    auto wrapperExecution =
+            std::make_shared<::android::nn::sl_wrapper::Execution>(mNnapi.get(), &mCompilation);
+    auto errorStatus =
+            parseInputs(request, measure, deadlineNs, loopTimeoutDurationNs, wrapperExecution.get(),
+                        requestMemoryPools, executionHints, extensionNameToPrefix);
+    if (errorStatus != ErrorStatus::NONE) {
+        return errorStatus;
+    }
+    if (reusable) {
+        auto result = wrapperExecution->setReusable(true);
+        if (result != Result::NO_ERROR) {
+            return convertResultToErrorStatus(result);
         }
     }
+    *execution = std::move(wrapperExecution);
+    return ErrorStatus::NONE;
+}
 
+ErrorStatus ShimPreparedModel::parseInputs(
+        const Request& request, bool measure, int64_t deadlineNs, int64_t loopTimeoutDurationNs,
+        ::android::nn::sl_wrapper::Execution* execution,
+        const std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>>& requestMemoryPools,
+        const std::vector<TokenValuePair>& executionHints,
+        const std::vector<ExtensionNameAndPrefix>& extensionNameToPrefix) {
     // enable input and output padding
     const auto enablePaddingResult = execution->enableInputAndOutputPadding(true);
     if (enablePaddingResult != Result::NO_ERROR) {
@@ -99,7 +132,7 @@ ErrorStatus ShimPreparedModel::parseInputs(
                 operandType.updateDimensions(::android::nn::toUnsigned(input.dimensions).value());
             }
             auto result = execution->setInputFromMemory(
-                    i, requestMemoryPools->at(input.location.poolIndex).get(),
+                    i, requestMemoryPools.at(input.location.poolIndex).get(),
                     input.location.offset, input.location.length, &operandType.operandType);
             if (result != Result::NO_ERROR) {
                 return convertResultToErrorStatus(result);
@@ -126,7 +159,7 @@ ErrorStatus ShimPreparedModel::parseInputs(
                 operandType.updateDimensions(::android::nn::toUnsigned(output.dimensions).value());
             }
             auto result = execution->setOutputFromMemory(
-                    i, requestMemoryPools->at(output.location.poolIndex).get(),
+                    i, requestMemoryPools.at(output.location.poolIndex).get(),
                     output.location.offset, output.location.length, &operandType.operandType);
             if (result != Result::NO_ERROR) {
                 return convertResultToErrorStatus(result);
@@ -190,6 +223,16 @@ ErrorStatus ShimPreparedModel::parseInputs(
     return ErrorStatus::NONE;
 }
 
+// Returns an error if deadlineNs is neither kNoDeadline nor a time point.
+static ndk::ScopedAStatus checkDeadline(int64_t deadlineNs) {
+    if (deadlineNs < -1) {
+        LOG(ERROR) << "Invalid deadline value, must be >= -1";
+        return ndk::ScopedAStatus::fromServiceSpecificError(
+                static_cast<int>(ErrorStatus::INVALID_ARGUMENT));
+    }
+    return ndk::ScopedAStatus::ok();
+}
+
 class ShimFencedExecutionCallback : public BnFencedExecutionCallback {
    public:
     ShimFencedExecutionCallback(
@@ -306,17 +349,18 @@ static ndk::ScopedAStatus executeFencedInternal(
         FencedExecutionResult* fencedExecutionResult) {
     CHECK(fencedExecutionResult != nullptr);
 
-    if (deadlineNs < -1) {
-        LOG(ERROR) << "Invalid deadline value, must be >= -1";
-        return ndk::ScopedAStatus::fromServiceSpecificError(
-                static_cast<int>(ErrorStatus::INVALID_ARGUMENT));
+    if (auto status = checkDeadline(deadlineNs); !status.isOk()) {
+        return status;
     }
-    auto execution =
-            std::make_shared<::android::nn::sl_wrapper::Execution>(mNnapi.get(), &mCompilation);
     std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>> requestMemoryPools;
-    auto errorStatus =
-            parseInputs(request, measureTiming, deadlineNs, loopTimeoutDurationNs, execution.get(),
-                        &requestMemoryPools, executionHints, extensionNameToPrefix);
+    auto errorStatus = getRequestMemoryPools(request, &requestMemoryPools);
+    if (errorStatus != ErrorStatus::NONE) {
+        return toAStatus(errorStatus);
+    }
+    std::shared_ptr<::android::nn::sl_wrapper::Execution> execution;
+    errorStatus = createExecution(request, requestMemoryPools, measureTiming, deadlineNs,
+                                  loopTimeoutDurationNs, /*reusable=*/false, executionHints,
+                                  extensionNameToPrefix, &execution);
     if (errorStatus != ErrorStatus::NONE) {
         return toAStatus(errorStatus);
     }
@@ -402,18 +446,19 @@ static ndk::ScopedAStatus executeSynchronouslyInternal(
         ExecutionResult* executionResult) {
     CHECK(executionResult != nullptr);
 
-    if (deadlineNs < -1) {
-        LOG(ERROR) << "Invalid deadline value, must be >= -1";
-        return ndk::ScopedAStatus::fromServiceSpecificError(
-                static_cast<int>(ErrorStatus::INVALID_ARGUMENT));
+    if (auto status = checkDeadline(deadlineNs); !status.isOk()) {
+        return status;
     }
 
-    auto execution =
-            std::make_shared<::android::nn::sl_wrapper::Execution>(mNnapi.get(), &mCompilation);
     std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>> requestMemoryPools;
-    auto errorStatus =
-            parseInputs(request, measureTiming, deadlineNs, loopTimeoutDurationNs, execution.get(),
-                        &requestMemoryPools, executionHints, extensionNameToPrefix);
+    auto errorStatus = getRequestMemoryPools(request, &requestMemoryPools);
+    if (errorStatus != ErrorStatus::NONE) {
+        return toAStatus(errorStatus);
+    }
+    std::shared_ptr<::android::nn::sl_wrapper::Execution> execution;
+    errorStatus = createExecution(request, requestMemoryPools, measureTiming, deadlineNs,
+                                  loopTimeoutDurationNs, /*reusable=*/false, executionHints,
+                                  extensionNameToPrefix, &execution);
     if (errorStatus != ErrorStatus::NONE) {
         return toAStatus(errorStatus);
     }
@@ -465,8 +510,40 @@ class ShimBurst : public BnBurst {
     ndk::ScopedAStatus releaseMemoryResource(int64_t memoryIdentifierToken) override;
 
    protected:
+    // The reusable execution of the last request, which is computed again as long as the burst
+    // receives the same request with the same memories and configuration.
+    struct CachedExecution {
+        std::vector<RequestArgument> inputs;
+        std::vector<RequestArgument> outputs;
+        std::vector<int64_t> memoryIdentifierTokens;
+        std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>> requestMemoryPools;
+        bool measureTiming;
+        int64_t loopTimeoutDurationNs;
+        std::vector<TokenValuePair> executionHints;
+        std::vector<ExtensionNameAndPrefix> extensionNameToPrefix;
+        std::shared_ptr<::android::nn::sl_wrapper::Execution> execution;
+    };
+
+    ndk::ScopedAStatus executeSynchronouslyCommon(
+            const Request& request, const std::vector<int64_t>& memoryIdentifierTokens,
+            bool measureTiming, int64_t deadlineNs, int64_t loopTimeoutDurationNs,
+            const std::vector<TokenValuePair>& executionHints,
+            const std::vector<ExtensionNameAndPrefix>& extensionNameToPrefix,
+            ExecutionResult* executionResult);
+    ErrorStatus getRequestMemoryPools(
+            const Request& request, const std::vector<int64_t>& memoryIdentifierTokens,
+            std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>>* requestMemoryPools)
+            REQUIRES(mMutex);
+
     std::atomic_flag mExecutionInFlight = ATOMIC_FLAG_INIT;
     const std::shared_ptr<ShimPreparedModel> kPreparedModel;
+
+    std::mutex mMutex;
+    // The SL memories of the memory pools that were sent with a memory identifier token, kept
+    // until the client calls releaseMemoryResource with the token.
+    std::unordered_map<int64_t, std::shared_ptr<::android::nn::sl_wrapper::Memory>> mMemoryCache
+            GUARDED_BY(mMutex);
+    std::optional<CachedExecution> mCachedExecution GUARDED_BY(mMutex);
 };
 
 ndk::ScopedAStatus ShimPreparedModel::configureExecutionBurst(std::shared_ptr<IBurst>* burst) {
@@ -480,10 +557,42 @@ ShimBurst::ShimBurst(std::shared_ptr<ShimPreparedModel> preparedModel)
     CHECK(kPreparedModel != nullptr);
 }
 
-ndk::ScopedAStatus ShimBurst::executeSynchronously(
+ErrorStatus ShimBurst::getRequestMemoryPools(
+        const Request& request, const std::vector<int64_t>& memoryIdentifierTokens,
+        std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>>* requestMemoryPools) {
+    for (size_t i = 0; i < request.pools.size(); ++i) {
+        const auto& requestPool = request.pools[i];
+        const int64_t token = memoryIdentifierTokens[i];
+        // Driver-managed buffers are owned by the buffer tracker, so only the memories of pools
+        // need to be cached.
+        const bool isCacheable = requestPool.getTag() == RequestMemoryPool::pool && token != -1;
+        if (isCacheable) {
+            const auto it = mMemoryCache.find(token);
+            if (it != mMemoryCache.end()) {
+                requestMemoryPools->push_back(it->second);
+                continue;
+            }
+        }
+        auto memory = kPreparedModel->getRequestMemory(requestPool);
+        if (memory == nullptr) {
+            return ErrorStatus::INVALID_ARGUMENT;
+        }
+        if (isCacheable) {
+            mMemoryCache.emplace(token, memory);
+        }
+        requestMemoryPools->push_back(std::move(memory));
+    }
+    return ErrorStatus::NONE;
+}
+
+ndk::ScopedAStatus ShimBurst::executeSynchronouslyCommon(
         const Request& request, const std::vector<int64_t>& memoryIdentifierTokens,
         bool measureTiming, int64_t deadlineNs, int64_t loopTimeoutDurationNs,
+        const std::vector<TokenValuePair>& executionHints,
+        const std::vector<ExtensionNameAndPrefix>& extensionNameToPrefix,
         ExecutionResult* executionResult) {
+    CHECK(executionResult != nullptr);
+
     if (request.pools.size() != memoryIdentifierTokens.size()) {
         return toAStatus(ErrorStatus::INVALID_ARGUMENT,
                          "request.pools.size() != memoryIdentifierTokens.size()");
@@ -492,6 +601,9 @@ ndk::ScopedAStatus ShimBurst::executeSynchronously(
                      [](int64_t token) { return token >= -1; })) {
         return toAStatus(ErrorStatus::INVALID_ARGUMENT, "Invalid memoryIdentifierTokens");
     }
+    if (auto status = checkDeadline(deadlineNs); !status.isOk()) {
+        return status;
+    }
 
     // Ensure at most one execution is in flight at a time.
     const bool executionAlreadyInFlight = mExecutionInFlight.test_and_set();
@@ -501,38 +613,95 @@ ndk::ScopedAStatus ShimBurst::executeSynchronously(
     }
     const auto guard = ::android::base::make_scope_guard([this] { mExecutionInFlight.clear(); });
 
-    return kPreparedModel->executeSynchronously(request, measureTiming, deadlineNs,
-                                                loopTimeoutDurationNs, executionResult);
+    // A reusable execution cannot be given a new timeout, so only executions without a deadline
+    // are cached, and only if all of their memories are cached as well.
+    const bool isCacheable =
+            deadlineNs == kNoDeadline &&
+            std::none_of(memoryIdentifierTokens.begin(), memoryIdentifierTokens.end(),
+                         [](int64_t token) { return token == -1; });
+    std::shared_ptr<::android::nn::sl_wrapper::Execution> execution;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>> requestMemoryPools;
+        auto errorStatus =
+                getRequestMemoryPools(request, memoryIdentifierTokens, &requestMemoryPools);
+        if (errorStatus != ErrorStatus::NONE) {
+            return toAStatus(errorStatus);
+        }
+        if (isCacheable && mCachedExecution.has_value() &&
+            mCachedExecution->inputs == request.inputs &&
+            mCachedExecution->outputs == request.outputs &&
+            mCachedExecution->memoryIdentifierTokens == memoryIdentifierTokens &&
+            mCachedExecution->requestMemoryPools == requestMemoryPools &&
+            mCachedExecution->measureTiming == measureTiming &&
+            mCachedExecution->loopTimeoutDurationNs == loopTimeoutDurationNs &&
+            mCachedExecution->executionHints == executionHints &&
+            mCachedExecution->extensionNameToPrefix == extensionNameToPrefix) {
+            execution = mCachedExecution->execution;
+        } else {
+            errorStatus = kPreparedModel->createExecution(
+                    request, requestMemoryPools, measureTiming, deadlineNs, loopTimeoutDurationNs,
+                    /*reusable=*/isCacheable, executionHints, extensionNameToPrefix, &execution);
+            if (errorStatus != ErrorStatus::NONE) {
+                return toAStatus(errorStatus);
+            }
+            if (isCacheable) {
+                mCachedExecution = CachedExecution{
+                        .inputs = request.inputs,
+                        .outputs = request.outputs,
+                        .memoryIdentifierTokens = memoryIdentifierTokens,
+                        .requestMemoryPools = std::move(requestMemoryPools),
+                        .measureTiming = measureTiming,
+                        .loopTimeoutDurationNs = loopTimeoutDurationNs,
+                        .executionHints = executionHints,
+                        .extensionNameToPrefix = extensionNameToPrefix,
+                        .execution = execution,
+                };
+            }
+        }
+    }
+
+    auto status = executeSynchronouslyInternal(execution, measureTiming, request.outputs.size(),
+                                               executionResult);
+    if (!status.isOk() && isCacheable) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mCachedExecution.has_value() && mCachedExecution->execution == execution) {
+            mCachedExecution.reset();
+        }
+    }
+    return status;
+}
+
+ndk::ScopedAStatus ShimBurst::executeSynchronously(
+        const Request& request, const std::vector<int64_t>& memoryIdentifierTokens,
+        bool measureTiming, int64_t deadlineNs, int64_t loopTimeoutDurationNs,
+        ExecutionResult* executionResult) {
+    return executeSynchronouslyCommon(request, memoryIdentifierTokens, measureTiming, deadlineNs,
+                                      loopTimeoutDurationNs, /*executionHints=*/{},
+                                      /*extensionNameToPrefix=*/{}, executionResult);
 }
 
 ndk::ScopedAStatus ShimBurst::executeSynchronouslyWithConfig(
         const Request& request, const std::vector<int64_t>& memoryIdentifierTokens,
         const ExecutionConfig& config, int64_t deadlineNs, ExecutionResult* executionResult) {
-    if (request.pools.size() != memoryIdentifierTokens.size()) {
-        return toAStatus(ErrorStatus::INVALID_ARGUMENT,
-                         "request.pools.size() != memoryIdentifierTokens.size()");
-    }
-    if (!std::all_of(memoryIdentifierTokens.begin(), memoryIdentifierTokens.end(),
-                     [](int64_t token) { return token >= -1; })) {
-        return toAStatus(ErrorStatus::INVALID_ARGUMENT, "Invalid memoryIdentifierTokens");
-    }
-
-    // Ensure at most one execution is in flight at a time.
-    const bool executionAlreadyInFlight = mExecutionInFlight.test_and_set();
-    if (executionAlreadyInFlight) {
-        return toAStatus(ErrorStatus::GENERAL_FAILURE,
-                         "Burst object supports at most one execution at a time");
-    }
-    const auto guard = ::android::base::make_scope_guard([this] { mExecutionInFlight.clear(); });
-
-    return kPreparedModel->executeSynchronouslyWithConfig(request, config, deadlineNs,
-                                                          executionResult);
+    return executeSynchronouslyCommon(request, memoryIdentifierTokens, config.measureTiming,
+                                      deadlineNs, config.loopTimeoutDurationNs,
+                                      config.executionHints, config.extensionNameToPrefix,
+                                      executionResult);
 }
 
 ndk::ScopedAStatus ShimBurst::releaseMemoryResource(int64_t memoryIdentifierToken) {
     if (memoryIdentifierToken < -1) {
         return toAStatus(ErrorStatus::INVALID_ARGUMENT, "Invalid memoryIdentifierToken");
     }
+    std::lock_guard<std::mutex> lock(mMutex);
+    mMemoryCache.erase(memoryIdentifierToken);
+    if (mCachedExecution.has_value()) {
+        const auto& tokens = mCachedExecution->memoryIdentifierTokens;
+        if (std::find(tokens.begin(), tokens.end(), memoryIdentifierToken) != tokens.end()) {
+            mCachedExecution.reset();
+        }
+    }
     return ndk::ScopedAStatus::ok();
 }
 
@@ -562,18 +731,19 @@ class ShimExecution : public BnExecution {
 ndk::ScopedAStatus ShimPreparedModel::createReusableExecution(
         const Request& request, const ExecutionConfig& config,
         std::shared_ptr<IExecution>* execution) {
-    auto wrapperExecution =
-            std::make_shared<::android::nn::sl_wrapper::Execution>(mNnapi.get(), &mCompilation);
     std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>> requestMemoryPools;
-    auto errorStatus =
-            parseInputs(request, config.measureTiming, kNoDeadline, config.loopTimeoutDurationNs,
-                        wrapperExecution.get(), &requestMemoryPools, config.executionHints,
-                        config.extensionNameToPrefix);
+    auto errorStatus = getRequestMemoryPools(request, &requestMemoryPools);
+    if (errorStatus != ErrorStatus::NONE) {
+        return toAStatus(errorStatus);
+    }
+    std::shared_ptr<::android::nn::sl_wrapper::Execution> wrapperExecution;
+    errorStatus = createExecution(request, requestMemoryPools, config.measureTiming, kNoDeadline,
+                                  config.loopTimeoutDurationNs, /*reusable=*/true,
+                                  config.executionHints, config.extensionNameToPrefix,
+                                  &wrapperExecution);
     if (errorStatus != ErrorStatus::NONE) {
         return toAStatus(errorStatus);
     }
-    auto result = wrapperExecution->setReusable(true);
-    SLW2SAS_RETURN_IF_ERROR(result);
 
     *execution = ndk::SharedRefBase::make<ShimExecution>(
             mNnapi, std::move(wrapperExecution), std::move(requestMemoryPools),
@@ -594,10 +764,8 @@ ShimExecution::ShimExecution(
 
 ndk::ScopedAStatus ShimExecution::executeSynchronously(int64_t deadlineNs,
                                                        ExecutionResult* executionResult) {
-    if (deadlineNs < -1) {
-        LOG(ERROR) << "Invalid deadline value, must be >= -1";
-        return ndk::ScopedAStatus::fromServiceSpecificError(
-                static_cast<int>(ErrorStatus::INVALID_ARGUMENT));
+    if (auto status = checkDeadline(deadlineNs); !status.isOk()) {
+        return status;
     }
 
     // Ensure at most one execution is in flight at a time.
@@ -615,10 +783,8 @@ ndk::ScopedAStatus ShimExecution::executeSynchronously(int64_t deadlineNs,
 ndk::ScopedAStatus ShimExecution::executeFenced(
         const std::vector<ndk::ScopedFileDescriptor>& waitFor, int64_t deadlineNs,
         int64_t durationNs, FencedExecutionResult* fencedExecutionResult) {
-    if (deadlineNs < -1) {
-        LOG(ERROR) << "Invalid deadline value, must be >= -1";
-        return ndk::ScopedAStatus::fromServiceSpecificError(
-                static_cast<int>(ErrorStatus::INVALID_ARGUMENT));
+    if (auto status = checkDeadline(deadlineNs); !status.isOk()) {
+        return status;
     }
 
     // Ensure at most one execution is in flight at a time.
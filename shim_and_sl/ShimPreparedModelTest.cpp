@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ShimPreparedModel.h"
+
+#include <aidl/android/hardware/common/Ashmem.h>
+#include <aidl/android/hardware/neuralnetworks/IBurst.h>
+#include <aidl/android/hardware/neuralnetworks/Memory.h>
+#include <aidl/android/hardware/neuralnetworks/Request.h>
+#include <aidl/android/hardware/neuralnetworks/RequestMemoryPool.h>
+#include <android-base/chrono_utils.h>
+#include <android/binder_auto_utils.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "ShimBufferTracker.h"
+#include "ShimUtils.h"
+#include "SupportLibrary.h"
+#include "SupportLibraryWrapper.h"
+
+namespace aidl::android::hardware::neuralnetworks {
+namespace {
+
+constexpr uint32_t kSize = 4;
+constexpr int64_t kLength = kSize * sizeof(float);
+constexpr int64_t kNoLoopTimeout = -1;
+
+// The support library objects created and the computations run through the fake support library.
+struct Counts {
+    int memories = 0;
+    int executions = 0;
+    int computations = 0;
+};
+Counts gCounts;
+
+// The fake support library never looks at its handles, so all objects of a type share one.
+template <typename T>
+T* getFakeHandle() {
+    static char handle;
+    return reinterpret_cast<T*>(&handle);
+}
+
+// A support library that accepts everything the shim does to run a burst execution, without
+// computing anything.
+NnApiSLDriverImplFL5 createFakeSupportLibrary() {
+    NnApiSLDriverImplFL5 impl = {};
+    impl.base.implFeatureLevel = ANEURALNETWORKS_FEATURE_LEVEL_5;
+    impl.ANeuralNetworksMemory_createFromFd = [](size_t, int, int, size_t,
+                                                 ANeuralNetworksMemory** memory) {
+        ++gCounts.memories;
+        *memory = getFakeHandle<ANeuralNetworksMemory>();
+        return ANEURALNETWORKS_NO_ERROR;
+    };
+    impl.ANeuralNetworksMemory_free = [](ANeuralNetworksMemory*) {};
+    impl.ANeuralNetworksModel_create = [](ANeuralNetworksModel** model) {
+        *model = getFakeHandle<ANeuralNetworksModel>();
+        return ANEURALNETWORKS_NO_ERROR;
+    };
+    impl.ANeuralNetworksModel_free = [](ANeuralNetworksModel*) {};
+    impl.ANeuralNetworksModel_addOperand = [](ANeuralNetworksModel*,
+                                              const ANeuralNetworksOperandType*) {
+        return ANEURALNETWORKS_NO_ERROR;
+    };
+    impl.ANeuralNetworksModel_identifyInputsAndOutputs =
+            [](ANeuralNetworksModel*, uint32_t, const uint32_t*, uint32_t, const uint32_t*) {
+                return ANEURALNETWORKS_NO_ERROR;
+            };
+    impl.ANeuralNetworksCompilation_createForDevices =
+            [](ANeuralNetworksModel*, const ANeuralNetworksDevice* const*, uint32_t,
+               ANeuralNetworksCompilation** compilation) {
+                *compilation = getFakeHandle<ANeuralNetworksCompilation>();
+                return ANEURALNETWORKS_NO_ERROR;
+            };
+    impl.ANeuralNetworksCompilation_free = [](ANeuralNetworksCompilation*) {};
+    impl.ANeuralNetworksExecution_create = [](ANeuralNetworksCompilation*,
+                                              ANeuralNetworksExecution** execution) {
+        ++gCounts.executions;
+        *execution = getFakeHandle<ANeuralNetworksExecution>();
+        return ANEURALNETWORKS_NO_ERROR;
+    };
+    impl.ANeuralNetworksExecution_free = [](ANeuralNetworksExecution*) {};
+    impl.ANeuralNetworksExecution_enableInputAndOutputPadding = [](ANeuralNetworksExecution*,
+                                                                   bool) {
+        return ANEURALNETWORKS_NO_ERROR;
+    };
+    impl.ANeuralNetworksExecution_setInputFromMemory =
+            [](ANeuralNetworksExecution*, int32_t, const ANeuralNetworksOperandType*,
+               const ANeuralNetworksMemory*, size_t, size_t) { return ANEURALNETWORKS_NO_ERROR; };
+    impl.ANeuralNetworksExecution_setOutputFromMemory =
+            [](ANeuralNetworksExecution*, int32_t, const ANeuralNetworksOperandType*,
+               const ANeuralNetworksMemory*, size_t, size_t) { return ANEURALNETWORKS_NO_ERROR; };
+    impl.ANeuralNetworksExecution_setReusable = [](ANeuralNetworksExecution*, bool) {
+        return ANEURALNETWORKS_NO_ERROR;
+    };
+    impl.ANeuralNetworksExecution_setTimeout = [](ANeuralNetworksExecution*, uint64_t) {
+        return ANEURALNETWORKS_NO_ERROR;
+    };
+    impl.ANeuralNetworksExecution_compute = [](ANeuralNetworksExecution*) {
+        ++gCounts.computations;
+        return ANEURALNETWORKS_NO_ERROR;
+    };
+    impl.ANeuralNetworksExecution_getOutputOperandRank = [](ANeuralNetworksExecution*, int32_t,
+                                                            uint32_t* rank) {
+        *rank = 1;
+        return ANEURALNETWORKS_NO_ERROR;
+    };
+    impl.ANeuralNetworksExecution_getOutputOperandDimensions =
+            [](ANeuralNetworksExecution*, int32_t, uint32_t* dimensions) {
+                dimensions[0] = kSize;
+                return ANEURALNETWORKS_NO_ERROR;
+            };
+    return impl;
+}
+
+// A request whose input and output are in separate ashmem pools.
+Request createRequest(int64_t outputLength = kLength) {
+    Request request;
+    request.inputs = {{.location = {.poolIndex = 0, .offset = 0, .length = kLength}}};
+    request.outputs = {{.location = {.poolIndex = 1, .offset = 0, .length = outputLength}}};
+    for (int i = 0; i < 2; ++i) {
+        request.pools.push_back(RequestMemoryPool::make<RequestMemoryPool::pool>(
+                Memory::make<Memory::ashmem>(common::Ashmem{.size = kLength})));
+    }
+    return request;
+}
+
+class ShimBurstTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        gCounts = {};
+        mNnapi = std::make_shared<const NnApiSupportLibrary>(createFakeSupportLibrary(), nullptr);
+
+        // A model with one input and one output.
+        ::android::nn::sl_wrapper::Model model(mNnapi.get());
+        const ::android::nn::wrapper::OperandType type(::android::nn::wrapper::Type::TENSOR_FLOAT32,
+                                                       {kSize});
+        model.addOperand(&type);
+        model.addOperand(&type);
+        model.identifyInputsAndOutputs({0}, {1});
+        auto [result, compilation] =
+                ::android::nn::sl_wrapper::Compilation::createForDevices(mNnapi.get(), &model, {});
+        ASSERT_EQ(result, Result::NO_ERROR);
+        std::vector<::android::nn::sl_wrapper::Model> models;
+        models.push_back(std::move(model));
+
+        auto preparedModel = ndk::SharedRefBase::make<ShimPreparedModel>(
+                mNnapi, ShimBufferTracker::create(), std::move(compilation), std::move(models),
+                /*memoryPools=*/std::vector<std::unique_ptr<::android::nn::sl_wrapper::Memory>>{},
+                /*copiedOperandValues=*/std::vector<uint8_t>{});
+        ASSERT_TRUE(preparedModel->configureExecutionBurst(&mBurst).isOk());
+    }
+
+    void execute(const Request& request, const std::vector<int64_t>& memoryIdentifierTokens,
+                 int64_t deadlineNs = kNoDeadline) {
+        ExecutionResult executionResult;
+        ASSERT_TRUE(mBurst->executeSynchronously(request, memoryIdentifierTokens,
+                                                 /*measureTiming=*/false, deadlineNs,
+                                                 kNoLoopTimeout, &executionResult)
+                            .isOk());
+        EXPECT_TRUE(executionResult.outputSufficientSize);
+    }
+
+    std::shared_ptr<const NnApiSupportLibrary> mNnapi;
+    std::shared_ptr<IBurst> mBurst;
+};
+
+TEST_F(ShimBurstTest, RepeatedRequestReusesMemoriesAndExecution) {
+    const Request request = createRequest();
+    for (int i = 0; i < 3; ++i) {
+        execute(request, {1, 2});
+    }
+    EXPECT_EQ(gCounts.memories, 2);
+    EXPECT_EQ(gCounts.executions, 1);
+    EXPECT_EQ(gCounts.computations, 3);
+}
+
+TEST_F(ShimBurstTest, ReleasedMemoryIsConvertedAgain) {
+    const Request request = createRequest();
+    execute(request, {1, 2});
+    ASSERT_TRUE(mBurst->releaseMemoryResource(2).isOk());
+    execute(request, {1, 2});
+    // Only the released memory is converted again, and the execution that used it is dropped.
+    EXPECT_EQ(gCounts.memories, 3);
+    EXPECT_EQ(gCounts.executions, 2);
+}
+
+TEST_F(ShimBurstTest, ChangedArgumentsCreateNewExecution) {
+    execute(createRequest(), {1, 2});
+    execute(createRequest(/*outputLength=*/kLength / 2), {1, 2});
+    EXPECT_EQ(gCounts.memories, 2);
+    EXPECT_EQ(gCounts.executions, 2);
+}
+
+TEST_F(ShimBurstTest, MemoriesWithoutTokenAreNotCached) {
+    const Request request = createRequest();
+    execute(request, {-1, 2});
+    execute(request, {-1, 2});
+    EXPECT_EQ(gCounts.memories, 3);
+    EXPECT_EQ(gCounts.executions, 2);
+}
+
+TEST_F(ShimBurstTest, ExecutionsWithDeadlineAreNotCached) {
+    const Request request = createRequest();
+    const int64_t deadlineNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                       (::android::base::boot_clock::now() + std::chrono::hours(1))
+                                               .time_since_epoch())
+                                       .count();
+    execute(request, {1, 2}, deadlineNs);
+    execute(request, {1, 2}, deadlineNs);
+    // The memories are cached all the same.
+    EXPECT_EQ(gCounts.memories, 2);
+    EXPECT_EQ(gCounts.executions, 2);
+}
+
+TEST_F(ShimBurstTest, InvalidDeadlineIsRejected) {
+    ExecutionResult executionResult;
+    EXPECT_FALSE(mBurst->executeSynchronously(createRequest(), {1, 2}, /*measureTiming=*/false,
+                                              /*deadlineNs=*/-2, kNoLoopTimeout, &executionResult)
+                         .isOk());
+    EXPECT_EQ(gCounts.executions, 0);
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::neuralnetworks
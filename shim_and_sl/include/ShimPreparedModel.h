@@ -73,11 +73,31 @@ class ShimPreparedModel : public BnPreparedModel {
         return mMainAndReferencedModels[0];
     }
 
+    // Returns the SL memory of a request memory pool, or nullptr if the pool is invalid.
+    std::shared_ptr<::android::nn::sl_wrapper::Memory> getRequestMemory(
+            const RequestMemoryPool& requestPool) const;
+
+    // Creates an execution of the compilation for a request whose memory pools have already been
+    // converted into requestMemoryPools. If reusable is true, the execution can be computed
+    // repeatedly.
+    ErrorStatus createExecution(
+            const Request& request,
+            const std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>>&
+                    requestMemoryPools,
+            bool measure, int64_t deadlineNs, int64_t loopTimeoutDurationNs, bool reusable,
+            const std::vector<TokenValuePair>& executionHints,
+            const std::vector<ExtensionNameAndPrefix>& extensionNameToPrefix,
+            std::shared_ptr<::android::nn::sl_wrapper::Execution>* execution);
+
    private:
+    ErrorStatus getRequestMemoryPools(
+            const Request& request,
+            std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>>* requestMemoryPools);
     ErrorStatus parseInputs(
             const Request& request, bool measure, int64_t deadlineNs, int64_t loopTimeoutDurationNs,
             ::android::nn::sl_wrapper::Execution* execution,
-            std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>>* requestMemoryPools,
+            const std::vector<std::shared_ptr<::android::nn::sl_wrapper::Memory>>&
+                    requestMemoryPools,
             const std::vector<TokenValuePair>& executionHints,
             const std::vector<ExtensionNameAndPrefix>& extensionNameToPrefix);
 
@@ -0,0 +1,85 @@
+#!/usr/bin/python3
+""" NNAPI model benchmark comparison
+
+Compares two JSON outputs of NeuralNetworksBenchmark_models, produced with
+  NeuralNetworksBenchmark_models --benchmark_out=[filename] --benchmark_out_format=json
+
+and reports the benchmarks whose latency percentiles, allocations or peak memory
+grew by more than a threshold. If a benchmark was repeated, the median of its
+repetitions is compared. Exits with status 1 if any benchmark regressed.
+
+Usage:
+  compare_model_benchmarks --threshold=[ratio] [baseline filename] [contender filename]
+
+"""
+import argparse
+import json
+import statistics
+import sys
+
+METRICS = ["p50_us", "p90_us", "p99_us", "allocations", "peak_bytes"]
+
+
+def main():
+  parser = argparse.ArgumentParser()
+  parser.add_argument("baseline", help="baseline filename")
+  parser.add_argument("contender", help="contender filename")
+  parser.add_argument("--threshold", type=float, default=0.05,
+                      help="relative growth of a metric that is reported as a "
+                      "regression (default: %(default)s)")
+  parser.add_argument("--all", action="store_true",
+                      help="print every benchmark, not only the regressions")
+  args = parser.parse_args()
+
+  baseline = read_data(args.baseline)
+  contender = read_data(args.contender)
+
+  regressions = 0
+  print("{:<80} {:<12} {:>12} {:>12} {:>8}".format(
+      "benchmark", "metric", "baseline", "contender", "change"))
+  for name in sorted(baseline.keys() & contender.keys()):
+    for metric in METRICS:
+      old = baseline[name].get(metric)
+      new = contender[name].get(metric)
+      if old is None or new is None:
+        continue
+      change = (new - old) / old if old > 0 else (0.0 if new == old else float("inf"))
+      is_regression = change > args.threshold
+      regressions += is_regression
+      if is_regression or args.all:
+        print("{:<80} {:<12} {:>12.3f} {:>12.3f} {:>+7.1%}{}".format(
+            name, metric, old, new, change, " REGRESSION" if is_regression else ""))
+
+  for name in sorted(baseline.keys() - contender.keys()):
+    print("{}: missing from {}".format(name, args.contender))
+  for name in sorted(contender.keys() - baseline.keys()):
+    print("{}: missing from {}".format(name, args.baseline))
+
+  print("{} regression(s) above {:.1%}".format(regressions, args.threshold))
+  sys.exit(1 if regressions else 0)
+
+
+def read_data(input_filename):
+  with open(input_filename) as f:
+    benchmarks = json.load(f)["benchmarks"]
+
+  samples = dict()
+  for benchmark in benchmarks:
+    if benchmark.get("run_type", "iteration") != "iteration":
+      continue
+    if benchmark.get("error_occurred"):
+      continue
+    runs = samples.setdefault(benchmark.get("run_name", benchmark["name"]), [])
+    runs.append({metric: benchmark[metric] for metric in METRICS if metric in benchmark})
+
+  data = dict()
+  for name, runs in samples.items():
+    data[name] = {
+        metric: statistics.median(run[metric] for run in runs)
+        for metric in METRICS if all(metric in run for run in runs)
+    }
+  return data
+
+
+if __name__ == "__main__":
+  main()
@@ -1,11 +1,18 @@
-""" NNAPI systrace parser - getting data in from a systrace html output """
+""" NNAPI systrace parser - getting data in from a systrace html output or a
+    Chrome trace written by the NNAPI TraceRecorder """
 
+import json
 import re
 import sys
 
 def get_trace_part(filename):
-  """ Finds the text trace in the given html file, returns as a string. """
+  """ Finds the text trace in the given html file, returns as a string.
+      A Chrome trace JSON file is converted to the same text form. """
   with open(filename) as f:
+    if f.read(1) in ["{", "["]:
+      f.seek(0)
+      return convert_chrome_trace(json.load(f))
+    f.seek(0)
     lines = f.readlines()
   seen_begin = False
   trace = []
@@ -21,6 +28,27 @@ def get_trace_part(filename):
       trace.append([line, lineno])
   return trace
 
+def convert_chrome_trace(trace):
+  """ Converts the begin and end events of a Chrome trace, as written by the
+      NNAPI TraceRecorder, to systrace text rows in time order. """
+  if isinstance(trace, dict):
+    trace = trace["traceEvents"]
+  events = [event for event in trace if event.get("ph") in ["B", "E"]]
+  # sorted() is stable, which keeps the order of events of a thread that have
+  # the same timestamp.
+  events = sorted(events, key=lambda event: float(event["ts"]))
+  rows = []
+  for lineno, event in enumerate(events, 1):
+    pid = event["pid"]
+    if event["ph"] == "B":
+      mark = "B|%d|%s" % (pid, event["name"])
+    else:
+      mark = "E|%d" % pid
+    line = "<...>-%d (%5d) [000] ...1 %.6f: tracing_mark_write: %s" % (
+        event["tid"], pid, float(event["ts"]) / 1e6, mark)
+    rows.append([line, lineno])
+  return rows
+
 MATCHER = re.compile(r"^\s*([^ ].{1,15})-(\d+)\s+\(\s*([-0-9]+)\) .* (\d+\.\d+): tracing_mark_write: ([BE].*)$")
 MATCHER_FOR_OLD = re.compile(r"^\s*([^ ].{1,15})-(\d+) .* (\d+\.\d+): tracing_mark_write: ([BE].*)$")
 
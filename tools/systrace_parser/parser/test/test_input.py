@@ -1,6 +1,6 @@
 import unittest
 
-from parser.input import MATCHER, MATCHER_FOR_OLD
+from parser.input import MATCHER, MATCHER_FOR_OLD, convert_chrome_trace, parse_trace_part
 
 class TestInput(unittest.TestCase):
   def check_match(self, line):
@@ -38,3 +38,23 @@ class TestInput(unittest.TestCase):
       line = line.strip()
       if line:
         self.check_old_match(line)
+
+  def test_chrome_trace(self):
+    trace = {"traceEvents": [
+        {"ph": "B", "pid": 100, "tid": 101, "ts": 2000.0, "name": "[NN_LR_PE]execute"},
+        {"ph": "B", "pid": 100, "tid": 100, "ts": 1000.25, "name": "[NN_LA_PO]test"},
+        {"ph": "E", "pid": 100, "tid": 101, "ts": 3000.0},
+        {"ph": "E", "pid": 100, "tid": 100, "ts": 4000.0},
+    ]}
+    rows = convert_chrome_trace(trace)
+    for [line, lineno] in rows:
+      self.check_match(line)
+    tracked_pids, driver_tgids, parsed = parse_trace_part(rows)
+    self.assertEqual(tracked_pids, {"100": "100", "101": "100"})
+    self.assertEqual(driver_tgids, {})
+    self.assertEqual([[pid, time, mark] for [_, pid, _, time, mark, _, _] in parsed], [
+        ["100", "0.001000", "B|100|[NN_LA_PO]test"],
+        ["101", "0.002000", "B|100|[NN_LR_PE]execute"],
+        ["101", "0.003000", "E|100"],
+        ["100", "0.004000", "E|100"],
+    ])